@@ -30,7 +30,8 @@ extern "C" {
 #endif
 
 #define CFG_ID "vgmstream" // ID for storing in audacious
-#define MIN_BUFFER_SIZE 576
+#define CHECKPOINT_SECONDS 10 // decoder state saved while playing, so seeks back are fast
+#define CHECKPOINT_BUDGET 0x1000000
 
 /* global state */
 /*EXPORT*/ VgmstreamPlugin aud_plugin_instance;
@@ -236,41 +237,6 @@ bool VgmstreamPlugin::read_tag(const char * filename, VFSFile & file, Tuple & tu
     return read_info(filename, tuple);
 }
 
-// internal util to seek during play
-static void seek_helper(int seek_value, int &current_sample_pos, int input_channels) {
-    AUDINFO("seeking\n");
-
-    // compute from ms to samples
-    int seek_needed_samples = (long long)seek_value * vgmstream->sample_rate / 1000L;
-    short buffer[MIN_BUFFER_SIZE * input_channels];
-    int max_buffer_samples = MIN_BUFFER_SIZE;
-
-    int samples_to_do = 0;
-    if (seek_needed_samples < current_sample_pos) {
-        // go back in time, reopen file
-        AUDINFO("resetting file to seek backwards\n");
-        reset_vgmstream(vgmstream);
-        current_sample_pos = 0;
-        samples_to_do = seek_needed_samples;
-    } else if (current_sample_pos < seek_needed_samples) {
-        // go forward in time
-        samples_to_do = seek_needed_samples - current_sample_pos;
-    }
-
-    // do the actual seeking
-    if (samples_to_do >= 0) {
-        AUDINFO("rendering forward\n");
-
-        // render till seeked sample
-        while (samples_to_do > 0) {
-            int seek_samples = std::min(max_buffer_samples, samples_to_do);
-            current_sample_pos += seek_samples;
-            samples_to_do -= seek_samples;
-            render_vgmstream(buffer, seek_samples, vgmstream);
-        }
-    }
-}
-
 // called on play (play thread)
 bool VgmstreamPlugin::play(const char *filename, VFSFile &file) {
     AUDINFO("play file=%s\n", filename);
@@ -298,66 +264,56 @@ bool VgmstreamPlugin::play(const char *filename, VFSFile &file) {
     int bitrate = get_vgmstream_average_bitrate(vgmstream);
     set_stream_bitrate(bitrate);
 
-    //todo apply config
+    // loops, fades and the end are handled by the player's renders
+    vgmstream_cfg_t vcfg = {0};
+    vcfg.allow_play_forever = 1;
+    vcfg.play_forever = settings.loop_forever;
+    vcfg.loop_count = settings.loop_count;
+    vcfg.fade_time = settings.fade_length;
+    vcfg.fade_delay = settings.fade_delay;
+
+    vgmstream_player_cfg pcfg = {0};
+    pcfg.play_cfg = &vcfg;
+    pcfg.checkpoint_seconds = CHECKPOINT_SECONDS;
+    pcfg.checkpoint_budget = CHECKPOINT_BUDGET;
+    vgmstream_player *player = vgmstream_player_init(vgmstream, &pcfg);
+    if (!player) {
+        close_vgmstream(vgmstream);
+        vgmstream = NULL;
+        return false;
+    }
+    int max_buffer_samples = vgmstream_player_get_chunk_samples(player);
 
     int input_channels = vgmstream->channels;
     int output_channels = vgmstream->channels;
     /* enable after all config but before outbuf */
     vgmstream_mixing_autodownmix(vgmstream, settings.downmix_channels);
-    vgmstream_mixing_enable(vgmstream, MIN_BUFFER_SIZE, &input_channels, &output_channels);
+    vgmstream_mixing_enable(vgmstream, max_buffer_samples, &input_channels, &output_channels);
 
     //FMT_S8 / FMT_S16_NE / FMT_S24_NE / FMT_S32_NE / FMT_FLOAT
     open_audio(FMT_S16_LE, vgmstream->sample_rate, output_channels);
 
     // play
-    short buffer[MIN_BUFFER_SIZE * input_channels];
-    int max_buffer_samples = MIN_BUFFER_SIZE;
-    int stream_samples_amount = get_vgmstream_play_samples(
-            settings.loop_count, settings.fade_length,
-            settings.fade_delay, vgmstream);
-    int fade_samples = settings.fade_length * vgmstream->sample_rate;
-    int current_sample_pos = 0;
+    short buffer[max_buffer_samples * input_channels];
 
     while (!check_stop()) {
-        int toget = max_buffer_samples;
-
-        // handle seek request
+        // handle seek request (from the nearest checkpoint, or jumps/renders forward)
         int seek_value = check_seek();
-        if (seek_value >= 0)
-            seek_helper(seek_value, current_sample_pos, input_channels);
-
-        // check stream finished
-        if (!settings.loop_forever || !vgmstream->loop_flag) {
-            if (current_sample_pos >= stream_samples_amount)
-                break;
-            if (current_sample_pos + toget > stream_samples_amount)
-                toget = stream_samples_amount - current_sample_pos;
+        if (seek_value >= 0) {
+            AUDINFO("seeking\n");
+            vgmstream_player_seek(player, (long long)seek_value * vgmstream->sample_rate / 1000L);
         }
 
-        render_vgmstream(buffer, toget, vgmstream);
-
-        if (vgmstream->loop_flag && fade_samples > 0 &&
-                !settings.loop_forever) {
-            int samples_into_fade =
-                    current_sample_pos - (stream_samples_amount - fade_samples);
-            if (samples_into_fade + toget > 0) {
-                for (int j = 0; j < toget; j++, samples_into_fade++) {
-                    if (samples_into_fade > 0) {
-                        double fadedness =
-                                (double)(fade_samples - samples_into_fade) / fade_samples;
-                        for (int k = 0; k < output_channels; k++)
-                            buffer[j * output_channels + k] *= fadedness;
-                    }
-                }
-            }
-        }
+        int done = vgmstream_player_render(player, buffer, max_buffer_samples);
+        if (done == 0)
+            break;
 
-        write_audio(buffer, toget * sizeof(short) * output_channels);
-        current_sample_pos += toget;
+        write_audio(buffer, done * sizeof(short) * output_channels);
     }
 
     AUDINFO("play finished\n");
 
+    vgmstream_player_free(player);
     close_vgmstream(vgmstream);
     vgmstream = NULL;
     return true;
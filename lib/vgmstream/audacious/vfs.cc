@@ -3,102 +3,60 @@
 
 #include <libaudcore/plugin.h>
 
+extern "C" {
 #include "../src/vgmstream.h"
+}
 #include "plugin.h"
 #include "vfs.h"
 
-typedef struct {
-    STREAMFILE sf;
-    VFSFile *vfsFile;
-    off_t offset;
-    char name[32768];
-} VFS_STREAMFILE;
-
-static STREAMFILE *open_vfs_by_VFSFILE(VFSFile *file, const char *path);
-
-static size_t read_vfs(VFS_STREAMFILE *streamfile, uint8_t *dest, off_t offset, size_t length) {
-    size_t bytes_read;
-
-    if (!dest || length <= 0 || offset < 0)
-        return 0;
-
-    // if the offsets don't match, then we need to perform a seek
-    if (streamfile->offset != offset) {
-        int ok = streamfile->vfsFile->fseek(offset, VFS_SEEK_SET);
-        if (ok != 0) return 0;
-        streamfile->offset = offset;
-    }
-
-    bytes_read = streamfile->vfsFile->fread(dest, 1, length);
-    streamfile->offset += bytes_read;
-
-    return bytes_read;
+/* Audacious' VFS as host callbacks, buffering and caching is done by the core's host streamfile */
+static int seek_vfs(void *handle, off_t offset) {
+    return ((VFSFile *)handle)->fseek(offset, VFS_SEEK_SET);
 }
 
-static void close_vfs(VFS_STREAMFILE *streamfile) {
-    delete streamfile->vfsFile; //fcloses the internal file too
-    free(streamfile);
+static size_t read_vfs(void *handle, uint8_t *dst, size_t length) {
+    int64_t bytes_read = ((VFSFile *)handle)->fread(dst, 1, length);
+    return bytes_read > 0 ? bytes_read : 0;
 }
 
-static size_t get_size_vfs(VFS_STREAMFILE *streamfile) {
-    return streamfile->vfsFile->fsize();
+static size_t get_size_vfs(void *handle) {
+    int64_t size = ((VFSFile *)handle)->fsize();
+    return size > 0 ? size : 0;
 }
 
-static size_t get_offset_vfs(VFS_STREAMFILE *streamfile) {
-    return streamfile->offset;
+static void *open_vfs_file(const char *path) {
+    VFSFile *vfsFile = new VFSFile(path, "rb");
+    if (!vfsFile || !*vfsFile) {
+        delete vfsFile;
+        return NULL;
+    }
+    return vfsFile;
 }
 
-static void get_name_vfs(VFS_STREAMFILE *streamfile, char *buffer, size_t length) {
-    strncpy(buffer, streamfile->name, length);
-    buffer[length - 1] = '\0';
+static void *open_vfs_handle(void *handle, const char *path) {
+    return open_vfs_file(path);
 }
 
-static STREAMFILE *open_vfs_impl(VFS_STREAMFILE *streamfile, const char *const filename, size_t buffersize) {
-    if (!filename)
-        return NULL;
-
-    return open_vfs(filename);
+static void close_vfs(void *handle) {
+    delete (VFSFile *)handle; //fcloses the internal file too
 }
 
-STREAMFILE *open_vfs_by_VFSFILE(VFSFile *file, const char *path) {
-    VFS_STREAMFILE *streamfile = (VFS_STREAMFILE *)malloc(sizeof(VFS_STREAMFILE));
-    if (!streamfile)
-        return NULL;
-
-    // success, set our pointers
-    memset(streamfile, 0, sizeof(VFS_STREAMFILE));
-
-    streamfile->sf.read = (size_t (*)(STREAMFILE *, uint8_t *, off_t, size_t))read_vfs;
-    streamfile->sf.get_size = (size_t (*)(STREAMFILE *))get_size_vfs;
-    streamfile->sf.get_offset = (off_t (*)(STREAMFILE *))get_offset_vfs;
-    streamfile->sf.get_name = (void (*)(STREAMFILE *, char *, size_t))get_name_vfs;
-    streamfile->sf.open = (STREAMFILE *(*)(STREAMFILE *, const char *, size_t))open_vfs_impl;
-    streamfile->sf.close = (void (*)(STREAMFILE *))close_vfs;
-
-    streamfile->vfsFile = file;
-    streamfile->offset = 0;
-    strncpy(streamfile->name, path, sizeof(streamfile->name));
-    streamfile->name[sizeof(streamfile->name) - 1] = '\0';
-
-    // for reference, actual file path ("name" has protocol path, file://...).
-    // name should work for all situations but in case it's needed again maybe
-    // get_name should always return realname, as it's used to open companion VFSFiles
-    //{
-    //    gchar *realname = g_filename_from_uri(path, NULL, NULL);
-    //    strncpy(streamfile->realname, realname, sizeof(streamfile->realname));
-    //    streamfile->realname[sizeof(streamfile->realname) - 1] = '\0';
-    //    g_free(realname);
-    //}
-
-    return &streamfile->sf;
-}
+static const host_streamfile_io_t vfs_io = {
+    seek_vfs,
+    read_vfs,
+    get_size_vfs,
+    open_vfs_handle,
+    close_vfs,
+    NULL,
+    NULL,
+};
 
+// "path" has the protocol (file://...), and works for all situations as it's also used
+// to open companion VFSFiles
 STREAMFILE *open_vfs(const char *path) {
-    VFSFile *vfsFile = new VFSFile(path, "rb");
-    if (!vfsFile || !*vfsFile) {
-        delete vfsFile;
+    void *vfsFile = open_vfs_file(path);
+    if (!vfsFile)
         return NULL;
-    }
 
-    return open_vfs_by_VFSFILE(vfsFile, path);
+    return open_host_streamfile(vfsFile, path, &vfs_io, 0);
 }
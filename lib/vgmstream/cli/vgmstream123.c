@@ -34,9 +34,12 @@
 # include <signal.h>
 # include <unistd.h>
 # include <sys/wait.h>
+# include <pthread.h>
+# define DECODE_AHEAD_THREAD
 #endif
 
 #include "../src/vgmstream.h"
+#include "../src/plugins.h"
 
 #ifndef VERSION
 # include "version.h"
@@ -78,9 +81,10 @@ struct params {
     double fade_time;
     double fade_delay;
     int stream_index;
+    double start_time;
 };
 
-#define DEFAULT_PARAMS { 2, -1, 10.0, 0.0, 0 }
+#define DEFAULT_PARAMS { 2, -1, 10.0, 0.0, 0, 0.0 }
 
 static const char *out_filename = NULL;
 static int driver_id;
@@ -88,10 +92,11 @@ static ao_device *device = NULL;
 static ao_option *device_options = NULL;
 static ao_sample_format current_sample_format;
 
-static sample_t *buffer = NULL;
 /* reportedly 1kb helps Raspberry Pi Zero play FFmpeg formats without stuttering
  * (presumably other low powered devices too), plus it's the default in other plugins */
 static int buffer_size_kb = 1;
+/* audio decoded ahead of the device, covers slow decodes (0 = decode right before playing) */
+static int latency_ms = 250;
 
 static int repeat = 0;
 static int verbose = 0;
@@ -161,6 +166,8 @@ static void usage(const char *progname) {
         "    -o KEY:VAL  Pass option KEY with value VAL to the output driver\n"
         "                (see https://www.xiph.org/ao/doc/drivers.html)\n"
         "    -b N        Use an audio buffer of N kilobytes [%d]\n"
+        "    -l MS       Decode up to MS milliseconds ahead of the device, 0 disables [%d]\n"
+        "    -t TIME     Start playback at TIME seconds\n"
         "    -@ LSTFILE  Read playlist from LSTFILE\n"
         "    -h          Print this help\n"
         "    -r          Repeat playback indefinitely\n"
@@ -177,6 +184,7 @@ static void usage(const char *progname) {
         "playlist referring to same. This program supports the \"EXT-X-VGMSTREAM\" tag\n"
         "in playlists, and files compressed with gzip/bzip2/xz.\n",
         buffer_size_kb,
+        latency_ms,
         default_par.stream_index,
         default_par.loop_count,
         default_par.fade_time,
@@ -235,21 +243,191 @@ static int set_sample_format(VGMSTREAM *vgms) {
     return 0;
 }
 
+/* Decode ahead: a thread renders chunks into a ring of slots while the main
+ * thread writes finished ones to the device, so a slow decode is covered by
+ * the latency target instead of stalling audio. Without threads (or with a
+ * latency of 0) chunks are rendered right before being played.
+ */
+typedef struct {
+    vgmstream_player *player;
+    int channels;
+    int32_t slot_samples;
+    int slot_count;
+    sample_t *slots;            /* slot_count * slot_samples * channels */
+    int32_t *slot_done;         /* samples rendered in each slot, less than slot_samples at the end */
+    long write_count;           /* slots rendered so far */
+    long read_count;            /* slots played so far */
+    int end;
+    int stop;
+    int underruns;
+#ifdef DECODE_AHEAD_THREAD
+    int threaded;
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+#endif
+} decode_ahead_t;
+
+static void render_slot(decode_ahead_t *da, long count) {
+    int slot = count % da->slot_count;
+    sample_t *buf = da->slots + (size_t)slot * da->slot_samples * da->channels;
+
+    da->slot_done[slot] = vgmstream_player_render(da->player, buf, da->slot_samples);
+}
+
+#ifdef DECODE_AHEAD_THREAD
+static void *decode_ahead_thread(void *data) {
+    decode_ahead_t *da = data;
+
+    pthread_mutex_lock(&da->mutex);
+    while (!da->stop && !da->end) {
+        long count;
+
+        if (da->write_count - da->read_count >= da->slot_count) {
+            pthread_cond_wait(&da->cond, &da->mutex);
+            continue;
+        }
+
+        /* the slot isn't touched by the main thread until write_count moves past it */
+        count = da->write_count;
+        pthread_mutex_unlock(&da->mutex);
+        render_slot(da, count);
+        pthread_mutex_lock(&da->mutex);
+
+        if (da->slot_done[count % da->slot_count] < da->slot_samples)
+            da->end = 1;
+        da->write_count++;
+        pthread_cond_broadcast(&da->cond);
+    }
+    pthread_mutex_unlock(&da->mutex);
+
+    return NULL;
+}
+#endif
+
+static int decode_ahead_init(decode_ahead_t *da, vgmstream_player *player, int channels, int32_t slot_samples, int slot_count) {
+    memset(da, 0, sizeof(*da));
+    da->player = player;
+    da->channels = channels;
+    da->slot_samples = slot_samples;
+    da->slot_count = slot_count > 0 ? slot_count : 1;
+
+    da->slots = malloc((size_t)da->slot_count * slot_samples * channels * sizeof(sample_t));
+    da->slot_done = calloc(da->slot_count, sizeof(int32_t));
+    if (!da->slots || !da->slot_done) {
+        free(da->slots);
+        free(da->slot_done);
+        return -1;
+    }
+    return 0;
+}
+
+/* Starts filling the ring (after any seek, so the first chunks are already at the target) */
+static void decode_ahead_start(decode_ahead_t *da) {
+#ifdef DECODE_AHEAD_THREAD
+    if (da->slot_count < 2)
+        return;
+
+    pthread_mutex_init(&da->mutex, NULL);
+    pthread_cond_init(&da->cond, NULL);
+    da->threaded = !pthread_create(&da->thread, NULL, decode_ahead_thread, da);
+    if (!da->threaded) {
+        pthread_cond_destroy(&da->cond);
+        pthread_mutex_destroy(&da->mutex);
+    }
+#endif
+}
+
+/* Returns the next rendered chunk (samples in *samples, 0 at the end), waiting for it if needed */
+static sample_t *decode_ahead_read(decode_ahead_t *da, int32_t *samples) {
+    int slot = da->read_count % da->slot_count;
+
+#ifdef DECODE_AHEAD_THREAD
+    if (da->threaded) {
+        pthread_mutex_lock(&da->mutex);
+        if (da->write_count == da->read_count && !da->end && da->read_count > 0)
+            da->underruns++;
+        while (da->write_count == da->read_count && !da->end)
+            pthread_cond_wait(&da->cond, &da->mutex);
+        *samples = da->write_count > da->read_count ? da->slot_done[slot] : 0;
+        pthread_mutex_unlock(&da->mutex);
+
+        return da->slots + (size_t)slot * da->slot_samples * da->channels;
+    }
+#endif
+
+    if (da->end) {
+        *samples = 0;
+    }
+    else {
+        render_slot(da, da->read_count);
+        *samples = da->slot_done[slot];
+        if (*samples < da->slot_samples)
+            da->end = 1;
+    }
+    return da->slots + (size_t)slot * da->slot_samples * da->channels;
+}
+
+/* Frees the chunk returned by decode_ahead_read so the thread can render into it */
+static void decode_ahead_release(decode_ahead_t *da) {
+#ifdef DECODE_AHEAD_THREAD
+    if (da->threaded) {
+        pthread_mutex_lock(&da->mutex);
+        da->read_count++;
+        pthread_cond_broadcast(&da->cond);
+        pthread_mutex_unlock(&da->mutex);
+        return;
+    }
+#endif
+    da->read_count++;
+}
+
+static void decode_ahead_close(decode_ahead_t *da) {
+#ifdef DECODE_AHEAD_THREAD
+    if (da->threaded) {
+        pthread_mutex_lock(&da->mutex);
+        da->stop = 1;
+        pthread_cond_broadcast(&da->cond);
+        pthread_mutex_unlock(&da->mutex);
+
+        pthread_join(da->thread, NULL);
+        pthread_cond_destroy(&da->cond);
+        pthread_mutex_destroy(&da->mutex);
+        da->threaded = 0;
+    }
+#endif
+    free(da->slots);
+    free(da->slot_done);
+    da->slots = NULL;
+    da->slot_done = NULL;
+}
+
 static int play_vgmstream(const char *filename, struct params *par) {
     int ret = 0;
     STREAMFILE *sf;
     VGMSTREAM *vgms;
     FILE *save_fps[4];
     int loop_count;
-    int64_t total_samples;
-    size_t buffer_size;
-    int64_t buffer_samples;
-    int64_t fade_time_samples, fade_start;
+    vgmstream_cfg_t vcfg = {0};
+    vgmstream_player_cfg pcfg = {0};
+    vgmstream_player *player = NULL;
+    decode_ahead_t da;
+    int32_t total_samples, fade_start;
+    int32_t buffer_samples;
+    int slot_count;
     int time_total_min;
     double time_total_sec;
     int64_t s;
+    struct timeval tv_start = { 0, 0 };
     int i;
 
+    if (buffer_size_kb < 1) {
+        fprintf(stderr, "Invalid buffer size '%d'\n", buffer_size_kb);
+        return -1;
+    }
+
+    gettimeofday(&tv_start, NULL);
+
     sf = open_stdio_streamfile(filename);
     if (!sf) {
         fprintf(stderr, "%s: cannot open file\n", filename);
@@ -311,7 +489,20 @@ static int play_vgmstream(const char *filename, struct params *par) {
         if (loop_count < 1) loop_count = 1;
     }
 
-    total_samples = get_vgmstream_play_samples(loop_count, par->fade_time, par->fade_delay, vgms);
+    /* loops, fades and the end are done by the player, which also seeks from checkpoints */
+    vcfg.loop_count = loop_count;
+    vcfg.fade_time = par->fade_time;
+    vcfg.fade_delay = par->fade_delay;
+    pcfg.play_cfg = &vcfg;
+    pcfg.checkpoint_seconds = 10;
+    player = vgmstream_player_init(vgms, &pcfg);
+    if (!player) {
+        ret = -1;
+        goto fail;
+    }
+
+    total_samples = vgmstream_player_get_length(player);
+    fade_start = vgms->pstate.fade_samples > 0 ? vgms->pstate.fade_start : total_samples;
 
     {
         double total = (double)total_samples / vgms->sample_rate;
@@ -319,48 +510,45 @@ static int play_vgmstream(const char *filename, struct params *par) {
         time_total_sec = total - 60 * time_total_min;
     }
 
-    /* Buffer size in bytes
+    /* Buffer size in samples, each slot of the decode ahead ring holds one
      */
-    buffer_size = 1024 * buffer_size_kb;
-
-    if (!buffer) {
-        if (buffer_size_kb < 1) {
-            fprintf(stderr, "Invalid buffer size '%d'\n", buffer_size_kb);
-            return -1;
-        }
-
-        buffer = malloc(buffer_size);
-        if (!buffer) goto fail;
+    buffer_samples = 1024 * buffer_size_kb / (vgms->channels * sizeof(sample));
+    if (buffer_samples < 1)
+        buffer_samples = 1;
+
+#ifdef DECODE_AHEAD_THREAD
+    slot_count = (int)((int64_t)vgms->sample_rate * latency_ms / 1000 / buffer_samples);
+    if (latency_ms > 0 && slot_count < 2)
+        slot_count = 2;
+#else
+    slot_count = 1;
+#endif
+    if (decode_ahead_init(&da, player, vgms->channels, buffer_samples, slot_count)) {
+        ret = -1;
+        goto fail;
     }
 
-    buffer_samples = buffer_size / (vgms->channels * sizeof(sample));
+    /* seeking first means the ring starts filling at the target */
+    if (par->start_time > 0)
+        vgmstream_player_seek(player, (int32_t)(par->start_time * vgms->sample_rate));
+    s = vgmstream_player_get_position(player);
 
-    fade_time_samples = (int64_t)(par->fade_time * vgms->sample_rate);
-    fade_start = total_samples - fade_time_samples;
-    if (fade_start < 0)
-        fade_start = total_samples;
+    decode_ahead_start(&da);
 
-    for (s = 0; s < total_samples && !interrupted; s += buffer_samples) {
-        int64_t buffer_used_samples = MIN(buffer_samples, total_samples - s);
+    while (!interrupted) {
+        int32_t buffer_used_samples;
+        sample_t *buffer = decode_ahead_read(&da, &buffer_used_samples);
         char *suffix = "";
 
-        render_vgmstream(buffer, buffer_used_samples, vgms);
+        if (buffer_used_samples == 0)
+            break;
 
 #ifdef LITTLE_ENDIAN_OUTPUT
         swap_samples_le(buffer, vgms->channels * buffer_used_samples);
 #endif
 
-        if (vgms->loop_flag && fade_time_samples > 0 && s >= fade_start) {
-            /* Got to do the fade-out ourselves :p */
-            int64_t b;
-            for (b = 0; b < buffer_used_samples; b++) {
-                double factor = 1.0 - (double)(s + b - fade_start) / fade_time_samples;
-                int c;
-                for (c = 0; c < vgms->channels; c++)
-                    buffer[vgms->channels * b + c] *= factor;
-            }
+        if (s + buffer_used_samples > fade_start)
             suffix = " (fading)";
-        }
 
         if (verbose && !out_filename) {
             double played = (double)s / vgms->sample_rate;
@@ -388,8 +576,21 @@ static int play_vgmstream(const char *filename, struct params *par) {
             ret = -1;
             break;
         }
+        decode_ahead_release(&da);
+
+        /* time from opening the file to the first audio handed to the device */
+        if (verbose && da.read_count == 1) {
+            struct timeval tv = { 0, 0 };
+            gettimeofday(&tv, NULL);
+            printf("\rStart latency: %.1f ms\n",
+                (tv.tv_sec - tv_start.tv_sec) * 1000.0 + (tv.tv_usec - tv_start.tv_usec) / 1000.0);
+        }
+
+        s += buffer_used_samples;
     }
 
+    decode_ahead_close(&da);
+
     if (verbose && !ret) {
         /* Clear time status line */
         putchar('\r');
@@ -403,6 +604,9 @@ static int play_vgmstream(const char *filename, struct params *par) {
         printf("Wrote %02d:%05.2f of audio to %s\n\n",
             time_total_min, time_total_sec, out_filename);
 
+    if (verbose && da.underruns)
+        printf("Decoding fell behind %d times, try a higher latency (-l)\n\n", da.underruns);
+
     if (interrupted) {
         fputs("Playback terminated.\n\n", stdout);
         ret = record_interrupt();
@@ -411,6 +615,7 @@ static int play_vgmstream(const char *filename, struct params *par) {
 
     fail:
 
+    vgmstream_player_free(player);
     close_vgmstream(vgms);
 
     for (i = 0; i < 4; i++)
@@ -472,6 +677,8 @@ static int play_playlist(const char *filename, struct params *default_par) {
                     par.loop_count = atoi(arg);
                 else if (PARAM_MATCHES("STREAMINDEX"))
                     par.stream_index = atoi(arg);
+                else if (PARAM_MATCHES("STARTTIME"))
+                    par.start_time = atof(arg);
 
                 param = strtok(NULL, ",");
             }
@@ -639,7 +846,7 @@ again:
         memcpy(&par, &default_par, sizeof(par));
     }
 
-    while ((opt = getopt(argc, argv, "-D:F:L:M:S:b:d:f:o:@:hrv")) != -1) {
+    while ((opt = getopt(argc, argv, "-D:F:L:M:S:b:d:f:l:o:t:@:hrv")) != -1) {
         switch (opt) {
             case 1:
                 if (play_file(optarg, &par)) {
@@ -670,8 +877,13 @@ again:
                 par.stream_index = atoi(optarg);
                 break;
             case 'b':
-                if (!buffer)
-                    buffer_size_kb = atoi(optarg);
+                buffer_size_kb = atoi(optarg);
+                break;
+            case 'l':
+                latency_ms = atoi(optarg);
+                break;
+            case 't':
+                par.start_time = atof(optarg);
                 break;
             case 'd':
                 driver_id = ao_driver_id(optarg);
@@ -722,8 +934,6 @@ done:
 
     if (device)
         ao_close(device);
-    if (buffer)
-        free(buffer);
 
     ao_free_options(device_options);
     ao_shutdown();
@@ -0,0 +1,507 @@
+/* Seek latency benchmark: times forward, backward, random seeks and loop jumps for every file in a
+ * corpus and prints results as JSON lines (one per file, then one per coding+layout), to track which
+ * codecs/layouts still decode forward to seek. */
+#define POSIXLY_CORRECT
+#include <getopt.h>
+#include "../src/vgmstream.h"
+#include "../src/plugins.h"
+#include "../src/mixing.h"
+#include "../src/util.h"
+#include <sys/stat.h>
+#ifdef WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#include <dirent.h>
+#endif
+
+/* samples rendered per call, also max samples around the loop end for loop jumps */
+#define BENCH_BUFFER_SAMPLES 4096
+/* decode time of the baseline pass, enough for clock resolution */
+#define BENCH_MIN_DECODE_US 50000
+#define BENCH_MAX_DECODE_SECONDS 60
+/* forward/backward/loop tests are repeated and the fastest taken (less noise from other processes) */
+#define BENCH_REPEATS 3
+
+/* getopt globals (the horror...) */
+extern char * optarg;
+extern int optind, opterr, optopt;
+
+
+static void usage(const char * name) {
+    fprintf(stderr,"vgmstream seek benchmark " __DATE__ "\n"
+            "Usage: %s [options] infile/folder ...\n"
+            "Options:\n"
+            "    -o outfile: write results to outfile, default stdout\n"
+            "    -n N: random seeks per file, default 20\n"
+            "    -r N: random seek seed, default 1\n"
+            "    -s N: select subsong N, if the format supports multiple subsongs\n"
+            "Prints a JSON object per line: \"file\" results, then \"summary\" per coding+layout.\n"
+            "Amplification is seek time divided by the time of decoding the skipped samples\n"
+            "(~1 = decodes forward, 0 = jumps directly, >1 = decodes extra, like from the start).\n"
+            , name);
+}
+
+typedef struct {
+    FILE* out;
+    int random_seeks;
+    uint32_t seed;
+    int stream_index;
+} bench_config;
+
+/* results of one file, times in us (<0 if not tested) */
+typedef struct {
+    double decode_ns; /* per sample, decoding forward */
+    double forward_us;
+    double forward_amp;
+    double backward_us;
+    double backward_amp;
+    double random_us;
+    double random_max_us;
+    double random_amp;
+    double loop_us; /* extra time rendering over the loop end */
+} bench_result;
+
+/* added results of all files with the same coding+layout */
+typedef struct {
+    coding_t coding_type;
+    layout_t layout_type;
+    char coding[128];
+    int files;
+    bench_result total;
+    int forward_count;
+    int backward_count;
+    int random_count;
+    int random_amp_count;
+    int loop_count;
+} bench_group;
+
+typedef struct {
+    bench_config* cfg;
+    bench_group* groups;
+    int group_count;
+    int group_size;
+    int tested;
+    int failed;
+} bench_report;
+
+
+static void render_samples(VGMSTREAM* vgmstream, sample_t* buf, int32_t samples) {
+    while (samples > 0) {
+        int32_t samples_to_do = samples > BENCH_BUFFER_SAMPLES ? BENCH_BUFFER_SAMPLES : samples;
+        render_vgmstream(buf, samples_to_do, vgmstream);
+        samples -= samples_to_do;
+    }
+}
+
+/* fastest seek from one position to another */
+static double time_seek(VGMSTREAM* vgmstream, int32_t from, int32_t to) {
+    double best = -1;
+    int i;
+
+    for (i = 0; i < BENCH_REPEATS; i++) {
+        uint64_t time_start;
+        double time_us;
+
+        seek_vgmstream(vgmstream, from);
+        time_start = get_streamfile_time_us();
+        seek_vgmstream(vgmstream, to);
+        time_us = (double)(get_streamfile_time_us() - time_start);
+        if (best < 0 || time_us < best)
+            best = time_us;
+    }
+    return best;
+}
+
+/* seek time vs decoding the skipped samples */
+static double get_amplification(double time_us, double decode_ns, int32_t distance) {
+    if (decode_ns <= 0 || distance <= 0)
+        return -1;
+    return (time_us * 1000.0 / decode_ns) / distance;
+}
+
+static int bench_file(bench_config* cfg, VGMSTREAM* vgmstream, bench_result* res) {
+    sample_t* buf = NULL;
+    int32_t limit, decode_samples;
+    int input_channels, output_channels;
+    uint64_t time_start, decode_us = 0;
+    int64_t decoded = 0;
+    int i;
+
+    res->decode_ns = res->forward_us = res->forward_amp = res->backward_us = res->backward_amp = -1;
+    res->random_us = res->random_max_us = res->random_amp = res->loop_us = -1;
+
+    input_channels = output_channels = vgmstream->channels;
+    mixing_info(vgmstream, &input_channels, &output_channels);
+    buf = malloc(sizeof(sample_t) * BENCH_BUFFER_SAMPLES * (input_channels > output_channels ? input_channels : output_channels));
+    if (!buf) goto fail;
+
+    /* seeks past the first loop end are later loops */
+    limit = vgmstream->loop_flag ? vgmstream->loop_end_sample : vgmstream->num_samples;
+    if (limit <= 0) goto fail;
+
+    /* baseline: time per sample decoding forward (several passes for short files) */
+    decode_samples = limit;
+    if (decode_samples > vgmstream->sample_rate * BENCH_MAX_DECODE_SECONDS)
+        decode_samples = vgmstream->sample_rate * BENCH_MAX_DECODE_SECONDS;
+    for (i = 0; i < 100 && decode_us < BENCH_MIN_DECODE_US; i++) {
+        reset_vgmstream(vgmstream);
+        time_start = get_streamfile_time_us();
+        render_samples(vgmstream, buf, decode_samples);
+        decode_us += get_streamfile_time_us() - time_start;
+        decoded += decode_samples;
+    }
+    res->decode_ns = decode_us * 1000.0 / decoded;
+
+    /* forward/backward: between 1/4 and 1/2 of the stream */
+    {
+        int32_t pos1 = limit / 4, pos2 = limit / 2;
+
+        res->forward_us = time_seek(vgmstream, pos1, pos2);
+        res->forward_amp = get_amplification(res->forward_us, res->decode_ns, pos2 - pos1);
+        res->backward_us = time_seek(vgmstream, pos2, pos1);
+        res->backward_amp = get_amplification(res->backward_us, res->decode_ns, pos2 - pos1);
+    }
+
+    /* random: from wherever the last seek was */
+    if (cfg->random_seeks > 0) {
+        uint32_t seed = cfg->seed;
+        int32_t current;
+        double total_us = 0, max_us = 0, decode_total = 0;
+        int64_t distance_total = 0;
+
+        seek_vgmstream(vgmstream, 0);
+        current = 0;
+        for (i = 0; i < cfg->random_seeks; i++) {
+            int32_t target;
+            double time_us;
+
+            seed = seed * 1103515245 + 12345;
+            target = (int32_t)((uint64_t)(seed >> 8) * limit >> 24);
+
+            time_start = get_streamfile_time_us();
+            seek_vgmstream(vgmstream, target);
+            time_us = (double)(get_streamfile_time_us() - time_start);
+
+            total_us += time_us;
+            if (time_us > max_us)
+                max_us = time_us;
+            if (res->decode_ns > 0)
+                decode_total += time_us * 1000.0 / res->decode_ns;
+            distance_total += target > current ? target - current : current - target;
+            current = target;
+        }
+
+        res->random_us = total_us / cfg->random_seeks;
+        res->random_max_us = max_us;
+        res->random_amp = distance_total > 0 && res->decode_ns > 0 ? decode_total / distance_total : -1;
+    }
+
+    /* loop jump: render around loop end, minus what decoding those samples takes */
+    if (vgmstream->loop_flag && vgmstream->loop_end_sample > vgmstream->loop_start_sample) {
+        int32_t window = BENCH_BUFFER_SAMPLES / 2;
+        double best = -1;
+
+        if (window > vgmstream->loop_end_sample - vgmstream->loop_start_sample)
+            window = vgmstream->loop_end_sample - vgmstream->loop_start_sample;
+        if (window > vgmstream->loop_end_sample)
+            window = vgmstream->loop_end_sample;
+
+        for (i = 0; i < BENCH_REPEATS; i++) {
+            double time_us;
+
+            seek_vgmstream(vgmstream, vgmstream->loop_end_sample - window);
+            time_start = get_streamfile_time_us();
+            render_samples(vgmstream, buf, window * 2);
+            time_us = (double)(get_streamfile_time_us() - time_start) - window * 2 * res->decode_ns / 1000.0;
+            if (best < 0 || time_us < best)
+                best = time_us;
+        }
+        res->loop_us = best < 0 ? 0 : best;
+    }
+
+    free(buf);
+    return 1;
+fail:
+    free(buf);
+    return 0;
+}
+
+/* ************************************************************ */
+
+static void print_string(FILE* out, const char* str) {
+    fputc('"', out);
+    for (; *str; str++) {
+        unsigned char c = *str;
+        if (c == '"' || c == '\\')
+            fprintf(out, "\\%c", c);
+        else if (c < 0x20)
+            fprintf(out, "\\u%04x", c);
+        else
+            fputc(c, out);
+    }
+    fputc('"', out);
+}
+
+static void print_value(FILE* out, const char* name, double value) {
+    if (value < 0)
+        fprintf(out, ",\"%s\":null", name);
+    else
+        fprintf(out, ",\"%s\":%.3f", name, value);
+}
+
+static void print_results(FILE* out, const bench_result* res) {
+    print_value(out, "decode_ns_per_sample", res->decode_ns);
+    print_value(out, "forward_us", res->forward_us);
+    print_value(out, "forward_amp", res->forward_amp);
+    print_value(out, "backward_us", res->backward_us);
+    print_value(out, "backward_amp", res->backward_amp);
+    print_value(out, "random_us", res->random_us);
+    print_value(out, "random_max_us", res->random_max_us);
+    print_value(out, "random_amp", res->random_amp);
+    print_value(out, "loop_us", res->loop_us);
+}
+
+static void print_names(FILE* out, const char* coding, coding_t coding_type, layout_t layout_type) {
+    const char* layout = get_vgmstream_layout_name(layout_type);
+
+    fprintf(out, ",\"coding\":");
+    print_string(out, coding);
+    fprintf(out, ",\"coding_id\":%i,\"layout\":", (int)coding_type);
+    print_string(out, layout ? layout : "unknown");
+    fprintf(out, ",\"layout_id\":%i", (int)layout_type);
+}
+
+static void add_value(double* total, int* count, double value) {
+    if (value < 0)
+        return;
+    *total += value;
+    (*count)++;
+}
+
+static int add_group(bench_report* report, VGMSTREAM* vgmstream, const char* coding, const bench_result* res) {
+    bench_group* group = NULL;
+    int i;
+
+    for (i = 0; i < report->group_count; i++) {
+        if (report->groups[i].coding_type == vgmstream->coding_type &&
+                report->groups[i].layout_type == vgmstream->layout_type) {
+            group = &report->groups[i];
+            break;
+        }
+    }
+
+    if (!group) {
+        if (report->group_count + 1 > report->group_size) {
+            int size = report->group_size ? report->group_size * 2 : 16;
+            bench_group* groups_re = realloc(report->groups, sizeof(bench_group) * size);
+            if (!groups_re) return 0;
+            report->groups = groups_re;
+            report->group_size = size;
+        }
+        group = &report->groups[report->group_count];
+        report->group_count++;
+
+        memset(group, 0, sizeof(bench_group));
+        group->coding_type = vgmstream->coding_type;
+        group->layout_type = vgmstream->layout_type;
+        snprintf(group->coding, sizeof(group->coding), "%s", coding);
+    }
+
+    group->files++;
+    group->total.decode_ns += res->decode_ns;
+    group->total.forward_us += res->forward_us;
+    add_value(&group->total.forward_amp, &group->forward_count, res->forward_amp);
+    group->total.backward_us += res->backward_us;
+    add_value(&group->total.backward_amp, &group->backward_count, res->backward_amp);
+    if (res->random_us >= 0) {
+        group->total.random_us += res->random_us;
+        if (res->random_max_us > group->total.random_max_us)
+            group->total.random_max_us = res->random_max_us;
+        group->random_count++;
+    }
+    add_value(&group->total.random_amp, &group->random_amp_count, res->random_amp);
+    add_value(&group->total.loop_us, &group->loop_count, res->loop_us);
+    return 1;
+}
+
+/* averages of each group (max for random_max_us) */
+static void print_groups(bench_report* report) {
+    FILE* out = report->cfg->out;
+    int i;
+
+    for (i = 0; i < report->group_count; i++) {
+        bench_group* group = &report->groups[i];
+        bench_result avg;
+
+        avg.decode_ns = group->total.decode_ns / group->files;
+        avg.forward_us = group->total.forward_us / group->files;
+        avg.forward_amp = group->forward_count ? group->total.forward_amp / group->forward_count : -1;
+        avg.backward_us = group->total.backward_us / group->files;
+        avg.backward_amp = group->backward_count ? group->total.backward_amp / group->backward_count : -1;
+        avg.random_us = group->random_count ? group->total.random_us / group->random_count : -1;
+        avg.random_max_us = group->random_count ? group->total.random_max_us : -1;
+        avg.random_amp = group->random_amp_count ? group->total.random_amp / group->random_amp_count : -1;
+        avg.loop_us = group->loop_count ? group->total.loop_us / group->loop_count : -1;
+
+        fprintf(out, "{\"type\":\"summary\"");
+        print_names(out, group->coding, group->coding_type, group->layout_type);
+        fprintf(out, ",\"files\":%i", group->files);
+        print_results(out, &avg);
+        fprintf(out, "}\n");
+    }
+}
+
+static void bench_path_file(bench_report* report, const char* filename) {
+    bench_config* cfg = report->cfg;
+    STREAMFILE* sf;
+    VGMSTREAM* vgmstream;
+    bench_result res;
+    char coding[128];
+
+    sf = open_stdio_streamfile(filename);
+    if (!sf) {
+        fprintf(stderr,"file %s not found\n",filename);
+        report->failed++;
+        return;
+    }
+    sf->stream_index = cfg->stream_index;
+    vgmstream = init_vgmstream_from_STREAMFILE(sf);
+    close_streamfile(sf);
+    if (!vgmstream) {
+        report->failed++;
+        return;
+    }
+
+    if (!bench_file(cfg, vgmstream, &res)) {
+        fprintf(stderr,"failed testing %s\n",filename);
+        report->failed++;
+        close_vgmstream(vgmstream);
+        return;
+    }
+
+    coding[0] = '\0';
+    get_vgmstream_coding_description(vgmstream, coding, sizeof(coding));
+    coding[sizeof(coding) - 1] = '\0';
+
+    fprintf(cfg->out, "{\"type\":\"file\",\"file\":");
+    print_string(cfg->out, filename);
+    print_names(cfg->out, coding, vgmstream->coding_type, vgmstream->layout_type);
+    fprintf(cfg->out, ",\"channels\":%i,\"sample_rate\":%i,\"num_samples\":%i,\"loop_start\":%i,\"loop_end\":%i",
+            vgmstream->channels, vgmstream->sample_rate, vgmstream->num_samples,
+            vgmstream->loop_flag ? vgmstream->loop_start_sample : -1, vgmstream->loop_flag ? vgmstream->loop_end_sample : -1);
+    print_results(cfg->out, &res);
+    fprintf(cfg->out, "}\n");
+    fflush(cfg->out);
+
+    report->tested++;
+    add_group(report, vgmstream, coding, &res);
+    close_vgmstream(vgmstream);
+}
+
+static void bench_path(bench_report* report, const char* path) {
+    char subpath[PATH_LIMIT];
+    struct stat st;
+
+    if (stat(path, &st) != 0 || !(st.st_mode & S_IFDIR)) {
+        bench_path_file(report, path);
+        return;
+    }
+
+#ifdef WIN32
+    {
+        struct _finddata_t data;
+        intptr_t handle;
+
+        snprintf(subpath, sizeof(subpath), "%s\\*", path);
+        handle = _findfirst(subpath, &data);
+        if (handle == -1)
+            return;
+        do {
+            if (strcmp(data.name, ".") == 0 || strcmp(data.name, "..") == 0)
+                continue;
+            snprintf(subpath, sizeof(subpath), "%s\\%s", path, data.name);
+            bench_path(report, subpath);
+        } while (_findnext(handle, &data) == 0);
+        _findclose(handle);
+    }
+#else
+    {
+        DIR* dir;
+        struct dirent* entry;
+
+        dir = opendir(path);
+        if (!dir)
+            return;
+        while ((entry = readdir(dir)) != NULL) {
+            if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+                continue;
+            snprintf(subpath, sizeof(subpath), "%s/%s", path, entry->d_name);
+            bench_path(report, subpath);
+        }
+        closedir(dir);
+    }
+#endif
+}
+
+
+int main(int argc, char ** argv) {
+    bench_config cfg = {0};
+    bench_report report = {0};
+    const char* outfilename = NULL;
+    int opt, i;
+
+    cfg.random_seeks = 20;
+    cfg.seed = 1;
+
+    opterr = 0;
+    while ((opt = getopt(argc, argv, "o:n:r:s:h")) != -1) {
+        switch (opt) {
+            case 'o':
+                outfilename = optarg;
+                break;
+            case 'n':
+                cfg.random_seeks = atoi(optarg);
+                break;
+            case 'r':
+                cfg.seed = (uint32_t)strtoul(optarg, NULL, 10);
+                break;
+            case 's':
+                cfg.stream_index = atoi(optarg);
+                break;
+            case '?':
+                fprintf(stderr, "Unknown option -%c found\n", optopt);
+                return EXIT_FAILURE;
+            default:
+                usage(argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    if (optind >= argc) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    cfg.out = stdout;
+    if (outfilename) {
+        cfg.out = fopen(outfilename, "w");
+        if (!cfg.out) {
+            fprintf(stderr,"failed to open %s for output\n",outfilename);
+            return EXIT_FAILURE;
+        }
+    }
+
+    report.cfg = &cfg;
+    for (i = optind; i < argc; i++) {
+        bench_path(&report, argv[i]);
+    }
+    print_groups(&report);
+
+    fprintf(stderr, "files: %i tested, %i failed\n", report.tested, report.failed);
+
+    if (cfg.out != stdout)
+        fclose(cfg.out);
+    free(report.groups);
+    return EXIT_SUCCESS;
+}
@@ -2,12 +2,17 @@
 #include <getopt.h>
 #include "../src/vgmstream.h"
 #include "../src/plugins.h"
+#include "../src/mixing.h"
 #include "../src/util.h"
+#include <sys/stat.h>
 #ifdef WIN32
 #include <io.h>
 #include <fcntl.h>
+#include <windows.h>
 #else
 #include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
 #endif
 
 #ifndef STDOUT_FILENO
@@ -25,6 +30,9 @@
  * may improve write I/O in some systems as this*channels doubles as output buffer */
 #define SAMPLE_BUFFER_SIZE  32768
 
+#define BATCH_THREADS_MAX   64
+#define BATCH_BUFFER_POOL   0x200000 /* streamfile buffers kept between batch items */
+
 /* getopt globals (the horror...) */
 extern char * optarg;
 extern int optind, opterr, optopt;
@@ -45,15 +53,19 @@ static void usage(const char * name, int is_full) {
             "    -e: force end-to-end looping\n"
             "    -E: force end-to-end looping even if file has real loop points\n"
             "    -s N: select subsong N, if the format supports multiple subsongs\n"
+            "    -S N: extract subsongs -s N (or first) to N (0 = last) to file#N.wav, in parallel with -j\n"
             "    -m: print metadata only, don't decode\n"
             "    -L: append a smpl chunk and create a looping wav\n"
             "    -2 N: only output the Nth (first is 0) set of stereo channels\n"
             "    -p: output to stdout (for piping into another program)\n"
             "    -P: output to stdout even if stdout is a terminal\n"
             "    -c: loop forever (continuously) to stdout\n"
+            "    -R: output raw 16-bit PCM (little endian) without a .wav header\n"
             "    -x: decode and print adxencd command line to encode as ADX\n"
             "    -g: decode and print oggenc command line to encode as OGG\n"
             "    -b: decode and print batch variable commands\n"
+            "    -j N: batch mode, decode every file in infile (a folder, recursively, or a @list.txt\n"
+            "        with a file or folder per line) to file.wav using N threads\n"
             "    -h: print extra commands\n"
             , name);
     if (is_full) {
@@ -62,6 +74,10 @@ static void usage(const char * name, int is_full) {
                 "    -k N: seeks to N samples before decoding (for seek testing)\n"
                 "    -t file: print tags found in file (for tag testing)\n"
                 "    -O: decode but don't write to file (for performance testing)\n"
+                "    -D: only detect infile (file or folder, recursively) and print time used\n"
+                "        by each detection function (for format order/performance testing)\n"
+                "    -B: decode infile (file or folder, recursively) without writing and print speed per\n"
+                "        file, coding, layout and meta, split in detection/decode/layout/mix time\n"
                 );
     }
 }
@@ -72,9 +88,12 @@ typedef struct {
     char * outfilename;
     char * tag_filename;
     int decode_only;
+    int profile_detection;
+    int benchmark;
     int play_forever;
     int play_sdtout;
     int play_wreckless;
+    int write_raw;
     int print_metaonly;
     int print_adxencd;
     int print_oggenc;
@@ -83,6 +102,9 @@ typedef struct {
     int write_lwav;
     int only_stereo;
     int stream_index;
+    int batch_threads;
+    int extract_subsongs;
+    int subsong_end;
 
     double loop_count;
     double fade_time;
@@ -112,7 +134,7 @@ static int parse_config(cli_config *cfg, int argc, char ** argv) {
     opterr = 0;
 
     /* read config */
-    while ((opt = getopt(argc, argv, "o:l:f:d:ipPcmxeLEFrgb2:s:t:k:hO")) != -1) {
+    while ((opt = getopt(argc, argv, "o:l:f:d:ipPcmxeLEFrgb2:s:S:t:k:hODBj:R")) != -1) {
         switch (opt) {
             case 'o':
                 cfg->outfilename = optarg;
@@ -139,6 +161,9 @@ static int parse_config(cli_config *cfg, int argc, char ** argv) {
             case 'c':
                 cfg->play_forever = 1;
                 break;
+            case 'R':
+                cfg->write_raw = 1;
+                break;
             case 'm':
                 cfg->print_metaonly = 1;
                 break;
@@ -172,6 +197,10 @@ static int parse_config(cli_config *cfg, int argc, char ** argv) {
             case 's':
                 cfg->stream_index = atoi(optarg);
                 break;
+            case 'S':
+                cfg->extract_subsongs = 1;
+                cfg->subsong_end = atoi(optarg);
+                break;
             case 't':
                 cfg->tag_filename= optarg;
                 break;
@@ -181,6 +210,15 @@ static int parse_config(cli_config *cfg, int argc, char ** argv) {
             case 'O':
                 cfg->decode_only = 1;
                 break;
+            case 'D':
+                cfg->profile_detection = 1;
+                break;
+            case 'B':
+                cfg->benchmark = 1;
+                break;
+            case 'j':
+                cfg->batch_threads = atoi(optarg);
+                break;
             case 'h':
                 usage(argv[0], 1);
                 goto fail;
@@ -215,6 +253,10 @@ static int validate_config(cli_config *cfg) {
         fprintf(stderr,"-c must use -p or -P\n");
         goto fail;
     }
+    if (cfg->write_raw && cfg->write_lwav) {
+        fprintf(stderr,"-R and -L are incompatible\n");
+        goto fail;
+    }
     if (cfg->ignore_loop && cfg->force_loop) {
         fprintf(stderr,"-e and -i are incompatible\n");
         goto fail;
@@ -231,9 +273,169 @@ static int validate_config(cli_config *cfg) {
         fprintf(stderr,"either -p or -o, make up your mind\n");
         goto fail;
     }
+    if (cfg->batch_threads < 0 || cfg->batch_threads > BATCH_THREADS_MAX) {
+        fprintf(stderr,"-j must be between 1 and %i\n", BATCH_THREADS_MAX);
+        goto fail;
+    }
+    if (cfg->extract_subsongs && cfg->subsong_end < 0) {
+        fprintf(stderr,"-S must be 0 (last subsong) or more\n");
+        goto fail;
+    }
+    if ((cfg->batch_threads || cfg->extract_subsongs) && (cfg->play_sdtout || cfg->outfilename || cfg->tag_filename || cfg->test_reset || cfg->profile_detection
+            || cfg->print_metaonly || cfg->print_adxencd || cfg->print_oggenc || cfg->print_batchvar)) {
+        fprintf(stderr,"-j/-S only write file.wav for each file (or decode with -O), other outputs can't be used\n");
+        goto fail;
+    }
+    if (cfg->benchmark && (cfg->play_sdtout || cfg->outfilename || cfg->tag_filename || cfg->test_reset || cfg->profile_detection
+            || cfg->batch_threads || cfg->extract_subsongs || cfg->print_metaonly || cfg->print_adxencd || cfg->print_oggenc || cfg->print_batchvar)) {
+        fprintf(stderr,"-B only prints speed, other outputs can't be used\n");
+        goto fail;
+    }
+
+    return 1;
+fail:
+    return 0;
+}
+
+/* calls callback with every file in path, recursively (or just path if it's not a folder) */
+static void walk_path(const char* path, void (*callback)(void*, const char*), void* data) {
+    char subpath[PATH_LIMIT];
+    struct stat st;
+
+    if (stat(path, &st) != 0 || !(st.st_mode & S_IFDIR)) {
+        callback(data, path);
+        return;
+    }
+
+#ifdef WIN32
+    {
+        struct _finddata_t find;
+        intptr_t handle;
+
+        snprintf(subpath, sizeof(subpath), "%s\\*", path);
+        handle = _findfirst(subpath, &find);
+        if (handle == -1)
+            return;
+        do {
+            if (strcmp(find.name, ".") == 0 || strcmp(find.name, "..") == 0)
+                continue;
+            snprintf(subpath, sizeof(subpath), "%s\\%s", path, find.name);
+            walk_path(subpath, callback, data);
+        } while (_findnext(handle, &find) == 0);
+        _findclose(handle);
+    }
+#else
+    {
+        DIR* dir;
+        struct dirent* entry;
+
+        dir = opendir(path);
+        if (!dir)
+            return;
+        while ((entry = readdir(dir)) != NULL) {
+            if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+                continue;
+            snprintf(subpath, sizeof(subpath), "%s/%s", path, entry->d_name);
+            walk_path(subpath, callback, data);
+        }
+        closedir(dir);
+    }
+#endif
+}
+
+/* detection profile state, for all files found */
+typedef struct {
+    vgmstream_detection_profile_t* profile;
+    int profile_count;
+    int stream_index;
+    int files;
+    int detected;
+    uint64_t time_us;
+    uint64_t unsupported_time_us;
+} profile_report;
+
+static void profile_file(void* data, const char* filename) {
+    profile_report* report = data;
+    STREAMFILE* sf;
+    VGMSTREAM* vgmstream;
+    uint64_t time_start;
+
+    sf = open_mmap_streamfile(filename);
+    if (!sf) {
+        fprintf(stderr,"file %s not found\n",filename);
+        return;
+    }
+    sf->stream_index = report->stream_index;
+
+    time_start = get_streamfile_time_us();
+    vgmstream = init_vgmstream_from_STREAMFILE(sf);
+    time_start = get_streamfile_time_us() - time_start;
+    close_streamfile(sf);
+
+    report->files++;
+    report->time_us += time_start;
+    if (vgmstream) {
+        report->detected++;
+        close_vgmstream(vgmstream);
+    }
+    else {
+        report->unsupported_time_us += time_start;
+    }
+}
+
+static int profile_compare_time(const void* a, const void* b) {
+    const vgmstream_detection_profile_t* pa = *(const vgmstream_detection_profile_t**)a;
+    const vgmstream_detection_profile_t* pb = *(const vgmstream_detection_profile_t**)b;
+    if (pa->time_us != pb->time_us)
+        return pa->time_us < pb->time_us ? 1 : -1;
+    return pa < pb ? -1 : 1;
+}
+
+/* detects every file and prints detection functions sorted by total time (the index is the
+ * position in vgmstream.c's init_vgmstream_functions) */
+static int profile_detection(cli_config* cfg) {
+    profile_report report = {0};
+    vgmstream_detection_profile_t** sorted = NULL;
+    int i;
+
+    report.profile_count = vgmstream_get_detection_count();
+    report.stream_index = cfg->stream_index;
+    report.profile = calloc(report.profile_count, sizeof(vgmstream_detection_profile_t));
+    sorted = calloc(report.profile_count, sizeof(vgmstream_detection_profile_t*));
+    if (!report.profile || !sorted) goto fail;
+
+    vgmstream_detection_profile_setup(report.profile);
+    walk_path(cfg->infilename, profile_file, &report);
+    vgmstream_detection_profile_setup(NULL);
+
+    printf("files: %i (%i detected), detection time: %.3f ms (%.3f ms in unsupported files)\n",
+            report.files, report.detected, report.time_us / 1000.0, report.unsupported_time_us / 1000.0);
+
+    for (i = 0; i < report.profile_count; i++) {
+        sorted[i] = &report.profile[i];
+    }
+    qsort(sorted, report.profile_count, sizeof(vgmstream_detection_profile_t*), profile_compare_time);
+
+    printf("%5s %8s %8s %12s %10s %12s %12s %6s  %s\n",
+            "index", "tries", "matches", "time (ms)", "avg (us)", "requested", "read", "budget", "meta");
+    for (i = 0; i < report.profile_count; i++) {
+        const vgmstream_detection_profile_t* profile = sorted[i];
+        if (profile->tries == 0)
+            continue;
+        printf("%5i %8u %8u %12.3f %10.1f %12llu %12llu %6u  %s\n",
+                (int)(profile - report.profile) + 1,
+                (unsigned)profile->tries, (unsigned)profile->matches,
+                profile->time_us / 1000.0, (double)profile->time_us / profile->tries,
+                (unsigned long long)profile->bytes_requested, (unsigned long long)profile->bytes_read,
+                (unsigned)profile->over_budget, profile->meta_name);
+    }
 
+    free(report.profile);
+    free(sorted);
     return 1;
 fail:
+    free(report.profile);
+    free(sorted);
     return 0;
 }
 
@@ -284,36 +486,36 @@ static void print_info(VGMSTREAM * vgmstream, cli_config *cfg) {
 static void apply_config(VGMSTREAM* vgmstream, cli_config* cfg) {
 
     /* honor suggested config (order matters, and config mixes with/overwrites player defaults) */
-  //if (vgmstream->config.play_forever) { /* not really suited for CLI */
+  //if (vgmstream->config->play_forever) { /* not really suited for CLI */
   //    cfg->play_forever = 1;
   //    cfg->ignore_loop = 0;
   //}
-    if (vgmstream->config.loop_count_set) {
-        cfg->loop_count = vgmstream->config.loop_count;
+    if (vgmstream->config->loop_count_set) {
+        cfg->loop_count = vgmstream->config->loop_count;
         cfg->play_forever = 0;
         cfg->ignore_loop = 0;
     }
-    if (vgmstream->config.fade_delay_set) {
-        cfg->fade_delay = vgmstream->config.fade_delay;
+    if (vgmstream->config->fade_delay_set) {
+        cfg->fade_delay = vgmstream->config->fade_delay;
     }
-    if (vgmstream->config.fade_time_set) {
-        cfg->fade_time = vgmstream->config.fade_time;
+    if (vgmstream->config->fade_time_set) {
+        cfg->fade_time = vgmstream->config->fade_time;
     }
-    if (vgmstream->config.ignore_fade) {
+    if (vgmstream->config->ignore_fade) {
         cfg->ignore_fade = 1;
     }
 
-    if (vgmstream->config.force_loop) {
+    if (vgmstream->config->force_loop) {
         cfg->ignore_loop = 0;
         cfg->force_loop = 1;
         cfg->really_force_loop = 0;
     }
-    if (vgmstream->config.really_force_loop) {
+    if (vgmstream->config->really_force_loop) {
         cfg->ignore_loop = 0;
         cfg->force_loop = 0;
         cfg->really_force_loop = 1;
     }
-    if (vgmstream->config.ignore_loop) {
+    if (vgmstream->config->ignore_loop) {
         cfg->ignore_loop = 1;
         cfg->force_loop = 0;
         cfg->really_force_loop = 0;
@@ -372,18 +574,843 @@ void apply_fade(sample_t * buf, VGMSTREAM * vgmstream, int to_get, int i, int le
     }
 }
 
-void apply_seek(sample_t * buf, VGMSTREAM * vgmstream, int len_samples) {
+void apply_seek(VGMSTREAM * vgmstream, int len_samples) {
+    seek_vgmstream(vgmstream, len_samples);
+}
+
+/* makes rendered samples final (-2 channel selection, PC endian) in place, returns bytes to write */
+static size_t prepare_output(sample_t* buf, int to_get, int channels, int only_stereo) {
+    int j;
+
+    if (only_stereo != -1) {
+        for (j = 0; j < to_get; j++) {
+            sample_t l = buf[j*channels + only_stereo*2 + 0];
+            sample_t r = buf[j*channels + only_stereo*2 + 1];
+            buf[j*2 + 0] = l;
+            buf[j*2 + 1] = r;
+        }
+        channels = 2;
+    }
+
+    swap_samples_le(buf, channels * to_get); /* write PC endian */
+    return to_get * channels * sizeof(sample_t);
+}
+
+
+/* Double buffered output: main renders into one buffer while a thread writes the other, so
+ * decoding doesn't wait for slow outputs (pipes into encoders, disks). Buffers are written whole
+ * and unbuffered, one write per render chunk. */
+typedef struct {
+    FILE* outfile;
+    sample_t* bufs[2];
+    size_t bytes[2];        /* pending bytes of each buffer, 0 if free */
+    int current;            /* buffer being rendered */
+    int threaded;           /* writes done here if the thread can't start */
+    int stop;
+    int failed;
+#ifdef WIN32
+    HANDLE thread;
+    CRITICAL_SECTION lock;
+    CONDITION_VARIABLE cond;
+#else
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+#endif
+} output_writer;
+
+static void writer_lock(output_writer* w) {
+#ifdef WIN32
+    EnterCriticalSection(&w->lock);
+#else
+    pthread_mutex_lock(&w->lock);
+#endif
+}
+
+static void writer_unlock(output_writer* w) {
+#ifdef WIN32
+    LeaveCriticalSection(&w->lock);
+#else
+    pthread_mutex_unlock(&w->lock);
+#endif
+}
+
+static void writer_wait(output_writer* w) {
+#ifdef WIN32
+    SleepConditionVariableCS(&w->cond, &w->lock, INFINITE);
+#else
+    pthread_cond_wait(&w->cond, &w->lock);
+#endif
+}
+
+static void writer_signal(output_writer* w) {
+#ifdef WIN32
+    WakeAllConditionVariable(&w->cond);
+#else
+    pthread_cond_broadcast(&w->cond);
+#endif
+}
+
+/* writes buffers in the order they are submitted, until stopped with nothing pending */
+static void writer_worker(output_writer* w) {
+    int index = 0;
+
+    writer_lock(w);
+    while (1) {
+        size_t bytes;
+
+        while (w->bytes[index] == 0 && !w->stop)
+            writer_wait(w);
+        bytes = w->bytes[index];
+        if (bytes == 0)
+            break;
+
+        writer_unlock(w);
+        if (!w->failed && fwrite(w->bufs[index], 1, bytes, w->outfile) != bytes)
+            w->failed = 1;
+        writer_lock(w);
+
+        w->bytes[index] = 0;
+        writer_signal(w);
+        index ^= 1;
+    }
+    writer_unlock(w);
+}
+
+#ifdef WIN32
+static DWORD WINAPI writer_thread(LPVOID arg) {
+    writer_worker(arg);
+    return 0;
+}
+#else
+static void* writer_thread(void* arg) {
+    writer_worker(arg);
+    return NULL;
+}
+#endif
+
+/* buf_size is the render buffer (before mixing and -2 remove channels) */
+static int writer_open(output_writer* w, FILE* outfile, size_t buf_size) {
+    memset(w, 0, sizeof(output_writer));
+    w->outfile = outfile;
+    w->bufs[0] = malloc(buf_size);
+    w->bufs[1] = malloc(buf_size);
+    if (!w->bufs[0] || !w->bufs[1])
+        goto fail;
+
+    /* writes are big already, stdio's buffer would only copy them */
+    setvbuf(outfile, NULL, _IONBF, 0);
+
+#ifdef WIN32
+    InitializeCriticalSection(&w->lock);
+    InitializeConditionVariable(&w->cond);
+    w->thread = CreateThread(NULL, 0, writer_thread, w, 0, NULL);
+    w->threaded = (w->thread != NULL);
+#else
+    pthread_mutex_init(&w->lock, NULL);
+    pthread_cond_init(&w->cond, NULL);
+    w->threaded = (pthread_create(&w->thread, NULL, writer_thread, w) == 0);
+#endif
+    return 1;
+fail:
+    free(w->bufs[0]);
+    free(w->bufs[1]);
+    return 0;
+}
+
+/* buffer to render the next chunk into, once the writer is done with it */
+static sample_t* writer_buffer(output_writer* w) {
+    if (w->threaded) {
+        writer_lock(w);
+        while (w->bytes[w->current] > 0)
+            writer_wait(w);
+        writer_unlock(w);
+    }
+    return w->bufs[w->current];
+}
+
+/* queues the current buffer's first bytes and moves to the other */
+static void writer_submit(output_writer* w, size_t bytes) {
+    if (bytes == 0)
+        return;
+
+    if (!w->threaded) {
+        if (!w->failed && fwrite(w->bufs[w->current], 1, bytes, w->outfile) != bytes)
+            w->failed = 1;
+        return;
+    }
+
+    writer_lock(w);
+    w->bytes[w->current] = bytes;
+    writer_signal(w);
+    writer_unlock(w);
+    w->current ^= 1;
+}
+
+static void writer_write(output_writer* w, const void* data, size_t bytes) {
+    memcpy(writer_buffer(w), data, bytes);
+    writer_submit(w, bytes);
+}
+
+/* writes pending buffers and frees the writer (not the file), returns 0 if any write failed */
+static int writer_close(output_writer* w) {
+    if (w->threaded) {
+        writer_lock(w);
+        w->stop = 1;
+        writer_signal(w);
+        writer_unlock(w);
+#ifdef WIN32
+        WaitForSingleObject(w->thread, INFINITE);
+        CloseHandle(w->thread);
+#else
+        pthread_join(w->thread, NULL);
+#endif
+    }
+#ifdef WIN32
+    DeleteCriticalSection(&w->lock);
+#else
+    pthread_mutex_destroy(&w->lock);
+    pthread_cond_destroy(&w->cond);
+#endif
+
+    free(w->bufs[0]);
+    free(w->bufs[1]);
+    w->bufs[0] = w->bufs[1] = NULL;
+    return !w->failed;
+}
+
+/* decode speed of a group of files (same coding/layout/meta) */
+typedef struct {
+    char name[128];
+    int files;
+    uint64_t samples;
+    double audio_seconds;
+    uint64_t render_us;
+} benchmark_group;
+
+typedef struct {
+    benchmark_group* groups;
+    int count;
+    int max;
+} benchmark_groups;
+
+/* benchmark state, for all files found */
+typedef struct {
+    cli_config* cfg;
+    sample_t* buf;
+    int buf_channels;
+    int files;
+    int decoded;
+    uint64_t samples;
+    double audio_seconds;
+    uint64_t detect_us;
+    uint64_t decode_calls;
+    uint64_t decode_us;
+    uint64_t layout_us;
+    uint64_t mix_us;
+    benchmark_groups codings;
+    benchmark_groups layouts;
+    benchmark_groups metas;
+} benchmark_report;
+
+static void benchmark_add_group(benchmark_groups* groups, const char* name, uint64_t samples, double audio_seconds, uint64_t render_us) {
+    benchmark_group* group = NULL;
     int i;
 
+    for (i = 0; i < groups->count; i++) {
+        if (strcmp(groups->groups[i].name, name) == 0) {
+            group = &groups->groups[i];
+            break;
+        }
+    }
+
+    if (!group) {
+        if (groups->count >= groups->max) {
+            int max = groups->max ? groups->max * 2 : 64;
+            benchmark_group* new_groups = realloc(groups->groups, max * sizeof(benchmark_group));
+            if (!new_groups) return;
+
+            groups->groups = new_groups;
+            groups->max = max;
+        }
+
+        group = &groups->groups[groups->count];
+        groups->count++;
+        memset(group, 0, sizeof(benchmark_group));
+        snprintf(group->name, sizeof(group->name), "%s", name);
+    }
+
+    group->files++;
+    group->samples += samples;
+    group->audio_seconds += audio_seconds;
+    group->render_us += render_us;
+}
+
+/* samples/s and real time factor (seconds of audio decoded per second) */
+static double benchmark_speed(uint64_t samples, uint64_t time_us) {
+    return time_us ? samples * 1000000.0 / time_us : 0;
+}
+
+static double benchmark_rtf(double audio_seconds, uint64_t time_us) {
+    return time_us ? audio_seconds * 1000000.0 / time_us : 0;
+}
+
+static void benchmark_file(void* data, const char* filename) {
+    benchmark_report* report = data;
+    cli_config cfg = *report->cfg; /* apply_config modifies it */
+    vgmstream_profile_t profile;
+    STREAMFILE* sf;
+    VGMSTREAM* vgmstream;
+    char description[128];
+    int channels, input_channels;
+    int32_t len_samples, i;
+    uint64_t time_start, detect_us, render_us = 0, mix_us, layout_us;
+    double audio_seconds;
+
+    sf = open_mmap_streamfile(filename);
+    if (!sf) {
+        fprintf(stderr,"file %s not found\n",filename);
+        return;
+    }
+    sf->stream_index = cfg.stream_index;
+
+    time_start = get_streamfile_time_us();
+    vgmstream = init_vgmstream_from_STREAMFILE(sf);
+    detect_us = get_streamfile_time_us() - time_start;
+    close_streamfile(sf);
+
+    report->files++;
+    report->detect_us += detect_us;
+    if (!vgmstream)
+        return;
+
+    apply_config(vgmstream, &cfg);
+
+    channels = vgmstream->channels;
+    input_channels = vgmstream->channels;
+    vgmstream_mixing_enable(vgmstream, SAMPLE_BUFFER_SIZE, &input_channels, &channels);
+
+    if (input_channels > report->buf_channels) {
+        sample_t* buf = realloc(report->buf, SAMPLE_BUFFER_SIZE * sizeof(sample_t) * input_channels);
+        if (!buf) {
+            fprintf(stderr,"failed allocating output buffer\n");
+            close_vgmstream(vgmstream);
+            return;
+        }
+        report->buf = buf;
+        report->buf_channels = input_channels;
+    }
+
+    len_samples = get_vgmstream_play_samples(cfg.loop_count,cfg.fade_time,cfg.fade_delay,vgmstream);
+    audio_seconds = (double)len_samples / vgmstream->sample_rate;
+
+    /* same as render_vgmstream without play config, with stage profiling */
+    vgmstream_set_profiling(vgmstream, 1);
+    for (i = 0; i < len_samples; i += SAMPLE_BUFFER_SIZE) {
+        int to_get = SAMPLE_BUFFER_SIZE;
+        if (i + SAMPLE_BUFFER_SIZE > len_samples)
+            to_get = len_samples - i;
+
+        time_start = get_streamfile_time_us();
+        render_vgmstream_unmixed(report->buf, to_get, vgmstream);
+        mix_vgmstream(report->buf, to_get, vgmstream);
+        render_us += get_streamfile_time_us() - time_start;
+    }
+    vgmstream_get_profile(vgmstream, &profile);
+
+    /* stages are measured inside render time, which may be a bit less due to clock resolution
+     * (layout here is all render overhead outside codecs, not just the profile's layout stage) */
+    mix_us = profile.mix_time_us + profile.output_time_us;
+    layout_us = render_us - mix_us > profile.decode_time_us ? render_us - mix_us - profile.decode_time_us : 0;
+
+    report->decoded++;
+    report->samples += len_samples;
+    report->audio_seconds += audio_seconds;
+    report->decode_calls += profile.decode_calls;
+    report->decode_us += profile.decode_time_us;
+    report->layout_us += layout_us;
+    report->mix_us += mix_us;
+
+    printf("%12i %10.3f %10.3f %10.3f %10.3f %10.3f %12.0f %10.1f  %s\n",
+            len_samples, detect_us / 1000.0, profile.decode_time_us / 1000.0, layout_us / 1000.0, mix_us / 1000.0,
+            render_us / 1000.0, benchmark_speed(len_samples, render_us), benchmark_rtf(audio_seconds, render_us),
+            filename);
+    fflush(stdout);
+
+    get_vgmstream_coding_description(vgmstream, description, sizeof(description));
+    benchmark_add_group(&report->codings, description, len_samples, audio_seconds, render_us);
+    get_vgmstream_layout_description(vgmstream, description, sizeof(description));
+    benchmark_add_group(&report->layouts, description, len_samples, audio_seconds, render_us);
+    get_vgmstream_meta_description(vgmstream, description, sizeof(description));
+    benchmark_add_group(&report->metas, description, len_samples, audio_seconds, render_us);
+
+    close_vgmstream(vgmstream);
+}
+
+static int benchmark_compare_time(const void* a, const void* b) {
+    const benchmark_group* ga = a;
+    const benchmark_group* gb = b;
+    if (ga->render_us != gb->render_us)
+        return ga->render_us < gb->render_us ? 1 : -1;
+    return strcmp(ga->name, gb->name);
+}
+
+static void benchmark_print_groups(benchmark_groups* groups, const char* title) {
+    int i;
+
+    qsort(groups->groups, groups->count, sizeof(benchmark_group), benchmark_compare_time);
+
+    printf("\nby %s:\n", title);
+    printf("%6s %14s %12s %12s %10s  %s\n",
+            "files", "samples", "time (ms)", "samples/s", "x realtime", title);
+    for (i = 0; i < groups->count; i++) {
+        const benchmark_group* group = &groups->groups[i];
+        printf("%6i %14llu %12.3f %12.0f %10.1f  %s\n",
+                group->files, (unsigned long long)group->samples, group->render_us / 1000.0,
+                benchmark_speed(group->samples, group->render_us), benchmark_rtf(group->audio_seconds, group->render_us),
+                group->name);
+    }
+}
+
+/* decodes every file (discarding output) and prints decode speed per file, then per coding/layout/meta,
+ * with time split between detection, codec decoding, layout handling and mixing */
+static int benchmark_decode(cli_config* cfg) {
+    benchmark_report report = {0};
+    uint64_t render_us;
+
+    report.cfg = cfg;
+
+    printf("%12s %10s %10s %10s %10s %10s %12s %10s  %s\n",
+            "samples", "detect", "decode", "layout", "mix", "total (ms)", "samples/s", "x realtime", "file");
+    walk_path(cfg->infilename, benchmark_file, &report);
+
+    if (report.decoded) {
+        benchmark_print_groups(&report.codings, "coding");
+        benchmark_print_groups(&report.layouts, "layout");
+        benchmark_print_groups(&report.metas, "meta");
+    }
+
+    render_us = report.decode_us + report.layout_us + report.mix_us;
+    printf("\nfiles: %i (%i decoded), samples: %llu, detect: %.3f ms, decode: %.3f ms, layout: %.3f ms, mix: %.3f ms\n",
+            report.files, report.decoded, (unsigned long long)report.samples, report.detect_us / 1000.0,
+            report.decode_us / 1000.0, report.layout_us / 1000.0, report.mix_us / 1000.0);
+    printf("speed: %.0f samples/s, %.1fx realtime (%llu decode calls)\n",
+            benchmark_speed(report.samples, render_us), benchmark_rtf(report.audio_seconds, render_us),
+            (unsigned long long)report.decode_calls);
+
+    free(report.buf);
+    free(report.codings.groups);
+    free(report.layouts.groups);
+    free(report.metas.groups);
+    return report.decoded > 0;
+}
+
+/* a file (or subsong of a file) to decode in batch mode */
+typedef struct {
+    char* filename;
+    int subsong;                /* 0 = -s config and file.wav, N = Nth subsong to file#N.wav */
+} batch_item;
+
+/* batch mode state, shared by all workers */
+typedef struct {
+    cli_config* cfg;
+    batch_item* items;
+    int item_count;
+    int items_max;
+    int next_item;
+    int decoded;
+    int unsupported;
+    int failed;
+#ifdef WIN32
+    CRITICAL_SECTION lock;
+    CRITICAL_SECTION cache_lock;
+#else
+    pthread_mutex_t lock;
+    pthread_mutex_t cache_lock;
+#endif
+} batch_state;
+
+static void batch_lock(batch_state* batch) {
+#ifdef WIN32
+    EnterCriticalSection(&batch->lock);
+#else
+    pthread_mutex_lock(&batch->lock);
+#endif
+}
+
+static void batch_unlock(batch_state* batch) {
+#ifdef WIN32
+    LeaveCriticalSection(&batch->lock);
+#else
+    pthread_mutex_unlock(&batch->lock);
+#endif
+}
+
+/* lock callbacks of the core's global caches */
+static void batch_cache_lock(void* data) {
+#ifdef WIN32
+    EnterCriticalSection(data);
+#else
+    pthread_mutex_lock(data);
+#endif
+}
+
+static void batch_cache_unlock(void* data) {
+#ifdef WIN32
+    LeaveCriticalSection(data);
+#else
+    pthread_mutex_unlock(data);
+#endif
+}
+
+/* shares bank indexes and setups between workers, so a bank's directory is parsed once rather than
+ * once per subsong (mmap'd files already share pages, so the page cache isn't needed), and
+ * recycles streamfile buffers of deblocking readers between items */
+static void batch_setup_caches(batch_state* batch, int enabled) {
+    void (*lock)(void*) = enabled ? batch_cache_lock : NULL;
+    void (*unlock)(void*) = enabled ? batch_cache_unlock : NULL;
+    void* lock_data = enabled ? &batch->cache_lock : NULL;
+
+    vgmstream_hca_key_cache_setup(enabled, lock, unlock, lock_data);
+    vgmstream_adx_key_cache_setup(enabled, lock, unlock, lock_data);
+    vgmstream_ubi_sb_index_setup(enabled, lock, unlock, lock_data);
+    vgmstream_fsb5_index_setup(enabled, lock, unlock, lock_data);
+    vgmstream_wwise_setup_cache_setup(enabled, lock, unlock, lock_data);
+    vgmstream_bank_index_setup(enabled, lock, unlock, lock_data);
+    vgmstream_acb_name_cache_setup(enabled, lock, unlock, lock_data);
+    vgmstream_xsb_name_cache_setup(enabled, lock, unlock, lock_data);
+    vgmstream_txth_cache_setup(enabled, lock, unlock, lock_data);
+    vgmstream_buffer_pool_setup(enabled ? BATCH_BUFFER_POOL : 0, lock, unlock, lock_data);
+}
+
+static void batch_add_item(batch_state* batch, const char* filename, int subsong) {
+    char* file;
+
+    if (batch->item_count >= batch->items_max) {
+        int items_max = batch->items_max ? batch->items_max * 2 : 256;
+        batch_item* items = realloc(batch->items, items_max * sizeof(batch_item));
+        if (!items) return;
+
+        batch->items = items;
+        batch->items_max = items_max;
+    }
+
+    file = malloc(strlen(filename) + 1);
+    if (!file) return;
+    strcpy(file, filename);
+
+    batch->items[batch->item_count].filename = file;
+    batch->items[batch->item_count].subsong = subsong;
+    batch->item_count++;
+}
+
+/* subsongs of a file as reported by the first one, 0 if it has none or can't be opened */
+static int batch_get_subsongs(const char* filename) {
+    STREAMFILE* sf;
+    VGMSTREAM* vgmstream;
+    int total_subsongs = 0;
+
+    sf = open_mmap_streamfile(filename);
+    if (!sf) return 0;
+
+    sf->stream_index = 1;
+    sf->probe_only = 1;
+    vgmstream = init_vgmstream_from_STREAMFILE(sf);
+    close_streamfile(sf);
+
+    if (vgmstream) {
+        total_subsongs = vgmstream->num_streams;
+        close_vgmstream(vgmstream);
+    }
+    return total_subsongs;
+}
+
+static void batch_add_file(void* data, const char* filename) {
+    batch_state* batch = data;
+    cli_config* cfg = batch->cfg;
+    int subsong_start, subsong_end, total_subsongs, i;
+
+    if (!cfg->extract_subsongs) {
+        batch_add_item(batch, filename, 0);
+        return;
+    }
+
+    /* files without subsongs (or unsupported) are decoded normally */
+    total_subsongs = batch_get_subsongs(filename);
+    if (total_subsongs <= 0) {
+        batch_add_item(batch, filename, 0);
+        return;
+    }
+
+    subsong_start = cfg->stream_index > 0 ? cfg->stream_index : 1;
+    subsong_end = cfg->subsong_end > 0 && cfg->subsong_end < total_subsongs ? cfg->subsong_end : total_subsongs;
+    for (i = subsong_start; i <= subsong_end; i++) {
+        batch_add_item(batch, filename, i);
+    }
+}
+
+/* adds files in a @list (one file or folder per line) */
+static int batch_add_list(batch_state* batch, const char* listname) {
+    char line[PATH_LIMIT];
+    FILE* list;
+
+    list = fopen(listname, "r");
+    if (!list) {
+        fprintf(stderr,"list %s not found\n",listname);
+        return 0;
+    }
+
+    while (fgets(line, sizeof(line), list)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0')
+            continue;
+        walk_path(line, batch_add_file, batch);
+    }
+
+    fclose(list);
+    return 1;
+}
+
+/* decodes a file to file.wav (or a subsong to file#N.wav), like a regular call without special outputs
+ * (called from any worker, so it only touches its own VGMSTREAM and config) */
+static int batch_file(const cli_config* base_cfg, const batch_item* item, char* status, size_t status_size) {
+    cli_config cfg = *base_cfg; /* apply_config modifies it */
+    VGMSTREAM* vgmstream = NULL;
+    FILE* outfile = NULL;
+    char outfilename[PATH_LIMIT];
+    sample_t* buf = NULL;
+    int channels, input_channels;
+    int32_t len_samples;
+    int32_t fade_samples;
+    int i;
+
+    {
+        STREAMFILE* sf = open_mmap_streamfile(item->filename);
+        if (!sf) {
+            snprintf(status, status_size, "file not found");
+            goto fail;
+        }
+
+        sf->stream_index = item->subsong ? item->subsong : cfg.stream_index;
+        vgmstream = init_vgmstream_from_STREAMFILE(sf);
+        close_streamfile(sf);
+
+        if (!vgmstream) {
+            status[0] = '\0'; /* unsupported */
+            goto fail;
+        }
+    }
+
+    apply_config(vgmstream, &cfg);
+
+    channels = vgmstream->channels;
+    input_channels = vgmstream->channels;
+    vgmstream_mixing_enable(vgmstream, SAMPLE_BUFFER_SIZE, &input_channels, &channels);
+
+    len_samples = get_vgmstream_play_samples(cfg.loop_count,cfg.fade_time,cfg.fade_delay,vgmstream);
+    fade_samples = (int32_t)(cfg.fade_time < 0 ? 0 : cfg.fade_time * vgmstream->sample_rate);
+
+    if (cfg.seek_samples >= len_samples)
+        cfg.seek_samples = 0;
+    len_samples -= cfg.seek_samples;
+
+    buf = malloc(SAMPLE_BUFFER_SIZE * sizeof(sample_t) * input_channels);
+    if (!buf) {
+        snprintf(status, status_size, "failed allocating output buffer");
+        goto fail;
+    }
+
+    if (!cfg.decode_only) {
+        uint8_t wav_buf[0x100];
+        int channels_write = (cfg.only_stereo != -1) ? 2 : channels;
+        size_t bytes_done;
+
+        if (item->subsong)
+            snprintf(outfilename, sizeof(outfilename), "%s#%i.wav", item->filename, item->subsong);
+        else
+            snprintf(outfilename, sizeof(outfilename), "%s.wav", item->filename);
+        outfile = fopen(outfilename,"wb");
+        if (!outfile) {
+            snprintf(status, status_size, "failed to open %s for output", outfilename);
+            goto fail;
+        }
+
+        bytes_done = make_wav_header(wav_buf,0x100,
+                len_samples, vgmstream->sample_rate, channels_write,
+                cfg.write_lwav, cfg.lwav_loop_start, cfg.lwav_loop_end);
+
+        fwrite(wav_buf,sizeof(uint8_t),bytes_done,outfile);
+    }
+
+    apply_seek(vgmstream, cfg.seek_samples);
+
     for (i = 0; i < len_samples; i += SAMPLE_BUFFER_SIZE) {
         int to_get = SAMPLE_BUFFER_SIZE;
         if (i + SAMPLE_BUFFER_SIZE > len_samples)
             to_get = len_samples - i;
 
         render_vgmstream(buf, to_get, vgmstream);
+
+        apply_fade(buf, vgmstream, to_get, i, len_samples, fade_samples, channels);
+
+        if (!cfg.decode_only) {
+            size_t bytes = prepare_output(buf, to_get, channels, cfg.only_stereo);
+            fwrite(buf, 1, bytes, outfile);
+        }
+    }
+
+    if (outfile != NULL && fclose(outfile) != 0) {
+        outfile = NULL;
+        snprintf(status, status_size, "failed writing %s", outfilename);
+        goto fail;
+    }
+
+    snprintf(status, status_size, "%d samples", len_samples);
+    close_vgmstream(vgmstream);
+    free(buf);
+    return 1;
+fail:
+    if (outfile != NULL)
+        fclose(outfile);
+    close_vgmstream(vgmstream);
+    free(buf);
+    return 0;
+}
+
+/* takes the next pending item until all are done */
+static void batch_worker(batch_state* batch) {
+    char status[PATH_LIMIT];
+    char name[PATH_LIMIT];
+    const batch_item* item;
+    int ok;
+
+    while (1) {
+        batch_lock(batch);
+        item = batch->next_item < batch->item_count ? &batch->items[batch->next_item++] : NULL;
+        batch_unlock(batch);
+        if (!item)
+            break;
+
+        ok = batch_file(batch->cfg, item, status, sizeof(status));
+
+        if (item->subsong)
+            snprintf(name, sizeof(name), "%s#%i", item->filename, item->subsong);
+        else
+            snprintf(name, sizeof(name), "%s", item->filename);
+
+        batch_lock(batch);
+        if (ok) {
+            batch->decoded++;
+            printf("ok: %s (%s)\n", name, status);
+        }
+        else if (status[0] == '\0') {
+            batch->unsupported++;
+            printf("unsupported: %s\n", name);
+        }
+        else {
+            batch->failed++;
+            printf("failed: %s (%s)\n", name, status);
+        }
+        fflush(stdout);
+        batch_unlock(batch);
     }
 }
 
+#ifdef WIN32
+static DWORD WINAPI batch_thread(LPVOID arg) {
+    batch_worker(arg);
+    return 0;
+}
+#else
+static void* batch_thread(void* arg) {
+    batch_worker(arg);
+    return NULL;
+}
+#endif
+
+/* decodes every file in a folder or @list (or every subsong of them) with a pool of threads, each with
+ * its own VGMSTREAM and output */
+static int batch_decode(cli_config* cfg) {
+    batch_state batch = {0};
+#ifdef WIN32
+    HANDLE threads[BATCH_THREADS_MAX];
+#else
+    pthread_t threads[BATCH_THREADS_MAX];
+#endif
+    int thread_count = 0;
+    int i, ok = 0;
+
+    batch.cfg = cfg;
+
+#ifdef WIN32
+    InitializeCriticalSection(&batch.lock);
+    InitializeCriticalSection(&batch.cache_lock);
+#else
+    pthread_mutex_init(&batch.lock, NULL);
+    pthread_mutex_init(&batch.cache_lock, NULL);
+#endif
+
+    /* before listing, so finding subsongs already indexes banks */
+    batch_setup_caches(&batch, 1);
+
+    if (cfg->infilename[0] == '@') {
+        if (!batch_add_list(&batch, cfg->infilename + 1))
+            goto done;
+    }
+    else {
+        walk_path(cfg->infilename, batch_add_file, &batch);
+    }
+
+    if (batch.item_count == 0) {
+        fprintf(stderr,"no files found in %s\n",cfg->infilename);
+        goto done;
+    }
+
+    /* main thread works too once the others are started */
+    for (i = 1; i < cfg->batch_threads && i < batch.item_count; i++) {
+#ifdef WIN32
+        threads[thread_count] = CreateThread(NULL, 0, batch_thread, &batch, 0, NULL);
+        if (threads[thread_count] == NULL)
+            break;
+#else
+        if (pthread_create(&threads[thread_count], NULL, batch_thread, &batch) != 0)
+            break;
+#endif
+        thread_count++;
+    }
+
+    batch_worker(&batch);
+
+    for (i = 0; i < thread_count; i++) {
+#ifdef WIN32
+        WaitForSingleObject(threads[i], INFINITE);
+        CloseHandle(threads[i]);
+#else
+        pthread_join(threads[i], NULL);
+#endif
+    }
+
+    printf("%s: %i (%i decoded, %i unsupported, %i failed)\n", cfg->extract_subsongs ? "streams" : "files",
+            batch.item_count, batch.decoded, batch.unsupported, batch.failed);
+    ok = (batch.failed == 0);
+
+done:
+    batch_setup_caches(&batch, 0);
+#ifdef WIN32
+    DeleteCriticalSection(&batch.lock);
+    DeleteCriticalSection(&batch.cache_lock);
+#else
+    pthread_mutex_destroy(&batch.lock);
+    pthread_mutex_destroy(&batch.cache_lock);
+#endif
+
+    for (i = 0; i < batch.item_count; i++) {
+        free(batch.items[i].filename);
+    }
+    free(batch.items);
+    return ok;
+}
+
 /* ************************************************************ */
 
 int main(int argc, char ** argv) {
@@ -395,7 +1422,9 @@ int main(int argc, char ** argv) {
     int channels, input_channels;
     int32_t len_samples;
     int32_t fade_samples;
-    int i, j;
+    output_writer writer = {0};
+    int writer_opened = 0;
+    int i;
 
     cli_config cfg = {0};
     int res;
@@ -415,6 +1444,21 @@ int main(int argc, char ** argv) {
     res = validate_config(&cfg);
     if (!res) goto fail;
 
+    if (cfg.profile_detection) {
+        res = profile_detection(&cfg);
+        return res ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (cfg.benchmark) {
+        res = benchmark_decode(&cfg);
+        return res ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (cfg.batch_threads || cfg.extract_subsongs) {
+        res = batch_decode(&cfg);
+        return res ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
 #if 0
     /* CLI has no need to check */
     {
@@ -439,7 +1483,7 @@ int main(int argc, char ** argv) {
     /* open streamfile and pass subsong */
     {
         //s = init_vgmstream(infilename);
-        STREAMFILE *streamFile = open_stdio_streamfile(cfg.infilename);
+        STREAMFILE *streamFile = open_mmap_streamfile(cfg.infilename);
         if (!streamFile) {
             fprintf(stderr,"file %s not found\n",cfg.infilename);
             goto fail;
@@ -553,69 +1597,75 @@ int main(int argc, char ** argv) {
 
 
     /* last init */
-    buf = malloc(SAMPLE_BUFFER_SIZE * sizeof(sample_t) * input_channels);
-    if (!buf) {
-        fprintf(stderr,"failed allocating output buffer\n");
-        goto fail;
+    if (cfg.decode_only) {
+        buf = malloc(SAMPLE_BUFFER_SIZE * sizeof(sample_t) * input_channels);
+        if (!buf) {
+            fprintf(stderr,"failed allocating output buffer\n");
+            goto fail;
+        }
+    }
+    else {
+        /* renders go straight into the writer's buffers */
+        if (!writer_open(&writer, outfile, SAMPLE_BUFFER_SIZE * sizeof(sample_t) * input_channels)) {
+            fprintf(stderr,"failed allocating output buffer\n");
+            goto fail;
+        }
+        writer_opened = 1;
     }
 
-    /* slap on a .wav header */
-    if (!cfg.decode_only) {
+    /* slap on a .wav header (unknown size if looping forever, as streamed .wav do) */
+    if (!cfg.decode_only && !cfg.write_raw) {
         uint8_t wav_buf[0x100];
         int channels_write = (cfg.only_stereo != -1) ? 2 : channels;
         size_t bytes_done;
 
         bytes_done = make_wav_header(wav_buf,0x100,
-                len_samples, vgmstream->sample_rate, channels_write,
+                cfg.play_forever ? -1 : len_samples, vgmstream->sample_rate, channels_write,
                 cfg.write_lwav, cfg.lwav_loop_start, cfg.lwav_loop_end);
 
-        fwrite(wav_buf,sizeof(uint8_t),bytes_done,outfile);
+        writer_write(&writer, wav_buf, bytes_done);
     }
 
 
-    /* decode forever */
-    while (cfg.play_forever) {
+    /* decode forever (until the other end of the pipe closes) */
+    while (cfg.play_forever && !writer.failed) {
         int to_get = SAMPLE_BUFFER_SIZE;
+        sample_t* out = writer_buffer(&writer);
 
-        render_vgmstream(buf, to_get, vgmstream);
+        render_vgmstream(out, to_get, vgmstream);
 
-        swap_samples_le(buf, channels * to_get); /* write PC endian */
-        if (cfg.only_stereo != -1) {
-            for (j = 0; j < to_get; j++) {
-                fwrite(buf + j*channels + (cfg.only_stereo*2), sizeof(sample_t), 2, outfile);
-            }
-        } else {
-            fwrite(buf, sizeof(sample_t) * channels, to_get, outfile);
-        }
+        writer_submit(&writer, prepare_output(out, to_get, channels, cfg.only_stereo));
     }
 
 
-    apply_seek(buf, vgmstream, cfg.seek_samples);
+    apply_seek(vgmstream, cfg.seek_samples);
 
     /* decode */
     for (i = 0; i < len_samples; i += SAMPLE_BUFFER_SIZE) {
         int to_get = SAMPLE_BUFFER_SIZE;
+        sample_t* out = cfg.decode_only ? buf : writer_buffer(&writer);
         if (i + SAMPLE_BUFFER_SIZE > len_samples)
             to_get = len_samples - i;
 
-        render_vgmstream(buf, to_get, vgmstream);
+        render_vgmstream(out, to_get, vgmstream);
 
-        apply_fade(buf, vgmstream, to_get, i, len_samples, fade_samples, channels);
+        apply_fade(out, vgmstream, to_get, i, len_samples, fade_samples, channels);
 
         if (!cfg.decode_only) {
-            swap_samples_le(buf, channels * to_get); /* write PC endian */
-            if (cfg.only_stereo != -1) {
-                for (j = 0; j < to_get; j++) {
-                    fwrite(buf + j*channels + (cfg.only_stereo*2), sizeof(sample_t), 2, outfile);
-                }
-            } else {
-                fwrite(buf, sizeof(sample_t), to_get * channels, outfile);
-            }
+            writer_submit(&writer, prepare_output(out, to_get, channels, cfg.only_stereo));
         }
     }
 
+    if (writer_opened) {
+        writer_opened = 0;
+        if (!writer_close(&writer)) {
+            fprintf(stderr,"failed writing output\n");
+            goto fail;
+        }
+    }
     if (outfile != NULL) {
-        fclose(outfile);
+        if (!cfg.play_sdtout)
+            fclose(outfile);
         outfile = NULL;
     }
 
@@ -637,10 +1687,18 @@ int main(int argc, char ** argv) {
         /* vgmstream manipulations are undone by reset */
         apply_config(vgmstream, &cfg);
 
-        apply_seek(buf, vgmstream, cfg.seek_samples);
+        apply_seek(vgmstream, cfg.seek_samples);
 
-        /* slap on a .wav header */
         if (!cfg.decode_only) {
+            if (!writer_open(&writer, outfile, SAMPLE_BUFFER_SIZE * sizeof(sample_t) * input_channels)) {
+                fprintf(stderr,"failed allocating output buffer\n");
+                goto fail;
+            }
+            writer_opened = 1;
+        }
+
+        /* slap on a .wav header */
+        if (!cfg.decode_only && !cfg.write_raw) {
             uint8_t wav_buf[0x100];
             int channels_write = (cfg.only_stereo != -1) ? 2 : channels;
             size_t bytes_done;
@@ -649,31 +1707,32 @@ int main(int argc, char ** argv) {
                     len_samples, vgmstream->sample_rate, channels_write,
                     cfg.write_lwav, cfg.lwav_loop_start, cfg.lwav_loop_end);
 
-            fwrite(wav_buf,sizeof(uint8_t),bytes_done,outfile);
+            writer_write(&writer, wav_buf, bytes_done);
         }
 
         /* decode */
         for (i = 0; i < len_samples; i += SAMPLE_BUFFER_SIZE) {
             int to_get = SAMPLE_BUFFER_SIZE;
+            sample_t* out = cfg.decode_only ? buf : writer_buffer(&writer);
             if (i + SAMPLE_BUFFER_SIZE > len_samples)
                 to_get = len_samples - i;
 
-            render_vgmstream(buf, to_get, vgmstream);
+            render_vgmstream(out, to_get, vgmstream);
 
-            apply_fade(buf, vgmstream, to_get, i, len_samples, fade_samples, channels);
+            apply_fade(out, vgmstream, to_get, i, len_samples, fade_samples, channels);
 
             if (!cfg.decode_only) {
-                swap_samples_le(buf, channels * to_get); /* write PC endian */
-                if (cfg.only_stereo != -1) {
-                    for (j = 0; j < to_get; j++) {
-                        fwrite(buf + j*channels + (cfg.only_stereo*2), sizeof(sample_t), 2, outfile);
-                    }
-                } else {
-                    fwrite(buf, sizeof(sample_t) * channels, to_get, outfile);
-                }
+                writer_submit(&writer, prepare_output(out, to_get, channels, cfg.only_stereo));
             }
         }
 
+        if (writer_opened) {
+            writer_opened = 0;
+            if (!writer_close(&writer)) {
+                fprintf(stderr,"failed writing output\n");
+                goto fail;
+            }
+        }
         if (outfile != NULL) {
             fclose(outfile);
             outfile = NULL;
@@ -686,6 +1745,8 @@ int main(int argc, char ** argv) {
     return EXIT_SUCCESS;
 
 fail:
+    if (writer_opened)
+        writer_close(&writer);
     if (!cfg.play_sdtout) {
         if (outfile != NULL)
             fclose(outfile);
@@ -721,7 +1782,7 @@ static void make_smpl_chunk(uint8_t * buf, int32_t loop_start, int32_t loop_end)
 static size_t make_wav_header(uint8_t * buf, size_t buf_size, int32_t sample_count, int32_t sample_rate, int channels, int smpl_chunk, int32_t loop_start, int32_t loop_end) {
     size_t data_size, header_size;
 
-    data_size = sample_count * channels * sizeof(sample_t);
+    data_size = sample_count < 0 ? 0 : sample_count * channels * sizeof(sample_t);
     header_size = 0x2c;
     if (smpl_chunk && loop_end)
         header_size += 0x3c+ 0x08;
@@ -753,6 +1814,12 @@ static size_t make_wav_header(uint8_t * buf, size_t buf_size, int32_t sample_cou
         put_32bitLE(buf+0x28, (int32_t)data_size); /* size of WAVE data chunk */
     }
 
+    /* negative count = unknown size (streamed), max sizes are read as "until EOF" */
+    if (sample_count < 0) {
+        put_32bitLE(buf+4, -1);
+        put_32bitLE(buf+header_size-0x04, -1);
+    }
+
     /* could try to add channel_layout, but would need to write WAVEFORMATEXTENSIBLE (maybe only if arg flag?) */
 
     return header_size;
@@ -0,0 +1,471 @@
+/* Decoder microbenchmark: decodes synthetic (random but valid) frames from memory with every
+ * supported decoder and channel count, so decoder changes can be measured without file I/O,
+ * parsing or layout noise. Prints results as JSON lines, optionally compared to a previous run. */
+#define POSIXLY_CORRECT
+#include <getopt.h>
+#include "../src/vgmstream.h"
+#include "../src/util.h"
+
+/* frames per channel in the synthetic data, small enough to stay in cache */
+#define CODEC_BENCH_FRAMES 256
+/* each test decodes the data repeatedly for at least this long, and the fastest of the repeats is taken */
+#define CODEC_BENCH_MIN_US 100000
+#define CODEC_BENCH_REPEATS 3
+#define CODEC_BENCH_MAX_CHANNELS 8
+
+/* getopt globals (the horror...) */
+extern char * optarg;
+extern int optind, opterr, optopt;
+
+
+static void usage(const char * name) {
+    fprintf(stderr,"vgmstream decoder benchmark " __DATE__ "\n"
+            "Usage: %s [options]\n"
+            "Options:\n"
+            "    -o outfile: write results to outfile, default stdout\n"
+            "    -b baseline: compare with the results of a previous run\n"
+            "    -f filter: only test decoders whose description contains filter\n"
+            "    -t N: minimum time per test in ms, default %i\n"
+            "Prints a JSON object per decoder and channel count, with ns per decoded sample\n"
+            "(per channel) and, with -b, the change against the baseline in %%.\n"
+            , name, CODEC_BENCH_MIN_US / 1000);
+}
+
+/* ************************************************************ */
+/* memory streamfile, so decoders read frames without any I/O   */
+
+typedef struct {
+    STREAMFILE sf;
+    const uint8_t* data;
+    size_t data_size;
+} memory_streamfile;
+
+static size_t memory_read(STREAMFILE* sf, uint8_t* dst, off_t offset, size_t length) {
+    memory_streamfile* msf = (memory_streamfile*)sf;
+
+    if (offset < 0 || (size_t)offset >= msf->data_size)
+        return 0;
+    if (length > msf->data_size - offset)
+        length = msf->data_size - offset;
+    memcpy(dst, msf->data + offset, length);
+    return length;
+}
+
+static const uint8_t* memory_read_ptr(STREAMFILE* sf, off_t offset, size_t length) {
+    memory_streamfile* msf = (memory_streamfile*)sf;
+
+    if (offset < 0 || (size_t)offset + length > msf->data_size)
+        return NULL;
+    return msf->data + offset;
+}
+
+static size_t memory_get_size(STREAMFILE* sf) {
+    return ((memory_streamfile*)sf)->data_size;
+}
+
+static off_t memory_get_offset(STREAMFILE* sf) {
+    return 0;
+}
+
+static void memory_get_name(STREAMFILE* sf, char* name, size_t name_size) {
+    snprintf(name, name_size, "codec_bench.bin");
+}
+
+static STREAMFILE* memory_open(STREAMFILE* sf, const char* const filename, size_t buffer_size) {
+    return NULL;
+}
+
+static void memory_close(STREAMFILE* sf) {
+    free(sf);
+}
+
+static STREAMFILE* open_memory_streamfile(const uint8_t* data, size_t data_size) {
+    memory_streamfile* msf = calloc(1, sizeof(memory_streamfile));
+    if (!msf) return NULL;
+
+    msf->sf.read = memory_read;
+    msf->sf.read_ptr = memory_read_ptr;
+    msf->sf.get_size = memory_get_size;
+    msf->sf.get_offset = memory_get_offset;
+    msf->sf.get_name = memory_get_name;
+    msf->sf.open = memory_open;
+    msf->sf.close = memory_close;
+    msf->data = data;
+    msf->data_size = data_size;
+    return &msf->sf;
+}
+
+/* ************************************************************ */
+/* decoders and how to make their frames valid                  */
+
+static uint32_t next_random(uint32_t* seed) {
+    *seed = *seed * 1103515245 + 12345;
+    return *seed >> 8;
+}
+
+/* PS-ADPCM/HEVAG: filter 0..4, shift 0..12, no flags */
+static void setup_psx(uint8_t* frame, int frame_bytes, int channels, uint32_t* seed) {
+    frame[0] = (next_random(seed) % 5) << 4 | (next_random(seed) % 13);
+    frame[1] = 0;
+}
+
+/* DSP: predictor 0..7, scale 0..11 */
+static void setup_dsp(uint8_t* frame, int frame_bytes, int channels, uint32_t* seed) {
+    frame[0] = (next_random(seed) % 8) << 4 | (next_random(seed) % 12);
+}
+
+/* ADX: 16-bit BE scale, without the high bits used by other ADX modes */
+static void setup_adx(uint8_t* frame, int frame_bytes, int channels, uint32_t* seed) {
+    int scale = 1 + next_random(seed) % 0x0FFF;
+    frame[0] = (scale >> 8) & 0xFF;
+    frame[1] = (scale >> 0) & 0xFF;
+}
+
+/* CD-XA: 16 sound parameters with filter 0..3, shift 0..12 */
+static void setup_xa(uint8_t* frame, int frame_bytes, int channels, uint32_t* seed) {
+    int i;
+    for (i = 0; i < 0x10; i++) {
+        frame[i] = (next_random(seed) % 4) << 4 | (next_random(seed) % 13);
+    }
+}
+
+/* MS-IMA: per channel header with 16-bit history and step index 0..88 */
+static void setup_ms_ima(uint8_t* frame, int frame_bytes, int channels, uint32_t* seed) {
+    int ch;
+    for (ch = 0; ch < channels; ch++) {
+        frame[ch*0x04 + 0x02] = next_random(seed) % 89;
+        frame[ch*0x04 + 0x03] = 0;
+    }
+}
+
+/* MSADPCM: coefficient index 0..6 and a non-zero delta */
+static void setup_msadpcm(uint8_t* frame, int frame_bytes, int channels, uint32_t* seed) {
+    frame[0] = next_random(seed) % 7;
+    frame[1] = 0x10 + next_random(seed) % 0xF0;
+    frame[2] = next_random(seed) % 0x10;
+}
+
+/* float PCM: samples in the -1.0..1.0 range */
+static void setup_pcmfloat(uint8_t* frame, int frame_bytes, int channels, uint32_t* seed) {
+    int i;
+    for (i = 0; i + 4 <= frame_bytes; i += 4) {
+        float sample = (float)((int)(next_random(seed) % 0x10000) - 0x8000) / 0x8000;
+        uint32_t value;
+        memcpy(&value, &sample, 4);
+        put_32bitLE(frame + i, value);
+    }
+}
+
+typedef struct {
+    coding_t coding_type;
+    int frame_bytes;    /* per channel, or of all channels if shared */
+    int frame_samples;  /* per decode call (sample-based codecs use several "frames"), 0 if shared */
+    int shared;         /* frames have all channels (samples per call depend on channels) */
+    int max_channels;
+    void (*setup)(uint8_t* frame, int frame_bytes, int channels, uint32_t* seed);
+} codec_bench_t;
+
+static const codec_bench_t codec_benchs[] = {
+    {coding_PCM16LE,        0x200,  0x100,  0, 0, NULL},
+    {coding_PCM8,           0x100,  0x100,  0, 0, NULL},
+    {coding_ULAW,           0x100,  0x100,  0, 0, NULL},
+    {coding_PCMFLOAT,       0x400,  0x100,  0, 0, setup_pcmfloat},
+    {coding_SDX2,           0x100,  0x100,  0, 0, NULL},
+    {coding_IMA_int,        0x80,   0x100,  0, 0, NULL},
+    {coding_AICA_int,       0x80,   0x100,  0, 0, NULL},
+    {coding_PSX,            0x10,   28,     0, 0, setup_psx},
+    {coding_HEVAG,          0x10,   28,     0, 0, setup_psx},
+    {coding_NGC_DSP,        0x08,   14,     0, 0, setup_dsp},
+    {coding_NGC_AFC,        0x09,   16,     0, 0, NULL},
+    {coding_CRI_ADX,        0x12,   32,     0, 0, setup_adx},
+    {coding_MSADPCM_int,    0x100,  500,    0, 0, setup_msadpcm},
+    {coding_XA,             0x80,   0,      1, 2, setup_xa},
+    {coding_MS_IMA,         0x400,  0,      1, 0, setup_ms_ima},
+};
+
+static const int bench_channels[] = {1, 2, 6};
+
+/* typical DSP/ADX coefs (any are valid, but these keep output in range like real files) */
+static const int16_t bench_dsp_coefs[16] = {
+    0x04AB, -0x0352, 0x0789, -0x0212, 0x0A2B, -0x0631, 0x0AF1, -0x0401,
+    0x0C44, -0x0549, 0x0D25, -0x0631, 0x0E41, -0x06F1, 0x0FB2, -0x07A8,
+};
+
+/* ************************************************************ */
+
+typedef struct {
+    FILE* out;
+    const char* filter;
+    int min_us;
+    char** baseline_names;      /* "coding/channels" of each baseline result */
+    double* baseline_ns;
+    int baseline_count;
+} bench_config;
+
+/* decodes all frames once, returns samples per channel decoded */
+static int64_t decode_frames(VGMSTREAM* vgmstream, const codec_bench_t* cb, sample_t* buf, int32_t samples_per_call, size_t frame_bytes, int frames) {
+    int64_t samples = 0;
+    int ch, f;
+
+    for (ch = 0; ch < vgmstream->channels; ch++) {
+        vgmstream->ch[ch].offset = vgmstream->ch[ch].channel_start_offset;
+    }
+
+    for (f = 0; f < frames; f++) {
+        vgmstream->samples_into_block = 0;
+        decode_vgmstream(vgmstream, 0, samples_per_call, buf);
+        for (ch = 0; ch < vgmstream->channels; ch++) {
+            vgmstream->ch[ch].offset += frame_bytes;
+        }
+        samples += samples_per_call;
+    }
+    return samples;
+}
+
+/* ns per sample of one decoder with N channels, or -1 if it can't be tested */
+static double bench_codec(const bench_config* cfg, const codec_bench_t* cb, int channels, char* description, size_t description_size) {
+    VGMSTREAM* vgmstream = NULL;
+    STREAMFILE* sf = NULL;
+    uint8_t* data = NULL;
+    sample_t* buf = NULL;
+    size_t channel_bytes, data_size;
+    int32_t samples_per_call;
+    uint32_t seed = 1;
+    double best = -1;
+    int ch, f, i, r;
+
+    vgmstream = allocate_vgmstream(channels, 0);
+    if (!vgmstream) goto fail;
+
+    vgmstream->coding_type = cb->coding_type;
+    vgmstream->layout_type = layout_none;
+    vgmstream->sample_rate = 48000;
+    vgmstream->interleave_block_size = cb->frame_bytes;
+    vgmstream->frame_size = cb->frame_bytes;
+    vgmstream->num_samples = 0x7FFFFFFF;
+
+    description[0] = '\0';
+    get_vgmstream_coding_description(vgmstream, description, description_size);
+    if (cfg->filter && !strstr(description, cfg->filter))
+        goto fail;
+
+    samples_per_call = cb->shared ? get_vgmstream_samples_per_frame(vgmstream) : cb->frame_samples;
+    if (samples_per_call <= 0)
+        goto fail;
+
+    /* each channel gets its own frames (or all read the same shared frames) */
+    channel_bytes = (size_t)cb->frame_bytes * CODEC_BENCH_FRAMES;
+    data_size = cb->shared ? channel_bytes : channel_bytes * channels;
+    data = malloc(data_size);
+    buf = malloc(sizeof(sample_t) * samples_per_call * channels);
+    if (!data || !buf) goto fail;
+
+    for (i = 0; i < (int)data_size; i++) {
+        data[i] = next_random(&seed) & 0xFF;
+    }
+    if (cb->setup) {
+        for (f = 0; f < (int)(data_size / cb->frame_bytes); f++) {
+            cb->setup(data + f * cb->frame_bytes, cb->frame_bytes, channels, &seed);
+        }
+    }
+
+    sf = open_memory_streamfile(data, data_size);
+    if (!sf) goto fail;
+
+    for (ch = 0; ch < channels; ch++) {
+        vgmstream->ch[ch].streamfile = sf;
+        vgmstream->ch[ch].channel_start_offset = cb->shared ? 0 : channel_bytes * ch;
+        memcpy(vgmstream->ch[ch].adpcm_coef, bench_dsp_coefs, sizeof(bench_dsp_coefs));
+    }
+
+    /* first pass warms up caches and any lazy codec setup */
+    decode_frames(vgmstream, cb, buf, samples_per_call, cb->frame_bytes, CODEC_BENCH_FRAMES);
+
+    for (r = 0; r < CODEC_BENCH_REPEATS; r++) {
+        uint64_t time_start = get_streamfile_time_us();
+        uint64_t time_us = 0;
+        int64_t samples = 0;
+        double ns;
+
+        while (time_us < (uint64_t)cfg->min_us) {
+            samples += decode_frames(vgmstream, cb, buf, samples_per_call, cb->frame_bytes, CODEC_BENCH_FRAMES);
+            time_us = get_streamfile_time_us() - time_start;
+        }
+
+        ns = time_us * 1000.0 / (samples * channels);
+        if (best < 0 || ns < best)
+            best = ns;
+    }
+
+fail:
+    if (vgmstream) {
+        /* channels share the memory streamfile, closed once below */
+        for (ch = 0; ch < channels; ch++) {
+            vgmstream->ch[ch].streamfile = NULL;
+        }
+        close_vgmstream(vgmstream);
+    }
+    close_streamfile(sf);
+    free(data);
+    free(buf);
+    return best;
+}
+
+/* ************************************************************ */
+
+static void print_string(FILE* out, const char* str) {
+    fputc('"', out);
+    for (; *str; str++) {
+        unsigned char c = *str;
+        if (c == '"' || c == '\\')
+            fprintf(out, "\\%c", c);
+        else if (c < 0x20)
+            fprintf(out, "\\u%04x", c);
+        else
+            fputc(c, out);
+    }
+    fputc('"', out);
+}
+
+/* reads "coding_id" + "channels" and "ns_per_sample" of a previous run (only this tool's own output) */
+static int load_baseline(bench_config* cfg, const char* filename) {
+    char line[1024];
+    FILE* file;
+
+    file = fopen(filename, "r");
+    if (!file) {
+        fprintf(stderr,"baseline %s not found\n",filename);
+        return 0;
+    }
+
+    while (fgets(line, sizeof(line), file)) {
+        char name[64];
+        const char* pos;
+        int coding_id, channels;
+        double ns;
+
+        pos = strstr(line, "\"coding_id\":");
+        if (!pos || sscanf(pos, "\"coding_id\":%i,\"channels\":%i,\"ns_per_sample\":%lf", &coding_id, &channels, &ns) != 3)
+            continue;
+
+        if (cfg->baseline_count % 64 == 0) {
+            char** names = realloc(cfg->baseline_names, (cfg->baseline_count + 64) * sizeof(char*));
+            double* values;
+            if (!names) break;
+            cfg->baseline_names = names;
+            values = realloc(cfg->baseline_ns, (cfg->baseline_count + 64) * sizeof(double));
+            if (!values) break;
+            cfg->baseline_ns = values;
+        }
+
+        snprintf(name, sizeof(name), "%i/%i", coding_id, channels);
+        cfg->baseline_names[cfg->baseline_count] = malloc(strlen(name) + 1);
+        if (!cfg->baseline_names[cfg->baseline_count]) break;
+        strcpy(cfg->baseline_names[cfg->baseline_count], name);
+        cfg->baseline_ns[cfg->baseline_count] = ns;
+        cfg->baseline_count++;
+    }
+
+    fclose(file);
+    return 1;
+}
+
+static double find_baseline(const bench_config* cfg, coding_t coding_type, int channels) {
+    char name[64];
+    int i;
+
+    snprintf(name, sizeof(name), "%i/%i", (int)coding_type, channels);
+    for (i = 0; i < cfg->baseline_count; i++) {
+        if (strcmp(cfg->baseline_names[i], name) == 0)
+            return cfg->baseline_ns[i];
+    }
+    return -1;
+}
+
+
+int main(int argc, char ** argv) {
+    bench_config cfg = {0};
+    const char* outfilename = NULL;
+    const char* baseline = NULL;
+    int opt, i, j, tested = 0;
+
+    cfg.min_us = CODEC_BENCH_MIN_US;
+
+    opterr = 0;
+    while ((opt = getopt(argc, argv, "o:b:f:t:h")) != -1) {
+        switch (opt) {
+            case 'o':
+                outfilename = optarg;
+                break;
+            case 'b':
+                baseline = optarg;
+                break;
+            case 'f':
+                cfg.filter = optarg;
+                break;
+            case 't':
+                cfg.min_us = atoi(optarg) * 1000;
+                break;
+            case '?':
+                fprintf(stderr, "Unknown option -%c found\n", optopt);
+                return EXIT_FAILURE;
+            default:
+                usage(argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    if (baseline && !load_baseline(&cfg, baseline))
+        return EXIT_FAILURE;
+
+    cfg.out = stdout;
+    if (outfilename) {
+        cfg.out = fopen(outfilename, "w");
+        if (!cfg.out) {
+            fprintf(stderr,"failed to open %s for output\n",outfilename);
+            return EXIT_FAILURE;
+        }
+    }
+
+    for (i = 0; i < sizeof(codec_benchs) / sizeof(codec_benchs[0]); i++) {
+        const codec_bench_t* cb = &codec_benchs[i];
+
+        for (j = 0; j < sizeof(bench_channels) / sizeof(bench_channels[0]); j++) {
+            int channels = bench_channels[j];
+            char description[128];
+            double ns, base_ns;
+
+            if (cb->max_channels && channels > cb->max_channels)
+                continue;
+            if (channels > CODEC_BENCH_MAX_CHANNELS)
+                continue;
+
+            ns = bench_codec(&cfg, cb, channels, description, sizeof(description));
+            if (ns < 0)
+                continue;
+
+            /* keep coding_id/channels/ns_per_sample together, load_baseline reads them in this order */
+            fprintf(cfg.out, "{\"type\":\"decoder\",\"coding\":");
+            print_string(cfg.out, description);
+            fprintf(cfg.out, ",\"coding_id\":%i,\"channels\":%i,\"ns_per_sample\":%.3f", (int)cb->coding_type, channels, ns);
+
+            base_ns = find_baseline(&cfg, cb->coding_type, channels);
+            if (base_ns > 0)
+                fprintf(cfg.out, ",\"baseline_ns\":%.3f,\"change_pct\":%.1f", base_ns, (ns - base_ns) * 100.0 / base_ns);
+            fprintf(cfg.out, "}\n");
+            fflush(cfg.out);
+            tested++;
+        }
+    }
+
+    fprintf(stderr, "decoders: %i tests\n", tested);
+
+    if (cfg.out != stdout)
+        fclose(cfg.out);
+    for (i = 0; i < cfg.baseline_count; i++) {
+        free(cfg.baseline_names[i]);
+    }
+    free(cfg.baseline_names);
+    free(cfg.baseline_ns);
+    return EXIT_SUCCESS;
+}
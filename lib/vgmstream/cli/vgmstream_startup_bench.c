@@ -0,0 +1,524 @@
+/* Startup latency benchmark: times, for every file in a corpus, what happens from opening it to the
+ * first rendered samples (file open, first read, detection, format setup, first render) and prints
+ * results as JSON lines (one per file, then one per format), to track what delays pressing play. */
+#define POSIXLY_CORRECT
+#include <getopt.h>
+#include "../src/vgmstream.h"
+#include "../src/plugins.h"
+#include "../src/mixing.h"
+#include "../src/util.h"
+#include <sys/stat.h>
+#ifdef WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#include <dirent.h>
+#endif
+
+/* samples rendered as the first render (about what a player asks first) */
+#define BENCH_FIRST_SAMPLES 4096
+
+/* getopt globals (the horror...) */
+extern char * optarg;
+extern int optind, opterr, optopt;
+
+
+static void usage(const char * name) {
+    fprintf(stderr,"vgmstream startup benchmark " __DATE__ "\n"
+            "Usage: %s [options] infile/folder ...\n"
+            "Options:\n"
+            "    -o outfile: write results to outfile, default stdout\n"
+            "    -i io: file access, stdio (default), mmap, buffer (adaptive buffer over stdio)\n"
+            "       or memory (whole small files read at once)\n"
+            "    -n N: samples of the first render, default %i\n"
+            "    -r N: opens per file, fastest taken (the first is usually the only cold one), default 1\n"
+            "    -s N: select subsong N, if the format supports multiple subsongs\n"
+            "Prints a JSON object per line: \"file\" results, then \"summary\" per format.\n"
+            "Times are in us: open (streamfile), first_read (first read of the file), detect (detection\n"
+            "minus the matching format, with the detection functions tried), setup (matching format's\n"
+            "init: header, codec setup, channel opens) and first_render, all added in total.\n"
+            , name, BENCH_FIRST_SAMPLES);
+}
+
+typedef enum { IO_STDIO, IO_MMAP, IO_BUFFER, IO_MEMORY } bench_io;
+
+typedef struct {
+    FILE* out;
+    bench_io io;
+    int first_samples;
+    int repeats;
+    int stream_index;
+} bench_config;
+
+/* results of one open, times in us */
+typedef struct {
+    double open_us;
+    double first_read_us;
+    double detect_us;
+    double setup_us;
+    double render_us;
+    double render_read_us;  /* part of the first render spent in file/device reads */
+    double total_us;
+    int tries;              /* detection functions called (including nested ones) */
+    uint64_t init_bytes;    /* read from the file/device until the stream was ready */
+    uint64_t render_bytes;  /* read from the file/device by the first render */
+} bench_result;
+
+/* added results of all files with the same format */
+typedef struct {
+    int init_index;
+    char meta[128];
+    int files;
+    bench_result total;
+    double max_total_us;
+} bench_group;
+
+typedef struct {
+    bench_config* cfg;
+    vgmstream_detection_profile_t* profile;
+    int profile_count;
+    bench_group* groups;
+    int group_count;
+    int group_size;
+    int tested;
+    int failed;
+} bench_report;
+
+
+/* ************************************************************ */
+
+/* Wrapper of the opened file that times its first read. Reopens (channels, companion files) aren't
+ * wrapped, like open_wrap_streamfile. */
+typedef struct {
+    STREAMFILE sf;
+
+    STREAMFILE* inner_sf;
+    int reads;
+    uint64_t first_read_us;
+} TIMED_STREAMFILE;
+
+static size_t timed_read(TIMED_STREAMFILE* sf, uint8_t* dst, off_t offset, size_t length) {
+    uint64_t time_start = get_streamfile_time_us();
+    size_t bytes = sf->inner_sf->read(sf->inner_sf, dst, offset, length);
+
+    if (sf->reads++ == 0)
+        sf->first_read_us = get_streamfile_time_us() - time_start;
+    return bytes;
+}
+static const uint8_t* timed_read_ptr(TIMED_STREAMFILE* sf, off_t offset, size_t length) {
+    uint64_t time_start = get_streamfile_time_us();
+    const uint8_t* ptr = sf->inner_sf->read_ptr(sf->inner_sf, offset, length);
+
+    if (sf->reads++ == 0)
+        sf->first_read_us = get_streamfile_time_us() - time_start;
+    return ptr;
+}
+static size_t timed_get_size(TIMED_STREAMFILE* sf) {
+    return sf->inner_sf->get_size(sf->inner_sf);
+}
+static off_t timed_get_offset(TIMED_STREAMFILE* sf) {
+    return sf->inner_sf->get_offset(sf->inner_sf);
+}
+static void timed_get_name(TIMED_STREAMFILE* sf, char* buffer, size_t length) {
+    sf->inner_sf->get_name(sf->inner_sf, buffer, length);
+}
+static STREAMFILE* timed_open(TIMED_STREAMFILE* sf, const char* const filename, size_t buffersize) {
+    return sf->inner_sf->open(sf->inner_sf, filename, buffersize);
+}
+static void timed_get_stats(TIMED_STREAMFILE* sf, streamfile_stats_t* stats) {
+    get_streamfile_stats(sf->inner_sf, stats);
+}
+static const char* timed_get_name_ref(TIMED_STREAMFILE* sf) {
+    return get_streamfile_name_ref(sf->inner_sf);
+}
+static void timed_prefetch(TIMED_STREAMFILE* sf, off_t offset, size_t length) {
+    prefetch_streamfile(sf->inner_sf, offset, length);
+}
+static void timed_release(TIMED_STREAMFILE* sf) {
+    release_streamfile_buffer(sf->inner_sf);
+}
+static void timed_close(TIMED_STREAMFILE* sf) {
+    close_streamfile(sf->inner_sf);
+    free(sf);
+}
+
+static TIMED_STREAMFILE* open_timed_streamfile_f(STREAMFILE* inner_sf) {
+    TIMED_STREAMFILE* this_sf;
+
+    if (!inner_sf) return NULL;
+
+    this_sf = calloc(1, sizeof(TIMED_STREAMFILE));
+    if (!this_sf) {
+        close_streamfile(inner_sf);
+        return NULL;
+    }
+
+    this_sf->sf.read = (void*)timed_read;
+    this_sf->sf.get_size = (void*)timed_get_size;
+    this_sf->sf.get_offset = (void*)timed_get_offset;
+    this_sf->sf.get_name = (void*)timed_get_name;
+    this_sf->sf.open = (void*)timed_open;
+    this_sf->sf.close = (void*)timed_close;
+    this_sf->sf.read_ptr = inner_sf->read_ptr ? (void*)timed_read_ptr : NULL;
+    this_sf->sf.get_stats = (void*)timed_get_stats;
+    this_sf->sf.release = (void*)timed_release;
+    this_sf->sf.get_name_ref = inner_sf->get_name_ref ? (void*)timed_get_name_ref : NULL;
+    this_sf->sf.prefetch = inner_sf->prefetch ? (void*)timed_prefetch : NULL;
+
+    this_sf->inner_sf = inner_sf;
+    return this_sf;
+}
+
+static STREAMFILE* open_bench_streamfile(bench_io io, const char* filename) {
+    switch (io) {
+        case IO_MMAP:
+            return open_mmap_streamfile(filename);
+        case IO_BUFFER:
+            return open_buffer_streamfile_adaptive_f(open_stdio_streamfile(filename));
+        case IO_MEMORY:
+            return open_memory_streamfile_f(open_stdio_streamfile(filename), MEMORY_STREAMFILE_MAX_SIZE);
+        case IO_STDIO:
+        default:
+            return open_stdio_streamfile(filename);
+    }
+}
+
+/* ************************************************************ */
+
+/* Opens the file and renders the first samples, returns the stream (for names) or NULL. */
+static VGMSTREAM* bench_file(bench_report* report, const char* filename, bench_result* res) {
+    bench_config* cfg = report->cfg;
+    TIMED_STREAMFILE* sf = NULL;
+    VGMSTREAM* vgmstream = NULL;
+    sample_t* buf = NULL;
+    streamfile_stats_t stats, stats_start;
+    vgmstream_profile_t profile;
+    uint64_t time_start, time_open, time_init, time_render;
+    int input_channels, output_channels;
+    int i;
+
+    memset(res, 0, sizeof(bench_result));
+    memset(report->profile, 0, sizeof(vgmstream_detection_profile_t) * report->profile_count);
+
+    time_start = get_streamfile_time_us();
+    sf = open_timed_streamfile_f(open_bench_streamfile(cfg->io, filename));
+    if (!sf) goto fail;
+    sf->sf.stream_index = cfg->stream_index;
+    time_open = get_streamfile_time_us();
+
+    vgmstream = init_vgmstream_from_STREAMFILE(&sf->sf);
+    time_init = get_streamfile_time_us();
+    if (!vgmstream) goto fail;
+
+    /* the first render should see the stream as a player would (mixing, play config) */
+    input_channels = output_channels = vgmstream->channels;
+    mixing_info(vgmstream, &input_channels, &output_channels);
+    buf = malloc(sizeof(sample_t) * cfg->first_samples * (input_channels > output_channels ? input_channels : output_channels));
+    if (!buf) goto fail;
+
+    vgmstream_set_profiling(vgmstream, 1);
+    get_vgmstream_io_stats(vgmstream, &stats_start);
+    time_render = get_streamfile_time_us();
+    render_vgmstream(buf, cfg->first_samples, vgmstream);
+    res->render_us = (double)(get_streamfile_time_us() - time_render);
+    res->total_us = (double)(get_streamfile_time_us() - time_start);
+
+    vgmstream_get_profile(vgmstream, &profile);
+    get_vgmstream_io_stats(vgmstream, &stats);
+    res->render_read_us = (double)profile.read_time_us;
+    res->render_bytes = stats.bytes_read - stats_start.bytes_read;
+
+    /* detection: what isn't the matching format's init (failed candidates, header buffering) */
+    res->open_us = (double)(time_open - time_start);
+    res->first_read_us = (double)sf->first_read_us;
+    for (i = 0; i < report->profile_count; i++) {
+        res->tries += (int)report->profile[i].tries;
+    }
+    if (vgmstream->init_index > 0 && vgmstream->init_index <= report->profile_count)
+        res->setup_us = (double)report->profile[vgmstream->init_index - 1].time_us;
+    res->detect_us = (double)(time_init - time_open) - res->setup_us;
+    if (res->detect_us < 0)
+        res->detect_us = 0;
+
+    /* the opened file's reads (detection), plus what the stream's own handles read while opening */
+    get_streamfile_stats(&sf->sf, &stats);
+    res->init_bytes = stats.bytes_read + stats_start.bytes_read;
+
+    free(buf);
+    close_streamfile(&sf->sf);
+    return vgmstream;
+fail:
+    free(buf);
+    close_vgmstream(vgmstream);
+    close_streamfile(sf ? &sf->sf : NULL);
+    return NULL;
+}
+
+/* ************************************************************ */
+
+static void print_string(FILE* out, const char* str) {
+    fputc('"', out);
+    for (; *str; str++) {
+        unsigned char c = *str;
+        if (c == '"' || c == '\\')
+            fprintf(out, "\\%c", c);
+        else if (c < 0x20)
+            fprintf(out, "\\u%04x", c);
+        else
+            fputc(c, out);
+    }
+    fputc('"', out);
+}
+
+static void print_results(FILE* out, const bench_result* res) {
+    fprintf(out, ",\"open_us\":%.3f,\"first_read_us\":%.3f,\"detect_us\":%.3f,\"tries\":%i"
+            ",\"setup_us\":%.3f,\"first_render_us\":%.3f,\"first_render_read_us\":%.3f,\"total_us\":%.3f",
+            res->open_us, res->first_read_us, res->detect_us, res->tries,
+            res->setup_us, res->render_us, res->render_read_us, res->total_us);
+}
+
+static int add_group(bench_report* report, VGMSTREAM* vgmstream, const char* meta, const bench_result* res) {
+    bench_group* group = NULL;
+    int i;
+
+    for (i = 0; i < report->group_count; i++) {
+        if (report->groups[i].init_index == vgmstream->init_index) {
+            group = &report->groups[i];
+            break;
+        }
+    }
+
+    if (!group) {
+        if (report->group_count + 1 > report->group_size) {
+            int size = report->group_size ? report->group_size * 2 : 16;
+            bench_group* groups_re = realloc(report->groups, sizeof(bench_group) * size);
+            if (!groups_re) return 0;
+            report->groups = groups_re;
+            report->group_size = size;
+        }
+        group = &report->groups[report->group_count];
+        report->group_count++;
+
+        memset(group, 0, sizeof(bench_group));
+        group->init_index = vgmstream->init_index;
+        snprintf(group->meta, sizeof(group->meta), "%s", meta);
+    }
+
+    group->files++;
+    group->total.open_us += res->open_us;
+    group->total.first_read_us += res->first_read_us;
+    group->total.detect_us += res->detect_us;
+    group->total.setup_us += res->setup_us;
+    group->total.render_us += res->render_us;
+    group->total.render_read_us += res->render_read_us;
+    group->total.total_us += res->total_us;
+    group->total.tries += res->tries;
+    if (res->total_us > group->max_total_us)
+        group->max_total_us = res->total_us;
+    return 1;
+}
+
+/* averages of each group (plus the slowest total) */
+static void print_groups(bench_report* report) {
+    FILE* out = report->cfg->out;
+    int i;
+
+    for (i = 0; i < report->group_count; i++) {
+        bench_group* group = &report->groups[i];
+        bench_result avg = {0};
+
+        avg.open_us = group->total.open_us / group->files;
+        avg.first_read_us = group->total.first_read_us / group->files;
+        avg.detect_us = group->total.detect_us / group->files;
+        avg.setup_us = group->total.setup_us / group->files;
+        avg.render_us = group->total.render_us / group->files;
+        avg.render_read_us = group->total.render_read_us / group->files;
+        avg.total_us = group->total.total_us / group->files;
+        avg.tries = group->total.tries / group->files;
+
+        fprintf(out, "{\"type\":\"summary\",\"meta\":");
+        print_string(out, group->meta);
+        fprintf(out, ",\"init_index\":%i,\"files\":%i", group->init_index, group->files);
+        print_results(out, &avg);
+        fprintf(out, ",\"max_total_us\":%.3f}\n", group->max_total_us);
+    }
+}
+
+static void bench_path_file(bench_report* report, const char* filename) {
+    bench_config* cfg = report->cfg;
+    VGMSTREAM* vgmstream = NULL;
+    bench_result res, best;
+    char coding[128];
+    char meta[128];
+    int i;
+
+    for (i = 0; i < cfg->repeats; i++) {
+        close_vgmstream(vgmstream);
+        vgmstream = bench_file(report, filename, &res);
+        if (!vgmstream)
+            break;
+        if (i == 0 || res.total_us < best.total_us)
+            best = res;
+    }
+    if (!vgmstream) {
+        fprintf(stderr,"failed opening %s\n",filename);
+        report->failed++;
+        return;
+    }
+
+    coding[0] = '\0';
+    get_vgmstream_coding_description(vgmstream, coding, sizeof(coding));
+    coding[sizeof(coding) - 1] = '\0';
+    meta[0] = '\0';
+    get_vgmstream_meta_description(vgmstream, meta, sizeof(meta));
+    meta[sizeof(meta) - 1] = '\0';
+
+    fprintf(cfg->out, "{\"type\":\"file\",\"file\":");
+    print_string(cfg->out, filename);
+    fprintf(cfg->out, ",\"meta\":");
+    print_string(cfg->out, meta);
+    fprintf(cfg->out, ",\"init_index\":%i,\"coding\":", vgmstream->init_index);
+    print_string(cfg->out, coding);
+    fprintf(cfg->out, ",\"channels\":%i,\"sample_rate\":%i", vgmstream->channels, vgmstream->sample_rate);
+    print_results(cfg->out, &best);
+    fprintf(cfg->out, ",\"init_bytes_read\":%llu,\"render_bytes_read\":%llu}\n",
+            (unsigned long long)best.init_bytes, (unsigned long long)best.render_bytes);
+    fflush(cfg->out);
+
+    report->tested++;
+    add_group(report, vgmstream, meta, &best);
+    close_vgmstream(vgmstream);
+}
+
+static void bench_path(bench_report* report, const char* path) {
+    char subpath[PATH_LIMIT];
+    struct stat st;
+
+    if (stat(path, &st) != 0 || !(st.st_mode & S_IFDIR)) {
+        bench_path_file(report, path);
+        return;
+    }
+
+#ifdef WIN32
+    {
+        struct _finddata_t data;
+        intptr_t handle;
+
+        snprintf(subpath, sizeof(subpath), "%s\\*", path);
+        handle = _findfirst(subpath, &data);
+        if (handle == -1)
+            return;
+        do {
+            if (strcmp(data.name, ".") == 0 || strcmp(data.name, "..") == 0)
+                continue;
+            snprintf(subpath, sizeof(subpath), "%s\\%s", path, data.name);
+            bench_path(report, subpath);
+        } while (_findnext(handle, &data) == 0);
+        _findclose(handle);
+    }
+#else
+    {
+        DIR* dir;
+        struct dirent* entry;
+
+        dir = opendir(path);
+        if (!dir)
+            return;
+        while ((entry = readdir(dir)) != NULL) {
+            if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+                continue;
+            snprintf(subpath, sizeof(subpath), "%s/%s", path, entry->d_name);
+            bench_path(report, subpath);
+        }
+        closedir(dir);
+    }
+#endif
+}
+
+
+int main(int argc, char ** argv) {
+    bench_config cfg = {0};
+    bench_report report = {0};
+    const char* outfilename = NULL;
+    int opt, i;
+
+    cfg.io = IO_STDIO;
+    cfg.first_samples = BENCH_FIRST_SAMPLES;
+    cfg.repeats = 1;
+
+    opterr = 0;
+    while ((opt = getopt(argc, argv, "o:i:n:r:s:h")) != -1) {
+        switch (opt) {
+            case 'o':
+                outfilename = optarg;
+                break;
+            case 'i':
+                if (strcmp(optarg, "stdio") == 0)
+                    cfg.io = IO_STDIO;
+                else if (strcmp(optarg, "mmap") == 0)
+                    cfg.io = IO_MMAP;
+                else if (strcmp(optarg, "buffer") == 0)
+                    cfg.io = IO_BUFFER;
+                else if (strcmp(optarg, "memory") == 0)
+                    cfg.io = IO_MEMORY;
+                else {
+                    fprintf(stderr, "Unknown io %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'n':
+                cfg.first_samples = atoi(optarg);
+                break;
+            case 'r':
+                cfg.repeats = atoi(optarg);
+                break;
+            case 's':
+                cfg.stream_index = atoi(optarg);
+                break;
+            case '?':
+                fprintf(stderr, "Unknown option -%c found\n", optopt);
+                return EXIT_FAILURE;
+            default:
+                usage(argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    if (optind >= argc || cfg.first_samples <= 0 || cfg.repeats <= 0) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    cfg.out = stdout;
+    if (outfilename) {
+        cfg.out = fopen(outfilename, "w");
+        if (!cfg.out) {
+            fprintf(stderr,"failed to open %s for output\n",outfilename);
+            return EXIT_FAILURE;
+        }
+    }
+
+    /* counts tried functions and times the matching one */
+    report.profile_count = vgmstream_get_detection_count();
+    report.profile = calloc(report.profile_count, sizeof(vgmstream_detection_profile_t));
+    if (!report.profile) {
+        fprintf(stderr,"failed to allocate detection profile\n");
+        return EXIT_FAILURE;
+    }
+    vgmstream_detection_profile_setup(report.profile);
+
+    report.cfg = &cfg;
+    for (i = optind; i < argc; i++) {
+        bench_path(&report, argv[i]);
+    }
+    print_groups(&report);
+
+    fprintf(stderr, "files: %i tested, %i failed\n", report.tested, report.failed);
+
+    vgmstream_detection_profile_setup(NULL);
+    if (cfg.out != stdout)
+        fclose(cfg.out);
+    free(report.profile);
+    free(report.groups);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,300 @@
+#!/usr/bin/env python3
+
+# ########################################################################### #
+# VGMSTREAM REGRESSION TESTING SCRIPT
+#
+# Portable version of vrts.bat: decodes every file found with two CLI builds
+# and compares wav outputs (bit-exact or within a tolerance) and stdout, plus
+# decode time and peak memory of each, flagging regressions over a threshold.
+# Temp files go to a work dir that is removed when done (unless -nd).
+# ########################################################################### #
+
+import argparse
+import fnmatch
+import os
+import shutil
+import struct
+import subprocess
+import sys
+import tempfile
+import time
+
+IGNORED_EXTS = ['.exe', '.dll', '.zip', '.7z', '.rar', '.bat', '.sh', '.py', '.txt', '.lnk', '.wav']
+
+def parse():
+    description = (
+        "compares output, decode time and memory of two vgmstream CLI builds"
+    )
+    epilog = (
+        "examples:\n"
+        "  %(prog)s -vo old/vgmstream-cli -vn vgmstream-cli -r files/\n"
+        "  - checks that all files in files/ and subdirs decode the same, and report slower ones\n"
+        "  %(prog)s -vo old/test.exe -vn test.exe -t 1 -f *.ogg .\n"
+        "  - allows +-1 sample differences (for float codecs)\n"
+        "  %(prog)s -vo old/test.exe -vn test.exe -P -T 5 -n 3 .\n"
+        "  - only compares decode time (without writing) of the fastest of 3 runs\n"
+    )
+
+    parser = argparse.ArgumentParser(description=description, epilog=epilog, formatter_class=argparse.RawTextHelpFormatter)
+    parser.add_argument("paths", help="files or dirs to test", nargs='*', default=['.'])
+    parser.add_argument("-vo","--cli-old", help="path to old CLI", default="test_old.exe")
+    parser.add_argument("-vn","--cli-new", help="path to new CLI", default="test.exe")
+    parser.add_argument("-f","--filter", help="search wildcard (ex. *.adx)", default="*")
+    parser.add_argument("-r","--recursive", help="search in subdirs", action='store_true')
+    parser.add_argument("-nd","--no-delete", help="don't delete compared files (in work dir)", action='store_true')
+    parser.add_argument("-nc","--no-correct", help="don't report correct files", action='store_true')
+    parser.add_argument("-w","--work-dir", help="dir for temp output (default: new temp dir)")
+    parser.add_argument("-t","--tolerance", help="max difference per 16-bit sample (default 0: bit-exact)", type=int, default=0)
+    parser.add_argument("-P","--performance", help="decode without writing and only compare time/memory", action='store_true')
+    parser.add_argument("-n","--repeats", help="decode N times and take the fastest (default 1)", type=int, default=1)
+    parser.add_argument("-T","--time-threshold", help="flag files N%% slower (default 10)", type=float, default=10.0)
+    parser.add_argument("-Tm","--time-min", help="ignore time changes under N ms (default 20)", type=float, default=20.0)
+    parser.add_argument("-M","--memory-threshold", help="flag files using N%% more memory (default 10)", type=float, default=10.0)
+    parser.add_argument("-a","--cli-args", help="extra args passed to both CLIs (ex. \"-l 1 -F\")", default="")
+    return parser.parse_args()
+
+
+# ########################################################################### #
+
+def find_files(paths, pattern, recursive):
+    files = []
+    for path in paths:
+        if os.path.isfile(path):
+            files.append(path)
+            continue
+
+        for root, dirnames, filenames in os.walk(path):
+            dirnames.sort()
+            for filename in sorted(fnmatch.filter(filenames, pattern)):
+                if filename.startswith('.'):
+                    continue
+                if os.path.splitext(filename)[1].lower() in IGNORED_EXTS:
+                    continue
+                files.append(os.path.join(root, filename))
+
+            if not recursive:
+                break
+    return files
+
+# peak RSS in KB of a finished child (only on systems with wait4, None elsewhere)
+def get_rss_kb(rusage):
+    if sys.platform == 'darwin':
+        return rusage.ru_maxrss // 1024 # bytes
+    return rusage.ru_maxrss
+
+class RunResult(object):
+    def __init__(self):
+        self.code = -1
+        self.time_ms = 0.0
+        self.rss_kb = None
+
+def run_cli(cmd, stdout_name):
+    result = RunResult()
+    with open(stdout_name, 'wb') as stdout:
+        time_start = time.perf_counter()
+        proc = subprocess.Popen(cmd, stdout=stdout, stderr=subprocess.STDOUT)
+        if hasattr(os, 'wait4'):
+            pid, status, rusage = os.wait4(proc.pid, 0)
+            result.time_ms = (time.perf_counter() - time_start) * 1000.0
+            result.rss_kb = get_rss_kb(rusage)
+            proc.returncode = os.WEXITSTATUS(status) if os.WIFEXITED(status) else -1
+        else:
+            proc.wait()
+            result.time_ms = (time.perf_counter() - time_start) * 1000.0
+        result.code = proc.returncode
+    return result
+
+def run_cli_repeats(args, cli, filename, wav_name, txt_name):
+    cmd = [cli] + args.cli_args.split()
+    if args.performance:
+        cmd += ['-O', filename]
+    else:
+        cmd += ['-o', wav_name, filename]
+
+    # fastest time (less noise from other processes) but max memory
+    best = run_cli(cmd, txt_name)
+    for _ in range(args.repeats - 1):
+        result = run_cli(cmd, txt_name)
+        best.time_ms = min(best.time_ms, result.time_ms)
+        if result.rss_kb is not None:
+            best.rss_kb = max(best.rss_kb, result.rss_kb)
+    return best
+
+
+# ########################################################################### #
+
+# returns (format, data) of a RIFF wav, or None
+def read_wav(filename):
+    with open(filename, 'rb') as f:
+        data = f.read()
+    if len(data) < 0x0c or data[0:4] != b'RIFF' or data[8:12] != b'WAVE':
+        return None
+
+    fmt = None
+    offset = 0x0c
+    while offset + 0x08 <= len(data):
+        chunk_id = data[offset:offset+4]
+        chunk_size, = struct.unpack('<I', data[offset+4:offset+8])
+        if chunk_id == b'fmt ':
+            fmt = data[offset+8:offset+8+chunk_size]
+        elif chunk_id == b'data':
+            return (fmt, data[offset+8:offset+8+chunk_size])
+        offset += 0x08 + chunk_size + (chunk_size & 1)
+    return None
+
+# max difference between 16-bit samples, or None if not comparable
+def get_max_diff(wav_old, wav_new):
+    old = read_wav(wav_old)
+    new = read_wav(wav_new)
+    if not old or not new or old[0] != new[0] or len(old[1]) != len(new[1]):
+        return None
+
+    count = len(old[1]) // 2
+    samples_old = struct.unpack('<%ih' % count, old[1][:count*2])
+    samples_new = struct.unpack('<%ih' % count, new[1][:count*2])
+    max_diff = 0
+    for s_old, s_new in zip(samples_old, samples_new):
+        diff = abs(s_old - s_new)
+        if diff > max_diff:
+            max_diff = diff
+    return max_diff
+
+def files_equal(file_a, file_b):
+    if os.path.getsize(file_a) != os.path.getsize(file_b):
+        return False
+    with open(file_a, 'rb') as fa, open(file_b, 'rb') as fb:
+        while True:
+            buf_a = fa.read(0x100000)
+            buf_b = fb.read(0x100000)
+            if buf_a != buf_b:
+                return False
+            if not buf_a:
+                return True
+
+def delete_files(filenames):
+    for filename in filenames:
+        if os.path.exists(filename):
+            os.remove(filename)
+
+
+# ########################################################################### #
+
+class Report(object):
+    def __init__(self):
+        self.files_ok = 0
+        self.files_ko = 0
+        self.time_ko = 0
+        self.memory_ko = 0
+        self.time_old_ms = 0.0
+        self.time_new_ms = 0.0
+
+def compare_perf(args, report, old, new):
+    issues = []
+
+    report.time_old_ms += old.time_ms
+    report.time_new_ms += new.time_ms
+    if new.time_ms - old.time_ms > args.time_min and new.time_ms > old.time_ms * (1.0 + args.time_threshold / 100.0):
+        issues.append("time %.0f > %.0f ms" % (new.time_ms, old.time_ms))
+        report.time_ko += 1
+
+    if old.rss_kb and new.rss_kb and new.rss_kb > old.rss_kb * (1.0 + args.memory_threshold / 100.0):
+        issues.append("memory %i > %i KB" % (new.rss_kb, old.rss_kb))
+        report.memory_ko += 1
+
+    return issues
+
+def process_file(args, report, work_dir, index, filename):
+    base = os.path.join(work_dir, "%06i_%s" % (index, os.path.basename(filename)))
+    wav_old = base + ".old.wav"
+    txt_old = base + ".old.txt"
+    wav_new = base + ".new.wav"
+    txt_new = base + ".new.txt"
+
+    old = run_cli_repeats(args, args.cli_old, filename, wav_old, txt_old)
+    new = run_cli_repeats(args, args.cli_new, filename, wav_new, txt_new)
+
+    # unsupported formats (nothing created or both failed)
+    if args.performance:
+        if old.code != 0 and new.code != 0:
+            delete_files([txt_old, txt_new])
+            return
+    elif not os.path.exists(wav_old) and not os.path.exists(wav_new):
+        delete_files([txt_old, txt_new])
+        return
+
+    issues = []
+    is_ko = True
+    if args.performance:
+        if old.code != new.code:
+            issues.append("exit codes %i/%i" % (old.code, new.code))
+        else:
+            is_ko = False
+    elif not os.path.exists(wav_old) or not os.path.exists(wav_new):
+        issues.append("wav missing")
+    elif not files_equal(wav_old, wav_new):
+        max_diff = get_max_diff(wav_old, wav_new) if args.tolerance > 0 else None
+        if max_diff is None or max_diff > args.tolerance:
+            issues.append("wav diffs")
+        else:
+            issues.append("wav diffs within tolerance (max %i)" % (max_diff))
+            is_ko = False
+    else:
+        is_ko = False
+
+    if not args.performance and not files_equal(txt_old, txt_new):
+        issues.append("txt diffs")
+    issues += compare_perf(args, report, old, new)
+
+    if is_ko:
+        report.files_ko += 1
+    else:
+        report.files_ok += 1
+
+    if issues:
+        print("%s: %s" % (filename, ", ".join(issues)))
+    elif not args.no_correct:
+        print("%s: no diffs (%.0f/%.0f ms)" % (filename, old.time_ms, new.time_ms))
+    sys.stdout.flush()
+
+    if not args.no_delete:
+        delete_files([wav_old, txt_old, wav_new, txt_new])
+
+
+def main():
+    args = parse()
+
+    for cli in [args.cli_old, args.cli_new]:
+        if not shutil.which(cli) and not os.path.isfile(cli):
+            print("VRTS: CLI %s not found" % (cli))
+            return 1
+
+    files = find_files(args.paths, args.filter, args.recursive)
+    if not files:
+        print("VRTS: no files found")
+        return 1
+
+    work_dir = args.work_dir or tempfile.mkdtemp(prefix="vrts_")
+    if not os.path.exists(work_dir):
+        os.makedirs(work_dir)
+
+    report = Report()
+    time_start = time.perf_counter()
+    print("VRTS: start (%i files)" % (len(files)))
+
+    try:
+        for index, filename in enumerate(files):
+            process_file(args, report, work_dir, index, filename)
+    finally:
+        if not args.no_delete and not args.work_dir:
+            shutil.rmtree(work_dir, ignore_errors=True)
+
+    print("VRTS: done (%.2fs)" % (time.perf_counter() - time_start))
+    print("VRTS: ok=%i, ko=%i, slower=%i, bigger=%i, decode time old=%.0f ms, new=%.0f ms" % (
+            report.files_ok, report.files_ko, report.time_ko, report.memory_ko, report.time_old_ms, report.time_new_ms))
+
+    if report.files_ko or report.time_ko or report.memory_ko:
+        return 1
+    return 0
+
+if __name__ == "__main__":
+    sys.exit(main())
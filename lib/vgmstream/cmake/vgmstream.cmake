@@ -24,6 +24,13 @@ macro(setup_target TARGET)
 		target_link_libraries(${TARGET} m)
 	endif()
 
+	if(USE_TSAN)
+		target_compile_options(${TARGET} PRIVATE -fsanitize=thread -g)
+		if(LINK)
+			target_link_libraries(${TARGET} -fsanitize=thread)
+		endif()
+	endif()
+
 	if(USE_MPEG)
 		target_compile_definitions(${TARGET} PRIVATE VGM_USE_MPEG)
 		if(WIN32)
@@ -58,8 +58,7 @@ typedef struct stChannel {
 
     float gain[HCA_SAMPLES_PER_SUBFRAME];                   /* gain to apply to quantized spectral data */
     float spectra[HCA_SAMPLES_PER_SUBFRAME];                /* resulting dequantized data */
-    float temp[HCA_SAMPLES_PER_SUBFRAME];                   /* temp for DCT-IV */
-    float dct[HCA_SAMPLES_PER_SUBFRAME];                    /* result of DCT-IV */
+    float temp[HCA_SAMPLES_PER_SUBFRAME];                   /* temp for DCT-IV (result ends in spectra) */
     float imdct_previous[HCA_SAMPLES_PER_SUBFRAME];         /* IMDCT */
 
     /* frame state */
@@ -284,25 +283,30 @@ int clHCA_getInfo(clHCA *hca, clHCA_stInfo *info) {
 
 void clHCA_ReadSamples16(clHCA *hca, signed short *samples) {
     const float scale = 32768.0f;
+    const unsigned int channels = hca->channels;
     float f;
     signed int s;
-    unsigned int i, j, k;
-
-    for (i = 0; i < HCA_SUBFRAMES_PER_FRAME; i++) {
-        for (j = 0; j < HCA_SAMPLES_PER_SUBFRAME; j++) {
-            for (k = 0; k < hca->channels; k++) {
-                f = hca->channel[k].wave[i][j];
-                //f = f * hca->rva_volume; /* rare, won't apply for now */
-                if (f > 1.0f) {
-                    f = 1.0f;
-                } else if (f < -1.0f) {
-                    f = -1.0f;
-                }
-                s = (signed int) (f * scale);
-                if ((unsigned) (s + 0x8000) & 0xFFFF0000)
-                    s = (s >> 31) ^ 0x7FFF;
-                *samples++ = (signed short) s;
+    unsigned int i, k;
+
+    /* walk each channel's wave linearly (subframes are contiguous) and write interleaved,
+     * rather than hopping between channel structs for every sample */
+    for (k = 0; k < channels; k++) {
+        const float *wave = &hca->channel[k].wave[0][0];
+        signed short *out = samples + k;
+
+        for (i = 0; i < HCA_SUBFRAMES_PER_FRAME * HCA_SAMPLES_PER_SUBFRAME; i++) {
+            f = wave[i];
+            //f = f * hca->rva_volume; /* rare, won't apply for now */
+            if (f > 1.0f) {
+                f = 1.0f;
+            } else if (f < -1.0f) {
+                f = -1.0f;
             }
+            s = (signed int) (f * scale);
+            if ((unsigned) (s + 0x8000) & 0xFFFF0000)
+                s = (s >> 31) ^ 0x7FFF;
+            *out = (signed short) s;
+            out += channels;
         }
     }
 }
@@ -1013,7 +1017,6 @@ void clHCA_DecodeReset(clHCA * hca) {
         //memset(ch->gain, 0, sizeof(ch->gain[0]) * HCA_SAMPLES_PER_SUBFRAME);
         //memset(ch->spectra, 0, sizeof(ch->spectra[0]) * HCA_SAMPLES_PER_SUBFRAME);
         //memset(ch->temp, 0, sizeof(ch->temp[0]) * HCA_SAMPLES_PER_SUBFRAME);
-        //memset(ch->dct, 0, sizeof(ch->dct[0]) * HCA_SAMPLES_PER_SUBFRAME);
         memset(ch->imdct_previous, 0, sizeof(ch->imdct_previous[0]) * HCA_SAMPLES_PER_SUBFRAME);
         //memset(ch->wave, 0, sizeof(ch->wave[0][0]) * HCA_SUBFRAMES_PER_FRAME * HCA_SUBFRAMES_PER_FRAME);
     }
@@ -1639,22 +1642,22 @@ static void decoder5_run_imdct(stChannel *ch, int subframe) {
             count2b = count2b << 1;
         }
 
-        /* copy dct */
-        /* (with the above optimization spectra is already modified, so this is redundant) */
-        for (i = 0; i < size; i++) {
-            ch->dct[i] = ch->spectra[i];
-        }
+        /* (odd number of passes, so the DCT result ends in spectra and needs no extra copy) */
     }
 
     /* update output/imdct */
     {
         unsigned int i;
+        const float *dct = ch->spectra;
+        const float *window = decode5_imdct_window;
+        float *wave = ch->wave[subframe];
+        float *imdct_previous = ch->imdct_previous;
 
         for (i = 0; i < half; i++) {
-            ch->wave[subframe][i] = decode5_imdct_window[i] * ch->dct[i + half] + ch->imdct_previous[i];
-            ch->wave[subframe][i + half] = decode5_imdct_window[i + half] * ch->dct[size - 1 - i] - ch->imdct_previous[i + half];
-            ch->imdct_previous[i] = decode5_imdct_window[size - 1 - i] * ch->dct[half - i - 1];
-            ch->imdct_previous[i + half] = decode5_imdct_window[half - i - 1] * ch->dct[i];
+            wave[i] = window[i] * dct[i + half] + imdct_previous[i];
+            wave[i + half] = window[i + half] * dct[size - 1 - i] - imdct_previous[i + half];
+            imdct_previous[i] = window[size - 1 - i] * dct[half - i - 1];
+            imdct_previous[i + half] = window[half - i - 1] * dct[i];
         }
 #if 0
         /* over-optimized IMDCT (for reference), barely noticeable even when decoding hundred of files */
@@ -1663,7 +1666,7 @@ static void decoder5_run_imdct(stChannel *ch, int subframe) {
         float *imdct_previous;
         float *wave = ch->wave[subframe];
 
-        dct = &ch->dct[half];
+        dct = &ch->spectra[half];
         imdct_previous = ch->imdct_previous;
         for (i = 0; i < half; i++) {
             *(wave++) = *(dct++) * *(imdct_window++) + *(imdct_previous++);
@@ -1672,7 +1675,7 @@ static void decoder5_run_imdct(stChannel *ch, int subframe) {
             *(wave++) = *(imdct_window++) * *(--dct) - *(imdct_previous++);
         }
         /* implicit: imdct_window pointer is now at end */
-        dct = &ch->dct[half - 1];
+        dct = &ch->spectra[half - 1];
         imdct_previous = ch->imdct_previous;
         for (i = 0; i < half; i++) {
             *(imdct_previous++) = *(--imdct_window) * *(dct--);
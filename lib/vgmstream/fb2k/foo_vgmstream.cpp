@@ -316,7 +316,6 @@ bool input_vgmstream::decode_run(audio_chunk & p_chunk,abort_callback & p_abort)
 // called when seeking
 void input_vgmstream::decode_seek(double p_seconds,abort_callback & p_abort) {
     seek_pos_samples = (int) audio_math::time_to_samples(p_seconds, vgmstream->sample_rate);
-    int max_buffer_samples = SAMPLE_BUFFER_SIZE;
     bool loop_okay = config.song_play_forever && vgmstream->loop_flag && !config.song_ignore_loop && !force_ignore_loop;
 
     // possible when disabling looping without refreshing foobar's cached song length
@@ -342,30 +341,18 @@ void input_vgmstream::decode_seek(double p_seconds,abort_callback & p_abort) {
         if (corrected_pos_samples > (seek_pos_samples - decode_pos_samples))
             corrected_pos_samples = seek_pos_samples;
     }
-    // Reset of backwards seek
-    else if(corrected_pos_samples < decode_pos_samples) {
-        reset_vgmstream(vgmstream);
-        apply_config(vgmstream, &config); /* config is undone by reset */
-        decode_pos_samples = 0;
-    }
-
     // seeking overrun = bad
     if (corrected_pos_samples > stream_length_samples)
         corrected_pos_samples = stream_length_samples;
 
-    while(decode_pos_samples < corrected_pos_samples) {
-        int seek_samples = max_buffer_samples;
-        if ((decode_pos_samples + max_buffer_samples >= stream_length_samples) && !loop_okay)
-            seek_samples = stream_length_samples - seek_pos_samples;
-        if (decode_pos_samples + max_buffer_samples > seek_pos_samples)
-            seek_samples = seek_pos_samples - decode_pos_samples;
-
-        decode_pos_samples += seek_samples;
-        render_vgmstream(sample_buffer, seek_samples, vgmstream);
+    // jumps or decodes forward as needed (resetting first if going backwards)
+    seek_vgmstream(vgmstream, corrected_pos_samples);
+    if (corrected_pos_samples < decode_pos_samples) {
+        apply_config(vgmstream, &config); /* config may be undone by reset */
     }
 
     // seek may have been clamped to skip unneeded loops, adjust as some internals need this value
-    vgmstream->loop_count = loop_count; //todo make seek_vgmstream, not ok if seeking in fade section with ignore_fade
+    vgmstream->loop_count = loop_count; //todo not ok if seeking in fade section with ignore_fade
 
     // remove seek loop correction from counter so file ends correctly
     decode_pos_samples = seek_pos_samples;
@@ -560,36 +547,36 @@ void input_vgmstream::set_config_defaults(foobar_song_config *current) {
 void input_vgmstream::apply_config(VGMSTREAM* vgmstream, foobar_song_config* cfg) {
 
     /* honor suggested config (order matters, and config mixes with/overwrites player defaults) */
-    if (vgmstream->config.play_forever) {
+    if (vgmstream->config->play_forever) {
         cfg->song_play_forever = 1;
         cfg->song_ignore_loop = 0;
     }
-    if (vgmstream->config.loop_count_set) {
-        cfg->song_loop_count = vgmstream->config.loop_count;
+    if (vgmstream->config->loop_count_set) {
+        cfg->song_loop_count = vgmstream->config->loop_count;
         cfg->song_play_forever = 0;
         cfg->song_ignore_loop = 0;
     }
-    if (vgmstream->config.fade_delay_set) {
-        cfg->song_fade_delay = vgmstream->config.fade_delay;
+    if (vgmstream->config->fade_delay_set) {
+        cfg->song_fade_delay = vgmstream->config->fade_delay;
     }
-    if (vgmstream->config.fade_time_set) {
-        cfg->song_fade_time = vgmstream->config.fade_time;
+    if (vgmstream->config->fade_time_set) {
+        cfg->song_fade_time = vgmstream->config->fade_time;
     }
-    if (vgmstream->config.ignore_fade) {
+    if (vgmstream->config->ignore_fade) {
         cfg->song_ignore_fade = 1;
     }
 
-    if (vgmstream->config.force_loop) {
+    if (vgmstream->config->force_loop) {
         cfg->song_ignore_loop = 0;
         cfg->song_force_loop = 1;
         cfg->song_really_force_loop = 0;
     }
-    if (vgmstream->config.really_force_loop) {
+    if (vgmstream->config->really_force_loop) {
         cfg->song_ignore_loop = 0;
         cfg->song_force_loop = 0;
         cfg->song_really_force_loop = 1;
     }
-    if (vgmstream->config.ignore_loop) {
+    if (vgmstream->config->ignore_loop) {
         cfg->song_ignore_loop = 1;
         cfg->song_force_loop = 0;
         cfg->song_really_force_loop = 0;
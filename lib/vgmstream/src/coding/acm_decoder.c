@@ -86,6 +86,14 @@ void reset_acm(acm_codec_data *data) {
     acm_seek_pcm(data->handle, 0);
 }
 
+/* jumps to the closest block already decoded (libacm keeps seek points as it goes) and decodes from there */
+void seek_acm(acm_codec_data *data, int32_t num_sample) {
+    if (!data || !data->handle)
+        return;
+
+    acm_seek_pcm(data->handle, num_sample);
+}
+
 void free_acm(acm_codec_data *data) {
     if (!data)
         return;
@@ -96,6 +104,67 @@ void free_acm(acm_codec_data *data) {
     free(data);
 }
 
+/* libacm stream (pointers kept on restore), its read buffer and current block, plus read offset */
+typedef struct {
+    ACMStream acm;
+    int offset;
+} acm_state_t;
+
+void* save_acm(acm_codec_data *data, size_t *size) {
+    ACMStream *acm;
+    acm_state_t *state;
+    uint8_t *buf;
+    size_t block_size, wrapbuf_size;
+    if (!data || !data->handle) return NULL;
+
+    acm = data->handle;
+    block_size = acm->block_len * sizeof(int);
+    wrapbuf_size = acm->wrapbuf_len * sizeof(int);
+    state = malloc(sizeof(acm_state_t) + acm->buf_size + block_size + wrapbuf_size);
+    if (!state) return NULL;
+
+    state->acm = *acm;
+    state->offset = ((acm_io_config*)data->io_config)->offset;
+    buf = (uint8_t*)(state + 1);
+    memcpy(buf, acm->buf, acm->buf_size);
+    memcpy(buf + acm->buf_size, acm->block, block_size);
+    memcpy(buf + acm->buf_size + block_size, acm->wrapbuf, wrapbuf_size);
+    *size = sizeof(acm_state_t) + acm->buf_size + block_size + wrapbuf_size;
+    return state;
+}
+
+void restore_acm(acm_codec_data *data, const void *state) {
+    const acm_state_t *saved = state;
+    const uint8_t *buf;
+    ACMStream *acm;
+    ACMStream current;
+    size_t block_size, wrapbuf_size;
+    if (!data || !data->handle || !state) return;
+
+    acm = data->handle;
+    current = *acm;
+    *acm = saved->acm;
+    acm->io_arg = current.io_arg;
+    acm->io = current.io;
+    acm->buf = current.buf;
+    acm->block = current.block;
+    acm->wrapbuf = current.wrapbuf;
+    acm->ampbuf = current.ampbuf;
+    acm->midbuf = current.midbuf; /* tables are regenerated per block */
+    acm->seek_points = current.seek_points; /* seek points only grow */
+    acm->seek_wrapbufs = current.seek_wrapbufs;
+    acm->seek_count = current.seek_count;
+    acm->seek_max = current.seek_max;
+    ((acm_io_config*)data->io_config)->offset = saved->offset;
+
+    block_size = acm->block_len * sizeof(int);
+    wrapbuf_size = acm->wrapbuf_len * sizeof(int);
+    buf = (const uint8_t*)(saved + 1);
+    memcpy(acm->buf, buf, acm->buf_size);
+    memcpy(acm->block, buf + acm->buf_size, block_size);
+    memcpy(acm->wrapbuf, buf + acm->buf_size + block_size, wrapbuf_size);
+}
+
 /* ******************************* */
 
 static int acm_read_streamfile(void *ptr, int size, int n, void *arg) {
@@ -25,6 +25,7 @@
 #include <string.h>
 
 #include "acm_decoder_libacm.h" //"libacm.h"//vgmstream mod
+#include "../cpu.h"
 
 #define ACM_BUFLEN	(64*1024)
 
@@ -169,33 +170,6 @@ static const int map_1bit[] = { -1, +1 };
 static const int map_2bit_near[] = { -2, -1, +1, +2 };
 static const int map_2bit_far[] = { -3, -2, +2, +3 };
 static const int map_3bit[] = { -4, -3, -2, -1, +1, +2, +3, +4 };
-static int mul_3x3[3*3*3];
-static int mul_3x5[5*5*5]; 
-static int mul_2x11[11*11];
-static int tables_generated;
-
-static void generate_tables(void)
-{
-	int x1, x2, x3;
-	if (tables_generated)
-		return;
-	for (x3 = 0; x3 < 3; x3++)
-		for (x2 = 0; x2 < 3; x2++)
-			for (x1 = 0; x1 < 3; x1++)
-				mul_3x3[x1 + x2*3 + x3*3*3] = 
-					x1 + (x2 << 4) + (x3 << 8);
-	for (x3 = 0; x3 < 5; x3++)
-		for (x2 = 0; x2 < 5; x2++)
-			for (x1 = 0; x1 < 5; x1++)
-				mul_3x5[x1 + x2*5 + x3*5*5] = 
-					x1 + (x2 << 4) + (x3 << 8);
-	for (x2 = 0; x2 < 11; x2++)
-		for (x1 = 0; x1 < 11; x1++)
-			mul_2x11[x1 + x2*11] = x1 + (x2 << 4);
-
-	tables_generated = 1;
-}
-
 /* IOW: (r * acm->subblock_len) + c */
 #define set_pos(acm, r, c, idx) do { \
 		unsigned _pos = ((r) << acm->info.acm_level) + (c); \
@@ -231,199 +205,110 @@ static int f_linear(ACMStream *acm, unsigned ind, unsigned col)
 	return 1;
 }
 
-static int f_k13(ACMStream *acm, unsigned ind, unsigned col)
-{
-	unsigned i, b;
-	for (i = 0; i < acm->info.acm_rows; i++) {
-		GET_BITS(b, acm, 1);
-		if (b == 0) {
-			/* 0 */
-			set_pos(acm, i++, col, 0);
-			if (i >= acm->info.acm_rows)
-				break;
-			set_pos(acm, i, col, 0);
-			continue;
-		}
-		GET_BITS(b, acm, 1);
-		if (b == 0) {
-			/* 1, 0 */
-			set_pos(acm, i, col, 0);
-			continue;
-		}
-		/* 1, 1, ? */
-		GET_BITS(b, acm, 1);
-		set_pos(acm, i, col, map_1bit[b]);
-	}
-	return 1;
-}
+/*
+ * vgmstream mod: k* fillers as table lookups. Each k* code is a short prefix code,
+ * so the next (up to 5) bits index a table with the code's length, value and
+ * whether it stands for two zeros. Tables are built once per stream from k_code.
+ */
+#define FILL_LUT_FIRST	17
+#define FILL_LUT_LEN(e)	((e) & 7)
+#define FILL_LUT_PAIR(e)	(((e) >> 3) & 1)
+#define FILL_LUT_VAL(e)	((int)((e) >> 4) - 4)
+
+/* max code bits per filler (0 = not a table filler) */
+static const unsigned char fill_lut_bits[11] = {
+	3, 2, 0, 4, 3,		/* 17..21: k13 k12 t15 k24 k23 */
+	0, 5, 4, 0, 5,		/* 22..26: t27 k35 k34 bad k45 */
+	4			/* 27: k44 */
+};
 
-static int f_k12(ACMStream *acm, unsigned ind, unsigned col)
-{
-	unsigned i, b;
-	for (i = 0; i < acm->info.acm_rows; i++) {
-		GET_BITS(b, acm, 1);
-		if (b == 0) {
-			/* 0 */
-			set_pos(acm, i, col, 0);
-			continue;
-		}
-		
-		/* 1, ? */
-		GET_BITS(b, acm, 1);
-		set_pos(acm, i, col, map_1bit[b]);
+/* decodes the code in the low bits of x, returns its length */
+static unsigned k_code(unsigned ind, unsigned x, int *val, int *pair)
+{
+	unsigned b0 = x & 1, b1 = (x >> 1) & 1, b2 = (x >> 2) & 1;
+
+	*val = 0;
+	*pair = 0;
+	switch (ind) {
+	case 17: /* k13 */
+		if (b0 == 0) { *pair = 1; return 1; }	/* 0 */
+		if (b1 == 0) return 2;			/* 1, 0 */
+		*val = map_1bit[b2]; return 3;		/* 1, 1, ? */
+	case 18: /* k12 */
+		if (b0 == 0) return 1;			/* 0 */
+		*val = map_1bit[b1]; return 2;		/* 1, ? */
+	case 20: /* k24 */
+		if (b0 == 0) { *pair = 1; return 1; }	/* 0 */
+		if (b1 == 0) return 2;			/* 1, 0 */
+		*val = map_2bit_near[(x >> 2) & 3]; return 4; /* 1, 1, ?, ? */
+	case 21: /* k23 */
+		if (b0 == 0) return 1;			/* 0 */
+		*val = map_2bit_near[(x >> 1) & 3]; return 3; /* 1, ?, ? */
+	case 23: /* k35 */
+		if (b0 == 0) { *pair = 1; return 1; }	/* 0 */
+		if (b1 == 0) return 2;			/* 1, 0 */
+		if (b2 == 0) { *val = map_1bit[(x >> 3) & 1]; return 4; } /* 1, 1, 0, ? */
+		*val = map_2bit_far[(x >> 3) & 3]; return 5; /* 1, 1, 1, ?, ? */
+	case 24: /* k34 */
+		if (b0 == 0) return 1;			/* 0 */
+		if (b1 == 0) { *val = map_1bit[b2]; return 3; } /* 1, 0, ? */
+		*val = map_2bit_far[(x >> 2) & 3]; return 4; /* 1, 1, ?, ? */
+	case 26: /* k45 */
+		if (b0 == 0) { *pair = 1; return 1; }	/* 0 */
+		if (b1 == 0) return 2;			/* 1, 0 */
+		*val = map_3bit[(x >> 2) & 7]; return 5; /* 1, 1, ?, ?, ? */
+	case 27: /* k44 */
+		if (b0 == 0) return 1;			/* 0 */
+		*val = map_3bit[(x >> 1) & 7]; return 4; /* 1, ?, ?, ? */
+	default:
+		return 0;
 	}
-	return 1;
 }
 
-static int f_k24(ACMStream *acm, unsigned ind, unsigned col)
+static void init_fill_tables(ACMStream *acm)
 {
-	unsigned i, b;
-	for (i = 0; i < acm->info.acm_rows; i++) {
-		GET_BITS(b, acm, 1);
-		if (b == 0) {
-			/* 0 */
-			set_pos(acm, i++, col, 0);
-			if (i >= acm->info.acm_rows) break;
-			set_pos(acm, i, col, 0);
-			continue;
-		}
-		
-		GET_BITS(b, acm, 1);
-		if (b == 0) {
-			/* 1, 0 */
-			set_pos(acm, i, col, 0);
-			continue;
-		}
-		
-		/* 1, 1, ?, ? */
-		GET_BITS(b, acm, 2);
-		set_pos(acm, i, col, map_2bit_near[b]);
-	}
-	return 1;
-}
+	unsigned t, x;
+	int val, pair;
 
-static int f_k23(ACMStream *acm, unsigned ind, unsigned col)
-{
-	unsigned i, b;
-	for (i = 0; i < acm->info.acm_rows; i++) {
-		GET_BITS(b, acm, 1);
-		if (b == 0) {
-			/* 0 */
-			set_pos(acm, i, col, 0);
-			continue;
+	for (t = 0; t < 11; t++) {
+		for (x = 0; x < (1u << fill_lut_bits[t]); x++) {
+			unsigned len = k_code(t + FILL_LUT_FIRST, x, &val, &pair);
+			acm->fill_lut[t][x] = len | (pair << 3) | ((val + 4) << 4);
 		}
-
-		/* 1, ?, ? */
-		GET_BITS(b, acm, 2);
-		set_pos(acm, i, col, map_2bit_near[b]);
 	}
-	return 1;
 }
 
-static int f_k35(ACMStream *acm, unsigned ind, unsigned col)
+static int f_table(ACMStream *acm, unsigned ind, unsigned col)
 {
-	unsigned i, b;
-	for (i = 0; i < acm->info.acm_rows; i++) {
-		GET_BITS(b, acm, 1);
-		if (b == 0) {
-			/* 0 */
-			set_pos(acm, i++, col, 0);
-			if (i >= acm->info.acm_rows)
-				break;
-			set_pos(acm, i, col, 0);
-			continue;
-		}
-		
-		GET_BITS(b, acm, 1);
-		if (b == 0) {
-			/* 1, 0 */
-			set_pos(acm, i, col, 0);
-			continue;
-		}
-		
-		GET_BITS(b, acm, 1);
-		if (b == 0) {
-			/* 1, 1, 0, ? */
-			GET_BITS(b, acm, 1);
-			set_pos(acm, i, col, map_1bit[b]);
-			continue;
-		}
-		
-		/* 1, 1, 1, ?, ? */
-		GET_BITS(b, acm, 2);
-		set_pos(acm, i, col, map_2bit_far[b]);
-	}
-	return 1;
-}
+	const unsigned short *lut = acm->fill_lut[ind - FILL_LUT_FIRST];
+	unsigned bits = fill_lut_bits[ind - FILL_LUT_FIRST];
+	unsigned mask = (1 << bits) - 1;
+	unsigned i, e, len, x, b;
 
-static int f_k34(ACMStream *acm, unsigned ind, unsigned col)
-{
-	unsigned i, b;
 	for (i = 0; i < acm->info.acm_rows; i++) {
-		GET_BITS(b, acm, 1);
-		if (b == 0) {
-			/* 0 */
-			set_pos(acm, i, col, 0);
-			continue;
-		}
-		
-		GET_BITS(b, acm, 1);
-		if (b == 0) {
-			/* 1, 0, ? */
-			GET_BITS(b, acm, 1);
-			set_pos(acm, i, col, map_1bit[b]);
-			continue;
+		if (acm->bit_avail >= bits) {
+			e = lut[acm->bit_data & mask];
+			len = FILL_LUT_LEN(e);
+			acm->bit_data >>= len;
+			acm->bit_avail -= len;
+		} else {
+			/* near a reload: read bits until the prefix is a whole code */
+			x = 0;
+			len = 0;
+			do {
+				GET_BITS(b, acm, 1);
+				x |= b << len;
+				len++;
+				e = lut[x];
+			} while (FILL_LUT_LEN(e) != len);
 		}
-		
-		/* 1, 1, ?, ? */
-		GET_BITS(b, acm, 2);
-		set_pos(acm, i, col, map_2bit_far[b]);
-	}
-	return 1;
-}
 
-static int f_k45(ACMStream *acm, unsigned ind, unsigned col)
-{
-	unsigned i, b;
-	for (i = 0; i < acm->info.acm_rows; i++) {
-		GET_BITS(b, acm, 1);
-		if (b == 0) {
-			/* 0 */
-			set_pos(acm, i, col, 0); i++;
-			if (i >= acm->info.acm_rows)
+		set_pos(acm, i, col, FILL_LUT_VAL(e));
+		if (FILL_LUT_PAIR(e)) {
+			if (++i >= acm->info.acm_rows)
 				break;
 			set_pos(acm, i, col, 0);
-			continue;
-		} 
-		
-		GET_BITS(b, acm, 1);
-		if (b == 0) {
-			/* 1, 0 */
-			set_pos(acm, i, col, 0);
-			continue;
 		}
-		
-		/* 1, 1, ?, ?, ? */
-		GET_BITS(b, acm, 3);
-		set_pos(acm, i, col, map_3bit[b]);
-	}
-	return 1;
-}
-
-static int f_k44(ACMStream *acm, unsigned ind, unsigned col)
-{
-	unsigned i, b;
-	for (i = 0; i < acm->info.acm_rows; i++) {
-		GET_BITS(b, acm, 1);
-		if (b == 0) {
-			/* 0 */
-			set_pos(acm, i, col, 0);
-			continue;
-		}
-		
-		/* 1, ?, ?, ? */
-		GET_BITS(b, acm, 3);
-		set_pos(acm, i, col, map_3bit[b]);
 	}
 	return 1;
 }
@@ -436,9 +321,9 @@ static int f_t15(ACMStream *acm, unsigned ind, unsigned col)
 		/* b = (x1) + (x2 * 3) + (x3 * 9) */
 		GET_BITS(b, acm, 5);
 		
-		n1 =  (mul_3x3[b] & 0x0F) - 1;
-		n2 = ((mul_3x3[b] >> 4) & 0x0F) - 1;
-		n3 = ((mul_3x3[b] >> 8) & 0x0F) - 1;
+		n1 = (b % 3) - 1;
+		n2 = ((b / 3) % 3) - 1;
+		n3 = ((b / 9) % 3) - 1;
 		
 		set_pos(acm, i++, col, n1);
 		if (i >= acm->info.acm_rows)
@@ -459,9 +344,9 @@ static int f_t27(ACMStream *acm, unsigned ind, unsigned col)
 		/* b = (x1) + (x2 * 5) + (x3 * 25) */
 		GET_BITS(b, acm, 7);
 
-		n1 =  (mul_3x5[b] & 0x0F) - 2;
-		n2 = ((mul_3x5[b] >> 4) & 0x0F) - 2;
-		n3 = ((mul_3x5[b] >> 8) & 0x0F) - 2;
+		n1 = (b % 5) - 2;
+		n2 = ((b / 5) % 5) - 2;
+		n3 = ((b / 25) % 5) - 2;
 		
 		set_pos(acm, i++, col, n1);
 		if (i >= acm->info.acm_rows)
@@ -482,8 +367,8 @@ static int f_t37(ACMStream *acm, unsigned ind, unsigned col)
 		/* b = (x1) + (x2 * 11) */
 		GET_BITS(b, acm, 7);
 		
-		n1 =  (mul_2x11[b] & 0x0F) - 5;
-		n2 = ((mul_2x11[b] >> 4) & 0x0F) - 5;
+		n1 = (b % 11) - 5;
+		n2 = ((b / 11) % 11) - 5;
 		
 		set_pos(acm, i++, col, n1);
 		if (i >= acm->info.acm_rows)
@@ -500,9 +385,9 @@ static const filler_t filler_list[] = {
 	f_linear, f_linear, f_linear, f_linear,	/* 4..7 */
 	f_linear, f_linear, f_linear, f_linear,	/* 8..11 */
 	f_linear, f_linear, f_linear, f_linear,	/* 12..15 */
-	f_linear, f_k13, f_k12, f_t15,		/* 16..19 */
-	f_k24, f_k23, f_t27, f_k35,		/* 20..23 */
-	f_k34, f_bad, f_k45, f_k44,		/* 24..27 */
+	f_linear, f_table, f_table, f_t15,	/* 16..19 */
+	f_table, f_table, f_t27, f_table,	/* 20..23 */
+	f_table, f_bad, f_table, f_table,	/* 24..27 */
 	f_bad, f_t37, f_bad, f_bad		/* 28..31 */
 };
 
@@ -523,30 +408,14 @@ static int fill_block(ACMStream *acm)
  * Decompress code
  **********************************************/
 
-static void juggle(int *wrap_p, int *block_p, unsigned sub_len, unsigned sub_count)
-{
-	unsigned int i, j;
-	int *p, r0, r1, r2, r3;
-	for (i = 0; i < sub_len; i++) {
-		p = block_p;
-		r0 = wrap_p[0];
-		r1 = wrap_p[1];
-		for (j = 0; j < sub_count/2; j++) {
-			r2 = *p;  *p = r1*2 + (r0 + r2);  p += sub_len;
-			r3 = *p;  *p = r2*2 - (r1 + r3);  p += sub_len;
-			r0 = r2;  r1 = r3;
-		}
-		*wrap_p++ = r0;
-		*wrap_p++ = r1;
-		block_p++;
-	}
-}
-
 static void juggle_block(ACMStream *acm)
 {
 	unsigned sub_count, sub_len, todo_count, step_subcount, i;
 	int *wrap_p, *block_p, *p;
 	
+	/* vgmstream mod: juggle() is a cpu kernel (columns are independent) */
+	void (*juggle)(int *wrap_p, int *block_p, unsigned sub_len, unsigned sub_count) = vgm_get_kernels()->acm_juggle;
+
 	/* juggle only if subblock_len > 1 */
 	if (acm->info.acm_level == 0)
 		return;
@@ -593,6 +462,44 @@ static void juggle_block(ACMStream *acm)
 	}
 }
 
+/*
+ * vgmstream mod: saves state before every ACM_SEEK_BLOCKS-th block as
+ * it's reached (blocks aren't byte aligned, and wrapbuf carries over).
+ */
+static void add_seek_point(ACMStream *acm)
+{
+	unsigned block_num = acm->stream_pos / acm->block_len;
+	ACMSeekPoint *point;
+
+	if (block_num % ACM_SEEK_BLOCKS != 0 || block_num / ACM_SEEK_BLOCKS != acm->seek_count)
+		return;
+	if (acm->file_eof)
+		return;
+
+	if (acm->seek_count == acm->seek_max) {
+		unsigned max = acm->seek_max ? acm->seek_max * 2 : 64;
+		ACMSeekPoint *points = realloc(acm->seek_points, max * sizeof(ACMSeekPoint));
+		int *wrapbufs;
+		if (!points)
+			return;
+		acm->seek_points = points;
+		wrapbufs = realloc(acm->seek_wrapbufs, max * acm->wrapbuf_len * sizeof(int));
+		if (!wrapbufs)
+			return;
+		acm->seek_wrapbufs = wrapbufs;
+		acm->seek_max = max;
+	}
+
+	point = &acm->seek_points[acm->seek_count];
+	point->stream_pos = acm->stream_pos;
+	point->file_ofs = acm->buf_start_ofs + acm->buf_pos;
+	point->bit_data = acm->bit_data;
+	point->bit_avail = acm->bit_avail;
+	memcpy(acm->seek_wrapbufs + acm->seek_count * acm->wrapbuf_len, acm->wrapbuf,
+			acm->wrapbuf_len * sizeof(int));
+	acm->seek_count++;
+}
+
 /***************************************************************/
 static int decode_block(ACMStream *acm)
 {
@@ -827,7 +734,7 @@ int acm_open_decoder(ACMStream **res, void *arg, acm_io_callbacks io_cb, int for
 
 	memset(acm->wrapbuf, 0, acm->wrapbuf_len * sizeof(int));
 
-	generate_tables();
+	init_fill_tables(acm);
 
 	*res = acm;
 	return ACM_OK;
@@ -856,6 +763,7 @@ int acm_read(ACMStream *acm, void *dst, unsigned numbytes,
 		return 0;
 
 	if (!acm->block_ready) {
+		add_seek_point(acm);
 		err = decode_block(acm);
 		if (err == ACM_EXPECTED_EOF)
 			return 0;
@@ -907,6 +815,8 @@ void acm_close(ACMStream *acm)
 		free(acm->wrapbuf);
 	if (acm->ampbuf)
 		free(acm->ampbuf);
+	free(acm->seek_points);
+	free(acm->seek_wrapbufs);
 	free(acm);
 }
 
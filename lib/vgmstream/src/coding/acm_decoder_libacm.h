@@ -24,6 +24,9 @@
 #define ACM_ID		0x032897
 #define ACM_WORD	2
 
+/* vgmstream mod: blocks between seek points */
+#define ACM_SEEK_BLOCKS	16
+
 #define ACM_OK			 0
 #define ACM_ERR_OTHER		-1
 #define ACM_ERR_OPEN		-2
@@ -45,6 +48,13 @@ typedef struct ACMInfo {
 	unsigned acm_rows;
 } ACMInfo;
 
+/* vgmstream mod: decoder state at a block start, to seek without decoding from the beginning */
+typedef struct ACMSeekPoint {
+	unsigned stream_pos;		/* in words, absolute */
+	unsigned file_ofs;		/* of the next byte after bit_data */
+	unsigned bit_data, bit_avail;
+} ACMSeekPoint;
+
 typedef struct {
 	/* read bytes */
 	int (*read_func)(void *ptr, int size, int n, void *datasrc);
@@ -85,6 +95,13 @@ struct ACMStream {
 	unsigned wavc_file:1;
 	unsigned stream_pos;			/* in words. absolute */
 	unsigned block_pos;			/* in words, relative */
+
+	/* vgmstream mod: decode tables for the common k* fillers (see init_fill_tables) */
+	unsigned short fill_lut[11][32];
+	/* vgmstream mod: seek points every ACM_SEEK_BLOCKS decoded blocks, plus wrapbuf of each */
+	ACMSeekPoint *seek_points;
+	int *seek_wrapbufs;
+	unsigned seek_count, seek_max;
 };
 typedef struct ACMStream ACMStream;
 
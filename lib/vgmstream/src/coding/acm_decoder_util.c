@@ -211,12 +211,52 @@ int acm_seek_time(ACMStream *acm, unsigned time_ms)
 	return pcm2time(acm, res);
 }
 
+/*
+ * vgmstream mod: find the last seek point before word_pos
+ */
+static const ACMSeekPoint *find_seek_point(ACMStream *acm, unsigned word_pos, unsigned *index)
+{
+	unsigned lo = 0, hi = acm->seek_count;
+
+	while (lo < hi) {
+		unsigned mid = (lo + hi) / 2;
+		if (acm->seek_points[mid].stream_pos <= word_pos)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo == 0)
+		return NULL;
+	*index = lo - 1;
+	return &acm->seek_points[lo - 1];
+}
+
 int acm_seek_pcm(ACMStream *acm, unsigned pcm_pos)
 {
 	unsigned word_pos = pcm_pos * acm->info.channels;
-	unsigned start_ofs;
+	unsigned start_ofs, index;
+	const ACMSeekPoint *point;
+
+	/* vgmstream mod: restart from a seek point if going back or it's ahead of current position */
+	point = find_seek_point(acm, word_pos, &index);
+	if (point && (word_pos < acm->stream_pos || point->stream_pos > acm->stream_pos)
+			&& acm->io.seek_func != NULL
+			&& acm->io.seek_func(acm->io_arg, point->file_ofs, SEEK_SET) >= 0) {
+		acm->file_eof = 0;
+		acm->buf_pos = 0;
+		acm->buf_size = 0;
+		acm->buf_start_ofs = point->file_ofs;
+		acm->bit_data = point->bit_data;
+		acm->bit_avail = point->bit_avail;
+
+		acm->stream_pos = point->stream_pos;
+		acm->block_pos = 0;
+		acm->block_ready = 0;
 
-	if (word_pos < acm->stream_pos) {
+		memcpy(acm->wrapbuf, acm->seek_wrapbufs + index * acm->wrapbuf_len,
+				acm->wrapbuf_len * sizeof(int));
+	}
+	else if (word_pos < acm->stream_pos) {
 		if (acm->io.seek_func == NULL)
 			return ACM_ERR_NOT_SEEKABLE;
 
@@ -236,7 +276,7 @@ int acm_seek_pcm(ACMStream *acm, unsigned pcm_pos)
 		acm->stream_pos = 0;
 		acm->block_pos = 0;
 		acm->block_ready = 0;
-		acm->buf_start_ofs = ACM_HEADER_LEN;
+		acm->buf_start_ofs = start_ofs;
 
 		memset(acm->wrapbuf, 0, acm->wrapbuf_len * sizeof(int));
 	}
@@ -1,10 +1,11 @@
 #include "coding.h"
 #include "../util.h"
 
-void decode_adx(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do, int32_t frame_size, coding_t coding_type) {
-    uint8_t frame[0x12] = {0};
+DECODE_INLINE void decode_adx_spaced(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do, int32_t frame_size, coding_t coding_type) {
+    uint8_t frame_buf[0x100]; /* frame size is a byte in the header */
+    const uint8_t* frame;
     off_t frame_offset;
-    int i, frames_in, sample_count = 0;
+    int i, frames_in, sample_count = 0, samples_done = 0;
     size_t bytes_per_frame, samples_per_frame;
     int scale, coef1, coef2;
     int32_t hist1 = stream->adpcm_history1_32;
@@ -17,65 +18,86 @@ void decode_adx(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing
     frames_in = first_sample / samples_per_frame;
     first_sample = first_sample % samples_per_frame;
 
-    /* parse frame header */
-    frame_offset = stream->offset + bytes_per_frame * frames_in;
-    read_streamfile(frame, frame_offset, bytes_per_frame, stream->streamfile); /* ignore EOF errors */
+    /* may be called with many consecutive frames */
+    while (samples_done < samples_to_do) {
+        int frame_samples = samples_per_frame - first_sample;
+        if (frame_samples > samples_to_do - samples_done)
+            frame_samples = samples_to_do - samples_done;
 
-    scale = get_16bitBE(frame+0x00);
-    switch(coding_type) {
-        case coding_CRI_ADX:
-            scale = scale + 1;
-            coef1 = stream->adpcm_coef[0];
-            coef2 = stream->adpcm_coef[1];
-            break;
-        case coding_CRI_ADX_exp:
-            scale = 1 << (12 - scale);
-            coef1 = stream->adpcm_coef[0];
-            coef2 = stream->adpcm_coef[1];
-            break;
-        case coding_CRI_ADX_fixed:
-            scale = (scale & 0x1fff) + 1;
-            coef1 = stream->adpcm_coef[(frame[0] >> 5)*2 + 0];
-            coef2 = stream->adpcm_coef[(frame[0] >> 5)*2 + 1];
-            break;
-        case coding_CRI_ADX_enc_8:
-        case coding_CRI_ADX_enc_9:
-            scale = ((scale ^ stream->adx_xor) & 0x1fff) + 1;
-            coef1 = stream->adpcm_coef[0];
-            coef2 = stream->adpcm_coef[1];
-            break;
-        default:
-            scale = scale + 1;
-            coef1 = stream->adpcm_coef[0];
-            coef2 = stream->adpcm_coef[1];
-            break;
-    }
+        /* parse frame header */
+        frame_offset = stream->offset + bytes_per_frame * frames_in;
+        memset(frame_buf, 0, bytes_per_frame);
+        frame = read_streamfile_ptr(frame_buf, frame_offset, bytes_per_frame, stream->streamfile); /* ignore EOF errors */
+
+        scale = get_16bitBE(frame+0x00);
+        switch(coding_type) {
+            case coding_CRI_ADX:
+                scale = scale + 1;
+                coef1 = stream->adpcm_coef[0];
+                coef2 = stream->adpcm_coef[1];
+                break;
+            case coding_CRI_ADX_exp:
+                scale = 1 << (12 - scale);
+                coef1 = stream->adpcm_coef[0];
+                coef2 = stream->adpcm_coef[1];
+                break;
+            case coding_CRI_ADX_fixed:
+                scale = (scale & 0x1fff) + 1;
+                coef1 = stream->adpcm_coef[(frame[0] >> 5)*2 + 0];
+                coef2 = stream->adpcm_coef[(frame[0] >> 5)*2 + 1];
+                break;
+            case coding_CRI_ADX_enc_8:
+            case coding_CRI_ADX_enc_9:
+                scale = ((scale ^ stream->adx_xor) & 0x1fff) + 1;
+                coef1 = stream->adpcm_coef[0];
+                coef2 = stream->adpcm_coef[1];
+                break;
+            default:
+                scale = scale + 1;
+                coef1 = stream->adpcm_coef[0];
+                coef2 = stream->adpcm_coef[1];
+                break;
+        }
+
+        /* decode nibbles */
+        for (i = first_sample; i < first_sample + frame_samples; i++) {
+            int32_t sample = 0;
+            uint8_t nibbles = frame[0x02 + i/2];
 
-    /* decode nibbles */
-    for (i = first_sample; i < first_sample + samples_to_do; i++) {
-        int32_t sample = 0;
-        uint8_t nibbles = frame[0x02 + i/2];
+            sample = i&1 ? /* high nibble first */
+                    get_low_nibble_signed(nibbles):
+                    get_high_nibble_signed(nibbles);
+            sample = sample * scale + (coef1 * hist1 >> 12) + (coef2 * hist2 >> 12);
+            sample = clamp16(sample);
 
-        sample = i&1 ? /* high nibble first */
-                get_low_nibble_signed(nibbles):
-                get_high_nibble_signed(nibbles);
-        sample = sample * scale + (coef1 * hist1 >> 12) + (coef2 * hist2 >> 12);
-        sample = clamp16(sample);
+            outbuf[sample_count] = sample;
+            sample_count += channelspacing;
 
-        outbuf[sample_count] = sample;
-        sample_count += channelspacing;
+            hist2 = hist1;
+            hist1 = sample;
+        }
 
-        hist2 = hist1;
-        hist1 = sample;
+        /* key moves once per frame of each channel */
+        if ((coding_type == coding_CRI_ADX_enc_8 || coding_type == coding_CRI_ADX_enc_9) && !(i % 32)) {
+            for (i =0; i < stream->adx_channels; i++) {
+                adx_next_key(stream);
+            }
+        }
+
+        samples_done += frame_samples;
+        first_sample = 0;
+        frames_in++;
     }
 
     stream->adpcm_history1_32 = hist1;
     stream->adpcm_history2_32 = hist2;
+}
 
-    if ((coding_type == coding_CRI_ADX_enc_8 || coding_type == coding_CRI_ADX_enc_9) && !(i % 32)) {
-        for (i =0; i < stream->adx_channels; i++) {
-            adx_next_key(stream);
-        }
+void decode_adx(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do, int32_t frame_size, coding_t coding_type) {
+    switch (channelspacing) {
+        case 1:  decode_adx_spaced(stream, outbuf, 1, first_sample, samples_to_do, frame_size, coding_type); break;
+        case 2:  decode_adx_spaced(stream, outbuf, 2, first_sample, samples_to_do, frame_size, coding_type); break;
+        default: decode_adx_spaced(stream, outbuf, channelspacing, first_sample, samples_to_do, frame_size, coding_type); break;
     }
 }
 
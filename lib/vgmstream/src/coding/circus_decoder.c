@@ -7,9 +7,17 @@ struct circus_codec_data {
     STREAMFILE* sf;
     int16_t* buf;
     int buf_samples_all;
+    int32_t samples_discard;
     circus_handle_t* handle;
 };
 
+/* saved codec_data state, followed by the handle's */
+typedef struct {
+    int16_t* buf;
+    int buf_samples_all;
+    int32_t samples_discard;
+} circus_vq_state;
+
 
 circus_codec_data* init_circus_vq(STREAMFILE* sf, off_t start, uint8_t codec, uint8_t flags) {
     circus_codec_data* data = NULL;
@@ -36,6 +44,18 @@ void decode_circus_vq(circus_codec_data* data, sample_t* outbuf, int32_t samples
             if (!ok) goto decode_fail;
         }
 
+        /* frames depend on previous ones, so seeking decodes up to the target */
+        if (data->samples_discard) {
+            samples_to_get = data->buf_samples_all / channels;
+            if (samples_to_get > data->samples_discard)
+                samples_to_get = data->samples_discard;
+
+            data->buf += samples_to_get * channels;
+            data->buf_samples_all -= samples_to_get * channels;
+            data->samples_discard -= samples_to_get;
+            continue;
+        }
+
         samples_to_get = data->buf_samples_all / channels;
         if (samples_to_get > samples_to_do)
             samples_to_get = samples_to_do;
@@ -62,13 +82,54 @@ void reset_circus_vq(circus_codec_data* data) {
 
     circus_reset(data->handle);
     data->buf_samples_all = 0;
+    data->samples_discard = 0;
 }
 
+/* loops normally restore the state saved at loop start instead (XPCM has no loops, but may be set externally) */
 void seek_circus_vq(circus_codec_data* data, int32_t num_sample) {
     if (!data) return;
 
     reset_circus_vq(data);
-    //data->samples_discard = num_sample; //todo (xpcm don't have loop points tho)
+    data->samples_discard = num_sample;
+}
+
+/* restored on the same data, so buf still points to the handle's frame samples */
+void* save_circus_vq(circus_codec_data* data, size_t* size) {
+    circus_vq_state* state = NULL;
+    void* handle_state = NULL;
+    size_t handle_size = 0;
+    if (!data) return NULL;
+
+    handle_state = circus_save(data->handle, &handle_size);
+    if (!handle_state) goto fail;
+
+    state = malloc(sizeof(circus_vq_state) + handle_size);
+    if (!state) goto fail;
+    state->buf = data->buf;
+    state->buf_samples_all = data->buf_samples_all;
+    state->samples_discard = data->samples_discard;
+    memcpy(state + 1, handle_state, handle_size);
+    free(handle_state);
+
+    *size = sizeof(circus_vq_state) + handle_size;
+    return state;
+fail:
+    free(handle_state);
+    return NULL;
+}
+
+void restore_circus_vq(circus_codec_data* data, const void* state_buf) {
+    const circus_vq_state* state = state_buf;
+    if (!data || !state) return;
+
+    if (!circus_restore(data->handle, state + 1, data->sf)) {
+        VGM_LOG("CIRCUS: restore error\n");
+        reset_circus_vq(data);
+        return;
+    }
+    data->buf = state->buf;
+    data->buf_samples_all = state->buf_samples_all;
+    data->samples_discard = state->samples_discard;
 }
 
 void free_circus_vq(circus_codec_data* data) {
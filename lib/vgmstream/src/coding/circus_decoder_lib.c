@@ -490,3 +490,88 @@ int circus_decode_frame(circus_handle_t* handle, STREAMFILE* sf, int16_t** p_buf
 fail:
     return 0;
 }
+
+/* state after a frame: filter/overlap state (pcmbuf also has current frame samples), compressed stream
+ * state and position; pending input isn't saved but re-read, as srcbuf is data right before offset */
+typedef struct {
+    int hist1;
+    int hist2;
+    int frame;
+    off_t offset;
+    int avail_in;
+    int total_in;
+    int16_t pcmbuf[XPCM_FRAME_SAMPLES_ALL + XPCM_FRAME_OVERLAP_ALL];
+    /* followed by lzxpcm context or inflate state */
+} circus_state_t;
+
+void* circus_save(circus_handle_t* handle, size_t* p_size) {
+    circus_state_t* state = NULL;
+    size_t stream_size;
+
+    if (handle->codec == XPCM_CODEC_VQ_LZXPCM) {
+        stream_size = sizeof(lzxpcm_context_t);
+    } else if (handle->codec == XPCM_CODEC_VQ_DEFLATE) {
+        stream_size = mz_inflateGetState(&handle->dstrm, NULL);
+        if (!stream_size) goto fail;
+    } else {
+        goto fail;
+    }
+
+    state = malloc(sizeof(circus_state_t) + stream_size);
+    if (!state) goto fail;
+
+    state->hist1 = handle->hist1;
+    state->hist2 = handle->hist2;
+    state->frame = handle->frame;
+    state->offset = handle->offset;
+    memcpy(state->pcmbuf, handle->pcmbuf, sizeof(handle->pcmbuf));
+
+    if (handle->codec == XPCM_CODEC_VQ_LZXPCM) {
+        state->avail_in = handle->lstrm.avail_in;
+        state->total_in = handle->lstrm.total_in;
+        memcpy(state + 1, &handle->lstrm.ctx, stream_size);
+    } else {
+        state->avail_in = handle->dstrm.avail_in;
+        state->total_in = 0;
+        mz_inflateGetState(&handle->dstrm, state + 1);
+    }
+
+    *p_size = sizeof(circus_state_t) + stream_size;
+    return state;
+fail:
+    free(state);
+    return NULL;
+}
+
+int circus_restore(circus_handle_t* handle, const void* state_buf, STREAMFILE* sf) {
+    const circus_state_t* state = state_buf;
+    int avail_in = state->avail_in;
+
+    if (avail_in < 0 || avail_in > sizeof(handle->srcbuf))
+        goto fail;
+    if (avail_in && read_streamfile(handle->srcbuf, state->offset - avail_in, avail_in, sf) != avail_in)
+        goto fail;
+
+    if (handle->codec == XPCM_CODEC_VQ_LZXPCM) {
+        memcpy(&handle->lstrm.ctx, state + 1, sizeof(lzxpcm_context_t));
+        handle->lstrm.next_in = handle->srcbuf;
+        handle->lstrm.avail_in = avail_in;
+        handle->lstrm.total_in = state->total_in;
+    } else if (handle->codec == XPCM_CODEC_VQ_DEFLATE) {
+        if (mz_inflateSetState(&handle->dstrm, state + 1) != MZ_OK)
+            goto fail;
+        handle->dstrm.next_in = handle->srcbuf;
+        handle->dstrm.avail_in = avail_in;
+    } else {
+        goto fail;
+    }
+
+    handle->hist1 = state->hist1;
+    handle->hist2 = state->hist2;
+    handle->frame = state->frame;
+    handle->offset = state->offset;
+    memcpy(handle->pcmbuf, state->pcmbuf, sizeof(handle->pcmbuf));
+    return 1;
+fail:
+    return 0;
+}
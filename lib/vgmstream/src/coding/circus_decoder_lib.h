@@ -13,4 +13,10 @@ void circus_reset(circus_handle_t* handle);
 
 int circus_decode_frame(circus_handle_t* handle, STREAMFILE* sf, int16_t** p_buf, int* p_buf_samples_all);
 
+/* Saves the decoding state (returned buf must be freed), to be restored later on the same handle. */
+void* circus_save(circus_handle_t* handle, size_t* p_size);
+
+/* Restores a state from circus_save, re-reading pending input from sf. Output buf of the saved frame stays valid. */
+int circus_restore(circus_handle_t* handle, const void* state, STREAMFILE* sf);
+
 #endif
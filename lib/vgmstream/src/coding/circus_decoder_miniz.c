@@ -547,6 +547,43 @@ int mz_inflateEnd(mz_streamp pStream)
     return MZ_OK;
 }
 
+typedef struct
+{
+    mz_ulong total_in, total_out, adler;
+    int data_type;
+    inflate_state state;
+} inflate_saved_state;
+
+size_t mz_inflateGetState(mz_streamp pStream, void *pState)
+{
+    inflate_saved_state *pSaved = (inflate_saved_state *)pState;
+    if (!pStream || !pStream->state)
+        return 0;
+    if (pSaved)
+    {
+        pSaved->total_in = pStream->total_in;
+        pSaved->total_out = pStream->total_out;
+        pSaved->adler = pStream->adler;
+        pSaved->data_type = pStream->data_type;
+        memcpy(&pSaved->state, pStream->state, sizeof(inflate_state));
+    }
+    return sizeof(inflate_saved_state);
+}
+
+int mz_inflateSetState(mz_streamp pStream, const void *pState)
+{
+    const inflate_saved_state *pSaved = (const inflate_saved_state *)pState;
+    if (!pStream || !pStream->state || !pSaved)
+        return MZ_STREAM_ERROR;
+    pStream->total_in = pSaved->total_in;
+    pStream->total_out = pSaved->total_out;
+    pStream->adler = pSaved->adler;
+    pStream->data_type = pSaved->data_type;
+    pStream->msg = NULL;
+    memcpy(pStream->state, &pSaved->state, sizeof(inflate_state));
+    return MZ_OK;
+}
+
 int mz_uncompress(unsigned char *pDest, mz_ulong *pDest_len, const unsigned char *pSource, mz_ulong source_len)
 {
     mz_stream stream;
@@ -395,6 +395,11 @@ int mz_inflate(mz_streamp pStream, int flush);
 /* Deinitializes a decompressor. */
 int mz_inflateEnd(mz_streamp pStream);
 
+/* vgmstream: copies a decompressor's state to pState (if not NULL) and returns its size, so it can continue from that point later with mz_inflateSetState(). */
+/* next_in/avail_in/next_out/avail_out aren't part of the state and must be set again by the caller. */
+size_t mz_inflateGetState(mz_streamp pStream, void *pState);
+int mz_inflateSetState(mz_streamp pStream, const void *pState);
+
 /* Single-call decompression. */
 /* Returns MZ_OK on success, or one of the error codes from mz_inflate() on failure. */
 int mz_uncompress(unsigned char *pDest, mz_ulong *pDest_len, const unsigned char *pSource, mz_ulong source_len);
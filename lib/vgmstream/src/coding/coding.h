@@ -3,6 +3,17 @@
 
 #include "../vgmstream.h"
 
+/* Decoders write outbuf[sample * channelspacing], a runtime stride that keeps compilers from unrolling
+ * or vectorizing stores. Hot ones keep their body in a DECODE_INLINE "_spaced" function, and their
+ * public version calls it with a constant stride for mono/planar (1) and stereo (2) to get copies. */
+#if defined(_MSC_VER)
+#define DECODE_INLINE static __forceinline
+#elif defined(__GNUC__)
+#define DECODE_INLINE static inline __attribute__((always_inline))
+#else
+#define DECODE_INLINE static inline
+#endif
+
 /* adx_decoder */
 void decode_adx(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do, int32_t frame_bytes, coding_t coding_type);
 void adx_next_key(VGMSTREAMCHANNEL * stream);
@@ -103,7 +114,7 @@ void decode_xa(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing,
 size_t xa_bytes_to_samples(size_t bytes, int channels, int is_blocked, int is_form2);
 
 /* ea_xa_decoder */
-void decode_ea_xa(VGMSTREAMCHANNEL * stream, sample * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do, int channel);
+void decode_ea_xa(VGMSTREAM* vgmstream, sample_t* outbuf, int32_t first_sample, int32_t samples_to_do);
 void decode_ea_xa_int(VGMSTREAMCHANNEL * stream, sample * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do, int channel);
 void decode_ea_xa_v2(VGMSTREAMCHANNEL * stream, sample * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do,int channel);
 void decode_maxis_xa(VGMSTREAMCHANNEL * stream, sample * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do, int channel);
@@ -111,7 +122,7 @@ int32_t ea_xa_bytes_to_samples(size_t bytes, int channels);
 
 /* ea_xas_decoder */
 void decode_ea_xas_v0(VGMSTREAMCHANNEL * stream, sample * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do, int channel);
-void decode_ea_xas_v1(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do, int channel);
+void decode_ea_xas_v1(VGMSTREAM* vgmstream, sample_t* outbuf, int32_t first_sample, int32_t samples_to_do);
 
 /* sdx2_decoder */
 void decode_sdx2(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do);
@@ -126,7 +137,10 @@ void decode_ws(VGMSTREAM * vgmstream, int channel, sample * outbuf, int channels
 acm_codec_data *init_acm(STREAMFILE *streamFile, int force_channel_number);
 void decode_acm(acm_codec_data *data, sample * outbuf, int32_t samples_to_do, int channelspacing);
 void reset_acm(acm_codec_data *data);
+void seek_acm(acm_codec_data *data, int32_t num_sample);
 void free_acm(acm_codec_data *data);
+void* save_acm(acm_codec_data *data, size_t *size);
+void restore_acm(acm_codec_data *data, const void *state);
 
 /* nwa_decoder */
 void decode_nwa(NWAData *nwa, sample *outbuf, int32_t samples_to_do);
@@ -164,7 +178,7 @@ void decode_lsf(VGMSTREAMCHANNEL *stream, sample_t *outbuf, int channelspacing,
 void decode_mtaf(VGMSTREAMCHANNEL *stream, sample_t *outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do, int channel);
 
 /* mta2_decoder */
-void decode_mta2(VGMSTREAMCHANNEL *stream, sample_t *outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do, int channel);
+void decode_mta2(VGMSTREAM* vgmstream, sample_t* outbuf, int32_t first_sample, int32_t samples_to_do);
 
 /* mc3_decoder */
 void decode_mc3(VGMSTREAM * vgmstream, VGMSTREAMCHANNEL * stream, sample * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do, int channel);
@@ -191,6 +205,8 @@ circus_codec_data* init_circus_vq(STREAMFILE* sf, off_t start, uint8_t codec, ui
 void decode_circus_vq(circus_codec_data* data, sample_t* outbuf, int32_t samples_to_do, int channels);
 void reset_circus_vq(circus_codec_data* data);
 void seek_circus_vq(circus_codec_data* data, int32_t num_sample);
+void* save_circus_vq(circus_codec_data* data, size_t* size);
+void restore_circus_vq(circus_codec_data* data, const void* state);
 void free_circus_vq(circus_codec_data* data);
 void decode_circus_adpcm(VGMSTREAMCHANNEL* stream, sample_t* outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do);
 
@@ -210,6 +226,8 @@ void decode_ubi_adpcm(VGMSTREAM * vgmstream, sample_t * outbuf, int32_t samples_
 void reset_ubi_adpcm(ubi_adpcm_codec_data *data);
 void seek_ubi_adpcm(ubi_adpcm_codec_data *data, int32_t num_sample);
 void free_ubi_adpcm(ubi_adpcm_codec_data *data);
+void* save_ubi_adpcm(ubi_adpcm_codec_data *data, size_t *size);
+void restore_ubi_adpcm(ubi_adpcm_codec_data *data, const void *state);
 int ubi_adpcm_get_samples(ubi_adpcm_codec_data *data);
 
 /* imuse_decoder */
@@ -217,8 +235,10 @@ typedef struct imuse_codec_data imuse_codec_data;
 imuse_codec_data *init_imuse(STREAMFILE* sf, int channels);
 void decode_imuse(VGMSTREAM* vgmstream, sample_t* outbuf, int32_t samples_to_do);
 void reset_imuse(imuse_codec_data* data);
-void seek_imuse(imuse_codec_data* data, int32_t num_sample);
+void seek_imuse(VGMSTREAM* vgmstream, int32_t num_sample);
 void free_imuse(imuse_codec_data* data);
+void* save_imuse(imuse_codec_data* data, size_t* size);
+void restore_imuse(imuse_codec_data* data, const void* state);
 
 /* ea_mt_decoder*/
 ea_mt_codec_data *init_ea_mt(int channels, int type);
@@ -235,14 +255,20 @@ void decode_relic(VGMSTREAMCHANNEL* stream, relic_codec_data* data, sample_t* ou
 void reset_relic(relic_codec_data* data);
 void seek_relic(relic_codec_data* data, int32_t num_sample);
 void free_relic(relic_codec_data* data);
+void* save_relic(relic_codec_data* data, size_t* size);
+void restore_relic(relic_codec_data* data, const void* state);
 
 /* hca_decoder */
 hca_codec_data *init_hca(STREAMFILE *streamFile);
 void decode_hca(hca_codec_data * data, sample * outbuf, int32_t samples_to_do);
 void reset_hca(hca_codec_data * data);
 void loop_hca(hca_codec_data * data, int32_t num_sample);
+void seek_hca(hca_codec_data * data, int32_t num_sample);
 void free_hca(hca_codec_data * data);
+void* save_hca(hca_codec_data * data, size_t * size);
+void restore_hca(hca_codec_data * data, const void * state);
 int test_hca_key(hca_codec_data * data, unsigned long long keycode);
+void test_hca_key_done(hca_codec_data * data);
 
 #ifdef VGM_USE_VORBIS
 /* ogg_vorbis_decoder */
@@ -261,6 +287,8 @@ STREAMFILE* ogg_vorbis_get_streamfile(ogg_vorbis_codec_data *data);
 /* vorbis_custom_decoder */
 vorbis_custom_codec_data *init_vorbis_custom(STREAMFILE *streamfile, off_t start_offset, vorbis_custom_t type, vorbis_custom_config * config);
 void decode_vorbis_custom(VGMSTREAM * vgmstream, sample_t * outbuf, int32_t samples_to_do, int channels);
+void decode_vorbis_custom_float(VGMSTREAM * vgmstream, float * outbuf, int32_t samples_to_do, int channels);
+int vorbis_custom_can_decode_float(vorbis_custom_codec_data * data);
 void reset_vorbis_custom(VGMSTREAM *vgmstream);
 void seek_vorbis_custom(VGMSTREAM *vgmstream, int32_t num_sample);
 void free_vorbis_custom(vorbis_custom_codec_data *data);
@@ -277,6 +305,7 @@ void free_mpeg(mpeg_codec_data *data);
 void flush_mpeg(mpeg_codec_data * data);
 
 long mpeg_bytes_to_samples(long bytes, const mpeg_codec_data *data);
+int mpeg_is_parallel_decoder(mpeg_codec_data *data);
 #endif
 
 #ifdef VGM_USE_G7221
@@ -299,6 +328,7 @@ void free_g719(g719_codec_data * data, int channels);
 
 #if defined(VGM_USE_MP4V2) && defined(VGM_USE_FDKAAC)
 /* mp4_aac_decoder */
+int setup_mp4_aac_index(mp4_aac_codec_data * data, int sample_rate);
 void decode_mp4_aac(mp4_aac_codec_data * data, sample * outbuf, int32_t samples_to_do, int channels);
 void reset_mp4_aac(VGMSTREAM *vgmstream);
 void seek_mp4_aac(VGMSTREAM *vgmstream, int32_t num_sample);
@@ -339,18 +369,22 @@ void free_celt_fsb(celt_codec_data *data);
 ffmpeg_codec_data *init_ffmpeg_offset(STREAMFILE *streamFile, uint64_t start, uint64_t size);
 ffmpeg_codec_data *init_ffmpeg_header_offset(STREAMFILE *streamFile, uint8_t * header, uint64_t header_size, uint64_t start, uint64_t size);
 ffmpeg_codec_data *init_ffmpeg_header_offset_subsong(STREAMFILE *streamFile, uint8_t * header, uint64_t header_size, uint64_t start, uint64_t size, int target_subsong);
+ffmpeg_codec_data* init_ffmpeg_raw_packets(STREAMFILE* sf, int codec_id, const uint8_t* extradata, size_t extradata_size, int channels, int sample_rate, int preroll, int count, uint32_t* offsets, uint32_t* sizes, int32_t* samples);
 
 void decode_ffmpeg(VGMSTREAM *stream, sample_t * outbuf, int32_t samples_to_do, int channels);
+void decode_ffmpeg_float(VGMSTREAM *vgmstream, float * outbuf, int32_t samples_to_do, int channels);
 void reset_ffmpeg(VGMSTREAM *vgmstream);
 void seek_ffmpeg(VGMSTREAM *vgmstream, int32_t num_sample);
 void free_ffmpeg(ffmpeg_codec_data *data);
 
 void ffmpeg_set_skip_samples(ffmpeg_codec_data * data, int skip_samples);
+void ffmpeg_set_xma_seek_index(ffmpeg_codec_data * data, STREAMFILE *sf, off_t data_offset, size_t data_size);
 uint32_t ffmpeg_get_channel_layout(ffmpeg_codec_data * data);
 void ffmpeg_set_channel_remapping(ffmpeg_codec_data * data, int *channels_remap);
 const char* ffmpeg_get_codec_name(ffmpeg_codec_data * data);
 void ffmpeg_set_force_seek(ffmpeg_codec_data * data);
 const char* ffmpeg_get_metadata_value(ffmpeg_codec_data* data, const char* key);
+int ffmpeg_can_decode_float(ffmpeg_codec_data * data);
 
 
 /* ffmpeg_decoder_utils.c (helper-things) */
@@ -415,6 +449,7 @@ typedef struct {
     int32_t loop_end_sample;
 } ms_sample_data;
 void xma_get_samples(ms_sample_data * msd, STREAMFILE *streamFile);
+int xma_get_seek_index(STREAMFILE *sf, off_t data_offset, size_t data_size, int step_packets, uint32_t **p_offsets, int32_t **p_frames);
 void wmapro_get_samples(ms_sample_data * msd, STREAMFILE *streamFile, int block_align, int sample_rate, uint32_t decode_flags);
 void wma_get_samples(ms_sample_data * msd, STREAMFILE *streamFile, int block_align, int sample_rate, uint32_t decode_flags);
 
@@ -697,6 +697,64 @@ void xma_get_samples(ms_sample_data * msd, STREAMFILE *streamFile) {
     ms_audio_get_samples(msd, streamFile, channels_per_stream, bytes_per_packet, samples_per_frame, samples_per_subframe, bits_frame_size);
 }
 
+/* Finds packets where single stream XMA can be decoded from, every step_packets packets, by reading
+ * frame headers like ms_audio_get_samples. Each entry is the packet's offset from data_offset and the
+ * frames before the first one starting there. Returns entries (arrays must be freed), 0 on error. */
+int xma_get_seek_index(STREAMFILE *sf, off_t data_offset, size_t data_size, int step_packets, uint32_t **p_offsets, int32_t **p_frames) {
+    const int bytes_per_packet = 2048;
+    const int bits_frame_size = 15;
+    const int64_t packet_size_b = bytes_per_packet * 8;
+    uint32_t *offsets = NULL;
+    int32_t *frames = NULL;
+    int count = 0, max_count, packet = 0, frame_count = 0;
+    off_t offset = data_offset;
+    off_t max_offset = data_offset + data_size;
+
+    max_count = data_size / bytes_per_packet / step_packets + 1;
+    offsets = malloc(max_count * sizeof(uint32_t));
+    frames = malloc(max_count * sizeof(int32_t));
+    if (!offsets || !frames) goto fail;
+
+    for (; offset < max_offset; offset += bytes_per_packet, packet++) {
+        size_t first_frame_b, packet_skip_count, header_size_b, frame_size_b;
+        int64_t offset_b = offset * 8;
+        int64_t packet_offset_b;
+
+        ms_audio_parse_header(sf, 2, offset_b, bits_frame_size, &first_frame_b, &packet_skip_count, &header_size_b);
+        if (packet_skip_count > 0x7FF)
+            continue; /* no frame starts here */
+        if (packet_skip_count != 0)
+            goto fail; /* multistream (or broken), packets aren't consecutive */
+
+        if (packet % step_packets == 0 && count < max_count) {
+            offsets[count] = offset - data_offset;
+            frames[count] = frame_count;
+            count++;
+        }
+
+        packet_offset_b = header_size_b + first_frame_b;
+        while (packet_offset_b < packet_size_b) {
+            frame_size_b = read_bitsBE_b(offset_b + packet_offset_b, bits_frame_size, sf);
+            if (frame_size_b == 0 || frame_size_b == (0xffffffff >> (32 - bits_frame_size)))
+                break;
+            packet_offset_b += frame_size_b;
+            frame_count++;
+
+            if (packet_offset_b < packet_size_b && !read_bitsBE_b(offset_b + packet_offset_b - 1, 1, sf))
+                break;
+        }
+    }
+
+    if (count == 0) goto fail;
+    *p_offsets = offsets;
+    *p_frames = frames;
+    return count;
+fail:
+    free(offsets);
+    free(frames);
+    return 0;
+}
+
 void wmapro_get_samples(ms_sample_data * msd, STREAMFILE *streamFile, int block_align, int sample_rate, uint32_t decode_flags) {
     const int version = 3; /* WMAPRO = WMAv3 */
     int bytes_per_packet = block_align;
@@ -831,6 +889,11 @@ void xma_fix_raw_samples_ch(VGMSTREAM *vgmstream, STREAMFILE*streamFile, off_t s
         if (data->skipSamples == 0) {
             ffmpeg_set_skip_samples(data, start_skip+64);
         }
+
+        /* multistream packets are interleaved, so only one stream can seek to a packet */
+        if (channels_per_stream <= 2 && channels_per_stream == vgmstream->channels) {
+            ffmpeg_set_xma_seek_index(data, streamFile, stream_offset, stream_size);
+        }
     }
 #endif
 }
@@ -1019,30 +1082,30 @@ size_t aac_get_samples(STREAMFILE *streamFile, off_t start_offset, size_t bytes)
 
 
 /* Read bits (max 32) from buf and update the bit offset. Vorbis packs values in LSB order and byte by byte.
- * (ex. from 2 bytes 00100111 00000001 we can could read 4b=0111 and 6b=010010, 6b=remainder (second value is split into the 2nd byte) */
+ * (ex. from 2 bytes 00100111 00000001 we can could read 4b=0111 and 6b=010010, 6b=remainder (second value is split into the 2nd byte)
+ * Bits are taken in chunks of what is left in each byte rather than one by one. */
 static int r_bits_vorbis(vgm_bitstream * ib, int num_bits, uint32_t * value) {
     off_t off, pos;
-    int i, bit_buf, bit_val;
+    uint32_t val = 0;
+    int done = 0;
     if (num_bits == 0) return 1;
     if (num_bits > 32 || num_bits < 0 || ib->b_off + num_bits > ib->bufsize*8) goto fail;
 
-    *value = 0; /* set all bits to 0 */
     off = ib->b_off / 8; /* byte offset */
     pos = ib->b_off % 8; /* bit sub-offset */
-    for (i = 0; i < num_bits; i++) {
-        bit_buf = (1U << pos) & 0xFF;   /* bit check for buf */
-        bit_val = (1U << i);            /* bit to set in value */
+    while (done < num_bits) {
+        int take = 8 - pos;             /* bits left in this byte */
+        if (take > num_bits - done)
+            take = num_bits - done;
 
-        if (ib->buf[off] & bit_buf)     /* is bit in buf set? */
-            *value |= bit_val;          /* set bit */
+        val |= ((uint32_t)(ib->buf[off] >> pos) & ((1U << take) - 1)) << done; /* low bits go first */
 
-        pos++;                          /* new byte starts */
-        if (pos%8 == 0) {
-            pos = 0;
-            off++;
-        }
+        done += take;
+        pos = 0;                        /* new byte starts */
+        off++;
     }
 
+    *value = val;
     ib->b_off += num_bits;
     return 1;
 fail:
@@ -1053,27 +1116,25 @@ fail:
  * (ex. writing 1101011010 from b_off 2 we get 01101011 00001101 (value split, and 11 in the first byte skipped)*/
 static int w_bits_vorbis(vgm_bitstream * ob, int num_bits, uint32_t value) {
     off_t off, pos;
-    int i, bit_val, bit_buf;
+    int done = 0;
     if (num_bits == 0) return 1;
     if (num_bits > 32 || num_bits < 0 || ob->b_off + num_bits > ob->bufsize*8) goto fail;
 
 
     off = ob->b_off / 8; /* byte offset */
     pos = ob->b_off % 8; /* bit sub-offset */
-    for (i = 0; i < num_bits; i++) {
-        bit_val = (1U << i);            /* bit check for value */
-        bit_buf = (1U << pos) & 0xFF;   /* bit to set in buf */
-
-        if (value & bit_val)            /* is bit in val set? */
-            ob->buf[off] |= bit_buf;    /* set bit */
-        else
-            ob->buf[off] &= ~bit_buf;   /* unset bit */
-
-        pos++;                          /* new byte starts */
-        if (pos%8 == 0) {
-            pos = 0;
-            off++;
-        }
+    while (done < num_bits) {
+        int take = 8 - pos;             /* bits left in this byte */
+        uint8_t mask;
+        if (take > num_bits - done)
+            take = num_bits - done;
+
+        mask = ((1U << take) - 1) << pos; /* other bits in the byte are kept */
+        ob->buf[off] = (ob->buf[off] & ~mask) | (((value >> done) << pos) & mask);
+
+        done += take;
+        pos = 0;                        /* new byte starts */
+        off++;
     }
 
     ob->b_off += num_bits;
@@ -1086,27 +1147,25 @@ fail:
 /* Read bits (max 32) from buf and update the bit offset. Order is BE (MSF). */
 static int r_bits_msf(vgm_bitstream * ib, int num_bits, uint32_t * value) {
     off_t off, pos;
-    int i, bit_buf, bit_val;
+    uint32_t val = 0;
+    int left = num_bits;
     if (num_bits == 0) return 1;
     if (num_bits > 32 || num_bits < 0 || ib->b_off + num_bits > ib->bufsize*8) goto fail;
 
-    *value = 0; /* set all bits to 0 */
     off = ib->b_off / 8; /* byte offset */
     pos = ib->b_off % 8; /* bit sub-offset */
-    for (i = 0; i < num_bits; i++) {
-        bit_buf = (1U << (8-1-pos)) & 0xFF;   /* bit check for buf */
-        bit_val = (1U << (num_bits-1-i));     /* bit to set in value */
+    while (left > 0) {
+        int avail = 8 - pos;            /* bits left in this byte, from the top */
+        int take = (left < avail) ? left : avail;
 
-        if (ib->buf[off] & bit_buf)         /* is bit in buf set? */
-            *value |= bit_val;              /* set bit */
+        val = (val << take) | ((ib->buf[off] >> (avail - take)) & ((1U << take) - 1)); /* high bits go first */
 
-        pos++;
-        if (pos%8 == 0) {                   /* new byte starts */
-            pos = 0;
-            off++;
-        }
+        left -= take;
+        pos = 0;                        /* new byte starts */
+        off++;
     }
 
+    *value = val;
     ib->b_off += num_bits;
     return 1;
 fail:
@@ -1116,27 +1175,24 @@ fail:
 /* Write bits (max 32) to buf and update the bit offset. Order is BE (MSF). */
 static int w_bits_msf(vgm_bitstream * ob, int num_bits, uint32_t value) {
     off_t off, pos;
-    int i, bit_val, bit_buf;
+    int left = num_bits;
     if (num_bits == 0) return 1;
     if (num_bits > 32 || num_bits < 0 || ob->b_off + num_bits > ob->bufsize*8) goto fail;
 
 
     off = ob->b_off / 8; /* byte offset */
     pos = ob->b_off % 8; /* bit sub-offset */
-    for (i = 0; i < num_bits; i++) {
-        bit_val = (1U << (num_bits-1-i));     /* bit check for value */
-        bit_buf = (1U << (8-1-pos)) & 0xFF;   /* bit to set in buf */
-
-        if (value & bit_val)                /* is bit in val set? */
-            ob->buf[off] |= bit_buf;        /* set bit */
-        else
-            ob->buf[off] &= ~bit_buf;       /* unset bit */
-
-        pos++;
-        if (pos%8 == 0) {                   /* new byte starts */
-            pos = 0;
-            off++;
-        }
+    while (left > 0) {
+        int avail = 8 - pos;            /* bits left in this byte, from the top */
+        int take = (left < avail) ? left : avail;
+        int shift = avail - take;
+        uint8_t mask = ((1U << take) - 1) << shift; /* other bits in the byte are kept */
+
+        ob->buf[off] = (ob->buf[off] & ~mask) | (((value >> (left - take)) << shift) & mask);
+
+        left -= take;
+        pos = 0;                        /* new byte starts */
+        off++;
     }
 
     ob->b_off += num_bits;
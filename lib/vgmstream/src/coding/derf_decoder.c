@@ -1,4 +1,5 @@
 #include "coding.h"
+#include "frame_walk.h"
 
 
 /* IMA table plus seven extra steps at the beginning */
@@ -19,24 +20,27 @@ static const int derf_steps[96] = {
 
 /* Xilam DERF DPCM for Stupid Invaders (PC), decompiled from the exe */
 void decode_derf(VGMSTREAMCHANNEL * stream, sample * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do) {
+    frame_walk_t fw;
     int i, sample_pos = 0, index;
     int32_t hist = stream->adpcm_history1_32;
-    off_t frame_offset = stream->offset; /* frame size is 1 */
 
-    for(i = first_sample; i < first_sample + samples_to_do; i++) {
-        uint8_t code = (uint8_t)read_8bit(frame_offset+i,stream->streamfile);
+    /* frame size is 1, read in chunks (0xFF past EOF, as read_8bit gave) */
+    FRAME_WALK_PADDED(&fw, stream->streamfile, stream->offset, FRAME_WALK_MAX_BYTES, FRAME_WALK_MAX_BYTES, first_sample, samples_to_do, 0xFF) {
+        for (i = fw.first; i < fw.first + fw.count; i++) {
+            uint8_t code = fw.frame[i];
 
-        /* original exe doesn't clamp the index, so presumably codes can't over it */
-        index = code & 0x7f;
-        if (index > 95) index = 95;
+            /* original exe doesn't clamp the index, so presumably codes can't over it */
+            index = code & 0x7f;
+            if (index > 95) index = 95;
 
-        if (code & 0x80)
-            hist -= derf_steps[index];
-        else
-            hist += derf_steps[index];
+            if (code & 0x80)
+                hist -= derf_steps[index];
+            else
+                hist += derf_steps[index];
 
-        outbuf[sample_pos] = clamp16(hist);
-        sample_pos += channelspacing;
+            outbuf[sample_pos] = clamp16(hist);
+            sample_pos += channelspacing;
+        }
     }
 
     stream->adpcm_history1_32 = hist;
@@ -34,7 +34,7 @@ struct ea_mt_codec_data {
     void* utk_context;
 };
 
-static size_t ea_mt_read_callback(void *dest, int size, void *arg);
+static const uint8_t* ea_mt_read_callback(void *arg, size_t *size);
 
 ea_mt_codec_data *init_ea_mt(int channels, int pcm_blocks) {
     return init_ea_mt_loops(channels, pcm_blocks, 0, NULL);
@@ -57,7 +57,7 @@ ea_mt_codec_data *init_ea_mt_loops(int channels, int pcm_blocks, int loop_sample
         if (loop_offsets)
             data[i].loop_offset = loop_offsets[i];
 
-        utk_set_callback(data[i].utk_context, data[i].buffer, UTK_BUFFER_SIZE, &data[i], &ea_mt_read_callback);
+        utk_set_callback(data[i].utk_context, &data[i], &ea_mt_read_callback);
     }
 
     return data;
@@ -67,8 +67,51 @@ fail:
     return NULL;
 }
 
-void decode_ea_mt(VGMSTREAM * vgmstream, sample * outbuf, int channelspacing, int32_t samples_to_do, int channel) {
+static void copy_frame_samples(const float *frame, sample * outbuf, int channelspacing, int samples) {
     int i;
+    for (i = 0; i < samples; i++) {
+        int pcm = UTK_ROUND(frame[i]);
+        outbuf[0] = (int16_t)UTK_CLAMP(pcm, -32768, 32767);
+        outbuf += channelspacing;
+    }
+}
+
+/* Loops in EA-MT are done with fully separate intro/loop substreams. We must
+ * notify the decoder when a new substream begins (even with looping disabled). */
+static void check_loop_start(ea_mt_codec_data *ch_data) {
+    UTKContext* ctx = ch_data->utk_context;
+
+    if (ch_data->loop_sample > 0 && ch_data->samples_done == ch_data->loop_sample) {
+        ch_data->samples_filled = 0;
+        ch_data->samples_discard = 0;
+
+        /* offset is usually at loop_offset here, but not always (ex. loop_sample < 432) */
+        ch_data->offset = ch_data->loop_offset;
+        utk_set_ptr(ctx, 0, 0); /* reset the buffer reader */
+        utk_reset(ctx); /* decoder init (all fields must be reset, for some edge cases) */
+    }
+}
+
+/* Decodes whole frames straight to outbuf (nothing pending, no loop/discard in the way), returns samples done. */
+static int decode_ea_mt_frames(ea_mt_codec_data *ch_data, sample * outbuf, int channelspacing, int frames) {
+    UTKContext* ctx = ch_data->utk_context;
+    int i;
+
+    for (i = 0; i < frames; i++) {
+        if (ch_data->pcm_blocks)
+            utk_rev3_decode_frame(ctx);
+        else
+            utk_decode_frame(ctx);
+
+        copy_frame_samples(ctx->decompressed_frame, outbuf, channelspacing, 432);
+        outbuf += 432 * channelspacing;
+    }
+
+    ch_data->samples_done += frames * 432;
+    return frames * 432;
+}
+
+void decode_ea_mt(VGMSTREAM * vgmstream, sample * outbuf, int channelspacing, int32_t samples_to_do, int channel) {
     ea_mt_codec_data *data = vgmstream->codec_data;
     ea_mt_codec_data *ch_data = &data[channel];
     UTKContext* ctx = ch_data->utk_context;
@@ -77,6 +120,24 @@ void decode_ea_mt(VGMSTREAM * vgmstream, sample * outbuf, int channelspacing, in
 
     while (samples_done < samples_to_do) {
 
+        if (!ch_data->samples_filled && !ch_data->samples_discard) {
+            /* whole frames up to the loop start (where the decoder resets) */
+            int frames = (samples_to_do - samples_done) / 432;
+            if (ch_data->loop_sample > 0 && ch_data->samples_done < ch_data->loop_sample) {
+                int loop_frames = (ch_data->loop_sample - ch_data->samples_done) / 432;
+                if (frames > loop_frames)
+                    frames = loop_frames;
+            }
+
+            if (frames > 0) {
+                int samples = decode_ea_mt_frames(ch_data, outbuf, channelspacing, frames);
+                outbuf += samples * channelspacing;
+                samples_done += samples;
+                check_loop_start(ch_data);
+                continue;
+            }
+        }
+
         if (ch_data->samples_filled) {
             /* consume current frame */
             int samples_to_get = ch_data->samples_filled;
@@ -97,11 +158,8 @@ void decode_ea_mt(VGMSTREAM * vgmstream, sample * outbuf, int channelspacing, in
                 if (samples_to_get > samples_to_do - samples_done)
                     samples_to_get = samples_to_do - samples_done;
 
-                for (i = ch_data->samples_used; i < ch_data->samples_used + samples_to_get; i++) {
-                    int pcm = UTK_ROUND(ctx->decompressed_frame[i]);
-                    outbuf[0] = (int16_t)UTK_CLAMP(pcm, -32768, 32767);
-                    outbuf += channelspacing;
-                }
+                copy_frame_samples(&ctx->decompressed_frame[ch_data->samples_used], outbuf, channelspacing, samples_to_get);
+                outbuf += samples_to_get * channelspacing;
 
                 samples_done += samples_to_get;
             }
@@ -111,17 +169,7 @@ void decode_ea_mt(VGMSTREAM * vgmstream, sample * outbuf, int channelspacing, in
             ch_data->samples_filled -= samples_to_get;
             ch_data->samples_done += samples_to_get;
 
-            /* Loops in EA-MT are done with fully separate intro/loop substreams. We must
-             * notify the decoder when a new substream begins (even with looping disabled). */
-            if (ch_data->loop_sample > 0 && ch_data->samples_done == ch_data->loop_sample) {
-                ch_data->samples_filled = 0;
-				ch_data->samples_discard = 0;
-
-				/* offset is usually at loop_offset here, but not always (ex. loop_sample < 432) */
-                ch_data->offset = ch_data->loop_offset;
-                utk_set_ptr(ctx, 0, 0); /* reset the buffer reader */
-                utk_reset(ctx); /* decoder init (all fields must be reset, for some edge cases) */
-            }
+            check_loop_start(ch_data);
         }
         else {
             /* new frame */
@@ -134,6 +182,11 @@ void decode_ea_mt(VGMSTREAM * vgmstream, sample * outbuf, int channelspacing, in
             ch_data->samples_filled = 432;
         }
     }
+
+    /* the input window may point into the streamfile's buffer, which other reads (blocks, other
+     * channels) invalidate, so unread bytes are given back (the bit reader keeps what it holds) */
+    ch_data->offset -= ctx->end - ctx->ptr;
+    ctx->ptr = ctx->end = NULL;
 }
 
 static void flush_ea_mt_offsets(VGMSTREAM *vgmstream, int is_start, int samples_discard) {
@@ -194,13 +247,23 @@ void free_ea_mt(ea_mt_codec_data *data, int channels) {
 
 /* ********************** */
 
-static size_t ea_mt_read_callback(void *dest, int size, void *arg) {
+/* points into the streamfile's memory when possible, or reads into the channel's buffer */
+static const uint8_t* ea_mt_read_callback(void *arg, size_t *size) {
     ea_mt_codec_data *ch_data = arg;
-    int bytes_read;
+    size_t filesize = get_streamfile_size(ch_data->streamfile);
+    size_t length = UTK_BUFFER_SIZE;
+    const uint8_t *window;
 
-    bytes_read = read_streamfile(dest,ch_data->offset,size,ch_data->streamfile);
-    ch_data->offset += bytes_read;
+    if (ch_data->offset < 0 || ch_data->offset >= filesize) {
+        *size = 0;
+        return NULL;
+    }
+    if (length > filesize - ch_data->offset)
+        length = filesize - ch_data->offset;
 
-    return bytes_read;
+    window = read_streamfile_ptr(ch_data->buffer, ch_data->offset, length, ch_data->streamfile);
+    ch_data->offset += length;
 
+    *size = length;
+    return window;
 }
@@ -7,10 +7,8 @@
 /* Note: This struct assumes a member alignment of 4 bytes.
 ** This matters when pitch_lag > 216 on the first subframe of any given frame. */
 typedef struct UTKContext {
-    uint8_t *buffer;
-    size_t buffer_size;
     void *arg;
-    size_t (*read_callback)(void *dest, int size, void *arg);
+    const uint8_t* (*read_callback)(void *arg, size_t *size); /* next input window (may be external) */
     const uint8_t *ptr, *end;
 
     int parsed_header;
@@ -131,10 +129,11 @@ static int utk_read_byte(UTKContext *ctx)
         return *ctx->ptr++;
 
     if (ctx->read_callback) {
-        size_t bytes_copied = ctx->read_callback(ctx->buffer, ctx->buffer_size, ctx->arg);
-        if (bytes_copied > 0 && bytes_copied <= ctx->buffer_size) {
-            ctx->ptr = ctx->buffer;
-            ctx->end = ctx->buffer + bytes_copied;
+        size_t size = 0;
+        const uint8_t *window = ctx->read_callback(ctx->arg, &size);
+        if (window && size > 0) {
+            ctx->ptr = window;
+            ctx->end = window + size;
             return *ctx->ptr++;
         }
     }
@@ -142,11 +141,19 @@ static int utk_read_byte(UTKContext *ctx)
     return 0;
 }
 
-static int16_t utk_read_i16(UTKContext *ctx)
+/* tops up the bit reader to at least 8 bits, a whole word at once when the window has it */
+static void utk_refill_bits(UTKContext *ctx)
 {
-    int x = utk_read_byte(ctx);
-    x = (x << 8) | utk_read_byte(ctx);
-    return x;
+    if (ctx->end - ctx->ptr >= 4) {
+        while (ctx->bits_count <= 24) {
+            ctx->bits_value |= (unsigned int)*ctx->ptr++ << ctx->bits_count;
+            ctx->bits_count += 8;
+        }
+    }
+    else {
+        ctx->bits_value |= utk_read_byte(ctx) << ctx->bits_count;
+        ctx->bits_count += 8;
+    }
 }
 
 static int utk_read_bits(UTKContext *ctx, int count)
@@ -155,15 +162,39 @@ static int utk_read_bits(UTKContext *ctx, int count)
     ctx->bits_value >>= count;
     ctx->bits_count -= count;
 
-    if (ctx->bits_count < 8) {
-        /* read another byte */
-        ctx->bits_value |= utk_read_byte(ctx) << ctx->bits_count;
-        ctx->bits_count += 8;
-    }
+    if (ctx->bits_count < 8)
+        utk_refill_bits(ctx);
+
+    return ret;
+}
+
+/* drops the bits left in the current byte, so whole bytes read ahead are taken by utk_read_aligned_byte */
+static void utk_align_bits(UTKContext *ctx)
+{
+    ctx->bits_value >>= ctx->bits_count & 7;
+    ctx->bits_count &= ~7;
+}
+
+static int utk_read_aligned_byte(UTKContext *ctx)
+{
+    int ret;
+
+    if (ctx->bits_count < 8)
+        return utk_read_byte(ctx);
 
+    ret = ctx->bits_value & 0xff;
+    ctx->bits_value >>= 8;
+    ctx->bits_count -= 8;
     return ret;
 }
 
+static int16_t utk_read_i16(UTKContext *ctx)
+{
+    int x = utk_read_aligned_byte(ctx);
+    x = (x << 8) | utk_read_aligned_byte(ctx);
+    return x;
+}
+
 static void utk_parse_header(UTKContext *ctx)
 {
     int i;
@@ -265,27 +296,44 @@ static void rc_to_lpc(const float *rc, float *lpc)
     }
 }
 
+/* synth_history keeps the last 12 outputs in reverse (synth_history[11-j] = j-th of the last block),
+ * so it's unrolled into a linear buffer to run as a plain IIR (same sums in the same order) */
 static void utk_lp_synthesis_filter(UTKContext *ctx, int offset, int num_blocks)
 {
-    int i, j, k;
+    int i;
+    int count = num_blocks * 12;
     float lpc[12];
+    float y[12+432];
     float *ptr = &ctx->decompressed_frame[offset];
 
     rc_to_lpc(ctx->rc, lpc);
 
-    for (i = 0; i < num_blocks; i++) {
-        for (j = 0; j < 12; j++) {
-            float x = *ptr;
-
-            for (k = 0; k < j; k++)
-                x += lpc[k] * ctx->synth_history[k-j+12];
-            for (; k < 12; k++)
-                x += lpc[k] * ctx->synth_history[k-j];
-
-            ctx->synth_history[11-j] = x;
-            *ptr++ = x;
-        }
+    for (i = 0; i < 12; i++)
+        y[i] = ctx->synth_history[11-i];
+
+    for (i = 0; i < count; i++) {
+        const float *past = &y[12+i];
+        float x = ptr[i];
+
+        x += lpc[0] * past[-1];
+        x += lpc[1] * past[-2];
+        x += lpc[2] * past[-3];
+        x += lpc[3] * past[-4];
+        x += lpc[4] * past[-5];
+        x += lpc[5] * past[-6];
+        x += lpc[6] * past[-7];
+        x += lpc[7] * past[-8];
+        x += lpc[8] * past[-9];
+        x += lpc[9] * past[-10];
+        x += lpc[10] * past[-11];
+        x += lpc[11] * past[-12];
+
+        y[12+i] = x;
     }
+
+    memcpy(ptr, &y[12], count * sizeof(float));
+    for (i = 0; i < 12; i++)
+        ctx->synth_history[11-i] = y[count+i];
 }
 
 /*
@@ -300,8 +348,8 @@ static int utk_decode_frame(UTKContext *ctx)
     float rc_delta[12];
 
     if (!ctx->bits_count) {
-        ctx->bits_value = utk_read_byte(ctx);
-        ctx->bits_count = 8;
+        ctx->bits_value = 0;
+        utk_refill_bits(ctx);
     }
 
     if (!ctx->parsed_header) {
@@ -404,11 +452,9 @@ static void utk_reset(UTKContext *ctx)
     memset(ctx->decompressed_frame, 0, sizeof(ctx->decompressed_frame));
 }
 
-static void utk_set_callback(UTKContext *ctx, uint8_t *buffer, size_t buffer_size, void *arg, size_t (*read_callback)(void *, int , void *))
+static void utk_set_callback(UTKContext *ctx, void *arg, const uint8_t* (*read_callback)(void *, size_t *))
 {
     /* prepares for external reading */
-    ctx->buffer = buffer;
-    ctx->buffer_size = buffer_size;
     ctx->arg = arg;
     ctx->read_callback = read_callback;
 
@@ -433,14 +479,13 @@ static void utk_set_ptr(UTKContext *ctx, const uint8_t *ptr, const uint8_t *end)
 
 static int utk_rev3_decode_frame(UTKContext *ctx)
 {
-    int pcm_data_present = (utk_read_byte(ctx) == 0xee);
+    int pcm_data_present = (utk_read_aligned_byte(ctx) == 0xee);
     int i;
 
     utk_decode_frame(ctx);
 
-    /* unread the last 8 bits and reset the bit reader */
-    ctx->ptr--;
-    ctx->bits_count = 0;
+    /* continue from the next byte (the bit reader may have whole bytes read ahead) */
+    utk_align_bits(ctx);
 
     if (pcm_data_present) {
         /* Overwrite n samples at a given offset in the decoded frame with
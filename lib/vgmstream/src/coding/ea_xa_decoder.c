@@ -31,6 +31,7 @@ static const int EA_XA_TABLE[20] = {
 
 /* EA XA v2 (always mono); like ea_xa_int but with "PCM samples" flag and doesn't add 128 on expand or clamp (pre-adjusted by the encoder?) */
 void decode_ea_xa_v2(VGMSTREAMCHANNEL * stream, sample * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do, int channel) {
+    uint8_t frame[0x01 + 2*0x02 + 28*0x02];
     uint8_t frame_info;
     int32_t coef1, coef2;
     int i, sample_count, shift;
@@ -40,15 +41,17 @@ void decode_ea_xa_v2(VGMSTREAMCHANNEL * stream, sample * outbuf, int channelspac
     int frame_samples = 28;
     first_sample = first_sample % frame_samples;
 
-    /* header */
-    frame_info = read_8bit(stream->offset,stream->streamfile);
+    /* read the biggest frame once, then header (0xFF past EOF, as read_8bit gave) */
+    memset(frame, 0xFF, sizeof(frame));
+    read_streamfile(frame, stream->offset, pcm_frame_size, stream->streamfile); /* ignore EOF errors */
+    frame_info = frame[0x00];
 
     if (frame_info == 0xEE) { /* PCM frame (used in later revisions), samples always BE */
-        stream->adpcm_history1_32 = read_16bitBE(stream->offset + 0x01 + 0x00,stream->streamfile);
-        stream->adpcm_history2_32 = read_16bitBE(stream->offset + 0x01 + 0x02,stream->streamfile);
+        stream->adpcm_history1_32 = get_16bitBE(frame + 0x01 + 0x00);
+        stream->adpcm_history2_32 = get_16bitBE(frame + 0x01 + 0x02);
 
         for (i=first_sample,sample_count=0; i<first_sample+samples_to_do; i++,sample_count+=channelspacing) {
-            outbuf[sample_count] = read_16bitBE(stream->offset + 0x01 + 2*0x02 + i*0x02,stream->streamfile);
+            outbuf[sample_count] = get_16bitBE(frame + 0x01 + 2*0x02 + i*0x02);
         }
 
         /* only increment offset on complete frame */
@@ -56,27 +59,30 @@ void decode_ea_xa_v2(VGMSTREAMCHANNEL * stream, sample * outbuf, int channelspac
             stream->offset += pcm_frame_size;
     }
     else { /* ADPCM frame */
+        int32_t hist1 = stream->adpcm_history1_32;
+        int32_t hist2 = stream->adpcm_history2_32;
+
         coef1 = EA_XA_TABLE[(frame_info >> 4) + 0];
         coef2 = EA_XA_TABLE[(frame_info >> 4) + 4];
         shift = (frame_info & 0x0F) + 8;
 
         for (i=first_sample,sample_count=0; i<first_sample+samples_to_do; i++,sample_count+=channelspacing) {
-            uint8_t sample_byte, sample_nibble;
+            uint8_t sample_byte = frame[0x01 + i/2];
+            uint8_t sample_nibble = (!(i&1)) ? sample_byte >> 4 : sample_byte & 0x0F; /* high nibble first */
             int32_t new_sample;
-            off_t byte_offset = (stream->offset + 0x01 + i/2);
-            int nibble_shift = (!(i&1)) ? 4 : 0; /* high nibble first */
 
-            sample_byte = (uint8_t)read_8bit(byte_offset,stream->streamfile);
-            sample_nibble = (sample_byte >> nibble_shift) & 0x0F;
-            new_sample = (sample_nibble << 28) >> shift; /* sign extend to 32b and shift */
-            new_sample = (new_sample + coef1 * stream->adpcm_history1_32 + coef2 * stream->adpcm_history2_32) >> 8;
+            new_sample = (int32_t)((uint32_t)sample_nibble << 28) >> shift; /* sign extend to 32b and shift */
+            new_sample = (new_sample + coef1 * hist1 + coef2 * hist2) >> 8;
             new_sample = clamp16(new_sample);
 
             outbuf[sample_count] = new_sample;
-            stream->adpcm_history2_32 = stream->adpcm_history1_32;
-            stream->adpcm_history1_32 = new_sample;
+            hist2 = hist1;
+            hist1 = new_sample;
         }
 
+        stream->adpcm_history1_32 = hist1;
+        stream->adpcm_history2_32 = hist2;
+
         /* only increment offset on complete frame */
         if (i == frame_samples)
             stream->offset += xa_frame_size;
@@ -183,83 +189,106 @@ void decode_ea_xa_v2(VGMSTREAMCHANNEL * stream, sample * outbuf, int channelspac
 }
 #endif
 
-/* EA XA v1 stereo */
-void decode_ea_xa(VGMSTREAMCHANNEL * stream, sample * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do,int channel) {
-    uint8_t frame_info;
-    int32_t coef1, coef2;
-    int i, sample_count, shift;
-    int hn = (channel==0); /* high nibble marker for stereo subinterleave, ch0/L=high nibble, ch1/R=low nibble */
+/* EA XA v1 stereo, both channels in the same frame (header: coefs ch0+ch1, shifts ch0+ch1; then a byte per sample
+ * with ch0/L in the high nibble and ch1/R in the low nibble). Channels sharing an offset are decoded from a single read. */
+void decode_ea_xa(VGMSTREAM* vgmstream, sample_t* outbuf, int32_t first_sample, int32_t samples_to_do) {
+    uint8_t frame[0x1e];
+    off_t frame_offset = -1;
+    STREAMFILE* frame_sf = NULL;
+    int ch, i, channels = vgmstream->channels;
 
     int frame_size = 0x1e;
     int frame_samples = 28;
     first_sample = first_sample % frame_samples;
+    if (samples_to_do > frame_samples - first_sample)
+        samples_to_do = frame_samples - first_sample;
+
+    for (ch = 0; ch < channels; ch++) {
+        VGMSTREAMCHANNEL* stream = &vgmstream->ch[ch];
+        int hn = (ch==0); /* high nibble marker for stereo subinterleave, ch0/L=high nibble, ch1/R=low nibble */
+        int32_t hist1 = stream->adpcm_history1_32;
+        int32_t hist2 = stream->adpcm_history2_32;
+        int32_t coef1, coef2;
+        int shift;
+        sample_t* out = outbuf + ch;
+
+        if (stream->offset != frame_offset || stream->streamfile != frame_sf) {
+            size_t bytes = read_streamfile(frame, stream->offset, frame_size, stream->streamfile);
+            if (bytes < frame_size) /* ignore EOF errors, 0xFF as read_8bit gave */
+                memset(frame + bytes, 0xFF, frame_size - bytes);
+            frame_offset = stream->offset;
+            frame_sf = stream->streamfile;
+        }
 
-    /* header (coefs ch0+ch1 + shift ch0+ch1) */
-    frame_info = read_8bit(stream->offset+0x00,stream->streamfile);
-    coef1 = EA_XA_TABLE[(hn ? frame_info >> 4 : frame_info & 0x0F) + 0];
-    coef2 = EA_XA_TABLE[(hn ? frame_info >> 4 : frame_info & 0x0F) + 4];
-    shift = (frame_info & 0x0F) + 8;
+        coef1 = EA_XA_TABLE[(hn ? frame[0x00] >> 4 : frame[0x00] & 0x0F) + 0];
+        coef2 = EA_XA_TABLE[(hn ? frame[0x00] >> 4 : frame[0x00] & 0x0F) + 4];
+        shift = (hn ? frame[0x01] >> 4 : frame[0x01] & 0x0F) + 8;
 
-    frame_info = read_8bit(stream->offset+0x01,stream->streamfile);
-    shift = (hn ? frame_info >> 4 : frame_info & 0x0F) + 8;
+        for (i = first_sample; i < first_sample + samples_to_do; i++) {
+            uint8_t sample_nibble = hn ? frame[0x02 + i] >> 4 : frame[0x02 + i] & 0x0F;
+            int32_t new_sample;
 
-    /* samples */
-    for (i=first_sample,sample_count=0; i<first_sample+samples_to_do; i++,sample_count+=channelspacing) {
-        uint8_t sample_byte, sample_nibble;
-        int32_t new_sample;
-        off_t byte_offset = (stream->offset + 0x02 + i);
-        int nibble_shift = (hn ? 4 : 0); /* high nibble first */
+            new_sample = (int32_t)((uint32_t)sample_nibble << 28) >> shift; /* sign extend to 32b and shift */
+            new_sample = (new_sample + coef1 * hist1 + coef2 * hist2 + 128) >> 8;
+            new_sample = clamp16(new_sample);
 
-        sample_byte = (uint8_t)read_8bit(byte_offset,stream->streamfile);
-        sample_nibble = (sample_byte >> nibble_shift) & 0x0F;
-        new_sample = (sample_nibble << 28) >> shift; /* sign extend to 32b and shift */
-        new_sample = (new_sample + coef1 * stream->adpcm_history1_32 + coef2 * stream->adpcm_history2_32 + 128) >> 8;
-        new_sample = clamp16(new_sample);
+            *out = new_sample;
+            out += channels;
+            hist2 = hist1;
+            hist1 = new_sample;
+        }
 
-        outbuf[sample_count] = new_sample;
-        stream->adpcm_history2_32 = stream->adpcm_history1_32;
-        stream->adpcm_history1_32 = new_sample;
+        stream->adpcm_history1_32 = hist1;
+        stream->adpcm_history2_32 = hist2;
     }
 
-    /* only increment offset on complete frame */
-    if (i == frame_samples)
-        stream->offset += frame_size;
+    /* only increment offset on complete frame (after all channels, as they may share it) */
+    if (first_sample + samples_to_do == frame_samples) {
+        for (ch = 0; ch < channels; ch++) {
+            vgmstream->ch[ch].offset += frame_size;
+        }
+    }
 }
 
 /* EA-XA v1 mono/interleave */
 void decode_ea_xa_int(VGMSTREAMCHANNEL * stream, sample * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do,int channel) {
+    uint8_t frame[0x0f];
     uint8_t frame_info;
     int32_t coef1, coef2;
+    int32_t hist1 = stream->adpcm_history1_32;
+    int32_t hist2 = stream->adpcm_history2_32;
     int i, sample_count, shift;
 
     int frame_size = 0x0f;
     int frame_samples = 28;
     first_sample = first_sample % frame_samples;
 
-    /* header (coefs+shift ch0) */
-    frame_info = read_8bit(stream->offset,stream->streamfile);
+    /* header (coefs+shift ch0), 0xFF past EOF as read_8bit gave */
+    memset(frame, 0xFF, sizeof(frame));
+    read_streamfile(frame, stream->offset, frame_size, stream->streamfile); /* ignore EOF errors */
+    frame_info = frame[0x00];
     coef1 = EA_XA_TABLE[(frame_info >> 4) + 0];
     coef2 = EA_XA_TABLE[(frame_info >> 4) + 4];
     shift = (frame_info & 0x0F) + 8;
 
     /* samples */
     for (i=first_sample,sample_count=0; i<first_sample+samples_to_do; i++,sample_count+=channelspacing) {
-        uint8_t sample_byte, sample_nibble;
+        uint8_t sample_byte = frame[0x01 + i/2];
+        uint8_t sample_nibble = (!(i&1)) ? sample_byte >> 4 : sample_byte & 0x0F; /* high nibble first */
         int32_t new_sample;
-        off_t byte_offset = (stream->offset + 0x01 + i/2);
-        int nibble_shift = (!(i&1)) ? 4 : 0; /* high nibble first */
 
-        sample_byte = (uint8_t)read_8bit(byte_offset,stream->streamfile);
-        sample_nibble = (sample_byte >> nibble_shift) & 0x0F;
-        new_sample = (sample_nibble << 28) >> shift; /* sign extend to 32b and shift */
-        new_sample = (new_sample + coef1 * stream->adpcm_history1_32 + coef2 * stream->adpcm_history2_32 + 128) >> 8;
+        new_sample = (int32_t)((uint32_t)sample_nibble << 28) >> shift; /* sign extend to 32b and shift */
+        new_sample = (new_sample + coef1 * hist1 + coef2 * hist2 + 128) >> 8;
         new_sample = clamp16(new_sample);
 
         outbuf[sample_count] = new_sample;
-        stream->adpcm_history2_32 = stream->adpcm_history1_32;
-        stream->adpcm_history1_32 = new_sample;
+        hist2 = hist1;
+        hist1 = new_sample;
     }
 
+    stream->adpcm_history1_32 = hist1;
+    stream->adpcm_history2_32 = hist2;
+
     /* only increment offset on complete frame */
     if (i == frame_samples)
         stream->offset += frame_size;
@@ -1,5 +1,10 @@
 #include "coding.h"
 #include "../util.h"
+#include "../cpu.h"
+
+#define EA_XAS_V1_FRAME_SIZE        0x4c
+#define EA_XAS_V1_FRAME_SAMPLES     128
+#define EA_XAS_V1_MAX_SHARED        8   /* channels read in a single call */
 
 #if 0
 /* known game code/platforms use float buffer and coefs, but some approximations around use this int math:
@@ -28,22 +33,13 @@ static const float xa_coefs[16][2] = {
 /* EA-XAS v1, evolution of EA-XA/XAS and cousin of MTA2. Reverse engineered from various .exes/.so
  *
  * Layout: blocks of 0x4c per channel (128 samples), divided into 4 headers + 4 vertical groups of 15 bytes.
- * Original code reads all headers first then processes all nibbles (for CPU cache/parallelism/SIMD optimizations).
- * To simplify, always decodes the block and discards unneeded samples, so doesn't use external hist. */
-void decode_ea_xas_v1(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do, int channel) {
-    uint8_t frame[0x4c] = {0};
-    off_t frame_offset;
-    int group, row, i, samples_done = 0, sample_count = 0;
-    size_t bytes_per_frame, samples_per_frame;
-
-
-    /* internal interleave */
-    bytes_per_frame = 0x4c;
-    samples_per_frame = 128;
-    first_sample = first_sample % samples_per_frame;
-
-    frame_offset = stream->offset + bytes_per_frame * channel;
-    read_streamfile(frame, frame_offset, bytes_per_frame, stream->streamfile); /* ignore EOF errors */
+ * Original code reads all headers first then processes all nibbles (for CPU cache/parallelism/SIMD optimizations),
+ * same here: groups are independent so the 4 filters run side by side in the ea_xas_groups kernel. */
+static void decode_ea_xas_v1_frame(const uint8_t* frame, int16_t* samples) {
+    float coefs[4*2];
+    int16_t hists[4*2];
+    int shifts[4];
+    int group;
 
     //todo: original code uses float sample buffer:
     //- header pcm-hist to float-hist:  hist * (1/32768)
@@ -53,61 +49,77 @@ void decode_ea_xas_v1(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channels
     //- coefs apply normally, though hists are already floats
     //- final float sample isn't clamped
 
-
     /* parse group headers */
     for (group = 0; group < 4; group++) {
-        float coef1, coef2;
-        int16_t hist1, hist2;
-        uint8_t shift;
         uint32_t group_header = (uint32_t)get_32bitLE(frame + group*0x4); /* always LE */
 
-        coef1 = xa_coefs[group_header & 0x0F][0];
-        coef2 = xa_coefs[group_header & 0x0F][1];
-        hist2 = (int16_t)((group_header >>  0) & 0xFFF0);
-        hist1 = (int16_t)((group_header >> 16) & 0xFFF0);
-        shift = (group_header >> 16) & 0x0F;
+        coefs[group*2 + 0] = xa_coefs[group_header & 0x0F][0];
+        coefs[group*2 + 1] = xa_coefs[group_header & 0x0F][1];
+        hists[group*2 + 1] = (int16_t)((group_header >>  0) & 0xFFF0);
+        hists[group*2 + 0] = (int16_t)((group_header >> 16) & 0xFFF0);
+        shifts[group] = (group_header >> 16) & 0x0F;
 
-        /* write header samples (needed) */
-        if (sample_count >= first_sample && samples_done < samples_to_do) {
-            outbuf[samples_done * channelspacing] = hist2;
-            samples_done++;
+        /* header samples (needed) */
+        samples[group*32 + 0] = hists[group*2 + 1];
+        samples[group*32 + 1] = hists[group*2 + 0];
+    }
+
+    /* process nibbles of all groups */
+    vgm_get_kernels()->ea_xas_groups(samples, frame + 4*4, coefs, hists, shifts);
+}
+
+/* Decodes one frame of all channels. Channels are interleaved per frame in the same block so their
+ * offsets match and a single read covers them; always decodes the frame and discards unneeded samples,
+ * so doesn't use external hist. */
+void decode_ea_xas_v1(VGMSTREAM* vgmstream, sample_t* outbuf, int32_t first_sample, int32_t samples_to_do) {
+    uint8_t frames[EA_XAS_V1_FRAME_SIZE * EA_XAS_V1_MAX_SHARED];
+    int16_t samples[EA_XAS_V1_FRAME_SAMPLES];
+    int ch, s, channels = vgmstream->channels;
+    int shared = (channels <= EA_XAS_V1_MAX_SHARED);
+    size_t bytes_per_frame = EA_XAS_V1_FRAME_SIZE;
+    int samples_per_frame = EA_XAS_V1_FRAME_SAMPLES;
+
+
+    /* internal interleave */
+    first_sample = first_sample % samples_per_frame;
+    if (samples_to_do > samples_per_frame - first_sample)
+        samples_to_do = samples_per_frame - first_sample;
+
+    for (ch = 1; ch < channels && shared; ch++) {
+        if (vgmstream->ch[ch].offset != vgmstream->ch[0].offset || vgmstream->ch[ch].streamfile != vgmstream->ch[0].streamfile)
+            shared = 0;
+    }
+
+    if (shared) {
+        size_t frames_size = bytes_per_frame * channels;
+        size_t bytes = read_streamfile(frames, vgmstream->ch[0].offset, frames_size, vgmstream->ch[0].streamfile);
+        if (bytes < frames_size) /* ignore EOF errors */
+            memset(frames + bytes, 0, frames_size - bytes);
+    }
+
+    for (ch = 0; ch < channels; ch++) {
+        VGMSTREAMCHANNEL* stream = &vgmstream->ch[ch];
+        const uint8_t* frame = frames;
+
+        if (shared) {
+            frame = frames + bytes_per_frame * ch;
         }
-        sample_count++;
-        if (sample_count >= first_sample && samples_done < samples_to_do) {
-            outbuf[samples_done * channelspacing] = hist1;
-            samples_done++;
+        else {
+            size_t bytes = read_streamfile(frames, stream->offset + bytes_per_frame * ch, bytes_per_frame, stream->streamfile);
+            if (bytes < bytes_per_frame)
+                memset(frames + bytes, 0, bytes_per_frame - bytes);
         }
-        sample_count++;
 
-        /* process nibbles per group */
-        for (row = 0; row < 15; row++) {
-            for (i = 0; i < 1*2; i++) {
-                uint8_t nibbles = frame[4*4 + row*0x04 + group + i/2];
-                int sample;
-
-                sample = i&1 ? /* high nibble first */
-                        (nibbles >> 0) & 0x0f :
-                        (nibbles >> 4) & 0x0f;
-                sample = (int16_t)(sample << 12) >> shift; /* 16b sign extend + scale */
-                sample = sample + hist1 * coef1 + hist2 * coef2;
-                sample = clamp16(sample);
-
-                if (sample_count >= first_sample && samples_done < samples_to_do) {
-                    outbuf[samples_done * channelspacing] = sample;
-                    samples_done++;
-                }
-                sample_count++;
-
-                hist2 = hist1;
-                hist1 = sample;
-            }
-        }
-    }
+        decode_ea_xas_v1_frame(frame, samples);
 
+        for (s = 0; s < samples_to_do; s++) {
+            outbuf[s * channels + ch] = samples[first_sample + s];
+        }
 
-    /* internal interleave (interleaved channels, but manually advances to co-exist with ea blocks) */
-    if (first_sample + samples_done == samples_per_frame)  {
-        stream->offset += bytes_per_frame * channelspacing;
+        /* internal interleave (interleaved channels, but manually advances to co-exist with ea blocks) */
+        if (first_sample + samples_to_do == samples_per_frame) {
+            stream->offset += bytes_per_frame * channels;
+        }
     }
 }
 
@@ -6,7 +6,7 @@
 #define FFMPEG_DEFAULT_IO_BUFFER_SIZE 128 * 1024
 
 
-static volatile int g_ffmpeg_initialized = 0;
+static vgm_once_t g_ffmpeg_initialized = 0;
 
 static void free_ffmpeg_config(ffmpeg_codec_data *data);
 static int init_ffmpeg_config(ffmpeg_codec_data * data, int target_subsong, int reset);
@@ -19,19 +19,16 @@ static void seek_ffmpeg_internal(ffmpeg_codec_data *data, int32_t num_sample);
 /* ******************************************** */
 
 /* Global FFmpeg init */
-static void g_init_ffmpeg() {
-    if (g_ffmpeg_initialized == 1) {
-        while (g_ffmpeg_initialized < 2); /* active wait for lack of a better way */
-    }
-    else if (g_ffmpeg_initialized == 0) {
-        g_ffmpeg_initialized = 1;
-        av_log_set_flags(AV_LOG_SKIP_REPEATED);
-        av_log_set_level(AV_LOG_ERROR);
+static void g_setup_ffmpeg(void) {
+    av_log_set_flags(AV_LOG_SKIP_REPEATED);
+    av_log_set_level(AV_LOG_ERROR);
 //#if LIBAVCODEC_VERSION_INT < AV_VERSION_INT(58, 18, 100)
-//        av_register_all(); /* not needed in newer versions */
+//    av_register_all(); /* not needed in newer versions */
 //#endif
-        g_ffmpeg_initialized = 2;
-    }
+}
+
+static void g_init_ffmpeg() {
+    vgm_once(&g_ffmpeg_initialized, g_setup_ffmpeg);
 }
 
 static void remap_audio(sample_t *outbuf, int sample_count, int channels, int *channel_mappings) {
@@ -454,6 +451,149 @@ fail:
     return -1;
 }
 
+/**
+ * Manually init FFmpeg's decoder alone, fed with packets from an index.
+ *
+ * For custom layouts no demuxer understands, so packets are read as-is (no fake header or
+ * container conversion). The index has count absolute packet offsets/sizes within the streamfile,
+ * and samples the decoder outputs before each one plus a final entry with the total. Arrays are
+ * owned by the codec data after this call (even on failure).
+ * Seeks restart at the packet preroll samples before the target, for codecs needing a few
+ * frames to converge (ex. Opus), and skip samples are handled like ffmpeg_set_skip_samples.
+ */
+ffmpeg_codec_data* init_ffmpeg_raw_packets(STREAMFILE* sf, int codec_id, const uint8_t* extradata, size_t extradata_size,
+        int channels, int sample_rate, int preroll, int count, uint32_t* offsets, uint32_t* sizes, int32_t* samples) {
+    ffmpeg_codec_data* data = NULL;
+    uint32_t max_size = 0;
+    int i, errcode;
+
+
+    /* initial FFmpeg setup */
+    g_init_ffmpeg();
+
+    data = calloc(1, sizeof(ffmpeg_codec_data));
+    if (!data) goto fail;
+
+    data->raw_count = count;
+    data->raw_offsets = offsets;
+    data->raw_sizes = sizes;
+    data->raw_samples = samples;
+    data->raw_preroll = preroll;
+    if (count <= 0 || !offsets || !sizes || !samples)
+        goto fail;
+
+    for (i = 0; i < count; i++) {
+        if (offsets[i] + sizes[i] > get_streamfile_size(sf)) {
+            VGM_LOG("FFMPEG: wrong raw packet %i at %x + %x\n", i, offsets[i], sizes[i]);
+            goto fail;
+        }
+        if (max_size < sizes[i])
+            max_size = sizes[i];
+    }
+
+    data->raw_buf = malloc(max_size);
+    if (!data->raw_buf) goto fail;
+
+    data->streamfile = reopen_streamfile(sf, 0);
+    if (!data->streamfile) goto fail;
+
+    data->start = offsets[0];
+    data->offset = data->start;
+    data->size = offsets[count - 1] + sizes[count - 1] - data->start;
+
+
+    /* setup codec directly */
+    data->codec = avcodec_find_decoder(codec_id);
+    if (!data->codec) goto fail;
+
+    data->codecCtx = avcodec_alloc_context3(data->codec);
+    if (!data->codecCtx) goto fail;
+
+    data->codecCtx->channels = channels;
+    data->codecCtx->sample_rate = sample_rate;
+    if (extradata_size > 0) {
+        data->codecCtx->extradata = av_mallocz(extradata_size + AV_INPUT_BUFFER_PADDING_SIZE);
+        if (!data->codecCtx->extradata) goto fail;
+        memcpy(data->codecCtx->extradata, extradata, extradata_size);
+        data->codecCtx->extradata_size = extradata_size;
+    }
+
+    errcode = avcodec_open2(data->codecCtx, data->codec, NULL);
+    if (errcode < 0) goto fail;
+
+    data->packet = av_malloc(sizeof(AVPacket));
+    if (!data->packet) goto fail;
+    av_new_packet(data->packet, 0);
+
+    data->frame = av_frame_alloc();
+    if (!data->frame) goto fail;
+    av_frame_unref(data->frame);
+
+    /* reset non-zero values */
+    data->read_packet = 1;
+
+    data->sampleRate = data->codecCtx->sample_rate;
+    data->channels = data->codecCtx->channels;
+    data->bitrate = (int)(data->codecCtx->bit_rate);
+    data->totalSamples = samples[count];
+    data->streamCount = 1;
+
+    ffmpeg_set_skip_samples(data, 0);
+
+    return data;
+fail:
+    if (data) {
+        free_ffmpeg(data); /* frees the index too */
+    }
+    else {
+        free(offsets);
+        free(sizes);
+        free(samples);
+    }
+    return NULL;
+}
+
+/* Reads the next indexed packet, pointing to the streamfile's memory when possible (FFmpeg copies
+ * non-refcounted packets when sent). Returns 0 or AVERROR_EOF like av_read_frame. */
+static int read_raw_packet(ffmpeg_codec_data* data) {
+    AVPacket* pkt = data->packet;
+    uint32_t offset, size;
+
+    if (data->raw_current >= data->raw_count)
+        return AVERROR_EOF;
+
+    offset = data->raw_offsets[data->raw_current];
+    size = data->raw_sizes[data->raw_current];
+    data->raw_current++;
+
+    pkt->data = (uint8_t*)read_streamfile_ptr(data->raw_buf, offset, size, data->streamfile);
+    pkt->size = size;
+    pkt->stream_index = data->streamIndex;
+    return 0;
+}
+
+/* Sets the indexed packet to decode from for target (decoder samples including skips),
+ * returning the samples before it. */
+static int32_t seek_raw_packet(ffmpeg_codec_data* data, int32_t target) {
+    int lo, hi;
+
+    target -= data->raw_preroll;
+
+    /* last packet at or before target */
+    lo = 0;
+    hi = data->raw_count - 1;
+    while (lo < hi) {
+        int mid = (lo + hi + 1) / 2;
+        if (data->raw_samples[mid] <= target)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+
+    data->raw_current = lo;
+    return data->raw_samples[lo];
+}
+
 /* decodes a new frame to internal data */
 static int decode_ffmpeg_frame(ffmpeg_codec_data *data) {
     int errcode;
@@ -477,8 +617,11 @@ static int decode_ffmpeg_frame(ffmpeg_codec_data *data) {
             /* reset old packet */
             av_packet_unref(data->packet);
 
-            /* read encoded data from demuxer into packet */
-            errcode = av_read_frame(data->formatCtx, data->packet);
+            /* read encoded data from demuxer (or index) into packet */
+            if (data->raw_count)
+                errcode = read_raw_packet(data);
+            else
+                errcode = av_read_frame(data->formatCtx, data->packet);
             if (errcode < 0) {
                 if (errcode == AVERROR_EOF) {
                     data->end_of_stream = 1; /* no more data to read (but may "drain" samples) */
@@ -488,7 +631,7 @@ static int decode_ffmpeg_frame(ffmpeg_codec_data *data) {
                     frame_error = 1; //goto fail;
                 }
 
-                if (data->formatCtx->pb && data->formatCtx->pb->error) {
+                if (data->formatCtx && data->formatCtx->pb && data->formatCtx->pb->error) {
                     VGM_LOG("FFMPEG: pb error=%i\n", data->formatCtx->pb->error);
                     frame_error = 1; //goto fail;
                 }
@@ -621,6 +764,17 @@ static void samples_s16_to_s16(sample_t* obuf, int16_t* ibuf, int ichs, int samp
 }
 static void samples_s16p_to_s16(sample_t* obuf, int16_t** ibuf, int ichs, int samples, int skip) {
     int s, ch;
+
+    if (ichs == 2) {
+        const int16_t* ibuf_l = ibuf[0] + skip;
+        const int16_t* ibuf_r = ibuf[1] + skip;
+        for (s = 0; s < samples; s++) {
+            obuf[s*2 + 0] = ibuf_l[s];
+            obuf[s*2 + 1] = ibuf_r[s];
+        }
+        return;
+    }
+
     for (ch = 0; ch < ichs; ch++) {
         for (s = 0; s < samples; s++) {
             obuf[s*ichs + ch] = ibuf[ch][skip + s];
@@ -641,19 +795,43 @@ static void samples_s32p_to_s16(sample_t* obuf, int32_t** ibuf, int ichs, int sa
         }
     }
 }
+/* float to s16 clamping first and rounding without lrintf, so compilers can vectorize loops using it
+ * (lrintf returns a long and isn't vectorized; halves round away from zero rather than to even) */
+static inline sample_t float_to_s16(float val) {
+    if (val > 32767.0f)
+        val = 32767.0f;
+    else if (val < -32768.0f)
+        val = -32768.0f;
+    return (sample_t)(int)(val < 0.0f ? val - 0.5f : val + 0.5f);
+}
+
 static void samples_flt_to_s16(sample_t* obuf, float* ibuf, int ichs, int samples, int skip, int invert) {
     int s, total_samples = samples * ichs;
     float scale = invert ? -32768.0f : 32768.0f;
+    ibuf += skip * ichs;
     for (s = 0; s < total_samples; s++) {
-        obuf[s] = clamp16(float_to_int(ibuf[skip*ichs + s] * scale));
+        obuf[s] = float_to_s16(ibuf[s] * scale);
     }
 }
 static void samples_fltp_to_s16(sample_t* obuf, float** ibuf, int ichs, int samples, int skip, int invert) {
     int s, ch;
     float scale = invert ? -32768.0f : 32768.0f;
+
+    /* most common case, written as a single pass of fixed stride to allow vectorizing */
+    if (ichs == 2) {
+        const float* ibuf_l = ibuf[0] + skip;
+        const float* ibuf_r = ibuf[1] + skip;
+        for (s = 0; s < samples; s++) {
+            obuf[s*2 + 0] = float_to_s16(ibuf_l[s] * scale);
+            obuf[s*2 + 1] = float_to_s16(ibuf_r[s] * scale);
+        }
+        return;
+    }
+
     for (ch = 0; ch < ichs; ch++) {
+        const float* iplane = ibuf[ch] + skip;
         for (s = 0; s < samples; s++) {
-            obuf[s*ichs + ch] = clamp16(float_to_int(ibuf[ch][skip + s] * scale));
+            obuf[s*ichs + ch] = float_to_s16(iplane[s] * scale);
         }
     }
 }
@@ -708,10 +886,121 @@ static void copy_samples(ffmpeg_codec_data *data, sample_t *outbuf, int samples_
         remap_audio(outbuf, samples_to_do, channels, data->channel_remap);
 }
 
-/* decode samples of any kind of FFmpeg format */
-void decode_ffmpeg(VGMSTREAM *vgmstream, sample_t * outbuf, int32_t samples_to_do, int channels) {
-    ffmpeg_codec_data *data = vgmstream->codec_data;
+/* float output (+-1.0) helpers, for hosts rendering to float (no 16-bit rounding/clamping) */
+static void samples_silence_flt(float* obuf, int ochs, int samples) {
+    memset(obuf, 0, samples * ochs * sizeof(float));
+}
+
+static void samples_u8_to_flt(float* obuf, uint8_t* ibuf, int ichs, int samples, int skip) {
+    int s, total_samples = samples * ichs;
+    ibuf += skip * ichs;
+    for (s = 0; s < total_samples; s++) {
+        obuf[s] = ((int)ibuf[s] - 0x80) * (1.0f / 128.0f);
+    }
+}
+static void samples_s16_to_flt(float* obuf, int16_t* ibuf, int ichs, int samples, int skip) {
+    int s, total_samples = samples * ichs;
+    ibuf += skip * ichs;
+    for (s = 0; s < total_samples; s++) {
+        obuf[s] = ibuf[s] * (1.0f / 32768.0f);
+    }
+}
+static void samples_s32_to_flt(float* obuf, int32_t* ibuf, int ichs, int samples, int skip) {
+    int s, total_samples = samples * ichs;
+    ibuf += skip * ichs;
+    for (s = 0; s < total_samples; s++) {
+        obuf[s] = ibuf[s] * (1.0f / 2147483648.0f);
+    }
+}
+static void samples_flt_to_flt(float* obuf, float* ibuf, int ichs, int samples, int skip, int invert) {
+    int s, total_samples = samples * ichs;
+    ibuf += skip * ichs;
+    if (!invert) {
+        memcpy(obuf, ibuf, total_samples * sizeof(float));
+        return;
+    }
+    for (s = 0; s < total_samples; s++) {
+        obuf[s] = -ibuf[s];
+    }
+}
+static void samples_dbl_to_flt(float* obuf, double* ibuf, int ichs, int samples, int skip) {
+    int s, total_samples = samples * ichs;
+    ibuf += skip * ichs;
+    for (s = 0; s < total_samples; s++) {
+        obuf[s] = (float)ibuf[s];
+    }
+}
+
+/* planar formats other than float are rare enough to share a per-sample loop */
+static void samples_planar_to_flt(float* obuf, void** ibuf, enum AVSampleFormat fmt, int ichs, int samples, int skip) {
+    int s, ch;
+    for (ch = 0; ch < ichs; ch++) {
+        for (s = 0; s < samples; s++) {
+            float val;
+            switch (fmt) {
+                case AV_SAMPLE_FMT_U8P:  val = ((int)((uint8_t*)ibuf[ch])[skip + s] - 0x80) * (1.0f / 128.0f); break;
+                case AV_SAMPLE_FMT_S16P: val = ((int16_t*)ibuf[ch])[skip + s] * (1.0f / 32768.0f); break;
+                case AV_SAMPLE_FMT_S32P: val = ((int32_t*)ibuf[ch])[skip + s] * (1.0f / 2147483648.0f); break;
+                case AV_SAMPLE_FMT_DBLP: val = (float)((double*)ibuf[ch])[skip + s]; break;
+                default: val = 0.0f; break;
+            }
+            obuf[s*ichs + ch] = val;
+        }
+    }
+}
+static void samples_fltp_to_flt(float* obuf, float** ibuf, int ichs, int samples, int skip, int invert) {
+    int s, ch;
+    float scale = invert ? -1.0f : 1.0f;
+
+    if (ichs == 2) {
+        const float* ibuf_l = ibuf[0] + skip;
+        const float* ibuf_r = ibuf[1] + skip;
+        for (s = 0; s < samples; s++) {
+            obuf[s*2 + 0] = ibuf_l[s] * scale;
+            obuf[s*2 + 1] = ibuf_r[s] * scale;
+        }
+        return;
+    }
+
+    for (ch = 0; ch < ichs; ch++) {
+        const float* iplane = ibuf[ch] + skip;
+        for (s = 0; s < samples; s++) {
+            obuf[s*ichs + ch] = iplane[s] * scale;
+        }
+    }
+}
+
+static void copy_samples_float(ffmpeg_codec_data *data, float *outbuf, int samples_to_do) {
+    int channels = data->codecCtx->channels;
+    int is_planar = av_sample_fmt_is_planar(data->codecCtx->sample_fmt) && (channels > 1);
+    int skip = data->samples_consumed;
+
+    if (is_planar) {
+        if (data->codecCtx->sample_fmt == AV_SAMPLE_FMT_FLTP)
+            samples_fltp_to_flt(outbuf, (float**)data->frame->extended_data, channels, samples_to_do, skip, data->invert_floats_set);
+        else
+            samples_planar_to_flt(outbuf, (void**)data->frame->extended_data, data->codecCtx->sample_fmt, channels, samples_to_do, skip);
+        return;
+    }
+
+    switch (data->codecCtx->sample_fmt) {
+        case AV_SAMPLE_FMT_U8P:
+        case AV_SAMPLE_FMT_U8:   samples_u8_to_flt(outbuf, data->frame->data[0], channels, samples_to_do, skip); break;
+        case AV_SAMPLE_FMT_S16P:
+        case AV_SAMPLE_FMT_S16:  samples_s16_to_flt(outbuf, (int16_t*)data->frame->data[0], channels, samples_to_do, skip); break;
+        case AV_SAMPLE_FMT_S32P:
+        case AV_SAMPLE_FMT_S32:  samples_s32_to_flt(outbuf, (int32_t*)data->frame->data[0], channels, samples_to_do, skip); break;
+        case AV_SAMPLE_FMT_FLTP:
+        case AV_SAMPLE_FMT_FLT:  samples_flt_to_flt(outbuf, (float*)data->frame->data[0], channels, samples_to_do, skip, data->invert_floats_set); break;
+        case AV_SAMPLE_FMT_DBLP:
+        case AV_SAMPLE_FMT_DBL:  samples_dbl_to_flt(outbuf, (double*)data->frame->data[0], channels, samples_to_do, skip); break;
+        default:
+            break;
+    }
+}
 
+/* Shared by the sample_t and float decoders (one of the buffers is NULL) */
+static void decode_ffmpeg_internal(ffmpeg_codec_data *data, sample_t *outbuf, float *outbuf_f, int32_t samples_to_do, int channels) {
 
     while (samples_to_do > 0) {
 
@@ -730,10 +1019,16 @@ void decode_ffmpeg(VGMSTREAM *vgmstream, sample_t * outbuf, int32_t samples_to_d
                 if (samples_to_get > samples_to_do)
                     samples_to_get = samples_to_do;
 
-                copy_samples(data, outbuf, samples_to_get);
+                if (outbuf_f) {
+                    copy_samples_float(data, outbuf_f, samples_to_get);
+                    outbuf_f += samples_to_get * channels;
+                }
+                else {
+                    copy_samples(data, outbuf, samples_to_get);
+                    outbuf += samples_to_get * channels;
+                }
 
                 samples_to_do -= samples_to_get;
-                outbuf += samples_to_get * channels;
             }
 
             /* mark consumed samples */
@@ -749,7 +1044,24 @@ void decode_ffmpeg(VGMSTREAM *vgmstream, sample_t * outbuf, int32_t samples_to_d
 
 decode_fail:
     VGM_LOG("FFMPEG: decode fail, missing %i samples\n", samples_to_do);
-    samples_silence_s16(outbuf, channels, samples_to_do);
+    if (outbuf_f)
+        samples_silence_flt(outbuf_f, channels, samples_to_do);
+    else
+        samples_silence_s16(outbuf, channels, samples_to_do);
+}
+
+/* decode samples of any kind of FFmpeg format */
+void decode_ffmpeg(VGMSTREAM *vgmstream, sample_t * outbuf, int32_t samples_to_do, int channels) {
+    decode_ffmpeg_internal(vgmstream->codec_data, outbuf, NULL, samples_to_do, channels);
+}
+
+/* same but to float, without the 16-bit step (remapped channels aren't supported, see ffmpeg_can_decode_float) */
+void decode_ffmpeg_float(VGMSTREAM *vgmstream, float * outbuf, int32_t samples_to_do, int channels) {
+    decode_ffmpeg_internal(vgmstream->codec_data, NULL, outbuf, samples_to_do, channels);
+}
+
+int ffmpeg_can_decode_float(ffmpeg_codec_data * data) {
+    return data && data->codecCtx && !data->channel_remap_set;
 }
 
 
@@ -764,11 +1076,57 @@ void reset_ffmpeg(VGMSTREAM *vgmstream) {
     reset_ffmpeg_internal(vgmstream->codec_data);
 }
 
+/* XMA packets from the index are seek points: FFmpeg's XMA decoder resyncs on the first frame that
+ * starts in a packet and skips its output (like the stream's first frame, as it lacks the previous
+ * frame's overlap), so output resumes at frame N+1, same as "N * 512" from the start.
+ * Finds the last one before target (decoder samples including skips), 0 if none. */
+#define XMA_SEEK_INDEX_STEP 4 /* packets */
+
+static int find_xma_seek_point(ffmpeg_codec_data *data, int32_t target, int64_t *p_offset, int32_t *p_sample) {
+    const int samples_per_frame = 512;
+    int lo, hi;
+
+    if (!data->xma_index_set || !data->skip_samples_set || data->xma_index_count < 0)
+        return 0;
+
+    /* walks the whole data, so only once a seek needs it */
+    if (data->xma_index_count == 0) {
+        data->xma_index_count = xma_get_seek_index(data->streamfile, data->xma_data_offset, data->xma_data_size,
+                XMA_SEEK_INDEX_STEP, &data->xma_index_offsets, &data->xma_index_frames);
+        if (data->xma_index_count == 0) {
+            VGM_LOG("FFMPEG: couldn't build XMA seek index\n");
+            data->xma_index_count = -1;
+            return 0;
+        }
+    }
+
+    /* last entry at or before target */
+    lo = 0;
+    hi = data->xma_index_count - 1;
+    while (lo < hi) {
+        int mid = (lo + hi + 1) / 2;
+        if (data->xma_index_frames[mid] * samples_per_frame <= target)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+    if (data->xma_index_frames[lo] == 0)
+        return 0; /* start, same as a normal seek */
+
+    *p_offset = data->header_size + (data->xma_data_offset - data->start) + data->xma_index_offsets[lo];
+    *p_sample = data->xma_index_frames[lo] * samples_per_frame;
+    return 1;
+}
+
 void seek_ffmpeg_internal(ffmpeg_codec_data *data, int32_t num_sample) {
+    int64_t index_offset = 0;
+    int32_t index_sample = 0;
+
     if (!data) return;
 
     /* Start from 0 and discard samples until sample (slower but not too noticeable).
-     * Due to many FFmpeg quirks seeking to a sample is erratic at best in most formats. */
+     * Due to many FFmpeg quirks seeking to a sample is erratic at best in most formats.
+     * XMA may start from a packet in its index instead. */
 
     if (data->force_seek) {
         int errcode;
@@ -784,6 +1142,17 @@ void seek_ffmpeg_internal(ffmpeg_codec_data *data, int32_t num_sample) {
         errcode = init_ffmpeg_config(data, 0, 1);
         if (errcode < 0) goto fail;
     }
+    else if (data->raw_count) {
+        index_sample = seek_raw_packet(data, num_sample + data->skipSamples);
+        avcodec_flush_buffers(data->codecCtx);
+    }
+    else if (num_sample > 0 && find_xma_seek_point(data, num_sample + data->skipSamples, &index_offset, &index_sample)) {
+        if (av_seek_frame(data->formatCtx, data->streamIndex, index_offset, AVSEEK_FLAG_BYTE) < 0) {
+            index_sample = 0;
+            avformat_seek_file(data->formatCtx, data->streamIndex, 0, 0, 0, AVSEEK_FLAG_ANY);
+        }
+        avcodec_flush_buffers(data->codecCtx);
+    }
     else {
         avformat_seek_file(data->formatCtx, data->streamIndex, 0, 0, 0, AVSEEK_FLAG_ANY);
         avcodec_flush_buffers(data->codecCtx);
@@ -799,14 +1168,19 @@ void seek_ffmpeg_internal(ffmpeg_codec_data *data, int32_t num_sample) {
 
     /* consider skip samples (encoder delay), if manually set (otherwise let FFmpeg handle it) */
     if (data->skip_samples_set) {
-        AVStream *stream = data->formatCtx->streams[data->streamIndex];
-        /* sometimes (ex. AAC) after seeking to the first packet skip_samples is restored, but we want our value */
-        stream->skip_samples = 0;
-        stream->start_skip_samples = 0;
+        if (data->formatCtx) {
+            AVStream *stream = data->formatCtx->streams[data->streamIndex];
+            /* sometimes (ex. AAC) after seeking to the first packet skip_samples is restored, but we want our value */
+            stream->skip_samples = 0;
+            stream->start_skip_samples = 0;
+        }
 
         data->samples_discard += data->skipSamples;
     }
 
+    /* decoding starts at the index packet's sample */
+    data->samples_discard -= index_sample;
+
     return;
 fail:
     VGM_LOG("FFMPEG: error during force_seek\n");
@@ -869,6 +1243,12 @@ void free_ffmpeg(ffmpeg_codec_data *data) {
         data->header_block = NULL;
     }
 
+    free(data->xma_index_offsets);
+    free(data->xma_index_frames);
+    free(data->raw_offsets);
+    free(data->raw_sizes);
+    free(data->raw_samples);
+    free(data->raw_buf);
     close_streamfile(data->streamfile);
     free(data);
 }
@@ -884,14 +1264,15 @@ void free_ffmpeg(ffmpeg_codec_data *data) {
  *  (FFmpeg's stream->(start_)skip_samples causes glitches in XMA).
  */
 void ffmpeg_set_skip_samples(ffmpeg_codec_data * data, int skip_samples) {
-    AVStream *stream = NULL;
-    if (!data || !data->formatCtx)
+    if (!data || (!data->formatCtx && !data->raw_count))
         return;
 
     /* overwrite FFmpeg's skip samples */
-    stream = data->formatCtx->streams[data->streamIndex];
-    stream->start_skip_samples = 0; /* used for the first packet *if* pts=0 */
-    stream->skip_samples = 0; /* skip_samples can be used for any packet */
+    if (data->formatCtx) {
+        AVStream *stream = data->formatCtx->streams[data->streamIndex];
+        stream->start_skip_samples = 0; /* used for the first packet *if* pts=0 */
+        stream->skip_samples = 0; /* skip_samples can be used for any packet */
+    }
 
     /* set skip samples with our internal discard */
     data->skip_samples_set = 1;
@@ -901,6 +1282,27 @@ void ffmpeg_set_skip_samples(ffmpeg_codec_data * data, int skip_samples) {
     data->skipSamples = skip_samples;
 }
 
+/* data must be single stream XMA in the file FFmpeg reads, with the packets at data_offset
+ * (index is built on first seek). Ignored if sf doesn't look like that file. */
+void ffmpeg_set_xma_seek_index(ffmpeg_codec_data * data, STREAMFILE *sf, off_t data_offset, size_t data_size) {
+    char name[PATH_LIMIT], data_name[PATH_LIMIT];
+
+    if (!data || !data->formatCtx)
+        return;
+    if (data_offset < data->start || data_offset + data_size > data->start + data->size)
+        return;
+
+    /* some metas fix samples from the original file but decode a deblocked one */
+    get_streamfile_name(sf, name, sizeof(name));
+    get_streamfile_name(data->streamfile, data_name, sizeof(data_name));
+    if (strcmp(name, data_name) != 0 || get_streamfile_size(sf) != get_streamfile_size(data->streamfile))
+        return;
+
+    data->xma_index_set = 1;
+    data->xma_data_offset = data_offset;
+    data->xma_data_size = data_size;
+}
+
 /* returns channel layout if set */
 uint32_t ffmpeg_get_channel_layout(ffmpeg_codec_data * data) {
     if (!data || !data->codecCtx) return 0;
@@ -945,7 +1347,7 @@ const char* ffmpeg_get_metadata_value(ffmpeg_codec_data* data, const char* key)
     AVDictionary* avd;
     AVDictionaryEntry* avde;
 
-    if (!data || !data->codec)
+    if (!data || !data->codec || !data->formatCtx)
         return NULL;
 
     avd = data->formatCtx->streams[data->streamIndex]->metadata;
@@ -5,11 +5,12 @@
 #ifdef VGM_USE_FFMPEG
 
 /**
- * Transmogrifies custom Opus (no Ogg layer and custom packet headers) into is Xiph Opus, creating
- * valid Ogg pages with single Opus packets.
- * Uses an intermediate buffer to make full Ogg pages, since checksums are calculated with the whole page.
+ * Decodes custom Opus (no Ogg layer and custom packet headers) by indexing its packets and feeding them
+ * as-is to FFmpeg's Opus decoder, with an OpusHead made from the config as extradata.
  *
- * Mostly as an experiment/demonstration, until some details are sorted out before adding actual libopus.
+ * If that can't be set up, transmogrifies it into Xiph Opus instead, creating valid Ogg pages with single
+ * Opus packets. Uses an intermediate buffer to make full Ogg pages, since checksums are calculated with
+ * the whole page.
  *
  * Info, CRC and stuff:
  *   https://www.opus-codec.org/docs/
@@ -25,6 +26,7 @@ static size_t opus_get_packet_samples(const uint8_t *buf, int len);
 static size_t opus_get_packet_samples_sf(STREAMFILE *sf, off_t offset);
 static size_t get_xopus_packet_size(int packet, STREAMFILE *streamfile);
 static opus_type_t get_ue4opus_version(STREAMFILE *sf, off_t offset);
+static size_t make_opus_header(uint8_t * buf, int buf_size, opus_config *cfg);
 
 typedef struct {
     /* config */
@@ -271,7 +273,7 @@ static STREAMFILE* setup_opus_streamfile(STREAMFILE *streamFile, opus_config *cf
     if (!new_streamFile) goto fail;
     temp_streamFile = new_streamFile;
 
-    new_streamFile = open_buffer_streamfile(new_streamFile,0);
+    new_streamFile = open_buffer_streamfile_adaptive(new_streamFile);
     if (!new_streamFile) goto fail;
     temp_streamFile = new_streamFile;
 
@@ -636,10 +638,132 @@ size_t ea_opus_get_encoder_delay(off_t offset, STREAMFILE *streamFile) {
 /* actual FFmpeg only-code starts here (the above is universal enough but no point to compile) */
 //#ifdef VGM_USE_FFMPEG
 
+/* Makes an index of custom Opus packets (data offsets/sizes, plus samples before each one and the total),
+ * so they can be fed to the decoder as-is. Returns packets found or 0 on error. */
+static int get_opus_packet_index(STREAMFILE *sf, off_t offset, size_t stream_size, opus_type_t type,
+        uint32_t **p_offsets, uint32_t **p_sizes, int32_t **p_samples) {
+    uint32_t *offsets = NULL, *sizes = NULL;
+    int32_t *samples = NULL;
+    int count = 0, max = 0;
+    int32_t num_samples = 0;
+    off_t end_offset = offset + stream_size;
+
+    if (end_offset > get_streamfile_size(sf)) {
+        VGM_LOG("OPUS: wrong streamsize %x + %x vs %x\n", (uint32_t)offset, (uint32_t)stream_size, get_streamfile_size(sf));
+        goto fail;
+    }
+
+    while (offset < end_offset) {
+        size_t data_size, skip_size, packet_samples = 0;
+
+        switch(type) {
+            case OPUS_SWITCH:
+                data_size = read_u32be(offset, sf);
+                skip_size = 0x08;
+                break;
+            case OPUS_UE4_v1:
+                data_size = read_u16le(offset, sf);
+                skip_size = 0x02;
+                break;
+            case OPUS_UE4_v2:
+                data_size       = read_u16le(offset + 0x00, sf);
+                packet_samples  = read_u16le(offset + 0x02, sf);
+                skip_size = 0x02 + 0x02;
+                break;
+            case OPUS_EA:
+                data_size = read_u16be(offset, sf);
+                skip_size = 0x02;
+                break;
+            case OPUS_X:
+                data_size = get_xopus_packet_size(count, sf);
+                skip_size = 0x00;
+                break;
+            default:
+                goto fail;
+        }
+
+        if (data_size == 0 || offset + skip_size + data_size > get_streamfile_size(sf)) {
+            VGM_LOG("OPUS: wrong packet size %x at %x\n", (uint32_t)data_size, (uint32_t)offset);
+            goto fail;
+        }
+
+        if (count + 1 >= max) { /* +1 for the total */
+            uint32_t *new_offsets, *new_sizes;
+            int32_t *new_samples;
+
+            max = max ? max * 2 : 0x400;
+            new_offsets = realloc(offsets, max * sizeof(uint32_t));
+            if (new_offsets) offsets = new_offsets;
+            new_sizes = realloc(sizes, max * sizeof(uint32_t));
+            if (new_sizes) sizes = new_sizes;
+            new_samples = realloc(samples, max * sizeof(int32_t));
+            if (new_samples) samples = new_samples;
+            if (!new_offsets || !new_sizes || !new_samples) goto fail;
+        }
+
+        if (packet_samples == 0)
+            packet_samples = opus_get_packet_samples_sf(sf, offset + skip_size);
+
+        offsets[count] = offset + skip_size;
+        sizes[count] = data_size;
+        samples[count] = num_samples;
+        count++;
+
+        num_samples += packet_samples;
+        offset += skip_size + data_size;
+    }
+
+    if (count == 0)
+        goto fail;
+    samples[count] = num_samples;
+
+    *p_offsets = offsets;
+    *p_sizes = sizes;
+    *p_samples = samples;
+    return count;
+fail:
+    free(offsets);
+    free(sizes);
+    free(samples);
+    return 0;
+}
+
+/* Feeds custom Opus packets straight to FFmpeg's Opus decoder, without Ogg pages in between */
+static ffmpeg_codec_data * init_ffmpeg_custom_opus_raw(STREAMFILE *sf, off_t start_offset, size_t data_size, opus_config *cfg, opus_type_t type) {
+    ffmpeg_codec_data * ffmpeg_data = NULL;
+    opus_config head_cfg = *cfg;
+    uint8_t head[0x100];
+    size_t head_size;
+    uint32_t *offsets = NULL, *sizes = NULL;
+    int32_t *samples = NULL;
+    int count;
+
+    /* skip is done by vgmstream, as decoders differ in how they handle OpusHead's pre-skip */
+    head_cfg.skip = 0;
+    head_size = make_opus_header(head, sizeof(head), &head_cfg);
+    if (!head_size) return NULL;
+
+    count = get_opus_packet_index(sf, start_offset, data_size, type, &offsets, &sizes, &samples);
+    if (!count) return NULL;
+
+    /* Opus decodes at 48000 whatever the original rate, and needs 80ms to converge after a seek (RFC 7845 4.6) */
+    ffmpeg_data = init_ffmpeg_raw_packets(sf, AV_CODEC_ID_OPUS, head, head_size, cfg->channels, 48000, 3840,
+            count, offsets, sizes, samples);
+    if (!ffmpeg_data) return NULL;
+
+    ffmpeg_set_skip_samples(ffmpeg_data, cfg->skip);
+    return ffmpeg_data;
+}
+
 static ffmpeg_codec_data * init_ffmpeg_custom_opus_config(STREAMFILE *streamFile, off_t start_offset, size_t data_size, opus_config *cfg, opus_type_t type) {
     ffmpeg_codec_data * ffmpeg_data = NULL;
     STREAMFILE *temp_streamFile = NULL;
 
+    ffmpeg_data = init_ffmpeg_custom_opus_raw(streamFile, start_offset, data_size, cfg, type);
+    if (ffmpeg_data)
+        return ffmpeg_data;
+    VGM_LOG("OPUS: can't feed packets directly, converting to Ogg\n");
+
     temp_streamFile = setup_opus_streamfile(streamFile, cfg, start_offset, data_size, type);
     if (!temp_streamFile) goto fail;
 
@@ -0,0 +1,106 @@
+#ifndef _FRAME_WALK_H
+#define _FRAME_WALK_H
+
+#include "../streamfile.h"
+
+/* Frame loop shared by small decoders with fixed size frames. Walks the frames holding
+ * [first_sample, first_sample + samples_to_do) from a start offset, so one call may decode any
+ * number of consecutive frames (see is_multiframe_decoder). Each frame is fetched once, pointing
+ * into the streamfile's memory when possible or read into a buffer (zero padded past EOF, or with
+ * a given byte through FRAME_WALK_PADDED).
+ *
+ *   frame_walk_t fw;
+ *   FRAME_WALK(&fw, stream->streamfile, stream->offset, frame_size, frame_samples, first_sample, samples_to_do) {
+ *       ...parse header at fw.frame...
+ *       for (i = fw.first; i < fw.first + fw.count; i++) {
+ *           ...decode sample i of the frame, write outbuf[sample_count]...
+ *       }
+ *   }
+ *
+ * Frames that must be decoded whole to get any of their samples (header samples, state reset
+ * each frame) are decoded into fw.pcm then served partially with frame_walk_output.
+ *
+ * Codecs without frames (a byte or nibble per sample) walk fixed chunks of bytes the same way,
+ * so they read once per chunk rather than once per sample. */
+
+#define FRAME_WALK_MAX_BYTES    0x200
+#define FRAME_WALK_MAX_SAMPLES  0x400
+
+typedef struct {
+    const uint8_t* frame;   /* current frame */
+    off_t offset;           /* current frame's offset */
+    int first;              /* first sample to output from the current frame */
+    int count;              /* samples to output from the current frame */
+    int32_t done;           /* samples output by previous frames */
+
+    STREAMFILE* sf;
+    size_t frame_size;
+    int frame_samples;
+    int32_t samples_left;
+    uint8_t pad;
+    uint8_t buf[FRAME_WALK_MAX_BYTES];
+    int16_t pcm[FRAME_WALK_MAX_SAMPLES]; /* whole frame decodes */
+} frame_walk_t;
+
+static inline void frame_walk_init(frame_walk_t* fw, STREAMFILE* sf, off_t start_offset, size_t frame_size, int frame_samples, int32_t first_sample, int32_t samples_to_do, uint8_t pad) {
+    if (frame_size > FRAME_WALK_MAX_BYTES)
+        frame_size = FRAME_WALK_MAX_BYTES; /* not seen, decoders check */
+
+    fw->sf = sf;
+    fw->frame_size = frame_size;
+    fw->frame_samples = frame_samples;
+    fw->offset = start_offset + (first_sample / frame_samples) * frame_size - frame_size;
+    fw->first = first_sample % frame_samples;
+    fw->count = 0;
+    fw->done = 0;
+    fw->samples_left = samples_to_do;
+    fw->pad = pad;
+}
+
+/* Moves to the next frame, returns 0 when all samples are done. */
+static inline int frame_walk_next(frame_walk_t* fw) {
+    STREAMFILE* sf = fw->sf;
+    const uint8_t* ptr = NULL;
+
+    fw->done += fw->count;
+    fw->samples_left -= fw->count;
+    if (fw->samples_left <= 0)
+        return 0;
+
+    if (fw->count > 0)
+        fw->first = 0;
+    fw->count = fw->frame_samples - fw->first;
+    if (fw->count > fw->samples_left)
+        fw->count = fw->samples_left;
+    fw->offset += fw->frame_size;
+
+    if (sf->read_ptr)
+        ptr = sf->read_ptr(sf, fw->offset, fw->frame_size);
+    if (!ptr) {
+        memset(fw->buf, fw->pad, fw->frame_size);
+        read_streamfile(fw->buf, fw->offset, fw->frame_size, sf); /* ignore EOF errors */
+        ptr = fw->buf;
+    }
+    fw->frame = ptr;
+    return 1;
+}
+
+/* Writes the wanted part of a frame decoded whole into fw.pcm. */
+static inline void frame_walk_output(const frame_walk_t* fw, sample_t* outbuf, int channelspacing) {
+    const int16_t* src = fw->pcm + fw->first;
+    sample_t* dst = outbuf + fw->done * channelspacing;
+    int i;
+
+    for (i = 0; i < fw->count; i++) {
+        dst[i * channelspacing] = src[i];
+    }
+}
+
+#define FRAME_WALK(fw, sf, start_offset, frame_size, frame_samples, first_sample, samples_to_do) \
+    for (frame_walk_init(fw, sf, start_offset, frame_size, frame_samples, first_sample, samples_to_do, 0x00); frame_walk_next(fw); )
+
+/* Same, but bytes past EOF read as pad (0xFF for codecs that used read_8bit, which returns -1 there) */
+#define FRAME_WALK_PADDED(fw, sf, start_offset, frame_size, frame_samples, first_sample, samples_to_do, pad) \
+    for (frame_walk_init(fw, sf, start_offset, frame_size, frame_samples, first_sample, samples_to_do, pad); frame_walk_next(fw); )
+
+#endif
@@ -126,7 +126,7 @@ int test_key_g7221(g7221_codec_data* data, off_t start, STREAMFILE* sf) {
             break;
         }
 
-        ok = g7221_decode_frame(data->ch[cur_ch].handle, buf, data->ch[cur_ch].buffer);
+        ok = g7221_test_frame(data->ch[cur_ch].handle, buf);
         if (!ok) {
             total_score = -1;
             break;
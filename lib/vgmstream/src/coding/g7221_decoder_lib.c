@@ -4,6 +4,7 @@
 
 #include "g7221_decoder_lib.h"
 #include "g7221_decoder_aes.h"
+#include "../cpu.h"
 
 
 /* Decodes Siren14 from Namco's BNSF, a mono MLT/DCT-based codec for speech/sound (low bandwidth).
@@ -54,48 +55,14 @@
 
 static int imlt_window(int16_t* new_samples, int16_t* old_samples, int16_t* out_samples) {
     int i;
-    int sample_lo, sample_hi;
-    int16_t win_val_lo, win_val_hi, new_val, old_val;
-    const int16_t *win_ptr_lo, *win_ptr_hi;
-    int16_t *new_ptr, *old_ptr, *out_ptr_lo, *out_ptr_hi;
-
 
     /* overlap 2nd half of prev frame's samples and 1st half of current frame's samples with
-     * a window function to smooth out between frames */
-    win_ptr_lo = imlt_samples_window + 0;
-    win_ptr_hi = imlt_samples_window + 640;
-    new_ptr = new_samples + 320;
-    old_ptr = old_samples + 0;
-    out_ptr_lo = out_samples + 0;
-    out_ptr_hi = out_samples + 640;
-
-    while (out_ptr_lo != out_ptr_hi) {
-        win_val_lo = *win_ptr_lo++;
-        win_val_hi = *--win_ptr_hi;
-        new_val = *--new_ptr;
-        old_val = *old_ptr++;
-
-        sample_lo = (new_val * win_val_lo + old_val * *win_ptr_hi + 32768) >> 13;
-        if (sample_lo > 32767)
-            sample_lo = 32767;
-        else if (sample_lo < -32768)
-            sample_lo = -32768;
-        *out_ptr_lo++ = sample_lo;
-
-        sample_hi = (new_val * win_val_hi - old_val * win_val_lo + 32768) >> 13;
-        if (sample_hi > 32767)
-            sample_hi = 32767;
-        else if (sample_hi < -32768)
-            sample_hi = -32768;
-        *--out_ptr_hi = sample_hi;
-    }
+     * a window function to smooth out between frames (see kernel in cpu.c) */
+    vgm_get_kernels()->imlt_window(out_samples, new_samples, old_samples, imlt_samples_window, 640);
 
     /* save the 2nd half of the new samples to use above in next frame */
-    old_ptr = old_samples + 0;
-    new_ptr = new_samples + 320;
-
     for (i = 0; i < 320; i++) {
-        old_ptr[i] = new_ptr[i];
+        old_samples[i] = new_samples[320 + i];
     }
 
     return 0;
@@ -1192,6 +1159,22 @@ fail:
     return 0;
 }
 
+int g7221_test_frame(g7221_handle* handle, uint8_t* data) {
+    int res;
+    int mag_shift;
+    int encrypted = handle->aes != NULL;
+
+    if (encrypted) {
+        s14aes_decrypt(handle->aes, data);
+    }
+
+    /* wrong keys result in unpacking errors, so the MLT transform isn't needed */
+    res = unpack_frame(handle->bit_rate, data, handle->frame_size, &mag_shift, handle->mlt_coefs, &handle->random_value, encrypted);
+    if (res < 0)
+        return 0;
+    return 1;
+}
+
 #if 0
 int g7221_decode_empty(g7221_handle* handle, int16_t* out_samples) {
     static const uint8_t empty_frame[0x3c] = {
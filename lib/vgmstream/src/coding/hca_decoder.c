@@ -149,9 +149,23 @@ void loop_hca(hca_codec_data * data, int32_t num_sample) {
     data->samples_to_discard = data->info.loopStartDelay;
 }
 
+/* Jumps to the block with num_sample. Its first decoded samples are off, since the previous
+ * block's overlap isn't there, so callers decode a bit before using output (approximate seeks). */
+void seek_hca(hca_codec_data * data, int32_t num_sample) {
+    unsigned int target_sample;
+    if (!data) return;
+
+    target_sample = num_sample + data->info.encoderDelay;
+    data->current_block = target_sample / data->info.samplesPerBlock;
+    data->samples_filled = 0;
+    data->samples_consumed = 0;
+    data->samples_to_discard = target_sample - data->current_block * data->info.samplesPerBlock;
+}
+
 void free_hca(hca_codec_data * data) {
     if (!data) return;
 
+    test_hca_key_done(data);
     close_streamfile(data->streamfile);
     clHCA_done(data->handle);
     free(data->handle);
@@ -160,6 +174,52 @@ void free_hca(hca_codec_data * data) {
     free(data);
 }
 
+/* decoder handle (no pointers outside itself) and current block's samples, plus positions */
+typedef struct {
+    clHCA_stInfo info;
+    unsigned int current_block;
+    size_t samples_filled;
+    size_t samples_consumed;
+    size_t samples_to_discard;
+} hca_state_t;
+
+void* save_hca(hca_codec_data * data, size_t * size) {
+    size_t handle_size, buffer_size;
+    hca_state_t *state;
+    if (!data || data->key_tests) return NULL;
+
+    handle_size = clHCA_sizeof();
+    buffer_size = sizeof(signed short) * data->info.channelCount * data->info.samplesPerBlock;
+    state = malloc(sizeof(hca_state_t) + handle_size + buffer_size);
+    if (!state) return NULL;
+
+    state->info = data->info;
+    state->current_block = data->current_block;
+    state->samples_filled = data->samples_filled;
+    state->samples_consumed = data->samples_consumed;
+    state->samples_to_discard = data->samples_to_discard;
+    memcpy((uint8_t*)(state + 1), data->handle, handle_size);
+    memcpy((uint8_t*)(state + 1) + handle_size, data->sample_buffer, buffer_size);
+    *size = sizeof(hca_state_t) + handle_size + buffer_size;
+    return state;
+}
+
+void restore_hca(hca_codec_data * data, const void * state) {
+    const hca_state_t *saved = state;
+    size_t handle_size, buffer_size;
+    if (!data || !state) return;
+
+    handle_size = clHCA_sizeof();
+    buffer_size = sizeof(signed short) * data->info.channelCount * data->info.samplesPerBlock;
+    data->info = saved->info;
+    data->current_block = saved->current_block;
+    data->samples_filled = saved->samples_filled;
+    data->samples_consumed = saved->samples_consumed;
+    data->samples_to_discard = saved->samples_to_discard;
+    memcpy(data->handle, (const uint8_t*)(saved + 1), handle_size);
+    memcpy(data->sample_buffer, (const uint8_t*)(saved + 1) + handle_size, buffer_size);
+}
+
 
 /* arbitrary scale to simplify score comparisons */
 #define HCA_KEY_SCORE_SCALE      10
@@ -173,6 +233,62 @@ void free_hca(hca_codec_data * data) {
 #define HCA_KEY_MAX_FRAME_SCORE  150
 #define HCA_KEY_MAX_TOTAL_SCORE  (HCA_KEY_MAX_TEST_FRAMES * 50*HCA_KEY_SCORE_SCALE)
 
+/* frames tested by every key (blank ones are only flagged), kept to avoid reading/checking them again */
+#define HCA_KEY_TESTS_FRAMES     (HCA_KEY_MAX_SKIP_BLANKS + HCA_KEY_MAX_TEST_FRAMES)
+#define HCA_KEY_TESTS_DATA       32
+
+#define HCA_KEY_FRAME_UNKNOWN    -1
+#define HCA_KEY_FRAME_EMPTY      -2
+
+typedef struct {
+    int16_t index[HCA_KEY_TESTS_FRAMES]; /* position in data, or unknown/empty */
+    int data_count;
+    uint8_t* data;
+} hca_key_tests;
+
+/* Loads a frame in data_buffer (decrypting modifies it, so it's copied on every test).
+ * Returns 0 if frame is empty (all 0 but sync/crc, same for any key), 1 if loaded, -1 on error. */
+static int load_test_frame(hca_codec_data * data, unsigned int frame) {
+    hca_key_tests* tests = data->key_tests;
+    const unsigned int blockSize = data->info.blockSize;
+    const uint8_t* buf = data->data_buffer;
+    off_t offset = data->info.headerSize + frame * blockSize;
+    int i, is_empty = 1;
+
+    if (tests && frame < HCA_KEY_TESTS_FRAMES) {
+        int index = tests->index[frame];
+        if (index == HCA_KEY_FRAME_EMPTY)
+            return 0;
+        if (index >= 0) {
+            memcpy(data->data_buffer, tests->data + index * blockSize, blockSize);
+            return 1;
+        }
+    }
+
+    if (read_streamfile(data->data_buffer, offset, blockSize, data->streamfile) != blockSize)
+        return -1;
+
+    for (i = 2; i < blockSize - 0x02; i++) {
+        if (buf[i] != 0) {
+            is_empty = 0;
+            break;
+        }
+    }
+
+    if (tests && frame < HCA_KEY_TESTS_FRAMES) {
+        if (is_empty) {
+            tests->index[frame] = HCA_KEY_FRAME_EMPTY;
+        }
+        else if (tests->data_count < HCA_KEY_TESTS_DATA) {
+            memcpy(tests->data + tests->data_count * blockSize, data->data_buffer, blockSize);
+            tests->index[frame] = tests->data_count;
+            tests->data_count++;
+        }
+    }
+
+    return is_empty ? 0 : 1;
+}
+
 /* Test a number of frames if key decrypts correctly.
  * Returns score: <0: error/wrong, 0: unknown/silent file, >0: good (the closest to 1 the better). */
 int test_hca_key(hca_codec_data * data, unsigned long long keycode) {
@@ -181,8 +297,25 @@ int test_hca_key(hca_codec_data * data, unsigned long long keycode) {
     const unsigned int blockSize = data->info.blockSize;
 
     /* Due to the potentially large number of keys this must be tuned for speed.
-     * Buffered IO seems fast enough (not very different reading a large block once vs frame by frame).
+     * Frames are read once and kept for next keys (files may start with lots of blank frames).
      * clHCA_TestBlock could be optimized a bit more. */
+    if (!data->key_tests) {
+        hca_key_tests* tests = calloc(1, sizeof(hca_key_tests));
+        if (tests) {
+            tests->data = malloc(HCA_KEY_TESTS_DATA * blockSize);
+            if (!tests->data) {
+                free(tests);
+                tests = NULL;
+            }
+            else {
+                int i;
+                for (i = 0; i < HCA_KEY_TESTS_FRAMES; i++) {
+                    tests->index[i] = HCA_KEY_FRAME_UNKNOWN;
+                }
+            }
+        }
+        data->key_tests = tests; /* tests work without it, just slower */
+    }
 
     clHCA_SetKey(data->handle, keycode);
 
@@ -190,18 +323,17 @@ int test_hca_key(hca_codec_data * data, unsigned long long keycode) {
     /* A final score of 0 (=silent) is only possible for short files with all blank frames */
 
     while (test_frames < HCA_KEY_MAX_TEST_FRAMES && current_frame < data->info.blockCount) {
-        off_t offset = data->info.headerSize + current_frame * blockSize;
         int score;
-        size_t bytes;
+        int loaded;
 
         /* read and test frame */
-        bytes = read_streamfile(data->data_buffer, offset, blockSize, data->streamfile);
-        if (bytes != blockSize) {
+        loaded = load_test_frame(data, current_frame);
+        if (loaded < 0) {
             total_score = -1;
             break;
         }
 
-        score = clHCA_TestBlock(data->handle, (void*)(data->data_buffer), blockSize);
+        score = loaded ? clHCA_TestBlock(data->handle, (void*)(data->data_buffer), blockSize) : 0;
         if (score < 0 || score > HCA_KEY_MAX_FRAME_SCORE) {
             total_score = -1;
             break;
@@ -242,3 +374,14 @@ int test_hca_key(hca_codec_data * data, unsigned long long keycode) {
     clHCA_DecodeReset(data->handle);
     return total_score;
 }
+
+/* Frees frames kept for key tests, once the key is found */
+void test_hca_key_done(hca_codec_data * data) {
+    hca_key_tests* tests;
+    if (!data || !data->key_tests) return;
+
+    tests = data->key_tests;
+    free(tests->data);
+    free(tests);
+    data->key_tests = NULL;
+}
@@ -34,8 +34,9 @@ static const int IMA_IndexTable[16] = {
 };
 
 
-/* Original IMA expansion, using shift+ADDs to avoid MULs (slow back then) */
-static void std_ima_expand_nibble(VGMSTREAMCHANNEL * stream, off_t byte_offset, int nibble_shift, int32_t * hist1, int32_t * step_index) {
+/* Original IMA expansion, using shift+ADDs to avoid MULs (slow back then).
+ * Reads from a block already in memory, for decoders that handle full blocks. */
+static void std_ima_expand_nibble_mem(const uint8_t * block, off_t byte_offset, int nibble_shift, int32_t * hist1, int32_t * step_index) {
     int sample_nibble, sample_decoded, step, delta;
 
     /* simplified through math from:
@@ -44,7 +45,7 @@ static void std_ima_expand_nibble(VGMSTREAMCHANNEL * stream, off_t byte_offset,
      *    > diff = (step * nibble / 4) + (step / 8)
      * final diff = [signed] (step / 8) + (step / 4) + (step / 2) + (step) [when code = 4+2+1] */
 
-    sample_nibble = (read_8bit(byte_offset,stream->streamfile) >> nibble_shift)&0xf; /* ADPCM code */
+    sample_nibble = (block[byte_offset] >> nibble_shift)&0xf; /* ADPCM code */
     sample_decoded = *hist1; /* predictor value */
     step = ADPCMTable[*step_index]; /* current step */
 
@@ -61,11 +62,16 @@ static void std_ima_expand_nibble(VGMSTREAMCHANNEL * stream, off_t byte_offset,
     if (*step_index > 88) *step_index=88;
 }
 
+static void std_ima_expand_nibble(VGMSTREAMCHANNEL * stream, off_t byte_offset, int nibble_shift, int32_t * hist1, int32_t * step_index) {
+    uint8_t byte = read_u8(byte_offset,stream->streamfile);
+    std_ima_expand_nibble_mem(&byte, 0, nibble_shift, hist1, step_index);
+}
+
 /* Apple's IMA variation. Exactly the same except it uses 16b history (probably more sensitive to overflow/sign extend?) */
-static void std_ima_expand_nibble_16(VGMSTREAMCHANNEL * stream, off_t byte_offset, int nibble_shift, int16_t * hist1, int32_t * step_index) {
+static void std_ima_expand_nibble_16(const uint8_t * block, off_t byte_offset, int nibble_shift, int16_t * hist1, int32_t * step_index) {
     int sample_nibble, sample_decoded, step, delta;
 
-    sample_nibble = (read_8bit(byte_offset,stream->streamfile) >> nibble_shift)&0xf;
+    sample_nibble = (block[byte_offset] >> nibble_shift)&0xf;
     sample_decoded = *hist1;
     step = ADPCMTable[*step_index];
 
@@ -130,10 +136,10 @@ static void n3ds_ima_expand_nibble(VGMSTREAMCHANNEL * stream, off_t byte_offset,
 }
 
 /* The Incredibles PC, updates step_index before doing current sample */
-static void snds_ima_expand_nibble(VGMSTREAMCHANNEL * stream, off_t byte_offset, int nibble_shift, int32_t * hist1, int32_t * step_index) {
+static void snds_ima_expand_nibble(const uint8_t * block, off_t byte_offset, int nibble_shift, int32_t * hist1, int32_t * step_index) {
     int sample_nibble, sample_decoded, step, delta;
 
-    sample_nibble = (read_8bit(byte_offset,stream->streamfile) >> nibble_shift)&0xf;
+    sample_nibble = (block[byte_offset] >> nibble_shift)&0xf;
     sample_decoded = *hist1;
 
     *step_index += IMA_IndexTable[sample_nibble];
@@ -346,7 +352,7 @@ static void cd_ima_expand_nibble(VGMSTREAMCHANNEL* stream, off_t byte_offset, in
 /* Standard DVI/IMA ADPCM (as in, ADPCM recommended by the IMA using Intel/DVI's implementation).
  * Configurable: stereo or mono/interleave nibbles, and high or low nibble first.
  * For vgmstream, low nibble is called "IMA ADPCM" and high nibble is "DVI IMA ADPCM" (same thing though). */
-void decode_standard_ima(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do, int channel, int is_stereo, int is_high_first) {
+DECODE_INLINE void decode_standard_ima_spaced(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do, int channel, int is_stereo, int is_high_first) {
     int i, sample_count = 0;
     int32_t hist1 = stream->adpcm_history1_32;
     int step_index = stream->adpcm_step_index;
@@ -374,6 +380,14 @@ void decode_standard_ima(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int chann
     stream->adpcm_step_index = step_index;
 }
 
+void decode_standard_ima(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do, int channel, int is_stereo, int is_high_first) {
+    switch (channelspacing) {
+        case 1:  decode_standard_ima_spaced(stream, outbuf, 1, first_sample, samples_to_do, channel, is_stereo, is_high_first); break;
+        case 2:  decode_standard_ima_spaced(stream, outbuf, 2, first_sample, samples_to_do, channel, is_stereo, is_high_first); break;
+        default: decode_standard_ima_spaced(stream, outbuf, channelspacing, first_sample, samples_to_do, channel, is_stereo, is_high_first); break;
+    }
+}
+
 void decode_mtf_ima(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do, int channel, int is_stereo) {
     int i, sample_count = 0;
     int32_t hist1 = stream->adpcm_history1_32;
@@ -424,6 +438,9 @@ void decode_3ds_ima(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspa
 }
 
 void decode_snds_ima(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do, int channel) {
+    uint8_t chunk_buf[0x400];
+    const uint8_t* chunk = NULL;
+    off_t chunk_offset = 0;
     int i, sample_count;
     int32_t hist1 = stream->adpcm_history1_32;
     int step_index = stream->adpcm_step_index;
@@ -436,7 +453,14 @@ void decode_snds_ima(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelsp
         off_t byte_offset = stream->offset + i;//one nibble per channel
         int nibble_shift = (channel==0?0:4); //high nibble first, based on channel
 
-        snds_ima_expand_nibble(stream, byte_offset,nibble_shift, &hist1, &step_index);
+        /* read bytes in chunks, as there is no block to load */
+        if (!chunk || byte_offset >= chunk_offset + sizeof(chunk_buf)) {
+            chunk_offset = byte_offset;
+            memset(chunk_buf, 0xFF, sizeof(chunk_buf)); /* same as read_8bit past EOF */
+            chunk = read_streamfile_ptr(chunk_buf, chunk_offset, sizeof(chunk_buf), stream->streamfile);
+        }
+
+        snds_ima_expand_nibble(chunk, byte_offset - chunk_offset,nibble_shift, &hist1, &step_index);
         outbuf[sample_count] = (short)(hist1);
     }
 
@@ -567,17 +591,36 @@ void decode_ms_ima(VGMSTREAM * vgmstream, VGMSTREAMCHANNEL * stream, sample_t *
     int i, samples_read = 0, samples_done = 0, max_samples;
     int32_t hist1;// = stream->adpcm_history1_32;
     int step_index;// = stream->adpcm_step_index;
+    uint8_t block_buf[0x2000];
+    const uint8_t* block = NULL;
+    size_t block_span;
 
     /* internal interleave (configurable size), mixed channels */
     int block_samples = ((vgmstream->interleave_block_size - 0x04*vgmstream->channels) * 2 / vgmstream->channels) + 1;
     first_sample = first_sample % block_samples;
 
+    /* whole block at once (all channels), unless too big; the last nibble group may go a bit past
+     * the block when its data isn't a multiple of 8 bytes per channel, so those bytes are read too */
+    block_span = 0x04*vgmstream->channels + 0x04*vgmstream->channels*((block_samples - 2) / 8 + 1);
+    if (block_span < vgmstream->interleave_block_size)
+        block_span = vgmstream->interleave_block_size;
+    if (block_span <= sizeof(block_buf)) {
+        memset(block_buf, 0xFF, block_span); /* same as read_8bit past EOF */
+        block = read_streamfile_ptr(block_buf, stream->offset, block_span, stream->streamfile);
+    }
+
     /* normal header (hist+step+reserved), per channel */
     { //if (first_sample == 0) {
         off_t header_offset = stream->offset + 0x04*channel;
 
-        hist1 =   read_16bitLE(header_offset+0x00,stream->streamfile);
-        step_index = read_8bit(header_offset+0x02,stream->streamfile); /* 0x03: reserved */
+        if (block) {
+            hist1 = get_16bitLE(block + 0x04*channel + 0x00);
+            step_index = (int8_t)block[0x04*channel + 0x02]; /* 0x03: reserved */
+        }
+        else {
+            hist1 = read_16bitLE(header_offset+0x00,stream->streamfile);
+            step_index = read_8bit(header_offset+0x02,stream->streamfile); /* 0x03: reserved */
+        }
         if (step_index < 0) step_index = 0;
         if (step_index > 88) step_index = 88;
 
@@ -595,10 +638,13 @@ void decode_ms_ima(VGMSTREAM * vgmstream, VGMSTREAMCHANNEL * stream, sample_t *
 
     /* decode nibbles (layout: alternates 4 bytes/4*2 nibbles per channel) */
     for (i = 0; i < max_samples; i++) {
-        off_t byte_offset = stream->offset + 0x04*vgmstream->channels + 0x04*channel + 0x04*vgmstream->channels*(i/8) + (i%8)/2;
+        off_t byte_offset = 0x04*vgmstream->channels + 0x04*channel + 0x04*vgmstream->channels*(i/8) + (i%8)/2;
         int nibble_shift = (i&1?4:0); /* low nibble first */
 
-        std_ima_expand_nibble(stream, byte_offset,nibble_shift, &hist1, &step_index); /* original expand */
+        if (block) /* original expand */
+            std_ima_expand_nibble_mem(block, byte_offset,nibble_shift, &hist1, &step_index);
+        else
+            std_ima_expand_nibble(stream, stream->offset + byte_offset,nibble_shift, &hist1, &step_index);
 
         if (samples_read >= first_sample && samples_done < samples_to_do) {
             outbuf[samples_done * channelspacing] = (short)(hist1);
@@ -678,6 +724,8 @@ void decode_ref_ima(VGMSTREAM * vgmstream, VGMSTREAMCHANNEL * stream, sample_t *
 /* MS-IMA with fixed frame size, and outputs an even number of samples per frame (skips last nibble).
  * Defined in Xbox's SDK. Usable in mono or stereo modes (both suitable for interleaved multichannel). */
 void decode_xbox_ima(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do, int channel, int is_stereo) {
+    uint8_t frame_buf[0x24*2];
+    const uint8_t* frame;
     int i, frames_in, sample_pos = 0, block_samples, frame_size;
     int32_t hist1 = stream->adpcm_history1_32;
     int step_index = stream->adpcm_step_index;
@@ -690,15 +738,17 @@ void decode_xbox_ima(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelsp
     frame_size = is_stereo ? 0x24*2 : 0x24;
 
     frame_offset = stream->offset + frame_size*frames_in;
+    memset(frame_buf, 0xFF, sizeof(frame_buf)); /* same as read_8bit past EOF */
+    frame = read_streamfile_ptr(frame_buf, frame_offset, frame_size, stream->streamfile);
 
     /* normal header (hist+step+reserved), stereo/mono */
     if (first_sample == 0) {
         off_t header_offset = is_stereo ?
-                frame_offset + 0x04*(channel % 2) :
-                frame_offset + 0x00;
+                0x04*(channel % 2) :
+                0x00;
 
-        hist1   = read_16bitLE(header_offset+0x00,stream->streamfile);
-        step_index = read_8bit(header_offset+0x02,stream->streamfile);
+        hist1   = get_s16le(frame + header_offset+0x00);
+        step_index = (int8_t)frame[header_offset+0x02];
         if (step_index < 0) step_index=0;
         if (step_index > 88) step_index=88;
 
@@ -712,13 +762,13 @@ void decode_xbox_ima(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelsp
     /* decode nibbles (layout: straight in mono or 4 bytes per channel in stereo) */
     for (i = first_sample; i < first_sample + samples_to_do; i++) {
         off_t byte_offset = is_stereo ?
-                frame_offset + 0x04*2 + 0x04*(channel % 2) + 0x04*2*((i-1)/8) + ((i-1)%8)/2 :
-                frame_offset + 0x04   + (i-1)/2;
+                0x04*2 + 0x04*(channel % 2) + 0x04*2*((i-1)/8) + ((i-1)%8)/2 :
+                0x04   + (i-1)/2;
         int nibble_shift = (!((i-1)&1)   ? 0:4);   /* low first */
 
         /* must skip last nibble per spec, rarely needed though (ex. Gauntlet Dark Legacy) */
         if (i < block_samples) {
-            std_ima_expand_nibble(stream, byte_offset,nibble_shift, &hist1, &step_index);
+            std_ima_expand_nibble_mem(frame, byte_offset,nibble_shift, &hist1, &step_index);
             outbuf[sample_pos] = (short)(hist1);
             sample_pos += channelspacing;
         }
@@ -902,6 +952,8 @@ void decode_rad_ima_mono(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int chann
 
 /* Apple's IMA4, a.k.a QuickTime IMA. 2 byte header and header sample is not written (setup only). */
 void decode_apple_ima4(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do) {
+    uint8_t frame_buf[0x22];
+    const uint8_t* frame;
     int i, sample_count, num_frame;
     int16_t hist1 = stream->adpcm_history1_16;//todo unneeded 16?
     int step_index = stream->adpcm_step_index;
@@ -911,21 +963,22 @@ void decode_apple_ima4(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channel
     num_frame = first_sample / block_samples;
     first_sample = first_sample % block_samples;
 
+    memset(frame_buf, 0xFF, sizeof(frame_buf)); /* same as read_8bit past EOF */
+    frame = read_streamfile_ptr(frame_buf, stream->offset + 0x22*num_frame, sizeof(frame_buf), stream->streamfile);
+
     //2-byte header
     if (first_sample == 0) {
-        off_t header_offset = stream->offset + 0x22*num_frame;
-
-        hist1 = (int16_t)((uint16_t)read_16bitBE(header_offset,stream->streamfile) & 0xff80);
-        step_index = read_8bit(header_offset+1,stream->streamfile) & 0x7f;
+        hist1 = (int16_t)((uint16_t)get_u16be(frame + 0x00) & 0xff80);
+        step_index = frame[0x01] & 0x7f;
         if (step_index < 0) step_index=0;
         if (step_index > 88) step_index=88;
     }
 
     for (i=first_sample,sample_count=0; i<first_sample+samples_to_do; i++,sample_count+=channelspacing) {
-        off_t byte_offset = (stream->offset + 0x22*num_frame + 0x2) + i/2;
+        off_t byte_offset = 0x2 + i/2;
         int nibble_shift = (i&1?4:0); //low nibble first
 
-        std_ima_expand_nibble_16(stream, byte_offset,nibble_shift, &hist1, &step_index);
+        std_ima_expand_nibble_16(frame, byte_offset,nibble_shift, &hist1, &step_index);
         outbuf[sample_count] = (short)(hist1);
     }
 
@@ -169,6 +169,8 @@ struct imuse_codec_data {
         uint32_t size;
         uint32_t flags;
         uint32_t data;
+        int32_t sample; /* first decoded sample */
+        int32_t samples;
     } *block_table;
 
     uint16_t adpcm_table[64 * 89];
@@ -280,6 +282,29 @@ imuse_codec_data* init_imuse(STREAMFILE* sf, int channels) {
         goto fail;
     }
 
+    /* blocks always decode to a fixed size, except headers, so they can be found by sample
+     * (ADPCM state is reset on each block, so they decode on their own too) */
+    {
+        int32_t sample = 0;
+        for (i = 0; i < data->block_count; i++) {
+            struct block_entry_t* entry = &data->block_table[i];
+            size_t data_size = entry->data;
+
+            if (data->type == COMP && i == 0) {
+                size_t copy_size = read_u16be(entry->offset, sf);
+                if (copy_size > data_size) goto fail;
+                data_size -= copy_size;
+            }
+            else if (data->type == MCMP && i == 0 && entry->flags == 0x00) {
+                data_size = 0;
+            }
+
+            entry->sample  = sample;
+            entry->samples = data_size / sizeof(int16_t) / channels;
+            sample += entry->samples;
+        }
+    }
+
     /* iMUSE pre-calculates main decode ops as a table, looks similar to standard IMA expand */
     for (i = 0; i < 64; i++) {
         for (j = 0; j < 89; j++) {
@@ -572,13 +597,14 @@ static int decode_block2(STREAMFILE* sf, imuse_codec_data* data, uint8_t* block,
 }
 
 
-/* decodes a whole block into sample buffer, all at once due to L/R layout and VBR data */
-static int decode_block(STREAMFILE* sf, imuse_codec_data* data) {
+/* decodes a whole block into samples, all at once due to L/R layout and VBR data */
+static int decode_block(STREAMFILE* sf, imuse_codec_data* data, int16_t* samples) {
     int ok;
     uint8_t block[MAX_BLOCK_SIZE];
     size_t data_left;
 
-    data->sbuf.samples = data->samples;
+    data->sbuf.samples = samples;
+    data->sbuf.filled = 0;
     data->sbuf.channels = data->channels;
 
     if (data->current_block >= data->block_count) {
@@ -624,8 +650,21 @@ void decode_imuse(VGMSTREAM* vgmstream, sample_t* outbuf, int32_t samples_to_do)
     while (samples_to_do > 0) {
         sbuf_t* sbuf = &data->sbuf;
 
+        /* whole blocks go straight to outbuf (stereo V1 may write one extra L sample, hence '>') */
+        if (sbuf->filled == 0 && data->current_block < data->block_count &&
+                samples_to_do > data->block_table[data->current_block].samples) {
+            ok = decode_block(sf, data, outbuf);
+            if (!ok) goto fail;
+
+            outbuf += sbuf->filled * sbuf->channels;
+            samples_to_do -= sbuf->filled;
+            sbuf->samples = data->samples;
+            sbuf->filled = 0;
+            continue;
+        }
+
         if (sbuf->filled == 0) {
-            ok = decode_block(sf, data);
+            ok = decode_block(sf, data, data->samples);
             if (!ok) goto fail;
         }
 
@@ -646,12 +685,38 @@ void free_imuse(imuse_codec_data* data) {
     free(data);
 }
 
-void seek_imuse(imuse_codec_data* data, int32_t num_sample) {
+/* decodes the block with num_sample and discards samples before it */
+void seek_imuse(VGMSTREAM* vgmstream, int32_t num_sample) {
+    imuse_codec_data* data = vgmstream->codec_data;
+    STREAMFILE* sf = vgmstream->ch[0].streamfile;
+    int lo, hi, skip;
     if (!data) return;
 
-    //todo find closest block, set skip count
-
     reset_imuse(data);
+    if (num_sample <= 0 || data->block_count == 0)
+        return;
+
+    lo = 0;
+    hi = data->block_count - 1;
+    while (lo < hi) {
+        int mid = (lo + hi + 1) / 2;
+        if (data->block_table[mid].sample <= num_sample)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+
+    data->current_block = lo;
+    if (!decode_block(sf, data, data->samples)) {
+        data->sbuf.filled = 0;
+        return;
+    }
+
+    skip = num_sample - data->block_table[lo].sample;
+    if (skip > data->sbuf.filled)
+        skip = data->sbuf.filled;
+    data->sbuf.samples += skip * data->sbuf.channels;
+    data->sbuf.filled -= skip;
 }
 
 void reset_imuse(imuse_codec_data* data) {
@@ -660,3 +725,35 @@ void reset_imuse(imuse_codec_data* data) {
     data->current_block = 0;
     data->sbuf.filled = 0;
 }
+
+/* state is the current block and its decoded samples (tables are config, sbuf points into samples) */
+typedef struct {
+    int current_block;
+    int filled;
+    size_t consumed;
+    int16_t samples[MAX_BLOCK_SIZE / sizeof(int16_t) * MAX_CHANNELS];
+} imuse_state_t;
+
+void* save_imuse(imuse_codec_data* data, size_t* size) {
+    imuse_state_t* state;
+    if (!data) return NULL;
+
+    state = malloc(sizeof(imuse_state_t));
+    if (!state) return NULL;
+    state->current_block = data->current_block;
+    state->filled = data->sbuf.filled;
+    state->consumed = data->sbuf.samples - data->samples;
+    memcpy(state->samples, data->samples, sizeof(data->samples));
+    *size = sizeof(imuse_state_t);
+    return state;
+}
+
+void restore_imuse(imuse_codec_data* data, const void* state) {
+    const imuse_state_t* saved = state;
+    if (!data || !state) return;
+
+    data->current_block = saved->current_block;
+    data->sbuf.filled = saved->filled;
+    data->sbuf.samples = data->samples + saved->consumed;
+    memcpy(data->samples, saved->samples, sizeof(data->samples));
+}
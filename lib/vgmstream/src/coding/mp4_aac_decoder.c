@@ -11,6 +11,39 @@ static void convert_samples(INT_PCM * src, sample * dest, int32_t count) {
 	}
 }
 
+/* Reads the track's sample table once (instead of asking the demuxer per access), so seeks and
+ * loops can jump to the MP4 sample with the target rather than decode from the start. */
+int setup_mp4_aac_index(mp4_aac_codec_data * data, int sample_rate) {
+    uint32_t timescale = MP4GetTrackTimeScale(data->h_mp4file, data->track_id);
+    unsigned long i;
+
+    if (!timescale || !data->numSamples)
+        goto fail;
+
+    data->read_buffer_size = MP4GetTrackMaxSampleSize(data->h_mp4file, data->track_id);
+    data->read_buffer = malloc(data->read_buffer_size);
+    if (!data->read_buffer) goto fail;
+
+    data->sample_index = malloc(data->numSamples * sizeof(int32_t));
+    if (!data->sample_index) goto fail;
+
+    for (i = 0; i < data->numSamples; i++) {
+        MP4Timestamp dts = MP4GetSampleTime(data->h_mp4file, data->track_id, i + 1);
+        if (dts == MP4_INVALID_TIMESTAMP) goto fail;
+
+        /* output rate may differ from the track's (ex. HE-AAC) */
+        data->sample_index[i] = (int32_t)(dts * sample_rate / timescale);
+    }
+
+    return 1;
+fail:
+    free(data->read_buffer);
+    free(data->sample_index);
+    data->read_buffer = NULL;
+    data->sample_index = NULL;
+    return 0;
+}
+
 void decode_mp4_aac(mp4_aac_codec_data * data, sample * outbuf, int32_t samples_to_do, int channels) {
 	int samples_done = 0;
 
@@ -49,18 +82,14 @@ void decode_mp4_aac(mp4_aac_codec_data * data, sample * outbuf, int32_t samples_
 			memset(outbuf, 0, (samples_to_do - samples_done) * stream_info->numChannels * sizeof(sample));
 			break;
 		}
+		buffer = data->read_buffer;
+		buffer_size = data->read_buffer_size;
 		if (!MP4ReadSample( data->h_mp4file, data->track_id, ++data->sampleId, (uint8_t**)(&buffer), (uint32_t*)(&buffer_size), 0, 0, 0, 0)) return;
 		ubuffer_size = buffer_size;
 		bytes_valid = buffer_size;
-		if ( aacDecoder_Fill( data->h_aacdecoder, &buffer, &ubuffer_size, &bytes_valid ) || bytes_valid ) {
-			free( buffer );
-			return;
-		}
-		if ( aacDecoder_DecodeFrame( data->h_aacdecoder, data->sample_buffer, ( (6) * (2048)*4 ), 0 ) ) {
-			free( buffer );
-			return;
-		}
-		free( buffer ); buffer = NULL;
+		if ( aacDecoder_Fill( data->h_aacdecoder, &buffer, &ubuffer_size, &bytes_valid ) || bytes_valid ) return;
+		if ( aacDecoder_DecodeFrame( data->h_aacdecoder, data->sample_buffer, ( (6) * (2048)*4 ), data->resync ? AACDEC_INTR : 0 ) ) return;
+		data->resync = 0;
 		stream_info = aacDecoder_GetStreamInfo( data->h_aacdecoder );
 		samples_remain = data->samples_per_frame = stream_info->frameSize;
 		data->sample_ptr = 0;
@@ -85,25 +114,40 @@ void decode_mp4_aac(mp4_aac_codec_data * data, sample * outbuf, int32_t samples_
 
 
 void reset_mp4_aac(VGMSTREAM *vgmstream) {
-    mp4_aac_codec_data *data = vgmstream->codec_data;
-    if (!data) return;
-
-    data->sampleId = 0;
-    data->sample_ptr = data->samples_per_frame;
-    data->samples_discard = 0;
+    seek_mp4_aac(vgmstream, 0);
 }
 
 void seek_mp4_aac(VGMSTREAM *vgmstream, int32_t num_sample) {
     mp4_aac_codec_data *data = (mp4_aac_codec_data *)(vgmstream->codec_data);
+    unsigned long start = 0;
     if (!data) return;
 
-    data->sampleId = 0;
+    /* start one MP4 sample before the one with the target, as a frame needs the previous one's
+     * overlap (discarded), with the decoder's state cleared */
+    if (num_sample > 0) {
+        unsigned long lo = 0, hi = data->numSamples - 1;
+        while (lo < hi) {
+            unsigned long mid = (lo + hi + 1) / 2;
+            if (data->sample_index[mid] <= num_sample)
+                lo = mid;
+            else
+                hi = mid - 1;
+        }
+        start = lo > 0 ? lo - 1 : 0;
+    }
+
+    data->sampleId = start; /* next read is start + 1 (1-based) */
     data->sample_ptr = data->samples_per_frame;
-    data->samples_discard = num_sample;
+    data->samples_discard = num_sample > data->sample_index[start] ? num_sample - data->sample_index[start] : 0;
+
+    aacDecoder_SetParam(data->h_aacdecoder, AAC_TPDEC_CLEAR_BUFFER, 1);
+    data->resync = 1;
 }
 
 void free_mp4_aac(mp4_aac_codec_data * data) {
     if (data) {
+        free(data->read_buffer);
+        free(data->sample_index);
         if (data->h_aacdecoder) aacDecoder_Close(data->h_aacdecoder);
         if (data->h_mp4file) MP4Close(data->h_mp4file, 0);
         if (data->if_file.streamfile) close_streamfile(data->if_file.streamfile);
@@ -24,6 +24,7 @@
 #define EALAYER3_MAX_EA_FRAME_SIZE  0x1000*2  /* enough for one EA-frame without PCM block */
 #define EALAYER3_MAX_GRANULES  2
 #define EALAYER3_MAX_CHANNELS  2
+#define EALAYER3_SKIP_INDEX_MAX  0x20000 /* pairs, ~10 min of 48000hz granules (1MB) */
 
 /* helper to pass around */
 typedef struct {
@@ -89,7 +90,11 @@ static int ealayer3_parse_frame_common(ealayer3_buffer_t *ib, ealayer3_frame_t *
 static int ealayer3_rebuild_mpeg_frame(vgm_bitstream *is_0, ealayer3_frame_t *eaf_0, vgm_bitstream *is_1, ealayer3_frame_t *eaf_1, vgm_bitstream *os);
 static int ealayer3_write_pcm_block(VGMSTREAMCHANNEL *stream, mpeg_codec_data *data, int num_stream, ealayer3_frame_t *eaf);
 static int ealayer3_skip_data(VGMSTREAMCHANNEL *stream, mpeg_codec_data *data, int num_stream, int at_start);
+static int ealayer3_skip_index_get(mpeg_custom_stream *ms, off_t offset, uint32_t *skip_size);
+static void ealayer3_skip_index_add(mpeg_custom_stream *ms, off_t offset, uint32_t skip_size);
 static int ealayer3_is_empty_frame_v2p(STREAMFILE *sf, off_t offset);
+static void init_buf(ealayer3_buffer_t *ib, STREAMFILE *sf, off_t offset);
+static int copy_bits(vgm_bitstream *os, vgm_bitstream *is, size_t bits);
 
 /* **************************************************************************** */
 /* EXTERNAL API                                                                 */
@@ -98,16 +103,14 @@ static int ealayer3_is_empty_frame_v2p(STREAMFILE *sf, off_t offset);
 /* init codec from an EALayer3 frame */
 int mpeg_custom_setup_init_ealayer3(STREAMFILE *streamfile, off_t start_offset, mpeg_codec_data *data, coding_t *coding_type) {
     int ok;
-    ealayer3_buffer_t ib = {0};
+    ealayer3_buffer_t ib;
     ealayer3_frame_t eaf;
 
 
     //;VGM_LOG("init at %lx\n", start_offset);
     /* get first frame for info */
     {
-        ib.sf = streamfile;
-        ib.offset = start_offset;
-        ib.is.buf = ib.buf;
+        init_buf(&ib, streamfile, start_offset);
 
         ok = ealayer3_parse_frame(data, -1, &ib, &eaf);
         if (!ok) goto fail;
@@ -133,7 +136,7 @@ fail:
 int mpeg_custom_parse_frame_ealayer3(VGMSTREAMCHANNEL *stream, mpeg_codec_data *data, int num_stream) {
     mpeg_custom_stream *ms = data->streams[num_stream];
     int ok, granule_found;
-    ealayer3_buffer_t ib_0 = {0}, ib_1 = {0};
+    ealayer3_buffer_t ib_0, ib_1; /* not cleared, only the parsed part is used (big) */
     ealayer3_frame_t eaf_0, eaf_1;
 
 
@@ -153,9 +156,7 @@ int mpeg_custom_parse_frame_ealayer3(VGMSTREAMCHANNEL *stream, mpeg_codec_data *
         if (!ealayer3_skip_data(stream, data, num_stream, 1))
             goto fail;
 
-        ib_0.sf = stream->streamfile;
-        ib_0.offset = stream->offset;
-        ib_0.is.buf = ib_0.buf;
+        init_buf(&ib_0, stream->streamfile, stream->offset);
 
         ok = ealayer3_parse_frame(data, num_stream, &ib_0, &eaf_0);
         if (!ok) goto fail;
@@ -196,9 +197,7 @@ int mpeg_custom_parse_frame_ealayer3(VGMSTREAMCHANNEL *stream, mpeg_codec_data *
             break;
         }
 
-        ib_1.sf = stream->streamfile;
-        ib_1.offset = stream->offset;
-        ib_1.is.buf = ib_1.buf;
+        init_buf(&ib_1, stream->streamfile, stream->offset);
 
         ok = ealayer3_parse_frame(data, num_stream, &ib_1, &eaf_1);
         if (!ok) goto fail;
@@ -240,6 +239,16 @@ fail:
 /* INTERNAL HELPERS                                                             */
 /* **************************************************************************** */
 
+static void init_buf(ealayer3_buffer_t *ib, STREAMFILE *sf, off_t offset) {
+    ib->sf = sf;
+    ib->offset = offset;
+    ib->is.buf = ib->buf;
+    ib->is.bufsize = 0;
+    ib->is.b_off = 0;
+    ib->is.mode = BITSTREAM_MSF;
+    ib->leftover_bits = 0;
+}
+
 /* Read at most N bits from streamfile. This makes more smaller reads (not good) but
  * allows exact frame size reading (good), as reading over a frame then reading back
  * is expensive in EALayer3 since it uses custom streamfiles. */
@@ -497,8 +506,7 @@ fail:
 
 /* converts an EALAYER3 frame to a standard MPEG frame from pre-parsed info */
 static int ealayer3_rebuild_mpeg_frame(vgm_bitstream *is_0, ealayer3_frame_t *eaf_0, vgm_bitstream *is_1, ealayer3_frame_t *eaf_1, vgm_bitstream* os) {
-    uint32_t c = 0;
-    int i, j;
+    int i;
     int expected_bitrate_index, expected_frame_size;
 
 
@@ -572,22 +580,14 @@ static int ealayer3_rebuild_mpeg_frame(vgm_bitstream *is_0, ealayer3_frame_t *ea
             w_bits(os, 47-32, eaf_1->others_2[i]);
         }
 
-        /* write MPEG1 main data */
+        /* write MPEG1 main data (all channels are consecutive) */
         is_0->b_off = eaf_0->data_offset_b;
-        for (i = 0; i < eaf_0->channels; i++) { /* granule0 */
-            for (j = 0; j < eaf_0->main_data_size[i]; j++) {
-                r_bits(is_0,  1, &c);
-                w_bits(os,    1,  c);
-            }
-        }
+        if (!copy_bits(os, is_0, eaf_0->data_size_b)) /* granule0 */
+            goto fail;
 
         is_1->b_off = eaf_1->data_offset_b;
-        for (i = 0; i < eaf_1->channels; i++) { /* granule1 */
-            for (j = 0; j < eaf_1->main_data_size[i]; j++) {
-                r_bits(is_1,  1, &c);
-                w_bits(os,    1,  c);
-            }
-        }
+        if (!copy_bits(os, is_1, eaf_1->data_size_b)) /* granule1 */
+            goto fail;
     }
     else {
         int private_bits = (eaf_0->channels==1 ? 1 : 2);
@@ -604,12 +604,8 @@ static int ealayer3_rebuild_mpeg_frame(vgm_bitstream *is_0, ealayer3_frame_t *ea
 
         /* write MPEG2 main data */
         is_0->b_off = eaf_0->data_offset_b;
-        for (i = 0; i < eaf_0->channels; i++) {
-            for (j = 0; j < eaf_0->main_data_size[i]; j++) {
-                r_bits(is_0,  1, &c);
-                w_bits(os,    1,  c);
-            }
-        }
+        if (!copy_bits(os, is_0, eaf_0->data_size_b))
+            goto fail;
     }
 
     /* align to closest 8b */
@@ -636,6 +632,49 @@ fail:
     return 0;
 }
 
+/* Copies bits between MSF bitstreams (same as reading/writing 1 bit at a time), by whole bytes
+ * once the output is aligned. MPEG data is most of an EA-frame so this is the bulk of rebuilding. */
+static int copy_bits(vgm_bitstream *os, vgm_bitstream *is, size_t bits) {
+    uint32_t c = 0;
+    const uint8_t *ibuf;
+    uint8_t *obuf;
+    size_t i, head, bytes;
+    int shift;
+
+    if (is->b_off + bits > is->bufsize*8 || os->b_off + bits > os->bufsize*8)
+        return 0;
+
+    /* up to the next output byte */
+    head = (8 - os->b_off % 8) % 8;
+    if (head > bits)
+        head = bits;
+    r_bits(is, head, &c);
+    w_bits(os, head, c);
+    bits -= head;
+
+    /* whole bytes, taking each from 2 input bytes if unaligned (the 2nd is within the copied bits) */
+    bytes = bits / 8;
+    ibuf = is->buf + is->b_off / 8;
+    obuf = os->buf + os->b_off / 8;
+    shift = is->b_off % 8;
+    if (shift == 0) {
+        memcpy(obuf, ibuf, bytes);
+    }
+    else {
+        for (i = 0; i < bytes; i++) {
+            obuf[i] = (uint8_t)(ibuf[i] << shift) | (ibuf[i+1] >> (8 - shift));
+        }
+    }
+    is->b_off += bytes * 8;
+    os->b_off += bytes * 8;
+    bits -= bytes * 8;
+
+    /* rest */
+    r_bits(is, bits, &c);
+    w_bits(os, bits, c);
+    return 1;
+}
+
 static void ealayer3_copy_pcm_block(uint8_t* outbuf, off_t pcm_offset, int pcm_number, int channels_per_frame, int is_packed, STREAMFILE *sf) {
     int i, ch;
     uint8_t pcm_block[1152 * 2 * 2]; /* assumed max: 1 MPEG frame samples * 16b * max channels */
@@ -818,19 +857,28 @@ fail:
  * EALayer3 v1 in SCHl uses external offsets and 1ch multichannel instead.
  */
 static int ealayer3_skip_data(VGMSTREAMCHANNEL *stream, mpeg_codec_data *data, int num_stream, int at_start) {
+    mpeg_custom_stream *ms = data->streams[num_stream];
     int ok, i;
-    ealayer3_buffer_t ib = {0};
+    ealayer3_buffer_t ib;
     ealayer3_frame_t eaf;
     int skips = at_start ? num_stream : data->streams_size - 1 - num_stream;
+    off_t start_offset = stream->offset;
+    uint32_t skip_size;
 
     /* v1 does multichannel with set offsets */
     if (data->type == MPEG_EAL31)
         return 1;
+    if (skips == 0)
+        return 1;
+
+    /* same skips were done before (loops and seeks restart from the beginning) */
+    if (ealayer3_skip_index_get(ms, start_offset, &skip_size)) {
+        stream->offset += skip_size;
+        return 1;
+    }
 
     for (i = 0; i < skips; i++) {
-        ib.sf = stream->streamfile;
-        ib.offset = stream->offset;
-        ib.is.buf = ib.buf;
+        init_buf(&ib, stream->streamfile, stream->offset);
 
         ok = ealayer3_parse_frame(data, num_stream, &ib, &eaf);
         if (!ok) goto fail;
@@ -840,11 +888,68 @@ static int ealayer3_skip_data(VGMSTREAMCHANNEL *stream, mpeg_codec_data *data, i
     }
     //;VGM_LOG("s%i: skipped %i frames, now at %lx\n", num_stream,skips,stream->offset);
 
+    ealayer3_skip_index_add(ms, start_offset, stream->offset - start_offset);
     return 1;
 fail:
     return 0;
 }
 
+/* Finds the skip done from offset, expecting the next one in order (as playback repeats them) */
+static int ealayer3_skip_index_get(mpeg_custom_stream *ms, off_t offset, uint32_t *skip_size) {
+    size_t pos = ms->skip_index_pos;
+    size_t low, high;
+
+    if (pos < ms->skip_index_count && ms->skip_index[pos*2 + 0] == offset) {
+        *skip_size = ms->skip_index[pos*2 + 1];
+        ms->skip_index_pos++;
+        return 1;
+    }
+
+    /* not the next one (first pass, or some other jump): offsets only grow in a pass */
+    low = 0;
+    high = ms->skip_index_count;
+    while (low < high) {
+        size_t mid = (low + high) / 2;
+        if (ms->skip_index[mid*2 + 0] < offset)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    ms->skip_index_pos = low;
+
+    if (low < ms->skip_index_count && ms->skip_index[low*2 + 0] == offset) {
+        *skip_size = ms->skip_index[low*2 + 1];
+        ms->skip_index_pos++;
+        return 1;
+    }
+    return 0;
+}
+
+static void ealayer3_skip_index_add(mpeg_custom_stream *ms, off_t offset, uint32_t skip_size) {
+    if (offset > 0xFFFFFFFF)
+        return;
+    if (ms->skip_index_count && ms->skip_index[(ms->skip_index_count - 1)*2 + 0] >= offset)
+        return; /* only in order */
+
+    if (ms->skip_index_count == ms->skip_index_max) {
+        uint32_t *skip_index;
+        size_t max = ms->skip_index_max ? ms->skip_index_max * 2 : 0x400;
+
+        if (max > EALAYER3_SKIP_INDEX_MAX)
+            return; /* too long, rest is re-parsed */
+        skip_index = realloc(ms->skip_index, max * 2 * sizeof(uint32_t));
+        if (!skip_index)
+            return;
+        ms->skip_index = skip_index;
+        ms->skip_index_max = max;
+    }
+
+    ms->skip_index[ms->skip_index_count*2 + 0] = (uint32_t)offset;
+    ms->skip_index[ms->skip_index_count*2 + 1] = skip_size;
+    ms->skip_index_count++;
+    ms->skip_index_pos = ms->skip_index_count;
+}
+
 static int ealayer3_is_empty_frame_v2p(STREAMFILE *sf, off_t offset) {
     /* V2P frame header should contain a valid frame size (lower 12b) */
     uint16_t v2_header = read_u16be(offset, sf);
@@ -13,6 +13,7 @@ static mpg123_handle * init_mpg123_handle();
 static void decode_mpeg_standard(VGMSTREAMCHANNEL *stream, mpeg_codec_data * data, sample_t * outbuf, int32_t samples_to_do, int channels);
 static void decode_mpeg_custom(VGMSTREAM * vgmstream, mpeg_codec_data * data, sample_t * outbuf, int32_t samples_to_do, int channels);
 static void decode_mpeg_custom_stream(VGMSTREAMCHANNEL *stream, mpeg_codec_data * data, int num_stream);
+static int decode_mpeg_custom_parallel(VGMSTREAM * vgmstream, mpeg_codec_data * data, int32_t samples_to_do);
 
 
 /* Inits regular MPEG */
@@ -183,21 +184,23 @@ fail:
 }
 
 
+static vgm_once_t g_mpg123_initialized = 0;
+
+/* Global mpg123 init (older versions need it before handles are made, and it isn't thread safe) */
+static void g_setup_mpg123(void) {
+    mpg123_init();
+}
+
 static mpg123_handle * init_mpg123_handle() {
     mpg123_handle *m = NULL;
     int rc;
 
+    vgm_once(&g_mpg123_initialized, g_setup_mpg123);
+
     /* inits a new mpg123 handle */
     m = mpg123_new(NULL,&rc);
-    if (rc == MPG123_NOT_INITIALIZED) {
-        /* inits the library if needed */
-        if (mpg123_init() != MPG123_OK)
-            goto fail;
-        m = mpg123_new(NULL,&rc);
-        if (rc != MPG123_OK) goto fail;
-    } else if (rc != MPG123_OK) {
+    if (rc != MPG123_OK)
         goto fail;
-    }
 
     mpg123_param(m,MPG123_REMOVE_FLAGS,MPG123_GAPLESS,0.0); /* wonky support */
     mpg123_param(m,MPG123_RESYNC_LIMIT, -1, 0x2000); /* just in case, games shouldn't ever need this */
@@ -346,6 +349,10 @@ static void decode_mpeg_custom(VGMSTREAM * vgmstream, mpeg_codec_data * data, sa
         else {
             /* decode more into stream sample buffers */
 
+            /* streams are independent (own mpg123 handle, buffers and channel), so may decode at once */
+            if (decode_mpeg_custom_parallel(vgmstream, data, samples_to_do - samples_done))
+                continue;
+
             /* Handle offsets depending on the data layout (may only use half VGMSTREAMCHANNELs with 2ch streams)
              * With multiple offsets they should already start in the first frame of each stream. */
             for (i=0; i < data->streams_size; i++) {
@@ -364,6 +371,39 @@ static void decode_mpeg_custom(VGMSTREAM * vgmstream, mpeg_codec_data * data, sa
     }
 }
 
+typedef struct {
+    VGMSTREAM* vgmstream;
+    mpeg_codec_data* data;
+} decode_mpeg_job_t;
+
+static void decode_mpeg_custom_job(void* job_data, int num_stream) {
+    decode_mpeg_job_t* job = job_data;
+    decode_mpeg_custom_stream(&job->vgmstream->ch[num_stream], job->data, num_stream);
+}
+
+/* Decodes every stream through the host runner if worth it, returns 0 if not done. Needs a streamfile
+ * per stream (see mpeg_is_parallel_decoder), which some metas/layouts may not set. */
+static int decode_mpeg_custom_parallel(VGMSTREAM * vgmstream, mpeg_codec_data * data, int32_t samples_to_do) {
+    decode_mpeg_job_t job;
+    int i, j;
+
+    if (!mpeg_is_parallel_decoder(data) || data->streams_size > vgmstream->channels)
+        return 0;
+
+    for (i = 0; i < data->streams_size; i++) {
+        if (!vgmstream->ch[i].streamfile)
+            return 0;
+        for (j = 0; j < i; j++) {
+            if (vgmstream->ch[i].streamfile == vgmstream->ch[j].streamfile)
+                return 0;
+        }
+    }
+
+    job.vgmstream = vgmstream;
+    job.data = data;
+    return vgmstream_run_parallel(vgmstream->channels, samples_to_do, decode_mpeg_custom_job, &job, data->streams_size);
+}
+
 /* Decodes frames from a stream into the stream's sample buffer, feeding mpg123 buffer data.
  * If not enough data to decode (as N data-frames = 1 full-frame) this will exit but be called again. */
 static void decode_mpeg_custom_stream(VGMSTREAMCHANNEL *stream, mpeg_codec_data * data, int num_stream) {
@@ -489,6 +529,7 @@ void free_mpeg(mpeg_codec_data *data) {
             mpg123_delete(data->streams[i]->m);
             free(data->streams[i]->buffer);
             free(data->streams[i]->output_buffer);
+            free(data->streams[i]->skip_index);
             free(data->streams[i]);
         }
         free(data->streams);
@@ -583,6 +624,7 @@ void flush_mpeg(mpeg_codec_data * data) {
             data->streams[i]->current_size_count = 0;
             data->streams[i]->current_size_target = 0;
             data->streams[i]->decode_to_discard = 0;
+            data->streams[i]->skip_index_pos = 0;
         }
 
         data->samples_to_discard = data->skip_samples;
@@ -614,6 +656,12 @@ long mpeg_bytes_to_samples(long bytes, const mpeg_codec_data *data) {
     }
 }
 
+/* Multi-stream custom MPEG (multichannel EALayer3, AWC, etc), that decodes its streams in parallel
+ * when vgmstream_channel_workers_setup is used */
+int mpeg_is_parallel_decoder(mpeg_codec_data *data) {
+    return data && data->custom && data->streams_size > 1;
+}
+
 #if 0
 /* disables/enables stderr output, for MPEG known to contain recoverable errors */
 void mpeg_set_error_logging(mpeg_codec_data * data, int enable) {
@@ -19,16 +19,39 @@ static const int16_t msadpcm_coefs[7][2] = {
     { 392, -232 }
 };
 
+/* Expands one nibble using and updating the channel's state. */
+static inline int16_t msadpcm_expand_nibble(VGMSTREAMCHANNEL *stream, int sample_nibble) {
+    int32_t hist1,hist2, predicted;
+
+    hist1 = stream->adpcm_history1_16;
+    hist2 = stream->adpcm_history2_16;
+    predicted = hist1*stream->adpcm_coef[0] + hist2*stream->adpcm_coef[1];
+    predicted = predicted / 256;
+    predicted = predicted + sample_nibble*stream->adpcm_scale;
+    predicted = clamp16(predicted);
+
+    stream->adpcm_history2_16 = stream->adpcm_history1_16;
+    stream->adpcm_history1_16 = predicted;
+    stream->adpcm_scale = (msadpcm_steps[sample_nibble & 0xf] * stream->adpcm_scale) / 256;
+    if (stream->adpcm_scale < 0x10)
+        stream->adpcm_scale = 0x10;
+
+    return predicted;
+}
+
+/* Frames may be long and calls small, so bytes are taken from a windowed reader (one read per
+ * window rather than per nibble), and many consecutive frames are decoded per call.
+ * Mid-frame calls resume from the channel's hist/scale/coefs, so headers are only parsed once. */
 void decode_msadpcm_stereo(VGMSTREAM * vgmstream, sample_t * outbuf, int32_t first_sample, int32_t samples_to_do) {
     VGMSTREAMCHANNEL *ch1,*ch2;
-    STREAMFILE *streamfile;
-    int i, frames_in;
+    sf_reader r;
+    int i, frames_in, frame_samples, samples_done = 0;
     size_t bytes_per_frame, samples_per_frame;
     off_t frame_offset;
 
     ch1 = &vgmstream->ch[0];
     ch2 = &vgmstream->ch[1];
-    streamfile = ch1->streamfile;
+    sf_reader_init(&r, ch1->streamfile);
 
     /* external interleave (variable size), stereo */
     bytes_per_frame = get_vgmstream_frame_size(vgmstream);
@@ -36,125 +59,119 @@ void decode_msadpcm_stereo(VGMSTREAM * vgmstream, sample_t * outbuf, int32_t fir
     frames_in = first_sample / samples_per_frame;
     first_sample = first_sample % samples_per_frame;
 
-    frame_offset = ch1->offset + frames_in*bytes_per_frame;
-
-    /* parse frame header */
-    if (first_sample == 0) {
-        ch1->adpcm_coef[0] = msadpcm_coefs[read_8bit(frame_offset+0x00,streamfile) & 0x07][0];
-        ch1->adpcm_coef[1] = msadpcm_coefs[read_8bit(frame_offset+0x00,streamfile) & 0x07][1];
-        ch2->adpcm_coef[0] = msadpcm_coefs[read_8bit(frame_offset+0x01,streamfile)][0];
-        ch2->adpcm_coef[1] = msadpcm_coefs[read_8bit(frame_offset+0x01,streamfile)][1];
-        ch1->adpcm_scale = read_16bitLE(frame_offset+0x02,streamfile);
-        ch2->adpcm_scale = read_16bitLE(frame_offset+0x04,streamfile);
-        ch1->adpcm_history1_16 = read_16bitLE(frame_offset+0x06,streamfile);
-        ch2->adpcm_history1_16 = read_16bitLE(frame_offset+0x08,streamfile);
-        ch1->adpcm_history2_16 = read_16bitLE(frame_offset+0x0a,streamfile);
-        ch2->adpcm_history2_16 = read_16bitLE(frame_offset+0x0c,streamfile);
-    }
-
-    /* write header samples (needed) */
-    if (first_sample==0) {
-        outbuf[0] = ch1->adpcm_history2_16;
-        outbuf[1] = ch2->adpcm_history2_16;
-        outbuf += 2;
-        first_sample++;
-        samples_to_do--;
-    }
-    if (first_sample == 1 && samples_to_do > 0) {
-        outbuf[0] = ch1->adpcm_history1_16;
-        outbuf[1] = ch2->adpcm_history1_16;
-        outbuf += 2;
-        first_sample++;
-        samples_to_do--;
-    }
-
-    /* decode nibbles */
-    for (i = first_sample; i < first_sample+samples_to_do; i++) {
-        int ch;
-
-        for (ch = 0; ch < 2; ch++) {
-            VGMSTREAMCHANNEL *stream = &vgmstream->ch[ch];
-            int32_t hist1,hist2, predicted;
-            int sample_nibble = (ch == 0) ? /* L = high nibble first */
-                 get_high_nibble_signed(read_8bit(frame_offset+0x07*2+(i-2),streamfile)) :
-                 get_low_nibble_signed (read_8bit(frame_offset+0x07*2+(i-2),streamfile));
+    /* may be called with many consecutive frames */
+    while (samples_done < samples_to_do) {
+        frame_samples = samples_per_frame - first_sample;
+        if (frame_samples > samples_to_do - samples_done)
+            frame_samples = samples_to_do - samples_done;
+        samples_done += frame_samples;
+
+        frame_offset = ch1->offset + frames_in*bytes_per_frame;
+
+        /* parse frame header */
+        if (first_sample == 0) {
+            ch1->adpcm_coef[0] = msadpcm_coefs[sf_reader_s8(&r, frame_offset+0x00) & 0x07][0];
+            ch1->adpcm_coef[1] = msadpcm_coefs[sf_reader_s8(&r, frame_offset+0x00) & 0x07][1];
+            ch2->adpcm_coef[0] = msadpcm_coefs[sf_reader_s8(&r, frame_offset+0x01)][0];
+            ch2->adpcm_coef[1] = msadpcm_coefs[sf_reader_s8(&r, frame_offset+0x01)][1];
+            ch1->adpcm_scale = sf_reader_s16le(&r, frame_offset+0x02);
+            ch2->adpcm_scale = sf_reader_s16le(&r, frame_offset+0x04);
+            ch1->adpcm_history1_16 = sf_reader_s16le(&r, frame_offset+0x06);
+            ch2->adpcm_history1_16 = sf_reader_s16le(&r, frame_offset+0x08);
+            ch1->adpcm_history2_16 = sf_reader_s16le(&r, frame_offset+0x0a);
+            ch2->adpcm_history2_16 = sf_reader_s16le(&r, frame_offset+0x0c);
+        }
 
-            hist1 = stream->adpcm_history1_16;
-            hist2 = stream->adpcm_history2_16;
-            predicted = hist1*stream->adpcm_coef[0] + hist2*stream->adpcm_coef[1];
-            predicted = predicted / 256;
-            predicted = predicted + sample_nibble*stream->adpcm_scale;
-            outbuf[0] = clamp16(predicted);
+        /* write header samples (needed) */
+        if (first_sample == 0) {
+            outbuf[0] = ch1->adpcm_history2_16;
+            outbuf[1] = ch2->adpcm_history2_16;
+            outbuf += 2;
+            first_sample++;
+            frame_samples--;
+        }
+        if (first_sample == 1 && frame_samples > 0) {
+            outbuf[0] = ch1->adpcm_history1_16;
+            outbuf[1] = ch2->adpcm_history1_16;
+            outbuf += 2;
+            first_sample++;
+            frame_samples--;
+        }
 
-            stream->adpcm_history2_16 = stream->adpcm_history1_16;
-            stream->adpcm_history1_16 = outbuf[0];
-            stream->adpcm_scale = (msadpcm_steps[sample_nibble & 0xf] * stream->adpcm_scale) / 256;
-            if (stream->adpcm_scale < 0x10)
-                stream->adpcm_scale = 0x10;
+        /* decode nibbles */
+        for (i = first_sample; i < first_sample + frame_samples; i++) {
+            int8_t nibbles = sf_reader_s8(&r, frame_offset+0x07*2+(i-2));
 
-            outbuf++;
+            outbuf[0] = msadpcm_expand_nibble(ch1, get_high_nibble_signed(nibbles)); /* L = high nibble first */
+            outbuf[1] = msadpcm_expand_nibble(ch2, get_low_nibble_signed(nibbles));
+            outbuf += 2;
         }
+
+        first_sample = 0;
+        frames_in++;
     }
 }
 
 void decode_msadpcm_mono(VGMSTREAM * vgmstream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do, int channel) {
     VGMSTREAMCHANNEL *stream = &vgmstream->ch[channel];
-    int i, frames_in;
+    sf_reader r;
+    int i, frames_in, frame_samples, samples_done = 0;
     size_t bytes_per_frame, samples_per_frame;
     off_t frame_offset;
 
+    sf_reader_init(&r, stream->streamfile);
+
     /* external interleave (variable size), mono */
     bytes_per_frame = get_vgmstream_frame_size(vgmstream);
     samples_per_frame = get_vgmstream_samples_per_frame(vgmstream);
     frames_in = first_sample / samples_per_frame;
     first_sample = first_sample % samples_per_frame;
 
-    frame_offset = stream->offset + frames_in*bytes_per_frame;
+    /* may be called with many consecutive frames */
+    while (samples_done < samples_to_do) {
+        frame_samples = samples_per_frame - first_sample;
+        if (frame_samples > samples_to_do - samples_done)
+            frame_samples = samples_to_do - samples_done;
+        samples_done += frame_samples;
+
+        frame_offset = stream->offset + frames_in*bytes_per_frame;
+
+        /* parse frame header */
+        if (first_sample == 0) {
+            stream->adpcm_coef[0] = msadpcm_coefs[sf_reader_s8(&r, frame_offset+0x00) & 0x07][0];
+            stream->adpcm_coef[1] = msadpcm_coefs[sf_reader_s8(&r, frame_offset+0x00) & 0x07][1];
+            stream->adpcm_scale = sf_reader_s16le(&r, frame_offset+0x01);
+            stream->adpcm_history1_16 = sf_reader_s16le(&r, frame_offset+0x03);
+            stream->adpcm_history2_16 = sf_reader_s16le(&r, frame_offset+0x05);
+        }
 
-    /* parse frame header */
-    if (first_sample == 0) {
-        stream->adpcm_coef[0] = msadpcm_coefs[read_8bit(frame_offset+0x00,stream->streamfile) & 0x07][0];
-        stream->adpcm_coef[1] = msadpcm_coefs[read_8bit(frame_offset+0x00,stream->streamfile) & 0x07][1];
-        stream->adpcm_scale = read_16bitLE(frame_offset+0x01,stream->streamfile);
-        stream->adpcm_history1_16 = read_16bitLE(frame_offset+0x03,stream->streamfile);
-        stream->adpcm_history2_16 = read_16bitLE(frame_offset+0x05,stream->streamfile);
-    }
+        /* write header samples (needed) */
+        if (first_sample == 0) {
+            outbuf[0] = stream->adpcm_history2_16;
+            outbuf += channelspacing;
+            first_sample++;
+            frame_samples--;
+        }
+        if (first_sample == 1 && frame_samples > 0) {
+            outbuf[0] = stream->adpcm_history1_16;
+            outbuf += channelspacing;
+            first_sample++;
+            frame_samples--;
+        }
 
-    /* write header samples (needed) */
-    if (first_sample == 0) {
-        outbuf[0] = stream->adpcm_history2_16;
-        outbuf += channelspacing;
-        first_sample++;
-        samples_to_do--;
-    }
-    if (first_sample == 1 && samples_to_do > 0) {
-        outbuf[0] = stream->adpcm_history1_16;
-        outbuf += channelspacing;
-        first_sample++;
-        samples_to_do--;
-    }
+        /* decode nibbles */
+        for (i = first_sample; i < first_sample + frame_samples; i++) {
+            int8_t nibbles = sf_reader_s8(&r, frame_offset+0x07+(i-2)/2);
+            int sample_nibble = (i & 1) ? /* high nibble first */
+                 get_low_nibble_signed(nibbles) :
+                 get_high_nibble_signed(nibbles);
 
-    /* decode nibbles */
-    for (i = first_sample; i < first_sample+samples_to_do; i++) {
-        int32_t hist1,hist2, predicted;
-        int sample_nibble = (i & 1) ? /* high nibble first */
-             get_low_nibble_signed (read_8bit(frame_offset+0x07+(i-2)/2,stream->streamfile)) :
-             get_high_nibble_signed(read_8bit(frame_offset+0x07+(i-2)/2,stream->streamfile));
-
-        hist1 = stream->adpcm_history1_16;
-        hist2 = stream->adpcm_history2_16;
-        predicted = hist1*stream->adpcm_coef[0] + hist2*stream->adpcm_coef[1];
-        predicted = predicted / 256;
-        predicted = predicted + sample_nibble*stream->adpcm_scale;
-        outbuf[0] = clamp16(predicted);
-
-        stream->adpcm_history2_16 = stream->adpcm_history1_16;
-        stream->adpcm_history1_16 = outbuf[0];
-        stream->adpcm_scale = (msadpcm_steps[sample_nibble & 0xf] * stream->adpcm_scale) / 256;
-        if (stream->adpcm_scale < 0x10)
-            stream->adpcm_scale = 0x10;
-
-        outbuf += channelspacing;
+            outbuf[0] = msadpcm_expand_nibble(stream, sample_nibble);
+            outbuf += channelspacing;
+        }
+
+        first_sample = 0;
+        frames_in++;
     }
 }
 
@@ -162,62 +179,77 @@ void decode_msadpcm_mono(VGMSTREAM * vgmstream, sample_t * outbuf, int channelsp
  * (their tools may convert to float/others but internally it's all PCM16, from debugging). */
 void decode_msadpcm_ck(VGMSTREAM * vgmstream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do, int channel) {
     VGMSTREAMCHANNEL *stream = &vgmstream->ch[channel];
-    int i, frames_in;
+    sf_reader r;
+    int i, frames_in, frame_samples, samples_done = 0;
     size_t bytes_per_frame, samples_per_frame;
     off_t frame_offset;
 
+    sf_reader_init(&r, stream->streamfile);
+
     /* external interleave (variable size), mono */
     bytes_per_frame = get_vgmstream_frame_size(vgmstream);
     samples_per_frame = get_vgmstream_samples_per_frame(vgmstream);
     frames_in = first_sample / samples_per_frame;
     first_sample = first_sample % samples_per_frame;
 
-    frame_offset = stream->offset + frames_in*bytes_per_frame;
+    /* may be called with many consecutive frames */
+    while (samples_done < samples_to_do) {
+        frame_samples = samples_per_frame - first_sample;
+        if (frame_samples > samples_to_do - samples_done)
+            frame_samples = samples_to_do - samples_done;
+        samples_done += frame_samples;
+
+        frame_offset = stream->offset + frames_in*bytes_per_frame;
+
+        /* parse frame header */
+        if (first_sample == 0) {
+            stream->adpcm_coef[0] = msadpcm_coefs[sf_reader_s8(&r, frame_offset+0x00) & 0x07][0];
+            stream->adpcm_coef[1] = msadpcm_coefs[sf_reader_s8(&r, frame_offset+0x00) & 0x07][1];
+            stream->adpcm_scale = sf_reader_s16le(&r, frame_offset+0x01);
+            stream->adpcm_history2_16 = sf_reader_s16le(&r, frame_offset+0x03); /* hist2 first, unlike normal MSADPCM */
+            stream->adpcm_history1_16 = sf_reader_s16le(&r, frame_offset+0x05);
+        }
 
-    /* parse frame header */
-    if (first_sample == 0) {
-        stream->adpcm_coef[0] = msadpcm_coefs[read_8bit(frame_offset+0x00,stream->streamfile) & 0x07][0];
-        stream->adpcm_coef[1] = msadpcm_coefs[read_8bit(frame_offset+0x00,stream->streamfile) & 0x07][1];
-        stream->adpcm_scale = read_16bitLE(frame_offset+0x01,stream->streamfile);
-        stream->adpcm_history2_16 = read_16bitLE(frame_offset+0x03,stream->streamfile); /* hist2 first, unlike normal MSADPCM */
-        stream->adpcm_history1_16 = read_16bitLE(frame_offset+0x05,stream->streamfile);
-    }
+        /* write header samples (needed) */
+        if (first_sample == 0) {
+            outbuf[0] = stream->adpcm_history2_16;
+            outbuf += channelspacing;
+            first_sample++;
+            frame_samples--;
+        }
+        if (first_sample == 1 && frame_samples > 0) {
+            outbuf[0] = stream->adpcm_history1_16;
+            outbuf += channelspacing;
+            first_sample++;
+            frame_samples--;
+        }
 
-    /* write header samples (needed) */
-    if (first_sample == 0) {
-        outbuf[0] = stream->adpcm_history2_16;
-        outbuf += channelspacing;
-        first_sample++;
-        samples_to_do--;
-    }
-    if (first_sample == 1 && samples_to_do > 0) {
-        outbuf[0] = stream->adpcm_history1_16;
-        outbuf += channelspacing;
-        first_sample++;
-        samples_to_do--;
-    }
+        /* decode nibbles */
+        for (i = first_sample; i < first_sample + frame_samples; i++) {
+            int32_t hist1,hist2, predicted;
+            int8_t nibbles = sf_reader_s8(&r, frame_offset+0x07+(i-2)/2);
+            int sample_nibble = (i & 1) ? /* low nibble first, unlike normal MSADPCM */
+                 get_high_nibble_signed(nibbles) :
+                 get_low_nibble_signed(nibbles);
+
+            hist1 = stream->adpcm_history1_16;
+            hist2 = stream->adpcm_history2_16;
+            predicted = hist1*stream->adpcm_coef[0] + hist2*stream->adpcm_coef[1];
+            predicted = predicted >> 8; /* probably no difference vs MSADPCM */
+            predicted = predicted + sample_nibble*stream->adpcm_scale;
+            outbuf[0] = clamp16(predicted);
+
+            stream->adpcm_history2_16 = stream->adpcm_history1_16;
+            stream->adpcm_history1_16 = outbuf[0];
+            stream->adpcm_scale = (msadpcm_steps[sample_nibble & 0xf] * stream->adpcm_scale) >> 8;
+            if (stream->adpcm_scale < 0x10)
+                stream->adpcm_scale = 0x10;
+
+            outbuf += channelspacing;
+        }
 
-    /* decode nibbles */
-    for (i = first_sample; i < first_sample+samples_to_do; i++) {
-        int32_t hist1,hist2, predicted;
-        int sample_nibble = (i & 1) ? /* low nibble first, unlike normal MSADPCM */
-             get_high_nibble_signed (read_8bit(frame_offset+0x07+(i-2)/2,stream->streamfile)) :
-             get_low_nibble_signed(read_8bit(frame_offset+0x07+(i-2)/2,stream->streamfile));
-
-        hist1 = stream->adpcm_history1_16;
-        hist2 = stream->adpcm_history2_16;
-        predicted = hist1*stream->adpcm_coef[0] + hist2*stream->adpcm_coef[1];
-        predicted = predicted >> 8; /* probably no difference vs MSADPCM */
-        predicted = predicted + sample_nibble*stream->adpcm_scale;
-        outbuf[0] = clamp16(predicted);
-
-        stream->adpcm_history2_16 = stream->adpcm_history1_16;
-        stream->adpcm_history1_16 = outbuf[0];
-        stream->adpcm_scale = (msadpcm_steps[sample_nibble & 0xf] * stream->adpcm_scale) >> 8;
-        if (stream->adpcm_scale < 0x10)
-            stream->adpcm_scale = 0x10;
-
-        outbuf += channelspacing;
+        first_sample = 0;
+        frames_in++;
     }
 }
 
@@ -37,67 +37,41 @@ static const int mta2_scales[32] = {
     160290, 209620, 274133, 358500, 468831, 613119, 801811, 1048576
 };
 
-/* decodes a block for a channel */
-void decode_mta2(VGMSTREAMCHANNEL *stream, sample_t *outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do, int channel) {
-    uint8_t frame[0x10 + 0x90*8] = {0};
-    int samples_done = 0, sample_count = 0, channel_block_samples, channel_first_sample, frame_size = 0;
-    int i, group, row, col;
-    int track_channels = 0, track_channel;
-
-
-    /* track skip */
-    do {
-        int num_track = 0, channel_layout;
-
-        /* parse track header (0x10) and skip tracks that our current channel doesn't belong to */
-        read_streamfile(frame, stream->offset, 0x10, stream->streamfile); /* ignore EOF errors */
-        num_track      = get_u8   (frame + 0x00); /* 0=first */
-        /* 0x01(3): num_frame (0=first) */
-        /* 0x04(1): 0? */
-        channel_layout = get_u8   (frame + 0x05); /* bitmask, see mta2.c */
-        frame_size     = get_u16be(frame + 0x06); /* not including this header */
-        /* 0x08(8): null */
-
-        VGM_ASSERT(frame_size == 0, "MTA2: empty frame at %x\n", (uint32_t)stream->offset);
-        /* frame_size 0 means silent/empty frame (rarely found near EOF for one track but not others)
-         * negative track only happens for truncated files (EOF) */
-        if (frame_size == 0 || num_track < 0) {
-            for (i = 0; i < samples_to_do; i++)
-                outbuf[i * channelspacing] = 0;
-            stream->offset += 0x10;
-            return;
-        }
-
-        track_channels = 0;
-        for (i = 0; i < 8; i++) { /* max 8ch */
-            if ((channel_layout >> i) & 0x01)
-                track_channels++;
-        }
-
-        if (track_channels == 0) { /* bad data, avoid div by 0 */
-            VGM_LOG("MTA2: track_channels 0 at %x\n", (uint32_t)stream->offset);
-            return;
-        }
-
-        /* assumes tracks channels are divided evenly in all tracks (ex. not 2ch + 1ch + 1ch) */
-        if (channel / track_channels == num_track)
-            break; /* channel belongs to this track */
-
-        /* keep looping for our track */
-        stream->offset += 0x10 + frame_size;
+#define MTA2_TRACK_HEADER_SIZE 0x10
+#define MTA2_CHANNEL_FRAME_SIZE 0x90
+#define MTA2_MAX_TRACK_CHANNELS 8
+#define MTA2_MAX_TRACKS 16
+#define MTA2_BLOCK_SAMPLES (0x80*2)
+
+/* parses a track header (0x10), returns track channels (0 if bad) */
+static int parse_track_header(const uint8_t* header, int* num_track, int* frame_size) {
+    int i, channel_layout, track_channels = 0;
+
+    *num_track     = get_u8   (header + 0x00); /* 0=first */
+    /* 0x01(3): num_frame (0=first) */
+    /* 0x04(1): 0? */
+    channel_layout = get_u8   (header + 0x05); /* bitmask, see mta2.c */
+    *frame_size    = get_u16be(header + 0x06); /* not including this header */
+    /* 0x08(8): null */
+
+    for (i = 0; i < MTA2_MAX_TRACK_CHANNELS; i++) {
+        if ((channel_layout >> i) & 0x01)
+            track_channels++;
     }
-    while (1);
+    return track_channels;
+}
 
-    /* parse stuff */
-    read_streamfile(frame + 0x10, stream->offset + 0x10, frame_size, stream->streamfile); /* ignore EOF errors */
-    track_channel = channel % track_channels;
-    channel_block_samples = (0x80*2);
-    channel_first_sample = first_sample % (0x80*2);
+/* decodes a channel in a track frame (after the header), returns samples done */
+static int decode_frame(const uint8_t* frame, int track_channel, sample_t* outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do) {
+    int samples_done = 0, sample_count = 0, channel_first_sample;
+    int group, row, col;
+
+    channel_first_sample = first_sample % MTA2_BLOCK_SAMPLES;
 
     /* parse channel frame (header 0x04*4 + data 0x20*4) */
     for (group = 0; group < 4; group++) {
         short hist2, hist1, coefs, scale;
-        uint32_t group_header = get_u32be(frame + 0x10 + track_channel*0x90 + group*0x4);
+        uint32_t group_header = get_u32be(frame + track_channel*0x90 + group*0x4);
         hist2 = (short) ((group_header >> 16) & 0xfff0); /* upper 16b discarding 4b */
         hist1 = (short) ((group_header >>  4) & 0xfff0); /* lower 16b discarding 4b */
         coefs = (group_header >> 5) & 0x7; /* mid 3b */
@@ -118,7 +92,7 @@ void decode_mta2(VGMSTREAMCHANNEL *stream, sample_t *outbuf, int channelspacing,
 
         /* decode nibbles */
         for (row = 0; row < 8; row++) {
-            int pos = 0x10 + track_channel*0x90 + 0x10 + group*0x4 + row*0x10;
+            int pos = track_channel*0x90 + 0x10 + group*0x4 + row*0x10;
             for (col = 0; col < 4*2; col++) {
                 uint8_t nibbles = frame[pos + col/2];
                 int32_t sample;
@@ -145,9 +119,122 @@ void decode_mta2(VGMSTREAMCHANNEL *stream, sample_t *outbuf, int channelspacing,
         }
     }
 
+    return samples_done;
+}
+
+/* decodes a block for a channel, reading and skipping track headers from its offset */
+static void decode_mta2_channel(VGMSTREAMCHANNEL *stream, sample_t *outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do, int channel) {
+    uint8_t frame[0x10 + 0x90*8] = {0};
+    int samples_done, frame_size = 0;
+    int i;
+    int track_channels = 0, track_channel;
+
+
+    /* track skip */
+    do {
+        int num_track = 0;
+
+        /* parse track header (0x10) and skip tracks that our current channel doesn't belong to */
+        read_streamfile(frame, stream->offset, 0x10, stream->streamfile); /* ignore EOF errors */
+        track_channels = parse_track_header(frame, &num_track, &frame_size);
+
+        VGM_ASSERT(frame_size == 0, "MTA2: empty frame at %x\n", (uint32_t)stream->offset);
+        /* frame_size 0 means silent/empty frame (rarely found near EOF for one track but not others)
+         * negative track only happens for truncated files (EOF) */
+        if (frame_size == 0 || num_track < 0) {
+            for (i = 0; i < samples_to_do; i++)
+                outbuf[i * channelspacing] = 0;
+            stream->offset += 0x10;
+            return;
+        }
+
+        if (track_channels == 0) { /* bad data, avoid div by 0 */
+            VGM_LOG("MTA2: track_channels 0 at %x\n", (uint32_t)stream->offset);
+            return;
+        }
+
+        /* assumes tracks channels are divided evenly in all tracks (ex. not 2ch + 1ch + 1ch) */
+        if (channel / track_channels == num_track)
+            break; /* channel belongs to this track */
+
+        /* keep looping for our track */
+        stream->offset += 0x10 + frame_size;
+    }
+    while (1);
+
+    /* parse stuff (bad sizes past max channels would overflow) */
+    read_streamfile(frame + 0x10, stream->offset + 0x10, frame_size > 0x90*8 ? 0x90*8 : frame_size, stream->streamfile); /* ignore EOF errors */
+    track_channel = channel % track_channels;
+
+    samples_done = decode_frame(frame + 0x10, track_channel, outbuf, channelspacing, first_sample, samples_to_do);
 
     /* block fully done */
-    if (channel_first_sample + samples_done == channel_block_samples)  {
+    if (first_sample % MTA2_BLOCK_SAMPLES + samples_done == MTA2_BLOCK_SAMPLES)  {
         stream->offset += 0x10 + frame_size;
     }
 }
+
+/* Decodes a block for all channels. Channels advance through tracks on their own (each skips other
+ * tracks' frames), but are always within a couple of frame groups, so all headers and frames are read
+ * at once and parsed from memory. Anything unusual (EOF, silent frames) goes through the per-channel path. */
+void decode_mta2(VGMSTREAM* vgmstream, sample_t* outbuf, int32_t first_sample, int32_t samples_to_do) {
+    uint8_t buf[0x2000];
+    STREAMFILE* sf = vgmstream->ch[0].streamfile;
+    int channels = vgmstream->channels;
+    off_t base_offset = vgmstream->ch[0].offset;
+    size_t span, bytes;
+    int ch;
+
+    for (ch = 1; ch < channels; ch++) {
+        if (vgmstream->ch[ch].streamfile != sf)
+            break;
+        if (vgmstream->ch[ch].offset < base_offset)
+            base_offset = vgmstream->ch[ch].offset;
+    }
+
+    /* a frame group per channel offset (channels are at most one group apart) */
+    span = 2 * (MTA2_MAX_TRACKS * MTA2_TRACK_HEADER_SIZE + channels * MTA2_CHANNEL_FRAME_SIZE);
+    if (span > sizeof(buf) || ch < channels)
+        span = 0;
+
+    bytes = span ? read_streamfile(buf, base_offset, span, sf) : 0;
+    if (bytes < span)
+        span = bytes; /* EOF handled per channel below */
+
+    for (ch = 0; ch < channels; ch++) {
+        VGMSTREAMCHANNEL* stream = &vgmstream->ch[ch];
+        sample_t* ch_outbuf = outbuf + ch;
+        off_t offset = stream->offset;
+        int num_track, frame_size, track_channels, samples_done;
+        size_t pos;
+
+        /* same skip as decode_mta2_channel (without silent/bad frames) */
+        do {
+            pos = offset - base_offset;
+            if (pos + MTA2_TRACK_HEADER_SIZE > span)
+                break;
+
+            track_channels = parse_track_header(buf + pos, &num_track, &frame_size);
+            if (frame_size == 0 || track_channels == 0)
+                break;
+            if (ch / track_channels == num_track)
+                break;
+
+            offset += MTA2_TRACK_HEADER_SIZE + frame_size;
+        }
+        while (1);
+
+        if (pos + MTA2_TRACK_HEADER_SIZE > span || frame_size == 0 || track_channels == 0 ||
+                pos + MTA2_TRACK_HEADER_SIZE + frame_size > span ||
+                frame_size < track_channels * MTA2_CHANNEL_FRAME_SIZE) {
+            decode_mta2_channel(stream, ch_outbuf, channels, first_sample, samples_to_do, ch);
+            continue;
+        }
+
+        samples_done = decode_frame(buf + pos + MTA2_TRACK_HEADER_SIZE, ch % track_channels, ch_outbuf, channels, first_sample, samples_to_do);
+
+        stream->offset = offset;
+        if (first_sample % MTA2_BLOCK_SAMPLES + samples_done == MTA2_BLOCK_SAMPLES)
+            stream->offset += MTA2_TRACK_HEADER_SIZE + frame_size;
+    }
+}
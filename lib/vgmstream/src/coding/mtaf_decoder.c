@@ -1,5 +1,6 @@
 #include "coding.h"
 #include "../util.h"
+#include "frame_walk.h"
 
 
 /* A hybrid of IMA and Yamaha ADPCM found in Metal Gear Solid 3
@@ -82,52 +83,50 @@ static const int16_t mtaf_step_sizes[32][16] = {
 
 
 void decode_mtaf(VGMSTREAMCHANNEL *stream, sample_t *outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do, int channel) {
-    uint8_t frame[0x110] = {0};
-    off_t frame_offset;
+    frame_walk_t fw;
     int i, ch, sample_count = 0;
-    size_t bytes_per_frame /*, samples_per_frame*/;
+    size_t bytes_per_frame, samples_per_frame;
     int32_t hist = stream->adpcm_history1_16;
     int32_t step_index = stream->adpcm_step_index;
 
 
     /* special stereo interleave, stereo */
     bytes_per_frame = 0x10 + 0x80*2;
-    //samples_per_frame = (bytes_per_frame - 0x10) / 2 * 2; /* 256 */
+    samples_per_frame = (bytes_per_frame - 0x10) / 2 * 2; /* 256 */
     ch = channel % 2; /* global channel to track channel */
-    //first_sample = first_sample % samples_per_frame; /* for flat layout */
 
-    /* read frame */
-    frame_offset = stream->offset;
-    read_streamfile(frame, frame_offset, bytes_per_frame, stream->streamfile); /* ignore EOF errors */
+    FRAME_WALK(&fw, stream->streamfile, stream->offset, bytes_per_frame, samples_per_frame, first_sample, samples_to_do) {
+        const uint8_t* frame = fw.frame;
 
-    /* parse frame header when we hit a new track every frame samples */
-    if (first_sample == 0) {
-        /*  0x10 header: track (8b, 0=first), track count (24b, 1=first), step-L, step-R, hist-L, hist-R */
-        step_index = get_s16le(frame + 0x04 + 0x00 + ch*0x02); /* step-L/R */
-        hist       = get_s16le(frame + 0x04 + 0x04 + ch*0x04); /* hist-L/R: hist 16bit + empty 16bit */
+        /* parse frame header when we hit a new track every frame samples */
+        if (fw.first == 0) {
+            /*  0x10 header: track (8b, 0=first), track count (24b, 1=first), step-L, step-R, hist-L, hist-R */
+            step_index = get_s16le(frame + 0x04 + 0x00 + ch*0x02); /* step-L/R */
+            hist       = get_s16le(frame + 0x04 + 0x04 + ch*0x04); /* hist-L/R: hist 16bit + empty 16bit */
 
-        VGM_ASSERT(step_index < 0 || step_index > 31, "MTAF: bad header idx at 0x%x\n", (uint32_t)stream->offset);
-        if (step_index < 0) {
-            step_index = 0;
-        } else if (step_index > 31) {
-            step_index = 31;
+            VGM_ASSERT(step_index < 0 || step_index > 31, "MTAF: bad header idx at 0x%x\n", (uint32_t)fw.offset);
+            if (step_index < 0) {
+                step_index = 0;
+            } else if (step_index > 31) {
+                step_index = 31;
+            }
         }
-    }
 
-    /* decode nibbles */
-    for (i = first_sample; i < first_sample + samples_to_do; i++) {
-        uint8_t nibbles = frame[0x10 + 0x80*ch + i/2];
-        uint8_t nibble = (nibbles >> (!(i&1)?0:4)) & 0xf; /* lower first */
+        /* decode nibbles */
+        for (i = fw.first; i < fw.first + fw.count; i++) {
+            uint8_t nibbles = frame[0x10 + 0x80*ch + i/2];
+            uint8_t nibble = (nibbles >> (!(i&1)?0:4)) & 0xf; /* lower first */
 
-        hist = clamp16(hist + mtaf_step_sizes[step_index][nibble]);
-        outbuf[sample_count] = hist;
-        sample_count += channelspacing;
+            hist = clamp16(hist + mtaf_step_sizes[step_index][nibble]);
+            outbuf[sample_count] = hist;
+            sample_count += channelspacing;
 
-        step_index += mtaf_step_indexes[nibble];
-        if (step_index < 0) {
-            step_index = 0;
-        } else if (step_index > 31) {
-            step_index = 31;
+            step_index += mtaf_step_indexes[nibble];
+            if (step_index < 0) {
+                step_index = 0;
+            } else if (step_index > 31) {
+                step_index = 31;
+            }
         }
     }
 
@@ -2,10 +2,11 @@
 #include "../util.h"
 
 
-void decode_ngc_dsp(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do) {
-    uint8_t frame[0x08] = {0};
+DECODE_INLINE void decode_ngc_dsp_spaced(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do) {
+    uint8_t frame_buf[0x08];
+    const uint8_t* frame;
     off_t frame_offset;
-    int i, frames_in, sample_count = 0;
+    int i, frames_in, sample_count = 0, samples_done = 0;
     size_t bytes_per_frame, samples_per_frame;
     int coef_index, scale, coef1, coef2;
     int32_t hist1 = stream->adpcm_history1_16;
@@ -18,43 +19,63 @@ void decode_ngc_dsp(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspa
     frames_in = first_sample / samples_per_frame;
     first_sample = first_sample % samples_per_frame;
 
-    /* parse frame header */
-    frame_offset = stream->offset + bytes_per_frame * frames_in;
-    read_streamfile(frame, frame_offset, bytes_per_frame, stream->streamfile); /* ignore EOF errors */
-    scale = 1 << ((frame[0] >> 0) & 0xf);
-    coef_index  = (frame[0] >> 4) & 0xf;
+    /* may be called with many consecutive frames */
+    while (samples_done < samples_to_do) {
+        int frame_samples = samples_per_frame - first_sample;
+        if (frame_samples > samples_to_do - samples_done)
+            frame_samples = samples_to_do - samples_done;
 
-    VGM_ASSERT_ONCE(coef_index > 8, "DSP: incorrect coefs at %x\n", (uint32_t)frame_offset);
-    //if (coef_index > 8) //todo not correctly clamped in original decoder?
-    //    coef_index = 8;
+        /* parse frame header */
+        frame_offset = stream->offset + bytes_per_frame * frames_in;
+        memset(frame_buf, 0, sizeof(frame_buf));
+        frame = read_streamfile_ptr(frame_buf, frame_offset, bytes_per_frame, stream->streamfile); /* ignore EOF errors */
+        scale = 1 << ((frame[0] >> 0) & 0xf);
+        coef_index  = (frame[0] >> 4) & 0xf;
 
-    coef1 = stream->adpcm_coef[coef_index*2 + 0];
-    coef2 = stream->adpcm_coef[coef_index*2 + 1];
+        VGM_ASSERT_ONCE(coef_index > 8, "DSP: incorrect coefs at %x\n", (uint32_t)frame_offset);
+        //if (coef_index > 8) //todo not correctly clamped in original decoder?
+        //    coef_index = 8;
 
+        coef1 = stream->adpcm_coef[coef_index*2 + 0];
+        coef2 = stream->adpcm_coef[coef_index*2 + 1];
 
-    /* decode nibbles */
-    for (i = first_sample; i < first_sample + samples_to_do; i++) {
-        int32_t sample = 0;
-        uint8_t nibbles = frame[0x01 + i/2];
 
-        sample = i&1 ? /* high nibble first */
-                get_low_nibble_signed(nibbles) :
-                get_high_nibble_signed(nibbles);
-        sample = ((sample * scale) << 11);
-        sample = (sample + 1024 + coef1*hist1 + coef2*hist2) >> 11;
-        sample = clamp16(sample);
+        /* decode nibbles */
+        for (i = first_sample; i < first_sample + frame_samples; i++) {
+            int32_t sample = 0;
+            uint8_t nibbles = frame[0x01 + i/2];
 
-        outbuf[sample_count] = sample;
-        sample_count += channelspacing;
+            sample = i&1 ? /* high nibble first */
+                    get_low_nibble_signed(nibbles) :
+                    get_high_nibble_signed(nibbles);
+            sample = ((sample * scale) << 11);
+            sample = (sample + 1024 + coef1*hist1 + coef2*hist2) >> 11;
+            sample = clamp16(sample);
 
-        hist2 = hist1;
-        hist1 = sample;
+            outbuf[sample_count] = sample;
+            sample_count += channelspacing;
+
+            hist2 = hist1;
+            hist1 = sample;
+        }
+
+        samples_done += frame_samples;
+        first_sample = 0;
+        frames_in++;
     }
 
     stream->adpcm_history1_16 = hist1;
     stream->adpcm_history2_16 = hist2;
 }
 
+void decode_ngc_dsp(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do) {
+    switch (channelspacing) {
+        case 1:  decode_ngc_dsp_spaced(stream, outbuf, 1, first_sample, samples_to_do); break;
+        case 2:  decode_ngc_dsp_spaced(stream, outbuf, 2, first_sample, samples_to_do); break;
+        default: decode_ngc_dsp_spaced(stream, outbuf, channelspacing, first_sample, samples_to_do); break;
+    }
+}
+
 
 /* read from memory rather than a file */
 static void decode_ngc_dsp_subint_internal(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do, uint8_t * frame) {
@@ -1,5 +1,6 @@
 #include "coding.h"
 #include "../util.h"
+#include "frame_walk.h"
 
 
 /* standard XA coefs << 6 */
@@ -13,11 +14,11 @@ static const int8_t dtk_coefs[16][2] = {
 
 /* Nintendo GC Disc TracK streaming ADPCM (similar to XA) */
 void decode_ngc_dtk(VGMSTREAMCHANNEL *stream, sample_t *outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do, int channel) {
-    uint8_t frame[0x20] = {0};
-    off_t frame_offset;
-    int i, frames_in, sample_count = 0;
+    frame_walk_t fw;
+    int i, sample_count = 0;
     size_t bytes_per_frame, samples_per_frame;
-    int index, shift, coef1, coef2;
+    int index, shift, coef1, coef2, nibble_shift;
+    const int16_t* scales;
     int32_t hist1 = stream->adpcm_history1_32;
     int32_t hist2 = stream->adpcm_history2_32;
 
@@ -25,39 +26,37 @@ void decode_ngc_dtk(VGMSTREAMCHANNEL *stream, sample_t *outbuf, int channelspaci
     /* external interleave (fixed size), stereo */
     bytes_per_frame = 0x20;
     samples_per_frame = (0x20 - 0x04); /* 28 for each channel */
-    frames_in = first_sample / samples_per_frame;
-    first_sample = first_sample % samples_per_frame;
+    nibble_shift = (channel==0) ? 0 : 4; /* L=low nibble first */
 
-    /* parse frame L/R header (repeated at 0x03/04) */
-    frame_offset = stream->offset + bytes_per_frame * frames_in;
-    read_streamfile(frame, frame_offset, bytes_per_frame, stream->streamfile); /* ignore EOF errors */
-    index = (frame[channel] >> 4) & 0xf;
-    shift = (frame[channel] >> 0) & 0xf;
-    coef1 = dtk_coefs[index][0];
-    coef2 = dtk_coefs[index][1];
-    /* rare but happens, also repeated headers don't match (ex. Ikaruga (GC) SONG02.adp) */
-    VGM_ASSERT_ONCE(index > 4 || shift > 12, "DTK: incorrect coefs/shift at %x\n", (uint32_t)frame_offset);
+    FRAME_WALK(&fw, stream->streamfile, stream->offset, bytes_per_frame, samples_per_frame, first_sample, samples_to_do) {
+        const uint8_t* frame = fw.frame;
 
-    /* decode nibbles */
-    for (i = first_sample; i < first_sample + samples_to_do; i++) {
-        int sample, hist;
-        uint8_t nibbles = frame[0x04 + i];
+        /* parse frame L/R header (repeated at 0x03/04) */
+        index = (frame[channel] >> 4) & 0xf;
+        shift = (frame[channel] >> 0) & 0xf;
+        coef1 = dtk_coefs[index][0];
+        coef2 = dtk_coefs[index][1];
+        scales = nibble_shift_table[shift];
+        /* rare but happens, also repeated headers don't match (ex. Ikaruga (GC) SONG02.adp) */
+        VGM_ASSERT_ONCE(index > 4 || shift > 12, "DTK: incorrect coefs/shift at %x\n", (uint32_t)fw.offset);
 
-        hist = (hist1*coef1 - hist2*coef2 + 32) >> 6;
-        if (hist > 2097151) hist = 2097151;
-        else if (hist < -2097152) hist = -2097152;
+        /* decode nibbles */
+        for (i = fw.first; i < fw.first + fw.count; i++) {
+            int sample, hist;
 
-        sample = (channel==0) ? /* L=low nibble first */
-                get_low_nibble_signed(nibbles) :
-                get_high_nibble_signed(nibbles);
-        sample = (sample << 12) >> shift;
-        sample = (sample << 6) + hist;
+            hist = (hist1*coef1 - hist2*coef2 + 32) >> 6;
+            if (hist > 2097151) hist = 2097151;
+            else if (hist < -2097152) hist = -2097152;
 
-        hist2 = hist1;
-        hist1 = sample; /* clamp *after* this so hist goes pretty high */
+            sample = scales[(frame[0x04 + i] >> nibble_shift) & 0xf]; /* 16b sign extend + scale */
+            sample = (sample << 6) + hist;
 
-        outbuf[sample_count] = clamp16(sample >> 6);
-        sample_count += channelspacing;
+            hist2 = hist1;
+            hist1 = sample; /* clamp *after* this so hist goes pretty high */
+
+            outbuf[sample_count] = clamp16(sample >> 6);
+            sample_count += channelspacing;
+        }
     }
 
     stream->adpcm_history1_32 = hist1;
@@ -33,9 +33,9 @@
 #include <stdlib.h>
 #include "nwa_decoder.h"
 
-/* can serve up 8 bits at a time */
+/* can serve up 8 bits at a time (from the block's buffer, 0 past its end like a short read) */
 static int
-getbits (STREAMFILE *file, off_t *offset, int *shift, int bits)
+getbits (const uint8_t *buf, int buf_size, int *offset, int *shift, int bits)
 {
 	int ret;
     if (*shift > 8)
@@ -43,7 +43,10 @@ getbits (STREAMFILE *file, off_t *offset, int *shift, int bits)
         ++*offset;
         *shift -= 8;
     }
-    ret = read_16bitLE(*offset,file) >> *shift;
+    if (*offset + 2 > buf_size)
+        ret = (*offset < buf_size ? buf[*offset] : 0) >> *shift;
+    else
+        ret = get_16bitLE(buf + *offset) >> *shift;
     *shift += bits;
     return ret & ((1 << bits) - 1);	/* mask */
 }
@@ -69,6 +72,8 @@ open_nwa (STREAMFILE * streamFile, const char *filename)
     nwa->buffer = NULL;
     nwa->buffer_readpos = NULL;
     nwa->file = NULL;
+    nwa->block_buf = NULL;
+    nwa->block_buf_size = 0;
 
     /* PCM not handled here */
     if (nwa->complevel < 0 || nwa->complevel > 5) goto fail;
@@ -136,6 +141,8 @@ close_nwa(NWAData * nwa)
     if (nwa->buffer)
         free (nwa->buffer);
     nwa->buffer = NULL;
+    free(nwa->block_buf);
+    nwa->block_buf = NULL;
     if (nwa->file)
         close_streamfile (nwa->file);
     nwa->file = NULL;
@@ -165,6 +172,25 @@ static int use_runlength(NWAData *nwa)
     return 0;
 }
 
+/* reads the current block's compressed data in one go, rather than a few bits per read */
+static int
+nwa_read_block(NWAData *nwa)
+{
+    off_t offset = nwa->offsets[nwa->curblock];
+    off_t next = nwa->curblock + 1 < nwa->blocks ? nwa->offsets[nwa->curblock + 1] : nwa->compdatasize;
+    int size = next > offset ? (int)(next - offset) : 0;
+
+    if (size > nwa->block_buf_size)
+    {
+        uint8_t *buf = realloc(nwa->block_buf, size);
+        if (!buf) return 0;
+        nwa->block_buf = buf;
+        nwa->block_buf_size = size;
+    }
+
+    return read_streamfile(nwa->block_buf, offset, size, nwa->file);
+}
+
 static void
 nwa_decode_block(NWAData *nwa)
 {
@@ -188,18 +214,20 @@ nwa_decode_block(NWAData *nwa)
         sample d[2];
         int i;
         int shift = 0;
-        off_t offset = nwa->offsets[nwa->curblock];
+        int offset = 0;
         int dsize = curblocksize / (nwa->bps / 8);
         int flip_flag = 0;			/* stereo 用 */
         int runlength = 0;
+        int buf_size = nwa_read_block(nwa);
+        const uint8_t *buf = nwa->block_buf;
 
         /* read initial sample value */
         for (i=0;i<nwa->channels;i++)
         {
-            if (nwa->bps == 8) { d[i] = read_8bit(offset,nwa->file); }
+            if (nwa->bps == 8) { d[i] = offset < buf_size ? (int8_t)buf[offset] : 0; }
             else							/* bps == 16 */
             {
-                d[i] = read_16bitLE(offset,nwa->file);
+                d[i] = offset + 2 <= buf_size ? get_16bitLE(buf + offset) : 0;
                 offset += 2;
             }
         }
@@ -208,13 +236,13 @@ nwa_decode_block(NWAData *nwa)
         {
             if (runlength == 0)
             {						/* コピーループ中でないならデータ読み込み */
-                int type = getbits(nwa->file, &offset, &shift, 3);
+                int type = getbits(buf, buf_size, &offset, &shift, 3);
                 /* type により分岐：0, 1-6, 7 */
                 if (type == 7)
                 {
                     /* 7 : 大きな差分 */
                     /* RunLength() 有効時（CompLevel==5, 音声ファイル) では無効 */
-                    if (getbits(nwa->file, &offset, &shift, 1) == 1)
+                    if (getbits(buf, buf_size, &offset, &shift, 1) == 1)
                     {
                         d[flip_flag] = 0;	/* 未使用 */
                     }
@@ -234,7 +262,7 @@ nwa_decode_block(NWAData *nwa)
 						{
 							const int MASK1 = (1 << (BITS - 1));
 							const int MASK2 = (1 << (BITS - 1)) - 1;
-							int b = getbits(nwa->file, &offset, &shift, BITS);
+							int b = getbits(buf, buf_size, &offset, &shift, BITS);
 							if (b & MASK1)
 								d[flip_flag] -= (b & MASK2) << SHIFT;
 							else
@@ -259,7 +287,7 @@ nwa_decode_block(NWAData *nwa)
 					{
 						const int MASK1 = (1 << (BITS - 1));
 						const int MASK2 = (1 << (BITS - 1)) - 1;
-						int b = getbits(nwa->file, &offset, &shift, BITS);
+						int b = getbits(buf, buf_size, &offset, &shift, BITS);
 						if (b & MASK1)
 							d[flip_flag] -= (b & MASK2) << SHIFT;
 						else
@@ -272,13 +300,13 @@ nwa_decode_block(NWAData *nwa)
                     if (use_runlength(nwa))
                     {
                         /* ランレングス圧縮ありの場合 */
-                        runlength = getbits(nwa->file, &offset, &shift, 1);
+                        runlength = getbits(buf, buf_size, &offset, &shift, 1);
                         if (runlength == 1)
                         {
-                            runlength = getbits(nwa->file, &offset, &shift, 2);
+                            runlength = getbits(buf, buf_size, &offset, &shift, 2);
                             if (runlength == 3)
                             {
-                                runlength = getbits(nwa->file, &offset, &shift, 8);
+                                runlength = getbits(buf, buf_size, &offset, &shift, 8);
                             }
                         }
                     }
@@ -57,6 +57,10 @@ typedef struct NWAData_s
     sample *buffer;
     sample *buffer_readpos;
     int samples_in_buffer;
+
+    /* compressed data of the current block, read at once */
+    uint8_t *block_buf;
+    int block_buf_size;
 } NWAData;
 
 NWAData *open_nwa(STREAMFILE *streamFile, const char *filename);
@@ -1,4 +1,5 @@
 #include "coding.h"
+#include "frame_walk.h"
 
 
 static const int step_sizes[49] = { /* OKI table (subsection of IMA's table) */
@@ -17,10 +18,10 @@ static const int stex_indexes[16] = { /* OKI table (also from IMA) */
 };
 
 
-static void pcfx_expand_nibble(VGMSTREAMCHANNEL * stream, off_t byte_offset, int nibble_shift, int32_t * hist1, int32_t * step_index, int16_t *out_sample, int mode) {
+static void pcfx_expand_nibble(uint8_t byte, int nibble_shift, int32_t * hist1, int32_t * step_index, int16_t *out_sample, int mode) {
     int code, step, delta;
 
-    code = (read_8bit(byte_offset,stream->streamfile) >> nibble_shift) & 0xf;
+    code = (byte >> nibble_shift) & 0xf;
     step = step_sizes[*step_index];
 
     delta = (code & 0x7);
@@ -57,10 +58,10 @@ static void pcfx_expand_nibble(VGMSTREAMCHANNEL * stream, off_t byte_offset, int
     }
 }
 
-static void oki16_expand_nibble(VGMSTREAMCHANNEL * stream, off_t byte_offset, int nibble_shift, int32_t * hist1, int32_t * step_index, int16_t *out_sample) {
+static void oki16_expand_nibble(uint8_t byte, int nibble_shift, int32_t * hist1, int32_t * step_index, int16_t *out_sample) {
     int code, step, delta;
 
-    code = (read_8bit(byte_offset,stream->streamfile) >> nibble_shift) & 0xf;
+    code = (byte >> nibble_shift) & 0xf;
     step = step_sizes[*step_index];
 
     /* IMA 'mul' style (standard OKI uses 'shift-add') */
@@ -79,10 +80,10 @@ static void oki16_expand_nibble(VGMSTREAMCHANNEL * stream, off_t byte_offset, in
     *out_sample = *hist1;
 }
 
-static void oki4s_expand_nibble(VGMSTREAMCHANNEL * stream, off_t byte_offset, int nibble_shift, int32_t * hist1, int32_t * step_index, int16_t *out_sample) {
+static void oki4s_expand_nibble(uint8_t byte, int nibble_shift, int32_t * hist1, int32_t * step_index, int16_t *out_sample) {
     int code, step, delta;
 
-    code = (read_8bit(byte_offset,stream->streamfile) >> nibble_shift) & 0xf;
+    code = (byte >> nibble_shift) & 0xf;
     step = step_sizes[*step_index];
 
     step = step << 4; /* original table has precomputed step_sizes so that this isn't done */
@@ -117,18 +118,21 @@ static void oki4s_expand_nibble(VGMSTREAMCHANNEL * stream, off_t byte_offset, in
  * base_value is approximately ~31468.5 (follows hardware clocks), mono or interleaved for stereo.
  */
 void decode_pcfx(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do, int mode) {
+    frame_walk_t fw;
     int i, sample_count = 0;
     int32_t hist1 = stream->adpcm_history1_32;
     int step_index = stream->adpcm_step_index;
     int16_t out_sample;
 
-    for (i = first_sample; i < first_sample + samples_to_do; i++) {
-        off_t byte_offset = stream->offset + i/2;
-        int nibble_shift = (i&1?4:0); /* low nibble first */
+    /* no frames, nibbles read in chunks (0xFF past EOF, as read_8bit gave) */
+    FRAME_WALK_PADDED(&fw, stream->streamfile, stream->offset, FRAME_WALK_MAX_BYTES, FRAME_WALK_MAX_BYTES * 2, first_sample, samples_to_do, 0xFF) {
+        for (i = fw.first; i < fw.first + fw.count; i++) {
+            int nibble_shift = (i&1?4:0); /* low nibble first */
 
-        pcfx_expand_nibble(stream, byte_offset,nibble_shift, &hist1, &step_index, &out_sample, mode);
-        outbuf[sample_count] = out_sample;
-        sample_count += channelspacing;
+            pcfx_expand_nibble(fw.frame[i/2], nibble_shift, &hist1, &step_index, &out_sample, mode);
+            outbuf[sample_count] = out_sample;
+            sample_count += channelspacing;
+        }
     }
 
     stream->adpcm_history1_32 = hist1;
@@ -138,7 +142,8 @@ void decode_pcfx(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacin
 /* OKI variation with 16-bit output (vs standard's 12-bit), found in FrontWing's PS2 games (Sweet Legacy, Hooligan).
  * Reverse engineered from the ELF with help from the folks at hcs. */
 void decode_oki16(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do, int channel) {
-    int i, sample_count = 0;
+    frame_walk_t fw;
+    int i, sample_count = 0, samples_per_chunk;
     int32_t hist1 = stream->adpcm_history1_32;
     int step_index = stream->adpcm_step_index;
     int16_t out_sample;
@@ -151,16 +156,19 @@ void decode_oki16(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspaci
     if (step_index < 0) step_index=0;
     if (step_index > 48) step_index=48;
 
-    /* decode nibbles (layout: varies) */
-    for (i = first_sample; i < first_sample + samples_to_do; i++, sample_count += channelspacing) {
-        off_t byte_offset = is_stereo ?
-                stream->offset + i :    /* stereo: one nibble per channel */
-                stream->offset + i/2;   /* mono: consecutive nibbles (assumed) */
-        int nibble_shift =
-                is_stereo ? (!(channel&1) ? 0:4) : (!(i&1) ? 0:4);  /* even = low, odd = high */
-
-        oki16_expand_nibble(stream, byte_offset,nibble_shift, &hist1, &step_index, &out_sample);
-        outbuf[sample_count] = (out_sample);
+    /* decode nibbles (layout: varies), no frames so read in chunks (0xFF past EOF, as read_8bit gave) */
+    samples_per_chunk = is_stereo ?
+            FRAME_WALK_MAX_BYTES :      /* stereo: one nibble per channel */
+            FRAME_WALK_MAX_BYTES * 2;   /* mono: consecutive nibbles (assumed) */
+    FRAME_WALK_PADDED(&fw, stream->streamfile, stream->offset, FRAME_WALK_MAX_BYTES, samples_per_chunk, first_sample, samples_to_do, 0xFF) {
+        for (i = fw.first; i < fw.first + fw.count; i++, sample_count += channelspacing) {
+            uint8_t byte = is_stereo ? fw.frame[i] : fw.frame[i/2];
+            int nibble_shift =
+                    is_stereo ? (!(channel&1) ? 0:4) : (!(i&1) ? 0:4);  /* even = low, odd = high */
+
+            oki16_expand_nibble(byte, nibble_shift, &hist1, &step_index, &out_sample);
+            outbuf[sample_count] = (out_sample);
+        }
     }
 
     stream->adpcm_history1_32 = hist1;
@@ -170,7 +178,8 @@ void decode_oki16(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspaci
 /* OKI variation with 16-bit output (vs standard's 12-bit) and pre-adjusted tables (shifted by 4), found in Jubeat Clan (AC).
  * Reverse engineered from the DLLs. */
 void decode_oki4s(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do, int channel) {
-    int i, sample_count = 0;
+    frame_walk_t fw;
+    int i, sample_count = 0, samples_per_chunk;
     int32_t hist1 = stream->adpcm_history1_32;
     int step_index = stream->adpcm_step_index;
     int16_t out_sample;
@@ -183,16 +192,19 @@ void decode_oki4s(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspaci
     if (step_index < 0) step_index=0;
     if (step_index > 48) step_index=48;
 
-    /* decode nibbles (layout: varies) */
-    for (i = first_sample; i < first_sample + samples_to_do; i++, sample_count += channelspacing) {
-        off_t byte_offset = is_stereo ?
-                stream->offset + i :    /* stereo: one nibble per channel */
-                stream->offset + i/2;   /* mono: consecutive nibbles (assumed) */
-        int nibble_shift =
-                is_stereo ? (!(channel&1) ? 0:4) : (!(i&1) ? 0:4);  /* even = low, odd = high */
-
-        oki4s_expand_nibble(stream, byte_offset,nibble_shift, &hist1, &step_index, &out_sample);
-        outbuf[sample_count] = (out_sample);
+    /* decode nibbles (layout: varies), no frames so read in chunks (0xFF past EOF, as read_8bit gave) */
+    samples_per_chunk = is_stereo ?
+            FRAME_WALK_MAX_BYTES :      /* stereo: one nibble per channel */
+            FRAME_WALK_MAX_BYTES * 2;   /* mono: consecutive nibbles (assumed) */
+    FRAME_WALK_PADDED(&fw, stream->streamfile, stream->offset, FRAME_WALK_MAX_BYTES, samples_per_chunk, first_sample, samples_to_do, 0xFF) {
+        for (i = fw.first; i < fw.first + fw.count; i++, sample_count += channelspacing) {
+            uint8_t byte = is_stereo ? fw.frame[i] : fw.frame[i/2];
+            int nibble_shift =
+                    is_stereo ? (!(channel&1) ? 0:4) : (!(i&1) ? 0:4);  /* even = low, odd = high */
+
+            oki4s_expand_nibble(byte, nibble_shift, &hist1, &step_index, &out_sample);
+            outbuf[sample_count] = (out_sample);
+        }
     }
 
     stream->adpcm_history1_32 = hist1;
@@ -2,79 +2,157 @@
 #include "../util.h"
 #include <math.h>
 
-void decode_pcm16le(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do) {
-    int i;
-    int32_t sample_count;
 
-    for (i=first_sample,sample_count=0; i<first_sample+samples_to_do; i++,sample_count+=channelspacing) {
-        outbuf[sample_count]=read_16bitLE(stream->offset+i*2,stream->streamfile);
+/* PCM has no frames so decoders may be asked for many samples at once, read them in big chunks
+ * rather than one streamfile call per sample. Returns how many samples (of size bytes, every step
+ * bytes from sample N) are in data. Like read_16bit/etc samples past or cut by EOF are all 0xFF. */
+static int read_pcm_chunk(const uint8_t** p_data, uint8_t* buf, size_t buf_size, VGMSTREAMCHANNEL* stream, int32_t sample, int32_t samples_left, int step, int size) {
+    int samples = buf_size / step;
+    off_t offset = stream->offset + sample * step;
+    size_t bytes, file_size;
+
+    if (samples <= 0)
+        samples = 1; /* shouldn't happen */
+    if (samples > samples_left)
+        samples = samples_left;
+    bytes = samples * step;
+    if (bytes > buf_size)
+        bytes = buf_size;
+
+    memset(buf, 0xFF, bytes);
+
+    file_size = get_streamfile_size(stream->streamfile);
+    if (offset + bytes > file_size) {
+        size_t valid = offset < file_size ? file_size - offset : 0;
+        size_t cut = valid % step;
+
+        read_streamfile(buf, offset, valid, stream->streamfile);
+        if (cut > 0 && cut < size)
+            memset(buf + valid - cut, 0xFF, cut);
+        *p_data = buf;
     }
+    else {
+        *p_data = read_streamfile_ptr(buf, offset, bytes, stream->streamfile);
+    }
+    return samples;
 }
 
-void decode_pcm16be(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do) {
-    int i;
-    int32_t sample_count;
+#define PCM_CHUNK_SIZE 0x1000
 
-    for (i=first_sample,sample_count=0; i<first_sample+samples_to_do; i++,sample_count+=channelspacing) {
-        outbuf[sample_count]=read_16bitBE(stream->offset+i*2,stream->streamfile);
+void decode_pcm16le(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do) {
+    uint8_t buf[PCM_CHUNK_SIZE];
+    const uint8_t* data;
+    int i, j, samples, sample_count = 0;
+
+    for (i = first_sample; i < first_sample + samples_to_do; i += samples) {
+        samples = read_pcm_chunk(&data, buf, sizeof(buf), stream, i, first_sample + samples_to_do - i, 0x02, 0x02);
+        for (j = 0; j < samples; j++) {
+            outbuf[sample_count] = get_s16le(data + j*0x02);
+            sample_count += channelspacing;
+        }
     }
 }
 
-void decode_pcm16_int(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do, int big_endian) {
-    int i, sample_count;
-    int16_t (*read_16bit)(off_t,STREAMFILE*) = big_endian ? read_16bitBE : read_16bitLE;
+void decode_pcm16be(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do) {
+    uint8_t buf[PCM_CHUNK_SIZE];
+    const uint8_t* data;
+    int i, j, samples, sample_count = 0;
+
+    for (i = first_sample; i < first_sample + samples_to_do; i += samples) {
+        samples = read_pcm_chunk(&data, buf, sizeof(buf), stream, i, first_sample + samples_to_do - i, 0x02, 0x02);
+        for (j = 0; j < samples; j++) {
+            outbuf[sample_count] = get_s16be(data + j*0x02);
+            sample_count += channelspacing;
+        }
+    }
+}
 
-    for (i=first_sample,sample_count=0; i<first_sample+samples_to_do; i++,sample_count+=channelspacing) {
-        outbuf[sample_count]=read_16bit(stream->offset+i*2*channelspacing,stream->streamfile);
+void decode_pcm16_int(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do, int big_endian) {
+    uint8_t buf[PCM_CHUNK_SIZE];
+    const uint8_t* data;
+    int i, j, samples, sample_count = 0;
+    int16_t (*get_16bit)(const uint8_t*) = big_endian ? get_s16be : get_s16le;
+
+    for (i = first_sample; i < first_sample + samples_to_do; i += samples) {
+        samples = read_pcm_chunk(&data, buf, sizeof(buf), stream, i, first_sample + samples_to_do - i, 0x02*channelspacing, 0x02);
+        for (j = 0; j < samples; j++) {
+            outbuf[sample_count] = get_16bit(data + j*0x02*channelspacing);
+            sample_count += channelspacing;
+        }
     }
 }
 
 void decode_pcm8(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do) {
-    int i;
-    int32_t sample_count;
-
-    for (i=first_sample,sample_count=0; i<first_sample+samples_to_do; i++,sample_count+=channelspacing) {
-        outbuf[sample_count]=read_8bit(stream->offset+i,stream->streamfile)*0x100;
+    uint8_t buf[PCM_CHUNK_SIZE];
+    const uint8_t* data;
+    int i, j, samples, sample_count = 0;
+
+    for (i = first_sample; i < first_sample + samples_to_do; i += samples) {
+        samples = read_pcm_chunk(&data, buf, sizeof(buf), stream, i, first_sample + samples_to_do - i, 0x01, 0x01);
+        for (j = 0; j < samples; j++) {
+            outbuf[sample_count] = get_s8(data + j)*0x100;
+            sample_count += channelspacing;
+        }
     }
 }
 
 void decode_pcm8_int(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do) {
-    int i;
-    int32_t sample_count;
-
-    for (i=first_sample,sample_count=0; i<first_sample+samples_to_do; i++,sample_count+=channelspacing) {
-        outbuf[sample_count]=read_8bit(stream->offset+i*channelspacing,stream->streamfile)*0x100;
+    uint8_t buf[PCM_CHUNK_SIZE];
+    const uint8_t* data;
+    int i, j, samples, sample_count = 0;
+
+    for (i = first_sample; i < first_sample + samples_to_do; i += samples) {
+        samples = read_pcm_chunk(&data, buf, sizeof(buf), stream, i, first_sample + samples_to_do - i, channelspacing, 0x01);
+        for (j = 0; j < samples; j++) {
+            outbuf[sample_count] = get_s8(data + j*channelspacing)*0x100;
+            sample_count += channelspacing;
+        }
     }
 }
 
 void decode_pcm8_unsigned(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do) {
-    int i;
-    int32_t sample_count;
-
-    for (i=first_sample,sample_count=0; i<first_sample+samples_to_do; i++,sample_count+=channelspacing) {
-        int16_t v = (uint8_t)read_8bit(stream->offset+i,stream->streamfile);
-        outbuf[sample_count] = v*0x100 - 0x8000;
+    uint8_t buf[PCM_CHUNK_SIZE];
+    const uint8_t* data;
+    int i, j, samples, sample_count = 0;
+
+    for (i = first_sample; i < first_sample + samples_to_do; i += samples) {
+        samples = read_pcm_chunk(&data, buf, sizeof(buf), stream, i, first_sample + samples_to_do - i, 0x01, 0x01);
+        for (j = 0; j < samples; j++) {
+            int16_t v = get_u8(data + j);
+            outbuf[sample_count] = v*0x100 - 0x8000;
+            sample_count += channelspacing;
+        }
     }
 }
 
 void decode_pcm8_unsigned_int(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do) {
-    int i;
-    int32_t sample_count;
-
-    for (i=first_sample,sample_count=0; i<first_sample+samples_to_do; i++,sample_count+=channelspacing) {
-        int16_t v = (uint8_t)read_8bit(stream->offset+i*channelspacing,stream->streamfile);
-        outbuf[sample_count] = v*0x100 - 0x8000;
+    uint8_t buf[PCM_CHUNK_SIZE];
+    const uint8_t* data;
+    int i, j, samples, sample_count = 0;
+
+    for (i = first_sample; i < first_sample + samples_to_do; i += samples) {
+        samples = read_pcm_chunk(&data, buf, sizeof(buf), stream, i, first_sample + samples_to_do - i, channelspacing, 0x01);
+        for (j = 0; j < samples; j++) {
+            int16_t v = get_u8(data + j*channelspacing);
+            outbuf[sample_count] = v*0x100 - 0x8000;
+            sample_count += channelspacing;
+        }
     }
 }
 
 void decode_pcm8_sb(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do) {
-    int i;
-    int32_t sample_count;
-
-    for (i=first_sample,sample_count=0; i<first_sample+samples_to_do; i++,sample_count+=channelspacing) {
-        int16_t v = (uint8_t)read_8bit(stream->offset+i,stream->streamfile);
-        if (v&0x80) v = 0-(v&0x7f);
-        outbuf[sample_count] = v*0x100;
+    uint8_t buf[PCM_CHUNK_SIZE];
+    const uint8_t* data;
+    int i, j, samples, sample_count = 0;
+
+    for (i = first_sample; i < first_sample + samples_to_do; i += samples) {
+        samples = read_pcm_chunk(&data, buf, sizeof(buf), stream, i, first_sample + samples_to_do - i, 0x01, 0x01);
+        for (j = 0; j < samples; j++) {
+            int16_t v = get_u8(data + j);
+            if (v&0x80) v = 0-(v&0x7f);
+            outbuf[sample_count] = v*0x100;
+            sample_count += channelspacing;
+        }
     }
 }
 
@@ -139,7 +217,7 @@ static int expand_ulaw(uint8_t ulawbyte) {
 
 #if 0   // the above follows Sun's implementation, but this works too
     {
-        static int exp_lut[8] = {0,132,396,924,1980,4092,8316,16764}; /* precalcs from bias */
+        static const int exp_lut[8] = {0,132,396,924,1980,4092,8316,16764}; /* precalcs from bias */
         new_sample = exp_lut[segment] + (quantization << (segment + 3));
         if (sign != 0) new_sample = -new_sample;
     }
@@ -150,21 +228,31 @@ static int expand_ulaw(uint8_t ulawbyte) {
 
 /* decodes u-law (ITU G.711 non-linear PCM), from g711.c */
 void decode_ulaw(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do) {
-    int i, sample_count;
-
-    for (i=first_sample,sample_count=0; i<first_sample+samples_to_do; i++,sample_count+=channelspacing) {
-        uint8_t ulawbyte = read_8bit(stream->offset+i,stream->streamfile);
-        outbuf[sample_count] = expand_ulaw(ulawbyte);
+    uint8_t buf[PCM_CHUNK_SIZE];
+    const uint8_t* data;
+    int i, j, samples, sample_count = 0;
+
+    for (i = first_sample; i < first_sample + samples_to_do; i += samples) {
+        samples = read_pcm_chunk(&data, buf, sizeof(buf), stream, i, first_sample + samples_to_do - i, 0x01, 0x01);
+        for (j = 0; j < samples; j++) {
+            outbuf[sample_count] = expand_ulaw(data[j]);
+            sample_count += channelspacing;
+        }
     }
 }
 
 
 void decode_ulaw_int(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do) {
-    int i, sample_count;
-
-    for (i=first_sample,sample_count=0; i<first_sample+samples_to_do; i++,sample_count+=channelspacing) {
-        uint8_t ulawbyte = read_8bit(stream->offset+i*channelspacing,stream->streamfile);
-        outbuf[sample_count] = expand_ulaw(ulawbyte);
+    uint8_t buf[PCM_CHUNK_SIZE];
+    const uint8_t* data;
+    int i, j, samples, sample_count = 0;
+
+    for (i = first_sample; i < first_sample + samples_to_do; i += samples) {
+        samples = read_pcm_chunk(&data, buf, sizeof(buf), stream, i, first_sample + samples_to_do - i, channelspacing, 0x01);
+        for (j = 0; j < samples; j++) {
+            outbuf[sample_count] = expand_ulaw(data[j*channelspacing]);
+            sample_count += channelspacing;
+        }
     }
 }
 
@@ -196,23 +284,40 @@ static int expand_alaw(uint8_t alawbyte) {
 
 /* decodes a-law (ITU G.711 non-linear PCM), from g711.c */
 void decode_alaw(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do) {
-    int i, sample_count;
-
-    for (i=first_sample,sample_count=0; i<first_sample+samples_to_do; i++,sample_count+=channelspacing) {
-        uint8_t alawbyte = read_8bit(stream->offset+i,stream->streamfile);
-        outbuf[sample_count] = expand_alaw(alawbyte);;
+    uint8_t buf[PCM_CHUNK_SIZE];
+    const uint8_t* data;
+    int i, j, samples, sample_count = 0;
+
+    for (i = first_sample; i < first_sample + samples_to_do; i += samples) {
+        samples = read_pcm_chunk(&data, buf, sizeof(buf), stream, i, first_sample + samples_to_do - i, 0x01, 0x01);
+        for (j = 0; j < samples; j++) {
+            outbuf[sample_count] = expand_alaw(data[j]);
+            sample_count += channelspacing;
+        }
     }
 }
 
 void decode_pcmfloat(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do, int big_endian) {
-    int i, sample_count;
-    float (*read_f32)(off_t,STREAMFILE*) = big_endian ? read_f32be : read_f32le;
-
-    for (i=first_sample,sample_count=0; i<first_sample+samples_to_do; i++,sample_count+=channelspacing) {
-        float sample_float = read_f32(stream->offset+i*4,stream->streamfile);
-        int sample_pcm = (int)floor(sample_float * 32767.f + .5f);
-
-        outbuf[sample_count] = clamp16(sample_pcm);
+    uint8_t buf[PCM_CHUNK_SIZE];
+    const uint8_t* data;
+    int i, j, samples, sample_count = 0;
+    uint32_t (*get_u32)(const uint8_t*) = big_endian ? get_u32be : get_u32le;
+
+    for (i = first_sample; i < first_sample + samples_to_do; i += samples) {
+        samples = read_pcm_chunk(&data, buf, sizeof(buf), stream, i, first_sample + samples_to_do - i, 0x04, 0x04);
+        for (j = 0; j < samples; j++) {
+            union {
+                uint32_t u32;
+                float f32;
+            } temp;
+            int sample_pcm;
+
+            temp.u32 = get_u32(data + j*0x04);
+            sample_pcm = (int)floor(temp.f32 * 32767.f + .5f);
+
+            outbuf[sample_count] = clamp16(sample_pcm);
+            sample_count += channelspacing;
+        }
     }
 }
 
@@ -1,4 +1,6 @@
 #include "coding.h"
+#include "../cpu.h"
+#include "../util.h"
 
 
 /* PS-ADPCM table, defined as rational numbers (as in the spec) */
@@ -46,6 +48,26 @@ static const int ps_adpcm_coefs_i[5][2] = {
 };
 
 
+/* ps_adpcm_coefs_f*256, all exact (for int versions of float implementations in low power mode) */
+static const int ps_adpcm_coefs_i8[16][2] = {
+        {    0 ,    0 },
+        {  240 ,    0 },
+        {  460 , -208 },
+        {  392 , -220 },
+        {  488 , -240 },
+        {  120 ,    0 },
+        {  230 , -104 },
+        {  196 , -110 },
+        {  244 , -120 },
+        {   60 ,    0 },
+        {  115 ,  -52 },
+        {   98 ,  -55 },
+        {  122 ,  -60 },
+        {  128 , -240 },
+        {   60 , -240 },
+        {   28 , -240 },
+};
+
 /* Decodes Sony's PS-ADPCM (sometimes called SPU-ADPCM or VAG, just "ADPCM" in the SDK docs).
  * Very similar to XA ADPCM (see xa_decoder for extended info).
  *
@@ -55,15 +77,20 @@ static const int ps_adpcm_coefs_i[5][2] = {
  */
 
 /* standard PS-ADPCM (float math version) */
-void decode_psx(VGMSTREAMCHANNEL* stream, sample_t* outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do, int is_badflags, int config) {
-    uint8_t frame[0x10] = {0};
+DECODE_INLINE void decode_psx_spaced(VGMSTREAMCHANNEL* stream, sample_t* outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do, int is_badflags, int config) {
+    uint8_t frame_buf[0x10];
+    const uint8_t* frame;
     off_t frame_offset;
-    int i, frames_in, sample_count = 0;
+    int i, frames_in, sample_count = 0, samples_done = 0;
     size_t bytes_per_frame, samples_per_frame;
     uint8_t coef_index, shift_factor, flag;
+    const int16_t* scales;
+    int scales_shift;
     int32_t hist1 = stream->adpcm_history1_32;
     int32_t hist2 = stream->adpcm_history2_32;
     int extended_mode = (config == 1);
+    int32_t pcm[28]; /* unclamped frame samples (hist isn't clamped, so clamping is left for output) */
+    const vgm_kernels_t* kernels = vgm_get_kernels();
 
 
     /* external interleave (fixed size), mono */
@@ -72,60 +99,107 @@ void decode_psx(VGMSTREAMCHANNEL* stream, sample_t* outbuf, int channelspacing,
     frames_in = first_sample / samples_per_frame;
     first_sample = first_sample % samples_per_frame;
 
-    /* parse frame header */
-    frame_offset = stream->offset + bytes_per_frame * frames_in;
-    read_streamfile(frame, frame_offset, bytes_per_frame, stream->streamfile); /* ignore EOF errors */
-    coef_index   = (frame[0] >> 4) & 0xf;
-    shift_factor = (frame[0] >> 0) & 0xf;
-    flag = frame[1]; /* only lower nibble needed */
+    /* may be called with many consecutive frames */
+    while (samples_done < samples_to_do) {
+        int frame_samples = samples_per_frame - first_sample;
+        if (frame_samples > samples_to_do - samples_done)
+            frame_samples = samples_to_do - samples_done;
+
+        /* parse frame header */
+        frame_offset = stream->offset + bytes_per_frame * frames_in;
+        memset(frame_buf, 0, sizeof(frame_buf));
+        frame = read_streamfile_ptr(frame_buf, frame_offset, bytes_per_frame, stream->streamfile); /* ignore EOF errors */
+        coef_index   = (frame[0] >> 4) & 0xf;
+        shift_factor = (frame[0] >> 0) & 0xf;
+        flag = frame[1]; /* only lower nibble needed */
+
+        /* upper filters only used in few PS3 games, normally 0 */
+        if (!extended_mode) {
+            VGM_ASSERT_ONCE(coef_index > 5 || shift_factor > 12, "PS-ADPCM: incorrect coefs/shift at %x\n", (uint32_t)frame_offset);
+            if (coef_index > 5)
+                coef_index = 0;
+            if (shift_factor > 12)
+                shift_factor = 9; /* supposedly, from Nocash PSX docs */
+        }
 
-    /* upper filters only used in few PS3 games, normally 0 */
-    if (!extended_mode) {
-        VGM_ASSERT_ONCE(coef_index > 5 || shift_factor > 12, "PS-ADPCM: incorrect coefs/shift at %x\n", (uint32_t)frame_offset);
-        if (coef_index > 5)
-            coef_index = 0;
-        if (shift_factor > 12)
-            shift_factor = 9; /* supposedly, from Nocash PSX docs */
-    }
+        if (is_badflags) /* some games store garbage or extra internal logic in the flags, must be ignored */
+            flag = 0;
+        VGM_ASSERT_ONCE(flag > 7,"PS-ADPCM: unknown flag at %x\n", (uint32_t)frame_offset); /* meta should use PSX-badflags */
 
-    if (is_badflags) /* some games store garbage or extra internal logic in the flags, must be ignored */
-        flag = 0;
-    VGM_ASSERT_ONCE(flag > 7,"PS-ADPCM: unknown flag at %x\n", (uint32_t)frame_offset); /* meta should use PSX-badflags */
 
+        /* nibble << (20 - shift), from the 16b table (extended shifts over 12 would lose bits there) */
+        if (shift_factor <= 12) {
+            scales = nibble_shift_table[shift_factor];
+            scales_shift = 8;
+        }
+        else {
+            scales = nibble_shift_table[12];
+            scales_shift = 20 - shift_factor;
+        }
 
-    shift_factor = 20 - shift_factor;
-    /* decode nibbles */
-    for (i = first_sample; i < first_sample + samples_to_do; i++) {
-        int32_t sample = 0;
+        /* decode nibbles */
+        for (i = first_sample; i < first_sample + frame_samples; i++) {
+            int32_t sample = 0;
 
-        if (flag < 0x07) { /* with flag 0x07 decoded sample must be 0 */
-            uint8_t nibbles = frame[0x02 + i/2];
-            
-            sample = (i&1 ? /* low nibble first */
-                    get_high_nibble_signed(nibbles):
-                    get_low_nibble_signed(nibbles)) << shift_factor; /*scale*/
-            sample = sample + (int32_t)((ps_adpcm_coefs_f[coef_index][0]*hist1 + ps_adpcm_coefs_f[coef_index][1]*hist2) * 256.0f);
-            sample >>= 8;
+            if (flag < 0x07) { /* with flag 0x07 decoded sample must be 0 */
+                uint8_t nibbles = frame[0x02 + i/2];
+
+                sample = scales[i&1 ? /* low nibble first */
+                        (nibbles >> 4) & 0x0f :
+                        (nibbles >> 0) & 0x0f] << scales_shift; /* 16b sign extend + scale */
+
+                /* float coefs are N/64 so with small enough hist (always, unless data is garbage) the
+                 * float math below is exact and equivalent to the faster int version */
+                if (coef_index < 5 && hist1 >= -0x10000 && hist1 < 0x10000 && hist2 >= -0x10000 && hist2 < 0x10000)
+                    sample = sample + (ps_adpcm_coefs_i[coef_index][0]*hist1 + ps_adpcm_coefs_i[coef_index][1]*hist2) * 4;
+                else
+                    sample = sample + (int32_t)((ps_adpcm_coefs_f[coef_index][0]*hist1 + ps_adpcm_coefs_f[coef_index][1]*hist2) * 256.0f);
+                sample >>= 8;
+            }
+
+            pcm[i - first_sample] = sample;
+
+            hist2 = hist1;
+            hist1 = sample;
         }
 
-        outbuf[sample_count] = clamp16(sample); /*clamping*/
-        sample_count += channelspacing;
+        /* clamp all at once (saturating pack when contiguous) */
+        if (channelspacing == 1) {
+            kernels->s32_to_s16(outbuf + sample_count, pcm, frame_samples);
+            sample_count += frame_samples;
+        }
+        else {
+            for (i = 0; i < frame_samples; i++) {
+                outbuf[sample_count] = clamp16(pcm[i]);
+                sample_count += channelspacing;
+            }
+        }
 
-        hist2 = hist1;
-        hist1 = sample;
+        samples_done += frame_samples;
+        first_sample = 0;
+        frames_in++;
     }
 
     stream->adpcm_history1_32 = hist1;
     stream->adpcm_history2_32 = hist2;
 }
 
+void decode_psx(VGMSTREAMCHANNEL* stream, sample_t* outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do, int is_badflags, int config) {
+    switch (channelspacing) {
+        case 1:  decode_psx_spaced(stream, outbuf, 1, first_sample, samples_to_do, is_badflags, config); break;
+        case 2:  decode_psx_spaced(stream, outbuf, 2, first_sample, samples_to_do, is_badflags, config); break;
+        default: decode_psx_spaced(stream, outbuf, channelspacing, first_sample, samples_to_do, is_badflags, config); break;
+    }
+}
+
 
 /* PS-ADPCM with configurable frame size and no flag (int math version).
  * Found in some PC/PS3 games (FF XI in sizes 0x3/0x5/0x9/0x41, Afrika in size 0x4, Blur/James Bond in size 0x33, etc).
  *
  * Uses int/float math depending on config (PC/other code may be int, PS3 float). */
 void decode_psx_configurable(VGMSTREAMCHANNEL* stream, sample_t* outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do, int frame_size, int config) {
-    uint8_t frame[0x50] = {0};
+    uint8_t frame_buf[0x50] = {0};
+    const uint8_t* frame;
     off_t frame_offset;
     int i, frames_in, sample_count = 0;
     size_t bytes_per_frame, samples_per_frame;
@@ -133,7 +207,8 @@ void decode_psx_configurable(VGMSTREAMCHANNEL* stream, sample_t* outbuf, int cha
     int32_t hist1 = stream->adpcm_history1_32;
     int32_t hist2 = stream->adpcm_history2_32;
     int extended_mode = (config == 1);
-    int float_mode = (config == 1);
+    int float_mode = (config == 1) && !vgmstream_is_low_power();
+    const int16_t* scales;
 
 
     /* external interleave (variable size), mono */
@@ -144,7 +219,7 @@ void decode_psx_configurable(VGMSTREAMCHANNEL* stream, sample_t* outbuf, int cha
 
     /* parse frame header */
     frame_offset = stream->offset + bytes_per_frame * frames_in;
-    read_streamfile(frame, frame_offset, bytes_per_frame, stream->streamfile); /* ignore EOF errors */
+    frame = read_streamfile_ptr(frame_buf, frame_offset, bytes_per_frame, stream->streamfile); /* ignore EOF errors */
     coef_index   = (frame[0] >> 4) & 0xf;
     shift_factor = (frame[0] >> 0) & 0xf;
 
@@ -156,6 +231,7 @@ void decode_psx_configurable(VGMSTREAMCHANNEL* stream, sample_t* outbuf, int cha
         if (shift_factor > 12)
             shift_factor = 9; /* supposedly, from Nocash PSX docs */
     }
+    scales = nibble_shift_table[shift_factor];
 
 
     /* decode nibbles */
@@ -163,13 +239,15 @@ void decode_psx_configurable(VGMSTREAMCHANNEL* stream, sample_t* outbuf, int cha
         int32_t sample = 0;
         uint8_t nibbles = frame[0x01 + i/2];
 
-        sample = i&1 ? /* low nibble first */
+        sample = scales[i&1 ? /* low nibble first */
                 (nibbles >> 4) & 0x0f :
-                (nibbles >> 0) & 0x0f;
-        sample = (int16_t)((sample << 12) & 0xf000) >> shift_factor; /* 16b sign extend + scale */
-        sample = float_mode ?
-            (int32_t)(sample + ps_adpcm_coefs_f[coef_index][0]*hist1 + ps_adpcm_coefs_f[coef_index][1]*hist2) :
-            sample + ((ps_adpcm_coefs_i[coef_index][0]*hist1 + ps_adpcm_coefs_i[coef_index][1]*hist2) >> 6);
+                (nibbles >> 0) & 0x0f]; /* 16b sign extend + scale */
+        if (float_mode)
+            sample = (int32_t)(sample + ps_adpcm_coefs_f[coef_index][0]*hist1 + ps_adpcm_coefs_f[coef_index][1]*hist2);
+        else if (extended_mode) /* low power, may round down where float truncates */
+            sample = sample + ((ps_adpcm_coefs_i8[coef_index][0]*hist1 + ps_adpcm_coefs_i8[coef_index][1]*hist2) >> 8);
+        else
+            sample = sample + ((ps_adpcm_coefs_i[coef_index][0]*hist1 + ps_adpcm_coefs_i[coef_index][1]*hist2) >> 6);
         sample = clamp16(sample);
 
         outbuf[sample_count] = sample;
@@ -185,13 +263,16 @@ void decode_psx_configurable(VGMSTREAMCHANNEL* stream, sample_t* outbuf, int cha
 
 /* PS-ADPCM from Pivotal games, exactly like psx_cfg but with float math (reverse engineered from the exe) */
 void decode_psx_pivotal(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do, int frame_size) {
-    uint8_t frame[0x50] = {0};
+    uint8_t frame_buf[0x50] = {0};
+    const uint8_t* frame;
     off_t frame_offset;
     int i, frames_in, sample_count = 0;
     size_t bytes_per_frame, samples_per_frame;
     uint8_t coef_index, shift_factor;
     int32_t hist1 = stream->adpcm_history1_32;
     int32_t hist2 = stream->adpcm_history2_32;
+    int int_mode = vgmstream_is_low_power();
+    const int16_t* scales;
 
 
     /* external interleave (variable size), mono */
@@ -202,7 +283,7 @@ void decode_psx_pivotal(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channe
 
     /* parse frame header */
     frame_offset = stream->offset + bytes_per_frame * frames_in;
-    read_streamfile(frame, frame_offset, bytes_per_frame, stream->streamfile); /* ignore EOF errors */
+    frame = read_streamfile_ptr(frame_buf, frame_offset, bytes_per_frame, stream->streamfile); /* ignore EOF errors */
     coef_index   = (frame[0] >> 4) & 0xf;
     shift_factor = (frame[0] >> 0) & 0xf;
 
@@ -211,17 +292,19 @@ void decode_psx_pivotal(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channe
         coef_index = 5;
     if (shift_factor > 12) /* same */
         shift_factor = 12;
+    scales = nibble_shift_table[shift_factor];
 
-    shift_factor = 20 - shift_factor;
     /* decode nibbles */
     for (i = first_sample; i < first_sample + samples_to_do; i++) {
         int32_t sample = 0;
         uint8_t nibbles = frame[0x01 + i/2];
 
-        sample = (i&1 ? /* low nibble first */
-                get_high_nibble_signed(nibbles):
-                get_low_nibble_signed(nibbles)) << shift_factor; /*scale*/
-        sample = sample + (int32_t)((ps_adpcm_coefs_f[coef_index][0]*hist1 + ps_adpcm_coefs_f[coef_index][1]*hist2) * 256.0f); /* actually substracts negative coefs but whatevs */
+        sample = scales[i&1 ? /* low nibble first */
+                (nibbles >> 4) & 0x0f :
+                (nibbles >> 0) & 0x0f] << 8; /* 16b sign extend + scale */
+        sample = int_mode ? /* same unless hist gets huge */
+            sample + (ps_adpcm_coefs_i8[coef_index][0]*hist1 + ps_adpcm_coefs_i8[coef_index][1]*hist2) :
+            sample + (int32_t)((ps_adpcm_coefs_f[coef_index][0]*hist1 + ps_adpcm_coefs_f[coef_index][1]*hist2) * 256.0f); /* actually substracts negative coefs but whatevs */
         sample >>= 8;
 
         outbuf[sample_count] = clamp16(sample); /*clamping*/
@@ -250,6 +333,24 @@ void decode_psx_pivotal(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channe
  * - 0x7 (0111): End marker and don't decode
  * - 0x8+(1NNN): Not valid
  */
+/* Reads frames in big chunks, as scanners below may walk whole files during detection
+ * (mimics read_u8, returning 0xFF past EOF) */
+typedef struct {
+    uint8_t buf[0x1000];
+    off_t offset;
+    size_t size;
+} ps_scan_t;
+
+static inline uint8_t ps_scan_u8(ps_scan_t* scan, off_t offset, STREAMFILE* sf) {
+    if (offset < scan->offset || offset >= scan->offset + scan->size) {
+        scan->offset = offset;
+        scan->size = read_streamfile(scan->buf, offset, sizeof(scan->buf), sf);
+        if (scan->size == 0)
+            return 0xFF;
+    }
+    return scan->buf[offset - scan->offset];
+}
+
 static int ps_find_loop_offsets_internal(STREAMFILE *sf, off_t start_offset, size_t data_size, int channels, size_t interleave, int32_t * p_loop_start, int32_t * p_loop_end, int config) {
     int num_samples = 0, loop_start = 0, loop_end = 0;
     int loop_start_found = 0, loop_end_found = 0;
@@ -257,13 +358,16 @@ static int ps_find_loop_offsets_internal(STREAMFILE *sf, off_t start_offset, siz
     off_t max_offset = start_offset + data_size;
     size_t interleave_consumed = 0;
     int detect_full_loops = config & 1;
+    ps_scan_t scan = {0};
 
 
     if (data_size == 0 || channels == 0 || (channels > 1 && interleave == 0))
         return 0;
 
     while (offset < max_offset) {
-        uint8_t flag = read_u8(offset+0x01, sf) & 0x0F; /* lower nibble only (for HEVAG) */
+        uint8_t flag = ps_scan_u8(&scan, offset+0x01, sf) & 0x0F; /* lower nibble only (for HEVAG) */
+        if (scan.size == 0) /* past EOF, read error or over detection budget: nothing else to find */
+            break;
 
         /* theoretically possible and would use last 0x06 */
         VGM_ASSERT_ONCE(loop_start_found && flag == 0x06, "PS LOOPS: multiple loop start found at %x\n", (uint32_t)offset);
@@ -280,7 +384,7 @@ static int ps_find_loop_offsets_internal(STREAMFILE *sf, off_t start_offset, siz
             /* ignore strange case in Commandos (PS2), has many loop starts and ends */
             if (channels == 1
                     && offset + 0x10 < max_offset
-                    && (read_u8(offset + 0x11, sf) & 0x0F) == 0x06) {
+                    && (ps_scan_u8(&scan, offset + 0x11, sf) & 0x0F) == 0x06) {
                 loop_end = 0;
                 loop_end_found = 0;
             }
@@ -296,7 +400,7 @@ static int ps_find_loop_offsets_internal(STREAMFILE *sf, off_t start_offset, siz
         if (flag == 0x01 && detect_full_loops) {
             static const uint8_t eof[0x10] = {0xFF,0x07,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00};
             uint8_t buf[0x10];
-            uint8_t hdr = read_u8(offset + 0x00, sf);
+            uint8_t hdr = ps_scan_u8(&scan, offset + 0x00, sf);
 
             int read = read_streamfile(buf, offset+0x10, sizeof(buf), sf);
             if (read > 0
@@ -426,12 +530,13 @@ size_t ps_cfg_bytes_to_samples(size_t bytes, size_t frame_size, int channels) {
 /* test PS-ADPCM frames for correctness */
 int ps_check_format(STREAMFILE *streamFile, off_t offset, size_t max) {
     off_t max_offset = offset + max;
+    ps_scan_t scan = {0};
     if (max_offset > get_streamfile_size(streamFile))
         max_offset = get_streamfile_size(streamFile);
 
     while (offset < max_offset) {
-        uint8_t predictor = (read_8bit(offset+0x00,streamFile) >> 4) & 0x0f;
-        uint8_t flags     =  read_8bit(offset+0x01,streamFile);
+        uint8_t predictor = (ps_scan_u8(&scan, offset+0x00, streamFile) >> 4) & 0x0f;
+        uint8_t flags     =  ps_scan_u8(&scan, offset+0x01, streamFile);
 
         if (predictor > 5 || flags > 7) {
             return 0;
@@ -1,4 +1,5 @@
 #include "coding.h"
+#include "frame_walk.h"
 
 
 /* a somewhat IMA-like mix of pre-calculated [index][nibble][step,index] all in one */
@@ -44,23 +45,12 @@ static const int32_t ptadpcm_table[16][16][2] = {
 };
 
 /* Platinum "PtADPCM" custom ADPCM for Wwise (reverse engineered from .exes). */
-void decode_ptadpcm(VGMSTREAMCHANNEL *stream, sample_t *outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do, size_t frame_size) {
-    uint8_t frame[0x104] = {0};
-    off_t frame_offset;
-    int i, frames_in, sample_count = 0, samples_done = 0;
-    size_t bytes_per_frame, samples_per_frame;
+static void decode_ptadpcm_frame(const uint8_t* frame, off_t frame_offset, int16_t* pcm, int samples_per_frame) {
+    int i;
     int16_t hist1, hist2;
     int index, nibble, step;
 
-    /* external interleave (variable size), mono */
-    bytes_per_frame = frame_size;
-    samples_per_frame = 2 + (frame_size - 0x05) * 2;
-    frames_in = first_sample / samples_per_frame;
-    //first_sample = first_sample % samples_per_frame;
-
     /* parse frame header */
-    frame_offset = stream->offset + bytes_per_frame*frames_in;
-    read_streamfile(frame, frame_offset, bytes_per_frame, stream->streamfile); /* ignore EOF errors */
     hist2 = get_s16le(frame + 0x00);
     hist1 = get_s16le(frame + 0x02);
     index = frame[0x04];
@@ -69,17 +59,9 @@ void decode_ptadpcm(VGMSTREAMCHANNEL *stream, sample_t *outbuf, int channelspaci
     if (index > 12)
         index = 12;
 
-    /* write header samples (needed) */
-    if (sample_count >= first_sample && samples_done < samples_to_do) {
-        outbuf[samples_done * channelspacing] = hist2;
-        samples_done++;
-    }
-    sample_count++;
-    if (sample_count >= first_sample && samples_done < samples_to_do) {
-        outbuf[samples_done * channelspacing] = hist1;
-        samples_done++;
-    }
-    sample_count++;
+    /* header samples (needed) */
+    pcm[0] = hist2;
+    pcm[1] = hist1;
 
     /* decode nibbles */
     for (i = 0; i < samples_per_frame - 2; i++) {
@@ -94,18 +76,28 @@ void decode_ptadpcm(VGMSTREAMCHANNEL *stream, sample_t *outbuf, int channelspaci
         index = ptadpcm_table[index][nibble][1];
         sample = clamp16(step + 2*hist1 - hist2);
 
-        if (sample_count >= first_sample && samples_done < samples_to_do) {
-            outbuf[samples_done * channelspacing] = sample;
-            samples_done++;
-        }
-        sample_count++;
+        pcm[2 + i] = sample;
 
         hist2 = hist1;
         hist1 = sample;
     }
+}
 
-    //stream->adpcm_history1_32 = hist1;
-    //stream->adpcm_history2_32 = hist2;
+void decode_ptadpcm(VGMSTREAMCHANNEL *stream, sample_t *outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do, size_t frame_size) {
+    frame_walk_t fw;
+    size_t bytes_per_frame, samples_per_frame;
+
+    /* external interleave (variable size), mono */
+    bytes_per_frame = frame_size;
+    samples_per_frame = 2 + (frame_size - 0x05) * 2;
+    if (bytes_per_frame < 0x05 || bytes_per_frame > FRAME_WALK_MAX_BYTES)
+        return;
+
+    /* frames start with their history, so they are decoded whole */
+    FRAME_WALK(&fw, stream->streamfile, stream->offset, bytes_per_frame, samples_per_frame, first_sample, samples_to_do) {
+        decode_ptadpcm_frame(fw.frame, fw.offset, fw.pcm, samples_per_frame);
+        frame_walk_output(&fw, outbuf, channelspacing);
+    }
 }
 
 size_t ptadpcm_bytes_to_samples(size_t bytes, int channels, size_t frame_size) {
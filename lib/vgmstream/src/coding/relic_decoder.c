@@ -45,10 +45,6 @@ struct relic_codec_data {
     int freq_size;
     int dct_mode;
     int samples_mode;
-    /* decoder init state */
-    float scales[RELIC_MAX_SCALES]; /* quantization scales */
-    float dct[RELIC_MAX_SIZE];
-    float window[RELIC_MAX_SIZE];
     /* decoder frame state */
     uint8_t exponents[RELIC_MAX_CHANNELS][RELIC_MAX_FREQ]; /* quantization/scale indexes */
     float freq1[RELIC_MAX_FREQ]; /* dequantized spectrum */
@@ -132,6 +128,24 @@ void free_relic(relic_codec_data* data) {
     free(data);
 }
 
+/* all state is in data, restored on the same data so config stays the same */
+void* save_relic(relic_codec_data* data, size_t* size) {
+    void* state;
+    if (!data) return NULL;
+
+    state = malloc(sizeof(relic_codec_data));
+    if (!state) return NULL;
+    memcpy(state, data, sizeof(relic_codec_data));
+    *size = sizeof(relic_codec_data);
+    return state;
+}
+
+void restore_relic(relic_codec_data* data, const void* state) {
+    if (!data || !state) return;
+
+    memcpy(data, state, sizeof(relic_codec_data));
+}
+
 /* ***************************************** */
 
 static const int16_t critical_band_data[RELIC_CRITICAL_BAND_COUNT] = { 
@@ -141,6 +155,9 @@ static const int16_t critical_band_data[RELIC_CRITICAL_BAND_COUNT] = {
     139, 180, 256
 };
 
+/* Decoder tables are always the same (DCT/window for RELIC_SIZE_HIGH and scales), so they are
+ * precomputed and shared by all streams. Originally built on init with the code below. */
+#if 0
 static void init_dct(float *dct, int dct_size) {
     int i;
     int dct_quarter = dct_size >> 2;
@@ -152,6 +169,169 @@ static void init_dct(float *dct, int dct_size) {
     }
 }
 
+static void init_window(float *window, int dct_size) {
+    int i;
+
+    for (i = 0; i < dct_size; i++) {
+        window[i] = sin((float)i * (RELIC_PI / dct_size));
+    }
+}
+
+static void init_dequantization(float* scales) {
+    int i;
+
+    scales[0] = RELIC_BASE_SCALE;
+    for (i = 1; i < RELIC_MAX_SCALES; i++) {
+        scales[i] = scales[i - 1] * scales[0];
+    }
+    for (i = 0; i < RELIC_MAX_SCALES; i++) {
+        scales[i] = RELIC_FREQUENCY_MASKING_FACTOR / (double) ((1 << (i + 1)) - 1) * scales[i];
+    }
+}
+#endif
+
+/* init_dct(dct, RELIC_SIZE_HIGH) */
+static const float relic_dct[RELIC_MAX_SIZE / 2] = {
+    1.533980248e-03f, 1.380538847e-02f, 2.607471868e-02f, 3.834012151e-02f, 5.059975013e-02f, 6.285175681e-02f,
+    7.509430498e-02f, 8.732553571e-02f, 9.954361618e-02f, 1.117467135e-01f, 1.239329800e-01f, 1.361005753e-01f,
+    1.482476890e-01f, 1.603724658e-01f, 1.724730879e-01f, 1.845477372e-01f, 1.965946108e-01f, 2.086118460e-01f,
+    2.205976993e-01f, 2.325503230e-01f, 2.444678992e-01f, 2.563486993e-01f, 2.681908607e-01f, 2.799926400e-01f,
+    2.917522788e-01f, 3.034679592e-01f, 3.151379526e-01f, 3.267604709e-01f, 3.383337557e-01f, 3.498561382e-01f,
+    3.613258004e-01f, 3.727410734e-01f, 3.841001987e-01f, 3.954015076e-01f, 4.066432416e-01f, 4.178237021e-01f,
+    4.289413095e-01f, 4.399942756e-01f, 4.509809911e-01f, 4.618998170e-01f, 4.727490544e-01f, 4.835270941e-01f,
+    4.942323267e-01f, 5.048631430e-01f, 5.154178739e-01f, 5.258950591e-01f, 5.362929702e-01f, 5.466101766e-01f,
+    5.568450689e-01f, 5.669960976e-01f, 5.770617127e-01f, 5.870403647e-01f, 5.969307423e-01f, 6.067311168e-01f,
+    6.164401770e-01f, 6.260563731e-01f, 6.355783343e-01f, 6.450045705e-01f, 6.543335915e-01f, 6.635642052e-01f,
+    6.726948023e-01f, 6.817241311e-01f, 6.906507015e-01f, 6.994733810e-01f, 7.081906796e-01f, 7.168012857e-01f,
+    7.253040075e-01f, 7.336974740e-01f, 7.419804335e-01f, 7.501516342e-01f, 7.582098842e-01f, 7.661539912e-01f,
+    7.739827037e-01f, 7.816948295e-01f, 7.892892361e-01f, 7.967648506e-01f, 8.041204214e-01f, 8.113548756e-01f,
+    8.184671402e-01f, 8.254561424e-01f, 8.323208690e-01f, 8.390602469e-01f, 8.456732631e-01f, 8.521589041e-01f,
+    8.585162759e-01f, 8.647442460e-01f, 8.708420992e-01f, 8.768087626e-01f, 8.826434016e-01f, 8.883450627e-01f,
+    8.939129710e-01f, 8.993462920e-01f, 9.046440721e-01f, 9.098057151e-01f, 9.148303270e-01f, 9.197171926e-01f,
+    9.244654775e-01f, 9.290745854e-01f, 9.335438013e-01f, 9.378723502e-01f, 9.420597553e-01f, 9.461052418e-01f,
+    9.500082135e-01f, 9.537681937e-01f, 9.573845267e-01f, 9.608566761e-01f, 9.641840458e-01f, 9.673662782e-01f,
+    9.704028368e-01f, 9.732932448e-01f, 9.760370851e-01f, 9.786339402e-01f, 9.810833931e-01f, 9.833850861e-01f,
+    9.855387211e-01f, 9.875439405e-01f, 9.894004464e-01f, 9.911079407e-01f, 9.926661253e-01f, 9.940748811e-01f,
+    9.953339100e-01f, 9.964430332e-01f, 9.974021316e-01f, 9.982110262e-01f, 9.988695383e-01f, 9.993776679e-01f,
+    9.997352958e-01f, 9.999423623e-01f, 9.999988079e-01f, 9.999046922e-01f, 9.996600151e-01f, 9.992647767e-01f,
+    9.987190366e-01f, 9.980228543e-01f, 9.971764088e-01f, 9.961798191e-01f, 9.950332046e-01f, 9.937367439e-01f,
+    9.922906160e-01f, 9.906949997e-01f, 9.889502525e-01f, 9.870565534e-01f, 9.850142598e-01f, 9.828235507e-01f,
+    9.804848433e-01f, 9.779984951e-01f, 9.753648639e-01f, 9.725843668e-01f, 9.696573615e-01f, 9.665843844e-01f,
+    9.633657932e-01f, 9.600021243e-01f, 9.564939141e-01f, 9.528416395e-01f, 9.490458965e-01f, 9.451071620e-01f,
+    9.410261512e-01f, 9.368034601e-01f, 9.324396253e-01f, 9.279353619e-01f, 9.232913852e-01f, 9.185084105e-01f,
+    9.135870337e-01f, 9.085280895e-01f, 9.033323526e-01f, 8.980005980e-01f, 8.925335407e-01f, 8.869321346e-01f,
+    8.811970949e-01f, 8.753293753e-01f, 8.693298697e-01f, 8.631994128e-01f, 8.569389582e-01f, 8.505494595e-01f,
+    8.440318704e-01f, 8.373872042e-01f, 8.306164145e-01f, 8.237205148e-01f, 8.167005777e-01f, 8.095576763e-01f,
+    8.022927642e-01f, 7.949071527e-01f, 7.874017358e-01f, 7.797777653e-01f, 7.720363736e-01f, 7.641787529e-01f,
+    7.562059760e-01f, 7.481193542e-01f, 7.399200797e-01f, 7.316093445e-01f, 7.231884599e-01f, 7.146586776e-01f,
+    7.060212493e-01f, 6.972774863e-01f, 6.884287000e-01f, 6.794763207e-01f, 6.704215407e-01f, 6.612658501e-01f,
+    6.520105600e-01f, 6.426569819e-01f, 6.332067251e-01f, 6.236611009e-01f, 6.140215397e-01f, 6.042894721e-01f,
+    5.944665074e-01f, 5.845539570e-01f, 5.745533109e-01f, 5.644662380e-01f, 5.542941093e-01f, 5.440385342e-01f,
+    5.337010026e-01f, 5.232830644e-01f, 5.127863288e-01f, 5.022124648e-01f, 4.915629029e-01f, 4.808392823e-01f,
+    4.700432420e-01f, 4.591765404e-01f, 4.482405782e-01f, 4.372371137e-01f, 4.261679053e-01f, 4.150344133e-01f,
+    4.038383961e-01f, 3.925815821e-01f, 3.812657595e-01f, 3.698924184e-01f, 3.584633470e-01f, 3.469804227e-01f,
+    3.354451358e-01f, 3.238593042e-01f, 3.122248352e-01f, 3.005432189e-01f, 2.888163626e-01f, 2.770459950e-01f,
+    2.652340233e-01f, 2.533819973e-01f, 2.414918244e-01f, 2.295653820e-01f, 2.176042646e-01f, 2.056103647e-01f,
+    1.935855001e-01f, 1.815316081e-01f, 1.694502532e-01f, 1.573433876e-01f, 1.452129334e-01f, 1.330605000e-01f,
+    1.208880320e-01f, 1.086973548e-01f, 9.649042040e-02f, 8.426884562e-02f, 7.203457505e-02f, 5.978957564e-02f,
+    4.753545672e-02f, 3.527417779e-02f, 2.300758474e-02f, 1.073764637e-02f
+};
+
+/* init_window(window, RELIC_SIZE_HIGH) */
+static const float relic_window[RELIC_MAX_SIZE] = {
+    0.000000000e+00f, 6.135884672e-03f, 1.227153838e-02f, 1.840673015e-02f, 2.454122901e-02f, 3.067480400e-02f,
+    3.680722415e-02f, 4.293825850e-02f, 4.906767607e-02f, 5.519524589e-02f, 6.132074073e-02f, 6.744392216e-02f,
+    7.356456667e-02f, 7.968243957e-02f, 8.579731733e-02f, 9.190895408e-02f, 9.801714122e-02f, 1.041216403e-01f,
+    1.102222055e-01f, 1.163186356e-01f, 1.224106774e-01f, 1.284981221e-01f, 1.345807165e-01f, 1.406582445e-01f,
+    1.467304677e-01f, 1.527971923e-01f, 1.588581502e-01f, 1.649131328e-01f, 1.709619015e-01f, 1.770042181e-01f,
+    1.830398887e-01f, 1.890686601e-01f, 1.950903237e-01f, 2.011046410e-01f, 2.071113884e-01f, 2.131103277e-01f,
+    2.191012353e-01f, 2.250839174e-01f, 2.310581207e-01f, 2.370236069e-01f, 2.429801971e-01f, 2.489276081e-01f,
+    2.548656762e-01f, 2.607941329e-01f, 2.667127848e-01f, 2.726213634e-01f, 2.785196900e-01f, 2.844075561e-01f,
+    2.902846634e-01f, 2.961508930e-01f, 3.020059466e-01f, 3.078496754e-01f, 3.136817515e-01f, 3.195020258e-01f,
+    3.253103197e-01f, 3.311063051e-01f, 3.368898630e-01f, 3.426607251e-01f, 3.484186828e-01f, 3.541635275e-01f,
+    3.598950505e-01f, 3.656130135e-01f, 3.713172078e-01f, 3.770074248e-01f, 3.826834559e-01f, 3.883450329e-01f,
+    3.939920664e-01f, 3.996241987e-01f, 4.052413404e-01f, 4.108431935e-01f, 4.164295793e-01f, 4.220002890e-01f,
+    4.275550842e-01f, 4.330938458e-01f, 4.386162460e-01f, 4.441221654e-01f, 4.496113360e-01f, 4.550835788e-01f,
+    4.605387151e-01f, 4.659765065e-01f, 4.713967443e-01f, 4.767992496e-01f, 4.821837544e-01f, 4.875501692e-01f,
+    4.928982258e-01f, 4.982276559e-01f, 5.035383701e-01f, 5.088301897e-01f, 5.141027570e-01f, 5.193560123e-01f,
+    5.245897174e-01f, 5.298036337e-01f, 5.349976420e-01f, 5.401715040e-01f, 5.453249812e-01f, 5.504580140e-01f,
+    5.555702448e-01f, 5.606616139e-01f, 5.657318234e-01f, 5.707807541e-01f, 5.758082271e-01f, 5.808140039e-01f,
+    5.857979059e-01f, 5.907596946e-01f, 5.956993103e-01f, 6.006165147e-01f, 6.055110097e-01f, 6.103827953e-01f,
+    6.152316332e-01f, 6.200572252e-01f, 6.248595119e-01f, 6.296382546e-01f, 6.343933344e-01f, 6.391244531e-01f,
+    6.438315511e-01f, 6.485144496e-01f, 6.531728506e-01f, 6.578066945e-01f, 6.624158025e-01f, 6.669999361e-01f,
+    6.715589762e-01f, 6.760927439e-01f, 6.806010008e-01f, 6.850836873e-01f, 6.895405650e-01f, 6.939714551e-01f,
+    6.983762980e-01f, 7.027547359e-01f, 7.071067691e-01f, 7.114322186e-01f, 7.157308459e-01f, 7.200025320e-01f,
+    7.242470980e-01f, 7.284644246e-01f, 7.326542735e-01f, 7.368165851e-01f, 7.409511805e-01f, 7.450577617e-01f,
+    7.491363883e-01f, 7.531868219e-01f, 7.572088838e-01f, 7.612023950e-01f, 7.651672959e-01f, 7.691033483e-01f,
+    7.730104327e-01f, 7.768884897e-01f, 7.807372808e-01f, 7.845566273e-01f, 7.883464098e-01f, 7.921065688e-01f,
+    7.958369255e-01f, 7.995373011e-01f, 8.032075167e-01f, 8.068475723e-01f, 8.104571700e-01f, 8.140363097e-01f,
+    8.175848126e-01f, 8.211025596e-01f, 8.245893121e-01f, 8.280450702e-01f, 8.314696550e-01f, 8.348628879e-01f,
+    8.382247090e-01f, 8.415549397e-01f, 8.448535800e-01f, 8.481203318e-01f, 8.513551950e-01f, 8.545579910e-01f,
+    8.577286601e-01f, 8.608669639e-01f, 8.639728427e-01f, 8.670462370e-01f, 8.700869679e-01f, 8.730949759e-01f,
+    8.760701418e-01f, 8.790122867e-01f, 8.819212914e-01f, 8.847970963e-01f, 8.876396418e-01f, 8.904487491e-01f,
+    8.932242990e-01f, 8.959662914e-01f, 8.986744881e-01f, 9.013488889e-01f, 9.039893150e-01f, 9.065957069e-01f,
+    9.091680050e-01f, 9.117060304e-01f, 9.142097831e-01f, 9.166790843e-01f, 9.191138744e-01f, 9.215140343e-01f,
+    9.238795042e-01f, 9.262102246e-01f, 9.285060763e-01f, 9.307669997e-01f, 9.329928160e-01f, 9.351835251e-01f,
+    9.373390079e-01f, 9.394592047e-01f, 9.415440559e-01f, 9.435934424e-01f, 9.456073642e-01f, 9.475856423e-01f,
+    9.495282173e-01f, 9.514350295e-01f, 9.533060193e-01f, 9.551411867e-01f, 9.569403529e-01f, 9.587035179e-01f,
+    9.604305625e-01f, 9.621214271e-01f, 9.637760520e-01f, 9.653944373e-01f, 9.669764638e-01f, 9.685221314e-01f,
+    9.700312614e-01f, 9.715039134e-01f, 9.729399681e-01f, 9.743393660e-01f, 9.757021070e-01f, 9.770281315e-01f,
+    9.783173800e-01f, 9.795697927e-01f, 9.807853103e-01f, 9.819638729e-01f, 9.831054807e-01f, 9.842100739e-01f,
+    9.852776527e-01f, 9.863080978e-01f, 9.873014092e-01f, 9.882575870e-01f, 9.891765118e-01f, 9.900581837e-01f,
+    9.909026623e-01f, 9.917097688e-01f, 9.924795628e-01f, 9.932119846e-01f, 9.939069748e-01f, 9.945645928e-01f,
+    9.951847196e-01f, 9.957674146e-01f, 9.963126183e-01f, 9.968203306e-01f, 9.972904325e-01f, 9.977230430e-01f,
+    9.981181026e-01f, 9.984755516e-01f, 9.987954497e-01f, 9.990777373e-01f, 9.993224144e-01f, 9.995294213e-01f,
+    9.996988177e-01f, 9.998306036e-01f, 9.999247193e-01f, 9.999811649e-01f, 1.000000000e+00f, 9.999811649e-01f,
+    9.999247193e-01f, 9.998306036e-01f, 9.996988177e-01f, 9.995294213e-01f, 9.993223548e-01f, 9.990777373e-01f,
+    9.987954497e-01f, 9.984755516e-01f, 9.981181026e-01f, 9.977230430e-01f, 9.972904325e-01f, 9.968202710e-01f,
+    9.963126183e-01f, 9.957674146e-01f, 9.951847196e-01f, 9.945645332e-01f, 9.939069748e-01f, 9.932119250e-01f,
+    9.924795032e-01f, 9.917097688e-01f, 9.909026027e-01f, 9.900581837e-01f, 9.891765118e-01f, 9.882575870e-01f,
+    9.873014092e-01f, 9.863080978e-01f, 9.852776527e-01f, 9.842100739e-01f, 9.831054807e-01f, 9.819638729e-01f,
+    9.807852507e-01f, 9.795697331e-01f, 9.783173800e-01f, 9.770281315e-01f, 9.757021070e-01f, 9.743393660e-01f,
+    9.729399085e-01f, 9.715039134e-01f, 9.700312614e-01f, 9.685220718e-01f, 9.669764638e-01f, 9.653944373e-01f,
+    9.637760520e-01f, 9.621214271e-01f, 9.604305029e-01f, 9.587034583e-01f, 9.569402933e-01f, 9.551411271e-01f,
+    9.533060193e-01f, 9.514349699e-01f, 9.495281577e-01f, 9.475855827e-01f, 9.456073046e-01f, 9.435934424e-01f,
+    9.415440559e-01f, 9.394592047e-01f, 9.373389482e-01f, 9.351835251e-01f, 9.329928160e-01f, 9.307669401e-01f,
+    9.285060763e-01f, 9.262102246e-01f, 9.238795042e-01f, 9.215139747e-01f, 9.191138744e-01f, 9.166790247e-01f,
+    9.142097235e-01f, 9.117060304e-01f, 9.091680050e-01f, 9.065957069e-01f, 9.039893150e-01f, 9.013488293e-01f,
+    8.986744285e-01f, 8.959662318e-01f, 8.932242990e-01f, 8.904486895e-01f, 8.876395822e-01f, 8.847970366e-01f,
+    8.819212317e-01f, 8.790121675e-01f, 8.760700226e-01f, 8.730949163e-01f, 8.700870275e-01f, 8.670462370e-01f,
+    8.639728427e-01f, 8.608669639e-01f, 8.577286005e-01f, 8.545579910e-01f, 8.513551354e-01f, 8.481203318e-01f,
+    8.448535204e-01f, 8.415549397e-01f, 8.382246494e-01f, 8.348627687e-01f, 8.314695358e-01f, 8.280450702e-01f,
+    8.245893121e-01f, 8.211025000e-01f, 8.175848126e-01f, 8.140363097e-01f, 8.104571700e-01f, 8.068475127e-01f,
+    8.032075167e-01f, 7.995372415e-01f, 7.958368659e-01f, 7.921065092e-01f, 7.883463502e-01f, 7.845565081e-01f,
+    7.807371020e-01f, 7.768884897e-01f, 7.730104923e-01f, 7.691033483e-01f, 7.651672363e-01f, 7.612023950e-01f,
+    7.572088242e-01f, 7.531867623e-01f, 7.491363287e-01f, 7.450577021e-01f, 7.409510612e-01f, 7.368164659e-01f,
+    7.326541543e-01f, 7.284643054e-01f, 7.242469788e-01f, 7.200025320e-01f, 7.157308459e-01f, 7.114322186e-01f,
+    7.071067691e-01f, 7.027547359e-01f, 6.983762383e-01f, 6.939713955e-01f, 6.895405054e-01f, 6.850836277e-01f,
+    6.806009412e-01f, 6.760926247e-01f, 6.715588570e-01f, 6.669998169e-01f, 6.624156237e-01f, 6.578066945e-01f,
+    6.531728506e-01f, 6.485143900e-01f, 6.438315511e-01f, 6.391243935e-01f, 6.343932748e-01f, 6.296381950e-01f,
+    6.248594522e-01f, 6.200571060e-01f, 6.152315140e-01f, 6.103826761e-01f, 6.055109501e-01f, 6.006163359e-01f,
+    5.956991315e-01f, 5.907597542e-01f, 5.857978463e-01f, 5.808139443e-01f, 5.758081675e-01f, 5.707806945e-01f,
+    5.657317638e-01f, 5.606614947e-01f, 5.555701852e-01f, 5.504578948e-01f, 5.453248620e-01f, 5.401713848e-01f,
+    5.349974632e-01f, 5.298034549e-01f, 5.245895386e-01f, 5.193560123e-01f, 5.141027570e-01f, 5.088301301e-01f,
+    5.035383701e-01f, 4.982276261e-01f, 4.928981364e-01f, 4.875501096e-01f, 4.821836948e-01f, 4.767991304e-01f,
+    4.713966250e-01f, 4.659763575e-01f, 4.605385661e-01f, 4.550834298e-01f, 4.496113658e-01f, 4.441221654e-01f,
+    4.386162460e-01f, 4.330938160e-01f, 4.275550544e-01f, 4.220002294e-01f, 4.164294899e-01f, 4.108431041e-01f,
+    4.052412212e-01f, 3.996241093e-01f, 3.939919174e-01f, 3.883449137e-01f, 3.826832771e-01f, 3.770072460e-01f,
+    3.713172376e-01f, 3.656130135e-01f, 3.598950505e-01f, 3.541634977e-01f, 3.484186530e-01f, 3.426606655e-01f,
+    3.368898034e-01f, 3.311062157e-01f, 3.253102005e-01f, 3.195019066e-01f, 3.136816025e-01f, 3.078494966e-01f,
+    3.020057976e-01f, 2.961507142e-01f, 2.902847230e-01f, 2.844075561e-01f, 2.785196900e-01f, 2.726213336e-01f,
+    2.667127252e-01f, 2.607940733e-01f, 2.548655868e-01f, 2.489275187e-01f, 2.429800779e-01f, 2.370234877e-01f,
+    2.310579717e-01f, 2.250837535e-01f, 2.191010714e-01f, 2.131101340e-01f, 2.071114033e-01f, 2.011046410e-01f,
+    1.950903088e-01f, 1.890686452e-01f, 1.830398440e-01f, 1.770041585e-01f, 1.709618121e-01f, 1.649130285e-01f,
+    1.588580310e-01f, 1.527970582e-01f, 1.467303336e-01f, 1.406580806e-01f, 1.345805228e-01f, 1.284979135e-01f,
+    1.224106997e-01f, 1.163186356e-01f, 1.102221981e-01f, 1.041216031e-01f, 9.801709652e-02f, 9.190889448e-02f,
+    8.579722792e-02f, 7.968233526e-02f, 7.356444746e-02f, 6.744378805e-02f, 6.132058427e-02f, 5.519507453e-02f,
+    4.906748608e-02f, 4.293805361e-02f, 3.680723906e-02f, 3.067480214e-02f, 2.454121038e-02f, 1.840669475e-02f,
+    1.227148529e-02f, 6.135814823e-03f
+};
+
+/* init_dequantization(scales) */
+static const float relic_scales[RELIC_MAX_SCALES] = {
+    1.000000000e+01f, 3.333333206e+01f, 1.428571472e+02f, 6.666666870e+02f, 3.225806396e+03f, 1.587301562e+04f
+};
+
 static int apply_idct(const float *freq, float *wave, const float *dct, int dct_size) {
     int i;
     float factor;
@@ -217,14 +397,6 @@ static void decode_frame(const float *freq1, const float *freq2, float *wave_cur
     }
 }
 
-static void init_window(float *window, int dct_size) {
-    int i;
-
-    for (i = 0; i < dct_size; i++) {
-        window[i] = sin((float)i * (RELIC_PI / dct_size));
-    }
-}
-
 static void decode_frame_base(const float *freq1, const float *freq2, float *wave_cur, float *wave_prv, const float *dct, const float *window, int dct_mode, int samples_mode) {
     int i;
     float wave_tmp[RELIC_MAX_SIZE];
@@ -304,18 +476,6 @@ static int read_sbits(uint8_t bits, uint32_t offset, uint8_t *buf) {
     return outval;
 }
 
-static void init_dequantization(float* scales) {
-    int i;
-
-    scales[0] = RELIC_BASE_SCALE;
-    for (i = 1; i < RELIC_MAX_SCALES; i++) {
-        scales[i] = scales[i - 1] * scales[0];
-    }
-    for (i = 0; i < RELIC_MAX_SCALES; i++) {
-        scales[i] = RELIC_FREQUENCY_MASKING_FACTOR / (double) ((1 << (i + 1)) - 1) * scales[i];
-    }
-}
-
 static void unpack_frame(uint8_t *buf, int buf_size, float *freq1, float *freq2, const float* scales, uint8_t *exponents, int freq_size) {
     uint8_t flags, cb_bits, ev_bits, ei_bits, qv_bits;
     int qv;
@@ -423,9 +583,9 @@ static int decode_frame_next(VGMSTREAMCHANNEL* stream, relic_codec_data* data) {
         if (bytes != data->frame_size) goto fail;
         stream->offset += data->frame_size;
                     
-        unpack_frame(buf, sizeof(buf), data->freq1, data->freq2, data->scales, data->exponents[ch], data->freq_size);
+        unpack_frame(buf, sizeof(buf), data->freq1, data->freq2, relic_scales, data->exponents[ch], data->freq_size);
 
-        decode_frame_base(data->freq1, data->freq2, data->wave_cur[ch], data->wave_prv[ch], data->dct, data->window, data->dct_mode, data->samples_mode);
+        decode_frame_base(data->freq1, data->freq2, data->wave_cur[ch], data->wave_prv[ch], relic_dct, relic_window, data->dct_mode, data->samples_mode);
     }
 
     data->samples_consumed = 0;
@@ -478,9 +638,6 @@ static relic_codec_data* init_codec(int channels, int bitrate, int codec_rate) {
     data->dct_mode = RELIC_SIZE_HIGH;
     data->samples_mode = RELIC_SIZE_HIGH;
 
-    init_dct(data->dct, RELIC_SIZE_HIGH);
-    init_window(data->window, RELIC_SIZE_HIGH);
-    init_dequantization(data->scales);
     memset(data->wave_prv, 0, RELIC_MAX_CHANNELS * RELIC_MAX_SIZE * sizeof(float));
 
     switch(bitrate) {
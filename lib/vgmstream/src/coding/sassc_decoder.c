@@ -1,5 +1,6 @@
 #include "coding.h"
 #include "../util.h"
+#include "frame_walk.h"
 
 /* Activision / EXAKT Entertainment's DPCM for Supercar Street Challenge */
 
@@ -64,13 +65,17 @@ int32_t SASSC_steps[256] =
 };
 
 void decode_sassc(VGMSTREAMCHANNEL * stream, sample * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do) {
+    frame_walk_t fw;
     int i;
-    int32_t sample_count;
+    int32_t sample_count = 0;
     int32_t hist = stream->adpcm_history1_32;
 
-    for(i=first_sample,sample_count=0; i<first_sample+samples_to_do; i++,sample_count+=channelspacing) {
-        hist = hist + SASSC_steps[(uint8_t)read_8bit(stream->offset+i,stream->streamfile)];
-        outbuf[sample_count] = clamp16(hist);
+    /* a byte per sample, read in chunks (0xFF past EOF, as read_8bit gave) */
+    FRAME_WALK_PADDED(&fw, stream->streamfile, stream->offset, FRAME_WALK_MAX_BYTES, FRAME_WALK_MAX_BYTES, first_sample, samples_to_do, 0xFF) {
+        for (i = fw.first; i < fw.first + fw.count; i++, sample_count += channelspacing) {
+            hist = hist + SASSC_steps[fw.frame[i]];
+            outbuf[sample_count] = clamp16(hist);
+        }
     }
 
     stream->adpcm_history1_32 = hist;
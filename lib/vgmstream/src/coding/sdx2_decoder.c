@@ -1,6 +1,7 @@
 #include <math.h>
 #include "coding.h"
 #include "../util.h"
+#include "frame_walk.h"
 
 /* SDX2 - 2:1 Squareroot-delta-exact compression */
 /* CBD2 - 2:1 Cuberoot-delta-exact compression (from the unreleased 3DO M2) */
@@ -61,39 +62,48 @@ static int16_t cubes[256] = {
          29791, 31256, 31256
 };
 
+/* byte per sample, read in chunks of FRAME_WALK_MAX_BYTES (0xFF past EOF, as read_8bit gave) */
 static void decode_delta_exact(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do, int16_t * table) {
+    frame_walk_t fw;
     int32_t hist = stream->adpcm_history1_32;
 
     int i;
     int32_t sample_count = 0;
 
-    for (i=first_sample; i<first_sample+samples_to_do; i++,sample_count+=channelspacing) {
-        int8_t sample_byte = read_8bit(stream->offset+i,stream->streamfile);
-        int16_t sample;
+    FRAME_WALK_PADDED(&fw, stream->streamfile, stream->offset, FRAME_WALK_MAX_BYTES, FRAME_WALK_MAX_BYTES, first_sample, samples_to_do, 0xFF) {
+        for (i = fw.first; i < fw.first + fw.count; i++, sample_count += channelspacing) {
+            int8_t sample_byte = (int8_t)fw.frame[i];
+            int16_t sample;
 
-        if (!(sample_byte & 1)) hist = 0;
-        sample = hist + table[sample_byte+128];
+            if (!(sample_byte & 1)) hist = 0;
+            sample = hist + table[sample_byte+128];
 
-        hist = outbuf[sample_count] = clamp16(sample);
+            hist = outbuf[sample_count] = clamp16(sample);
+        }
     }
 
     stream->adpcm_history1_32 = hist;
 }
 
+/* same with channels interleaved per byte */
 static void decode_delta_exact_int(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do, int16_t * table) {
+    frame_walk_t fw;
     int32_t hist = stream->adpcm_history1_32;
+    int chunk_samples = FRAME_WALK_MAX_BYTES / channelspacing;
 
     int i;
     int32_t sample_count = 0;
 
-    for (i=first_sample; i<first_sample+samples_to_do; i++,sample_count+=channelspacing) {
-        int8_t sample_byte = read_8bit(stream->offset+i*channelspacing,stream->streamfile);
-        int16_t sample;
+    FRAME_WALK_PADDED(&fw, stream->streamfile, stream->offset, chunk_samples * channelspacing, chunk_samples, first_sample, samples_to_do, 0xFF) {
+        for (i = fw.first; i < fw.first + fw.count; i++, sample_count += channelspacing) {
+            int8_t sample_byte = (int8_t)fw.frame[i * channelspacing];
+            int16_t sample;
 
-        if (!(sample_byte & 1)) hist = 0;
-        sample = hist + table[sample_byte+128];
+            if (!(sample_byte & 1)) hist = 0;
+            sample = hist + table[sample_byte+128];
 
-        hist = outbuf[sample_count] = clamp16(sample);
+            hist = outbuf[sample_count] = clamp16(sample);
+        }
     }
 
     stream->adpcm_history1_32 = hist;
@@ -1,4 +1,5 @@
 #include "coding.h"
+#include "frame_walk.h"
 
 /* Decodes SunPlus' ADPCM codec used on the Tiger Game.com.
  * Reverse engineered from the Game.com's BIOS. */
@@ -17,26 +18,33 @@ static uint16_t slopeTable[64] =
 
 void decode_tgc(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int32_t first_sample, int32_t samples_to_do)
 {
-    for (int i = first_sample, sample_count = 0; i < first_sample + samples_to_do; i++, sample_count++)
+    frame_walk_t fw;
+    int sample_count = 0;
+
+    /* nibbles from the start of the file, read in chunks (0xFF past EOF, as read_8bit gave) */
+    FRAME_WALK_PADDED(&fw, stream->streamfile, 0, FRAME_WALK_MAX_BYTES, FRAME_WALK_MAX_BYTES * 2, first_sample, samples_to_do, 0xFF)
     {
-        uint8_t samp = ((uint8_t)read_8bit(i/2, stream->streamfile) >>
-            (i & 1 ? 4 : 0)) & 0xf;
+        for (int i = fw.first; i < fw.first + fw.count; i++, sample_count++)
+        {
+            uint8_t samp = (fw.frame[i/2] >>
+                (i & 1 ? 4 : 0)) & 0xf;
 
-        uint8_t slopeIndex = stream->adpcm_scale | (samp >> 1);
+            uint8_t slopeIndex = stream->adpcm_scale | (samp >> 1);
 
-        stream->adpcm_step_index = slopeTable[slopeIndex] >> 8;
-        stream->adpcm_scale      = slopeTable[slopeIndex] & 0xff;
+            stream->adpcm_step_index = slopeTable[slopeIndex] >> 8;
+            stream->adpcm_scale      = slopeTable[slopeIndex] & 0xff;
 
-        stream->adpcm_history1_16 += (samp & 1) ?
-            -stream->adpcm_step_index:
-             stream->adpcm_step_index;
+            stream->adpcm_history1_16 += (samp & 1) ?
+                -stream->adpcm_step_index:
+                 stream->adpcm_step_index;
 
-        if (stream->adpcm_history1_16 < 0)
-            stream->adpcm_history1_16 = 0;
+            if (stream->adpcm_history1_16 < 0)
+                stream->adpcm_history1_16 = 0;
 
-        if (stream->adpcm_history1_16 > 0xff)
-            stream->adpcm_history1_16 = 0xff;
+            if (stream->adpcm_history1_16 > 0xff)
+                stream->adpcm_history1_16 = 0xff;
 
-        outbuf[sample_count] = stream->adpcm_history1_16 * 0x100 - 0x8000;
+            outbuf[sample_count] = stream->adpcm_history1_16 * 0x100 - 0x8000;
+        }
     }
 }
\ No newline at end of file
@@ -67,10 +67,19 @@ typedef struct {
     int16_t unused5;
 } ubi_adpcm_channel_data;
 
+/* per-code values of the expand tables, so codes don't need converting */
+typedef struct {
+    int32_t step_next;      /* table1 */
+    int32_t step_add;       /* table2 */
+    int32_t delta_sign;     /* offset into delta_table */
+} ubi_adpcm_code_data;
+
 struct ubi_adpcm_codec_data {
     ubi_adpcm_header_data header;
     ubi_adpcm_channel_data ch[UBI_CHANNELS_MAX];
 
+    ubi_adpcm_code_data code_table[64];
+
     off_t start_offset;
     off_t offset;
     int subframe_number;
@@ -79,6 +88,9 @@ struct ubi_adpcm_codec_data {
     uint8_t codes[UBI_CODES_PER_SUBFRAME_MAX];
     int16_t samples[UBI_SAMPLES_PER_FRAME_MAX]; /* for all channels, saved in L-R-L-R form */
 
+    off_t samples_offset;   /* frame decoded in samples (-1 if none), reused when seeking into it */
+    int samples_subframe;
+    size_t samples_total;
     size_t samples_filled;
     size_t samples_consumed;
     size_t samples_to_discard;
@@ -87,6 +99,7 @@ struct ubi_adpcm_codec_data {
 /* *********************************************************************** */
 
 static int parse_header(STREAMFILE* sf, ubi_adpcm_codec_data *data, off_t offset);
+static void setup_code_table(ubi_adpcm_codec_data *data);
 static void decode_frame(STREAMFILE* sf, ubi_adpcm_codec_data *data);
 
 ubi_adpcm_codec_data *init_ubi_adpcm(STREAMFILE *sf, off_t offset, int channels) {
@@ -105,8 +118,11 @@ ubi_adpcm_codec_data *init_ubi_adpcm(STREAMFILE *sf, off_t offset, int channels)
         goto fail;
     }
 
+    setup_code_table(data);
+
     data->start_offset = offset + 0x30;
     data->offset = data->start_offset;
+    data->samples_offset = -1;
 
     return data;
 fail:
@@ -156,17 +172,45 @@ void decode_ubi_adpcm(VGMSTREAM * vgmstream, sample_t * outbuf, int32_t samples_
 void reset_ubi_adpcm(ubi_adpcm_codec_data *data) {
     if (!data) return;
 
-    data->offset = data->start_offset;
-    data->subframe_number = 0;
+    seek_ubi_adpcm(data, 0);
 }
 
+/* Frames carry the whole ADPCM state, and all but the last have the same size, so seeks go straight
+ * to the frame with the sample (or reuse it if already decoded, as when looping inside a frame). */
 void seek_ubi_adpcm(ubi_adpcm_codec_data *data, int32_t num_sample) {
+    int channels, bps, frame_number = 0;
+    size_t frame_size, frame_samples;
+
     if (!data) return;
 
-    //todo improve by seeking to closest frame
+    channels = data->header.channels;
+    bps = data->header.bits_per_sample;
+    frame_size = 0x34 * channels + (bps * data->header.codes_per_subframe / 8 + 0x01) * UBI_SUBFRAMES_PER_FRAME_MAX;
+    frame_samples = data->header.codes_per_subframe * UBI_SUBFRAMES_PER_FRAME_MAX / channels;
+
+    if (frame_samples > 0 && num_sample > 0) {
+        frame_number = num_sample / frame_samples;
+        /* past the end (only the last frame may be shorter, so any existing one is found this way) */
+        while (frame_number > 0 && frame_number * UBI_SUBFRAMES_PER_FRAME_MAX >= data->header.subframe_count)
+            frame_number--;
+    }
 
-    reset_ubi_adpcm(data);
-    data->samples_to_discard = num_sample;
+    data->offset = data->start_offset + frame_number * frame_size;
+    data->subframe_number = frame_number * UBI_SUBFRAMES_PER_FRAME_MAX;
+    data->samples_to_discard = num_sample - frame_number * frame_samples;
+
+    if (data->samples_offset == data->offset && data->samples_to_discard < data->samples_total) {
+        data->samples_consumed = data->samples_to_discard;
+        data->samples_filled = data->samples_total - data->samples_to_discard;
+        data->samples_to_discard = 0;
+
+        data->offset += frame_size;
+        data->subframe_number += UBI_SUBFRAMES_PER_FRAME_MAX;
+    }
+    else {
+        data->samples_consumed = 0;
+        data->samples_filled = 0;
+    }
 }
 
 void free_ubi_adpcm(ubi_adpcm_codec_data *data) {
@@ -175,6 +219,24 @@ void free_ubi_adpcm(ubi_adpcm_codec_data *data) {
     free(data);
 }
 
+/* all state is in data (frame reads only use offsets), so it's saved whole */
+void* save_ubi_adpcm(ubi_adpcm_codec_data *data, size_t *size) {
+    void *state;
+    if (!data) return NULL;
+
+    state = malloc(sizeof(ubi_adpcm_codec_data));
+    if (!state) return NULL;
+    memcpy(state, data, sizeof(ubi_adpcm_codec_data));
+    *size = sizeof(ubi_adpcm_codec_data);
+    return state;
+}
+
+void restore_ubi_adpcm(ubi_adpcm_codec_data *data, const void *state) {
+    if (!data || !state) return;
+
+    memcpy(data, state, sizeof(ubi_adpcm_codec_data));
+}
+
 
 /* ************************************************************************ */
 
@@ -271,13 +333,13 @@ int32_t delta_table[33+33] = {
 };
 
 
-static int sign16(int16_t test) {
+static inline int sign16(int16_t test) {
     return (test < 0 ? -1 : 1);
 }
-static int sign32(int32_t test) {
+static inline int sign32(int32_t test) {
     return (test < 0 ? -1 : 1);
 }
-static int16_t absmax16(int16_t val, int16_t absmax) {
+static inline int16_t absmax16(int16_t val, int16_t absmax) {
     if (val < 0) {
         if (val < -absmax) return -absmax;
     } else {
@@ -285,64 +347,66 @@ static int16_t absmax16(int16_t val, int16_t absmax) {
     }
     return val;
 }
-static int32_t clamp_val(int32_t val, int32_t min, int32_t max) {
-    if (val < min) return min;
-    else if (val > max) return max;
-    else return val;
+static inline int32_t clamp_step(int32_t val) {
+    return val < 271 ? 271 : (val > 2560 ? 2560 : val);
 }
 
+/* codes are 0..63 (6-bit, where 0=-31 .. 31=0 .. 63=32) or 0..15 (4-bit, where 0=-7 .. 7=0 .. 15=8) */
+static void setup_code_table(ubi_adpcm_codec_data *data) {
+    int code;
+    int code_count = data->header.bits_per_sample == 6 ? 64 : 16;
+    int code_zero = data->header.bits_per_sample == 6 ? 31 : 7;
 
-static int16_t expand_code_6bit(uint8_t code, ubi_adpcm_channel_data* state) {
-    int step0_index;
-    int32_t code_signed, step0_next, step0, delta0;
-    int32_t sample_new;
+    for (code = 0; code < code_count; code++) {
+        int code_signed = code - code_zero;
+        int step0_index = abs(code_signed); /* should only go up to 31/7 */
+        ubi_adpcm_code_data *entry = &data->code_table[code];
+
+        if (data->header.bits_per_sample == 6) {
+            entry->step_next = adpcm6_table1[step0_index];
+            entry->step_add = adpcm6_table2[step0_index];
+        }
+        else {
+            entry->step_next = adpcm4_table1[step0_index];
+            entry->step_add = adpcm4_table2[step0_index];
+        }
+        entry->delta_sign = (code_signed < 0 ? 33 : 0);
+    }
+}
 
-    code_signed = (int32_t)code - 31; /* convert coded 0..63 value to signed value, where 0=-31 .. 31=0 .. 63=32 */
-    step0_index = abs(code_signed); /* 0..32, but should only go up to 31 */
-    step0_next = adpcm6_table1[step0_index] + state->step1;
-    step0 = (state->step1 & 0xFFFF) * 246;
-    step0 = (step0 + adpcm6_table2[step0_index]) >> 8;
-    step0 = clamp_val(step0, 271, 2560);
+static inline int32_t expand_delta(const ubi_adpcm_code_data *code, int32_t step1) {
+    int32_t step0_next = code->step_next + step1;
 
-    delta0 = 0;
     if (!(((step0_next & 0xFFFFFF00) - 1) & (1 << 31))) {
-        int delta0_index = ((step0_next >> 3) & 0x1F) + (code_signed < 0 ? 33 : 0);
-        int delta0_shift = clamp_val((step0_next >> 8) & 0xFF, 0,31);
-        delta0 = (delta_table[delta0_index] << delta0_shift) >> 10;
+        int delta0_index = ((step0_next >> 3) & 0x1F) + code->delta_sign;
+        int delta0_shift = (step0_next >> 8) & 0xFF;
+        if (delta0_shift > 31)
+            delta0_shift = 31;
+        return (delta_table[delta0_index] << delta0_shift) >> 10;
     }
+    return 0;
+}
 
-    sample_new = (int16_t)(delta0 + state->delta1 + state->hist1);
+static inline int16_t expand_code_6bit(const ubi_adpcm_code_data *code, ubi_adpcm_channel_data* state) {
+    int32_t delta0 = expand_delta(code, state->step1);
+    int32_t sample_new;
 
-    state->hist1 = sample_new;
+    state->step1 = clamp_step(((state->step1 & 0xFFFF) * 246 + code->step_add) >> 8);
 
-    state->step1 = step0;
+    sample_new = (int16_t)(delta0 + state->delta1 + state->hist1);
 
+    state->hist1 = sample_new;
     state->delta1 = delta0;
-
-    VGM_ASSERT(step0_index > 31, "UBI ADPCM: index over 31\n");
     return sample_new;
 }
 
 /* may be simplified (masks, saturation, etc) as some values should never happen in the encoder */
-static int16_t expand_code_4bit(uint8_t code, ubi_adpcm_channel_data* state) {
-    int step0_index;
-    int32_t code_signed, step0_next, step0, delta0, next0, coef1_next, coef2_next;
+static inline int16_t expand_code_4bit(const ubi_adpcm_code_data *code, ubi_adpcm_channel_data* state) {
+    int32_t step0, delta0, next0, coef1_next, coef2_next;
     int32_t sample_new;
 
-
-    code_signed = (int32_t)code - 7; /* convert coded 0..15 value to signed value, where 0=-7 .. 7=0 .. 15=8 */
-    step0_index = abs(code_signed); /*  0..8, but should only go up to 7 */
-    step0_next = adpcm4_table1[step0_index] + state->step1;
-    step0 = (state->step1 & 0xFFFF) * 246;
-    step0 = (step0 + adpcm4_table2[step0_index]) >> 8;
-    step0 = clamp_val(step0, 271, 2560);
-
-    delta0 = 0;
-    if (!(((step0_next & 0xFFFFFF00) - 1) & (1 << 31))) {
-        int delta0_index = ((step0_next >> 3) & 0x1F) + (code_signed < 0 ? 33 : 0);
-        int delta0_shift = clamp_val((step0_next >> 8) & 0xFF, 0,31);
-        delta0 = (delta_table[delta0_index] << delta0_shift) >> 10;
-    }
+    delta0 = expand_delta(code, state->step1);
+    step0 = clamp_step(((state->step1 & 0xFFFF) * 246 + code->step_add) >> 8);
 
     next0 = (int16_t)((
             (state->mod1 * state->delta1) + (state->mod2 * state->delta2) +
@@ -391,59 +455,54 @@ static int16_t expand_code_4bit(uint8_t code, ubi_adpcm_channel_data* state) {
     state->mod2 = clamp16(state->mod2 * 255 + 2048 * sign16(state->delta1) * sign16(state->delta3)) >> 8;
     state->mod1 = clamp16(state->mod1 * 255 + 2048 * sign16(state->delta1) * sign16(state->delta2)) >> 8;
 
-    VGM_ASSERT(step0_index > 7, "UBI ADPCM: index over 7\n");
     return sample_new;
 }
 
-static void decode_subframe_mono(ubi_adpcm_channel_data* ch_state, uint8_t* codes, int16_t* samples, int code_count, int bps) {
+static void decode_subframe_mono(const ubi_adpcm_code_data *table, ubi_adpcm_channel_data* ch_state, uint8_t* codes, int16_t* samples, int code_count, int bps) {
     int i;
-    int16_t (*expand_code)(uint8_t,ubi_adpcm_channel_data*) = NULL;
 
-    if (bps == 6)
-        expand_code = expand_code_6bit;
-    else
-        expand_code = expand_code_4bit;
-
-    for (i = 0; i < code_count; i++) {
-        samples[i] = expand_code(codes[i], ch_state);
+    if (bps == 6) {
+        for (i = 0; i < code_count; i++) {
+            samples[i] = expand_code_6bit(&table[codes[i]], ch_state);
+        }
+    }
+    else {
+        for (i = 0; i < code_count; i++) {
+            samples[i] = expand_code_4bit(&table[codes[i]], ch_state);
+        }
     }
 }
 
-static void decode_subframe_stereo(ubi_adpcm_channel_data* ch0_state, ubi_adpcm_channel_data* ch1_state, uint8_t* codes, int16_t* samples, int code_count, int bps) {
-    int i;
-    int16_t (*expand_code)(uint8_t,ubi_adpcm_channel_data*) = NULL;
-
-    if (bps == 6)
-        expand_code = expand_code_6bit;
-    else
-        expand_code = expand_code_4bit;
-
-    for (i = 0; i < code_count; i += 8) {
-        samples[i + 0] = expand_code(codes[i + 0], ch0_state);
-        samples[i + 1] = expand_code(codes[i + 2], ch0_state);
-        samples[i + 2] = expand_code(codes[i + 4], ch0_state);
-        samples[i + 3] = expand_code(codes[i + 6], ch0_state);
-        samples[i + 4] = expand_code(codes[i + 1], ch1_state);
-        samples[i + 5] = expand_code(codes[i + 3], ch1_state);
-        samples[i + 6] = expand_code(codes[i + 5], ch1_state);
-        samples[i + 7] = expand_code(codes[i + 7], ch1_state);
+/* codes alternate channels, decoded in groups of 8 as mid/side (L = ch0 + ch1, R = ch0 - ch1) */
+#define UBI_STEREO_GROUP(expand_code) \
+    for (i = 0; i < code_count; i += 8) { \
+        int16_t m0 = expand_code(&table[codes[i + 0]], ch0_state); \
+        int16_t m1 = expand_code(&table[codes[i + 2]], ch0_state); \
+        int16_t m2 = expand_code(&table[codes[i + 4]], ch0_state); \
+        int16_t m3 = expand_code(&table[codes[i + 6]], ch0_state); \
+        int16_t s0 = expand_code(&table[codes[i + 1]], ch1_state); \
+        int16_t s1 = expand_code(&table[codes[i + 3]], ch1_state); \
+        int16_t s2 = expand_code(&table[codes[i + 5]], ch1_state); \
+        int16_t s3 = expand_code(&table[codes[i + 7]], ch1_state); \
+        samples[i + 0] = clamp16(m0 + s0); \
+        samples[i + 1] = clamp16(m0 - s0); \
+        samples[i + 2] = clamp16(m1 + s1); \
+        samples[i + 3] = clamp16(m1 - s1); \
+        samples[i + 4] = clamp16(m2 + s2); \
+        samples[i + 5] = clamp16(m2 - s2); \
+        samples[i + 6] = clamp16(m3 + s3); \
+        samples[i + 7] = clamp16(m3 - s3); \
     }
 
-    for (i = 0; i < code_count; i += 8) {
-        int16_t samples_old[8];
-        memcpy(samples_old, samples, sizeof(samples_old));
-
-        samples[0] = clamp16(samples_old[0] + samples_old[4]);
-        samples[1] = clamp16(samples_old[0] - samples_old[4]);
-        samples[2] = clamp16(samples_old[1] + samples_old[5]);
-        samples[3] = clamp16(samples_old[1] - samples_old[5]);
-
-        samples[4] = clamp16(samples_old[2] + samples_old[6]);
-        samples[5] = clamp16(samples_old[2] - samples_old[6]);
-        samples[6] = clamp16(samples_old[3] + samples_old[7]);
-        samples[7] = clamp16(samples_old[3] - samples_old[7]);
+static void decode_subframe_stereo(const ubi_adpcm_code_data *table, ubi_adpcm_channel_data* ch0_state, ubi_adpcm_channel_data* ch1_state, uint8_t* codes, int16_t* samples, int code_count, int bps) {
+    int i;
 
-        samples += 8;
+    /* groups past code_count (odd last subframes) use leftover codes, as the original decoder */
+    if (bps == 6) {
+        UBI_STEREO_GROUP(expand_code_6bit);
+    }
+    else {
+        UBI_STEREO_GROUP(expand_code_4bit);
     }
 }
 
@@ -455,13 +514,46 @@ static void decode_subframe_stereo(ubi_adpcm_channel_data* ch0_state, ubi_adpcm_
  *    0xA82557DB LE = 1010 100000 100101 010101 111101 1011 ... (where last 00 | first 1010 = 001010), etc
  * Codes aren't signed but rather have a particular meaning (see decoding).
  */
-void unpack_codes(uint8_t *data, uint8_t* codes, int code_count, int bps) {
-    int i;
+static void unpack_codes(uint8_t *data, uint8_t* codes, int code_count, int bps) {
+    int i = 0;
     size_t pos = 0;
     uint64_t bits = 0, input = 0;
     const uint64_t mask = (bps == 6) ? 0x3f : 0x0f;
 
-    for (i = 0; i < code_count; i++) {
+    /* whole words at once (8 codes per 32b for 4-bit, 16 per 96b for 6-bit), then any rest */
+    if (bps == 4) {
+        for (; i + 8 <= code_count; i += 8) {
+            uint32_t word = get_u32le(data + pos);
+            pos += 0x04;
+
+            codes[i + 0] = (word >> 28) & 0xf;
+            codes[i + 1] = (word >> 24) & 0xf;
+            codes[i + 2] = (word >> 20) & 0xf;
+            codes[i + 3] = (word >> 16) & 0xf;
+            codes[i + 4] = (word >> 12) & 0xf;
+            codes[i + 5] = (word >>  8) & 0xf;
+            codes[i + 6] = (word >>  4) & 0xf;
+            codes[i + 7] = (word >>  0) & 0xf;
+        }
+    }
+    else {
+        for (; i + 16 <= code_count; i += 16) {
+            uint64_t hi = ((uint64_t)get_u32le(data + pos + 0x00) << 32) | get_u32le(data + pos + 0x04);
+            uint32_t lo = get_u32le(data + pos + 0x08);
+            int j;
+            pos += 0x0c;
+
+            for (j = 0; j < 10; j++) {
+                codes[i + j] = (hi >> (58 - j * 6)) & 0x3f;
+            }
+            codes[i + 10] = ((hi & 0xf) << 2) | (lo >> 30);
+            for (j = 0; j < 5; j++) {
+                codes[i + 11 + j] = (lo >> (24 - j * 6)) & 0x3f;
+            }
+        }
+    }
+
+    for (; i < code_count; i++) {
         if (bits < bps) {
             uint32_t source32le = (uint32_t)get_32bitLE(data + pos);
             pos += 0x04;
@@ -556,27 +648,29 @@ static void decode_frame(STREAMFILE* sf, ubi_adpcm_codec_data *data) {
         read_channel_state(data->frame + 0x00, &data->ch[0]);
 
         unpack_codes(data->frame + 0x34, data->codes, code_count_a, bps);
-        decode_subframe_mono(&data->ch[0], data->codes, &data->samples[0], code_count_a, bps);
+        decode_subframe_mono(data->code_table, &data->ch[0], data->codes, &data->samples[0], code_count_a, bps);
 
         unpack_codes(data->frame + 0x34 + subframe_size_a, data->codes, code_count_b, bps);
-        decode_subframe_mono(&data->ch[0], data->codes, &data->samples[code_count_a], code_count_b, bps);
+        decode_subframe_mono(data->code_table, &data->ch[0], data->codes, &data->samples[code_count_a], code_count_b, bps);
     }
     else if (channels == 2) {
         read_channel_state(data->frame + 0x00, &data->ch[0]);
         read_channel_state(data->frame + 0x34, &data->ch[1]);
 
         unpack_codes(data->frame + 0x68, data->codes, code_count_a, bps);
-        decode_subframe_stereo(&data->ch[0], &data->ch[1], data->codes, &data->samples[0], code_count_a, bps);
+        decode_subframe_stereo(data->code_table, &data->ch[0], &data->ch[1], data->codes, &data->samples[0], code_count_a, bps);
 
         unpack_codes(data->frame + 0x68 + subframe_size_a, data->codes, code_count_b, bps);
-        decode_subframe_stereo(&data->ch[0], &data->ch[1], data->codes, &data->samples[code_count_a], code_count_b, bps);
+        decode_subframe_stereo(data->code_table, &data->ch[0], &data->ch[1], data->codes, &data->samples[code_count_a], code_count_b, bps);
     }
 
     /* frame done */
+    data->samples_offset = data->offset;
     data->offset += frame_size;
     data->subframe_number += 2;
     data->samples_consumed = 0;
-    data->samples_filled = (code_count_a + code_count_b) / channels;
+    data->samples_total = (code_count_a + code_count_b) / channels;
+    data->samples_filled = data->samples_total;
 }
 
 
@@ -1,5 +1,10 @@
 #include "coding.h"
 #include "../util.h"
+#include "../pool.h"
+#include "../cpu.h"
+
+/* for channels without a code book (files only set the first channel's), was zeroed in the old fixed array */
+static const int16_t vadpcm_empty_coefs[VGMSTREAM_VADPCM_COEFS] = {0};
 
 
 /* Decodes Silicon Graphics' N64 VADPCM, big brother of GC ADPCM.
@@ -12,28 +17,50 @@
  * implementation. Output sounds correct though.
  */
 
+/* Sub-frame decoding ends up as (for order 2, where coefs[o] are coefs[index][o][0..7]):
+ *   out[i] = (coefs[0][i] * hist2 + coefs[1][i] * hist1 + (code[i] << 11) + sum(k < i) code[i-1-k] * coefs[1][k]) >> 11
+ * so each table is expanded once into a matrix of 10 columns (hist2, hist1, 8 codes) by 8 rows, and
+ * a sub-frame is a matrix-vector product plus clamps (see cpu.c). Since codes are nibble * scale,
+ * nibbles go in the product and the scale is applied to the sum. Columns are stored in pairs
+ * (VGMSTREAM_VADPCM_MATRIX values) for the kernels. */
+static void vadpcm_expand_matrix(int16_t* matrix, const int16_t* coefs) {
+    int i, j;
+
+    for (j = 0; j < 10; j++) {
+        for (i = 0; i < 8; i++) {
+            int16_t value;
+            if (j < 2)
+                value = coefs[j*8 + i];
+            else if (i == j - 2)
+                value = 1 << 11;
+            else if (i > j - 2)
+                value = coefs[1*8 + (i - 1 - (j - 2))];
+            else
+                value = 0;
+            matrix[(j / 2)*16 + i*2 + (j % 2)] = value;
+        }
+    }
+}
+
 void decode_vadpcm(VGMSTREAMCHANNEL* stream, sample_t* outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do, int order) {
     uint8_t frame[0x09] = {0};
     off_t frame_offset;
     int frames_in, sample_count = 0;
     size_t bytes_per_frame, samples_per_frame;
-    int i, j, k, o;
+    int i, j;
     int scale, index;
 
-    int codes[16]; /* AKA ix */
-    int16_t hist[8] = {0};
+    int16_t nibbles[16]; /* AKA ix, before scaling */
     int16_t out[16];
-    int16_t* coefs;
+    int16_t temp_matrix[VGMSTREAM_VADPCM_MATRIX];
+    const int16_t* matrix;
+    const vgm_kernels_t* kernels = vgm_get_kernels();
 
 
     VGM_ASSERT_ONCE(order != 2, "VADPCM: wrong order=%i\n", order);
     if (order != 2) /* only 2 allowed "in the current implementation" */
         order = 2;
 
-    /* up to 8 (hist[0]=oldest) but only uses latest 2 (order=2), so we don't save the whole thing ATM */
-    hist[6] = stream->adpcm_history2_16;
-    hist[7] = stream->adpcm_history1_16;
-
 
     /* external interleave (fixed size), mono */
     bytes_per_frame = 0x09;
@@ -47,15 +74,21 @@ void decode_vadpcm(VGMSTREAMCHANNEL* stream, sample_t* outbuf, int channelspacin
     scale = (frame[0] >> 4) & 0xF;
     index = (frame[0] >> 0) & 0xF;
 
-    scale = 1 << scale;
+    VGM_ASSERT_ONCE(index > 7, "DSP: incorrect index at %x\n", (uint32_t)frame_offset);
+    if (index > 7) /* assumed (max 8 groups) */
+        index = 7;
 
-    VGM_ASSERT_ONCE(index > 8, "DSP: incorrect index at %x\n", (uint32_t)frame_offset);
-    if (index > 8) /* assumed */
-        index = 8;
-    coefs = &stream->vadpcm_coefs[index * (order*8) + 0];
+    if (stream->vadpcm_book) {
+        matrix = stream->vadpcm_book + index * VGMSTREAM_VADPCM_MATRIX;
+    }
+    else {
+        const int16_t* coefs = (stream->vadpcm_coefs ? stream->vadpcm_coefs : vadpcm_empty_coefs) + index * (order*8);
+        vadpcm_expand_matrix(temp_matrix, coefs);
+        matrix = temp_matrix;
+    }
 
 
-    /* read and pre-scale all nibbles, since groups of 8 are needed */
+    /* read all nibbles, since groups of 8 are needed (scale = 1 << shift applied in the kernel) */
     for (i = 0, j = 0; i < 16; i += 2, j++) {
         int n0 = (frame[j+1] >> 4) & 0xF;
         int n1 = (frame[j+1] >> 0) & 0xF;
@@ -66,50 +99,14 @@ void decode_vadpcm(VGMSTREAMCHANNEL* stream, sample_t* outbuf, int channelspacin
         if (n1 & 8)
             n1 = n1 - 16;
 
-        codes[i+0] = n0 * scale;
-        codes[i+1] = n1 * scale;
+        nibbles[i+0] = n0;
+        nibbles[i+1] = n1;
     }
 
-    /* decode 2 sub-frames of 8 samples (maybe like this since N64 MIPS has registers to spare?) */
-    for (j = 0; j < 2; j++) {
-        /* SDK dec code and N64ST copy 8 codes to a tmp buf and has some complex logic to move out buf
-         * around, but since that's useless N64 asm would be much more optimized... hopefully */
-        int* sf_codes = &codes[j*8];
-        int16_t* sf_out = &out[j*8];
-
-        /* works with 8 samples at a time, related in twisted ways */
-        for( i = 0; i < 8; i++) {
-            int sample, delta = 0;
-
-            /* in practice: delta = coefs[0][i] * hist[6] + coefs[1][i] * hist[7],
-             * much like XA's coef1*hist1 + coef2*hist2 but with multi coefs */
-            for (o = 0; o < order; o++) {
-                delta += coefs[o*8 + i] * hist[(8 - order) + o];
-            }
-
-            /* adds all previous samples */
-            for (k = i-1; k > -1; k--) {
-                for (o = 1; o < order; o++) { /* assumed, since only goes coefs[1][k] */
-                    delta += sf_codes[(i-1) - k] * coefs[(o*8) + k];
-                }
-            }
-
-            /* scale-filter thing (also seen in DSP) */
-            sample = (sf_codes[i] << 11);
-            sample = (sample + delta) >> 11;
-            if (sample > 32767)
-                sample = 32767;
-            else if (sample < -32768)
-                sample = -32768;
-
-            sf_out[i] = sample;
-        }
-
-        /* save subframe hist */
-        for (i = 8 - order; i < 8; i++) {
-            hist[i] = sf_out[i];
-        }
-    }
+    /* decode 2 sub-frames of 8 samples, each using the last 2 samples of the previous one
+     * (only latest 2 hist are used with order=2, so we don't save the whole 8 ATM) */
+    kernels->vadpcm_subframe(&out[0], matrix, &nibbles[0], scale, stream->adpcm_history2_16, stream->adpcm_history1_16);
+    kernels->vadpcm_subframe(&out[8], matrix, &nibbles[8], scale, out[6], out[7]);
 
 
     /* copy samples last, since the whole thing is kinda complex to worry about half copying and stuff */
@@ -120,8 +117,8 @@ void decode_vadpcm(VGMSTREAMCHANNEL* stream, sample_t* outbuf, int channelspacin
 
     /* update hist once all frame is actually copied */
     if (first_sample + sample_count == samples_per_frame) {
-        stream->adpcm_history2_16 = hist[6];
-        stream->adpcm_history1_16 = hist[7];
+        stream->adpcm_history2_16 = out[14];
+        stream->adpcm_history1_16 = out[15];
     }
 }
 
@@ -148,8 +145,22 @@ void vadpcm_read_coefs_be(VGMSTREAM* vgmstream, STREAMFILE* sf, off_t offset, in
         order = 2;
 
     /* assumes all channels use same coefs, never seen non-mono files */
+    if (!vgmstream->ch[ch].vadpcm_coefs)
+        vgmstream->ch[ch].vadpcm_coefs = pool_arena_calloc(vgmstream->arena, VGMSTREAM_VADPCM_COEFS, sizeof(int16_t));
+    if (!vgmstream->ch[ch].vadpcm_coefs)
+        return;
+
     for (i = 0; i < entries * order * 8; i++) {
         vgmstream->ch[ch].vadpcm_coefs[i] = read_s16be(offset + i*2, sf);
     }
+
+    /* decoder matrices, for all entries (unused ones are zeroed coefs like in the decoder) */
+    if (!vgmstream->ch[ch].vadpcm_book)
+        vgmstream->ch[ch].vadpcm_book = pool_arena_calloc(vgmstream->arena, VGMSTREAM_VADPCM_BOOK, sizeof(int16_t));
+    if (vgmstream->ch[ch].vadpcm_book) {
+        for (i = 0; i < 8; i++) {
+            vadpcm_expand_matrix(vgmstream->ch[ch].vadpcm_book + i * VGMSTREAM_VADPCM_MATRIX, vgmstream->ch[ch].vadpcm_coefs + i * (order*8));
+        }
+    }
     vgmstream->codec_config = order;
 }
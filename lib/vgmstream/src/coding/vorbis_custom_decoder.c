@@ -6,8 +6,10 @@
 #include <vorbis/codec.h>
 
 #define VORBIS_DEFAULT_BUFFER_SIZE 0x8000 /* should be at least the size of the setup header, ~0x2000 */
+#define VORBIS_DEFAULT_IBUF_SIZE 0x8000 /* max size of a custom packet to rebuild */
 
 static void pcm_convert_float_to_16(int channels, sample_t * outbuf, int samples_to_do, float ** pcm);
+static void pcm_convert_float(int channels, float * outbuf, int samples_to_do, float ** pcm);
 
 /**
  * Inits a vorbis stream of some custom variety.
@@ -27,9 +29,13 @@ vorbis_custom_codec_data * init_vorbis_custom(STREAMFILE *streamFile, off_t star
     data = calloc(1,sizeof(vorbis_custom_codec_data));
     if (!data) goto fail;
 
+    /* packet arena: one block reused for every packet, the output packet first, then the scratch to
+     * rebuild custom packets (packets that need no changes are given to libvorbis in place if possible) */
     data->buffer_size = VORBIS_DEFAULT_BUFFER_SIZE;
-    data->buffer = calloc(sizeof(uint8_t), data->buffer_size);
+    data->ibuf_size = VORBIS_DEFAULT_IBUF_SIZE;
+    data->buffer = calloc(sizeof(uint8_t), data->buffer_size + data->ibuf_size);
     if (!data->buffer) goto fail;
+    data->ibuf = data->buffer + data->buffer_size;
 
     /* keep around to decode too */
     data->type = type;
@@ -74,19 +80,18 @@ fail:
     return NULL;
 }
 
-/* Decodes Vorbis packets into a libvorbis sample buffer, and copies them to outbuf */
-void decode_vorbis_custom(VGMSTREAM * vgmstream, sample_t * outbuf, int32_t samples_to_do, int channels) {
+/* Decodes Vorbis packets into a libvorbis sample buffer, and copies them to outbuf or outbuf_f (the other is NULL) */
+static void decode_vorbis_custom_internal(VGMSTREAM * vgmstream, sample_t * outbuf, float * outbuf_f, int32_t samples_to_do, int channels) {
     VGMSTREAMCHANNEL *stream = &vgmstream->ch[0];
     vorbis_custom_codec_data * data = vgmstream->codec_data;
     size_t stream_size =  get_streamfile_size(stream->streamfile);
-    //data->op.packet = data->buffer;/* implicit from init */
+    /* data->op.packet is set by each parser, to the buffer or to the streamfile's memory */
     int samples_done = 0;
 
     while (samples_done < samples_to_do) {
 
         /* extra EOF check for edge cases */
         if (stream->offset >= stream_size) {
-            memset(outbuf + samples_done * channels, 0, (samples_to_do - samples_done) * sizeof(sample) * channels);
             break;
         }
 
@@ -109,10 +114,13 @@ void decode_vorbis_custom(VGMSTREAM * vgmstream, sample_t * outbuf, int32_t samp
                 data->samples_to_discard -= samples_to_get;
             }
             else {
-                /* get max samples and convert from Vorbis float pcm to 16bit pcm */
+                /* get max samples and convert from Vorbis float pcm to 16bit pcm (or just interleave) */
                 if (samples_to_get > samples_to_do - samples_done)
                     samples_to_get = samples_to_do - samples_done;
-                pcm_convert_float_to_16(data->vi.channels, outbuf + samples_done * channels, samples_to_get, pcm);
+                if (outbuf_f)
+                    pcm_convert_float(data->vi.channels, outbuf_f + samples_done * channels, samples_to_get, pcm);
+                else
+                    pcm_convert_float_to_16(data->vi.channels, outbuf + samples_done * channels, samples_to_get, pcm);
                 samples_done += samples_to_get;
             }
 
@@ -158,12 +166,30 @@ void decode_vorbis_custom(VGMSTREAM * vgmstream, sample_t * outbuf, int32_t samp
         }
     }
 
-    return;
+    /* EOF: just put some 0 samples */
+    goto decode_end;
 
 decode_fail:
     /* on error just put some 0 samples */
     VGM_LOG("VORBIS: decode fail at %x, missing %i samples\n", (uint32_t)stream->offset, (samples_to_do - samples_done));
-    memset(outbuf + samples_done * channels, 0, (samples_to_do - samples_done) * channels * sizeof(sample));
+decode_end:
+    if (outbuf_f)
+        memset(outbuf_f + samples_done * channels, 0, (samples_to_do - samples_done) * channels * sizeof(float));
+    else
+        memset(outbuf + samples_done * channels, 0, (samples_to_do - samples_done) * channels * sizeof(sample));
+}
+
+void decode_vorbis_custom(VGMSTREAM * vgmstream, sample_t * outbuf, int32_t samples_to_do, int channels) {
+    decode_vorbis_custom_internal(vgmstream, outbuf, NULL, samples_to_do, channels);
+}
+
+/* same but to float, skipping the 16-bit conversion (Vorbis is float internally) */
+void decode_vorbis_custom_float(VGMSTREAM * vgmstream, float * outbuf, int32_t samples_to_do, int channels) {
+    decode_vorbis_custom_internal(vgmstream, NULL, outbuf, samples_to_do, channels);
+}
+
+int vorbis_custom_can_decode_float(vorbis_custom_codec_data * data) {
+    return data != NULL;
 }
 
 /* converts from internal Vorbis format to standard PCM (mostly from Xiph's decoder_example.c) */
@@ -189,6 +215,22 @@ static void pcm_convert_float_to_16(int channels, sample_t * outbuf, int samples
     }
 }
 
+/* interleaves internal Vorbis float PCM as-is (nominally -1.0..1.0, not clamped) */
+static void pcm_convert_float(int channels, float * outbuf, int samples_to_do, float ** pcm) {
+    int ch, s;
+    float *ptr;
+    float *channel;
+
+    for (ch = 0; ch < channels; ch++) {
+        ptr = outbuf + ch;
+        channel = pcm[ch];
+        for (s = 0; s < samples_to_do; s++) {
+            *ptr = channel[s];
+            ptr += channels;
+        }
+    }
+}
+
 /* ********************************************** */
 
 void free_vorbis_custom(vorbis_custom_codec_data * data) {
@@ -50,17 +50,15 @@ fail:
 
 
 int vorbis_custom_parse_packet_ogl(VGMSTREAMCHANNEL *stream, vorbis_custom_codec_data *data) {
-    size_t bytes;
-
     /* get next packet size from the OGL 16b header (upper 14b) */
     data->op.bytes = (uint16_t)read_16bitLE(stream->offset, stream->streamfile) >> 2;
     stream->offset += 2;
     if (data->op.bytes == 0 || data->op.bytes == 0xFFFF || data->op.bytes > data->buffer_size) goto fail; /* EOF or end padding */
 
-    /* read raw block */
-    bytes = read_streamfile(data->buffer,stream->offset, data->op.bytes,stream->streamfile);
+    /* raw block is a standard packet, so point to it in place when the streamfile allows */
+    if (stream->offset + data->op.bytes > get_streamfile_size(stream->streamfile)) goto fail; /* wrong packet? */
+    data->op.packet = (unsigned char *)read_streamfile_ptr(data->buffer, stream->offset, data->op.bytes, stream->streamfile);
     stream->offset += data->op.bytes;
-    if (bytes != data->op.bytes) goto fail; /* wrong packet? */
 
     return 1;
 
@@ -76,17 +76,23 @@ int vorbis_custom_parse_packet_sk(VGMSTREAMCHANNEL *stream, vorbis_custom_codec_
     data->current_packet++;
     if (!res || packet_size > data->buffer_size) goto fail;
 
-    /* read raw block */
-    data->op.bytes = read_streamfile(data->buffer, packet_offset, packet_size, stream->streamfile);
-    if (data->op.bytes != packet_size) goto fail; /* wrong packet? */
+    if (packet_offset + packet_size > get_streamfile_size(stream->streamfile)) goto fail; /* wrong packet? */
 
     /* go next page when processed all packets in page */
     if (data->current_packet >= page_packets) {
-        if (!get_page_info(stream->streamfile, stream->offset, &packet_offset, &packet_size, &page_packets, -1)) goto fail;
-        stream->offset = packet_offset + packet_size;
+        off_t page_end_offset;
+        size_t page_end_size;
+
+        if (!get_page_info(stream->streamfile, stream->offset, &page_end_offset, &page_end_size, &page_packets, -1)) goto fail;
+        stream->offset = page_end_offset + page_end_size;
         data->current_packet = 0;
     }
 
+    /* raw block is a standard packet, so point to it in place when the streamfile allows
+     * (last, as other reads may invalidate it) */
+    data->op.bytes = packet_size;
+    data->op.packet = (unsigned char *)read_streamfile_ptr(data->buffer, packet_offset, packet_size, stream->streamfile);
+
     return 1;
 
 fail:
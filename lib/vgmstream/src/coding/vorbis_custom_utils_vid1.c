@@ -54,7 +54,7 @@ fail:
 
 
 int vorbis_custom_parse_packet_vid1(VGMSTREAMCHANNEL *stream, vorbis_custom_codec_data *data) {
-    size_t bytes;
+    off_t packet_offset;
 
 
     /* test block start */
@@ -77,10 +77,9 @@ int vorbis_custom_parse_packet_vid1(VGMSTREAMCHANNEL *stream, vorbis_custom_code
     get_packet_header(stream->streamfile, &stream->offset, (uint32_t*)&data->op.bytes);
     if (data->op.bytes == 0 || data->op.bytes > data->buffer_size) goto fail; /* EOF or end padding */
 
-    /* read raw block */
-    bytes = read_streamfile(data->buffer,stream->offset, data->op.bytes,stream->streamfile);
+    if (stream->offset + data->op.bytes > get_streamfile_size(stream->streamfile)) goto fail; /* wrong packet? */
+    packet_offset = stream->offset;
     stream->offset += data->op.bytes;
-    if (bytes != data->op.bytes) goto fail; /* wrong packet? */
 
     //todo: sometimes there are short packets like 01be590000 and Vorbis complains and skips, no idea
 
@@ -89,6 +88,10 @@ int vorbis_custom_parse_packet_vid1(VGMSTREAMCHANNEL *stream, vorbis_custom_code
         stream->offset = data->block_offset + read_32bitBE(data->block_offset + 0x04,stream->streamfile);
     }
 
+    /* raw block is a standard packet, so point to it in place when the streamfile allows
+     * (last, as other reads may invalidate it) */
+    data->op.packet = (unsigned char *)read_streamfile_ptr(data->buffer, packet_offset, data->op.bytes, stream->streamfile);
+
     return 1;
 
 fail:
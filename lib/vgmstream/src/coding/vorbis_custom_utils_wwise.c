@@ -1,5 +1,44 @@
 #include "vorbis_custom_decoder.h"
 
+
+/* Rebuilt setup packets of the last Wwise setups, as hashes of their Wwise setup (plus config),
+ * so banks of .wem sharing codebooks don't rebuild them (and reload external ones) for every stream.
+ * Only enabled with vgmstream_wwise_setup_cache_setup. Older entries are dropped.
+ * (outside VGM_USE_VORBIS so hosts can call the setup regardless) */
+#define WWISE_SETUP_CACHE_SIZE 16
+
+static struct {
+    int enabled;
+    struct {
+        uint64_t key;
+        uint8_t* setup;
+        size_t setup_size;
+        uint8_t mode_blockflag[64+1];
+        int mode_bits;
+    } entries[WWISE_SETUP_CACHE_SIZE];
+    int count;
+    int next;
+    void (*lock)(void*);
+    void (*unlock)(void*);
+    void* lock_data;
+} wwise_setup_cache;
+
+void vgmstream_wwise_setup_cache_setup(int enabled, void (*lock)(void*), void (*unlock)(void*), void* lock_data) {
+    int i;
+
+    for (i = 0; i < wwise_setup_cache.count; i++) {
+        free(wwise_setup_cache.entries[i].setup);
+        wwise_setup_cache.entries[i].setup = NULL;
+    }
+
+    wwise_setup_cache.enabled = enabled;
+    wwise_setup_cache.count = 0;
+    wwise_setup_cache.next = 0;
+    wwise_setup_cache.lock = lock;
+    wwise_setup_cache.unlock = unlock;
+    wwise_setup_cache.lock_data = lock_data;
+}
+
 #ifdef VGM_USE_VORBIS
 #include <vorbis/codec.h>
 
@@ -24,6 +63,7 @@ static int ww2ogg_generate_vorbis_setup(vgm_bitstream * ow, vgm_bitstream * iw,
 static int ww2ogg_codebook_library_copy(vgm_bitstream * ow, vgm_bitstream * iw);
 static int ww2ogg_codebook_library_rebuild(vgm_bitstream * ow, vgm_bitstream * iw, size_t cb_size, STREAMFILE *streamFile);
 static int ww2ogg_codebook_library_rebuild_by_id(vgm_bitstream * ow, uint32_t codebook_id, wwise_setup_t setup_type, STREAMFILE *streamFile);
+static int copy_bytes_to_bits(vgm_bitstream * ow, vgm_bitstream * iw, size_t bytes);
 static int ww2ogg_tremor_ilog(unsigned int v);
 static unsigned int ww2ogg_tremor_book_maptype1_quantvals(unsigned int entries, unsigned int dimensions);
 
@@ -31,6 +71,10 @@ static int load_wvc(uint8_t * ibuf, size_t ibufsize, uint32_t codebook_id, wwise
 static int load_wvc_file(uint8_t * buf, size_t bufsize, uint32_t codebook_id, STREAMFILE *streamFile);
 static int load_wvc_array(uint8_t * buf, size_t bufsize, uint32_t codebook_id, wwise_setup_t setup_type);
 
+static uint64_t wwise_setup_cache_key(const uint8_t * ibuf, size_t packet_size, vorbis_custom_codec_data * data, int channels, STREAMFILE *streamFile);
+static size_t wwise_setup_cache_get(uint64_t key, uint8_t * obuf, size_t obufsize, vorbis_custom_codec_data * data);
+static void wwise_setup_cache_put(uint64_t key, const uint8_t * setup, size_t setup_size, vorbis_custom_codec_data * data);
+
 
 /* **************************************************************************** */
 /* EXTERNAL API                                                                 */
@@ -105,7 +149,18 @@ int vorbis_custom_parse_packet_wwise(VGMSTREAMCHANNEL *stream, vorbis_custom_cod
     header_size = get_packet_header(stream->streamfile, stream->offset, data->config.header_type, (int*)&data->op.granulepos, &packet_size, data->config.big_endian);
     if (!header_size || packet_size > data->buffer_size) goto fail;
 
-    data->op.bytes = rebuild_packet(data->buffer, data->buffer_size, stream->streamfile,stream->offset, data, data->config.big_endian);
+    if (data->config.packet_type == WWV_STANDARD) {
+        /* standard packets go unchanged, so point to them in place when the streamfile allows */
+        off_t packet_offset = stream->offset + header_size;
+        if (!packet_size || packet_offset + packet_size > get_streamfile_size(stream->streamfile)) goto fail;
+
+        data->op.bytes = packet_size;
+        data->op.packet = (unsigned char *)read_streamfile_ptr(data->buffer, packet_offset, packet_size, stream->streamfile);
+    }
+    else {
+        data->op.bytes = rebuild_packet(data->buffer, data->buffer_size, stream->streamfile,stream->offset, data, data->config.big_endian);
+        data->op.packet = data->buffer;
+    }
     stream->offset += header_size + packet_size;
     if (!data->op.bytes || data->op.bytes >= 0xFFFF) goto fail;
 
@@ -152,15 +207,11 @@ static size_t rebuild_packet(uint8_t * obuf, size_t obufsize, STREAMFILE *stream
     int rc, granulepos;
     size_t header_size, packet_size;
 
-    size_t ibufsize = 0x8000; /* arbitrary max size of a setup packet */
-    uint8_t ibuf[0x8000]; /* Wwise setup packet buffer */
-    if (obufsize < ibufsize) goto fail; /* arbitrary expected min */
-
     header_size = get_packet_header(streamFile, offset, data->config.header_type, &granulepos, &packet_size, big_endian);
-    if (!header_size || packet_size > obufsize) goto fail;
+    if (!header_size || packet_size > obufsize || packet_size > data->ibuf_size) goto fail;
 
-    /* load Wwise data into internal buffer */
-    if (read_streamfile(ibuf,offset+header_size,packet_size, streamFile)!=packet_size)
+    /* load Wwise data into the codec's scratch (a copy, as rebuilding reads the next packet too) */
+    if (read_streamfile(data->ibuf,offset+header_size,packet_size, streamFile)!=packet_size)
         goto fail;
 
     /* prepare helper structs */
@@ -169,8 +220,8 @@ static size_t rebuild_packet(uint8_t * obuf, size_t obufsize, STREAMFILE *stream
     ow.b_off = 0;
     ow.mode = BITSTREAM_VORBIS;
 
-    iw.buf = ibuf;
-    iw.bufsize = ibufsize;
+    iw.buf = data->ibuf;
+    iw.bufsize = packet_size;
     iw.b_off = 0;
     iw.mode = BITSTREAM_VORBIS;
 
@@ -193,7 +244,8 @@ fail:
 static size_t rebuild_setup(uint8_t * obuf, size_t obufsize, STREAMFILE *streamFile, off_t offset, vorbis_custom_codec_data * data, int big_endian, int channels) {
     vgm_bitstream ow, iw;
     int rc, granulepos;
-    size_t header_size, packet_size;
+    size_t header_size, packet_size, setup_size;
+    uint64_t key;
 
     size_t ibufsize = 0x8000; /* arbitrary max size of a setup packet */
     uint8_t ibuf[0x8000]; /* Wwise setup packet buffer */
@@ -207,6 +259,12 @@ static size_t rebuild_setup(uint8_t * obuf, size_t obufsize, STREAMFILE *streamF
     if (read_streamfile(ibuf,offset+header_size,packet_size, streamFile)!=packet_size)
         goto fail;
 
+    /* same setup was already rebuilt */
+    key = wwise_setup_cache_key(ibuf, packet_size, data, channels, streamFile);
+    setup_size = wwise_setup_cache_get(key, obuf, obufsize, data);
+    if (setup_size)
+        return setup_size;
+
     /* prepare helper structs */
     ow.buf = obuf;
     ow.bufsize = obufsize;
@@ -226,6 +284,7 @@ static size_t rebuild_setup(uint8_t * obuf, size_t obufsize, STREAMFILE *streamF
         goto fail;
     }
 
+    wwise_setup_cache_put(key, obuf, ow.b_off / 8, data);
 
     return ow.b_off / 8;
 fail:
@@ -375,11 +434,8 @@ static int ww2ogg_generate_vorbis_packet(vgm_bitstream * ow, vgm_bitstream * iw,
 
 
     /* remainder of packet (not byte-aligned when using mod_packets) */
-    for (i = 1; i < packet_size; i++) {
-        uint32_t c = 0;
-
-        r_bits(iw,  8, &c);
-        w_bits(ow,  8,  c);
+    if (packet_size > 1) {
+        if (!copy_bytes_to_bits(ow, iw, packet_size - 1)) goto fail;
     }
 
     /* remove trailing garbage bits */
@@ -1048,6 +1104,52 @@ fail:
 }
 
 
+/* Copies bytes from a byte-aligned input to a possibly unaligned output, same as reading/writing
+ * them 8 bits at a time but shifting whole bytes (most of a modified packet's rebuild time). */
+static int copy_bytes_to_bits(vgm_bitstream * ow, vgm_bitstream * iw, size_t bytes) {
+    const uint8_t *ibuf;
+    uint8_t *obuf;
+    int shift;
+    size_t i;
+
+    if (iw->b_off + bytes*8 > iw->bufsize*8 || ow->b_off + bytes*8 > ow->bufsize*8) goto fail;
+
+    if (iw->b_off % 8 != 0) { /* not expected, do it the slow way */
+        for (i = 0; i < bytes; i++) {
+            uint32_t c = 0;
+
+            r_bits(iw,  8, &c);
+            w_bits(ow,  8,  c);
+        }
+        return 1;
+    }
+
+    ibuf = iw->buf + iw->b_off / 8;
+    obuf = ow->buf + ow->b_off / 8;
+    shift = ow->b_off % 8;
+
+    if (shift == 0) {
+        memcpy(obuf, ibuf, bytes);
+    }
+    else {
+        /* Vorbis packs LSB first: low bits of each byte complete the current output byte, high bits start the next */
+        uint8_t low_mask = (1 << shift) - 1;
+        uint8_t carry = obuf[0] & low_mask;
+
+        for (i = 0; i < bytes; i++) {
+            obuf[i] = carry | (uint8_t)(ibuf[i] << shift);
+            carry = ibuf[i] >> (8 - shift);
+        }
+        obuf[bytes] = carry; /* always inside ow when unaligned; bits above are padded with 0 later anyway */
+    }
+
+    iw->b_off += bytes*8;
+    ow->b_off += bytes*8;
+    return 1;
+fail:
+    return 0;
+}
+
 /* fixed-point ilog from Xiph's Tremor */
 static int ww2ogg_tremor_ilog(unsigned int v) {
     int ret=0;
@@ -1088,6 +1190,99 @@ static unsigned int ww2ogg_tremor_book_maptype1_quantvals(unsigned int entries,
 /* INTERNAL UTILS                                                               */
 /* **************************************************************************** */
 
+static uint64_t wwise_setup_cache_key(const uint8_t * ibuf, size_t packet_size, vorbis_custom_codec_data * data, int channels, STREAMFILE *streamFile) {
+    uint64_t hash = 0xCBF29CE484222325ULL; /* FNV-1a */
+    size_t i;
+
+    for (i = 0; i < packet_size; i++) {
+        hash = (hash ^ ibuf[i]) * 0x100000001B3ULL;
+    }
+    hash = (hash ^ data->config.setup_type) * 0x100000001B3ULL;
+    hash = (hash ^ channels) * 0x100000001B3ULL;
+
+    /* external codebooks may come from a .wvc in the stream's dir */
+    if (data->config.setup_type == WWV_EXTERNAL_CODEBOOKS || data->config.setup_type == WWV_AOTUV603_CODEBOOKS) {
+        char pathname[PATH_LIMIT];
+        char *path;
+
+        streamFile->get_name(streamFile,pathname,sizeof(pathname));
+        path = strrchr(pathname,DIR_SEPARATOR);
+        if (path)
+            *(path+1) = '\0';
+        else
+            pathname[0] = '\0';
+
+        for (i = 0; pathname[i]; i++) {
+            hash = (hash ^ (uint8_t)pathname[i]) * 0x100000001B3ULL;
+        }
+    }
+
+    return hash;
+}
+
+/* copies a known rebuilt setup (and its mode info for packets), returns its size or 0 */
+static size_t wwise_setup_cache_get(uint64_t key, uint8_t * obuf, size_t obufsize, vorbis_custom_codec_data * data) {
+    size_t setup_size = 0;
+    int i;
+
+    if (!wwise_setup_cache.enabled)
+        return 0;
+
+    if (wwise_setup_cache.lock)
+        wwise_setup_cache.lock(wwise_setup_cache.lock_data);
+    for (i = 0; i < wwise_setup_cache.count; i++) {
+        if (wwise_setup_cache.entries[i].key == key) {
+            if (wwise_setup_cache.entries[i].setup_size <= obufsize) {
+                setup_size = wwise_setup_cache.entries[i].setup_size;
+                memcpy(obuf, wwise_setup_cache.entries[i].setup, setup_size);
+                memcpy(data->mode_blockflag, wwise_setup_cache.entries[i].mode_blockflag, sizeof(data->mode_blockflag));
+                data->mode_bits = wwise_setup_cache.entries[i].mode_bits;
+            }
+            break;
+        }
+    }
+    if (wwise_setup_cache.unlock)
+        wwise_setup_cache.unlock(wwise_setup_cache.lock_data);
+
+    return setup_size;
+}
+
+static void wwise_setup_cache_put(uint64_t key, const uint8_t * setup, size_t setup_size, vorbis_custom_codec_data * data) {
+    uint8_t* old_setup = NULL;
+    uint8_t* new_setup;
+    int i;
+
+    if (!wwise_setup_cache.enabled)
+        return;
+
+    new_setup = malloc(setup_size);
+    if (!new_setup) return;
+    memcpy(new_setup, setup, setup_size);
+
+    if (wwise_setup_cache.lock)
+        wwise_setup_cache.lock(wwise_setup_cache.lock_data);
+    for (i = 0; i < wwise_setup_cache.count; i++) {
+        if (wwise_setup_cache.entries[i].key == key)
+            break;
+    }
+    if (i == wwise_setup_cache.count) {
+        i = wwise_setup_cache.next;
+        wwise_setup_cache.next = (wwise_setup_cache.next + 1) % WWISE_SETUP_CACHE_SIZE;
+        if (wwise_setup_cache.count < WWISE_SETUP_CACHE_SIZE)
+            wwise_setup_cache.count++;
+    }
+    old_setup = wwise_setup_cache.entries[i].setup;
+    wwise_setup_cache.entries[i].key = key;
+    wwise_setup_cache.entries[i].setup = new_setup;
+    wwise_setup_cache.entries[i].setup_size = setup_size;
+    memcpy(wwise_setup_cache.entries[i].mode_blockflag, data->mode_blockflag, sizeof(data->mode_blockflag));
+    wwise_setup_cache.entries[i].mode_bits = data->mode_bits;
+    if (wwise_setup_cache.unlock)
+        wwise_setup_cache.unlock(wwise_setup_cache.lock_data);
+
+    free(old_setup);
+}
+
 /* loads an external Wwise Vorbis Codebooks file (wvc) referenced by ID and returns size */
 static int load_wvc(uint8_t * ibuf, size_t ibufsize, uint32_t codebook_id, wwise_setup_t setup_type, STREAMFILE *streamFile) {
     size_t bytes;
@@ -6,8 +6,8 @@
 
 /* Based on Valery V. Anisimovsky's WS-AUD.txt */
 
-static char WSTable2bit[4]={-2,-1,0,1};
-static char WSTable4bit[16]={-9,-8,-6,-5,-4,-3,-2,-1,
+static const char WSTable2bit[4]={-2,-1,0,1};
+static const char WSTable4bit[16]={-9,-8,-6,-5,-4,-3,-2,-1,
                               0, 1, 2, 3, 4, 5 ,6, 8};
 
 /* We pass in the VGMSTREAM here, unlike in other codings, because
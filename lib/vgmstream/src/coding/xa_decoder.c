@@ -45,10 +45,11 @@ static const int IK1[4] = {  0,    0,   832,   880 };
  *           (bsnes): https://github.com/byuu/bsnes/blob/master/bsnes/sfc/dsp/SPC_DSP.cpp#L316
  */
 
-void decode_xa(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do, int channel) {
-    uint8_t frame[0x80] = {0};
+DECODE_INLINE void decode_xa_spaced(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do, int channel) {
+    uint8_t frame_buf[0x80];
+    const uint8_t* frame;
     off_t frame_offset;
-    int i,j, sp_pos, frames_in, samples_done = 0, sample_count = 0;
+    int i,j, sp_pos, frames_in, samples_done = 0, sample_count;
     size_t bytes_per_frame, samples_per_frame;
     int32_t hist1 = stream->adpcm_history1_32;
     int32_t hist2 = stream->adpcm_history2_32;
@@ -80,78 +81,97 @@ void decode_xa(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing,
     frames_in = first_sample / samples_per_frame;
     first_sample = first_sample % samples_per_frame;
 
-    /* parse frame header */
-    frame_offset = stream->offset + bytes_per_frame * frames_in;
-    read_streamfile(frame, frame_offset, bytes_per_frame, stream->streamfile); /* ignore EOF errors */
+    /* may be called with many consecutive frames (up to a whole sector when blocked) */
+    while (samples_done < samples_to_do) {
 
-    VGM_ASSERT(get_32bitBE(frame+0x0) != get_32bitBE(frame+0x4) || get_32bitBE(frame+0x8) != get_32bitBE(frame+0xC),
-               "bad frames at %x\n", (uint32_t)frame_offset);
+        /* parse frame header */
+        frame_offset = stream->offset + bytes_per_frame * frames_in;
+        memset(frame_buf, 0, sizeof(frame_buf));
+        frame = read_streamfile_ptr(frame_buf, frame_offset, bytes_per_frame, stream->streamfile); /* ignore EOF errors */
 
+        VGM_ASSERT(get_32bitBE(frame+0x0) != get_32bitBE(frame+0x4) || get_32bitBE(frame+0x8) != get_32bitBE(frame+0xC),
+                   "bad frames at %x\n", (uint32_t)frame_offset);
 
-    /* decode subframes */
-    for (i = 0; i < 8 / channelspacing; i++) {
-        int32_t coef1, coef2;
-        uint8_t coef_index, shift_factor;
 
-        /* parse current subframe (sound unit)'s header (sound parameters) */
-        sp_pos = 0x04 + i*channelspacing + channel;
-        coef_index   = (frame[sp_pos] >> 4) & 0xf;
-        shift_factor = (frame[sp_pos] >> 0) & 0xf;
+        /* decode subframes */
+        sample_count = 0;
+        for (i = 0; i < 8 / channelspacing && samples_done < samples_to_do; i++) {
+            int32_t coef1, coef2;
+            uint8_t coef_index, shift_factor;
+            int su_pos, nibble_shift;
+            const int16_t* scales;
 
-        VGM_ASSERT(coef_index > 4 || shift_factor > 12, "XA: incorrect coefs/shift at %x\n", (uint32_t)frame_offset + sp_pos);
-        if (coef_index > 4)
-            coef_index = 0; /* only 4 filters are used, rest is apparently 0 */
-        if (shift_factor > 12)
-            shift_factor = 9; /* supposedly, from Nocash PSX docs */
+            /* skip whole subframes before first_sample (hist isn't touched) */
+            if (sample_count + 28 <= first_sample) {
+                sample_count += 28;
+                continue;
+            }
 
-        coef1 = IK0[coef_index];
-        coef2 = IK1[coef_index];
+            /* parse current subframe (sound unit)'s header (sound parameters) */
+            sp_pos = 0x04 + i*channelspacing + channel;
+            coef_index   = (frame[sp_pos] >> 4) & 0xf;
+            shift_factor = (frame[sp_pos] >> 0) & 0xf;
 
+            VGM_ASSERT(coef_index > 4 || shift_factor > 12, "XA: incorrect coefs/shift at %x\n", (uint32_t)frame_offset + sp_pos);
+            if (coef_index > 4)
+                coef_index = 0; /* only 4 filters are used, rest is apparently 0 */
+            if (shift_factor > 12)
+                shift_factor = 9; /* supposedly, from Nocash PSX docs */
 
-        /* decode subframe nibbles */
-        for(j = 0; j < 28; j++) {
-            uint8_t nibbles;
-            int32_t new_sample;
+            coef1 = IK0[coef_index];
+            coef2 = IK1[coef_index];
+            scales = nibble_shift_table[shift_factor];
 
-            int su_pos = (channelspacing==1) ?
-                    0x10 + j*0x04 + (i/2) : /* mono */
-                    0x10 + j*0x04 + i;      /* stereo */
-            int get_high_nibble = (channelspacing==1) ?
-                    (i&1) :         /* mono (even subframes = low, off subframes = high) */
-                    (channel == 1); /* stereo (L channel / even subframes = low, R channel / odd subframes = high) */
+            su_pos = (channelspacing==1) ?
+                    0x10 + (i/2) :  /* mono */
+                    0x10 + i;       /* stereo */
+            nibble_shift = (channelspacing==1) ?
+                    ((i&1) ? 4 : 0) :       /* mono (even subframes = low, off subframes = high) */
+                    ((channel == 1) ? 4 : 0); /* stereo (L channel / even subframes = low, R channel / odd subframes = high) */
 
-            /* skip half decodes to make sure hist isn't touched (kinda hack-ish) */
-            if (!(sample_count >= first_sample && samples_done < samples_to_do)) {
-                sample_count++;
-                continue;
-            }
 
-            nibbles = frame[su_pos];
+            /* decode subframe nibbles */
+            for(j = 0; j < 28; j++) {
+                int32_t new_sample;
 
-            new_sample = get_high_nibble ?
-                    (nibbles >> 4) & 0x0f :
-                    (nibbles >> 0) & 0x0f;
+                /* skip half decodes to make sure hist isn't touched (kinda hack-ish) */
+                if (!(sample_count >= first_sample && samples_done < samples_to_do)) {
+                    sample_count++;
+                    continue;
+                }
 
-            new_sample = (int16_t)((new_sample << 12) & 0xf000) >> shift_factor; /* 16b sign extend + scale */
-            new_sample = new_sample << 4;
-            new_sample = new_sample - ((coef1*hist1 + coef2*hist2) >> 10);
+                new_sample = scales[(frame[su_pos + j*0x04] >> nibble_shift) & 0x0f]; /* 16b sign extend + scale */
+                new_sample = new_sample << 4;
+                new_sample = new_sample - ((coef1*hist1 + coef2*hist2) >> 10);
 
-            hist2 = hist1;
-            hist1 = new_sample; /* must go before clamp, somehow */
-            new_sample = new_sample >> 4;
-            new_sample = clamp16(new_sample);
+                hist2 = hist1;
+                hist1 = new_sample; /* must go before clamp, somehow */
+                new_sample = new_sample >> 4;
+                new_sample = clamp16(new_sample);
 
-            outbuf[samples_done * channelspacing] = new_sample;
-            samples_done++;
+                outbuf[samples_done * channelspacing] = new_sample;
+                samples_done++;
 
-            sample_count++;
+                sample_count++;
+            }
         }
+
+        first_sample = 0;
+        frames_in++;
     }
 
     stream->adpcm_history1_32 = hist1;
     stream->adpcm_history2_32 = hist2;
 }
 
+void decode_xa(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do, int channel) {
+    switch (channelspacing) {
+        case 1:  decode_xa_spaced(stream, outbuf, 1, first_sample, samples_to_do, channel); break;
+        case 2:  decode_xa_spaced(stream, outbuf, 2, first_sample, samples_to_do, channel); break;
+        default: decode_xa_spaced(stream, outbuf, channelspacing, first_sample, samples_to_do, channel); break;
+    }
+}
+
 size_t xa_bytes_to_samples(size_t bytes, int channels, int is_blocked, int is_form2) {
     if (is_blocked) {
         return (bytes / 0x930) * (28*8/ channels) * (is_form2 ? 18 : 16);
@@ -1,5 +1,6 @@
 #include "../util.h"
 #include "coding.h"
+#include "frame_walk.h"
 
 /* fixed point amount to scale the current step size */
 static const unsigned int scale_step_aica[16] = {
@@ -40,12 +41,12 @@ static void yamaha_adpcmb_expand_nibble(VGMSTREAMCHANNEL * stream, off_t byte_of
 
 /* Yamaha AICA expand, slightly filtered vs "ACM" Yamaha ADPCM, same as Creative ADPCM
  * (some info from https://github.com/vgmrips/vgmplay, https://wiki.multimedia.cx/index.php/Creative_ADPCM) */
-static void yamaha_aica_expand_nibble(VGMSTREAMCHANNEL * stream, off_t byte_offset, int nibble_shift, int32_t* hist1, int32_t* step_size, int16_t *out_sample) {
+static void yamaha_aica_expand_nibble(uint8_t byte, int nibble_shift, int32_t* hist1, int32_t* step_size, int16_t *out_sample) {
     int code, delta, sample;
 
     *hist1 = *hist1 * 254 / 256; /* hist filter is vital to get correct waveform but not done in many emus */
 
-    code = ((read_8bit(byte_offset,stream->streamfile) >> nibble_shift))&0xf;
+    code = (byte >> nibble_shift) & 0xf;
     delta = (*step_size * scale_delta[code]) / 8; /* 'mul' IMA with table (not sure if part of encoder) */
     sample = *hist1 + delta;
 
@@ -81,26 +82,33 @@ static void yamaha_aica_expand_nibble(VGMSTREAMCHANNEL * stream, off_t byte_offs
 
 /* Yamaha AICA ADPCM (also used in YMZ280B with high nibble first) */
 void decode_aica(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do, int channel, int is_stereo) {
+    frame_walk_t fw;
     int i, sample_count = 0;
     int16_t out_sample;
     int32_t hist1 = stream->adpcm_history1_16;
     int step_size = stream->adpcm_step_index;
+    int chunk_samples = is_stereo ?
+            FRAME_WALK_MAX_BYTES :      /* stereo: one nibble per channel */
+            FRAME_WALK_MAX_BYTES * 2;   /* mono: consecutive nibbles */
 
     /* no header (external setup), pre-clamp for wrong values */
     if (step_size < 0x7f) step_size = 0x7f;
     if (step_size > 0x6000) step_size = 0x6000;
 
-    for (i = first_sample; i < first_sample + samples_to_do; i++) {
-        off_t byte_offset = is_stereo ?
-                stream->offset + i :    /* stereo: one nibble per channel */
-                stream->offset + i/2;   /* mono: consecutive nibbles */
-        int nibble_shift = is_stereo ?
-                (!(channel&1) ? 0:4) :  /* even = low/L, odd = high/R */
-                (!(i&1) ? 0:4);         /* low nibble first */
-
-        yamaha_aica_expand_nibble(stream, byte_offset, nibble_shift, &hist1, &step_size, &out_sample);
-        outbuf[sample_count] = out_sample;
-        sample_count += channelspacing;
+    /* no frames, read in chunks (0xFF past EOF, as read_8bit gave) */
+    FRAME_WALK_PADDED(&fw, stream->streamfile, stream->offset, FRAME_WALK_MAX_BYTES, chunk_samples, first_sample, samples_to_do, 0xFF) {
+        for (i = fw.first; i < fw.first + fw.count; i++) {
+            uint8_t byte = is_stereo ?
+                    fw.frame[i] :
+                    fw.frame[i/2];
+            int nibble_shift = is_stereo ?
+                    (!(channel&1) ? 0:4) :  /* even = low/L, odd = high/R */
+                    (!(i&1) ? 0:4);         /* low nibble first */
+
+            yamaha_aica_expand_nibble(byte, nibble_shift, &hist1, &step_size, &out_sample);
+            outbuf[sample_count] = out_sample;
+            sample_count += channelspacing;
+        }
     }
 
     stream->adpcm_history1_16 = hist1;
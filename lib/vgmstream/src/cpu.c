@@ -0,0 +1,806 @@
+#include <stddef.h>
+#include "cpu.h"
+#include "util.h"
+#include "vgmstream.h"
+
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+#define VGM_CPU_X86
+#if defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#define VGM_TARGET(isa) /* MSVC allows any intrinsic */
+#else
+#include <cpuid.h>
+#include <immintrin.h>
+#define VGM_TARGET(isa) __attribute__((target(isa)))
+#endif
+#endif
+
+#if defined(__aarch64__) || defined(_M_ARM64) || defined(__ARM_NEON)
+#define VGM_CPU_NEON
+#include <arm_neon.h>
+#endif
+
+
+/* ******************************************** */
+/* KERNELS                                      */
+/* ******************************************** */
+
+static void s16_to_float_c(float* dst, const sample_t* src, int count, float scale) {
+    int i;
+    for (i = 0; i < count; i++) {
+        dst[i] = src[i] * scale;
+    }
+}
+
+static void s16_deinterleave_c(sample_t** dst, int offset, const sample_t* src, int channels, int count) {
+    int ch, s;
+    for (ch = 0; ch < channels; ch++) {
+        sample_t* plane = dst[ch] + offset;
+        for (s = 0; s < count; s++) {
+            plane[s] = src[s * channels + ch];
+        }
+    }
+}
+
+static void imlt_window_c(int16_t* out, const int16_t* new_samples, const int16_t* old_samples, const int16_t* window, int size) {
+    int i, half = size / 2;
+
+    for (i = 0; i < half; i++) {
+        int new_val = new_samples[half - 1 - i];
+        int old_val = old_samples[i];
+        int win_lo = window[i];
+        int win_hi = window[size - 1 - i];
+        int sample_lo = (new_val * win_lo + old_val * win_hi + 32768) >> 13;
+        int sample_hi = (new_val * win_hi - old_val * win_lo + 32768) >> 13;
+
+        out[i] = clamp16(sample_lo);
+        out[size - 1 - i] = clamp16(sample_hi);
+    }
+}
+
+static void xor_bytes_c(uint8_t* dst, const uint8_t* key, int count) {
+    int i;
+    for (i = 0; i < count; i++) {
+        dst[i] ^= key[i];
+    }
+}
+
+static void reverse_bits_c(uint8_t* dst, int count) {
+    int i;
+    for (i = 0; i < count; i++) {
+        uint8_t val = dst[i];
+        val = (val >> 4) | (val << 4);
+        val = ((val >> 2) & 0x33) | ((val & 0x33) << 2);
+        val = ((val >> 1) & 0x55) | ((val & 0x55) << 1);
+        dst[i] = val;
+    }
+}
+
+static void vadpcm_subframe_c(int16_t* out, const int16_t* matrix, const int16_t* nibbles, int shift, int hist2, int hist1) {
+    int i, p;
+
+    for (i = 0; i < 8; i++) {
+        uint32_t hist = (uint32_t)(matrix[i*2 + 0] * hist2) + (uint32_t)(matrix[i*2 + 1] * hist1);
+        uint32_t codes = 0;
+        int32_t sample;
+
+        for (p = 1; p < 5; p++) {
+            codes += (uint32_t)(matrix[p*16 + i*2 + 0] * nibbles[p*2 - 2] + matrix[p*16 + i*2 + 1] * nibbles[p*2 - 1]);
+        }
+        sample = (int32_t)(hist + (codes << shift)) >> 11;
+        out[i] = clamp16(sample);
+    }
+}
+
+static void s32_to_s16_c(sample_t* dst, const int32_t* src, int count) {
+    int i;
+    for (i = 0; i < count; i++) {
+        dst[i] = clamp16(src[i]);
+    }
+}
+
+static void f32_scale_c(float* dst, const float* src, float vol, int count) {
+    int i;
+    for (i = 0; i < count; i++) {
+        dst[i] = src[i] * vol;
+    }
+}
+
+static void f32_muladd_c(float* dst, const float* src, float vol, int count) {
+    int i;
+    for (i = 0; i < count; i++) {
+        float temp = src[i] * vol;
+        dst[i] = dst[i] + temp;
+    }
+}
+
+/* columns from first on (for SIMD leftovers), unsigned math for wrapping sums */
+static void acm_juggle_columns_c(int* wrap, int* block, unsigned sub_len, unsigned sub_count, unsigned first) {
+    unsigned i, j;
+
+    for (i = first; i < sub_len; i++) {
+        int* p = block + i;
+        unsigned r0 = wrap[i*2 + 0];
+        unsigned r1 = wrap[i*2 + 1];
+        for (j = 0; j < sub_count / 2; j++) {
+            unsigned r2 = p[0];
+            unsigned r3;
+            p[0] = r1*2 + (r0 + r2);
+            p += sub_len;
+            r3 = p[0];
+            p[0] = r2*2 - (r1 + r3);
+            p += sub_len;
+            r0 = r2;
+            r1 = r3;
+        }
+        wrap[i*2 + 0] = r0;
+        wrap[i*2 + 1] = r1;
+    }
+}
+
+static void acm_juggle_c(int* wrap, int* block, unsigned sub_len, unsigned sub_count) {
+    acm_juggle_columns_c(wrap, block, sub_len, sub_count, 0);
+}
+
+static void ea_xas_groups_c(int16_t* out, const uint8_t* nibbles, const float* coefs, const int16_t* hists, const int* shifts) {
+    int group, row, i;
+
+    for (group = 0; group < 4; group++) {
+        float coef1 = coefs[group*2 + 0];
+        float coef2 = coefs[group*2 + 1];
+        int16_t hist1 = hists[group*2 + 0];
+        int16_t hist2 = hists[group*2 + 1];
+        int shift = shifts[group];
+
+        for (row = 0; row < 15; row++) {
+            for (i = 0; i < 2; i++) {
+                uint8_t byte = nibbles[row*4 + group];
+                int sample = i ? (byte >> 0) & 0x0f : (byte >> 4) & 0x0f;
+
+                sample = (int16_t)(sample << 12) >> shift;
+                sample = sample + hist1 * coef1 + hist2 * coef2;
+                sample = clamp16(sample);
+
+                out[group*32 + 2 + row*2 + i] = sample;
+                hist2 = hist1;
+                hist1 = sample;
+            }
+        }
+    }
+}
+
+#ifdef VGM_CPU_X86
+VGM_TARGET("sse2")
+static void s16_to_float_sse2(float* dst, const sample_t* src, int count, float scale) {
+    const __m128 vscale = _mm_set1_ps(scale);
+    int i;
+
+    for (i = 0; i + 8 <= count; i += 8) {
+        __m128i in = _mm_loadu_si128((const __m128i*)(src + i));
+        /* sign-extend by placing samples in the high half and shifting back */
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(in, in), 16);
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(in, in), 16);
+        _mm_storeu_ps(dst + i + 0, _mm_mul_ps(_mm_cvtepi32_ps(lo), vscale));
+        _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), vscale));
+    }
+    s16_to_float_c(dst + i, src + i, count - i, scale);
+}
+
+VGM_TARGET("avx2")
+static void s16_to_float_avx2(float* dst, const sample_t* src, int count, float scale) {
+    const __m256 vscale = _mm256_set1_ps(scale);
+    int i;
+
+    for (i = 0; i + 16 <= count; i += 16) {
+        __m256i lo = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(src + i + 0)));
+        __m256i hi = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(src + i + 8)));
+        _mm256_storeu_ps(dst + i + 0, _mm256_mul_ps(_mm256_cvtepi32_ps(lo), vscale));
+        _mm256_storeu_ps(dst + i + 8, _mm256_mul_ps(_mm256_cvtepi32_ps(hi), vscale));
+    }
+    s16_to_float_c(dst + i, src + i, count - i, scale);
+}
+
+/* stereo only (most common), others use the C version */
+VGM_TARGET("sse2")
+static void s16_deinterleave_sse2(sample_t** dst, int offset, const sample_t* src, int channels, int count) {
+    sample_t* left = dst[0] + offset;
+    sample_t* right;
+    int s;
+
+    if (channels != 2) {
+        s16_deinterleave_c(dst, offset, src, channels, count);
+        return;
+    }
+    right = dst[1] + offset;
+
+    for (s = 0; s + 8 <= count; s += 8) {
+        __m128i a = _mm_loadu_si128((const __m128i*)(src + s * 2 + 0));
+        __m128i b = _mm_loadu_si128((const __m128i*)(src + s * 2 + 8));
+        /* as 32-bit LR pairs: L is the sign-extended low half, R the high half */
+        __m128i la = _mm_srai_epi32(_mm_slli_epi32(a, 16), 16);
+        __m128i lb = _mm_srai_epi32(_mm_slli_epi32(b, 16), 16);
+        __m128i ra = _mm_srai_epi32(a, 16);
+        __m128i rb = _mm_srai_epi32(b, 16);
+        _mm_storeu_si128((__m128i*)(left + s), _mm_packs_epi32(la, lb));
+        _mm_storeu_si128((__m128i*)(right + s), _mm_packs_epi32(ra, rb));
+    }
+    for (; s < count; s++) {
+        left[s] = src[s * 2 + 0];
+        right[s] = src[s * 2 + 1];
+    }
+}
+
+VGM_TARGET("sse2")
+static inline __m128i reverse_s16_sse2(__m128i v) {
+    v = _mm_shuffle_epi32(v, _MM_SHUFFLE(0,1,2,3));
+    v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2,3,0,1));
+    return _mm_shufflehi_epi16(v, _MM_SHUFFLE(2,3,0,1));
+}
+
+/* products are summed in pairs with madd (exact as window values are positive) */
+VGM_TARGET("sse2")
+static void imlt_window_sse2(int16_t* out, const int16_t* new_samples, const int16_t* old_samples, const int16_t* window, int size) {
+    const __m128i round = _mm_set1_epi32(32768);
+    const __m128i zero = _mm_setzero_si128();
+    int i, half = size / 2;
+
+    for (i = 0; i < half; i += 8) {
+        __m128i new_val = reverse_s16_sse2(_mm_loadu_si128((const __m128i*)(new_samples + half - 8 - i)));
+        __m128i old_val = _mm_loadu_si128((const __m128i*)(old_samples + i));
+        __m128i win_lo = _mm_loadu_si128((const __m128i*)(window + i));
+        __m128i win_hi = reverse_s16_sse2(_mm_loadu_si128((const __m128i*)(window + size - 8 - i)));
+        __m128i win_lo_neg = _mm_sub_epi16(zero, win_lo);
+
+        __m128i vals_a = _mm_unpacklo_epi16(new_val, old_val);
+        __m128i vals_b = _mm_unpackhi_epi16(new_val, old_val);
+        __m128i lo_a = _mm_madd_epi16(vals_a, _mm_unpacklo_epi16(win_lo, win_hi));
+        __m128i lo_b = _mm_madd_epi16(vals_b, _mm_unpackhi_epi16(win_lo, win_hi));
+        __m128i hi_a = _mm_madd_epi16(vals_a, _mm_unpacklo_epi16(win_hi, win_lo_neg));
+        __m128i hi_b = _mm_madd_epi16(vals_b, _mm_unpackhi_epi16(win_hi, win_lo_neg));
+
+        lo_a = _mm_srai_epi32(_mm_add_epi32(lo_a, round), 13);
+        lo_b = _mm_srai_epi32(_mm_add_epi32(lo_b, round), 13);
+        hi_a = _mm_srai_epi32(_mm_add_epi32(hi_a, round), 13);
+        hi_b = _mm_srai_epi32(_mm_add_epi32(hi_b, round), 13);
+
+        _mm_storeu_si128((__m128i*)(out + i), _mm_packs_epi32(lo_a, lo_b));
+        _mm_storeu_si128((__m128i*)(out + size - 8 - i), reverse_s16_sse2(_mm_packs_epi32(hi_a, hi_b)));
+    }
+}
+
+VGM_TARGET("sse2")
+static void xor_bytes_sse2(uint8_t* dst, const uint8_t* key, int count) {
+    int i;
+
+    for (i = 0; i + 16 <= count; i += 16) {
+        __m128i val = _mm_loadu_si128((const __m128i*)(dst + i));
+        __m128i xor = _mm_loadu_si128((const __m128i*)(key + i));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_xor_si128(val, xor));
+    }
+    xor_bytes_c(dst + i, key + i, count - i);
+}
+
+/* swaps nibbles, then bit pairs, then bits (16-bit shifts, masked to stay within each byte) */
+VGM_TARGET("sse2")
+static void reverse_bits_sse2(uint8_t* dst, int count) {
+    const __m128i mask4 = _mm_set1_epi8(0x0F);
+    const __m128i mask2 = _mm_set1_epi8(0x33);
+    const __m128i mask1 = _mm_set1_epi8(0x55);
+    int i;
+
+    for (i = 0; i + 16 <= count; i += 16) {
+        __m128i val = _mm_loadu_si128((const __m128i*)(dst + i));
+        val = _mm_or_si128(_mm_and_si128(_mm_srli_epi16(val, 4), mask4), _mm_slli_epi16(_mm_and_si128(val, mask4), 4));
+        val = _mm_or_si128(_mm_and_si128(_mm_srli_epi16(val, 2), mask2), _mm_slli_epi16(_mm_and_si128(val, mask2), 2));
+        val = _mm_or_si128(_mm_and_si128(_mm_srli_epi16(val, 1), mask1), _mm_slli_epi16(_mm_and_si128(val, mask1), 1));
+        _mm_storeu_si128((__m128i*)(dst + i), val);
+    }
+    reverse_bits_c(dst + i, count - i);
+}
+/* pairs of columns go in madd (no overflow, as nibbles are 4-bit), and packs does the final clamp */
+VGM_TARGET("sse2")
+static void vadpcm_subframe_sse2(int16_t* out, const int16_t* matrix, const int16_t* nibbles, int shift, int hist2, int hist1) {
+    __m128i hist = _mm_set1_epi32((int32_t)(((uint32_t)hist1 << 16) | (uint16_t)hist2));
+    __m128i hist_lo = _mm_madd_epi16(_mm_loadu_si128((const __m128i*)(matrix + 0)), hist);
+    __m128i hist_hi = _mm_madd_epi16(_mm_loadu_si128((const __m128i*)(matrix + 8)), hist);
+    __m128i codes_lo = _mm_setzero_si128();
+    __m128i codes_hi = _mm_setzero_si128();
+    int p;
+
+    for (p = 1; p < 5; p++) {
+        __m128i pair = _mm_set1_epi32((int32_t)(((uint32_t)nibbles[p*2 - 1] << 16) | (uint16_t)nibbles[p*2 - 2]));
+        codes_lo = _mm_add_epi32(codes_lo, _mm_madd_epi16(_mm_loadu_si128((const __m128i*)(matrix + p*16 + 0)), pair));
+        codes_hi = _mm_add_epi32(codes_hi, _mm_madd_epi16(_mm_loadu_si128((const __m128i*)(matrix + p*16 + 8)), pair));
+    }
+
+    codes_lo = _mm_sll_epi32(codes_lo, _mm_cvtsi32_si128(shift));
+    codes_hi = _mm_sll_epi32(codes_hi, _mm_cvtsi32_si128(shift));
+    hist_lo = _mm_srai_epi32(_mm_add_epi32(hist_lo, codes_lo), 11);
+    hist_hi = _mm_srai_epi32(_mm_add_epi32(hist_hi, codes_hi), 11);
+    _mm_storeu_si128((__m128i*)out, _mm_packs_epi32(hist_lo, hist_hi));
+}
+
+VGM_TARGET("sse2")
+static void s32_to_s16_sse2(sample_t* dst, const int32_t* src, int count) {
+    int i;
+
+    for (i = 0; i + 8 <= count; i += 8) {
+        __m128i lo = _mm_loadu_si128((const __m128i*)(src + i + 0));
+        __m128i hi = _mm_loadu_si128((const __m128i*)(src + i + 4));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_packs_epi32(lo, hi));
+    }
+    s32_to_s16_c(dst + i, src + i, count - i);
+}
+
+VGM_TARGET("sse2")
+static void f32_scale_sse2(float* dst, const float* src, float vol, int count) {
+    const __m128 vvol = _mm_set1_ps(vol);
+    int i;
+
+    for (i = 0; i + 8 <= count; i += 8) {
+        _mm_storeu_ps(dst + i + 0, _mm_mul_ps(_mm_loadu_ps(src + i + 0), vvol));
+        _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_loadu_ps(src + i + 4), vvol));
+    }
+    f32_scale_c(dst + i, src + i, vol, count - i);
+}
+
+VGM_TARGET("sse2")
+static void f32_muladd_sse2(float* dst, const float* src, float vol, int count) {
+    const __m128 vvol = _mm_set1_ps(vol);
+    int i;
+
+    for (i = 0; i + 8 <= count; i += 8) {
+        __m128 a = _mm_mul_ps(_mm_loadu_ps(src + i + 0), vvol);
+        __m128 b = _mm_mul_ps(_mm_loadu_ps(src + i + 4), vvol);
+        _mm_storeu_ps(dst + i + 0, _mm_add_ps(_mm_loadu_ps(dst + i + 0), a));
+        _mm_storeu_ps(dst + i + 4, _mm_add_ps(_mm_loadu_ps(dst + i + 4), b));
+    }
+    f32_muladd_c(dst + i, src + i, vol, count - i);
+}
+
+VGM_TARGET("avx2")
+static void f32_scale_avx2(float* dst, const float* src, float vol, int count) {
+    const __m256 vvol = _mm256_set1_ps(vol);
+    int i;
+
+    for (i = 0; i + 16 <= count; i += 16) {
+        _mm256_storeu_ps(dst + i + 0, _mm256_mul_ps(_mm256_loadu_ps(src + i + 0), vvol));
+        _mm256_storeu_ps(dst + i + 8, _mm256_mul_ps(_mm256_loadu_ps(src + i + 8), vvol));
+    }
+    f32_scale_c(dst + i, src + i, vol, count - i);
+}
+
+VGM_TARGET("avx2")
+static void f32_muladd_avx2(float* dst, const float* src, float vol, int count) {
+    const __m256 vvol = _mm256_set1_ps(vol);
+    int i;
+
+    /* mul then add rather than _mm256_fmadd_ps, as FMA rounds once and results would differ */
+    for (i = 0; i + 16 <= count; i += 16) {
+        __m256 a = _mm256_mul_ps(_mm256_loadu_ps(src + i + 0), vvol);
+        __m256 b = _mm256_mul_ps(_mm256_loadu_ps(src + i + 8), vvol);
+        _mm256_storeu_ps(dst + i + 0, _mm256_add_ps(_mm256_loadu_ps(dst + i + 0), a));
+        _mm256_storeu_ps(dst + i + 8, _mm256_add_ps(_mm256_loadu_ps(dst + i + 8), b));
+    }
+    f32_muladd_c(dst + i, src + i, vol, count - i);
+}
+
+/* 4 columns at a time, wrap pairs split into r0/r1 vectors with a float shuffle */
+VGM_TARGET("sse2")
+static void acm_juggle_sse2(int* wrap, int* block, unsigned sub_len, unsigned sub_count) {
+    unsigned i, j;
+
+    for (i = 0; i + 4 <= sub_len; i += 4) {
+        int* p = block + i;
+        __m128 w0 = _mm_castsi128_ps(_mm_loadu_si128((const __m128i*)(wrap + i*2 + 0)));
+        __m128 w1 = _mm_castsi128_ps(_mm_loadu_si128((const __m128i*)(wrap + i*2 + 4)));
+        __m128i r0 = _mm_castps_si128(_mm_shuffle_ps(w0, w1, _MM_SHUFFLE(2,0,2,0)));
+        __m128i r1 = _mm_castps_si128(_mm_shuffle_ps(w0, w1, _MM_SHUFFLE(3,1,3,1)));
+
+        for (j = 0; j < sub_count / 2; j++) {
+            __m128i r2 = _mm_loadu_si128((const __m128i*)p);
+            __m128i r3;
+            _mm_storeu_si128((__m128i*)p, _mm_add_epi32(_mm_slli_epi32(r1, 1), _mm_add_epi32(r0, r2)));
+            p += sub_len;
+            r3 = _mm_loadu_si128((const __m128i*)p);
+            _mm_storeu_si128((__m128i*)p, _mm_sub_epi32(_mm_slli_epi32(r2, 1), _mm_add_epi32(r1, r3)));
+            p += sub_len;
+            r0 = r2;
+            r1 = r3;
+        }
+
+        _mm_storeu_si128((__m128i*)(wrap + i*2 + 0), _mm_unpacklo_epi32(r0, r1));
+        _mm_storeu_si128((__m128i*)(wrap + i*2 + 4), _mm_unpackhi_epi32(r0, r1));
+    }
+    acm_juggle_columns_c(wrap, block, sub_len, sub_count, i);
+}
+
+/* groups in 4 lanes; (int16_t)(n << 12) >> shift is a mullo of the nibble up to shift 12 and a mulhi past it
+ * (no per-lane shifts in SSE2), and packs does the clamp */
+VGM_TARGET("sse2")
+static void ea_xas_groups_sse2(int16_t* out, const uint8_t* nibbles, const float* coefs, const int16_t* hists, const int* shifts) {
+    int16_t rows[30*4];
+    __m128 coef1 = _mm_setr_ps(coefs[0], coefs[2], coefs[4], coefs[6]);
+    __m128 coef2 = _mm_setr_ps(coefs[1], coefs[3], coefs[5], coefs[7]);
+    __m128 hist1 = _mm_setr_ps(hists[0], hists[2], hists[4], hists[6]);
+    __m128 hist2 = _mm_setr_ps(hists[1], hists[3], hists[5], hists[7]);
+    __m128i mul_lo, mul_hi;
+    __m128i zero = _mm_setzero_si128();
+    __m128i high_mask = _mm_set1_epi16((int16_t)0xF000);
+    int row, i, n;
+
+    {
+        int16_t lo[4], hi[4];
+        for (i = 0; i < 4; i++) {
+            lo[i] = shifts[i] <= 12 ? 1 << (12 - shifts[i]) : 0;
+            hi[i] = shifts[i] > 12 ? 1 << (16 - shifts[i]) : 0;
+        }
+        mul_lo = _mm_setr_epi16(lo[0], lo[1], lo[2], lo[3], 0, 0, 0, 0);
+        mul_hi = _mm_setr_epi16(hi[0], hi[1], hi[2], hi[3], 0, 0, 0, 0);
+    }
+
+    for (row = 0; row < 15; row++) {
+        uint32_t word;
+        __m128i bytes, codes[2];
+
+        memcpy(&word, nibbles + row*4, 4);
+        bytes = _mm_unpacklo_epi8(_mm_cvtsi32_si128((int)word), zero);
+        codes[0] = _mm_and_si128(_mm_slli_epi16(bytes, 8), high_mask);
+        codes[1] = _mm_slli_epi16(bytes, 12);
+
+        for (i = 0; i < 2; i++) {
+            __m128i scaled = _mm_add_epi16(_mm_mullo_epi16(_mm_srai_epi16(codes[i], 12), mul_lo), _mm_mulhi_epi16(codes[i], mul_hi));
+            __m128 sample = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(scaled, scaled), 16));
+            __m128i clamped;
+
+            sample = _mm_add_ps(sample, _mm_mul_ps(hist1, coef1));
+            sample = _mm_add_ps(sample, _mm_mul_ps(hist2, coef2));
+            clamped = _mm_cvttps_epi32(sample);
+            clamped = _mm_packs_epi32(clamped, clamped);
+            _mm_storel_epi64((__m128i*)(rows + (row*2 + i)*4), clamped);
+
+            hist2 = hist1;
+            hist1 = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(clamped, clamped), 16));
+        }
+    }
+
+    for (n = 0; n < 30; n++) {
+        for (i = 0; i < 4; i++) {
+            out[i*32 + 2 + n] = rows[n*4 + i];
+        }
+    }
+}
+#endif
+
+#ifdef VGM_CPU_NEON
+static void s16_to_float_neon(float* dst, const sample_t* src, int count, float scale) {
+    int i;
+
+    for (i = 0; i + 8 <= count; i += 8) {
+        int16x8_t in = vld1q_s16(src + i);
+        vst1q_f32(dst + i + 0, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(in))), scale));
+        vst1q_f32(dst + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(in))), scale));
+    }
+    s16_to_float_c(dst + i, src + i, count - i, scale);
+}
+
+static void s16_deinterleave_neon(sample_t** dst, int offset, const sample_t* src, int channels, int count) {
+    sample_t* left = dst[0] + offset;
+    sample_t* right;
+    int s;
+
+    if (channels != 2) {
+        s16_deinterleave_c(dst, offset, src, channels, count);
+        return;
+    }
+    right = dst[1] + offset;
+
+    for (s = 0; s + 8 <= count; s += 8) {
+        int16x8x2_t in = vld2q_s16(src + s * 2);
+        vst1q_s16(left + s, in.val[0]);
+        vst1q_s16(right + s, in.val[1]);
+    }
+    for (; s < count; s++) {
+        left[s] = src[s * 2 + 0];
+        right[s] = src[s * 2 + 1];
+    }
+}
+
+static inline int16x8_t reverse_s16_neon(int16x8_t v) {
+    v = vrev64q_s16(v);
+    return vextq_s16(v, v, 4);
+}
+
+static inline int16x4_t imlt_round_neon(int32x4_t v) {
+    return vqmovn_s32(vshrq_n_s32(vaddq_s32(v, vdupq_n_s32(32768)), 13));
+}
+
+static void imlt_window_neon(int16_t* out, const int16_t* new_samples, const int16_t* old_samples, const int16_t* window, int size) {
+    int i, half = size / 2;
+
+    for (i = 0; i < half; i += 8) {
+        int16x8_t new_val = reverse_s16_neon(vld1q_s16(new_samples + half - 8 - i));
+        int16x8_t old_val = vld1q_s16(old_samples + i);
+        int16x8_t win_lo = vld1q_s16(window + i);
+        int16x8_t win_hi = reverse_s16_neon(vld1q_s16(window + size - 8 - i));
+        int32x4_t lo_a, lo_b, hi_a, hi_b;
+
+        lo_a = vmlal_s16(vmull_s16(vget_low_s16(new_val), vget_low_s16(win_lo)), vget_low_s16(old_val), vget_low_s16(win_hi));
+        lo_b = vmlal_s16(vmull_s16(vget_high_s16(new_val), vget_high_s16(win_lo)), vget_high_s16(old_val), vget_high_s16(win_hi));
+        hi_a = vmlsl_s16(vmull_s16(vget_low_s16(new_val), vget_low_s16(win_hi)), vget_low_s16(old_val), vget_low_s16(win_lo));
+        hi_b = vmlsl_s16(vmull_s16(vget_high_s16(new_val), vget_high_s16(win_hi)), vget_high_s16(old_val), vget_high_s16(win_lo));
+
+        vst1q_s16(out + i, vcombine_s16(imlt_round_neon(lo_a), imlt_round_neon(lo_b)));
+        vst1q_s16(out + size - 8 - i, reverse_s16_neon(vcombine_s16(imlt_round_neon(hi_a), imlt_round_neon(hi_b))));
+    }
+}
+
+static void xor_bytes_neon(uint8_t* dst, const uint8_t* key, int count) {
+    int i;
+
+    for (i = 0; i + 16 <= count; i += 16) {
+        vst1q_u8(dst + i, veorq_u8(vld1q_u8(dst + i), vld1q_u8(key + i)));
+    }
+    xor_bytes_c(dst + i, key + i, count - i);
+}
+
+static void reverse_bits_neon(uint8_t* dst, int count) {
+    const uint8x16_t mask2 = vdupq_n_u8(0x33);
+    const uint8x16_t mask1 = vdupq_n_u8(0x55);
+    int i;
+
+    for (i = 0; i + 16 <= count; i += 16) {
+        uint8x16_t val = vld1q_u8(dst + i);
+        val = vorrq_u8(vshrq_n_u8(val, 4), vshlq_n_u8(val, 4));
+        val = vorrq_u8(vandq_u8(vshrq_n_u8(val, 2), mask2), vshlq_n_u8(vandq_u8(val, mask2), 2));
+        val = vorrq_u8(vandq_u8(vshrq_n_u8(val, 1), mask1), vshlq_n_u8(vandq_u8(val, mask1), 1));
+        vst1q_u8(dst + i, val);
+    }
+    reverse_bits_c(dst + i, count - i);
+}
+
+static void vadpcm_subframe_neon(int16_t* out, const int16_t* matrix, const int16_t* nibbles, int shift, int hist2, int hist1) {
+    int16x8x2_t cols = vld2q_s16(matrix);
+    int32x4_t hist_lo = vmlal_n_s16(vmull_n_s16(vget_low_s16(cols.val[0]), hist2), vget_low_s16(cols.val[1]), hist1);
+    int32x4_t hist_hi = vmlal_n_s16(vmull_n_s16(vget_high_s16(cols.val[0]), hist2), vget_high_s16(cols.val[1]), hist1);
+    int32x4_t codes_lo = vdupq_n_s32(0);
+    int32x4_t codes_hi = vdupq_n_s32(0);
+    int32x4_t shifts = vdupq_n_s32(shift);
+    int p;
+
+    for (p = 1; p < 5; p++) {
+        cols = vld2q_s16(matrix + p*16);
+        codes_lo = vmlal_n_s16(codes_lo, vget_low_s16(cols.val[0]), nibbles[p*2 - 2]);
+        codes_lo = vmlal_n_s16(codes_lo, vget_low_s16(cols.val[1]), nibbles[p*2 - 1]);
+        codes_hi = vmlal_n_s16(codes_hi, vget_high_s16(cols.val[0]), nibbles[p*2 - 2]);
+        codes_hi = vmlal_n_s16(codes_hi, vget_high_s16(cols.val[1]), nibbles[p*2 - 1]);
+    }
+
+    hist_lo = vshrq_n_s32(vaddq_s32(hist_lo, vshlq_s32(codes_lo, shifts)), 11);
+    hist_hi = vshrq_n_s32(vaddq_s32(hist_hi, vshlq_s32(codes_hi, shifts)), 11);
+    vst1q_s16(out, vcombine_s16(vqmovn_s32(hist_lo), vqmovn_s32(hist_hi)));
+}
+
+static void s32_to_s16_neon(sample_t* dst, const int32_t* src, int count) {
+    int i;
+
+    for (i = 0; i + 8 <= count; i += 8) {
+        int16x4_t lo = vqmovn_s32(vld1q_s32(src + i + 0));
+        int16x4_t hi = vqmovn_s32(vld1q_s32(src + i + 4));
+        vst1q_s16(dst + i, vcombine_s16(lo, hi));
+    }
+    s32_to_s16_c(dst + i, src + i, count - i);
+}
+
+static void f32_scale_neon(float* dst, const float* src, float vol, int count) {
+    int i;
+
+    for (i = 0; i + 8 <= count; i += 8) {
+        vst1q_f32(dst + i + 0, vmulq_n_f32(vld1q_f32(src + i + 0), vol));
+        vst1q_f32(dst + i + 4, vmulq_n_f32(vld1q_f32(src + i + 4), vol));
+    }
+    f32_scale_c(dst + i, src + i, vol, count - i);
+}
+
+static void f32_muladd_neon(float* dst, const float* src, float vol, int count) {
+    int i;
+
+    /* separate mul and add (vfmaq/vmlaq may fuse) */
+    for (i = 0; i + 8 <= count; i += 8) {
+        float32x4_t a = vmulq_n_f32(vld1q_f32(src + i + 0), vol);
+        float32x4_t b = vmulq_n_f32(vld1q_f32(src + i + 4), vol);
+        vst1q_f32(dst + i + 0, vaddq_f32(vld1q_f32(dst + i + 0), a));
+        vst1q_f32(dst + i + 4, vaddq_f32(vld1q_f32(dst + i + 4), b));
+    }
+    f32_muladd_c(dst + i, src + i, vol, count - i);
+}
+
+static void acm_juggle_neon(int* wrap, int* block, unsigned sub_len, unsigned sub_count) {
+    unsigned i, j;
+
+    for (i = 0; i + 4 <= sub_len; i += 4) {
+        int* p = block + i;
+        int32x4x2_t w = vld2q_s32(wrap + i*2);
+        int32x4_t r0 = w.val[0];
+        int32x4_t r1 = w.val[1];
+
+        for (j = 0; j < sub_count / 2; j++) {
+            int32x4_t r2 = vld1q_s32(p);
+            int32x4_t r3;
+            vst1q_s32(p, vaddq_s32(vshlq_n_s32(r1, 1), vaddq_s32(r0, r2)));
+            p += sub_len;
+            r3 = vld1q_s32(p);
+            vst1q_s32(p, vsubq_s32(vshlq_n_s32(r2, 1), vaddq_s32(r1, r3)));
+            p += sub_len;
+            r0 = r2;
+            r1 = r3;
+        }
+
+        w.val[0] = r0;
+        w.val[1] = r1;
+        vst2q_s32(wrap + i*2, w);
+    }
+    acm_juggle_columns_c(wrap, block, sub_len, sub_count, i);
+}
+#endif
+
+
+/* ******************************************** */
+/* SELECTION                                    */
+/* ******************************************** */
+
+static const vgm_kernels_t kernels_c = {
+    s16_to_float_c,
+    s16_deinterleave_c,
+    imlt_window_c,
+    xor_bytes_c,
+    reverse_bits_c,
+    vadpcm_subframe_c,
+    s32_to_s16_c,
+    f32_scale_c,
+    f32_muladd_c,
+    acm_juggle_c,
+    ea_xas_groups_c,
+};
+static vgm_kernels_t kernels = {
+    s16_to_float_c,
+    s16_deinterleave_c,
+    imlt_window_c,
+    xor_bytes_c,
+    reverse_bits_c,
+    vadpcm_subframe_c,
+    s32_to_s16_c,
+    f32_scale_c,
+    f32_muladd_c,
+    acm_juggle_c,
+    ea_xas_groups_c,
+};
+
+/* Alternate kernels, in order of preference (later entries replace earlier ones when supported) */
+typedef struct {
+    uint32_t features;
+    size_t slot;            /* offset of the kernel in vgm_kernels_t */
+    void (*function)(void);
+} vgm_kernel_entry_t;
+
+#define VGM_KERNEL(features, name, function) { features, offsetof(vgm_kernels_t, name), (void (*)(void))function }
+
+static const vgm_kernel_entry_t kernel_list[] = {
+#ifdef VGM_CPU_X86
+    VGM_KERNEL(VGMSTREAM_CPU_SSE2,  s16_to_float, s16_to_float_sse2),
+    VGM_KERNEL(VGMSTREAM_CPU_AVX2,  s16_to_float, s16_to_float_avx2),
+    VGM_KERNEL(VGMSTREAM_CPU_SSE2,  s16_deinterleave, s16_deinterleave_sse2),
+    VGM_KERNEL(VGMSTREAM_CPU_SSE2,  imlt_window, imlt_window_sse2),
+    VGM_KERNEL(VGMSTREAM_CPU_SSE2,  xor_bytes, xor_bytes_sse2),
+    VGM_KERNEL(VGMSTREAM_CPU_SSE2,  reverse_bits, reverse_bits_sse2),
+    VGM_KERNEL(VGMSTREAM_CPU_SSE2,  vadpcm_subframe, vadpcm_subframe_sse2),
+    VGM_KERNEL(VGMSTREAM_CPU_SSE2,  s32_to_s16, s32_to_s16_sse2),
+    VGM_KERNEL(VGMSTREAM_CPU_SSE2,  f32_scale, f32_scale_sse2),
+    VGM_KERNEL(VGMSTREAM_CPU_AVX2,  f32_scale, f32_scale_avx2),
+    VGM_KERNEL(VGMSTREAM_CPU_SSE2,  f32_muladd, f32_muladd_sse2),
+    VGM_KERNEL(VGMSTREAM_CPU_AVX2,  f32_muladd, f32_muladd_avx2),
+    VGM_KERNEL(VGMSTREAM_CPU_SSE2,  acm_juggle, acm_juggle_sse2),
+    VGM_KERNEL(VGMSTREAM_CPU_SSE2,  ea_xas_groups, ea_xas_groups_sse2),
+#endif
+#ifdef VGM_CPU_NEON
+    VGM_KERNEL(VGMSTREAM_CPU_NEON,  s16_to_float, s16_to_float_neon),
+    VGM_KERNEL(VGMSTREAM_CPU_NEON,  s16_deinterleave, s16_deinterleave_neon),
+    VGM_KERNEL(VGMSTREAM_CPU_NEON,  imlt_window, imlt_window_neon),
+    VGM_KERNEL(VGMSTREAM_CPU_NEON,  xor_bytes, xor_bytes_neon),
+    VGM_KERNEL(VGMSTREAM_CPU_NEON,  reverse_bits, reverse_bits_neon),
+    VGM_KERNEL(VGMSTREAM_CPU_NEON,  vadpcm_subframe, vadpcm_subframe_neon),
+    VGM_KERNEL(VGMSTREAM_CPU_NEON,  s32_to_s16, s32_to_s16_neon),
+    VGM_KERNEL(VGMSTREAM_CPU_NEON,  f32_scale, f32_scale_neon),
+    VGM_KERNEL(VGMSTREAM_CPU_NEON,  f32_muladd, f32_muladd_neon),
+    VGM_KERNEL(VGMSTREAM_CPU_NEON,  acm_juggle, acm_juggle_neon),
+    VGM_KERNEL(VGMSTREAM_CPU_NEON,  ea_xas_groups, ea_xas_groups_neon),
+#endif
+    { 0, 0, NULL }
+};
+
+static uint32_t cpu_disabled = 0;
+static vgm_once_t g_kernels_selected = 0;
+
+
+#ifdef VGM_CPU_X86
+static void get_cpuid(int leaf, uint32_t* regs) {
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuidex(info, leaf, 0);
+    regs[0] = info[0]; regs[1] = info[1]; regs[2] = info[2]; regs[3] = info[3];
+#else
+    regs[0] = regs[1] = regs[2] = regs[3] = 0;
+    __cpuid_count(leaf, 0, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+static uint64_t get_xcr0(void) {
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    uint32_t lo, hi;
+    __asm__ __volatile__ ("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    return ((uint64_t)hi << 32) | lo;
+#endif
+}
+#endif
+
+uint32_t vgmstream_get_cpu_features(void) {
+    uint32_t features = 0;
+
+#ifdef VGM_CPU_X86
+    {
+        uint32_t regs[4];
+        int max_leaf;
+
+        get_cpuid(0, regs);
+        max_leaf = regs[0];
+
+        if (max_leaf >= 1) {
+            get_cpuid(1, regs);
+            if (regs[3] & (1 << 26))
+                features |= VGMSTREAM_CPU_SSE2;
+            if (regs[2] & (1 << 19))
+                features |= VGMSTREAM_CPU_SSE41;
+
+            /* AVX2 also needs the OS saving YMM registers (OSXSAVE + XCR0 SSE/AVX state) */
+            if (max_leaf >= 7 && (regs[2] & (1 << 27)) && (get_xcr0() & 0x06) == 0x06) {
+                get_cpuid(7, regs);
+                if (regs[1] & (1 << 5))
+                    features |= VGMSTREAM_CPU_AVX2;
+            }
+        }
+    }
+#endif
+
+#ifdef VGM_CPU_NEON
+    features |= VGMSTREAM_CPU_NEON; /* part of the compile target */
+#endif
+
+    return features;
+}
+
+static void select_kernels(void) {
+    uint32_t features = vgmstream_get_cpu_features() & ~cpu_disabled;
+    const vgm_kernel_entry_t* entry;
+
+    kernels = kernels_c;
+
+    for (entry = kernel_list; entry->function; entry++) {
+        if ((entry->features & features) != entry->features)
+            continue;
+        *(void (**)(void))((uint8_t*)&kernels + entry->slot) = entry->function;
+    }
+}
+
+void vgmstream_cpu_setup(uint32_t disabled_features) {
+    cpu_disabled = disabled_features;
+    vgm_once(&g_kernels_selected, select_kernels); /* so first use doesn't select again */
+    select_kernels();
+}
+
+const vgm_kernels_t* vgm_get_kernels(void) {
+    vgm_once(&g_kernels_selected, select_kernels);
+    return &kernels;
+}
@@ -0,0 +1,49 @@
+/*
+ * cpu.h - CPU features and alternate kernels of hot loops, picked once at runtime
+ */
+#ifndef _CPU_H
+#define _CPU_H
+
+#include "streamtypes.h"
+
+/* Kernels used by decoders/mixing. Each starts as the portable C version and is replaced by the best
+ * one the CPU supports (see kernel_list in cpu.c to add alternates). All versions must give the same
+ * results, so forcing the C ones (vgmstream_cpu_setup) is only slower. */
+typedef struct {
+    /* dst[i] = src[i] * scale */
+    void (*s16_to_float)(float* dst, const sample_t* src, int count, float scale);
+    /* dst[ch][offset + s] = src[s * channels + ch], for count samples of each channel */
+    void (*s16_deinterleave)(sample_t** dst, int offset, const sample_t* src, int channels, int count);
+    /* MLT overlap-add of size samples, with h = size/2 and for i < h, m = new_samples[h-1-i]:
+     * out[i] = clamp16((m * window[i] + old[i] * window[size-1-i] + 32768) >> 13),
+     * out[size-1-i] = clamp16((m * window[size-1-i] - old[i] * window[i] + 32768) >> 13). size is a multiple of 16. */
+    void (*imlt_window)(int16_t* out, const int16_t* new_samples, const int16_t* old_samples, const int16_t* window, int size);
+    /* dst[i] ^= key[i] */
+    void (*xor_bytes)(uint8_t* dst, const uint8_t* key, int count);
+    /* dst[i] = dst[i] with bits in reverse order */
+    void (*reverse_bits)(uint8_t* dst, int count);
+    /* VADPCM sub-frame of 8 samples, from a matrix of 5 column pairs (16 values each, row i at [i*2+0/1]):
+     * out[i] = clamp16((hist2 * m[0][i][0] + hist1 * m[0][i][1] + (sum(p=1..4) nibbles[2p-2] * m[p][i][0] + nibbles[2p-1] * m[p][i][1]) << shift) >> 11),
+     * with 32-bit wrapping sums. */
+    void (*vadpcm_subframe)(int16_t* out, const int16_t* matrix, const int16_t* nibbles, int shift, int hist2, int hist1);
+    /* dst[i] = clamp16(src[i]) */
+    void (*s32_to_s16)(sample_t* dst, const int32_t* src, int count);
+    /* dst[i] = src[i] * vol */
+    void (*f32_scale)(float* dst, const float* src, float vol, int count);
+    /* dst[i] = dst[i] + src[i] * vol (product rounded first, not a fused multiply-add) */
+    void (*f32_muladd)(float* dst, const float* src, float vol, int count);
+    /* ACM juggle pass: for each of sub_len columns c (rows are sub_len apart in block, wrap has a r0/r1 pair per column),
+     * r0/r1 = wrap[c*2+0/1], then for each row pair: r2 = row0, row0 = r1*2 + (r0 + r2), r3 = row1, row1 = r2*2 - (r1 + r3),
+     * r0 = r2, r1 = r3; then wrap[c*2+0/1] = r0/r1. sub_count is even, sums wrap. */
+    void (*acm_juggle)(int* wrap, int* block, unsigned sub_len, unsigned sub_count);
+    /* EA-XAS v1 frame body: 4 groups decoded in parallel from 15 rows of 4 bytes (group g at nibbles[row*4 + g],
+     * high nibble first), each with hist1/hist2 = hists[g*2+0/1], coef1/coef2 = coefs[g*2+0/1] and shifts[g]:
+     * out[g*32 + 2 + n] = hist1 = clamp16((int)(((int16_t)(nibble << 12) >> shift) + hist1 * coef1 + hist2 * coef2)),
+     * with float math in that order (2 header samples per group are left to the caller). */
+    void (*ea_xas_groups)(int16_t* out, const uint8_t* nibbles, const float* coefs, const int16_t* hists, const int* shifts);
+} vgm_kernels_t;
+
+/* Kernels for this CPU (selected on first call). */
+const vgm_kernels_t* vgm_get_kernels(void);
+
+#endif /* _CPU_H */
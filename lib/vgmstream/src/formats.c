@@ -12,6 +12,8 @@
  * formats not parsed don't need to go there (for example .stm is a Scream Tracker Module elsewhere,
  * but our .stm is very different so there is no conflict). */
 
+/* Both lists must be kept in alphabetical (case-insensitive) order, as plugins binary search them. */
+
 /* Some extensions require external libraries and could be #ifdef, not worth. */
 
 /* Formats marked as "not parsed" mean they'll go through FFmpeg, the header/extension isn't
@@ -51,8 +53,8 @@ static const char* extension_list[] = {
     "afc",
     "afs2",
     "agsc",
-    "ahx",
     "ahv",
+    "ahx",
     "ai",
     //"aif", //common
     "aif-Loop",
@@ -102,9 +104,9 @@ static const char* extension_list[] = {
     "bgw",
     "bh2pcm",
     "bik",
-    "bika",
     "bik2",
     //"bin", //common
+    "bika",
     "bk2",
     "blk",
     "bmdx",
@@ -142,8 +144,8 @@ static const char* extension_list[] = {
     "data",
     "dax",
     "dbm",
-    "dct",
     "dcs",
+    "dct",
     "ddsp",
     "de2",
     "dec",
@@ -202,6 +204,7 @@ static const char* extension_list[] = {
     "his",
     "hps",
     "hsf",
+    "hwas",
     "hwx", //txth/reserved [Star Wars Episode III (Xbox)]
     "hx2",
     "hx3",
@@ -209,7 +212,6 @@ static const char* extension_list[] = {
     "hxd",
     "hxg",
     "hxx",
-    "hwas",
 
     "iab",
     "iadp",
@@ -231,8 +233,8 @@ static const char* extension_list[] = {
     "isd",
     "isws",
     "itl",
-    "ivaud",
     "ivag",
+    "ivaud",
     "ivb",
     "ivs", //txth/reserved [Burnout 2 (PS2)]
 
@@ -244,8 +246,8 @@ static const char* extension_list[] = {
     "kcey", //fake extension/header id for .pcm (renamed, to be removed)
     "khv", //fake extension/header id for .vas (renamed, to be removed)
     "km9",
-    "kovs", //fake extension/header id for .kvs
     "kns",
+    "kovs", //fake extension/header id for .kvs
     "kraw",
     "ktsl2asbin",
     "ktss", //fake extension/header id for .kns
@@ -254,10 +256,10 @@ static const char* extension_list[] = {
     "l",
     "l00", //txth/reserved [Disney's Dinosaur (PS2)]
     "laac", //fake extension for .aac (tri-Ace)
+    "lac3", //fake extension for .ac3, FFmpeg/not parsed
     "laif", //fake extension for .aif (various)
-    "laiff", //fake extension for .aiff
     "laifc", //fake extension for .aifc
-    "lac3", //fake extension for .ac3, FFmpeg/not parsed
+    "laiff", //fake extension for .aiff
     "lasf", //fake extension for .asf (various)
     "lbin", //fake extension for .bin (various)
     "leg",
@@ -311,8 +313,8 @@ static const char* extension_list[] = {
     //"mp3", //common
     //"mp4", //common
     //"mpc", //common
-    "mpdsp",
     "mpds",
+    "mpdsp",
     "mpf",
     "mps", //txth/reserved [Scandal (PS2)]
     "ms",
@@ -420,17 +422,9 @@ static const char* extension_list[] = {
     "sb5",
     "sb6",
     "sb7",
+    "sbin",
     "sbr",
     "sbv",
-    "sm0",
-    "sm1",
-    "sm2",
-    "sm3",
-    "sm4",
-    "sm5",
-    "sm6",
-    "sm7",
-    "sbin",
     "sc",
     "scd",
     "sch",
@@ -450,6 +444,14 @@ static const char* extension_list[] = {
     "sl3",
     "slb", //txth/reserved [THE Nekomura no Hitobito (PS2)]
     "sli",
+    "sm0",
+    "sm1",
+    "sm2",
+    "sm3",
+    "sm4",
+    "sm5",
+    "sm6",
+    "sm7",
     "smc",
     "smk",
     "smp",
@@ -484,8 +486,8 @@ static const char* extension_list[] = {
     "sts",
     "stx",
     "svag",
-    "svs",
     "svg",
+    "svs",
     "swag",
     "swav",
     "swd",
@@ -523,9 +525,10 @@ static const char* extension_list[] = {
     "vb",
     "vbk",
     "vbx", //txth/reserved [THE Taxi 2 (PS2)]
-    "vds",
     "vdm",
+    "vds",
     "vgm", //txth/reserved [Maximo (PS2)]
+    "vgmstream", /* fake extension, catch-all for FFmpeg/txth/etc */
     "vgs",
     "vgv",
     "vid",
@@ -584,18 +587,18 @@ static const char* extension_list[] = {
     "xen",
     "xma",
     "xma2",
+    "xmd",
     "xmu",
     "xnb",
-    "xsf",
+    "xopus",
+    "xps",
     "xsew",
+    "xsf",
     "xss",
     "xvag",
     "xvas",
     "xwav", //fake extension for .wav (renamed, to be removed)
     "xwb",
-    "xmd",
-    "xopus",
-    "xps",
     "xwc",
     "xwm",
     "xwma",
@@ -611,8 +614,6 @@ static const char* extension_list[] = {
     "zss",
     "zwdsp",
 
-    "vgmstream" /* fake extension, catch-all for FFmpeg/txth/etc */
-
     //, NULL //end mark
 };
 
@@ -1,5 +1,81 @@
 #include "layout.h"
 #include "../vgmstream.h"
+#include <stddef.h>
+
+#define BLOCK_INDEX_SPACING 32768   /* min samples between indexed blocks */
+#define BLOCK_INDEX_MAX_ENTRIES 512 /* spacing grows for longer streams, entries hold all channels */
+#define BLOCK_SEEK_BUFFER 1024      /* samples per discard render when seeking */
+#define BLOCK_RING_ENTRIES 16       /* blocks parsed ahead at once (see block_update_ahead) */
+#define BLOCK_RING_BUFFER 0x10000   /* buffer of the separate header reader */
+#define BLOCK_FILE_ID 0x56534958    /* "VSIX" */
+#define BLOCK_FILE_VERSION 1        /* bump when the saved format changes without the checked sizes changing */
+#define BLOCK_FILE_HASH_SIZE 0x10000 /* bytes hashed at the start and end of the file to name saved indexes */
+
+/* channel values a layout's block parser may set, besides offset (see get_ring_fields) */
+#define BLOCK_RING_HIST 0x01        /* ADPCM hists and IMA step */
+#define BLOCK_RING_COEF 0x02        /* ADPCM coefs */
+
+/* Block values and channels right after block_update, restoring them resumes decoding at that
+ * block, as long as the codec keeps all its state in the channels (no codec_data). */
+typedef struct {
+    int32_t sample;
+    off_t current_block_offset;
+    size_t current_block_size;
+    int32_t current_block_samples;
+    off_t next_block_offset;
+    size_t full_block_size;
+    int codec_config;
+    int32_t ws_output_size;
+} block_index_entry_t;
+
+typedef struct {
+    int channels;
+    int32_t num_samples;
+    int32_t spacing;
+    int count;
+    int max;
+    block_index_entry_t* entries;
+    VGMSTREAMCHANNEL* ch; /* channels per entry */
+
+    /* saved across sessions (see vgmstream_seek_index_cache_setup) */
+    char name[17];        /* empty if not saved */
+    int saved_count;      /* entries already in the saved index */
+
+    /* Lookahead of the next blocks, parsed in a row through ring_sf (so the data reader keeps its
+     * buffer) and applied from memory. Entries are keyed by offset and the previous full_block_size
+     * (some parsers derive the next offset from it), so loops/seeks/resets simply refill it. */
+    STREAMFILE* ring_sf;
+    int ring_fields;
+    int ring_head;
+    int ring_count;
+    off_t ring_offsets[BLOCK_RING_ENTRIES];
+    size_t ring_full_sizes[BLOCK_RING_ENTRIES];
+    block_index_entry_t ring[BLOCK_RING_ENTRIES];
+    VGMSTREAMCHANNEL* ring_ch; /* channels per ring entry */
+} block_index_t;
+
+/* Header of saved indexes, followed by the entries and their channels. Only valid for the same
+ * build, as channels are saved as they are in memory (minus pointers, restored from the stream). */
+typedef struct {
+    uint32_t id;
+    uint32_t version;
+    uint32_t build;             /* detection version and struct layouts */
+    int32_t channels;
+    int32_t num_samples;
+    int32_t spacing;
+    int32_t count;
+} block_index_file_t;
+
+static struct {
+    int enabled;
+    size_t (*load)(const char* name, void* buf, size_t max_size, void* data);
+    void (*save)(const char* name, const void* buf, size_t size, void* data);
+    void* data;
+} block_index_cache;
+
+static void init_block_index(VGMSTREAM* vgmstream);
+static void add_block_index(VGMSTREAM* vgmstream);
+static void block_update_ahead(off_t block_offset, VGMSTREAM* vgmstream);
 
 
 /* Decodes samples for blocked streams.
@@ -9,8 +85,13 @@ void render_vgmstream_blocked(sample_t * buffer, int32_t sample_count, VGMSTREAM
     int samples_written = 0;
     int frame_size, samples_per_frame, samples_this_block;
 
-    frame_size = get_vgmstream_frame_size(vgmstream);
-    samples_per_frame = get_vgmstream_samples_per_frame(vgmstream);
+    if (!vgmstream->block_index && !vgmstream->codec_data)
+        init_block_index(vgmstream); /* if not prepared */
+
+    if (!vgmstream->frame_geometry_valid)
+        vgmstream_update_frame_geometry(vgmstream);
+    frame_size = vgmstream->frame_bytes;
+    samples_per_frame = vgmstream->frame_samples;
     samples_this_block = 0;
 
     if (vgmstream->current_block_samples) {
@@ -69,11 +150,14 @@ void render_vgmstream_blocked(sample_t * buffer, int32_t sample_count, VGMSTREAM
         /* move to next block when all samples are consumed */
         if (vgmstream->samples_into_block == samples_this_block
                 /*&& vgmstream->current_sample < vgmstream->num_samples*/) { /* don't go past last block */ //todo
-            block_update(vgmstream->next_block_offset,vgmstream);
+            block_update_ahead(vgmstream->next_block_offset,vgmstream);
+            add_block_index(vgmstream);
 
             /* update since these may change each block */
-            frame_size = get_vgmstream_frame_size(vgmstream);
-            samples_per_frame = get_vgmstream_samples_per_frame(vgmstream);
+            if (!vgmstream->frame_geometry_valid)
+                vgmstream_update_frame_geometry(vgmstream);
+            frame_size = vgmstream->frame_bytes;
+            samples_per_frame = vgmstream->frame_samples;
             if (vgmstream->current_block_samples) {
                 samples_this_block = vgmstream->current_block_samples;
             } else if (frame_size == 0) { /* assume 4 bit */ //TODO: get_vgmstream_frame_size() really should return bits... */
@@ -88,8 +172,477 @@ void render_vgmstream_blocked(sample_t * buffer, int32_t sample_count, VGMSTREAM
     }
 }
 
+void prepare_layout_blocked(VGMSTREAM* vgmstream) {
+    if (!vgmstream->block_index && !vgmstream->codec_data)
+        init_block_index(vgmstream);
+}
+
+/* Channel values set by the layout's block parser besides offsets, or -1 if blocks can't be parsed
+ * ahead (parsers that touch codec state, or read values the decoder changes). */
+static int get_ring_fields(VGMSTREAM* vgmstream) {
+    switch (vgmstream->layout_type) {
+        case layout_blocked_xa:
+            return 0;
+        case layout_blocked_thp:
+            return BLOCK_RING_HIST | BLOCK_RING_COEF;
+        case layout_blocked_ea_schl:
+            return vgmstream->coding_type == coding_DVI_IMA ? BLOCK_RING_HIST : 0;
+        default:
+            return -1;
+    }
+}
+
+void vgmstream_seek_index_cache_setup(int enabled, size_t (*load)(const char* name, void* buf, size_t max_size, void* data),
+        void (*save)(const char* name, const void* buf, size_t size, void* data), void* data) {
+    block_index_cache.enabled = enabled && load && save;
+    block_index_cache.load = load;
+    block_index_cache.save = save;
+    block_index_cache.data = data;
+}
+
+static uint64_t hash_block_data(uint64_t hash, const void* data, size_t size) {
+    const uint8_t* bytes = data;
+    size_t i;
+
+    for (i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * 0x100000001B3ULL; /* FNV-1a */
+    }
+    return hash;
+}
+
+static uint64_t hash_block_value(uint64_t hash, int64_t value) {
+    return hash_block_data(hash, &value, sizeof(value));
+}
+
+/* Changes with the detection version and layouts of what's saved, so other builds' indexes are ignored. */
+static uint32_t get_block_index_build(void) {
+    uint64_t hash = 0xCBF29CE484222325ULL;
+
+    hash = hash_block_value(hash, vgmstream_get_detection_version());
+    hash = hash_block_value(hash, sizeof(block_index_entry_t));
+    hash = hash_block_value(hash, sizeof(VGMSTREAMCHANNEL));
+    hash = hash_block_value(hash, offsetof(VGMSTREAMCHANNEL, adpcm_coef));
+    hash = hash_block_value(hash, offsetof(VGMSTREAMCHANNEL, channel_start_offset));
+    hash = hash_block_value(hash, offsetof(VGMSTREAMCHANNEL, adpcm_history3_16));
+    hash = hash_block_value(hash, offsetof(VGMSTREAMCHANNEL, adx_xor));
+    hash = hash_block_value(hash, offsetof(VGMSTREAMCHANNEL, adpcm_history1_double));
+    hash = hash_block_value(hash, offsetof(VGMSTREAMCHANNEL, g72x_state));
+    return (uint32_t)(hash ^ (hash >> 32));
+}
+
+/* Names the index after the file's data (its start and end, not all of it as big files would take
+ * a while) and the stream in it, so it's found again for the same file under other paths. */
+static void get_block_index_name(VGMSTREAM* vgmstream, char* name) {
+    STREAMFILE* sf = vgmstream->ch[0].streamfile;
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    size_t file_size = get_streamfile_size(sf);
+    uint8_t* buf;
+    int ch;
+
+    buf = malloc(BLOCK_FILE_HASH_SIZE);
+    if (!buf) return;
+    hash = hash_block_data(hash, buf, read_streamfile(buf, 0, BLOCK_FILE_HASH_SIZE, sf));
+    if (file_size > BLOCK_FILE_HASH_SIZE)
+        hash = hash_block_data(hash, buf, read_streamfile(buf, file_size - BLOCK_FILE_HASH_SIZE, BLOCK_FILE_HASH_SIZE, sf));
+    free(buf);
+
+    hash = hash_block_value(hash, file_size);
+    hash = hash_block_value(hash, vgmstream->meta_type);
+    hash = hash_block_value(hash, vgmstream->layout_type);
+    hash = hash_block_value(hash, vgmstream->coding_type);
+    hash = hash_block_value(hash, vgmstream->stream_index);
+    hash = hash_block_value(hash, vgmstream->num_samples);
+    hash = hash_block_value(hash, vgmstream->sample_rate);
+    hash = hash_block_value(hash, vgmstream->channels);
+    for (ch = 0; ch < vgmstream->channels; ch++) {
+        hash = hash_block_value(hash, vgmstream->start_ch[ch].offset);
+    }
+
+    snprintf(name, 17, "%08x%08x", (uint32_t)(hash >> 32), (uint32_t)hash);
+}
+
+/* Channel pointers point to the stream's own readers and tables, so saved channels take the stream's. */
+static void set_block_index_pointers(VGMSTREAMCHANNEL* dst, const VGMSTREAMCHANNEL* src, int channels) {
+    int ch;
+
+    for (ch = 0; ch < channels; ch++) {
+        dst[ch].streamfile = src ? src[ch].streamfile : NULL;
+        dst[ch].adpcm_coef_3by32 = src ? src[ch].adpcm_coef_3by32 : NULL;
+        dst[ch].vadpcm_coefs = src ? src[ch].vadpcm_coefs : NULL;
+        dst[ch].vadpcm_book = src ? src[ch].vadpcm_book : NULL;
+    }
+}
+
+static void load_block_index(VGMSTREAM* vgmstream, block_index_t* index) {
+    block_index_file_t header;
+    size_t entries_size, max_size, size;
+    uint8_t* buf;
+    int i;
+
+    /* usually fits in what the first pass needs, bigger ones are read again */
+    entries_size = sizeof(block_index_entry_t) + index->channels * sizeof(VGMSTREAMCHANNEL);
+    max_size = sizeof(block_index_file_t) + index->max * entries_size;
+    buf = malloc(max_size);
+    if (!buf) return;
+
+    size = block_index_cache.load(index->name, buf, max_size, block_index_cache.data);
+    if (size > max_size && size <= sizeof(block_index_file_t) + BLOCK_INDEX_MAX_ENTRIES * entries_size) {
+        uint8_t* buf_re = realloc(buf, size);
+        if (!buf_re) goto fail;
+        buf = buf_re;
+        max_size = size;
+        size = block_index_cache.load(index->name, buf, max_size, block_index_cache.data);
+    }
+    if (size < sizeof(block_index_file_t) || size > max_size)
+        goto fail;
+
+    memcpy(&header, buf, sizeof(block_index_file_t));
+    if (header.id != BLOCK_FILE_ID || header.version != BLOCK_FILE_VERSION || header.build != get_block_index_build() ||
+            header.channels != index->channels || header.num_samples != vgmstream->num_samples ||
+            header.spacing != index->spacing || header.count <= 0 || header.count > BLOCK_INDEX_MAX_ENTRIES ||
+            size != sizeof(block_index_file_t) + header.count * entries_size)
+        goto fail;
+
+    if (header.count > index->max) {
+        block_index_entry_t* entries_re;
+        VGMSTREAMCHANNEL* ch_re;
+
+        entries_re = realloc(index->entries, header.count * sizeof(block_index_entry_t));
+        if (!entries_re) goto fail;
+        index->entries = entries_re;
+
+        ch_re = realloc(index->ch, header.count * index->channels * sizeof(VGMSTREAMCHANNEL));
+        if (!ch_re) goto fail;
+        index->ch = ch_re;
+
+        index->max = header.count;
+    }
+
+    memcpy(index->entries, buf + sizeof(block_index_file_t), header.count * sizeof(block_index_entry_t));
+    memcpy(index->ch, buf + sizeof(block_index_file_t) + header.count * sizeof(block_index_entry_t),
+            header.count * index->channels * sizeof(VGMSTREAMCHANNEL));
+    for (i = 0; i < header.count; i++) {
+        set_block_index_pointers(&index->ch[i * index->channels], vgmstream->ch, index->channels);
+    }
+    index->count = header.count;
+    index->saved_count = header.count;
+fail:
+    free(buf);
+}
+
+/* Saves the index when this session added entries (the first pass went further than last time's). */
+static void save_block_index(block_index_t* index) {
+    block_index_file_t header;
+    size_t entries_offset, ch_offset, size;
+    uint8_t* buf;
+    int i;
+
+    if (!block_index_cache.enabled || !index->name[0] || index->count <= index->saved_count)
+        return;
+
+    entries_offset = sizeof(block_index_file_t);
+    ch_offset = entries_offset + index->count * sizeof(block_index_entry_t);
+    size = ch_offset + index->count * index->channels * sizeof(VGMSTREAMCHANNEL);
+    buf = calloc(1, size);
+    if (!buf) return;
+
+    header.id = BLOCK_FILE_ID;
+    header.version = BLOCK_FILE_VERSION;
+    header.build = get_block_index_build();
+    header.channels = index->channels;
+    header.num_samples = index->num_samples;
+    header.spacing = index->spacing;
+    header.count = index->count;
+    memcpy(buf, &header, sizeof(block_index_file_t));
+    memcpy(buf + entries_offset, index->entries, index->count * sizeof(block_index_entry_t));
+    memcpy(buf + ch_offset, index->ch, index->count * index->channels * sizeof(VGMSTREAMCHANNEL));
+    for (i = 0; i < index->count; i++) {
+        set_block_index_pointers((VGMSTREAMCHANNEL*)(buf + ch_offset) + i * index->channels, NULL, index->channels);
+    }
+
+    block_index_cache.save(index->name, buf, size, block_index_cache.data);
+    index->saved_count = index->count;
+    free(buf);
+}
+
+static void init_block_index(VGMSTREAM* vgmstream) {
+    block_index_t* index = calloc(1, sizeof(block_index_t));
+    int max;
+    if (!index) return;
+
+    index->channels = vgmstream->channels;
+    index->num_samples = vgmstream->num_samples;
+    index->spacing = vgmstream->num_samples / BLOCK_INDEX_MAX_ENTRIES;
+    if (index->spacing < BLOCK_INDEX_SPACING)
+        index->spacing = BLOCK_INDEX_SPACING;
+
+    /* sized for the whole first pass, so indexing while playing doesn't allocate (unless num_samples is off) */
+    max = vgmstream->num_samples / index->spacing + 1;
+    if (max > BLOCK_INDEX_MAX_ENTRIES)
+        max = BLOCK_INDEX_MAX_ENTRIES;
+    index->entries = malloc(max * sizeof(block_index_entry_t));
+    index->ch = malloc(max * index->channels * sizeof(VGMSTREAMCHANNEL));
+    if (index->entries && index->ch)
+        index->max = max;
+
+    if (block_index_cache.enabled && index->max && vgmstream->ch[0].streamfile) {
+        get_block_index_name(vgmstream, index->name);
+        if (index->name[0])
+            load_block_index(vgmstream, index);
+    }
+
+    index->ring_fields = get_ring_fields(vgmstream);
+    if (index->ring_fields >= 0 && vgmstream->ch[0].streamfile) {
+        index->ring_ch = malloc(BLOCK_RING_ENTRIES * index->channels * sizeof(VGMSTREAMCHANNEL));
+        index->ring_sf = reopen_streamfile(vgmstream->ch[0].streamfile, BLOCK_RING_BUFFER);
+    }
+
+    /* resets restore start_vgmstream, that must keep the index too */
+    vgmstream->block_index = index;
+    ((VGMSTREAM*)vgmstream->start_vgmstream)->block_index = index;
+}
+
+/* Called after moving to a new block, adds it when far enough from the last one. Only the first
+ * pass is indexed, as looping may carry ADPCM history (see vgmstream_do_loop). */
+static void add_block_index(VGMSTREAM* vgmstream) {
+    block_index_t* index = vgmstream->block_index;
+    block_index_entry_t* entry;
+    int32_t last_sample;
+
+    if (!index || vgmstream->loop_count > 0 || index->count >= BLOCK_INDEX_MAX_ENTRIES)
+        return;
+
+    last_sample = index->count ? index->entries[index->count - 1].sample : 0;
+    if (vgmstream->current_sample < last_sample + index->spacing)
+        return;
+
+    if (index->count == index->max) {
+        int max = index->max ? index->max * 2 : 16;
+        block_index_entry_t* entries_re;
+        VGMSTREAMCHANNEL* ch_re;
+
+        entries_re = realloc(index->entries, max * sizeof(block_index_entry_t));
+        if (!entries_re) return;
+        index->entries = entries_re;
+
+        ch_re = realloc(index->ch, max * index->channels * sizeof(VGMSTREAMCHANNEL));
+        if (!ch_re) return;
+        index->ch = ch_re;
+
+        index->max = max;
+    }
+
+    entry = &index->entries[index->count];
+    entry->sample = vgmstream->current_sample;
+    entry->current_block_offset = vgmstream->current_block_offset;
+    entry->current_block_size = vgmstream->current_block_size;
+    entry->current_block_samples = vgmstream->current_block_samples;
+    entry->next_block_offset = vgmstream->next_block_offset;
+    entry->full_block_size = vgmstream->full_block_size;
+    entry->codec_config = vgmstream->codec_config;
+    entry->ws_output_size = vgmstream->ws_output_size;
+    memcpy(&index->ch[index->count * index->channels], vgmstream->ch, index->channels * sizeof(VGMSTREAMCHANNEL));
+    index->count++;
+}
+
+void free_layout_blocked_index(void* block_index) {
+    block_index_t* index = block_index;
+
+    if (!index)
+        return;
+    save_block_index(index);
+    free(index->entries);
+    free(index->ch);
+    free(index->ring_ch);
+    close_streamfile(index->ring_sf);
+    free(index);
+}
+
+/* Jumps to the last indexed block before seek_sample (or keeps the current position if closer)
+ * and discards samples up to it. Blocks past the furthest one played aren't known, so those
+ * are reached by decoding forward from there. */
+int seek_layout_blocked(VGMSTREAM* vgmstream, int32_t seek_sample) {
+    block_index_t* index = vgmstream->block_index;
+    block_index_entry_t* entry = NULL;
+    int32_t max_sample = seek_sample;
+    sample_t* buffer;
+    int low, high;
+
+    if (!index || index->channels != vgmstream->channels)
+        return 0;
+    if (seek_sample < 0 || seek_sample >= vgmstream->num_samples)
+        return 0;
+
+    /* positions past loop end are later loops (loop_flag may be disabled by now after a loop target) */
+    if (((VGMSTREAM*)vgmstream->start_vgmstream)->loop_flag && seek_sample > vgmstream->loop_end_sample)
+        return 0;
+
+    /* loop start state is saved once reached (kept after that), so it has to be decoded first */
+    if (vgmstream->loop_flag && !vgmstream->hit_loop && seek_sample > vgmstream->loop_start_sample)
+        max_sample = vgmstream->loop_start_sample;
+
+    low = 0;
+    high = index->count - 1;
+    while (low <= high) {
+        int mid = (low + high) / 2;
+        if (index->entries[mid].sample <= max_sample) {
+            entry = &index->entries[mid];
+            low = mid + 1;
+        }
+        else {
+            high = mid - 1;
+        }
+    }
+
+    if (vgmstream->loop_count == 0 && vgmstream->current_sample <= max_sample &&
+            (!entry || entry->sample <= vgmstream->current_sample)) {
+        entry = NULL; /* decoding forward from here is closer */
+    }
+    else if (!entry) {
+        return 0;
+    }
+
+    buffer = malloc(BLOCK_SEEK_BUFFER * vgmstream->channels * sizeof(sample_t));
+    if (!buffer) return 0;
+
+    if (entry) {
+        memcpy(vgmstream->ch, &index->ch[(entry - index->entries) * index->channels], index->channels * sizeof(VGMSTREAMCHANNEL));
+        vgmstream->current_sample = entry->sample;
+        vgmstream->samples_into_block = 0;
+        vgmstream->current_block_offset = entry->current_block_offset;
+        vgmstream->current_block_size = entry->current_block_size;
+        vgmstream->current_block_samples = entry->current_block_samples;
+        vgmstream->next_block_offset = entry->next_block_offset;
+        vgmstream->full_block_size = entry->full_block_size;
+        vgmstream->codec_config = entry->codec_config;
+        vgmstream->ws_output_size = entry->ws_output_size;
+        vgmstream->frame_geometry_valid = 0;
+        vgmstream->loop_flag = ((VGMSTREAM*)vgmstream->start_vgmstream)->loop_flag; /* may be disabled by loop_target */
+        vgmstream->loop_count = 0;
+    }
+
+    while (vgmstream->current_sample < seek_sample) {
+        int32_t samples_to_do = seek_sample - vgmstream->current_sample;
+        if (samples_to_do > BLOCK_SEEK_BUFFER)
+            samples_to_do = BLOCK_SEEK_BUFFER;
+
+        render_vgmstream_blocked(buffer, samples_to_do, vgmstream);
+    }
+
+    free(buffer);
+    return 1;
+}
+
+static void block_update_layout(off_t block_offset, VGMSTREAM * vgmstream);
+
+/* Parses up to BLOCK_RING_ENTRIES blocks from block_offset on a copy of the stream, with the copy's
+ * channels reading from the ring's own reader. */
+static void fill_block_ring(block_index_t* index, off_t block_offset, VGMSTREAM* vgmstream) {
+    VGMSTREAM scratch;
+    STREAMFILE* sf = vgmstream->ch[0].streamfile;
+    size_t file_size = get_streamfile_size(index->ring_sf);
+    int i, ch;
+
+    memcpy(&scratch, vgmstream, sizeof(VGMSTREAM));
+    index->ring_head = 0;
+    index->ring_count = 0;
+
+    for (i = 0; i < BLOCK_RING_ENTRIES; i++) {
+        block_index_entry_t* entry = &index->ring[i];
+        VGMSTREAMCHANNEL* ring_ch = &index->ring_ch[i * index->channels];
+
+        memcpy(ring_ch, i == 0 ? vgmstream->ch : scratch.ch, index->channels * sizeof(VGMSTREAMCHANNEL));
+        for (ch = 0; ch < index->channels; ch++) {
+            if (ring_ch[ch].streamfile == sf)
+                ring_ch[ch].streamfile = index->ring_sf;
+        }
+        scratch.ch = ring_ch;
+
+        index->ring_offsets[i] = block_offset;
+        index->ring_full_sizes[i] = scratch.full_block_size;
+        block_update(block_offset, &scratch);
+
+        entry->current_block_offset = scratch.current_block_offset;
+        entry->current_block_size = scratch.current_block_size;
+        entry->current_block_samples = scratch.current_block_samples;
+        entry->next_block_offset = scratch.next_block_offset;
+        entry->full_block_size = scratch.full_block_size;
+        entry->codec_config = scratch.codec_config;
+        entry->ws_output_size = scratch.ws_output_size;
+        index->ring_count++;
+
+        /* EOF or bad blocks are left for the layout to handle */
+        if (scratch.current_block_samples < 0 || scratch.next_block_offset <= block_offset ||
+                scratch.next_block_offset >= file_size)
+            break;
+        block_offset = scratch.next_block_offset;
+    }
+}
+
+/* Same as block_update, but from the lookahead ring when the layout supports it. */
+static void block_update_ahead(off_t block_offset, VGMSTREAM* vgmstream) {
+    block_index_t* index = vgmstream->block_index;
+    const block_index_entry_t* entry;
+    const VGMSTREAMCHANNEL* ring_ch;
+    int ch;
+
+    if (!index || !index->ring_sf || !index->ring_ch || index->channels != vgmstream->channels) {
+        block_update(block_offset, vgmstream);
+        return;
+    }
+
+    if (index->ring_head >= index->ring_count ||
+            index->ring_offsets[index->ring_head] != block_offset ||
+            index->ring_full_sizes[index->ring_head] != vgmstream->full_block_size) {
+        fill_block_ring(index, block_offset, vgmstream);
+    }
+
+    entry = &index->ring[index->ring_head];
+    ring_ch = &index->ring_ch[index->ring_head * index->channels];
+    index->ring_head++;
+
+    vgmstream->current_block_offset = entry->current_block_offset;
+    vgmstream->current_block_size = entry->current_block_size;
+    vgmstream->current_block_samples = entry->current_block_samples;
+    vgmstream->next_block_offset = entry->next_block_offset;
+    vgmstream->full_block_size = entry->full_block_size;
+    vgmstream->codec_config = entry->codec_config;
+    vgmstream->ws_output_size = entry->ws_output_size;
+    vgmstream->frame_geometry_valid = 0;
+
+    for (ch = 0; ch < vgmstream->channels; ch++) {
+        VGMSTREAMCHANNEL* stream = &vgmstream->ch[ch];
+
+        stream->offset = ring_ch[ch].offset;
+        if (index->ring_fields & BLOCK_RING_HIST) {
+            stream->adpcm_history1_32 = ring_ch[ch].adpcm_history1_32;
+            stream->adpcm_history2_32 = ring_ch[ch].adpcm_history2_32;
+            stream->adpcm_step_index = ring_ch[ch].adpcm_step_index;
+        }
+        if (index->ring_fields & BLOCK_RING_COEF) {
+            memcpy(stream->adpcm_coef, ring_ch[ch].adpcm_coef, sizeof(stream->adpcm_coef));
+        }
+    }
+}
+
 /* helper functions to parse new block */
 void block_update(off_t block_offset, VGMSTREAM * vgmstream) {
+    vgmstream_profile_t* profile = vgmstream->profile;
+    uint64_t time_start;
+
+    vgmstream->frame_geometry_valid = 0; /* block values may change frame sizes */
+
+    if (!profile) {
+        block_update_layout(block_offset, vgmstream);
+        return;
+    }
+
+    time_start = get_streamfile_time_us();
+    block_update_layout(block_offset, vgmstream);
+    profile->layout_time_us += get_streamfile_time_us() - time_start;
+}
+
+static void block_update_layout(off_t block_offset, VGMSTREAM * vgmstream) {
     switch (vgmstream->layout_type) {
         case layout_blocked_ast:
             block_update_ast(block_offset,vgmstream);
@@ -3,12 +3,17 @@
 
 
 /* Decodes samples for flat streams.
- * Data forms a single stream, and the decoder may internally skip chunks and move offsets as needed. */
-void render_vgmstream_flat(sample_t * buffer, int32_t sample_count, VGMSTREAM * vgmstream) {
+ * Data forms a single stream, and the decoder may internally skip chunks and move offsets as needed.
+ * Writes to buffer, to buffer_f for codecs that decode to float, or to planes for codecs that
+ * decode channels separately (only one is set). */
+static void render_vgmstream_flat_internal(sample_t * buffer, float * buffer_f, sample_t ** planes, int32_t sample_count, VGMSTREAM * vgmstream) {
     int samples_written = 0;
+    int ch;
     int samples_per_frame, samples_this_block;
 
-    samples_per_frame = get_vgmstream_samples_per_frame(vgmstream);
+    if (!vgmstream->frame_geometry_valid)
+        vgmstream_update_frame_geometry(vgmstream);
+    samples_per_frame = vgmstream->frame_samples;
     samples_this_block = vgmstream->num_samples; /* do all samples if possible */
 
 
@@ -27,14 +32,39 @@ void render_vgmstream_flat(sample_t * buffer, int32_t sample_count, VGMSTREAM *
         if (samples_to_do == 0) {
             VGM_LOG("layout_flat: wrong samples_to_do 0 found\n"); /* could happen when calling render at EOF? */
             //VGM_LOG("layout_flat: tb=%i sib=%i, spf=%i\n", samples_this_block, vgmstream->samples_into_block, samples_per_frame);
-            memset(buffer + samples_written*vgmstream->channels, 0, (sample_count - samples_written) * vgmstream->channels * sizeof(sample_t));
+            if (planes) {
+                for (ch = 0; ch < vgmstream->channels; ch++) {
+                    memset(planes[ch] + samples_written, 0, (sample_count - samples_written) * sizeof(sample_t));
+                }
+            }
+            else if (buffer_f)
+                memset(buffer_f + samples_written*vgmstream->channels, 0, (sample_count - samples_written) * vgmstream->channels * sizeof(float));
+            else
+                memset(buffer + samples_written*vgmstream->channels, 0, (sample_count - samples_written) * vgmstream->channels * sizeof(sample_t));
             break;
         }
 
-        decode_vgmstream(vgmstream, samples_written, samples_to_do, buffer);
+        if (planes)
+            decode_vgmstream_planar(vgmstream, samples_written, samples_to_do, planes);
+        else if (buffer_f)
+            decode_vgmstream_float(vgmstream, samples_written, samples_to_do, buffer_f);
+        else
+            decode_vgmstream(vgmstream, samples_written, samples_to_do, buffer);
 
         samples_written += samples_to_do;
         vgmstream->current_sample += samples_to_do;
         vgmstream->samples_into_block += samples_to_do;
     }
 }
+
+void render_vgmstream_flat(sample_t * buffer, int32_t sample_count, VGMSTREAM * vgmstream) {
+    render_vgmstream_flat_internal(buffer, NULL, NULL, sample_count, vgmstream);
+}
+
+void render_vgmstream_flat_float(float * buffer, int32_t sample_count, VGMSTREAM * vgmstream) {
+    render_vgmstream_flat_internal(NULL, buffer, NULL, sample_count, vgmstream);
+}
+
+void render_vgmstream_flat_planar(sample_t ** planes, int32_t sample_count, VGMSTREAM * vgmstream) {
+    render_vgmstream_flat_internal(NULL, NULL, planes, sample_count, vgmstream);
+}
@@ -1,6 +1,8 @@
 #include "layout.h"
 #include "../vgmstream.h"
 
+#define INTERLEAVE_PREFETCH_MIN  STREAMFILE_DEFAULT_BUFFER_SIZE /* blocks that don't share a channel buffer */
+
 
 /* Decodes samples for interleaved streams.
  * Data has interleaved chunks per channel, and once one is decoded the layout moves offsets,
@@ -17,15 +19,17 @@ void render_vgmstream_interleave(sample_t * buffer, int32_t sample_count, VGMSTR
 
 
     /* setup */
+    if (!vgmstream->frame_geometry_valid)
+        vgmstream_update_frame_geometry(vgmstream);
     {
-        int frame_size_d = get_vgmstream_frame_size(vgmstream);
-        samples_per_frame_d = get_vgmstream_samples_per_frame(vgmstream);
+        int frame_size_d = vgmstream->frame_bytes;
+        samples_per_frame_d = vgmstream->frame_samples;
         if (frame_size_d == 0 || samples_per_frame_d == 0) goto fail;
         samples_this_block_d = vgmstream->interleave_block_size / frame_size_d * samples_per_frame_d;
     }
     if (has_interleave_first) {
-        int frame_size_f = get_vgmstream_frame_size(vgmstream);
-        samples_per_frame_f = get_vgmstream_samples_per_frame(vgmstream); //todo samples per shortframe
+        int frame_size_f = vgmstream->frame_bytes;
+        samples_per_frame_f = vgmstream->frame_samples; //todo samples per shortframe
         if (frame_size_f == 0 || samples_per_frame_f == 0) goto fail;
         samples_this_block_f = vgmstream->interleave_first_block_size / frame_size_f * samples_per_frame_f;
     }
@@ -90,6 +94,10 @@ void render_vgmstream_interleave(sample_t * buffer, int32_t sample_count, VGMSTR
             goto fail;
         }
 
+        /* small requests may end mid-frame, but decoders resume from the channel's saved history
+         * (only re-reading the frame header), so no frame is decoded twice. Staging whole frames
+         * here would leave channel state ahead of current_sample, which loop saves and callers'
+         * checkpoints rely on. */
         decode_vgmstream(vgmstream, samples_written, samples_to_do, buffer);
 
         samples_written += samples_to_do;
@@ -139,6 +147,14 @@ void render_vgmstream_interleave(sample_t * buffer, int32_t sample_count, VGMSTR
                 }
             }
 
+            /* with big blocks each channel needs its own refill, so hint all of them at once
+             * (reads get queued together) rather than waiting on each channel's refill in turn */
+            if (vgmstream->channels > 1 && vgmstream->interleave_block_size >= INTERLEAVE_PREFETCH_MIN) {
+                for (ch = 0; ch < vgmstream->channels; ch++) {
+                    prefetch_streamfile(vgmstream->ch[ch].streamfile, vgmstream->ch[ch].offset, vgmstream->interleave_block_size);
+                }
+            }
+
             vgmstream->samples_into_block = 0;
         }
     }
@@ -1,12 +1,117 @@
 #include "layout.h"
 #include "../vgmstream.h"
 #include "../mixing.h"
+#include "../pool.h"
 
 
 /* NOTE: if loop settings change the layered vgmstreams must be notified (preferably using vgmstream_force_loop) */
 #define VGMSTREAM_MAX_LAYERS 255
 #define VGMSTREAM_LAYER_SAMPLE_BUFFER 8192
 
+/* layer_flags */
+#define LAYER_FLAG_UNUSED   0x01 /* output channels removed or muted by mixing, so it isn't rendered */
+#define LAYER_FLAG_DIRTY    0x02 /* rendered since the last reset */
+
+
+typedef struct {
+    layered_layout_data *data;
+    int samples_to_do;
+} layer_job_t;
+
+/* Returns the buffer of a layer when rendering in parallel (layers may have different input channels). */
+static sample_t* get_layer_buffer(layered_layout_data *data, int layer) {
+    int i, layer_input_channels;
+    size_t offset = 0;
+
+    for (i = 0; i < layer; i++) {
+        mixing_info(data->layers[i], &layer_input_channels, NULL);
+        offset += VGMSTREAM_LAYER_SAMPLE_BUFFER * layer_input_channels;
+    }
+    return data->layer_buffers + offset;
+}
+
+static void render_layer_job(void *job_data, int layer) {
+    layer_job_t *job = job_data;
+
+    if (job->data->layer_flags[layer] & LAYER_FLAG_UNUSED)
+        return;
+    job->data->layer_flags[layer] |= LAYER_FLAG_DIRTY;
+    render_vgmstream(get_layer_buffer(job->data, layer), job->samples_to_do, job->data->layers[layer]);
+}
+
+/* Layers can be rendered from different threads if they don't share streamfiles, as decoders
+ * only touch their own VGMSTREAM. Layers without channel streamfiles (codecs/layouts with
+ * internal data) aren't checked and are kept serial. Allocates per-layer buffers once. */
+static int setup_parallel_layers(layered_layout_data *data) {
+    int i, j, layer, other, layer_input_channels;
+    size_t buffer_samples = 0;
+
+    if (data->parallel_layers)
+        return data->parallel_layers > 0;
+    data->parallel_layers = -1;
+
+    for (layer = 0; layer < data->layer_count; layer++) {
+        VGMSTREAM *vgmstream = data->layers[layer];
+
+        for (i = 0; i < vgmstream->channels; i++) {
+            if (!vgmstream->ch[i].streamfile)
+                return 0;
+
+            for (other = 0; other < layer; other++) {
+                for (j = 0; j < data->layers[other]->channels; j++) {
+                    if (vgmstream->ch[i].streamfile == data->layers[other]->ch[j].streamfile)
+                        return 0;
+                }
+            }
+        }
+
+        mixing_info(vgmstream, &layer_input_channels, NULL);
+        buffer_samples += VGMSTREAM_LAYER_SAMPLE_BUFFER * layer_input_channels;
+    }
+
+    data->layer_buffers = pool_arena_realloc(data->arena, data->layer_buffers, buffer_samples * sizeof(sample_t));
+    if (!data->layer_buffers)
+        return 0;
+
+    data->parallel_layers = 1;
+    return 1;
+}
+
+/* Mixing may remove or mute whole layers (ex. TXTP selecting some channels), that are then
+ * skipped. Mixes can't change once active and hosts enable them before rendering, so this
+ * is only done once. At least one layer is kept, as it reports the current position. */
+static void setup_used_layers(VGMSTREAM *vgmstream, layered_layout_data *data) {
+    uint64_t used_channels = mixing_get_used_channels(vgmstream);
+    int layer, ch = 0;
+
+    data->used_layers = 0;
+    data->first_used_layer = -1;
+    for (layer = 0; layer < data->layer_count; layer++) {
+        int layer_ch, layer_channels, is_used = 0;
+
+        mixing_info(data->layers[layer], NULL, &layer_channels);
+        for (layer_ch = 0; layer_ch < layer_channels; layer_ch++) {
+            if (ch + layer_ch >= 64 || ch + layer_ch >= vgmstream->channels || (used_channels >> (ch + layer_ch)) & 1)
+                is_used = 1;
+        }
+        ch += layer_channels;
+
+        if (!is_used) {
+            data->layer_flags[layer] |= LAYER_FLAG_UNUSED;
+            continue;
+        }
+
+        if (data->first_used_layer < 0)
+            data->first_used_layer = layer;
+        data->used_layers++;
+    }
+
+    if (data->used_layers == 0) {
+        data->layer_flags[0] &= ~LAYER_FLAG_UNUSED;
+        data->first_used_layer = 0;
+        data->used_layers = 1;
+    }
+}
 
 /* Decodes samples for layered streams.
  * Similar to interleave layout, but decodec samples are mixed from complete vgmstreams, each
@@ -17,42 +122,97 @@ void render_vgmstream_layered(sample_t * outbuf, int32_t sample_count, VGMSTREAM
     layered_layout_data *data = vgmstream->layout_data;
 
 
+    if (!data->used_layers)
+        setup_used_layers(vgmstream, data);
+
     while (samples_written < sample_count) {
         int samples_to_do = VGMSTREAM_LAYER_SAMPLE_BUFFER;
         int layer, ch = 0;
+        int is_parallel = 0;
 
         if (samples_to_do > sample_count - samples_written)
             samples_to_do = sample_count - samples_written;
 
+        /* render all layers at once in their own buffers if the host set up a runner */
+        if (data->used_layers > 1 && data->parallel_layers >= 0 &&
+                vgmstream_can_run_parallel(data->output_channels, samples_to_do)) {
+            layer_job_t job;
+            job.data = data;
+            job.samples_to_do = samples_to_do;
+
+            if (setup_parallel_layers(data))
+                is_parallel = vgmstream_run_parallel(data->output_channels, samples_to_do, render_layer_job, &job, data->layer_count);
+        }
+
         for (layer = 0; layer < data->layer_count; layer++) {
             int s, layer_ch, layer_channels;
+            sample_t *layer_buffer = is_parallel ? get_layer_buffer(data, layer) : data->buffer;
+            const sample_t *src;
+            sample_t *dst;
 
             /* each layer will handle its own looping/mixing internally */
 
             /* layers may have its own number of channels */
             mixing_info(data->layers[layer], NULL, &layer_channels);
 
-            render_vgmstream(
-                    data->buffer,
-                    samples_to_do,
-                    data->layers[layer]);
-
-            /* mix layer samples to main samples */
-            for (layer_ch = 0; layer_ch < layer_channels; layer_ch++) {
+            /* unused layers are silent (their channels are dropped later anyway) */
+            if (data->layer_flags[layer] & LAYER_FLAG_UNUSED) {
+                dst = outbuf + samples_written*data->output_channels + ch;
                 for (s = 0; s < samples_to_do; s++) {
-                    size_t layer_sample = s*layer_channels + layer_ch;
-                    size_t buffer_sample = (samples_written+s)*data->output_channels + ch;
-
-                    outbuf[buffer_sample] = data->buffer[layer_sample];
+                    for (layer_ch = 0; layer_ch < layer_channels; layer_ch++) {
+                        dst[layer_ch] = 0;
+                    }
+                    dst += data->output_channels;
                 }
-                ch++;
+                ch += layer_channels;
+                continue;
             }
+
+            if (!is_parallel) {
+                data->layer_flags[layer] |= LAYER_FLAG_DIRTY;
+                render_vgmstream(
+                        layer_buffer,
+                        samples_to_do,
+                        data->layers[layer]);
+            }
+
+            /* mix layer samples to main samples (sample by sample, as both are interleaved;
+             * most layers are mono or stereo so those get simpler loops) */
+            src = layer_buffer;
+            dst = outbuf + samples_written*data->output_channels + ch;
+            switch (layer_channels) {
+                case 1:
+                    for (s = 0; s < samples_to_do; s++) {
+                        dst[0] = src[0];
+                        src += 1;
+                        dst += data->output_channels;
+                    }
+                    break;
+                case 2:
+                    for (s = 0; s < samples_to_do; s++) {
+                        dst[0] = src[0];
+                        dst[1] = src[1];
+                        src += 2;
+                        dst += data->output_channels;
+                    }
+                    break;
+                default:
+                    for (s = 0; s < samples_to_do; s++) {
+                        for (layer_ch = 0; layer_ch < layer_channels; layer_ch++) {
+                            dst[layer_ch] = src[layer_ch];
+                        }
+                        src += layer_channels;
+                        dst += data->output_channels;
+                    }
+                    break;
+            }
+            ch += layer_channels;
         }
 
         samples_written += samples_to_do;
         /* needed for info (ex. for mixing) */
-        vgmstream->current_sample = data->layers[0]->current_sample;
-        vgmstream->loop_count = data->layers[0]->loop_count;
+        vgmstream->current_sample = data->layers[data->first_used_layer]->current_sample;
+        vgmstream->loop_count = data->layers[data->first_used_layer]->loop_count;
         //vgmstream->samples_into_block = 0; /* handled in each layer */
     }
 }
@@ -60,21 +220,30 @@ void render_vgmstream_layered(sample_t * outbuf, int32_t sample_count, VGMSTREAM
 
 layered_layout_data* init_layout_layered(int layer_count) {
     layered_layout_data *data = NULL;
+    pool_arena* arena;
 
     if (layer_count <= 0 || layer_count > VGMSTREAM_MAX_LAYERS)
-        goto fail;
+        return NULL;
 
-    data = calloc(1, sizeof(layered_layout_data));
+    /* the struct and layer arrays in one chunk (buffers are added on setup) */
+    arena = pool_arena_new(sizeof(layered_layout_data) + layer_count * (sizeof(VGMSTREAM*) + sizeof(uint8_t)) + 0x100);
+    if (!arena) return NULL;
+
+    data = pool_arena_calloc(arena, 1, sizeof(layered_layout_data));
     if (!data) goto fail;
+    data->arena = arena;
 
     data->layer_count = layer_count;
 
-    data->layers = calloc(layer_count, sizeof(VGMSTREAM*));
+    data->layers = pool_arena_calloc(arena, layer_count, sizeof(VGMSTREAM*));
     if (!data->layers) goto fail;
 
+    data->layer_flags = pool_arena_calloc(arena, layer_count, sizeof(uint8_t));
+    if (!data->layer_flags) goto fail;
+
     return data;
 fail:
-    free_layout_layered(data);
+    pool_arena_free(arena);
     return NULL;
 }
 
@@ -128,7 +297,7 @@ int setup_layout_layered(layered_layout_data* data) {
         goto fail;
 
     /* create internal buffer big enough for mixing */
-    outbuf_re = realloc(data->buffer, VGMSTREAM_LAYER_SAMPLE_BUFFER*max_input_channels*sizeof(sample_t));
+    outbuf_re = pool_arena_realloc(data->arena, data->buffer, VGMSTREAM_LAYER_SAMPLE_BUFFER*max_input_channels*sizeof(sample_t));
     if (!outbuf_re) goto fail;
     data->buffer = outbuf_re;
 
@@ -150,10 +319,8 @@ void free_layout_layered(layered_layout_data *data) {
         for (i = 0; i < data->layer_count; i++) {
             close_vgmstream(data->layers[i]);
         }
-        free(data->layers);
     }
-    free(data->buffer);
-    free(data);
+    pool_arena_free(data->arena); /* data itself, layer arrays and buffers */
 }
 
 void reset_layout_layered(layered_layout_data *data) {
@@ -162,8 +329,24 @@ void reset_layout_layered(layered_layout_data *data) {
     if (!data)
         return;
 
+    /* layers not rendered since the last reset (like unused ones) are still at the start */
     for (i = 0; i < data->layer_count; i++) {
+        if (!(data->layer_flags[i] & LAYER_FLAG_DIRTY))
+            continue;
         reset_vgmstream(data->layers[i]);
+        data->layer_flags[i] &= ~LAYER_FLAG_DIRTY;
+    }
+}
+
+/* marks layers as changed when their state is set outside rendering (snapshots), so resets don't skip them */
+void touch_layout_layered(layered_layout_data *data) {
+    int i;
+
+    if (!data)
+        return;
+
+    for (i = 0; i < data->layer_count; i++) {
+        data->layer_flags[i] |= LAYER_FLAG_DIRTY;
     }
 }
 
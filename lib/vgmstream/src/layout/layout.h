@@ -7,6 +7,9 @@
 /* blocked layouts */
 void render_vgmstream_blocked(sample_t * buffer, int32_t sample_count, VGMSTREAM * vgmstream);
 void block_update(off_t block_offset, VGMSTREAM * vgmstream);
+int seek_layout_blocked(VGMSTREAM * vgmstream, int32_t seek_sample);
+void free_layout_blocked_index(void * block_index);
+void prepare_layout_blocked(VGMSTREAM * vgmstream);
 
 void block_update_ast(off_t block_ofset, VGMSTREAM * vgmstream);
 void block_update_mxch(off_t block_ofset, VGMSTREAM * vgmstream);
@@ -53,12 +56,16 @@ void block_update_ubi_sce(off_t block_offset, VGMSTREAM* vgmstream);
 void render_vgmstream_interleave(sample_t * buffer, int32_t sample_count, VGMSTREAM * vgmstream);
 
 void render_vgmstream_flat(sample_t * buffer, int32_t sample_count, VGMSTREAM * vgmstream);
+void render_vgmstream_flat_float(float * buffer, int32_t sample_count, VGMSTREAM * vgmstream);
+void render_vgmstream_flat_planar(sample_t ** planes, int32_t sample_count, VGMSTREAM * vgmstream);
 
 void render_vgmstream_segmented(sample_t * buffer, int32_t sample_count, VGMSTREAM * vgmstream);
 segmented_layout_data* init_layout_segmented(int segment_count);
 int setup_layout_segmented(segmented_layout_data* data);
 void free_layout_segmented(segmented_layout_data *data);
 void reset_layout_segmented(segmented_layout_data *data);
+int seek_layout_segmented(VGMSTREAM* vgmstream, int32_t seek_sample);
+VGMSTREAM* get_layout_segmented_loop(VGMSTREAM* vgmstream);
 VGMSTREAM *allocate_segmented_vgmstream(segmented_layout_data* data, int loop_flag, int loop_start_segment, int loop_end_segment);
 
 void render_vgmstream_layered(sample_t * buffer, int32_t sample_count, VGMSTREAM * vgmstream);
@@ -66,6 +73,7 @@ layered_layout_data* init_layout_layered(int layer_count);
 int setup_layout_layered(layered_layout_data* data);
 void free_layout_layered(layered_layout_data *data);
 void reset_layout_layered(layered_layout_data *data);
+void touch_layout_layered(layered_layout_data *data);
 VGMSTREAM *allocate_layered_vgmstream(layered_layout_data* data);
 
 #endif
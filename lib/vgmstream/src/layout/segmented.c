@@ -1,58 +1,283 @@
 #include "layout.h"
 #include "../vgmstream.h"
 #include "../mixing.h"
+#include "../pool.h"
+#include "../membudget.h"
 
-#define VGMSTREAM_MAX_SEGMENTS 1024
+#define VGMSTREAM_MAX_SEGMENTS 8192 /* big playlists should use bounded mode */
 #define VGMSTREAM_SEGMENT_SAMPLE_BUFFER 8192
+#define VGMSTREAM_SEGMENT_PREOPEN_SAMPLES (VGMSTREAM_SEGMENT_SAMPLE_BUFFER * 2) /* before the next segment */
 
 
+/* Returns the segment that contains sample (binary search over segment starts), or -1 if out of range. */
+static int find_segment(segmented_layout_data* data, int32_t sample, int32_t num_samples) {
+    int low = 0, high = data->segment_count - 1;
+
+    if (sample < 0 || sample >= num_samples || sample >= data->segment_starts[data->segment_count])
+        return -1;
+
+    while (low < high) {
+        int mid = (low + high + 1) / 2;
+        if (data->segment_starts[mid] <= sample)
+            low = mid;
+        else
+            high = mid - 1;
+    }
+
+    return low;
+}
+
+/* Final setup of segments once opened (roughly equivalent to vgmstream.c's init_vgmstream_internal stuff) */
+static void setup_segment(VGMSTREAM* segment) {
+    /* disable so that looping is controlled by render_vgmstream_segmented */
+    segment->loop_flag = 0;
+
+    setup_vgmstream(segment); /* final setup in case the VGMSTREAM was created manually */
+
+    mixing_setup(segment, VGMSTREAM_SEGMENT_SAMPLE_BUFFER); /* init mixing */
+}
+
+static VGMSTREAM* reopen_segment(segmented_layout_data* data, int segment) {
+    VGMSTREAM* reopened;
+
+    reopened = data->open_segment(data->open_data, segment);
+    if (!reopened) {
+        VGM_LOG("segmented: can't reopen segment %i\n", segment);
+        return NULL;
+    }
+
+    /* the file may have changed since it was first opened, and positions depend on it */
+    if (reopened->num_samples != data->segment_starts[segment + 1] - data->segment_starts[segment]) {
+        VGM_LOG("segmented: reopened segment %i has different samples\n", segment);
+        close_vgmstream(reopened);
+        return NULL;
+    }
+
+    setup_segment(reopened);
+    /* the first segment is never closed, so it tells if segments are profiled */
+    if (data->segments[0] && data->segments[0]->profile)
+        vgmstream_set_profiling(reopened, 1);
+    data->segments[segment] = reopened;
+    return reopened;
+}
+
+/* Returns a segment, reopening it in bounded mode if it was closed (NULL if that fails). */
+static VGMSTREAM* get_segment(segmented_layout_data* data, int segment) {
+    VGMSTREAM* reopened;
+
+    if (data->segments[segment] || !data->open_segment)
+        return data->segments[segment];
+
+    /* bounded mode trades opening again for memory, so it's allowed to allocate while rendering */
+    VGM_ALLOC_CHECK_PAUSE();
+    reopened = reopen_segment(data, segment);
+    VGM_ALLOC_CHECK_RESUME();
+    return reopened;
+}
+
+/* Resets a segment to decode it from the start (closed segments reopen at the start already).
+ * Segments not rendered since their last reset are still there, so it's skipped for them (checked
+ * on the VGMSTREAM as segments may repeat the same one, and they always render forward from 0). */
+static void reset_segment(segmented_layout_data* data, int segment) {
+    VGMSTREAM* vgmstream = data->segments[segment];
+
+    if (!vgmstream)
+        return;
+    if (vgmstream->current_sample == 0 && vgmstream->samples_into_block == 0)
+        return;
+    reset_vgmstream(vgmstream);
+}
+
+/* Renders from a segment, or silence if it can't be (re)opened. */
+static void render_segment(segmented_layout_data* data, int segment, sample_t* buffer, int32_t samples_to_do) {
+    VGMSTREAM* vgmstream = get_segment(data, segment);
+
+    if (!vgmstream) {
+        memset(buffer, 0, samples_to_do * data->output_channels * sizeof(sample_t));
+        return;
+    }
+
+    render_vgmstream(buffer, samples_to_do, vgmstream);
+}
+
+/* Keeps stage times of a segment about to be closed in the segmented stream's own counters */
+static void keep_segment_profile(VGMSTREAM* vgmstream, VGMSTREAM* segment) {
+    vgmstream_profile_t* profile = vgmstream->profile;
+    vgmstream_profile_t closed;
+
+    if (!profile)
+        return;
+
+    vgmstream_get_profile(segment, &closed);
+    profile->decode_calls += closed.decode_calls;
+    profile->decode_time_us += closed.decode_time_us;
+    profile->layout_time_us += closed.layout_time_us;
+    profile->mix_time_us += closed.mix_time_us;
+    profile->output_time_us += closed.output_time_us;
+}
+
+/* If other entries point to the same VGMSTREAM (repeated segments) */
+static int is_shared_segment(segmented_layout_data* data, int segment) {
+    int i;
+
+    for (i = 0; i < data->segment_count; i++) {
+        if (i != segment && data->segments[i] == data->segments[segment])
+            return 1;
+    }
+    return 0;
+}
+
+/* When segments can be reopened closes those that won't play soon, other than the first (info),
+ * current and next ones. Normally those already played that looping can't reach again (before the
+ * loop segment, or all without loop), so long intros don't stay open (seeking back reopens them).
+ * In bounded mode all others but the loop start one (reopened when looping instead under a low
+ * memory budget), as huge playlists would use too much memory. Called on segment changes and seeks. */
+static void close_far_segments(VGMSTREAM* vgmstream, segmented_layout_data* data) {
+    int i, loop_segment = -1;
+
+    if (!data->open_segment)
+        return;
+
+    if (vgmstream->loop_flag && (!data->bounded || !membudget_is_low()))
+        loop_segment = find_segment(data, vgmstream->loop_start_sample, vgmstream->num_samples);
+
+    for (i = 1; i < data->segment_count; i++) {
+        if (!data->segments[i])
+            continue;
+        if (i == data->current_segment || i == data->current_segment + 1 || i == loop_segment)
+            continue;
+        if (!data->bounded) {
+            if (i > data->current_segment || (loop_segment >= 0 && i > loop_segment))
+                continue;
+            if (is_shared_segment(data, i))
+                continue;
+        }
+
+        keep_segment_profile(vgmstream, data->segments[i]);
+        close_vgmstream(data->segments[i]);
+        data->segments[i] = NULL;
+    }
+}
+
+/* Gives back streamfile buffers of open segments that won't play next (current and next ones
+ * keep theirs, as may other entries that point to the same VGMSTREAM). */
+static void release_idle_segments(segmented_layout_data* data) {
+    VGMSTREAM* current = data->segments[data->current_segment];
+    VGMSTREAM* next = data->current_segment + 1 < data->segment_count ? data->segments[data->current_segment + 1] : NULL;
+    int i;
+
+    for (i = 0; i < data->segment_count; i++) {
+        if (!data->segments[i] || data->segments[i] == current || data->segments[i] == next)
+            continue;
+        release_vgmstream_buffers(data->segments[i]);
+    }
+}
+
+/* Moves to current_segment from the start (layout time if profiled) */
+static void change_segment(VGMSTREAM* vgmstream, segmented_layout_data* data) {
+    vgmstream_profile_t* profile = vgmstream->profile;
+    uint64_t time_start = profile ? get_streamfile_time_us() : 0;
+
+    reset_segment(data, data->current_segment);
+    close_far_segments(vgmstream, data);
+    release_idle_segments(data);
+
+    if (profile)
+        profile->layout_time_us += get_streamfile_time_us() - time_start;
+}
+
+typedef struct {
+    VGMSTREAM* segment;
+    VGMSTREAM* next;
+    sample_t* buffer;
+    int32_t samples_to_do;
+} preopen_job_t;
+
+static void preopen_job(void* job_data, int index) {
+    preopen_job_t* job = job_data;
+
+    if (index == 0) {
+        render_vgmstream(job->buffer, job->samples_to_do, job->segment);
+    }
+    else {
+        /* usually already prepared with the whole stream, unless reopened in bounded mode */
+        VGM_ALLOC_CHECK_PAUSE();
+        prepare_vgmstream(job->next);
+        VGM_ALLOC_CHECK_RESUME();
+    }
+}
+
+/* Near the end of a segment, reopens the next segment if closed (bounded mode) and runs its
+ * deferred setup (HCA key search and such) alongside the current render through the host runner,
+ * so it doesn't stall the boundary. Returns 0 if not done (caller must render normally). */
+static int render_with_preopen(segmented_layout_data* data, sample_t* buffer, int32_t samples_to_do, int32_t samples_left) {
+    preopen_job_t job;
+    VGMSTREAM* segment = data->segments[data->current_segment];
+    VGMSTREAM* next;
+
+    if (samples_left > VGMSTREAM_SEGMENT_PREOPEN_SAMPLES || data->current_segment + 1 >= data->segment_count)
+        return 0;
+
+    next = get_segment(data, data->current_segment + 1);
+    if (!segment || !next || !next->codec_setup || next == segment)
+        return 0;
+
+    job.segment = segment;
+    job.next = next;
+    job.buffer = buffer;
+    job.samples_to_do = samples_to_do;
+    return vgmstream_run_jobs(preopen_job, &job, 2);
+}
+
+/* Segments render their input channels and mix down in place, so those that downmix need room for
+ * more channels than outbuf has for them (others render there directly, as do downmixing ones when
+ * what's left of outbuf is enough). */
+static int needs_internal_buffer(segmented_layout_data* data, int32_t samples_to_do, int32_t samples_left) {
+    VGMSTREAM* segment;
+    int input_channels = data->output_channels;
+
+    if (data->input_channels == data->output_channels)
+        return 0;
+
+    segment = get_segment(data, data->current_segment);
+    if (segment) {
+        input_channels = segment->channels;
+        mixing_info(segment, &input_channels, NULL);
+    }
+    if (input_channels <= data->output_channels)
+        return 0;
+    return (int64_t)samples_to_do * input_channels > (int64_t)samples_left * data->output_channels;
+}
+
 /* Decodes samples for segmented streams.
  * Chains together sequential vgmstreams, for data divided into separate sections or files
  * (like one part for intro and other for loop segments, which may even use different codecs). */
 void render_vgmstream_segmented(sample_t * outbuf, int32_t sample_count, VGMSTREAM * vgmstream) {
     int samples_written = 0, loop_samples_skip = 0;
     segmented_layout_data *data = vgmstream->layout_data;
-    int use_internal_buffer = 0;
-
-
-    /* normally uses outbuf directly (faster) but could need internal buffer if downmixing */
-    if (vgmstream->channels != data->input_channels) {
-        use_internal_buffer = 1;
-    }
 
 
     while (samples_written < sample_count) {
+        int use_internal_buffer;
         int samples_to_do;
-        int samples_this_segment = data->segments[data->current_segment]->num_samples;
+        int samples_this_segment = data->segment_starts[data->current_segment + 1] - data->segment_starts[data->current_segment];
 
         if (vgmstream->loop_flag && vgmstream_do_loop(vgmstream)) {
-            int segment, loop_segment, total_samples;
+            int loop_segment;
 
             /* handle looping by finding loop segment and loop_start inside that segment */
-            loop_segment = 0;
-            total_samples = 0;
-            while (total_samples < vgmstream->num_samples) {
-                int32_t segment_samples = data->segments[loop_segment]->num_samples;
-
-                if (vgmstream->loop_sample >= total_samples && vgmstream->loop_sample < total_samples + segment_samples) {
-                    loop_samples_skip = vgmstream->loop_sample - total_samples;
-                    break; /* loop_start falls within loop_segment's samples */
-                }
-                total_samples += segment_samples;
-                loop_segment++;
-            }
-
-            if (loop_segment == data->segment_count) {
+            loop_segment = find_segment(data, vgmstream->loop_sample, vgmstream->num_samples);
+            if (loop_segment < 0) {
                 VGM_LOG("segmented_layout: can't find loop segment\n");
                 loop_segment = 0;
             }
+            else {
+                loop_samples_skip = vgmstream->loop_sample - data->segment_starts[loop_segment];
+            }
 
+            /* loops can span multiple segments, but next ones are reset on segment change */
             data->current_segment = loop_segment;
-
-            /* loops can span multiple segments */
-            for (segment = loop_segment; segment < data->segment_count; segment++) {
-                reset_vgmstream(data->segments[segment]);
-            }
+            change_segment(vgmstream, data);
 
             vgmstream->samples_into_block = 0;
             continue;
@@ -73,17 +298,21 @@ void render_vgmstream_segmented(sample_t * outbuf, int32_t sample_count, VGMSTRE
         /* detect segment change and restart */
         if (samples_to_do == 0) {
             data->current_segment++;
-            reset_vgmstream(data->segments[data->current_segment]);
+            change_segment(vgmstream, data);
             vgmstream->samples_into_block = 0;
             continue;
         }
 
-        render_vgmstream(
-                use_internal_buffer ?
-                        data->buffer :
-                        &outbuf[samples_written * data->output_channels],
-                samples_to_do,
-                data->segments[data->current_segment]);
+        use_internal_buffer = needs_internal_buffer(data, samples_to_do, sample_count - samples_written);
+        {
+            sample_t* buffer = use_internal_buffer ?
+                    data->buffer :
+                    &outbuf[samples_written * data->output_channels];
+            int32_t samples_left = samples_this_segment - vgmstream->samples_into_block;
+
+            if (!render_with_preopen(data, buffer, samples_to_do, samples_left))
+                render_segment(data, data->current_segment, buffer, samples_to_do);
+        }
 
         if (loop_samples_skip > 0) {
             loop_samples_skip -= samples_to_do;
@@ -92,10 +321,7 @@ void render_vgmstream_segmented(sample_t * outbuf, int32_t sample_count, VGMSTRE
         }
 
         if (use_internal_buffer) {
-            int s;
-            for (s = 0; s < samples_to_do * data->output_channels; s++) {
-                outbuf[samples_written * data->output_channels + s] = data->buffer[s];
-            }
+            memcpy(&outbuf[samples_written * data->output_channels], data->buffer, samples_to_do * data->output_channels * sizeof(sample_t));
         }
 
         samples_written += samples_to_do;
@@ -107,34 +333,52 @@ void render_vgmstream_segmented(sample_t * outbuf, int32_t sample_count, VGMSTRE
 
 segmented_layout_data* init_layout_segmented(int segment_count) {
     segmented_layout_data *data = NULL;
+    pool_arena* arena;
 
     if (segment_count <= 0 || segment_count > VGMSTREAM_MAX_SEGMENTS)
-        goto fail;
+        return NULL;
+
+    /* the struct, segments and starts in one chunk (the buffer is added on setup) */
+    arena = pool_arena_new(sizeof(segmented_layout_data) + segment_count * (sizeof(VGMSTREAM*) + sizeof(int32_t)) + 0x100);
+    if (!arena) return NULL;
 
-    data = calloc(1, sizeof(segmented_layout_data));
+    data = pool_arena_calloc(arena, 1, sizeof(segmented_layout_data));
     if (!data) goto fail;
+    data->arena = arena;
 
     data->segment_count = segment_count;
     data->current_segment = 0;
 
-    data->segments = calloc(segment_count, sizeof(VGMSTREAM*));
+    data->segments = pool_arena_calloc(arena, segment_count, sizeof(VGMSTREAM*));
     if (!data->segments) goto fail;
 
     return data;
 fail:
-    free_layout_segmented(data);
+    pool_arena_free(arena);
     return NULL;
 }
 
 int setup_layout_segmented(segmented_layout_data* data) {
-    int i, max_input_channels = 0, max_output_channels = 0;
+    int i, max_input_channels = 0, max_output_channels = 0, prev_output_channels = 0;
     sample_t *outbuf_re = NULL;
+    int32_t *starts_re = NULL;
+    int64_t bitrate_sum = 0;
 
 
-    /* setup each VGMSTREAM (roughly equivalent to vgmstream.c's init_vgmstream_internal stuff) */
+    /* precompute segment starts so loops and seeks can find their segment directly */
+    starts_re = pool_arena_realloc(data->arena, data->segment_starts, (data->segment_count + 1) * sizeof(int32_t));
+    if (!starts_re) goto fail;
+    data->segment_starts = starts_re;
+    data->segment_starts[0] = 0;
+
+    /* setup each VGMSTREAM (bounded mode opens them one by one, so only a few stay open) */
     for (i = 0; i < data->segment_count; i++) {
         int segment_input_channels, segment_output_channels;
 
+        if (data->segments[i] == NULL && data->open_segment) {
+            data->segments[i] = data->open_segment(data->open_data, i);
+        }
+
         if (data->segments[i] == NULL) {
             VGM_LOG("segmented: no vgmstream in segment %i\n", i);
             goto fail;
@@ -147,10 +391,8 @@ int setup_layout_segmented(segmented_layout_data* data) {
         }
 
 
-        /* disable so that looping is controlled by render_vgmstream_segmented */
         if (data->segments[i]->loop_flag != 0) {
             VGM_LOG("segmented: segment %i is looped\n", i);
-            data->segments[i]->loop_flag = 0;
         }
 
         /* different segments may have different input channels, though output should be
@@ -162,16 +404,13 @@ int setup_layout_segmented(segmented_layout_data* data) {
             max_output_channels = segment_output_channels;
 
         if (i > 0) {
-            int prev_output_channels;
-
-            mixing_info(data->segments[i-1], NULL, &prev_output_channels);
             if (segment_output_channels != prev_output_channels) {
                 VGM_LOG("segmented: segment %i has wrong channels %i vs prev channels %i\n", i, segment_output_channels, prev_output_channels);
                 goto fail;
             }
 
             /* a bit weird, but no matter */
-            if (data->segments[i]->sample_rate != data->segments[i-1]->sample_rate) {
+            if (data->segments[i]->sample_rate != data->segments[0]->sample_rate) {
                 VGM_LOG("segmented: segment %i has different sample rate\n", i);
             }
 
@@ -179,18 +418,36 @@ int setup_layout_segmented(segmented_layout_data* data) {
             //if (data->segments[i]->coding_type != data->segments[i-1]->coding_type)
             //    goto fail;
         }
+        prev_output_channels = segment_output_channels;
+
+        /* inherit first segment's layout but only if all segments' layout match */
+        if (i == 0)
+            data->channel_layout = data->segments[i]->channel_layout;
+        else if (data->channel_layout != data->segments[i]->channel_layout)
+            data->channel_layout = 0;
 
+        data->segment_starts[i + 1] = data->segment_starts[i] + data->segments[i]->num_samples;
 
-        setup_vgmstream(data->segments[i]); /* final setup in case the VGMSTREAM was created manually */
+        /* first segment is kept for info (bitrate needs all files, so it's done while open) */
+        if (data->open_segment) {
+            bitrate_sum += get_vgmstream_average_bitrate(data->segments[i]);
+            data->average_bitrate = (int)(bitrate_sum / (i + 1));
+
+            if (i > 0 && data->bounded) {
+                close_vgmstream(data->segments[i]);
+                data->segments[i] = NULL;
+                continue;
+            }
+        }
 
-        mixing_setup(data->segments[i], VGMSTREAM_SEGMENT_SAMPLE_BUFFER); /* init mixing */
+        setup_segment(data->segments[i]);
     }
 
     if (max_output_channels > VGMSTREAM_MAX_CHANNELS || max_input_channels > VGMSTREAM_MAX_CHANNELS)
         goto fail;
 
     /* create internal buffer big enough for mixing */
-    outbuf_re = realloc(data->buffer, VGMSTREAM_SEGMENT_SAMPLE_BUFFER*max_input_channels*sizeof(sample_t));
+    outbuf_re = pool_arena_realloc(data->arena, data->buffer, VGMSTREAM_SEGMENT_SAMPLE_BUFFER*max_input_channels*sizeof(sample_t));
     if (!outbuf_re) goto fail;
     data->buffer = outbuf_re;
 
@@ -222,48 +479,104 @@ void free_layout_segmented(segmented_layout_data *data) {
 
             close_vgmstream(data->segments[i]);
         }
-        free(data->segments);
     }
-    free(data->buffer);
-    free(data);
+    if (data->free_open_data)
+        data->free_open_data(data->open_data);
+    pool_arena_free(data->arena); /* data itself, segments, starts and buffer */
 }
 
 void reset_layout_segmented(segmented_layout_data *data) {
-    int i;
-
     if (!data)
         return;
 
+    /* others are reset once reached (segment changes, loops and seeks), to avoid resetting
+     * every segment of long playlists on each reset */
     data->current_segment = 0;
-    for (i = 0; i < data->segment_count; i++) {
-        reset_vgmstream(data->segments[i]);
+    reset_segment(data, 0);
+}
+
+int seek_layout_segmented(VGMSTREAM* vgmstream, int32_t seek_sample) {
+    segmented_layout_data *data = vgmstream->layout_data;
+    int segment;
+
+    if (!data || !data->segment_starts)
+        return 0;
+
+    /* positions past loop end are later loops (loop_flag may be disabled by now after a loop target) */
+    if (((VGMSTREAM*)vgmstream->start_vgmstream)->loop_flag && seek_sample > vgmstream->loop_end_sample)
+        return 0;
+
+    segment = find_segment(data, seek_sample, vgmstream->num_samples);
+    if (segment < 0)
+        return 0;
+
+    /* restart the target segment only, unless already before seek_sample in the same one */
+    if (vgmstream->loop_count > 0 || segment != data->current_segment || seek_sample < vgmstream->current_sample) {
+        memcpy(vgmstream, vgmstream->start_vgmstream, sizeof(VGMSTREAM));
+        memcpy(vgmstream->ch, vgmstream->start_ch, sizeof(VGMSTREAMCHANNEL)*vgmstream->channels);
+
+        data->current_segment = segment;
+        reset_segment(data, segment);
+        close_far_segments(vgmstream, data);
+
+        vgmstream->current_sample = data->segment_starts[segment];
+        vgmstream->samples_into_block = 0;
+    }
+
+    /* loop start is saved by vgmstream_do_loop when reached, but here it may be skipped over */
+    if (vgmstream->loop_flag && !vgmstream->hit_loop && seek_sample > vgmstream->loop_start_sample) {
+        memcpy(vgmstream->loop_ch, vgmstream->ch, sizeof(VGMSTREAMCHANNEL)*vgmstream->channels);
+        vgmstream->loop_sample = vgmstream->loop_start_sample;
+        vgmstream->loop_samples_into_block = 0;
+        vgmstream->loop_block_size = vgmstream->current_block_size;
+        vgmstream->loop_block_samples = vgmstream->current_block_samples;
+        vgmstream->loop_block_offset = vgmstream->current_block_offset;
+        vgmstream->loop_next_block_offset = vgmstream->next_block_offset;
+        vgmstream->hit_loop = 1;
+    }
+
+    /* discard up to seek_sample (internal buffer is big enough for any segment's channels) */
+    while (vgmstream->current_sample < seek_sample) {
+        int32_t samples_to_do = seek_sample - vgmstream->current_sample;
+        if (samples_to_do > VGMSTREAM_SEGMENT_SAMPLE_BUFFER)
+            samples_to_do = VGMSTREAM_SEGMENT_SAMPLE_BUFFER;
+
+        render_segment(data, segment, data->buffer, samples_to_do);
+
+        vgmstream->current_sample += samples_to_do;
+        vgmstream->samples_into_block += samples_to_do;
     }
+
+    return 1;
+}
+
+/* Segment that loops go back to (restarted from its start), or NULL if closed */
+VGMSTREAM* get_layout_segmented_loop(VGMSTREAM* vgmstream) {
+    segmented_layout_data *data = vgmstream->layout_data;
+    int segment;
+
+    if (!data || !data->segment_starts)
+        return NULL;
+
+    segment = find_segment(data, vgmstream->loop_start_sample, vgmstream->num_samples);
+    if (segment < 0)
+        return NULL;
+    return data->segments[segment];
 }
 
 /* helper for easier creation of segments */
 VGMSTREAM *allocate_segmented_vgmstream(segmented_layout_data* data, int loop_flag, int loop_start_segment, int loop_end_segment) {
     VGMSTREAM *vgmstream = NULL;
-    int channel_layout;
-    int i, num_samples, loop_start, loop_end;
+    int num_samples, loop_start, loop_end;
 
-    /* save data */
-    channel_layout = data->segments[0]->channel_layout;
-    num_samples = 0;
+    /* save data (segments were checked on setup) */
+    num_samples = data->segment_starts[data->segment_count];
     loop_start = 0;
     loop_end = 0;
-    for (i = 0; i < data->segment_count; i++) {
-        if (loop_flag && i == loop_start_segment)
-            loop_start = num_samples;
-
-        num_samples += data->segments[i]->num_samples;
-
-        if (loop_flag && i == loop_end_segment)
-            loop_end = num_samples;
-
-        /* inherit first segment's layout but only if all segments' layout match */
-        if (channel_layout != 0 && channel_layout != data->segments[i]->channel_layout)
-            channel_layout = 0;
-    }
+    if (loop_flag && loop_start_segment >= 0 && loop_start_segment < data->segment_count)
+        loop_start = data->segment_starts[loop_start_segment];
+    if (loop_flag && loop_end_segment >= 0 && loop_end_segment < data->segment_count)
+        loop_end = data->segment_starts[loop_end_segment + 1];
 
     /* respect loop_flag even when no loop_end found as it's possible file loops are set outside */
 
@@ -277,7 +590,7 @@ VGMSTREAM *allocate_segmented_vgmstream(segmented_layout_data* data, int loop_fl
     vgmstream->loop_start_sample = loop_start;
     vgmstream->loop_end_sample = loop_end;
     vgmstream->coding_type = data->segments[0]->coding_type;
-    vgmstream->channel_layout = channel_layout;
+    vgmstream->channel_layout = data->channel_layout;
 
     vgmstream->layout_type = layout_segmented;
     vgmstream->layout_data = data;
@@ -0,0 +1,104 @@
+#include <string.h>
+#include "membudget.h"
+#include "vgmstream.h"
+#include "page_cache.h"
+#include "pool.h"
+
+/* A single figure for hosts with very different memory (small ARM boxes to desktops) that sizes the
+ * global caches, plus a few per-stream decisions that were fixed before. Shares of the budget: */
+#define MEMBUDGET_PAGE_CACHE_DIV    8   /* shared file pages */
+#define MEMBUDGET_BUFFER_GROWTH_DIV 4   /* adaptive buffers growing past their default size */
+#define MEMBUDGET_BUFFER_POOL_DIV   16  /* idle streamfile buffers */
+#define MEMBUDGET_CHECKPOINTS_DIV   4   /* checkpoints of each player */
+#define MEMBUDGET_HOST_CACHE_DIV    4   /* host caches of decoded audio */
+#define MEMBUDGET_CHANNEL_BUFFERS_DIV 64 /* buffers of a stream's channels */
+
+#define MEMBUDGET_LOW_SIZE          0x1000000 /* under this keep the least possible open */
+#define MEMBUDGET_MIN_BUFFER_SIZE   0x1000
+
+static struct {
+    size_t max_size;
+    void (*lock)(void*);
+    void (*unlock)(void*);
+    void* lock_data;
+
+    size_t checkpoints;     /* used by all players */
+} budget;
+
+
+static void budget_lock(void) {
+    if (budget.lock)
+        budget.lock(budget.lock_data);
+}
+
+static void budget_unlock(void) {
+    if (budget.unlock)
+        budget.unlock(budget.lock_data);
+}
+
+void vgmstream_memory_budget_setup(size_t max_size, void (*lock)(void*), void (*unlock)(void*), void* lock_data) {
+    budget.max_size = max_size;
+    budget.lock = lock;
+    budget.unlock = unlock;
+    budget.lock_data = lock_data;
+
+    vgmstream_page_cache_setup(max_size / MEMBUDGET_PAGE_CACHE_DIV, lock, unlock, lock_data);
+    vgmstream_buffer_budget_setup(max_size / MEMBUDGET_BUFFER_GROWTH_DIV, lock, unlock, lock_data);
+    vgmstream_buffer_pool_setup(max_size / MEMBUDGET_BUFFER_POOL_DIV, lock, unlock, lock_data);
+}
+
+size_t vgmstream_memory_budget_get_host_cache(void) {
+    return budget.max_size / MEMBUDGET_HOST_CACHE_DIV;
+}
+
+void vgmstream_get_memory_usage(vgmstream_memory_usage_t* usage) {
+    memset(usage, 0, sizeof(vgmstream_memory_usage_t));
+
+    usage->page_cache = page_cache_get_size();
+    streamfile_get_buffer_usage(&usage->stream_buffers, &usage->buffer_pool);
+    usage->decoder_pool = pool_get_size();
+
+    budget_lock();
+    usage->checkpoints = budget.checkpoints;
+    budget_unlock();
+
+    usage->total = usage->page_cache + usage->stream_buffers + usage->buffer_pool + usage->decoder_pool + usage->checkpoints;
+}
+
+
+size_t membudget_get(void) {
+    return budget.max_size;
+}
+
+size_t membudget_get_buffer_size(int channels, size_t default_size) {
+    size_t max_size, buffer_size = default_size;
+
+    if (!budget.max_size || channels <= 0)
+        return default_size;
+
+    max_size = budget.max_size / MEMBUDGET_CHANNEL_BUFFERS_DIV;
+    while (buffer_size > MEMBUDGET_MIN_BUFFER_SIZE && buffer_size * channels > max_size) {
+        buffer_size /= 2;
+    }
+    return buffer_size;
+}
+
+size_t membudget_get_checkpoint_size(size_t requested) {
+    size_t max_size = budget.max_size / MEMBUDGET_CHECKPOINTS_DIV;
+
+    if (!budget.max_size)
+        return requested;
+    if (requested && requested < max_size)
+        return requested;
+    return max_size;
+}
+
+int membudget_is_low(void) {
+    return budget.max_size && budget.max_size < MEMBUDGET_LOW_SIZE;
+}
+
+void membudget_add_checkpoints(long bytes) {
+    budget_lock();
+    budget.checkpoints += bytes;
+    budget_unlock();
+}
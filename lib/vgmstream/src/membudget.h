@@ -0,0 +1,24 @@
+/*
+ * membudget.h - global memory budget and usage of caches/buffers
+ */
+#ifndef _MEMBUDGET_H
+#define _MEMBUDGET_H
+
+#include "streamtypes.h"
+
+/* Budget set with vgmstream_memory_budget_setup (0 if none) */
+size_t membudget_get(void);
+
+/* Buffer size for each of the channels' streamfiles, default_size unless the budget is tight. */
+size_t membudget_get_buffer_size(int channels, size_t default_size);
+
+/* Checkpoint memory a player may use given the size it asked (0 = no limit). */
+size_t membudget_get_checkpoint_size(size_t requested);
+
+/* If bounded segmented layouts should only keep the segments they are about to play. */
+int membudget_is_low(void);
+
+/* Tracks player checkpoint memory for vgmstream_get_memory_usage (bytes may be negative). */
+void membudget_add_checkpoints(long bytes);
+
+#endif /* _MEMBUDGET_H */
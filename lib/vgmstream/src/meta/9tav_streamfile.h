@@ -168,7 +168,7 @@ static STREAMFILE* setup_9tav_streamfile(STREAMFILE *streamFile, off_t stream_of
     if (!new_streamFile) goto fail;
     temp_streamFile = new_streamFile;
 
-    new_streamFile = open_buffer_streamfile(new_streamFile,0);
+    new_streamFile = open_buffer_streamfile_adaptive(new_streamFile);
     if (!new_streamFile) goto fail;
     temp_streamFile = new_streamFile;
 
@@ -49,7 +49,7 @@ VGMSTREAM* init_vgmstream_acb(STREAMFILE* sf) {
 
     //;VGM_LOG("ACB: subfile offset=%lx + %x\n", subfile_offset, subfile_size);
 
-    temp_sf = setup_subfile_streamfile(sf, subfile_offset,subfile_size, "awb");
+    temp_sf = open_slice_streamfile(sf, subfile_offset,subfile_size, "awb");
     if (!temp_sf) goto fail;
 
     vgmstream = init_vgmstream_awb_memory(temp_sf, sf);
@@ -71,8 +71,7 @@ fail:
 /* ************************************** */
 
 /* extra config for .acb with lots of sounds, since there is a lot of IO back and forth,
- * ex. +7000 acb+awb subsongs in Ultra Despair Girls (PC) */
-//TODO: could pre-load all sections first, but needs cache for multiple subsongs (+semaphs, if multiple read the same thing)
+ * ex. +7000 acb+awb subsongs in Ultra Despair Girls (PC) (tables are walked once per .acb, see acb_name_cache) */
 #define ACB_TABLE_BUFFER_CUENAME 0x8000
 #define ACB_TABLE_BUFFER_CUE 0x40000
 #define ACB_TABLE_BUFFER_BLOCK 0x8000
@@ -82,7 +81,6 @@ fail:
 #define ACB_TABLE_BUFFER_SYNTH 0x40000
 #define ACB_TABLE_BUFFER_WAVEFORM 0x20000
 
-#define ACB_MAX_NAMELIST 255
 #define ACB_MAX_NAME 1024 /* even more is possible in rare cases [Senran Kagura Burst Re:Newal (PC)] */
 
 
@@ -124,7 +122,6 @@ typedef struct {
 
     /* config */
     int is_memory;
-    int target_waveid;
     int has_TrackEventTable;
     int has_CommandTable;
 
@@ -135,9 +132,9 @@ typedef struct {
     /* name stuff */
     int16_t cuename_index;
     const char * cuename_name;
-    int awbname_count;
-    int16_t awbname_list[ACB_MAX_NAMELIST];
-    char name[ACB_MAX_NAME];
+    int wave_count;             /* max waveid + 1 */
+    char** wave_names;          /* per waveid, NULL if no cue uses it */
+    int16_t* wave_cuenames;     /* last cue name added to each waveid, to ignore repeats */
 
 } acb_header;
 
@@ -164,50 +161,55 @@ fail:
     return 0;
 }
 
-//todo safeops, avoid recalc lens 
-static void acb_cat(char* dst, int dst_max, const char* src) {
-    int dst_len = strlen(dst);
-    int src_len = strlen(dst);
-    if (dst_len + src_len > dst_max - 1)
-        return;
-    strcat(dst, src);
-}
-static void acb_cpy(char* dst, int dst_max, const char* src) {
-    int src_len = strlen(dst);
-    if (src_len > dst_max - 1)
-        return;
-    strcpy(dst, src);
-}
+/* grows name lists so waveid fits */
+static int grow_acb_names(acb_header* acb, int waveid) {
+    int i, wave_count = (waveid + 0x100) & ~0xFF;
+    char** wave_names;
+    int16_t* wave_cuenames;
 
-static void add_acb_name(acb_header* acb, int8_t Waveform_Streaming) {
+    wave_names = realloc(acb->wave_names, wave_count * sizeof(char*));
+    if (!wave_names) return 0;
+    acb->wave_names = wave_names;
 
-    /* ignore name repeats */
-    if (acb->awbname_count) {
-        int i;
-        for (i = 0; i < acb->awbname_count; i++) {
-            if (acb->awbname_list[i] == acb->cuename_index)
-                return;
-        }
+    wave_cuenames = realloc(acb->wave_cuenames, wave_count * sizeof(int16_t));
+    if (!wave_cuenames) return 0;
+    acb->wave_cuenames = wave_cuenames;
+
+    for (i = acb->wave_count; i < wave_count; i++) {
+        acb->wave_names[i] = NULL;
+        acb->wave_cuenames[i] = -1;
     }
+    acb->wave_count = wave_count;
+    return 1;
+}
+
+static int add_acb_name(acb_header* acb, uint16_t waveid, int8_t Waveform_Streaming) {
+    const char* suffix = (Waveform_Streaming == 2 && acb->is_memory) ? " [pre]" : "";
+    char* name;
+    size_t len, add_len;
+
+    if (waveid >= acb->wave_count && !grow_acb_names(acb, waveid))
+        return 0;
+
+    /* ignore name repeats (cues are read in order, so only the current one may repeat) */
+    if (acb->wave_cuenames[waveid] == acb->cuename_index)
+        return 1;
 
     /* since waveforms can be reused by cues, multiple names are a thing */
-    if (acb->awbname_count) {
-        acb_cat(acb->name, sizeof(acb->name), "; ");
-        acb_cat(acb->name, sizeof(acb->name), acb->cuename_name);
-    }
-    else {
-        acb_cpy(acb->name, sizeof(acb->name), acb->cuename_name);
-    }
-    if (Waveform_Streaming == 2 && acb->is_memory) {
-        acb_cat(acb->name, sizeof(acb->name), " [pre]");
-    }
+    len = acb->wave_names[waveid] ? strlen(acb->wave_names[waveid]) : 0;
+    add_len = (len ? 2 : 0) + strlen(acb->cuename_name) + strlen(suffix);
+    if (len + add_len > ACB_MAX_NAME - 1)
+        return 1;
+
+    name = realloc(acb->wave_names[waveid], len + add_len + 1);
+    if (!name) return 0;
+    sprintf(name + len, "%s%s%s", len ? "; " : "", acb->cuename_name, suffix);
 
-    acb->awbname_list[acb->awbname_count] = acb->cuename_index;
-    acb->awbname_count++;
-    if (acb->awbname_count >= ACB_MAX_NAMELIST)
-        acb->awbname_count = ACB_MAX_NAMELIST - 1; /* ??? */
+    acb->wave_names[waveid] = name;
+    acb->wave_cuenames[waveid] = acb->cuename_index;
 
-    //;VGM_LOG("ACB: found cue for waveid=%i: %s\n", acb->target_waveid, acb->cuename_name);
+    //;VGM_LOG("ACB: found cue for waveid=%i: %s\n", waveid, acb->cuename_name);
+    return 1;
 }
 
 
@@ -231,15 +233,13 @@ static int load_acb_waveform(acb_header* acb, int16_t Index) {
         goto fail;
     //;VGM_LOG("ACB: Waveform[%i]: Id=%i, Streaming=%i\n", Index, Waveform_Id, Waveform_Streaming);
 
-    /* not found but valid */
-    if (Waveform_Id != acb->target_waveid)
-        return 1;
     /* must match our target's (0=memory, 1=streaming, 2=memory (prefetch)+stream) */
     if ((acb->is_memory && Waveform_Streaming == 1) || (!acb->is_memory && Waveform_Streaming == 0))
         return 1;
 
     /* aaand finally get name (phew) */
-    add_acb_name(acb, Waveform_Streaming);
+    if (!add_acb_name(acb, Waveform_Id, Waveform_Streaming))
+        goto fail;
 
     return 1;
 fail:
@@ -591,13 +591,127 @@ fail:
 }
 
 
-void load_acb_wave_name(STREAMFILE* sf, VGMSTREAM* vgmstream, int waveid, int is_memory) {
-    acb_header acb = {0};
-    int i, CueName_rows;
+static void free_acb_names(char** wave_names, int wave_count) {
+    int i;
+
+    if (!wave_names)
+        return;
+    for (i = 0; i < wave_count; i++) {
+        free(wave_names[i]);
+    }
+    free(wave_names);
+}
 
+/* Names of every waveid of the last few .acb, as hashes of their name and size (+ memory/stream
+ * target), so each subsong of big .awb doesn't walk all cues again. Only enabled with
+ * vgmstream_acb_name_cache_setup. Older .acb are dropped. */
+#define ACB_NAME_CACHE_SIZE 4
+
+static struct {
+    int enabled;
+    struct {
+        uint64_t key;
+        int wave_count;
+        char** wave_names;
+    } entries[ACB_NAME_CACHE_SIZE];
+    int count;
+    int next;
+    void (*lock)(void*);
+    void (*unlock)(void*);
+    void* lock_data;
+} acb_name_cache;
+
+void vgmstream_acb_name_cache_setup(int enabled, void (*lock)(void*), void (*unlock)(void*), void* lock_data) {
+    int i;
 
-    if (!sf || !vgmstream || waveid < 0)
+    for (i = 0; i < acb_name_cache.count; i++) {
+        free_acb_names(acb_name_cache.entries[i].wave_names, acb_name_cache.entries[i].wave_count);
+        acb_name_cache.entries[i].wave_names = NULL;
+    }
+
+    acb_name_cache.enabled = enabled;
+    acb_name_cache.count = 0;
+    acb_name_cache.next = 0;
+    acb_name_cache.lock = lock;
+    acb_name_cache.unlock = unlock;
+    acb_name_cache.lock_data = lock_data;
+}
+
+static uint64_t acb_name_cache_key(STREAMFILE* sf, int is_memory) {
+    char filename[PATH_LIMIT];
+    uint64_t hash = 0xCBF29CE484222325ULL; /* FNV-1a */
+    int i;
+
+    get_streamfile_name(sf, filename, sizeof(filename));
+    for (i = 0; filename[i]; i++) {
+        hash = (hash ^ (uint8_t)filename[i]) * 0x100000001B3ULL;
+    }
+    hash = (hash ^ get_streamfile_size(sf)) * 0x100000001B3ULL;
+    return (hash ^ is_memory) * 0x100000001B3ULL;
+}
+
+/* copy waveid's name (empty if none), returns 1 if the .acb is known */
+static int acb_name_cache_get(uint64_t key, int waveid, char* name, size_t name_size) {
+    int i, found = 0;
+
+    if (!acb_name_cache.enabled)
+        return 0;
+
+    if (acb_name_cache.lock)
+        acb_name_cache.lock(acb_name_cache.lock_data);
+    for (i = 0; i < acb_name_cache.count; i++) {
+        if (acb_name_cache.entries[i].key == key) {
+            found = 1;
+            name[0] = '\0';
+            if (waveid < acb_name_cache.entries[i].wave_count && acb_name_cache.entries[i].wave_names[waveid])
+                snprintf(name, name_size, "%s", acb_name_cache.entries[i].wave_names[waveid]);
+            break;
+        }
+    }
+    if (acb_name_cache.unlock)
+        acb_name_cache.unlock(acb_name_cache.lock_data);
+
+    return found;
+}
+
+/* store an .acb's names (the cache takes them) */
+static void acb_name_cache_put(uint64_t key, char** wave_names, int wave_count) {
+    char** old_names = NULL;
+    int old_count = 0;
+    int i;
+
+    if (!acb_name_cache.enabled) {
+        free_acb_names(wave_names, wave_count);
         return;
+    }
+
+    if (acb_name_cache.lock)
+        acb_name_cache.lock(acb_name_cache.lock_data);
+    for (i = 0; i < acb_name_cache.count; i++) {
+        if (acb_name_cache.entries[i].key == key)
+            break;
+    }
+    if (i == acb_name_cache.count) {
+        i = acb_name_cache.next;
+        acb_name_cache.next = (acb_name_cache.next + 1) % ACB_NAME_CACHE_SIZE;
+        if (acb_name_cache.count < ACB_NAME_CACHE_SIZE)
+            acb_name_cache.count++;
+    }
+    old_names = acb_name_cache.entries[i].wave_names;
+    old_count = acb_name_cache.entries[i].wave_count;
+    acb_name_cache.entries[i].key = key;
+    acb_name_cache.entries[i].wave_count = wave_count;
+    acb_name_cache.entries[i].wave_names = wave_names;
+    if (acb_name_cache.unlock)
+        acb_name_cache.unlock(acb_name_cache.lock_data);
+
+    free_acb_names(old_names, old_count);
+}
+
+/* find names of all waveids in a single walk of the cues */
+static int load_acb_names(acb_header* acb, STREAMFILE* sf, int is_memory) {
+    int i, CueName_rows;
+    int ok = 0;
 
     /* Normally games load a .acb + .awb, and asks the .acb to play a cue by name or index.
      * Since we only care for actual waves, to get its name we need to find which cue uses our wave.
@@ -621,50 +735,77 @@ void load_acb_wave_name(STREAMFILE* sf, VGMSTREAM* vgmstream, int waveid, int is
      * .acb link to .awb by name (loaded manually), though they have a checksum/hash to validate.
      */
 
-    //;VGM_LOG("ACB: find waveid=%i\n", waveid);
-
-    acb.acbFile = sf;
+    acb->acbFile = sf;
 
-    acb.Header = utf_open(acb.acbFile, 0x00, NULL, NULL);
-    if (!acb.Header) goto fail;
+    acb->Header = utf_open(acb->acbFile, 0x00, NULL, NULL);
+    if (!acb->Header) goto fail;
 
-    acb.target_waveid = waveid;
-    acb.is_memory = is_memory;
-    acb.has_TrackEventTable = utf_query_data(acb.Header, 0, "TrackEventTable", NULL,NULL);
-    acb.has_CommandTable = utf_query_data(acb.Header, 0, "CommandTable", NULL,NULL);
+    acb->is_memory = is_memory;
+    acb->has_TrackEventTable = utf_query_data(acb->Header, 0, "TrackEventTable", NULL,NULL);
+    acb->has_CommandTable = utf_query_data(acb->Header, 0, "CommandTable", NULL,NULL);
 
 
     /* read all possible cue names and find which waveids are referenced by it */
-    if (!open_utf_subtable(&acb, &acb.CueNameSf, &acb.CueNameTable, "CueNameTable", &CueName_rows, ACB_TABLE_BUFFER_CUENAME))
+    if (!open_utf_subtable(acb, &acb->CueNameSf, &acb->CueNameTable, "CueNameTable", &CueName_rows, ACB_TABLE_BUFFER_CUENAME))
         goto fail;
     for (i = 0; i < CueName_rows; i++) {
 
-        if (!load_acb_cuename(&acb, i))
+        if (!load_acb_cuename(acb, i))
             goto fail;
     }
 
-    /* meh copy */
-    if (acb.awbname_count > 0) {
-        strncpy(vgmstream->stream_name, acb.name, STREAM_NAME_SIZE);
-        vgmstream->stream_name[STREAM_NAME_SIZE - 1] = '\0';
+    ok = 1;
+fail:
+    utf_close(acb->Header);
+
+    utf_close(acb->CueNameTable);
+    utf_close(acb->CueTable);
+    utf_close(acb->BlockTable);
+    utf_close(acb->SequenceTable);
+    utf_close(acb->TrackTable);
+    utf_close(acb->TrackCommandTable);
+    utf_close(acb->SynthTable);
+    utf_close(acb->WaveformTable);
+
+    close_streamfile(acb->CueNameSf);
+    close_streamfile(acb->CueSf);
+    close_streamfile(acb->BlockSf);
+    close_streamfile(acb->SequenceSf);
+    close_streamfile(acb->TrackSf);
+    close_streamfile(acb->TrackCommandSf);
+    close_streamfile(acb->SynthSf);
+    close_streamfile(acb->WaveformSf);
+
+    free(acb->wave_cuenames);
+    acb->wave_cuenames = NULL;
+    return ok;
+}
+
+void load_acb_wave_name(STREAMFILE* sf, VGMSTREAM* vgmstream, int waveid, int is_memory) {
+    char name[STREAM_NAME_SIZE];
+    uint64_t key;
+
+
+    if (!sf || !vgmstream || waveid < 0)
+        return;
+
+    //;VGM_LOG("ACB: find waveid=%i\n", waveid);
+
+    key = acb_name_cache_key(sf, is_memory);
+    if (!acb_name_cache_get(key, waveid, name, sizeof(name))) {
+        acb_header acb = {0};
+
+        if (!load_acb_names(&acb, sf, is_memory)) {
+            free_acb_names(acb.wave_names, acb.wave_count);
+            return;
+        }
+
+        name[0] = '\0';
+        if (waveid < acb.wave_count && acb.wave_names[waveid])
+            snprintf(name, sizeof(name), "%s", acb.wave_names[waveid]);
+        acb_name_cache_put(key, acb.wave_names, acb.wave_count);
     }
 
-fail:
-    utf_close(acb.Header);
-
-    utf_close(acb.CueNameTable);
-    utf_close(acb.CueTable);
-    utf_close(acb.SequenceTable);
-    utf_close(acb.TrackTable);
-    utf_close(acb.TrackCommandTable);
-    utf_close(acb.SynthTable);
-    utf_close(acb.WaveformTable);
-
-    close_streamfile(acb.CueNameSf);
-    close_streamfile(acb.CueSf);
-    close_streamfile(acb.SequenceSf);
-    close_streamfile(acb.TrackSf);
-    close_streamfile(acb.TrackCommandSf);
-    close_streamfile(acb.SynthSf);
-    close_streamfile(acb.WaveformSf);
+    if (name[0])
+        strcpy(vgmstream->stream_name, name);
 }
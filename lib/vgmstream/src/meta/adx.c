@@ -248,6 +248,111 @@ fail:
 }
 
 
+/* Keys found per folder and type (games use one key for all files), as hashes of the folder name, so
+ * next files there test that key first. Only enabled with vgmstream_adx_key_cache_setup. */
+#define ADX_KEY_CACHE_SIZE 16
+
+static struct {
+    int enabled;
+    struct {
+        uint64_t folder;
+        uint8_t type;
+        uint16_t start;
+        uint16_t mult;
+        uint16_t add;
+    } entries[ADX_KEY_CACHE_SIZE];
+    int count;
+    int next;
+    void (*lock)(void*);
+    void (*unlock)(void*);
+    void* lock_data;
+} adx_key_cache;
+
+void vgmstream_adx_key_cache_setup(int enabled, void (*lock)(void*), void (*unlock)(void*), void* lock_data) {
+    adx_key_cache.enabled = enabled;
+    adx_key_cache.count = 0;
+    adx_key_cache.next = 0;
+    adx_key_cache.lock = lock;
+    adx_key_cache.unlock = unlock;
+    adx_key_cache.lock_data = lock_data;
+}
+
+static uint64_t get_adx_key_folder(STREAMFILE* sf) {
+    char filename[PATH_LIMIT];
+    uint64_t hash = 0xCBF29CE484222325ULL; /* FNV-1a */
+    int i, len;
+
+    get_streamfile_name(sf, filename, sizeof(filename));
+    len = strlen(filename);
+    while (len > 0 && filename[len - 1] != '/' && filename[len - 1] != '\\') {
+        len--;
+    }
+
+    for (i = 0; i < len; i++) {
+        hash = (hash ^ (uint8_t)filename[i]) * 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+/* find (get=1) or store (get=0) a folder's key */
+static int adx_key_cache_access(uint64_t folder, uint8_t type, uint16_t* start, uint16_t* mult, uint16_t* add, int get) {
+    int i, found = 0;
+
+    if (!adx_key_cache.enabled)
+        return 0;
+
+    if (adx_key_cache.lock)
+        adx_key_cache.lock(adx_key_cache.lock_data);
+    for (i = 0; i < adx_key_cache.count; i++) {
+        if (adx_key_cache.entries[i].folder == folder && adx_key_cache.entries[i].type == type) {
+            found = 1;
+            break;
+        }
+    }
+    if (get && found) {
+        *start = adx_key_cache.entries[i].start;
+        *mult = adx_key_cache.entries[i].mult;
+        *add = adx_key_cache.entries[i].add;
+    }
+    else if (!get) {
+        if (!found) {
+            i = adx_key_cache.next;
+            adx_key_cache.next = (adx_key_cache.next + 1) % ADX_KEY_CACHE_SIZE;
+            if (adx_key_cache.count < ADX_KEY_CACHE_SIZE)
+                adx_key_cache.count++;
+        }
+        adx_key_cache.entries[i].folder = folder;
+        adx_key_cache.entries[i].type = type;
+        adx_key_cache.entries[i].start = *start;
+        adx_key_cache.entries[i].mult = *mult;
+        adx_key_cache.entries[i].add = *add;
+    }
+    if (adx_key_cache.unlock)
+        adx_key_cache.unlock(adx_key_cache.lock_data);
+
+    return found;
+}
+
+/* test XOR values vs scales before and in the test frames, while they look valid */
+static int test_adx_key(const uint16_t* prescales, int prescale_count, const uint16_t* scales, int scale_count,
+        int keymask, uint16_t xor, uint16_t mul, uint16_t add) {
+    int i;
+
+    for (i = 0; i < prescale_count; i++) {
+        if ((prescales[i] & keymask) != (xor & keymask) && prescales[i] != 0)
+            return 0;
+        xor = xor * mul + add;
+    }
+
+    for (i = 0; i < scale_count; i++) {
+        if ((scales[i] & keymask) != (xor & keymask))
+            return 0;
+        xor = xor * mul + add;
+    }
+
+    return 1;
+}
+
 /* ADX key detection works by reading XORed ADPCM scales in frames, and un-XORing with keys in
  * a list. If resulting values are within the expected range for N scales we accept that key. */
 static int find_adx_key(STREAMFILE *sf, uint8_t type, uint16_t *xor_start, uint16_t *xor_mult, uint16_t *xor_add) {
@@ -256,6 +361,7 @@ static int find_adx_key(STREAMFILE *sf, uint8_t type, uint16_t *xor_start, uint1
     uint16_t *prescales = NULL;
     int bruteframe_start = 0, bruteframe_count = -1;
     off_t start_offset;
+    uint64_t folder = 0;
     int i, rc = 0;
 
 
@@ -380,6 +486,7 @@ static int find_adx_key(STREAMFILE *sf, uint8_t type, uint16_t *xor_start, uint1
         const adxkey_info *keys = NULL;
         int keycount = 0, keymask = 0;
         int key_id;
+        uint16_t key_xor, key_mul, key_add;
 
         /* setup test mask (used to check high bits that signal un-XORed scale would be too high to be valid) */
         if (type == 8) {
@@ -397,10 +504,19 @@ static int find_adx_key(STREAMFILE *sf, uint8_t type, uint16_t *xor_start, uint1
             keymask = 0x1000;
         }
 
+        /* last key that worked in this folder */
+        folder = get_adx_key_folder(sf);
+        if (adx_key_cache_access(folder, type, &key_xor, &key_mul, &key_add, 1) &&
+                test_adx_key(prescales, bruteframe_start, scales, bruteframe_count, keymask, key_xor, key_mul, key_add)) {
+            *xor_start = key_xor;
+            *xor_mult = key_mul;
+            *xor_add = key_add;
+            rc = 1;
+            goto done;
+        }
+
         /* try all keys until one decrypts correctly vs expected scales */
         for (key_id = 0; key_id < keycount; key_id++) {
-            uint16_t key_xor, key_mul, key_add;
-            uint16_t xor, mul, add;
 
             /* get pre-derived XOR values or derive if needed */
             if (keys[key_id].start || keys[key_id].mult || keys[key_id].add) {
@@ -419,14 +535,10 @@ static int find_adx_key(STREAMFILE *sf, uint8_t type, uint16_t *xor_start, uint1
                 continue;
             }
 
-            /* temp test values */
-            xor = key_xor;
-            mul = key_mul;
-            add = key_add;
-
 #if 0
             /* derive and print all keys in the list, quick validity test */
             {
+                uint16_t xor, mul, add;
                 uint16_t test_xor, test_mul, test_add;
                 xor = keys[key_id].start;
                 mul = keys[key_id].mult;
@@ -447,28 +559,14 @@ static int find_adx_key(STREAMFILE *sf, uint8_t type, uint16_t *xor_start, uint1
             }
 #endif
 
-            /* test vs prescales while XOR looks valid */
-            for (i = 0; i < bruteframe_start; i++) {
-                if ((prescales[i] & keymask) != (xor & keymask) && prescales[i] != 0)
-                    break;
-                xor = xor * mul + add;
-            }
-            if (i != bruteframe_start)
-                continue;
-
-            /* test vs scales while XOR looks valid */
-            for (i = 0; i < bruteframe_count; i++) {
-                if ((scales[i] & keymask) != (xor & keymask))
-                    break;
-                xor = xor * mul + add;
-            }
-            if (i != bruteframe_count)
+            if (!test_adx_key(prescales, bruteframe_start, scales, bruteframe_count, keymask, key_xor, key_mul, key_add))
                 continue;
 
             /* all scales are valid, key is good */
             *xor_start = key_xor;
             *xor_mult = key_mul;
             *xor_add = key_add;
+            adx_key_cache_access(folder, type, &key_xor, &key_mul, &key_add, 0);
             rc = 1;
             break;
         }
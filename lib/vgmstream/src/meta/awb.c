@@ -121,7 +121,7 @@ VGMSTREAM * init_vgmstream_awb_memory(STREAMFILE *streamFile, STREAMFILE *acbFil
     }
 
 
-    temp_streamFile = setup_subfile_streamfile(streamFile, subfile_offset,subfile_size, extension);
+    temp_streamFile = open_slice_streamfile(streamFile, subfile_offset,subfile_size, extension);
     if (!temp_streamFile) goto fail;
 
     switch(type) {
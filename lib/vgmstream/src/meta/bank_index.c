@@ -0,0 +1,249 @@
+#include "../vgmstream.h"
+#include "bank_index.h"
+
+#define BANK_INDEX_SIZE 16
+
+struct bank_index {
+    uint64_t key;
+    int total_subsongs;
+    int entries_max;
+    bank_entry_t* entries;
+    char** names;           /* per subsong, allocated on first set */
+};
+
+static struct {
+    int enabled;
+    bank_index* banks[BANK_INDEX_SIZE];
+    int count;
+    int next;
+    void (*lock)(void*);
+    void (*unlock)(void*);
+    void* lock_data;
+} bank_indexes;
+
+
+void bank_index_free(bank_index* index) {
+    int i;
+
+    if (!index)
+        return;
+
+    if (index->names) {
+        for (i = 0; i < index->total_subsongs; i++) {
+            free(index->names[i]);
+        }
+        free(index->names);
+    }
+    free(index->entries);
+    free(index);
+}
+
+void vgmstream_bank_index_setup(int enabled, void (*lock)(void*), void (*unlock)(void*), void* lock_data) {
+    int i;
+
+    for (i = 0; i < bank_indexes.count; i++) {
+        bank_index_free(bank_indexes.banks[i]);
+        bank_indexes.banks[i] = NULL;
+    }
+
+    bank_indexes.enabled = enabled;
+    bank_indexes.count = 0;
+    bank_indexes.next = 0;
+    bank_indexes.lock = lock;
+    bank_indexes.unlock = unlock;
+    bank_indexes.lock_data = lock_data;
+}
+
+static uint64_t bank_index_key(STREAMFILE* sf, uint32_t tag) {
+    char filename[PATH_LIMIT];
+    uint64_t hash = 0xCBF29CE484222325ULL; /* FNV-1a */
+    int i;
+
+    get_streamfile_name(sf, filename, sizeof(filename));
+    for (i = 0; filename[i]; i++) {
+        hash = (hash ^ (uint8_t)filename[i]) * 0x100000001B3ULL;
+    }
+    hash = (hash ^ get_streamfile_size(sf)) * 0x100000001B3ULL;
+    return (hash ^ tag) * 0x100000001B3ULL;
+}
+
+/* call with the lock held */
+static bank_index* find_bank(uint64_t key) {
+    int i;
+
+    for (i = 0; i < bank_indexes.count; i++) {
+        if (bank_indexes.banks[i]->key == key)
+            return bank_indexes.banks[i];
+    }
+    return NULL;
+}
+
+static void lock_banks(void) {
+    if (bank_indexes.lock)
+        bank_indexes.lock(bank_indexes.lock_data);
+}
+
+static void unlock_banks(void) {
+    if (bank_indexes.unlock)
+        bank_indexes.unlock(bank_indexes.lock_data);
+}
+
+
+int bank_index_get(STREAMFILE* sf, uint32_t tag, int target_subsong, bank_entry_t* entry) {
+    uint64_t key;
+    bank_index* index;
+    int total_subsongs = 0;
+
+    if (!bank_indexes.enabled)
+        return 0;
+
+    key = bank_index_key(sf, tag);
+
+    lock_banks();
+    index = find_bank(key);
+    if (index) {
+        total_subsongs = index->total_subsongs;
+        if (target_subsong > 0 && target_subsong <= total_subsongs)
+            *entry = index->entries[target_subsong - 1];
+    }
+    unlock_banks();
+
+    return total_subsongs;
+}
+
+int bank_index_find(STREAMFILE* sf, uint32_t tag, uint32_t index_value, bank_entry_t* entry) {
+    uint64_t key;
+    bank_index* index;
+    int i, found = -1;
+
+    if (!bank_indexes.enabled)
+        return -1;
+
+    key = bank_index_key(sf, tag);
+
+    lock_banks();
+    index = find_bank(key);
+    if (index) {
+        found = 0;
+        for (i = 0; i < index->total_subsongs; i++) {
+            if (index->entries[i].index == index_value) {
+                *entry = index->entries[i];
+                found = 1;
+                break;
+            }
+        }
+    }
+    unlock_banks();
+
+    return found;
+}
+
+bank_index* bank_index_new(STREAMFILE* sf, uint32_t tag) {
+    bank_index* index;
+
+    if (!bank_indexes.enabled)
+        return NULL;
+
+    index = calloc(1, sizeof(bank_index));
+    if (!index) return NULL;
+
+    index->key = bank_index_key(sf, tag);
+    return index;
+}
+
+int bank_index_add(bank_index* index, const bank_entry_t* entry) {
+    if (!index)
+        return 1;
+
+    if (index->total_subsongs >= index->entries_max) {
+        int entries_max = index->entries_max ? index->entries_max * 2 : 256;
+        bank_entry_t* entries = realloc(index->entries, entries_max * sizeof(bank_entry_t));
+        if (!entries) return 0;
+
+        index->entries = entries;
+        index->entries_max = entries_max;
+    }
+
+    index->entries[index->total_subsongs] = *entry;
+    index->total_subsongs++;
+    return 1;
+}
+
+void bank_index_put(bank_index* index) {
+    bank_index* old = NULL;
+    int i;
+
+    if (!index)
+        return;
+    if (!bank_indexes.enabled || index->total_subsongs == 0) {
+        bank_index_free(index);
+        return;
+    }
+
+    lock_banks();
+    for (i = 0; i < bank_indexes.count; i++) {
+        if (bank_indexes.banks[i]->key == index->key)
+            break;
+    }
+    if (i == bank_indexes.count) {
+        i = bank_indexes.next;
+        bank_indexes.next = (bank_indexes.next + 1) % BANK_INDEX_SIZE;
+        if (bank_indexes.count < BANK_INDEX_SIZE)
+            bank_indexes.count++;
+    }
+    old = bank_indexes.banks[i];
+    bank_indexes.banks[i] = index;
+    unlock_banks();
+
+    bank_index_free(old);
+}
+
+
+int bank_index_get_name(STREAMFILE* sf, uint32_t tag, int target_subsong, char* name, size_t name_size) {
+    uint64_t key;
+    bank_index* index;
+    int found = 0;
+
+    if (!bank_indexes.enabled)
+        return 0;
+
+    key = bank_index_key(sf, tag);
+
+    lock_banks();
+    index = find_bank(key);
+    if (index && index->names && target_subsong > 0 && target_subsong <= index->total_subsongs && index->names[target_subsong - 1]) {
+        snprintf(name, name_size, "%s", index->names[target_subsong - 1]);
+        found = 1;
+    }
+    unlock_banks();
+
+    return found;
+}
+
+void bank_index_set_name(STREAMFILE* sf, uint32_t tag, int target_subsong, const char* name) {
+    uint64_t key;
+    bank_index* index;
+    char* new_name;
+
+    if (!bank_indexes.enabled)
+        return;
+
+    key = bank_index_key(sf, tag);
+    new_name = malloc(strlen(name) + 1);
+    if (!new_name) return;
+    strcpy(new_name, name);
+
+    lock_banks();
+    index = find_bank(key);
+    if (index && target_subsong > 0 && target_subsong <= index->total_subsongs) {
+        if (!index->names)
+            index->names = calloc(index->total_subsongs, sizeof(char*));
+        if (index->names && !index->names[target_subsong - 1]) {
+            index->names[target_subsong - 1] = new_name;
+            new_name = NULL;
+        }
+    }
+    unlock_banks();
+
+    free(new_name);
+}
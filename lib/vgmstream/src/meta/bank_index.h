@@ -0,0 +1,44 @@
+#ifndef _BANK_INDEX_H_
+#define _BANK_INDEX_H_
+
+#include "../streamfile.h"
+
+/* Process-wide index of subsongs in the last opened banks, so parsers that must walk their tables
+ * to find subsong N (and resolve its name) only do it once per bank. Banks are identified by
+ * name+size of the streamfile plus a tag (usually the format id), and entries values mean whatever
+ * each parser needs to open a subsong directly. Only enabled with vgmstream_bank_index_setup,
+ * otherwise calls do nothing (parsers then just walk as usual). Older banks are dropped. */
+
+typedef struct {
+    uint32_t offset;
+    uint32_t size;
+    uint32_t index;
+    uint32_t name_offset;
+    uint32_t name_size;
+} bank_entry_t;
+
+/* opaque struct */
+typedef struct bank_index bank_index;
+
+/* Finds target_subsong (1..N) of a known bank, returns total subsongs or 0 if not indexed
+ * (entry is only filled when target_subsong exists). */
+int bank_index_get(STREAMFILE* sf, uint32_t tag, int target_subsong, bank_entry_t* entry);
+
+/* Finds the first entry with this index value in a known bank (for banks looked up by id rather than
+ * by subsong), returns 1 if found (entry filled), 0 if missing, or -1 if the bank isn't indexed. */
+int bank_index_find(STREAMFILE* sf, uint32_t tag, uint32_t index_value, bank_entry_t* entry);
+
+/* Starts an index to fill while walking a bank, NULL if indexing is disabled. */
+bank_index* bank_index_new(STREAMFILE* sf, uint32_t tag);
+/* Appends the entry of the next subsong (index may be NULL). */
+int bank_index_add(bank_index* index, const bank_entry_t* entry);
+/* Stores a complete index (which is taken), or frees it when a bank fails. */
+void bank_index_put(bank_index* index);
+void bank_index_free(bank_index* index);
+
+/* Names resolved for a subsong of a known bank, for parsers where finding names is the slow part.
+ * get returns 0 if no name was stored yet. */
+int bank_index_get_name(STREAMFILE* sf, uint32_t tag, int target_subsong, char* name, size_t name_size);
+void bank_index_set_name(STREAMFILE* sf, uint32_t tag, int target_subsong, const char* name);
+
+#endif /* _BANK_INDEX_H_ */
@@ -1,26 +1,23 @@
 #ifndef _BGW_STREAMFILE_H_
 #define _BGW_STREAMFILE_H_
 #include "../streamfile.h"
+#include "xor_streamfile.h"
 
 
 #define BGW_KEY_MAX (0xC0*2)
 
 typedef struct {
-    uint8_t key[BGW_KEY_MAX];
-    size_t key_size;
+    xor_key_t key;
 } bgw_decryption_data;
 
 /* Encrypted ATRAC3 info from Moogle Toolbox (https://sourceforge.net/projects/mogbox/) */
 static size_t bgw_decryption_read(STREAMFILE *streamfile, uint8_t *dest, off_t offset, size_t length, bgw_decryption_data* data) {
     size_t bytes_read;
-    int i;
 
     bytes_read = streamfile->read(streamfile, dest, offset, length);
 
     /* decrypt data (xor) */
-    for (i = 0; i < bytes_read; i++) {
-        dest[i] ^= data->key[(offset + i) % data->key_size];
-    }
+    xor_key_apply(&data->key, dest, bytes_read, offset);
 
     //todo: a few files (music069.bgw, music071.bgw, music900.bgw) have the last frames unencrypted,
     // though they are blank and encoder ignores wrongly decrypted frames and outputs blank samples as well
@@ -32,16 +29,19 @@ static STREAMFILE* setup_bgw_atrac3_streamfile(STREAMFILE *streamFile, off_t sub
     STREAMFILE *temp_streamFile = NULL, *new_streamFile = NULL;
     bgw_decryption_data io_data = {0};
     size_t io_data_size = sizeof(bgw_decryption_data);
+    uint8_t key[BGW_KEY_MAX];
+    size_t key_size;
     int ch;
 
     /* setup decryption with key (first frame + modified channel header) */
     if (frame_size*channels == 0 || frame_size*channels > BGW_KEY_MAX) goto fail;
 
-    io_data.key_size = read_streamfile(io_data.key, subfile_offset, frame_size*channels, streamFile);
+    key_size = read_streamfile(key, subfile_offset, frame_size*channels, streamFile);
     for (ch = 0; ch < channels; ch++) {
-        uint32_t xor = get_32bitBE(io_data.key + frame_size*ch);
-        put_32bitBE(io_data.key + frame_size*ch, xor ^ 0xA0024E9F);
+        uint32_t xor = get_32bitBE(key + frame_size*ch);
+        put_32bitBE(key + frame_size*ch, xor ^ 0xA0024E9F);
     }
+    if (!xor_key_init(&io_data.key, key, key_size)) goto fail;
 
     /* setup subfile */
     new_streamFile = open_wrap_streamfile(streamFile);
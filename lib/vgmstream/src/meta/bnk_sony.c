@@ -1,5 +1,6 @@
 #include "meta.h"
 #include "../coding/coding.h"
+#include "bank_index.h"
 
 typedef enum { PSX, PCM16, ATRAC9, HEVAG } bnk_codec;
 
@@ -20,6 +21,10 @@ VGMSTREAM* init_vgmstream_bnk_sony(STREAMFILE* sf) {
     int16_t (*read_16bit)(off_t,STREAMFILE*) = NULL;
     float (*read_f32)(off_t,STREAMFILE*) = NULL;
     bnk_codec codec;
+    bank_index* index = NULL;
+    bank_entry_t entry = {0};
+    char stream_name[STREAM_NAME_SIZE];
+    int has_stream_name = 0;
 
 
     /* checks */
@@ -145,57 +150,78 @@ VGMSTREAM* init_vgmstream_bnk_sony(STREAMFILE* sf) {
          * - find if one section points to the selected material, and get section name = stream name */
 
         /* parse materials */
-        total_subsongs = 0;
         if (target_subsong == 0) target_subsong = 1;
 
-        switch(sblk_version) {
-            case 0x01:
-                /* table2/3 has size 0x28 entries, seemingly:
-                 * 0x00: subtype(01=sound)
-                 * 0x08: same as other versions (pitch, flags, offset...)
-                 * rest: padding
-                 * 0x18: stream offset
-                 * there is no stream size like in v0x03
-                 */
-
-                for (i = 0; i < material_entries; i++) {
-                    uint8_t table2_type = read_32bit(table2_offset + (i*0x28) + 0x00, sf);
-
-                    if (table2_type != 0x01)
-                        continue;
-
-                    total_subsongs++;
-                    if (total_subsongs == target_subsong) {
-                        table2_entry_offset = 0;
-                        table3_entry_offset = (i*0x28) + 0x08;
-                        /* continue to count all subsongs*/
+        /* known banks go straight to the target */
+        total_subsongs = bank_index_get(sf, 0x6B6C4253, target_subsong, &entry);
+        if (total_subsongs) {
+            table2_entry_offset = entry.index;
+            table3_entry_offset = entry.offset;
+        }
+        else {
+            index = bank_index_new(sf, 0x6B6C4253);
+
+            switch(sblk_version) {
+                case 0x01:
+                    /* table2/3 has size 0x28 entries, seemingly:
+                     * 0x00: subtype(01=sound)
+                     * 0x08: same as other versions (pitch, flags, offset...)
+                     * rest: padding
+                     * 0x18: stream offset
+                     * there is no stream size like in v0x03
+                     */
+
+                    for (i = 0; i < material_entries; i++) {
+                        uint8_t table2_type = read_32bit(table2_offset + (i*0x28) + 0x00, sf);
+
+                        if (table2_type != 0x01)
+                            continue;
+
+                        entry.index = 0;
+                        entry.offset = (i*0x28) + 0x08;
+                        if (!bank_index_add(index, &entry))
+                            goto fail;
+
+                        total_subsongs++;
+                        if (total_subsongs == target_subsong) {
+                            table2_entry_offset = 0;
+                            table3_entry_offset = (i*0x28) + 0x08;
+                            /* continue to count all subsongs*/
+                        }
+
                     }
 
-                }
+                    break;
 
-                break;
+                default:
+                    for (i = 0; i < material_entries; i++) {
+                        uint32_t table2_value, table2_subinfo, table2_subtype;
 
-            default:
-                for (i = 0; i < material_entries; i++) {
-                    uint32_t table2_value, table2_subinfo, table2_subtype;
-
-                    table2_value = (uint32_t)read_32bit(table2_offset+(i*0x08)+table2_suboffset+0x00,sf);
-                    table2_subinfo = (table2_value >>  0) & 0xFFFF;
-                    table2_subtype = (table2_value >> 16) & 0xFFFF;
-                    if (table2_subtype != 0x100)
-                        continue; /* not sounds */
-
-                    total_subsongs++;
-                    if (total_subsongs == target_subsong) {
-                        table2_entry_offset = (i*0x08);
-                        table3_entry_offset = table2_subinfo;
-                        /* continue to count all subsongs*/
+                        table2_value = (uint32_t)read_32bit(table2_offset+(i*0x08)+table2_suboffset+0x00,sf);
+                        table2_subinfo = (table2_value >>  0) & 0xFFFF;
+                        table2_subtype = (table2_value >> 16) & 0xFFFF;
+                        if (table2_subtype != 0x100)
+                            continue; /* not sounds */
+
+                        entry.index = (i*0x08);
+                        entry.offset = table2_subinfo;
+                        if (!bank_index_add(index, &entry))
+                            goto fail;
+
+                        total_subsongs++;
+                        if (total_subsongs == target_subsong) {
+                            table2_entry_offset = (i*0x08);
+                            table3_entry_offset = table2_subinfo;
+                            /* continue to count all subsongs*/
+                        }
                     }
-                }
 
-                break;
-        }
+                    break;
+            }
 
+            bank_index_put(index);
+            index = NULL;
+        }
 
         //;VGM_LOG("BNK: subsongs %i, table2_entry=%lx, table3_entry=%lx\n", total_subsongs,table2_entry_offset,table3_entry_offset);
 
@@ -260,47 +286,50 @@ VGMSTREAM* init_vgmstream_bnk_sony(STREAMFILE* sf) {
 
         //;VGM_LOG("BNK: stream at %lx + %x\n", stream_offset, stream_size);
 
-        /* parse names */
-        switch(sblk_version) {
-          //case 0x03: /* different format? */
-          //case 0x04: /* different format? */
-            case 0x09:
-            case 0x0d:
-            case 0x0e:
-                /* find if this sound has an assigned name in table1 */
-                for (i = 0; i < section_entries; i++) {
-                    off_t entry_offset = (uint16_t)read_16bit(table1_offset+(i*table1_entry_size)+table1_suboffset+0x00,sf);
-
-                    /* rarely (ex. Polara sfx) one name applies to multiple materials,
-                     * from current entry_offset to next entry_offset (section offsets should be in order) */
-                    if (entry_offset <= table2_entry_offset ) {
-                        table4_entry_id = i;
-                        //break;
+        /* parse names (once per subsong if indexed) */
+        has_stream_name = bank_index_get_name(sf, 0x6B6C4253, target_subsong, stream_name, sizeof(stream_name));
+        if (!has_stream_name) {
+            switch(sblk_version) {
+              //case 0x03: /* different format? */
+              //case 0x04: /* different format? */
+                case 0x09:
+                case 0x0d:
+                case 0x0e:
+                    /* find if this sound has an assigned name in table1 */
+                    for (i = 0; i < section_entries; i++) {
+                        off_t entry_offset = (uint16_t)read_16bit(table1_offset+(i*table1_entry_size)+table1_suboffset+0x00,sf);
+
+                        /* rarely (ex. Polara sfx) one name applies to multiple materials,
+                         * from current entry_offset to next entry_offset (section offsets should be in order) */
+                        if (entry_offset <= table2_entry_offset ) {
+                            table4_entry_id = i;
+                            //break;
+                        }
                     }
-                }
 
-                /* table4: */
-                /* 0x00: bank name (optional) */
-                /* 0x08: header size */
-                /* 0x0c: table4 size */
-                /* variable: entries */
-                /* variable: names (null terminated) */
-                table4_entries_offset = table4_offset + read_32bit(table4_offset+0x08, sf);
-                table4_names_offset = table4_entries_offset + (0x10*section_entries);
-                //;VGM_LOG("BNK: t4_entries=%lx, t4_names=%lx\n", table4_entries_offset, table4_names_offset);
-
-                /* get assigned name from table4 names */
-                for (i = 0; i < section_entries; i++) {
-                    int entry_id = read_32bit(table4_entries_offset+(i*0x10)+0x0c, sf);
-                    if (entry_id == table4_entry_id) {
-                        name_offset = table4_names_offset + read_32bit(table4_entries_offset+(i*0x10)+0x00, sf);
-                        break;
+                    /* table4: */
+                    /* 0x00: bank name (optional) */
+                    /* 0x08: header size */
+                    /* 0x0c: table4 size */
+                    /* variable: entries */
+                    /* variable: names (null terminated) */
+                    table4_entries_offset = table4_offset + read_32bit(table4_offset+0x08, sf);
+                    table4_names_offset = table4_entries_offset + (0x10*section_entries);
+                    //;VGM_LOG("BNK: t4_entries=%lx, t4_names=%lx\n", table4_entries_offset, table4_names_offset);
+
+                    /* get assigned name from table4 names */
+                    for (i = 0; i < section_entries; i++) {
+                        int entry_id = read_32bit(table4_entries_offset+(i*0x10)+0x0c, sf);
+                        if (entry_id == table4_entry_id) {
+                            name_offset = table4_names_offset + read_32bit(table4_entries_offset+(i*0x10)+0x00, sf);
+                            break;
+                        }
                     }
-                }
 
-                break;
-            default:
-                break;
+                    break;
+                default:
+                    break;
+            }
         }
 
         //;VGM_LOG("BNK: stream_offset=%lx, stream_size=%x, name_offset=%lx\n", stream_offset, stream_size, name_offset);
@@ -526,14 +555,21 @@ VGMSTREAM* init_vgmstream_bnk_sony(STREAMFILE* sf) {
             goto fail;
     }
 
-    if (name_offset)
-        read_string(vgmstream->stream_name,STREAM_NAME_SIZE, name_offset,sf);
+    if (has_stream_name) {
+        strcpy(vgmstream->stream_name, stream_name);
+    }
+    else {
+        if (name_offset)
+            read_string(vgmstream->stream_name,STREAM_NAME_SIZE, name_offset,sf);
+        bank_index_set_name(sf, 0x6B6C4253, target_subsong, vgmstream->stream_name);
+    }
 
 
     if (!vgmstream_open_stream(vgmstream, sf, start_offset))
         goto fail;
     return vgmstream;
 fail:
+    bank_index_free(index);
     close_vgmstream(vgmstream);
     return NULL;
 }
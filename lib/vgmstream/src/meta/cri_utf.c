@@ -71,7 +71,9 @@ struct utf_context {
         uint8_t flag;
         uint8_t type;
         const char *name;
+        uint32_t hash;      /* of name, to find columns without comparing every name */
         uint32_t offset;
+        uint32_t size;
     } *schema;
 
     /* derived */
@@ -79,8 +81,17 @@ struct utf_context {
     uint32_t strings_size;
     char *string_table;
     const char *table_name;
+    uint8_t *table;         /* header, schema and rows (up to strings), NULL if not loaded */
 };
 
+static uint32_t utf_hash(const char* name) {
+    uint32_t hash = 0x811C9DC5; /* FNV-1a */
+    while (*name) {
+        hash = (hash ^ (uint8_t)*name++) * 0x01000193;
+    }
+    return hash;
+}
+
 
 /* @UTF table context creation */
 utf_context* utf_open(STREAMFILE* sf, uint32_t table_offset, int* p_rows, const char** p_row_name) {
@@ -140,6 +151,16 @@ utf_context* utf_open(STREAMFILE* sf, uint32_t table_offset, int* p_rows, const
     }
 
 
+    /* load schema and rows, so queries read values from memory (if rows are where they should be) */
+    if ((uint64_t)utf->rows_offset + (uint64_t)utf->rows * utf->row_width <= utf->strings_offset) {
+        utf->table = malloc(utf->strings_offset);
+        if (utf->table && read_streamfile(utf->table, utf->table_offset, utf->strings_offset, sf) != utf->strings_offset) {
+            free(utf->table);
+            utf->table = NULL;
+        }
+    }
+
+
     /* load column schema */
     {
         int i;
@@ -161,6 +182,7 @@ utf_context* utf_open(STREAMFILE* sf, uint32_t table_offset, int* p_rows, const
             utf->schema[i].flag = info & COLUMN_BITMASK_FLAG;
             utf->schema[i].type = info & COLUMN_BITMASK_TYPE;
             utf->schema[i].name = NULL;
+            utf->schema[i].hash = 0;
             utf->schema[i].offset = 0;
 
             /* known flags are name+default or name+row, but name+default+row is mentioned in VGMToolbox
@@ -201,8 +223,11 @@ utf_context* utf_open(STREAMFILE* sf, uint32_t table_offset, int* p_rows, const
                     goto fail;
             }
 
+            utf->schema[i].size = value_size;
+
             if (utf->schema[i].flag & COLUMN_FLAG_NAME) {
                 utf->schema[i].name = utf->string_table + name_offset;
+                utf->schema[i].hash = utf_hash(utf->schema[i].name);
             }
 
             if (utf->schema[i].flag & COLUMN_FLAG_DEFAULT) {
@@ -237,11 +262,13 @@ void utf_close(utf_context* utf) {
 
     free(utf->string_table);
     free(utf->schema);
+    free(utf->table);
     free(utf);
 }
 
 
 static int utf_query(utf_context* utf, int row, const char* column, utf_result_t* result) {
+    uint32_t hash = utf_hash(column);
     int i;
 
 
@@ -254,67 +281,75 @@ static int utf_query(utf_context* utf, int row, const char* column, utf_result_t
     for (i = 0; i < utf->columns; i++) {
         struct utf_column_t *col = &utf->schema[i];
         uint32_t data_offset;
+        uint8_t buf[0x08];
+        const uint8_t *p;
 
-        if (col->name == NULL || strcmp(col->name, column) != 0)
+        if (col->name == NULL || col->hash != hash || strcmp(col->name, column) != 0)
             continue;
 
         result->found = 1;
         result->type = col->type;
 
         if (col->flag & COLUMN_FLAG_DEFAULT) {
-            data_offset = utf->table_offset + utf->schema_offset + col->offset;
+            data_offset = utf->schema_offset + col->offset;
         }
         else if (col->flag & COLUMN_FLAG_ROW) {
-            data_offset = utf->table_offset + utf->rows_offset + row * utf->row_width + col->offset;
+            data_offset = utf->rows_offset + row * utf->row_width + col->offset;
         }
-        else {
-            data_offset = 0;
-        }
-
-        /* ignore zero value */
-        if (data_offset == 0) {
+        else { /* ignore zero value */
             memset(&result->value, 0, sizeof(result->value)); /* just in case... */
             break;
         }
 
-        /* read row/constant value */
+        /* row/constant value, from the loaded table or the file */
+        if (utf->table) {
+            if (data_offset + col->size > utf->strings_offset)
+                goto fail;
+            p = utf->table + data_offset;
+        }
+        else {
+            if (read_streamfile(buf, utf->table_offset + data_offset, col->size, utf->sf) != col->size)
+                goto fail;
+            p = buf;
+        }
+
         switch (col->type) {
             case COLUMN_TYPE_UINT8:
-                result->value.value_u8 = read_u8(data_offset, utf->sf);
+                result->value.value_u8 = get_u8(p);
                 break;
             case COLUMN_TYPE_SINT8:
-                result->value.value_s8 = read_s8(data_offset, utf->sf);
+                result->value.value_s8 = get_s8(p);
                 break;
             case COLUMN_TYPE_UINT16:
-                result->value.value_u16 = read_u16be(data_offset, utf->sf);
+                result->value.value_u16 = get_u16be(p);
                 break;
             case COLUMN_TYPE_SINT16:
-                result->value.value_s16 = read_s16be(data_offset, utf->sf);
+                result->value.value_s16 = get_s16be(p);
                 break;
             case COLUMN_TYPE_UINT32:
-                result->value.value_u32 = read_u32be(data_offset, utf->sf);
+                result->value.value_u32 = get_u32be(p);
                 break;
             case COLUMN_TYPE_SINT32:
-                result->value.value_s32 = read_s32be(data_offset, utf->sf);
+                result->value.value_s32 = get_s32be(p);
                 break;
             case COLUMN_TYPE_UINT64:
-                result->value.value_u64 = read_u64be(data_offset, utf->sf);
+                result->value.value_u64 = (uint64_t)get_64bitBE(p);
                 break;
             case COLUMN_TYPE_SINT64:
-                result->value.value_s64 = read_s64be(data_offset, utf->sf);
+                result->value.value_s64 = get_64bitBE(p);
                 break;
             case COLUMN_TYPE_FLOAT: {
-                result->value.value_float = read_f32be(data_offset, utf->sf);
-                break;
-            }
-#if 0
-            case COLUMN_TYPE_DOUBLE: {
-                result->value.value_double = read_d64be(data_offset, utf->sf);
+                union {
+                    uint32_t u32;
+                    float f32;
+                } temp;
+                temp.u32 = get_u32be(p);
+                result->value.value_float = temp.f32;
                 break;
             }
-#endif
             case COLUMN_TYPE_STRING: {
-                uint32_t name_offset = read_u32be(data_offset, utf->sf);
+                /* points into the string table, valid until utf_close */
+                uint32_t name_offset = get_u32be(p);
                 if (name_offset > utf->strings_size)
                     goto fail;
                 result->value.value_string = utf->string_table + name_offset;
@@ -322,16 +357,9 @@ static int utf_query(utf_context* utf, int row, const char* column, utf_result_t
             }
 
             case COLUMN_TYPE_VLDATA:
-                result->value.value_data.offset = read_u32be(data_offset + 0x00, utf->sf);
-                result->value.value_data.size   = read_u32be(data_offset + 0x04, utf->sf);
+                result->value.value_data.offset = get_u32be(p + 0x00);
+                result->value.value_data.size   = get_u32be(p + 0x04);
                 break;
-#if 0
-            case COLUMN_TYPE_UINT128: {
-                result->value.value_u128.hi = read_u64be(data_offset + 0x00, utf->sf);
-                result->value.value_u128.lo = read_u64be(data_offset + 0x08, utf->sf);
-                break;
-            }
-#endif
             default:
                 goto fail;
         }
@@ -20,10 +20,11 @@
 /* opaque struct */
 typedef struct utf_context utf_context;
 
-/* open a CRI UTF table at offset, returning table name and rows. Passed streamfile is used internally for next calls */
+/* open a CRI UTF table at offset, returning table name and rows. Passed streamfile is used internally for next calls
+ * (tables are loaded to memory when possible, so queries don't read the streamfile) */
 utf_context* utf_open(STREAMFILE* sf, uint32_t table_offset, int* p_rows, const char** p_row_name);
 void utf_close(utf_context* utf);
-/* query calls */
+/* query calls (strings point into the table, valid until utf_close) */
 int utf_query_u8(utf_context* utf, int row, const char* column, uint8_t* value);
 int utf_query_u16(utf_context* utf, int row, const char* column, uint16_t* value);
 int utf_query_u32(utf_context* utf, int row, const char* column, uint32_t* value);
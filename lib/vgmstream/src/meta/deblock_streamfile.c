@@ -2,6 +2,9 @@
 
 //todo move to utils or something
 
+#define DEBLOCK_INDEX_INTERVAL  8   /* blocks between index entries */
+#define DEBLOCK_LAZY_SAMPLE     0x40000 /* logical data walked to estimate lazy sizes */
+
 static void block_callback_default(STREAMFILE* sf, deblock_io_data* data) {
     data->block_size = data->cfg.chunk_size;
     data->skip_size = data->cfg.skip_size;
@@ -10,6 +13,64 @@ static void block_callback_default(STREAMFILE* sf, deblock_io_data* data) {
     //;VGM_LOG("DEBLOCK: of=%lx, bs=%lx, ss=%lx, ds=%lx\n", data->physical_offset, data->block_size, data->skip_size, data->data_size);
 }
 
+/* adds current block start to the index (called on block boundaries only) */
+static void deblock_index_add(deblock_io_data* data) {
+    deblock_index_t* entry;
+
+    data->index_blocks++;
+    if (data->index_blocks < DEBLOCK_INDEX_INTERVAL)
+        return;
+    data->index_blocks = 0;
+
+    /* only forward (keeps index sorted) */
+    if (data->index_count > 0 && data->index[data->index_count - 1].physical_offset >= data->physical_offset)
+        return;
+
+    if (data->index_count >= data->index_max) {
+        int new_max = data->index_max ? data->index_max * 2 : 0x100;
+        deblock_index_t* new_index = realloc(data->index, new_max * sizeof(deblock_index_t));
+        if (!new_index) return; /* not fatal, reads just walk from an earlier block */
+        data->index = new_index;
+        data->index_max = new_max;
+    }
+
+    entry = &data->index[data->index_count];
+    entry->logical_offset = data->logical_offset;
+    entry->physical_offset = data->physical_offset;
+    data->index_count++;
+}
+
+/* finds last indexed block that starts at or before offset */
+static deblock_index_t* deblock_index_find(deblock_io_data* data, off_t offset) {
+    int lo = 0, hi = data->index_count - 1;
+    deblock_index_t* found = NULL;
+
+    while (lo <= hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (data->index[mid].logical_offset <= offset) {
+            found = &data->index[mid];
+            lo = mid + 1;
+        }
+        else {
+            hi = mid - 1;
+        }
+    }
+
+    return found;
+}
+
+/* remembers the furthest block boundary, and the exact size once the walk reaches stream end */
+static void deblock_known_add(deblock_io_data* data) {
+    if (data->physical_offset <= data->known_physical)
+        return;
+
+    data->known_physical = data->physical_offset;
+    data->known_logical = data->logical_offset;
+
+    if (data->cfg.lazy_size && !data->logical_size && data->physical_offset >= data->physical_end)
+        data->logical_size = data->logical_offset;
+}
+
 static size_t deblock_io_read(STREAMFILE* sf, uint8_t* dest, off_t offset, size_t length, deblock_io_data* data) {
     size_t total_read = 0;
 
@@ -28,6 +89,21 @@ static size_t deblock_io_read(STREAMFILE* sf, uint8_t* dest, off_t offset, size_
         //data->read_count = data->cfg.read_count;
     }
 
+    /* skip ahead to the closest known block (entries are block starts after a block of this stream) */
+    if (offset >= data->logical_offset + data->data_size) {
+        deblock_index_t* entry = deblock_index_find(data, offset);
+        if (entry && entry->physical_offset > data->physical_offset) {
+            data->physical_offset = entry->physical_offset;
+            data->logical_offset = entry->logical_offset;
+            data->block_size = 0;
+            data->data_size = 0;
+            data->skip_size = 0;
+
+            data->step_count = data->cfg.step_count;
+            data->index_blocks = 0;
+        }
+    }
+
     /* read blocks */
     while (length > 0) {
 
@@ -80,6 +156,8 @@ static size_t deblock_io_read(STREAMFILE* sf, uint8_t* dest, off_t offset, size_
             data->data_size = 0;
 
             data->step_count = data->cfg.step_count;
+            deblock_index_add(data);
+            deblock_known_add(data);
             //VGM_LOG("ignore at %lx + %lx, skips=%i\n", data->physical_offset, data->block_size, data->step_count);
             continue;
         }
@@ -125,6 +203,23 @@ static size_t deblock_io_size(STREAMFILE* sf, deblock_io_data* data) {
         return data->logical_size;
     }
 
+    if (data->cfg.lazy_size) {
+        off_t known_physical;
+
+        /* walk a few blocks if nothing was read yet */
+        if (data->known_logical < DEBLOCK_LAZY_SAMPLE)
+            deblock_io_read(sf, buf, DEBLOCK_LAZY_SAMPLE, 1, data);
+        if (data->logical_size) /* small file, whole thing was walked */
+            return data->logical_size;
+
+        /* data seen so far plus the rest as if it had no block headers, so it's never smaller than the
+         * real size (callers clamping reads to it are fine) and shrinks towards it as more blocks are read */
+        known_physical = data->known_physical - data->cfg.stream_start;
+        if (known_physical <= 0)
+            return 0;
+        return data->known_logical + (data->physical_size - known_physical);
+    }
+
     /* force a fake read at max offset, to get max logical_offset (will be reset next read) */
     deblock_io_read(sf, buf, 0x7FFFFFFF, 1, data);
     data->logical_size = data->logical_offset;
@@ -139,6 +234,28 @@ static size_t deblock_io_size(STREAMFILE* sf, deblock_io_data* data) {
     return data->logical_size;
 }
 
+/* reopened streamfiles get a copy of the state, so index must be duplicated */
+static int deblock_io_init(STREAMFILE* sf, deblock_io_data* data) {
+    deblock_index_t* index = data->index;
+
+    if (!index)
+        return 0;
+
+    data->index = malloc(data->index_max * sizeof(deblock_index_t));
+    if (!data->index) {
+        data->index_count = 0;
+        data->index_max = 0;
+        return 0; /* rebuilt as needed */
+    }
+    memcpy(data->index, index, data->index_count * sizeof(deblock_index_t));
+    return 0;
+}
+
+static void deblock_io_close(STREAMFILE* sf, deblock_io_data* data) {
+    free(data->index);
+    data->index = NULL;
+}
+
 /* generic "de-blocker" helper for streams divided in blocks that have weird interleaves, their
  * decoder can't easily use blocked layout, or some other weird feature. It "filters" data so
  * reader only sees clean data without blocks. Must pass setup config and a callback that sets
@@ -171,11 +288,12 @@ STREAMFILE* open_io_deblock_streamfile_f(STREAMFILE* sf, deblock_config_t *cfg)
     io_data.physical_end = io_data.cfg.stream_start + io_data.physical_size;
 
     io_data.logical_offset = -1; /* read reset */
+    io_data.known_physical = io_data.cfg.stream_start;
 
     //TODO: other validations
 
     /* setup subfile */
-    new_sf = open_io_streamfile_f(sf, &io_data, sizeof(deblock_io_data), deblock_io_read, deblock_io_size);
+    new_sf = open_io_streamfile_ex_f(sf, &io_data, sizeof(deblock_io_data), deblock_io_read, deblock_io_size, deblock_io_init, deblock_io_close);
     return new_sf;
 fail:
     VGM_LOG("DEBLOCK: bad init\n");
@@ -4,10 +4,13 @@
 
 typedef struct deblock_config_t deblock_config_t;
 typedef struct deblock_io_data deblock_io_data;
+typedef struct deblock_index_t deblock_index_t;
 
 struct deblock_config_t {
     /* config (all optional) */
     size_t logical_size;    /* pre-calculated size for performance (otherwise has to read the whole thing) */
+    int lazy_size;          /* if no logical_size: report an upper bound from the first blocks, refined as blocks are
+                             * read (for parsers that only need an approximate size at open, not for sample counts) */
     off_t stream_start;     /* data start */
     size_t stream_size;     /* data max */
 
@@ -39,6 +42,12 @@ struct deblock_config_t {
     void (*read_callback)(uint8_t* dst, deblock_io_data* data, size_t block_pos, size_t read_size);
 } ;
 
+/* known block start, to resume reads without walking blocks from stream start */
+struct deblock_index_t {
+    off_t logical_offset;
+    off_t physical_offset;
+};
+
 struct deblock_io_data {
     /* initial config */
     deblock_config_t cfg;
@@ -56,6 +65,16 @@ struct deblock_io_data {
     size_t logical_size;
     size_t physical_size;
     off_t physical_end;
+
+    /* sparse block index, filled as blocks are read (one entry every N blocks, sorted) */
+    deblock_index_t* index;
+    int index_count;
+    int index_max;
+    int index_blocks;       /* blocks since last entry */
+
+    /* furthest block boundary seen, for lazy sizes */
+    off_t known_logical;
+    off_t known_physical;
 };
 
 STREAMFILE* open_io_deblock_streamfile_f(STREAMFILE* sf, deblock_config_t* cfg);
@@ -562,17 +562,19 @@ static STREAMFILE *open_mapfile_pair(STREAMFILE* sf, int track, int num_tracks)
         }
 
         strncpy(buf, mus_name, PATH_LIMIT - 1);
-        pch = strtok(buf, ","); //TODO: not thread safe in std C
+        pch = buf; /* find Nth name manually as strtok isn't thread safe */
         for (j = 0; j < track && pch; j++) {
-            pch = strtok(NULL, ",");
+            pch = strchr(pch, ',');
+            if (pch) pch++;
         }
         if (!pch) continue; /* invalid track */
+        pch[strcspn(pch, ",")] = '\0';
 
         if (use_mask) {
             file_name[file_len - map_len] = '\0';
             strncat(file_name, pch + 1, PATH_LIMIT - 1);
         } else {
-            strncpy(file_name, pch, PATH_LIMIT - 1);
+            snprintf(file_name, PATH_LIMIT, "%s", pch);
         }
 
         musFile = open_streamfile_by_filename(sf, file_name);
@@ -261,7 +261,7 @@ static STREAMFILE* setup_eaac_audio_streamfile(STREAMFILE *sf, int version, int
     /* setup subfile */
     new_sf = open_wrap_streamfile(sf);
     new_sf = open_io_streamfile_f(new_sf, &io_data, sizeof(eaac_io_data), eaac_io_read, eaac_io_size);
-    new_sf = open_buffer_streamfile_f(new_sf, 0); /* EA-XMA and multichannel EALayer3 benefit from this */
+    new_sf = open_buffer_streamfile_adaptive_f(new_sf); /* EA-XMA and multichannel EALayer3 benefit from this */
     if (codec == 0x0c && stream_count > 1) /* multichannel opus */
         new_sf = open_io_eaac_opus_streamfile_f(new_sf, stream_number, stream_count);
     return new_sf;
@@ -2,6 +2,7 @@
 #include "../layout/layout.h"
 #include "../coding/coding.h"
 #include "ea_schl_streamfile.h"
+#include "bank_index.h"
 
 /* header version */
 #define EA_VERSION_NONE         -1
@@ -112,7 +113,7 @@ typedef struct {
 static VGMSTREAM * parse_schl_block(STREAMFILE* sf, off_t offset, int standalone);
 static VGMSTREAM * parse_bnk_header(STREAMFILE* sf, off_t offset, int target_stream, int is_embedded);
 static int parse_variable_header(STREAMFILE* sf, ea_header* ea, off_t begin_offset, int max_length, int bnk_version);
-static uint32_t read_patch(STREAMFILE* sf, off_t* offset);
+static uint32_t read_patch(sf_reader* r, off_t* offset);
 static off_t get_ea_stream_mpeg_start_offset(STREAMFILE* sf, off_t start_offset, const ea_header* ea);
 static VGMSTREAM * init_vgmstream_ea_variable_header(STREAMFILE* sf, ea_header* ea, off_t start_offset, int is_bnk, int standalone);
 static void update_ea_stream_size_and_samples(STREAMFILE* sf, off_t start_offset, VGMSTREAM* vgmstream, int standalone);
@@ -295,6 +296,8 @@ VGMSTREAM * init_vgmstream_ea_abk(STREAMFILE* sf) {
     STREAMFILE * astData = NULL;
     VGMSTREAM * vgmstream = NULL;
     segmented_layout_data *data_s = NULL;
+    bank_index* index = NULL;
+    bank_entry_t entry = {0};
     int32_t(*read_32bit)(off_t, STREAMFILE*);
     int16_t(*read_16bit)(off_t, STREAMFILE*);
 
@@ -330,6 +333,16 @@ VGMSTREAM * init_vgmstream_ea_abk(STREAMFILE* sf) {
         read_32bitBE(bnk_offset, sf) != EA_BNK_HEADER_BE)
         goto fail;
 
+    /* known banks go straight to the target's sound entry (the whole walk is needed to count them) */
+    total_sounds = bank_index_get(sf, 0x41424B43, target_stream, &entry);
+    if (total_sounds) {
+        target_entry_offset = entry.offset;
+        num_tables = 0;
+    }
+    else {
+        index = bank_index_new(sf, 0x41424B43);
+    }
+
     for (i = 0; i < num_tables; i++) {
         num_entries = read_8bit(header_table_offset + 0x24, sf);
         base_offset = read_32bit(header_table_offset + 0x2C, sf);
@@ -363,6 +376,10 @@ VGMSTREAM * init_vgmstream_ea_abk(STREAMFILE* sf) {
                 if (sound_type == 0x00 && read_32bit(entry_offset + 0x04, sf) == 0)
                     continue;
 
+                entry.offset = entry_offset;
+                if (!bank_index_add(index, &entry))
+                    goto fail;
+
                 total_sounds++;
                 if (target_stream == total_sounds)
                     target_entry_offset = entry_offset;
@@ -374,6 +391,9 @@ VGMSTREAM * init_vgmstream_ea_abk(STREAMFILE* sf) {
         header_table_offset += 0x3C + num_entries * 0x04;
     }
 
+    bank_index_put(index);
+    index = NULL;
+
     if (target_entry_offset == 0)
         goto fail;
 
@@ -465,6 +485,7 @@ VGMSTREAM * init_vgmstream_ea_abk(STREAMFILE* sf) {
 fail:
     close_streamfile(astData);
     free_layout_segmented(data_s);
+    bank_index_free(index);
     return NULL;
 }
 
@@ -690,17 +711,19 @@ static STREAMFILE* open_mapfile_pair(STREAMFILE* sf, int track, int num_tracks)
         }
 
         strncpy(buf, mus_name, PATH_LIMIT - 1);
-        pch = strtok(buf, ","); //TODO: not thread safe in std C
+        pch = buf; /* find Nth name manually as strtok isn't thread safe */
         for (j = 0; j < track && pch; j++) {
-            pch = strtok(NULL, ",");
+            pch = strchr(pch, ',');
+            if (pch) pch++;
         }
         if (!pch) continue; /* invalid track */
+        pch[strcspn(pch, ",")] = '\0';
 
         if (use_mask) {
             file_name[file_len - map_len] = '\0';
             strncat(file_name, pch + 1, PATH_LIMIT - 1);
         } else {
-            strncpy(file_name, pch, PATH_LIMIT - 1);
+            snprintf(file_name, PATH_LIMIT, "%s", pch);
         }
 
         sf_mus = open_streamfile_by_filename(sf, file_name);
@@ -1036,6 +1059,8 @@ static VGMSTREAM * parse_bnk_header(STREAMFILE* sf, off_t offset, int target_str
     int32_t(*read_32bit)(off_t, STREAMFILE*) = NULL;
     int16_t(*read_16bit)(off_t, STREAMFILE*) = NULL;
     VGMSTREAM *vgmstream = NULL;
+    bank_index* index = NULL;
+    bank_entry_t entry = {0};
     int bnk_version;
     int real_bnk_sounds = 0;
 
@@ -1082,17 +1107,33 @@ static VGMSTREAM * parse_bnk_header(STREAMFILE* sf, off_t offset, int target_str
         entry_offset = offset + table_offset + 0x04 * target_stream;
         header_offset = entry_offset + read_32bit(entry_offset, sf);
     } else {
-        /* some of these are dummies with zero offset, skip them when opening standalone BNK */
-        for (i = 0; i < num_sounds; i++) {
-            entry_offset = offset + table_offset + 0x04 * i;
-            test_offset = read_32bit(entry_offset, sf);
+        /* known banks go straight to the target */
+        real_bnk_sounds = bank_index_get(sf, EA_BNK_HEADER_LE, target_stream + 1, &entry);
+        if (real_bnk_sounds) {
+            header_offset = entry.offset;
+        }
+        else {
+            index = bank_index_new(sf, EA_BNK_HEADER_LE);
+
+            /* some of these are dummies with zero offset, skip them when opening standalone BNK */
+            for (i = 0; i < num_sounds; i++) {
+                entry_offset = offset + table_offset + 0x04 * i;
+                test_offset = read_32bit(entry_offset, sf);
+
+                if (test_offset != 0) {
+                    entry.offset = entry_offset + test_offset;
+                    if (!bank_index_add(index, &entry))
+                        goto fail;
 
-            if (test_offset != 0) {
-                if (target_stream == real_bnk_sounds)
-                    header_offset = entry_offset + test_offset;
+                    if (target_stream == real_bnk_sounds)
+                        header_offset = entry_offset + test_offset;
 
-                real_bnk_sounds++;
+                    real_bnk_sounds++;
+                }
             }
+
+            bank_index_put(index);
+            index = NULL;
         }
     }
 
@@ -1120,6 +1161,7 @@ static VGMSTREAM * parse_bnk_header(STREAMFILE* sf, off_t offset, int target_str
     return vgmstream;
 
 fail:
+    bank_index_free(index);
     return NULL;
 }
 
@@ -1382,13 +1424,13 @@ fail:
 }
 
 
-static uint32_t read_patch(STREAMFILE* sf, off_t* offset) {
+static uint32_t read_patch(sf_reader* r, off_t* offset) {
     uint32_t result = 0;
-    uint8_t byte_count = read_8bit(*offset, sf);
+    uint8_t byte_count = sf_reader_s8(r, *offset);
     (*offset)++;
 
     if (byte_count == 0xFF) { /* signals 32b size (ex. custom user data) */
-        (*offset) += 4 + read_32bitBE(*offset, sf);
+        (*offset) += 4 + sf_reader_s32be(r, *offset);
         return 0;
     }
 
@@ -1399,7 +1441,7 @@ static uint32_t read_patch(STREAMFILE* sf, off_t* offset) {
 
     for ( ; byte_count > 0; byte_count--) { /* count of 0 is also possible, means value 0 */
         result <<= 8;
-        result += (uint8_t)read_8bit(*offset, sf);
+        result += (uint8_t)sf_reader_s8(r, *offset);
         (*offset)++;
     }
 
@@ -1412,6 +1454,10 @@ static int parse_variable_header(STREAMFILE* sf, ea_header* ea, off_t begin_offs
     uint32_t platform_id;
     int is_header_end = 0;
     int is_bnk = bnk_version;
+    sf_reader r;
+
+    /* lots of 1-4 byte patches, read them from a window instead of one by one */
+    sf_reader_init(&r, sf);
 
     /* null defaults as 0 can be valid */
     ea->version = EA_VERSION_NONE;
@@ -1419,17 +1465,17 @@ static int parse_variable_header(STREAMFILE* sf, ea_header* ea, off_t begin_offs
     ea->codec2 = EA_CODEC2_NONE;
 
     /* get platform info */
-    platform_id = read_32bitBE(offset, sf);
+    platform_id = sf_reader_s32be(&r, offset);
     if (platform_id != 0x47535452 && (platform_id & 0xFFFF0000) != 0x50540000) {
         offset += 4; /* skip unknown field (related to blocks/size?) in "nbapsstream" (NBA2000 PS, FIFA2001 PS) */
-        platform_id = read_32bitBE(offset, sf);
+        platform_id = sf_reader_s32be(&r, offset);
     }
     if (platform_id == 0x47535452) { /* "GSTR" = Generic STReam */
         ea->platform = EA_PLATFORM_GENERIC;
         offset += 4 + 4; /* GSTRs have an extra field (config?): ex. 0x01000000, 0x010000D8 BE */
     }
     else if ((platform_id & 0xFFFF0000) == 0x50540000) { /* "PT" = PlaTform */
-        ea->platform = (uint16_t)read_16bitLE(offset + 2,sf);
+        ea->platform = (uint16_t)sf_reader_s16le(&r, offset + 2);
         offset += 4;
     }
     else {
@@ -1439,14 +1485,14 @@ static int parse_variable_header(STREAMFILE* sf, ea_header* ea, off_t begin_offs
 
     /* parse mini-chunks/tags (variable, ommited if default exists; some are removed in later versions of sx.exe) */
     while (!is_header_end && offset - begin_offset < max_length) {
-        uint8_t patch_type = read_8bit(offset,sf);
+        uint8_t patch_type = sf_reader_s8(&r, offset);
         offset++;
 
-        //;{ off_t test = offset; VGM_LOG("EA SCHl: patch=%02x at %lx, value=%x\n", patch_type, offset-1, read_patch(sf, &test)); }
+        //;{ off_t test = offset; VGM_LOG("EA SCHl: patch=%02x at %lx, value=%x\n", patch_type, offset-1, read_patch(&r, &test)); }
         switch(patch_type) {
             case 0x00: /* signals non-default block rate and maybe other stuff; or padding after 0xFF */
                 if (!is_header_end)
-                    read_patch(sf, &offset);
+                    read_patch(&r, &offset);
                 break;
 
             case 0x05: /* unknown (usually 0x50 except Madden NFL 3DS: 0x3e800) */
@@ -1478,7 +1524,7 @@ static int parse_variable_header(STREAMFILE* sf, ea_header* ea, off_t begin_offs
             case 0x23:
             case 0x24: /* master random detune range (BNK only) */
             case 0x25: /* unknown */
-                read_patch(sf, &offset);
+                read_patch(&r, &offset);
                 break;
 
             case 0xFC: /* padding for alignment between patches */
@@ -1486,104 +1532,104 @@ static int parse_variable_header(STREAMFILE* sf, ea_header* ea, off_t begin_offs
                 break;
 
             case 0x83: /* codec1 defines, used early revisions */
-                ea->codec1 = read_patch(sf, &offset);
+                ea->codec1 = read_patch(&r, &offset);
                 break;
             case 0xA0: /* codec2 defines */
-                ea->codec2 = read_patch(sf, &offset);
+                ea->codec2 = read_patch(&r, &offset);
                 break;
 
             case 0x80: /* version, affecting some codecs */
-                ea->version = read_patch(sf, &offset);
+                ea->version = read_patch(&r, &offset);
                 break;
             case 0x81: /* bits per sample for codec1 PCM */
-                ea->bps = read_patch(sf, &offset);
+                ea->bps = read_patch(&r, &offset);
                 break;
 
             case 0x82: /* channel count */
-                ea->channels = read_patch(sf, &offset);
+                ea->channels = read_patch(&r, &offset);
                 break;
             case 0x84: /* sample rate */
-                ea->sample_rate = read_patch(sf,&offset);
+                ea->sample_rate = read_patch(&r, &offset);
                 break;
 
             case 0x85: /* sample count */
-                ea->num_samples = read_patch(sf, &offset);
+                ea->num_samples = read_patch(&r, &offset);
                 break;
             case 0x86: /* loop start sample */
-                ea->loop_start = read_patch(sf, &offset);
+                ea->loop_start = read_patch(&r, &offset);
                 break;
             case 0x87: /* loop end sample */
-                ea->loop_end = read_patch(sf, &offset) + 1; /* sx.exe does +1 */
+                ea->loop_end = read_patch(&r, &offset) + 1; /* sx.exe does +1 */
                 break;
 
             /* channel offsets (BNK only), can be the equal for all channels or interleaved; not necessarily contiguous */
             case 0x88: /* absolute offset of ch1 (or ch1+ch2 for stereo EAXA) */
-                ea->offsets[0] = read_patch(sf, &offset);
+                ea->offsets[0] = read_patch(&r, &offset);
                 break;
             case 0x89: /* absolute offset of ch2 */
-                ea->offsets[1] = read_patch(sf, &offset);
+                ea->offsets[1] = read_patch(&r, &offset);
                 break;
             case 0x94: /* absolute offset of ch3 */
-                ea->offsets[2] = read_patch(sf, &offset);
+                ea->offsets[2] = read_patch(&r, &offset);
                 break;
             case 0x95: /* absolute offset of ch4 */
-                ea->offsets[3] = read_patch(sf, &offset);
+                ea->offsets[3] = read_patch(&r, &offset);
                 break;
             case 0xA2: /* absolute offset of ch5 */
-                ea->offsets[4] = read_patch(sf, &offset);
+                ea->offsets[4] = read_patch(&r, &offset);
                 break;
             case 0xA3: /* absolute offset of ch6 */
-                ea->offsets[5] = read_patch(sf, &offset);
+                ea->offsets[5] = read_patch(&r, &offset);
                 break;
 
             case 0x8F: /* DSP/N64BLK coefs ch1 */
                 ea->coefs[0] = offset+1;
-                read_patch(sf, &offset);
+                read_patch(&r, &offset);
                 break;
             case 0x90: /* DSP/N64BLK coefs ch2 */
                 ea->coefs[1] = offset+1;
-                read_patch(sf, &offset);
+                read_patch(&r, &offset);
                 break;
             case 0x91: /* DSP coefs ch3, and unknown in older versions */
                 ea->coefs[2] = offset+1;
-                read_patch(sf, &offset);
+                read_patch(&r, &offset);
                 break;
             case 0xAB: /* DSP coefs ch4 */
                 ea->coefs[3] = offset+1;
-                read_patch(sf, &offset);
+                read_patch(&r, &offset);
                 break;
             case 0xAC: /* DSP coefs ch5 */
                 ea->coefs[4] = offset+1;
-                read_patch(sf, &offset);
+                read_patch(&r, &offset);
                 break;
             case 0xAD: /* DSP coefs ch6 */
                 ea->coefs[5] = offset+1;
-                read_patch(sf, &offset);
+                read_patch(&r, &offset);
                 break;
 
             case 0x1A: /* EA-MT/EA-XA relative loop offset of ch1 */
-                ea->loops[0] = read_patch(sf, &offset);
+                ea->loops[0] = read_patch(&r, &offset);
                 break;
             case 0x26: /* EA-MT/EA-XA relative loop offset of ch2 */
-                ea->loops[1] = read_patch(sf, &offset);
+                ea->loops[1] = read_patch(&r, &offset);
                 break;
             case 0x27: /* EA-MT/EA-XA relative loop offset of ch3 */
-                ea->loops[2] = read_patch(sf, &offset);
+                ea->loops[2] = read_patch(&r, &offset);
                 break;
             case 0x28: /* EA-MT/EA-XA relative loop offset of ch4 */
-                ea->loops[3] = read_patch(sf, &offset);
+                ea->loops[3] = read_patch(&r, &offset);
                 break;
             case 0x29: /* EA-MT/EA-XA relative loop offset of ch5 */
-                ea->loops[4] = read_patch(sf, &offset);
+                ea->loops[4] = read_patch(&r, &offset);
                 break;
             case 0x2a: /* EA-MT/EA-XA relative loop offset of ch6 */
-                ea->loops[5] = read_patch(sf, &offset);
+                ea->loops[5] = read_patch(&r, &offset);
                 break;
 
             case 0x8C: /* flags (ex. play type = 01=static/02=dynamic | spatialize = 20=pan/etc) */
                        /* (ex. PS1 VAG=0, PS2 PCM/LAYER2=4, GC EAXA=4, 3DS DSP=512, Xbox EAXA=36, N64 BLK=05E800, N64 MT10=01588805E800) */
                 /* in rare cases value is the interleave, will be ignored if > 32b */
-                ea->flag_value = read_patch(sf, &offset);
+                ea->flag_value = read_patch(&r, &offset);
                 break;
 
             case 0x8A: /* long padding (always 0x00000000) */
@@ -1601,7 +1647,7 @@ static int parse_variable_header(STREAMFILE* sf, ea_header* ea, off_t begin_offs
             case 0xA6: /* azimuth ch5 */
             case 0xA7: /* azimuth ch6 */
             case 0xA1: /* unknown and very rare, always 0x02 [FIFA 2001 (PS2)] */
-                read_patch(sf, &offset);
+                read_patch(&r, &offset);
                 break;
 
             case 0xFF: /* header end (then 0-padded so it's 32b aligned) */
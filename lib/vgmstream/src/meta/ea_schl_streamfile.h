@@ -32,6 +32,7 @@ static STREAMFILE* setup_schl_streamfile(STREAMFILE *sf, int codec, int channels
 
     cfg.stream_start = stream_offset;
     cfg.logical_size = logical_size;
+    cfg.lazy_size = 1; /* big streams may be opened over network, and size is only needed for bitrates */
     cfg.codec = codec;
     cfg.channels = channels; //todo chunk size?
     cfg.block_callback = block_callback;
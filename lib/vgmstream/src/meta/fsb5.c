@@ -36,12 +36,149 @@ typedef struct {
 static layered_layout_data* build_layered_fsb5_celt(STREAMFILE* sf, fsb5_header* fsb5);
 static layered_layout_data* build_layered_fsb5_atrac9(STREAMFILE* sf, fsb5_header* fsb5, off_t configs_offset, size_t configs_size);
 
+
+/* Sample header offsets of the last opened banks, as hashes of their name and size, so opening
+ * subsong N of a bank with thousands of them only parses its header instead of walking all previous
+ * ones again. Only enabled with vgmstream_fsb5_index_setup. Older banks are dropped. */
+#define FSB5_INDEX_SIZE 8
+
+static struct {
+    int enabled;
+    struct {
+        uint64_t key;
+        int total_subsongs;
+        uint32_t* offsets;
+    } banks[FSB5_INDEX_SIZE];
+    int count;
+    int next;
+    void (*lock)(void*);
+    void (*unlock)(void*);
+    void* lock_data;
+} fsb5_index;
+
+void vgmstream_fsb5_index_setup(int enabled, void (*lock)(void*), void (*unlock)(void*), void* lock_data) {
+    int i;
+
+    for (i = 0; i < fsb5_index.count; i++) {
+        free(fsb5_index.banks[i].offsets);
+        fsb5_index.banks[i].offsets = NULL;
+    }
+
+    fsb5_index.enabled = enabled;
+    fsb5_index.count = 0;
+    fsb5_index.next = 0;
+    fsb5_index.lock = lock;
+    fsb5_index.unlock = unlock;
+    fsb5_index.lock_data = lock_data;
+}
+
+static uint64_t fsb5_index_key(STREAMFILE* sf) {
+    char filename[PATH_LIMIT];
+    uint64_t hash = 0xCBF29CE484222325ULL; /* FNV-1a */
+    int i;
+
+    get_streamfile_name(sf, filename, sizeof(filename));
+    for (i = 0; filename[i]; i++) {
+        hash = (hash ^ (uint8_t)filename[i]) * 0x100000001B3ULL;
+    }
+    return (hash ^ get_streamfile_size(sf)) * 0x100000001B3ULL;
+}
+
+/* find target_subsong's sample header offset, returns 1 if the bank is indexed */
+static int fsb5_index_get(uint64_t key, int target_subsong, int total_subsongs, off_t* offset) {
+    int i, found = 0;
+
+    if (!fsb5_index.enabled)
+        return 0;
+
+    if (fsb5_index.lock)
+        fsb5_index.lock(fsb5_index.lock_data);
+    for (i = 0; i < fsb5_index.count; i++) {
+        if (fsb5_index.banks[i].key == key && fsb5_index.banks[i].total_subsongs == total_subsongs) {
+            found = 1;
+            *offset = fsb5_index.banks[i].offsets[target_subsong - 1];
+            break;
+        }
+    }
+    if (fsb5_index.unlock)
+        fsb5_index.unlock(fsb5_index.lock_data);
+
+    return found;
+}
+
+/* store a bank's offsets (the index takes them) */
+static void fsb5_index_put(uint64_t key, uint32_t* offsets, int total_subsongs) {
+    uint32_t* old = NULL;
+    int i;
+
+    if (!fsb5_index.enabled) {
+        free(offsets);
+        return;
+    }
+
+    if (fsb5_index.lock)
+        fsb5_index.lock(fsb5_index.lock_data);
+    for (i = 0; i < fsb5_index.count; i++) {
+        if (fsb5_index.banks[i].key == key)
+            break;
+    }
+    if (i == fsb5_index.count) {
+        i = fsb5_index.next;
+        fsb5_index.next = (fsb5_index.next + 1) % FSB5_INDEX_SIZE;
+        if (fsb5_index.count < FSB5_INDEX_SIZE)
+            fsb5_index.count++;
+    }
+    old = fsb5_index.banks[i].offsets;
+    fsb5_index.banks[i].key = key;
+    fsb5_index.banks[i].total_subsongs = total_subsongs;
+    fsb5_index.banks[i].offsets = offsets;
+    if (fsb5_index.unlock)
+        fsb5_index.unlock(fsb5_index.lock_data);
+
+    free(old);
+}
+
+/* walks all sample headers (only their sizes) to get where each one starts */
+static uint32_t* build_fsb5_offsets(STREAMFILE* sf, fsb5_header* fsb5) {
+    uint32_t* offsets;
+    off_t offset = fsb5->base_header_size;
+    off_t max_offset = fsb5->base_header_size + fsb5->sample_header_size;
+    int i;
+
+    offsets = malloc(fsb5->total_subsongs * sizeof(uint32_t));
+    if (!offsets) goto fail;
+
+    for (i = 0; i < fsb5->total_subsongs; i++) {
+        uint32_t sample_mode1;
+
+        if (offset >= max_offset) goto fail;
+        offsets[i] = offset;
+
+        sample_mode1 = (uint32_t)read_32bitLE(offset+0x00,sf);
+        offset += 0x08;
+
+        if (sample_mode1 & 0x01) {
+            uint32_t extraflag;
+
+            do {
+                extraflag = (uint32_t)read_32bitLE(offset,sf);
+                offset += 0x04 + ((extraflag >> 1) & 0xFFFFFF);
+            } while ((extraflag & 0x01) && offset < max_offset);
+        }
+    }
+
+    return offsets;
+fail:
+    free(offsets);
+    return NULL;
+}
+
 /* FSB5 - FMOD Studio multiplatform format */
 VGMSTREAM* init_vgmstream_fsb5(STREAMFILE* sf) {
     VGMSTREAM* vgmstream = NULL;
     fsb5_header fsb5 = {0};
     int target_subsong = sf->stream_index;
-    int i;
+    int i, first_subsong = 0;
 
 
     /* checks */
@@ -80,9 +217,26 @@ VGMSTREAM* init_vgmstream_fsb5(STREAMFILE* sf) {
 
     fsb5.sample_header_offset = fsb5.base_header_size;
 
+    /* known banks start at the target's header */
+    if (fsb5_index.enabled) {
+        uint64_t index_key = fsb5_index_key(sf);
+
+        if (fsb5_index_get(index_key, target_subsong, fsb5.total_subsongs, &fsb5.sample_header_offset)) {
+            first_subsong = target_subsong - 1;
+        }
+        else {
+            uint32_t* offsets = build_fsb5_offsets(sf, &fsb5);
+            if (offsets) {
+                fsb5.sample_header_offset = offsets[target_subsong - 1];
+                first_subsong = target_subsong - 1;
+                fsb5_index_put(index_key, offsets, fsb5.total_subsongs);
+            }
+        }
+    }
+
     /* find target stream header and data offset, and read all needed values for later use
      *  (reads one by one as the size of a single stream header is variable) */
-    for (i = 0; i < fsb5.total_subsongs; i++) {
+    for (i = first_subsong; i < fsb5.total_subsongs; i++) {
         size_t stream_header_size = 0;
         off_t data_offset = 0;
         uint32_t sample_mode1, sample_mode2; /* maybe one uint64? */
@@ -7,6 +7,7 @@
 static void bruteforce_hca_key(STREAMFILE* sf, hca_codec_data* hca_data, unsigned long long* out_keycode, uint16_t subkey);
 #endif
 static void find_hca_key(hca_codec_data* hca_data, uint64_t* p_keycode, uint16_t subkey);
+static void setup_hca_key(VGMSTREAM* vgmstream);
 
 
 /* CRI HCA - streamed audio from CRI ADX2/Atom middleware */
@@ -17,6 +18,7 @@ VGMSTREAM * init_vgmstream_hca(STREAMFILE *streamFile) {
 VGMSTREAM * init_vgmstream_hca_subkey(STREAMFILE *streamFile, uint16_t subkey) {
     VGMSTREAM * vgmstream = NULL;
     hca_codec_data * hca_data = NULL;
+    int key_deferred = 0;
 
 
     /* checks */
@@ -50,13 +52,17 @@ VGMSTREAM * init_vgmstream_hca_subkey(STREAMFILE *streamFile, uint16_t subkey) {
 #ifdef HCA_BRUTEFORCE
         else if (1) {
             bruteforce_hca_key(streamFile, hca_data, &keycode, subkey);
+            test_hca_key_done(hca_data);
         }
 #endif
         else {
-            find_hca_key(hca_data, &keycode, subkey);
+            /* testing known keys decodes frames, so it's done when actually playing */
+            hca_data->subkey = subkey;
+            key_deferred = 1;
         }
 
-        clHCA_SetKey(hca_data->handle, (unsigned long long)keycode); //maybe should be done through hca_decoder.c?
+        if (!key_deferred)
+            clHCA_SetKey(hca_data->handle, (unsigned long long)keycode); //maybe should be done through hca_decoder.c?
     }
 
 
@@ -89,6 +95,10 @@ VGMSTREAM * init_vgmstream_hca_subkey(STREAMFILE *streamFile, uint16_t subkey) {
     vgmstream->coding_type = coding_CRI_HCA;
     vgmstream->layout_type = layout_none;
     vgmstream->codec_data = hca_data;
+    /* CBR, and the file may be a subfile of a bigger bank */
+    vgmstream->bitrate = (int)((int64_t)hca_data->info.blockSize * 8 * hca_data->info.samplingRate / hca_data->info.samplesPerBlock);
+    if (key_deferred)
+        vgmstream->codec_setup = setup_hca_key;
 
     /* assumed mappings */
     {
@@ -115,6 +125,15 @@ fail:
 }
 
 
+static void setup_hca_key(VGMSTREAM* vgmstream) {
+    hca_codec_data* hca_data = vgmstream->codec_data;
+    uint64_t keycode = 0;
+
+    find_hca_key(hca_data, &keycode, hca_data->subkey);
+    clHCA_SetKey(hca_data->handle, (unsigned long long)keycode);
+    test_hca_key_done(hca_data);
+}
+
 static inline void test_key(hca_codec_data * hca_data, uint64_t key, uint16_t subkey, int *best_score, uint64_t *best_keycode) {
     int score;
 
@@ -138,25 +157,135 @@ static inline void test_key(hca_codec_data * hca_data, uint64_t key, uint16_t su
     }
 }
 
+/* Keys found per bank file and per folder (games use one key for all files), as hashes of their
+ * names, so next subsongs of a bank and then next files in the folder test that key first.
+ * Only enabled with vgmstream_hca_key_cache_setup. */
+#define HCA_KEY_CACHE_SIZE 32
+
+static struct {
+    int enabled;
+    struct {
+        uint64_t name; /* file or folder hash */
+        uint64_t key;
+        uint16_t subkey;
+    } entries[HCA_KEY_CACHE_SIZE];
+    int count;
+    int next;
+    void (*lock)(void*);
+    void (*unlock)(void*);
+    void* lock_data;
+} hca_key_cache;
+
+void vgmstream_hca_key_cache_setup(int enabled, void (*lock)(void*), void (*unlock)(void*), void* lock_data) {
+    hca_key_cache.enabled = enabled;
+    hca_key_cache.count = 0;
+    hca_key_cache.next = 0;
+    hca_key_cache.lock = lock;
+    hca_key_cache.unlock = unlock;
+    hca_key_cache.lock_data = lock_data;
+}
+
+/* AWB/ACB subsongs are opened as slices named after the bank, so they share the file hash */
+static void get_hca_key_names(STREAMFILE* sf, uint64_t* p_file, uint64_t* p_folder) {
+    char filename[PATH_LIMIT];
+    uint64_t hash = 0xCBF29CE484222325ULL; /* FNV-1a */
+    int i, len, folder_len;
+
+    get_streamfile_name(sf, filename, sizeof(filename));
+    len = strlen(filename);
+    folder_len = len;
+    while (folder_len > 0 && filename[folder_len - 1] != '/' && filename[folder_len - 1] != '\\') {
+        folder_len--;
+    }
+
+    for (i = 0; i < len; i++) {
+        if (i == folder_len)
+            *p_folder = hash;
+        hash = (hash ^ (uint8_t)filename[i]) * 0x100000001B3ULL;
+    }
+    if (folder_len == len)
+        *p_folder = hash;
+    *p_file = hash;
+}
+
+/* find (get=1) or store (get=0) a file or folder's key */
+static int hca_key_cache_access(uint64_t name, uint64_t* key, uint16_t* subkey, int get) {
+    int i, found = 0;
+
+    if (!hca_key_cache.enabled)
+        return 0;
+
+    if (hca_key_cache.lock)
+        hca_key_cache.lock(hca_key_cache.lock_data);
+    for (i = 0; i < hca_key_cache.count; i++) {
+        if (hca_key_cache.entries[i].name == name) {
+            found = 1;
+            break;
+        }
+    }
+    if (get && found) {
+        *key = hca_key_cache.entries[i].key;
+        *subkey = hca_key_cache.entries[i].subkey;
+    }
+    else if (!get) {
+        if (!found) {
+            i = hca_key_cache.next;
+            hca_key_cache.next = (hca_key_cache.next + 1) % HCA_KEY_CACHE_SIZE;
+            if (hca_key_cache.count < HCA_KEY_CACHE_SIZE)
+                hca_key_cache.count++;
+        }
+        hca_key_cache.entries[i].name = name;
+        hca_key_cache.entries[i].key = *key;
+        hca_key_cache.entries[i].subkey = *subkey;
+    }
+    if (hca_key_cache.unlock)
+        hca_key_cache.unlock(hca_key_cache.lock_data);
+
+    return found;
+}
+
 /* try to find the decryption key from a list. */
 static void find_hca_key(hca_codec_data* hca_data, uint64_t* p_keycode, uint16_t subkey) {
     const size_t keys_length = sizeof(hcakey_list) / sizeof(hcakey_info);
     int best_score = -1;
     int i,j;
+    uint64_t file, folder, found_key = 0, file_key = 0;
+    uint16_t found_subkey = 0;
 
     *p_keycode = 0xCC55463930DBE1AB; /* defaults to PSO2 key, most common */
 
+    /* last key that worked in this bank, then in this folder (for AWB subkeys only the base key is shared) */
+    get_hca_key_names(hca_data->streamfile, &file, &folder);
+    if (hca_key_cache_access(file, &found_key, &found_subkey, 1)) {
+        if (subkey)
+            found_subkey = subkey;
+        file_key = found_key;
+        test_key(hca_data, found_key, found_subkey, &best_score, p_keycode);
+        if (best_score == 1)
+            goto done;
+    }
+    if (hca_key_cache_access(folder, &found_key, &found_subkey, 1) && (found_key != file_key || !file_key)) {
+        if (subkey)
+            found_subkey = subkey;
+        test_key(hca_data, found_key, found_subkey, &best_score, p_keycode);
+        if (best_score == 1)
+            goto done;
+    }
+
     for (i = 0; i < keys_length; i++) {
         uint64_t key = hcakey_list[i].key;
         size_t subkeys_size = hcakey_list[i].subkeys_size;
         const uint16_t *subkeys = hcakey_list[i].subkeys;
 
+        found_key = key;
+        found_subkey = subkey;
         test_key(hca_data, key, subkey, &best_score, p_keycode);
         if (best_score == 1)
             goto done;
 
         if (subkeys_size > 0 && subkey == 0) {
             for (j = 0; j < subkeys_size; j++) {
+                found_subkey = subkeys[j];
                 test_key(hca_data, key, subkeys[j], &best_score, p_keycode);
                 if (best_score == 1)
                     goto done;
@@ -165,6 +294,11 @@ static void find_hca_key(hca_codec_data* hca_data, uint64_t* p_keycode, uint16_t
     }
 
 done:
+    if (best_score == 1) {
+        hca_key_cache_access(file, &found_key, &found_subkey, 0);
+        hca_key_cache_access(folder, &found_key, &found_subkey, 0);
+    }
+
     VGM_ASSERT(best_score > 1, "HCA: best key=%08x%08x (score=%i)\n",
             (uint32_t)((*p_keycode >> 32) & 0xFFFFFFFF), (uint32_t)(*p_keycode & 0xFFFFFFFF), best_score);
     VGM_ASSERT(best_score < 0, "HCA: key not found\n");
@@ -124,6 +124,8 @@ VGMSTREAM * init_vgmstream_mp4_aac_offset(STREAMFILE *streamFile, uint64_t start
 	aac_file->samples_per_frame = stream_info->frameSize;
 	aac_file->samples_discard = 0;
 
+	if ( !setup_mp4_aac_index( aac_file, stream_info->sampleRate ) ) goto fail;
+
 	streamFile->get_name( streamFile, filename, sizeof(filename) );
 
 	aac_file->if_file.streamfile = streamFile->open(streamFile, filename, STREAMFILE_DEFAULT_BUFFER_SIZE);
@@ -152,6 +154,8 @@ fail:
 	if ( aac_file ) {
 		if ( aac_file->h_aacdecoder ) aacDecoder_Close( aac_file->h_aacdecoder );
 		if ( aac_file->h_mp4file ) MP4Close( aac_file->h_mp4file, 0 );
+		free( aac_file->read_buffer );
+		free( aac_file->sample_index );
 		free( aac_file );
 	}
 	return NULL;
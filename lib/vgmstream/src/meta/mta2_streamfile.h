@@ -2,6 +2,16 @@
 #define _MTA2_STREAMFILE_H_
 #include "../streamfile.h"
 
+
+/* reassembled track data kept per read, so decoder reads are just copies */
+#define MTA2_WINDOW_SIZE 0x8000
+
+/* start of a KCEJ block, to resume reassembling without walking from the stream start */
+typedef struct {
+    off_t logical_offset;
+    off_t physical_offset;
+} mta2_block_entry_t;
+
 typedef struct {
     /* config */
     int big_endian;
@@ -17,19 +27,100 @@ typedef struct {
     size_t data_size;           /* usable size in a block */
 
     size_t logical_size;
+
+    /* every block seen so far (sorted, as blocks are only walked forward) */
+    mta2_block_entry_t* blocks;
+    int block_count;
+    int block_max;
+
+    uint8_t* window; /* reassembled data */
+    off_t window_offset; /* logical offset of window data */
+    size_t window_filled;
 } mta2_io_data;
 
 
-static size_t mta2_io_read(STREAMFILE *sf, uint8_t *dest, off_t offset, size_t length, mta2_io_data* data) {
+static int mta2_io_init(STREAMFILE* sf, mta2_io_data* data) {
+    mta2_block_entry_t* blocks = data->blocks;
+
+    /* reopened streamfiles get a copy of the parent's block list */
+    data->blocks = NULL;
+    data->block_max = 0;
+    if (data->block_count > 0) {
+        data->blocks = malloc(data->block_count * sizeof(mta2_block_entry_t));
+        if (!data->blocks) return -1;
+        memcpy(data->blocks, blocks, data->block_count * sizeof(mta2_block_entry_t));
+        data->block_max = data->block_count;
+    }
+
+    data->window_offset = 0;
+    data->window_filled = 0;
+    data->window = malloc(MTA2_WINDOW_SIZE);
+    if (!data->window) {
+        free(data->blocks);
+        data->blocks = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+static void mta2_io_close(STREAMFILE* sf, mta2_io_data* data) {
+    free(data->blocks);
+    data->blocks = NULL;
+    free(data->window);
+    data->window = NULL;
+}
+
+static void mta2_add_block(mta2_io_data* data) {
+    mta2_block_entry_t* entry;
+
+    if (data->block_count > 0 && data->blocks[data->block_count - 1].physical_offset >= data->physical_offset)
+        return;
+
+    if (data->block_count == data->block_max) {
+        int block_max = data->block_max ? data->block_max * 2 : 256;
+        mta2_block_entry_t* blocks = realloc(data->blocks, block_max * sizeof(mta2_block_entry_t));
+        if (!blocks) return; /* will walk a bit more */
+        data->blocks = blocks;
+        data->block_max = block_max;
+    }
+
+    entry = &data->blocks[data->block_count];
+    entry->logical_offset = data->logical_offset;
+    entry->physical_offset = data->physical_offset;
+    data->block_count++;
+}
+
+/* last block starting at or before offset (-1 if none) */
+static int mta2_find_block(mta2_io_data* data, off_t offset) {
+    int lo = 0, hi = data->block_count;
+
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (data->blocks[mid].logical_offset <= offset)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo - 1;
+}
+
+/* reassembles track data from KCEJ blocks */
+static size_t mta2_read_blocks(STREAMFILE *sf, uint8_t *dest, off_t offset, size_t length, mta2_io_data* data) {
     size_t total_read = 0;
     uint32_t (*read_u32)(off_t,STREAMFILE*) = data->big_endian ? read_u32be : read_u32le;
 
 
-    /* re-start when previous offset (can't map logical<>physical offsets) */
+    /* re-start when previous offset (can't map logical<>physical offsets), from the closest known block */
     if (data->logical_offset < 0 || offset < data->logical_offset) {
-        ;VGM_LOG("IO restart: offset=%lx + %x, po=%lx, lo=%lx\n", offset, length, data->physical_offset, data->logical_offset);
-        data->physical_offset = data->stream_offset;
-        data->logical_offset = 0x00;
+        int index = mta2_find_block(data, offset);
+        if (index >= 0) {
+            data->physical_offset = data->blocks[index].physical_offset;
+            data->logical_offset = data->blocks[index].logical_offset;
+        }
+        else {
+            data->physical_offset = data->stream_offset;
+            data->logical_offset = 0x00;
+        }
         data->data_size = 0;
     }
 
@@ -52,6 +143,7 @@ static size_t mta2_io_read(STREAMFILE *sf, uint8_t *dest, off_t offset, size_t l
 
             if (block_type != data->target_type || block_size == 0xFFFFFFFF)
                 break;
+            mta2_add_block(data);
 
             data->block_size = block_size;
             data->skip_size = 0x10;
@@ -93,6 +185,39 @@ static size_t mta2_io_read(STREAMFILE *sf, uint8_t *dest, off_t offset, size_t l
     return total_read;
 }
 
+static size_t mta2_io_read(STREAMFILE* sf, uint8_t* dest, off_t offset, size_t length, mta2_io_data* data) {
+    size_t total_read = 0;
+
+    while (length > 0) {
+        size_t to_copy;
+
+        if (offset < data->window_offset || offset >= data->window_offset + data->window_filled) {
+            /* from the block start, so slightly earlier reads (other tracks) hit the window too */
+            int index = mta2_find_block(data, offset);
+            off_t window_offset = offset;
+            if (index >= 0 && offset - data->blocks[index].logical_offset < MTA2_WINDOW_SIZE / 2)
+                window_offset = data->blocks[index].logical_offset;
+
+            data->window_offset = window_offset;
+            data->window_filled = mta2_read_blocks(sf, data->window, window_offset, MTA2_WINDOW_SIZE, data);
+            if (offset >= data->window_offset + data->window_filled)
+                break; /* EOF/read error */
+        }
+
+        to_copy = data->window_offset + data->window_filled - offset;
+        if (to_copy > length)
+            to_copy = length;
+
+        memcpy(dest, data->window + (offset - data->window_offset), to_copy);
+        total_read += to_copy;
+        dest += to_copy;
+        offset += to_copy;
+        length -= to_copy;
+    }
+
+    return total_read;
+}
+
 static size_t mta2_io_size(STREAMFILE *streamfile, mta2_io_data* data) {
     uint8_t buf[1];
 
@@ -100,7 +225,7 @@ static size_t mta2_io_size(STREAMFILE *streamfile, mta2_io_data* data) {
         return data->logical_size;
 
     /* force a fake read at max offset, to get max logical_offset (will be reset next read) */
-    mta2_io_read(streamfile, buf, 0x7FFFFFFF, 1, data);
+    mta2_read_blocks(streamfile, buf, 0x7FFFFFFF, 1, data);
     data->logical_size = data->logical_offset;
 
     return data->logical_size;
@@ -126,7 +251,7 @@ static STREAMFILE* setup_mta2_streamfile(STREAMFILE *sf, off_t stream_offset, in
 
     /* setup subfile */
     new_sf = open_wrap_streamfile(sf);
-    new_sf = open_io_streamfile_f(new_sf, &io_data, sizeof(mta2_io_data), mta2_io_read, mta2_io_size);
+    new_sf = open_io_streamfile_ex_f(new_sf, &io_data, sizeof(mta2_io_data), mta2_io_read, mta2_io_size, mta2_io_init, mta2_io_close);
     if (extension)
         new_sf = open_fakename_streamfile_f(new_sf, NULL, extension);
     return new_sf;
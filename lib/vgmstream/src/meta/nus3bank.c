@@ -2,30 +2,15 @@
 #include "../coding/coding.h"
 
 #include "nus3bank_streamfile.h"
+#include "bank_index.h"
 
 typedef enum { IDSP, IVAG, BNSF, RIFF, OPUS, RIFF_ENC, } nus3bank_codec;
 
-/* .nus3bank - Namco's newest audio container [Super Smash Bros (Wii U), idolmaster (PS4))] */
-VGMSTREAM * init_vgmstream_nus3bank(STREAMFILE *streamFile) {
-    VGMSTREAM *vgmstream = NULL;
-    STREAMFILE *temp_sf = NULL;
-    off_t tone_offset = 0, pack_offset = 0, name_offset = 0, subfile_offset = 0;
-    size_t name_size = 0, subfile_size = 0;
-    nus3bank_codec codec;
-    const char* fake_ext;
-    int total_subsongs, target_subsong = streamFile->stream_index;
-
-    /* checks */
-    /* .nub2: early [THE iDOLM@STER 2 (PS3/X360)]
-     * .nus3bank: standard */
-    if (!check_extensions(streamFile, "nub2,nus3bank"))
-        goto fail;
-    if (read_32bitBE(0x00,streamFile) != 0x4E555333) /* "NUS3" */
-        goto fail;
-    if (read_32bitBE(0x08,streamFile) != 0x42414E4B) /* "BANK" */
-        goto fail;
-    if (read_32bitBE(0x0c,streamFile) != 0x544F4320) /* "TOC\0" */
-        goto fail;
+/* walks the TOC and tones, returning subsongs and target's entry (plus all entries in the index) */
+static int parse_nus3bank(STREAMFILE* streamFile, int target_subsong, bank_entry_t* target, bank_index* index) {
+    off_t tone_offset = 0, pack_offset = 0;
+    bank_entry_t entry = {0};
+    int total_subsongs;
 
     /* header is always LE, while contained files may use another endianness */
 
@@ -70,12 +55,10 @@ VGMSTREAM * init_vgmstream_nus3bank(STREAMFILE *streamFile) {
     /* parse tones */
     {
         int i;
-        uint32_t codec_id = 0;
         size_t entries = read_32bitLE(tone_offset+0x00, streamFile);
 
         /* get actual number of subsongs */
         total_subsongs = 0;
-        if (target_subsong == 0) target_subsong = 1;
 
         for (i = 0; i < entries; i++) {
             off_t offset, tone_header_offset, stream_name_offset, stream_offset;
@@ -130,16 +113,73 @@ VGMSTREAM * init_vgmstream_nus3bank(STREAMFILE *streamFile) {
             }
 
 
+            entry.offset = stream_offset;
+            entry.size = stream_size;
+            entry.index = i;
+            entry.name_offset = stream_name_offset;
+            entry.name_size = stream_name_size;
+            if (!bank_index_add(index, &entry))
+                goto fail;
+
             total_subsongs++;
             if (total_subsongs == target_subsong) {
                 //;VGM_LOG("NUS3BANK: subsong header offset %lx\n", offset);
-                subfile_offset = stream_offset;
-                subfile_size = stream_size;
-                name_size = stream_name_size;
-                name_offset = stream_name_offset;
+                *target = entry;
             }
             /* continue counting subsongs */
         }
+    }
+
+    return total_subsongs;
+fail:
+    return 0;
+}
+
+/* .nus3bank - Namco's newest audio container [Super Smash Bros (Wii U), idolmaster (PS4))] */
+VGMSTREAM * init_vgmstream_nus3bank(STREAMFILE *streamFile) {
+    VGMSTREAM *vgmstream = NULL;
+    STREAMFILE *temp_sf = NULL;
+    off_t name_offset = 0, subfile_offset = 0;
+    size_t name_size = 0, subfile_size = 0;
+    bank_entry_t entry = {0};
+    nus3bank_codec codec;
+    const char* fake_ext;
+    int total_subsongs, target_subsong = streamFile->stream_index;
+
+    /* checks */
+    /* .nub2: early [THE iDOLM@STER 2 (PS3/X360)]
+     * .nus3bank: standard */
+    if (!check_extensions(streamFile, "nub2,nus3bank"))
+        goto fail;
+    if (read_32bitBE(0x00,streamFile) != 0x4E555333) /* "NUS3" */
+        goto fail;
+    if (read_32bitBE(0x08,streamFile) != 0x42414E4B) /* "BANK" */
+        goto fail;
+    if (read_32bitBE(0x0c,streamFile) != 0x544F4320) /* "TOC\0" */
+        goto fail;
+
+    if (target_subsong == 0) target_subsong = 1;
+
+    /* known banks go straight to the target */
+    total_subsongs = bank_index_get(streamFile, 0x4E555333, target_subsong, &entry);
+    if (!total_subsongs) {
+        bank_index* index = bank_index_new(streamFile, 0x4E555333);
+
+        total_subsongs = parse_nus3bank(streamFile, target_subsong, &entry, index);
+        if (total_subsongs)
+            bank_index_put(index);
+        else
+            bank_index_free(index);
+    }
+
+    subfile_offset = entry.offset;
+    subfile_size = entry.size;
+    name_offset = entry.name_offset;
+    name_size = entry.name_size;
+
+    /* detect codec */
+    {
+        uint32_t codec_id = 0;
 
         if (target_subsong < 0 || target_subsong > total_subsongs || total_subsongs < 1) goto fail;
         if (subfile_offset == 0) {
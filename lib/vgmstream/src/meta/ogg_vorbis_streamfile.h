@@ -1,6 +1,7 @@
 #ifndef _OGG_VORBIS_STREAMFILE_H_
 #define _OGG_VORBIS_STREAMFILE_H_
 #include "../streamfile.h"
+#include "xor_streamfile.h"
 
 
 typedef struct {
@@ -14,27 +15,30 @@ typedef struct {
 typedef struct {
     /* config */
     ogg_vorbis_io_config_data cfg;
+    /* state */
+    xor_key_t key;
 } ogg_vorbis_io_data;
 
 
 static size_t ogg_vorbis_io_read(STREAMFILE *sf, uint8_t *dest, off_t offset, size_t length, ogg_vorbis_io_data* data) {
     static const uint8_t header_swap[4] = { 0x4F,0x67,0x67,0x53 }; /* "OggS" */
     static const size_t header_size = 0x04;
-    int i;
+    int i = 0;
     size_t bytes = read_streamfile(dest, offset, length, sf);
 
     if (data->cfg.is_encrypted) {
-        for (i = 0; i < bytes; i++) {
-            if (data->cfg.is_header_swap && (offset + i) < header_size) {
+        if (data->cfg.is_header_swap) {
+            for (i = 0; i < bytes && (offset + i) < header_size; i++) {
                 dest[i] = header_swap[(offset + i) % header_size];
             }
-            else {
-                if (!data->cfg.key_len && !data->cfg.is_nibble_swap)
-                    break;
-                if (data->cfg.key_len)
-                    dest[i] ^= data->cfg.key[(offset + i) % data->cfg.key_len];
-                if (data->cfg.is_nibble_swap)
-                    dest[i] = ((dest[i] << 4) & 0xf0) | ((dest[i] >> 4) & 0x0f);
+        }
+
+        if (data->cfg.key_len)
+            xor_key_apply(&data->key, dest + i, bytes - i, offset + i);
+
+        if (data->cfg.is_nibble_swap) {
+            for (; i < bytes; i++) {
+                dest[i] = ((dest[i] << 4) & 0xf0) | ((dest[i] >> 4) & 0x0f);
             }
         }
     }
@@ -49,6 +53,10 @@ static STREAMFILE* setup_ogg_vorbis_streamfile(STREAMFILE *sf, ogg_vorbis_io_con
     ogg_vorbis_io_data io_data = {0};
 
     io_data.cfg = cfg; /* memcpy */
+    if (cfg.is_encrypted && cfg.key_len) {
+        if (!xor_key_init(&io_data.key, cfg.key, cfg.key_len))
+            return NULL;
+    }
 
     new_sf = open_wrap_streamfile(sf);
     new_sf = open_io_streamfile_f(new_sf, &io_data, sizeof(ogg_vorbis_io_data), ogg_vorbis_io_read, NULL);
@@ -83,7 +83,7 @@ static STREAMFILE* setup_ppst_streamfile(STREAMFILE *streamFile, off_t start_off
     if (!new_streamFile) goto fail;
     temp_streamFile = new_streamFile;
 
-    new_streamFile = open_buffer_streamfile(new_streamFile,0);
+    new_streamFile = open_buffer_streamfile_adaptive(new_streamFile);
     if (!new_streamFile) goto fail;
     temp_streamFile = new_streamFile;
 
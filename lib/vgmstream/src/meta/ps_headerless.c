@@ -68,7 +68,10 @@ VGMSTREAM * init_vgmstream_ps_headerless(STREAMFILE *streamFile) {
 
         readOffset=0;
         do {
-            readOffset+=(off_t)read_streamfile(testBuffer,readOffset,0x10,streamFile);
+            size_t bytes = read_streamfile(testBuffer,readOffset,0x10,streamFile);
+            if (bytes == 0) /* read error or over detection budget, would loop forever */
+                goto fail;
+            readOffset+=(off_t)bytes;
             // be sure to point to an interleave value
             if(readOffset<(int32_t)(fileLength*0.5)) {
 
@@ -3,6 +3,7 @@
 #include "../coding/coding.h"
 #include "../layout/layout.h"
 #include "../util.h"
+#include "../pool.h"
 #include "riff_ogg_streamfile.h"
 
 /* RIFF - Resource Interchange File Format, standard container used in many games */
@@ -404,16 +405,24 @@ VGMSTREAM* init_vgmstream_riff(STREAMFILE* sf) {
 
     /* read through chunks to verify format and find metadata */
     {
-        off_t current_chunk = 0x0c; /* start with first chunk */
+        sf_chunks chunks;
+        sf_reader r;
+        int i;
 
-        while (current_chunk < file_size && current_chunk < riff_size+8) {
-            uint32_t chunk_id = read_32bitBE(current_chunk + 0x00,sf); /* FOURCC */
-            size_t chunk_size = read_32bitLE(current_chunk + 0x04,sf);
+        sf_reader_init(&r, sf);
 
-            if (current_chunk + 0x08 + chunk_size > file_size)
-                goto fail;
+        /* chunks are even-sized with padding byte (for 16b reads) as per spec (normally
+         * pre-adjusted except for a few like Liar-soft's), at end may not have padding though
+         * (the index skips it but keeps sizes without padding, as they are needed) */
+        chunks.count = 0;
+        if (!sf_chunks_read(&chunks, &r, 0x0c, riff_size + 0x08, file_size, 0, 1))
+            goto fail;
 
-            switch(chunk_id) {
+        for (i = 0; i < chunks.count; i++) {
+            off_t current_chunk = chunks.chunk[i].offset;
+            size_t chunk_size = chunks.chunk[i].size;
+
+            switch(chunks.chunk[i].id) {
                 case 0x666d7420:    /* "fmt " */
                     if (FormatChunkFound) goto fail; /* only one per file */
                     FormatChunkFound = 1;
@@ -421,9 +430,13 @@ VGMSTREAM* init_vgmstream_riff(STREAMFILE* sf) {
                     if (!read_fmt(0, sf, current_chunk, &fmt, mwv))
                         goto fail;
 
-                    /* some Dreamcast/Naomi games again [Headhunter (DC), Bomber hehhe (DC), Rayman 2 (DC)] */
-                    if (fmt.codec == 0x0000 && chunk_size == 0x12)
-                        chunk_size += 0x02;
+                    /* some Dreamcast/Naomi games again [Headhunter (DC), Bomber hehhe (DC), Rayman 2 (DC)],
+                     * real size is 0x14 so next chunks must be read again */
+                    if (fmt.codec == 0x0000 && chunk_size == 0x12) {
+                        chunks.count = i + 1;
+                        if (!sf_chunks_read(&chunks, &r, current_chunk + 0x08 + 0x14, riff_size + 0x08, file_size, 0, 1))
+                            goto fail;
+                    }
                     break;
 
                 case 0x64617461:    /* "data" */
@@ -435,7 +448,7 @@ VGMSTREAM* init_vgmstream_riff(STREAMFILE* sf) {
                     break;
 
                 case 0x4C495354:    /* "LIST" */
-                    switch (read_32bitBE(current_chunk+0x08, sf)) {
+                    switch (sf_reader_s32be(&r, current_chunk+0x08)) {
                         case 0x6164746C:    /* "adtl" */
                             /* yay, atdl is its own little world */
                             parse_adtl(current_chunk + 8, chunk_size,
@@ -451,13 +464,13 @@ VGMSTREAM* init_vgmstream_riff(STREAMFILE* sf) {
                     /* check loop count/loop info (most common) */
                     /* 0x00: manufacturer id, 0x04: product id, 0x08: sample period, 0x0c: unity node,
                      * 0x10: pitch fraction, 0x14: SMPTE format, 0x18: SMPTE offset, 0x1c: loop count, 0x20: sampler data */
-                    if (read_32bitLE(current_chunk+0x08+0x1c, sf) == 1) { /* handle only one loop (could contain N MIDILoop) */
+                    if (sf_reader_s32le(&r, current_chunk+0x08+0x1c) == 1) { /* handle only one loop (could contain N MIDILoop) */
                         /* 0x24: cue point id, 0x28: type (0=forward, 1=alternating, 2=backward)
                          * 0x2c: start, 0x30: end, 0x34: fraction, 0x38: play count */
-                        if (read_32bitLE(current_chunk+0x08+0x28, sf) == 0) { /* loop forward */
+                        if (sf_reader_s32le(&r, current_chunk+0x08+0x28) == 0) { /* loop forward */
                             loop_flag = 1;
-                            loop_start_smpl = read_32bitLE(current_chunk+0x08+0x2c, sf);
-                            loop_end_smpl   = read_32bitLE(current_chunk+0x08+0x30, sf) + 1; /* must add 1 as per spec (ok for standard WAV/AT3/AT9) */
+                            loop_start_smpl = sf_reader_s32le(&r, current_chunk+0x08+0x2c);
+                            loop_end_smpl   = sf_reader_s32le(&r, current_chunk+0x08+0x30) + 1; /* must add 1 as per spec (ok for standard WAV/AT3/AT9) */
                         }
                     }
                     break;
@@ -466,14 +479,14 @@ VGMSTREAM* init_vgmstream_riff(STREAMFILE* sf) {
                     /* check loop count/info (found in some Xbox games: Halo (non-looping), Dynasty Warriors 3, Crimson Sea) */
                     /* 0x00: size, 0x04: unity note, 0x06: fine tune, 0x08: gain, 0x10: loop count */
                     if (chunk_size >= 0x24
-                            && read_32bitLE(current_chunk+0x08+0x00, sf) == 0x14
-                            && read_32bitLE(current_chunk+0x08+0x10, sf) > 0
-                            && read_32bitLE(current_chunk+0x08+0x14, sf) == 0x10) {
+                            && sf_reader_s32le(&r, current_chunk+0x08+0x00) == 0x14
+                            && sf_reader_s32le(&r, current_chunk+0x08+0x10) > 0
+                            && sf_reader_s32le(&r, current_chunk+0x08+0x14) == 0x10) {
                         /* 0x14: size, 0x18: loop type (0=forward, 1=release), 0x1c: loop start, 0x20: loop length */
-                        if (read_32bitLE(current_chunk+0x08+0x18, sf) == 0) { /* loop forward */
+                        if (sf_reader_s32le(&r, current_chunk+0x08+0x18) == 0) { /* loop forward */
                             loop_flag = 1;
-                            loop_start_wsmp = read_32bitLE(current_chunk+0x08+0x1c, sf);
-                            loop_end_wsmp   = read_32bitLE(current_chunk+0x08+0x20, sf); /* must not add 1 as per spec */
+                            loop_start_wsmp = sf_reader_s32le(&r, current_chunk+0x08+0x1c);
+                            loop_end_wsmp   = sf_reader_s32le(&r, current_chunk+0x08+0x20); /* must not add 1 as per spec */
                             loop_end_wsmp  += loop_start_wsmp;
                         }
                     }
@@ -481,24 +494,24 @@ VGMSTREAM* init_vgmstream_riff(STREAMFILE* sf) {
 
                 case 0x66616374:    /* "fact" */
                     if (chunk_size == 0x04) { /* standard (usually for ADPCM, MS recommends to set for non-PCM codecs) */
-                        fact_sample_count = read_32bitLE(current_chunk+0x08, sf);
+                        fact_sample_count = sf_reader_s32le(&r, current_chunk+0x08);
                     }
-                    else if (chunk_size == 0x10 && read_32bitBE(current_chunk+0x08+0x04, sf) == 0x4C794E20) { /* "LyN " */
+                    else if (chunk_size == 0x10 && sf_reader_s32be(&r, current_chunk+0x08+0x04) == 0x4C794E20) { /* "LyN " */
                         goto fail; /* parsed elsewhere */
                     }
                     else if ((fmt.is_at3 || fmt.is_at3p) && chunk_size == 0x08) { /* early AT3 (mainly PSP games) */
-                        fact_sample_count = read_32bitLE(current_chunk+0x08, sf);
-                        fact_sample_skip  = read_32bitLE(current_chunk+0x0c, sf); /* base skip samples */
+                        fact_sample_count = sf_reader_s32le(&r, current_chunk+0x08);
+                        fact_sample_skip  = sf_reader_s32le(&r, current_chunk+0x0c); /* base skip samples */
                     }
                     else if ((fmt.is_at3 || fmt.is_at3p) && chunk_size == 0x0c) { /* late AT3 (mainly PS3 games and few PSP games) */
-                        fact_sample_count = read_32bitLE(current_chunk+0x08, sf);
+                        fact_sample_count = sf_reader_s32le(&r, current_chunk+0x08);
                         /* 0x0c: base skip samples, ignored by decoder */
-                        fact_sample_skip  = read_32bitLE(current_chunk+0x10, sf); /* skip samples with extra 184 */
+                        fact_sample_skip  = sf_reader_s32le(&r, current_chunk+0x10); /* skip samples with extra 184 */
                     }
                     else if (fmt.is_at9 && chunk_size == 0x0c) {
-                        fact_sample_count = read_32bitLE(current_chunk+0x08, sf);
+                        fact_sample_count = sf_reader_s32le(&r, current_chunk+0x08);
                         /* 0x0c: base skip samples (same as next field) */
-                        fact_sample_skip  = read_32bitLE(current_chunk+0x10, sf);
+                        fact_sample_skip  = sf_reader_s32le(&r, current_chunk+0x10);
                     }
                     break;
 
@@ -509,18 +522,18 @@ VGMSTREAM* init_vgmstream_riff(STREAMFILE* sf) {
 
                 case 0x6374726c:    /* "ctrl" (.mwv extension) */
                     if (!mwv) break;
-                    loop_flag = read_32bitLE(current_chunk+0x08, sf);
+                    loop_flag = sf_reader_s32le(&r, current_chunk+0x08);
                     mwv_ctrl_offset = current_chunk;
                     break;
 
                 case 0x63756520:    /* "cue " (used in Source Engine for storing loop points) */
                     if (fmt.coding_type == coding_PCM16LE || fmt.coding_type == coding_MSADPCM) {
-                        uint32_t num_cues = read_32bitLE(current_chunk + 0x08, sf);
+                        uint32_t num_cues = sf_reader_s32le(&r, current_chunk + 0x08);
 
                         if (num_cues > 0) {
                             /* The second cue sets loop end point but it's not actually used by the engine. */
                             loop_flag = 1;
-                            loop_start_cue = read_32bitLE(current_chunk + 0x20, sf);
+                            loop_start_cue = sf_reader_s32le(&r, current_chunk + 0x20);
                         }
                     }
                     break;
@@ -532,7 +545,7 @@ VGMSTREAM* init_vgmstream_riff(STREAMFILE* sf) {
                     /* 0x08: data size */
                     /* 0x0c: channels */
                     /* 0x10: null */
-                    loop_start_nxbf = read_32bitLE(current_chunk + 0x08 + 0x14, sf);
+                    loop_start_nxbf = sf_reader_s32le(&r, current_chunk + 0x08 + 0x14);
                     /* 0x18: sample rate */
                     /* 0x1c: volume? (0x3e8 = 1000 = max) */
                     /* 0x20: type/flags? */
@@ -551,14 +564,6 @@ VGMSTREAM* init_vgmstream_riff(STREAMFILE* sf) {
                     /* ignorance is bliss */
                     break;
             }
-
-            /* chunks are even-sized with padding byte (for 16b reads) as per spec (normally
-             * pre-adjusted except for a few like Liar-soft's), at end may not have padding though
-             * (done *after* chunk parsing since size without padding is needed) */
-            if (chunk_size % 0x02 && current_chunk + 0x08 + chunk_size+0x01 <= file_size)
-                chunk_size += 0x01;
-
-            current_chunk += 0x08 + chunk_size;
         }
     }
 
@@ -657,6 +662,9 @@ VGMSTREAM* init_vgmstream_riff(STREAMFILE* sf) {
                     goto fail;
 
                 for (ch = 0; ch < fmt.channel_count; ch++) {
+                    vgmstream->ch[ch].adpcm_coef_3by32 = pool_arena_calloc(vgmstream->arena, VGMSTREAM_L5_COEFS, sizeof(int32_t));
+                    if (!vgmstream->ch[ch].adpcm_coef_3by32) goto fail;
+
                     for (i = 0; i < filter_count * filter_order; i++) {
                         int coef = read_32bitLE(mwv_pflt_offset+0x10+i*0x04, sf);
                         vgmstream->ch[ch].adpcm_coef_3by32[i] = coef;
@@ -973,15 +981,21 @@ VGMSTREAM* init_vgmstream_rifx(STREAMFILE* sf) {
 
     /* read through chunks to verify format and find metadata */
     {
-        off_t current_chunk = 0xc; /* start with first chunk */
+        sf_chunks chunks;
+        sf_reader r;
+        int i;
 
-        while (current_chunk < file_size && current_chunk < riff_size+8) {
-            uint32_t chunk_type = read_32bitBE(current_chunk,sf);
-            off_t chunk_size = read_32bitBE(current_chunk+4,sf);
+        sf_reader_init(&r, sf);
 
-            if (current_chunk+8+chunk_size > file_size) goto fail;
+        chunks.count = 0;
+        if (!sf_chunks_read(&chunks, &r, 0x0c, riff_size + 0x08, file_size, 1, 0))
+            goto fail;
+
+        for (i = 0; i < chunks.count; i++) {
+            off_t current_chunk = chunks.chunk[i].offset;
+            off_t chunk_size = chunks.chunk[i].size;
 
-            switch(chunk_type) {
+            switch(chunks.chunk[i].id) {
                 case 0x666d7420:    /* "fmt " */
                     /* only one per file */
                     if (FormatChunkFound) goto fail;
@@ -1013,8 +1027,6 @@ VGMSTREAM* init_vgmstream_rifx(STREAMFILE* sf) {
                     /* ignorance is bliss */
                     break;
             }
-
-            current_chunk += 8+chunk_size;
         }
     }
 
@@ -3,51 +3,89 @@
 #include "../streamfile.h"
 
 
+/* deinterleaved data kept per read, so the DSP decoder's small reads are just copies */
+#define SCD_DSP_WINDOW_SIZE 0x8000
+
 typedef struct {
     off_t start_physical_offset; /* interleaved data start, for this substream */
     size_t interleave_block_size; /* max size that can be read before encountering other substreams */
     size_t stride_size; /* step size between interleave blocks (interleave*channels) */
     size_t total_size; /* final size of the deinterleaved substream */
+
+    /* state */
+    uint8_t* window; /* deinterleaved substream data */
+    size_t window_size; /* max (multiple of interleave_block_size) */
+    off_t window_offset; /* logical offset of window data */
+    size_t window_filled;
 } scd_dsp_io_data;
 
 
-/* Handles deinterleaving of complete files, skipping portions or other substreams. */
-static size_t scd_dsp_io_read(STREAMFILE *streamfile, uint8_t *dest, off_t offset, size_t length, scd_dsp_io_data* data) {
-    size_t total_read = 0;
+static int scd_dsp_io_init(STREAMFILE* sf, scd_dsp_io_data* data) {
+    data->window_size = SCD_DSP_WINDOW_SIZE / data->interleave_block_size * data->interleave_block_size;
+    if (data->window_size == 0)
+        data->window_size = data->interleave_block_size;
+    data->window_offset = 0;
+    data->window_filled = 0;
 
-    while (length > 0) {
-        size_t to_read;
-        size_t length_available;
-        off_t block_num;
-        off_t intrablock_offset;
-        off_t physical_offset;
+    data->window = malloc(data->window_size);
+    if (!data->window) return -1;
+    return 0;
+}
 
-        block_num = offset / data->interleave_block_size;
-        intrablock_offset = offset % data->interleave_block_size;
-        physical_offset = data->start_physical_offset + block_num*data->stride_size + intrablock_offset;
-        length_available = data->interleave_block_size - intrablock_offset;
+static void scd_dsp_io_close(STREAMFILE* sf, scd_dsp_io_data* data) {
+    free(data->window);
+    data->window = NULL;
+}
 
-        if (length < length_available) {
-            to_read = length;
-        }
-        else {
-            to_read = length_available;
-        }
+/* Deinterleaves whole blocks of the substream starting at offset (aligned to a block) into the window. */
+static void scd_dsp_fill_window(STREAMFILE* sf, scd_dsp_io_data* data, off_t offset) {
+    off_t block_num = offset / data->interleave_block_size;
+    off_t physical_offset = data->start_physical_offset + block_num * data->stride_size;
+    size_t window_max = data->window_size;
+
+    data->window_offset = block_num * data->interleave_block_size;
+    data->window_filled = 0;
+    if (window_max > data->total_size - data->window_offset)
+        window_max = data->total_size - data->window_offset;
 
-        if (to_read > 0) {
-            size_t bytes_read;
+    while (data->window_filled < window_max) {
+        size_t to_read = data->interleave_block_size;
+        size_t bytes_read;
 
-            bytes_read = read_streamfile(dest, physical_offset, to_read, streamfile);
-            total_read += bytes_read;
+        if (to_read > window_max - data->window_filled)
+            to_read = window_max - data->window_filled;
 
-            if (bytes_read != to_read) {
-                return total_read;
-            }
+        bytes_read = read_streamfile(data->window + data->window_filled, physical_offset, to_read, sf);
+        data->window_filled += bytes_read;
+        if (bytes_read != to_read)
+            break;
 
-            dest += bytes_read;
-            offset += bytes_read;
-            length -= bytes_read;
+        physical_offset += data->stride_size;
+    }
+}
+
+/* Handles deinterleaving of complete files, skipping portions or other substreams. */
+static size_t scd_dsp_io_read(STREAMFILE* sf, uint8_t* dest, off_t offset, size_t length, scd_dsp_io_data* data) {
+    size_t total_read = 0;
+
+    while (length > 0 && offset < data->total_size) {
+        size_t to_copy;
+
+        if (offset < data->window_offset || offset >= data->window_offset + data->window_filled) {
+            scd_dsp_fill_window(sf, data, offset);
+            if (offset >= data->window_offset + data->window_filled)
+                break; /* EOF/read error */
         }
+
+        to_copy = data->window_offset + data->window_filled - offset;
+        if (to_copy > length)
+            to_copy = length;
+
+        memcpy(dest, data->window + (offset - data->window_offset), to_copy);
+        total_read += to_copy;
+        dest += to_copy;
+        offset += to_copy;
+        length -= to_copy;
     }
 
     return total_read;
@@ -74,7 +112,7 @@ static STREAMFILE* setup_scd_dsp_streamfile(STREAMFILE *streamFile, off_t start_
     if (!new_streamFile) goto fail;
     temp_streamFile = new_streamFile;
 
-    new_streamFile = open_io_streamfile(temp_streamFile, &io_data,io_data_size, scd_dsp_io_read,scd_dsp_io_size);
+    new_streamFile = open_io_streamfile_ex(temp_streamFile, &io_data,io_data_size, scd_dsp_io_read,scd_dsp_io_size, scd_dsp_io_init,scd_dsp_io_close);
     if (!new_streamFile) goto fail;
     temp_streamFile = new_streamFile;
 
@@ -1,6 +1,7 @@
 #include "meta.h"
 #include "../coding/coding.h"
 #include "sqex_sead_streamfile.h"
+#include "bank_index.h"
 
 
 typedef struct {
@@ -770,6 +771,8 @@ static void parse_sead_sab_name(sead_header *sead, STREAMFILE *sf) {
 static int parse_sead(sead_header *sead, STREAMFILE *sf) {
     uint32_t (*read_u32)(off_t,STREAMFILE*) = sead->big_endian ? read_u32be : read_u32le;
     uint16_t (*read_u16)(off_t,STREAMFILE*) = sead->big_endian ? read_u16be : read_u16le;
+    uint32_t index_tag = read_u32be(0x00, sf); /* "sabf" or "mabf" */
+    bank_index* index = NULL;
 
     /** base header **/
     /* 0x00: id */
@@ -835,26 +838,44 @@ static int parse_sead(sead_header *sead, STREAMFILE *sf) {
     /* find target material offset */
     {
         int i, entries;
-
-        entries = read_u16(sead->mtrl_section_offset + 0x04, sf);
+        bank_entry_t entry = {0};
 
         if (sead->target_subsong == 0) sead->target_subsong = 1;
-        sead->total_subsongs = 0;
         sead->mtrl_offset = 0;
 
-        /* manually find subsongs as entries can be dummy (ex. sfx banks in Dissidia Opera Omnia) */
-        for (i = 0; i < entries; i++) {
-            off_t entry_offset = sead->mtrl_section_offset + read_u32(sead->mtrl_section_offset + 0x10 + i*0x04, sf);
+        /* known banks go straight to the target */
+        sead->total_subsongs = bank_index_get(sf, index_tag, sead->target_subsong, &entry);
+        if (sead->total_subsongs) {
+            sead->mtrl_offset = entry.offset;
+            sead->mtrl_index = entry.index;
+        }
+        else {
+            index = bank_index_new(sf, index_tag);
 
-            if (read_u8(entry_offset + 0x05, sf) == 0) {
-                continue; /* codec 0 when dummy (see stream header) */
-            }
+            entries = read_u16(sead->mtrl_section_offset + 0x04, sf);
+
+            /* manually find subsongs as entries can be dummy (ex. sfx banks in Dissidia Opera Omnia) */
+            for (i = 0; i < entries; i++) {
+                off_t entry_offset = sead->mtrl_section_offset + read_u32(sead->mtrl_section_offset + 0x10 + i*0x04, sf);
 
-            sead->total_subsongs++;
-            if (!sead->mtrl_offset && sead->total_subsongs == sead->target_subsong) {
-                sead->mtrl_offset = entry_offset;
-                sead->mtrl_index = i;
+                if (read_u8(entry_offset + 0x05, sf) == 0) {
+                    continue; /* codec 0 when dummy (see stream header) */
+                }
+
+                entry.offset = entry_offset;
+                entry.index = i;
+                if (!bank_index_add(index, &entry))
+                    goto fail;
+
+                sead->total_subsongs++;
+                if (!sead->mtrl_offset && sead->total_subsongs == sead->target_subsong) {
+                    sead->mtrl_offset = entry_offset;
+                    sead->mtrl_index = i;
+                }
             }
+
+            bank_index_put(index);
+            index = NULL;
         }
 
         /* SAB can contain 0 entries too */
@@ -880,16 +901,21 @@ static int parse_sead(sead_header *sead, STREAMFILE *sf) {
     sead->loop_flag       = (sead->loop_end > 0);
     sead->extradata_offset = sead->mtrl_offset + 0x20;
 
-    if (sead->is_sab) {
-        parse_sead_sab_name(sead, sf);
-    }
-    else if (sead->is_mab) {
-        parse_sead_mab_name(sead, sf);
-    }
+    /* names need to walk most sections, so they are only found once per subsong if indexed */
+    if (!bank_index_get_name(sf, index_tag, sead->target_subsong, sead->readable_name, sizeof(sead->readable_name))) {
+        if (sead->is_sab) {
+            parse_sead_sab_name(sead, sf);
+        }
+        else if (sead->is_mab) {
+            parse_sead_mab_name(sead, sf);
+        }
 
-    build_readable_name(sead->readable_name, sizeof(sead->readable_name), sead, sf);
+        build_readable_name(sead->readable_name, sizeof(sead->readable_name), sead, sf);
+        bank_index_set_name(sf, index_tag, sead->target_subsong, sead->readable_name);
+    }
 
     return 1;
 fail:
+    bank_index_free(index);
     return 0;
 }
@@ -415,7 +415,7 @@ VGMSTREAM* init_vgmstream_txth(STREAMFILE* sf) {
             /* get coefs */
             {
                 int16_t (*read_16bit)(off_t , STREAMFILE*) = txth.coef_big_endian ? read_16bitBE : read_16bitLE;
-                int16_t (*get_16bit)(uint8_t * p) = txth.coef_big_endian ? get_16bitBE : get_16bitLE;
+                int16_t (*get_16bit)(const uint8_t * p) = txth.coef_big_endian ? get_16bitBE : get_16bitLE;
 
                 for (i = 0; i < vgmstream->channels; i++) {
                     if (txth.coef_mode == 0) { /* normal coefs */
@@ -653,12 +653,149 @@ fail:
 }
 
 
+/* Parsed .txth (key/value pairs), as hashes of their name and size, so raw files that share one .txth
+ * don't read and split the same text again. Also dirs+extensions without a shared .txth, so their files
+ * only try their own names. Only enabled with vgmstream_txth_cache_setup. Older entries are dropped. */
+#define TXTH_CACHE_SIZE 8
+#define TXTH_CACHE_MISSING_SIZE 64
+
+static struct {
+    int enabled;
+    struct {
+        uint64_t key;
+        char* pairs;
+        size_t pairs_size;
+    } entries[TXTH_CACHE_SIZE];
+    int count;
+    int next;
+    uint64_t missing[TXTH_CACHE_MISSING_SIZE];
+    int missing_count;
+    int missing_next;
+    void (*lock)(void*);
+    void (*unlock)(void*);
+    void* lock_data;
+} txth_cache;
+
+void vgmstream_txth_cache_setup(int enabled, void (*lock)(void*), void (*unlock)(void*), void* lock_data) {
+    int i;
+
+    for (i = 0; i < txth_cache.count; i++) {
+        free(txth_cache.entries[i].pairs);
+        txth_cache.entries[i].pairs = NULL;
+    }
+
+    txth_cache.enabled = enabled;
+    txth_cache.count = 0;
+    txth_cache.next = 0;
+    txth_cache.missing_count = 0;
+    txth_cache.missing_next = 0;
+    txth_cache.lock = lock;
+    txth_cache.unlock = unlock;
+    txth_cache.lock_data = lock_data;
+}
+
+static uint64_t txth_cache_key(const char* filename, size_t size) {
+    uint64_t hash = 0xCBF29CE484222325ULL; /* FNV-1a */
+    while (*filename) {
+        hash = (hash ^ (uint8_t)*filename++) * 0x100000001B3ULL;
+    }
+    return (hash ^ size) * 0x100000001B3ULL;
+}
+
+/* returns 1 if key is a known dir+ext without .txth, otherwise adds it if add is set */
+static int txth_cache_missing(uint64_t key, int add) {
+    int i, found = 0;
+
+    if (!txth_cache.enabled)
+        return 0;
+
+    if (txth_cache.lock)
+        txth_cache.lock(txth_cache.lock_data);
+    for (i = 0; i < txth_cache.missing_count; i++) {
+        if (txth_cache.missing[i] == key) {
+            found = 1;
+            break;
+        }
+    }
+    if (!found && add) {
+        txth_cache.missing[txth_cache.missing_next] = key;
+        txth_cache.missing_next = (txth_cache.missing_next + 1) % TXTH_CACHE_MISSING_SIZE;
+        if (txth_cache.missing_count < TXTH_CACHE_MISSING_SIZE)
+            txth_cache.missing_count++;
+    }
+    if (txth_cache.unlock)
+        txth_cache.unlock(txth_cache.lock_data);
+
+    return found;
+}
+
+/* copies a known .txth's pairs, returns NULL if not found */
+static char* txth_cache_get(uint64_t key, size_t* p_pairs_size) {
+    char* pairs = NULL;
+    int i;
+
+    if (!txth_cache.enabled)
+        return NULL;
+
+    if (txth_cache.lock)
+        txth_cache.lock(txth_cache.lock_data);
+    for (i = 0; i < txth_cache.count; i++) {
+        if (txth_cache.entries[i].key == key) {
+            pairs = malloc(txth_cache.entries[i].pairs_size);
+            if (pairs) {
+                memcpy(pairs, txth_cache.entries[i].pairs, txth_cache.entries[i].pairs_size);
+                *p_pairs_size = txth_cache.entries[i].pairs_size;
+            }
+            break;
+        }
+    }
+    if (txth_cache.unlock)
+        txth_cache.unlock(txth_cache.lock_data);
+
+    return pairs;
+}
+
+static void txth_cache_put(uint64_t key, const char* pairs, size_t pairs_size) {
+    char* old_pairs = NULL;
+    char* new_pairs;
+    int i;
+
+    if (!txth_cache.enabled)
+        return;
+
+    new_pairs = malloc(pairs_size);
+    if (!new_pairs) return;
+    memcpy(new_pairs, pairs, pairs_size);
+
+    if (txth_cache.lock)
+        txth_cache.lock(txth_cache.lock_data);
+    for (i = 0; i < txth_cache.count; i++) {
+        if (txth_cache.entries[i].key == key)
+            break;
+    }
+    if (i == txth_cache.count) {
+        i = txth_cache.next;
+        txth_cache.next = (txth_cache.next + 1) % TXTH_CACHE_SIZE;
+        if (txth_cache.count < TXTH_CACHE_SIZE)
+            txth_cache.count++;
+    }
+    old_pairs = txth_cache.entries[i].pairs;
+    txth_cache.entries[i].key = key;
+    txth_cache.entries[i].pairs = new_pairs;
+    txth_cache.entries[i].pairs_size = pairs_size;
+    if (txth_cache.unlock)
+        txth_cache.unlock(txth_cache.lock_data);
+
+    free(old_pairs);
+}
+
 static STREAMFILE* open_txth(STREAMFILE* sf) {
     char basename[PATH_LIMIT];
     char filename[PATH_LIMIT];
     char fileext[PATH_LIMIT];
     const char *subext;
     STREAMFILE* sf_text;
+    uint64_t missing_key;
 
     /* try "(path/)(name.ext).txth" */
     get_streamfile_name(sf,filename,PATH_LIMIT);
@@ -690,6 +827,9 @@ static STREAMFILE* open_txth(STREAMFILE* sf) {
     strcat(filename,".");
     strcat(filename, fileext);
     strcat(filename, ".txth");
+    missing_key = txth_cache_key(filename, 0);
+    if (txth_cache_missing(missing_key, 0))
+        return NULL;
     sf_text = open_streamfile(sf,filename);
     if (sf_text) return sf_text;
 
@@ -699,7 +839,8 @@ static STREAMFILE* open_txth(STREAMFILE* sf) {
     sf_text = open_streamfile(sf,filename);
     if (sf_text) return sf_text;
 
-    /* not found */
+    /* not found, other files in the dir with this extension won't find these either */
+    txth_cache_missing(missing_key, 1);
     return NULL;
 }
 
@@ -778,25 +919,21 @@ static int is_string(const char * val, const char * cmp);
 static int get_bytes_to_samples(txth_header* txth, uint32_t bytes);
 static int get_padding_size(txth_header* txth, int discard_empty);
 
-/* Simple text parser of "key = value" lines.
+/* Simple text parser of "key = value" lines, into "key\0val\0" pairs.
  * The code is meh and error handling not exactly the best. */
-static int parse_txth(txth_header* txth) {
+static char* read_txth_pairs(STREAMFILE* sf_text, size_t* p_pairs_size) {
     off_t txt_offset = 0x00;
-    off_t file_size = get_streamfile_size(txth->sf_text);
-
-    /* setup txth defaults */
-    if (txth->sf_body)
-        txth->data_size = get_streamfile_size(txth->sf_body);
-    txth->target_subsong = txth->sf->stream_index;
-    if (txth->target_subsong == 0) txth->target_subsong = 1;
+    off_t file_size = get_streamfile_size(sf_text);
+    char* pairs = NULL;
+    size_t pairs_size = 0, pairs_max = 0;
 
 
     /* skip BOM if needed */
-    if ((uint16_t)read_16bitLE(0x00, txth->sf_text) == 0xFFFE ||
-        (uint16_t)read_16bitLE(0x00, txth->sf_text) == 0xFEFF) {
+    if ((uint16_t)read_16bitLE(0x00, sf_text) == 0xFFFE ||
+        (uint16_t)read_16bitLE(0x00, sf_text) == 0xFEFF) {
         txt_offset = 0x02;
     }
-    else if (((uint32_t)read_32bitBE(0x00, txth->sf_text) & 0xFFFFFF00) == 0xEFBBBF00) {
+    else if (((uint32_t)read_32bitBE(0x00, sf_text) & 0xFFFFFF00) == 0xEFBBBF00) {
         txt_offset = 0x03;
     }
 
@@ -805,8 +942,9 @@ static int parse_txth(txth_header* txth) {
         char line[TXT_LINE_MAX];
         char key[TXT_LINE_MAX] = {0}, val[TXT_LINE_MAX] = {0}; /* at least as big as a line to avoid overflows (I hope) */
         int ok, bytes_read, line_ok;
+        size_t key_size, val_size;
 
-        bytes_read = read_line(line, sizeof(line), txt_offset, txth->sf_text, &line_ok);
+        bytes_read = read_line(line, sizeof(line), txt_offset, sf_text, &line_ok);
         if (!line_ok) goto fail;
         //;VGM_LOG("TXTH: line=%s\n",line);
 
@@ -817,9 +955,73 @@ static int parse_txth(txth_header* txth) {
         if (ok != 2) /* ignore line if no key=val (comment or garbage) */
             continue;
 
-        if (!parse_keyval(txth->sf, txth, key, val)) /* read key/val */
+        key_size = strlen(key) + 1;
+        val_size = strlen(val) + 1;
+        if (pairs_size + key_size + val_size > pairs_max) {
+            char* new_pairs;
+
+            pairs_max = (pairs_size + key_size + val_size) * 2;
+            new_pairs = realloc(pairs, pairs_max);
+            if (!new_pairs) goto fail;
+            pairs = new_pairs;
+        }
+        memcpy(pairs + pairs_size, key, key_size);
+        pairs_size += key_size;
+        memcpy(pairs + pairs_size, val, val_size);
+        pairs_size += val_size;
+    }
+
+    /* empty .txth are valid, though will fail later */
+    if (!pairs) {
+        pairs = malloc(1);
+        if (!pairs) goto fail;
+    }
+
+    *p_pairs_size = pairs_size;
+    return pairs;
+fail:
+    free(pairs);
+    return NULL;
+}
+
+/* Applies every "key = value" of the .txth in order. */
+static int parse_txth(txth_header* txth) {
+    char* pairs = NULL;
+    size_t pairs_size = 0, pos;
+    uint64_t key;
+    char filename[PATH_LIMIT];
+
+    /* setup txth defaults */
+    if (txth->sf_body)
+        txth->data_size = get_streamfile_size(txth->sf_body);
+    txth->target_subsong = txth->sf->stream_index;
+    if (txth->target_subsong == 0) txth->target_subsong = 1;
+
+
+    /* pairs are the same for every file using this .txth */
+    get_streamfile_name(txth->sf_text, filename, sizeof(filename));
+    key = txth_cache_key(filename, get_streamfile_size(txth->sf_text));
+    pairs = txth_cache_get(key, &pairs_size);
+    if (!pairs) {
+        pairs = read_txth_pairs(txth->sf_text, &pairs_size);
+        if (!pairs) goto fail;
+        txth_cache_put(key, pairs, pairs_size);
+    }
+
+    pos = 0;
+    while (pos < pairs_size) {
+        char val[TXT_LINE_MAX]; /* parsers may modify it */
+        const char* key_str = pairs + pos;
+
+        pos += strlen(key_str) + 1;
+        strcpy(val, pairs + pos);
+        pos += strlen(val) + 1;
+
+        if (!parse_keyval(txth->sf, txth, key_str, val)) /* read key/val */
             goto fail;
     }
+    free(pairs);
+    pairs = NULL;
 
     if (!txth->loop_flag_set)
         txth->loop_flag = txth->loop_end_sample && txth->loop_end_sample != 0xFFFFFFFF;
@@ -832,6 +1034,7 @@ static int parse_txth(txth_header* txth) {
 
     return 1;
 fail:
+    free(pairs);
     return 0;
 }
 
@@ -2,6 +2,7 @@
 #include "../coding/coding.h"
 #include "../layout/layout.h"
 #include "../mixing.h"
+#include <stddef.h>
 
 
 #define TXTP_LINE_MAX 1024
@@ -10,6 +11,7 @@
 #define TXTP_GROUP_MODE_LAYERED 'L'
 #define TXTP_GROUP_REPEAT 'R'
 #define TXTP_POSITION_LOOPS 'L'
+#define TXTP_SEGMENTS_OPEN_MAX 16 /* plain segment playlists bigger than this reopen segments on demand */
 
 /* mixing info */
 typedef enum {
@@ -69,8 +71,6 @@ typedef struct {
     int subsong;
 
     uint32_t channel_mask;
-    int mixing_count;
-    txtp_mix_data mixing[TXTP_MIXING_MAX];
 
     play_config_t config;
 
@@ -87,6 +87,8 @@ typedef struct {
     double trim_second;
     int32_t trim_sample;
 
+    int mixing_count;
+    txtp_mix_data mixing[TXTP_MIXING_MAX]; /* last, so copies may only keep used mixes */
 } txtp_entry;
 
 
@@ -100,6 +102,28 @@ typedef struct {
 
 } txtp_group;
 
+/* file opened by entries, so entries of the same file (like subsongs of one bank) share it */
+typedef struct {
+    char* filename;
+    STREAMFILE* streamFile; /* shared base (and its buffer) for header parsing, NULL if not kept */
+    int init_index;         /* detection function that opened it, to skip detection on next entries */
+} txtp_source;
+
+typedef struct {
+    txtp_source* source;
+    int source_count;
+    int source_max;
+    int keep_open;          /* bounded mode can't keep every file open */
+} txtp_sources;
+
+/* entries needed to reopen segments closed by the layout */
+typedef struct {
+    STREAMFILE* streamFile; /* base for relative filenames */
+    txtp_entry** entries;   /* as parsed, since applying config modifies them */
+    int entry_count;
+    txtp_sources sources;
+} txtp_reopen_data;
+
 typedef struct {
     txtp_entry *entry;
     size_t entry_count;
@@ -123,6 +147,10 @@ typedef struct {
     int is_segmented;
     int is_layered;
     int is_single;
+
+    txtp_reopen_data* reopen; /* plain segments, passed to the segmented layout */
+    int is_bounded;         /* reopen data only, segments are opened by the layout */
+    txtp_sources sources;
 } txtp_header;
 
 static txtp_header* parse_txtp(STREAMFILE* streamFile);
@@ -132,6 +160,12 @@ void add_mixing(txtp_entry* cfg, txtp_mix_data* mix, txtp_mix_t command);
 
 static int make_group_segment(txtp_header* txtp, int from, int count);
 static int make_group_layer(txtp_header* txtp, int from, int count);
+static VGMSTREAM* open_entry(STREAMFILE* streamFile, txtp_entry* entry, txtp_sources* sources);
+static int init_sources(txtp_sources* sources, int source_max, int keep_open);
+static void free_sources(txtp_sources* sources);
+static txtp_reopen_data* init_reopen_data(STREAMFILE* streamFile, txtp_header* txtp);
+static VGMSTREAM* open_reopen_segment(void* open_data, int segment);
+static void free_reopen_data(void* open_data);
 
 
 /* TXTP - an artificial playlist-like format to play files with segments/layers/config */
@@ -158,6 +192,9 @@ VGMSTREAM * init_vgmstream_txtp(STREAMFILE *streamFile) {
         if (!txtp->vgmstream) goto fail;
 
         txtp->vgmstream_count = txtp->entry_count;
+
+        if (!init_sources(&txtp->sources, txtp->entry_count, 1))
+            goto fail;
     }
 
 
@@ -169,23 +206,20 @@ VGMSTREAM * init_vgmstream_txtp(STREAMFILE *streamFile) {
     }
 
 
-    /* open all entry files first as they'll be modified by modes */
-    for (i = 0; i < txtp->vgmstream_count; i++) {
-        STREAMFILE* temp_streamFile = open_streamfile_by_filename(streamFile, txtp->entry[i].filename);
-        if (!temp_streamFile) {
-            VGM_LOG("TXTP: cannot open streamfile for %s\n", txtp->entry[i].filename);
-            goto fail;
-        }
-        temp_streamFile->stream_index = txtp->entry[i].subsong;
+    /* plain segments can be reopened, so the layout closes those that can't play again, and
+     * big playlists only keep a few open (bounded mode), so segments are opened by the layout */
+    if (txtp->is_segmented && txtp->group_count == 0) {
+        txtp->reopen = init_reopen_data(streamFile, txtp);
+        if (!txtp->reopen) goto fail;
+        txtp->is_bounded = txtp->vgmstream_count > TXTP_SEGMENTS_OPEN_MAX;
+    }
 
-        txtp->vgmstream[i] = init_vgmstream_from_STREAMFILE(temp_streamFile);
-        close_streamfile(temp_streamFile);
-        if (!txtp->vgmstream[i]) {
-            VGM_LOG("TXTP: cannot open vgmstream for %s#%i\n", txtp->entry[i].filename, txtp->entry[i].subsong);
-            goto fail;
-        }
 
-        apply_config(txtp->vgmstream[i], &txtp->entry[i]);
+    /* open all entry files first as they'll be modified by modes */
+    for (i = 0; i < txtp->vgmstream_count && !txtp->is_bounded; i++) {
+        txtp->vgmstream[i] = open_entry(streamFile, &txtp->entry[i], &txtp->sources);
+        if (!txtp->vgmstream[i])
+            goto fail;
     }
 
 
@@ -327,6 +361,15 @@ static int make_group_segment(txtp_header* txtp, int position, int count) {
         txtp->vgmstream[i + position] = NULL; /* will be freed by layout */
     }
 
+    /* in bounded mode segments aren't open yet and the layout opens them when needed */
+    if (txtp->reopen && position == 0 && txtp->vgmstream_count == count) {
+        data_s->open_segment = open_reopen_segment;
+        data_s->free_open_data = free_reopen_data;
+        data_s->open_data = txtp->reopen;
+        data_s->bounded = txtp->is_bounded;
+        txtp->reopen = NULL; /* will be freed by layout */
+    }
+
     /* setup VGMSTREAMs */
     if (!setup_layout_segmented(data_s))
         goto fail;
@@ -335,9 +378,9 @@ static int make_group_segment(txtp_header* txtp, int position, int count) {
     vgmstream = allocate_segmented_vgmstream(data_s,loop_flag, txtp->loop_start_segment - 1, txtp->loop_end_segment - 1);
     if (!vgmstream) goto fail;
 
-    /* custom meta name if all parts don't match */
+    /* custom meta name if all parts don't match (closed segments in bounded mode can't be checked) */
     for (i = 0; i < data_s->segment_count; i++) {
-        if (vgmstream->meta_type != data_s->segments[i]->meta_type) {
+        if (!data_s->segments[i] || vgmstream->meta_type != data_s->segments[i]->meta_type) {
             vgmstream->meta_type = meta_TXTP;
             break;
         }
@@ -345,17 +388,28 @@ static int make_group_segment(txtp_header* txtp, int position, int count) {
 
     /* fix loop keep */
     if (loop_flag && txtp->is_loop_keep) {
-        int32_t current_samples = 0;
         for (i = 0; i < data_s->segment_count; i++) {
-            if (txtp->loop_start_segment == i+1 /*&& data_s->segments[i]->loop_start_sample*/) {
-                vgmstream->loop_start_sample = current_samples + data_s->segments[i]->loop_start_sample;
-            }
+            VGMSTREAM* segment;
+
+            if (txtp->loop_start_segment != i+1 && txtp->loop_end_segment != i+1)
+                continue;
 
-            current_samples += data_s->segments[i]->num_samples;
+            /* only loop points are needed from closed segments */
+            segment = data_s->segments[i];
+            if (!segment)
+                segment = open_reopen_segment(data_s->open_data, i);
+            if (!segment) goto fail;
 
-            if (txtp->loop_end_segment == i+1 && data_s->segments[i]->loop_end_sample) {
-                vgmstream->loop_end_sample = current_samples - data_s->segments[i]->num_samples + data_s->segments[i]->loop_end_sample;
+            if (txtp->loop_start_segment == i+1 /*&& segment->loop_start_sample*/) {
+                vgmstream->loop_start_sample = data_s->segment_starts[i] + segment->loop_start_sample;
             }
+
+            if (txtp->loop_end_segment == i+1 && segment->loop_end_sample) {
+                vgmstream->loop_end_sample = data_s->segment_starts[i] + segment->loop_end_sample;
+            }
+
+            if (segment != data_s->segments[i])
+                close_vgmstream(segment);
         }
     }
 
@@ -427,34 +481,178 @@ fail:
 }
 
 
+static int init_sources(txtp_sources* sources, int source_max, int keep_open) {
+    sources->source = calloc(source_max, sizeof(txtp_source));
+    if (!sources->source) return 0;
+    sources->source_count = 0;
+    sources->source_max = source_max;
+    sources->keep_open = keep_open;
+    return 1;
+}
+
+static void free_sources(txtp_sources* sources) {
+    int i;
+
+    for (i = 0; i < sources->source_count; i++) {
+        free(sources->source[i].filename);
+        close_streamfile(sources->source[i].streamFile);
+    }
+    free(sources->source);
+    sources->source = NULL;
+    sources->source_count = 0;
+}
+
+static txtp_source* get_source(txtp_sources* sources, const char* filename) {
+    txtp_source* source;
+    int i;
+
+    for (i = 0; i < sources->source_count; i++) {
+        if (strcmp(sources->source[i].filename, filename) == 0)
+            return &sources->source[i];
+    }
+
+    if (sources->source_count >= sources->source_max)
+        return NULL;
+    source = &sources->source[sources->source_count];
+    source->filename = malloc(strlen(filename) + 1);
+    if (!source->filename) return NULL;
+    strcpy(source->filename, filename);
+    source->streamFile = NULL;
+    source->init_index = 0;
+    sources->source_count++;
+    return source;
+}
+
+static VGMSTREAM* open_entry(STREAMFILE* streamFile, txtp_entry* entry, txtp_sources* sources) {
+    VGMSTREAM* vgmstream;
+    STREAMFILE* temp_streamFile;
+    txtp_source* source = get_source(sources, entry->filename);
+
+    if (source && source->streamFile) {
+        temp_streamFile = source->streamFile;
+    }
+    else {
+        temp_streamFile = open_streamfile_by_filename(streamFile, entry->filename);
+        if (!temp_streamFile) {
+            VGM_LOG("TXTP: cannot open streamfile for %s\n", entry->filename);
+            return NULL;
+        }
+        if (source && sources->keep_open)
+            source->streamFile = temp_streamFile;
+    }
+    temp_streamFile->stream_index = entry->subsong;
+
+    /* streams keep their own streamfiles, so the base can be reused by next entries */
+    vgmstream = init_vgmstream_from_STREAMFILE_index(temp_streamFile, source ? source->init_index : 0);
+    if (!source || temp_streamFile != source->streamFile)
+        close_streamfile(temp_streamFile);
+    if (!vgmstream) {
+        VGM_LOG("TXTP: cannot open vgmstream for %s#%i\n", entry->filename, entry->subsong);
+        return NULL;
+    }
+    if (source)
+        source->init_index = vgmstream->init_index;
+
+    apply_config(vgmstream, entry);
+    return vgmstream;
+}
+
+/* Keeps a copy of each entry (just the used mixes, as full entries are big) plus the .txtp. */
+static txtp_reopen_data* init_reopen_data(STREAMFILE* streamFile, txtp_header* txtp) {
+    txtp_reopen_data* data;
+    int i;
+
+    data = calloc(1, sizeof(txtp_reopen_data));
+    if (!data) goto fail;
+
+    data->streamFile = reopen_streamfile(streamFile, 0);
+    if (!data->streamFile) goto fail;
+
+    data->entries = calloc(txtp->entry_count, sizeof(txtp_entry*));
+    if (!data->entries) goto fail;
+    data->entry_count = txtp->entry_count;
+
+    if (!init_sources(&data->sources, txtp->entry_count, 0))
+        goto fail;
+
+    for (i = 0; i < txtp->entry_count; i++) {
+        size_t entry_size = offsetof(txtp_entry, mixing) + txtp->entry[i].mixing_count * sizeof(txtp_mix_data);
+
+        data->entries[i] = malloc(entry_size);
+        if (!data->entries[i]) goto fail;
+        memcpy(data->entries[i], &txtp->entry[i], entry_size);
+    }
+
+    return data;
+fail:
+    free_reopen_data(data);
+    return NULL;
+}
+
+static VGMSTREAM* open_reopen_segment(void* open_data, int segment) {
+    txtp_reopen_data* data = open_data;
+    VGMSTREAM* vgmstream;
+    txtp_entry* entry;
+
+    if (segment < 0 || segment >= data->entry_count)
+        return NULL;
+
+    /* config may add mixes, so it needs a full entry */
+    entry = malloc(sizeof(txtp_entry));
+    if (!entry) return NULL;
+    memcpy(entry, data->entries[segment], offsetof(txtp_entry, mixing) + data->entries[segment]->mixing_count * sizeof(txtp_mix_data));
+
+    vgmstream = open_entry(data->streamFile, entry, &data->sources);
+    free(entry);
+    return vgmstream;
+}
+
+static void free_reopen_data(void* open_data) {
+    txtp_reopen_data* data = open_data;
+    int i;
+
+    if (!data)
+        return;
+
+    if (data->entries) {
+        for (i = 0; i < data->entry_count; i++) {
+            free(data->entries[i]);
+        }
+        free(data->entries);
+    }
+    free_sources(&data->sources);
+    close_streamfile(data->streamFile);
+    free(data);
+}
+
 static void apply_config(VGMSTREAM *vgmstream, txtp_entry *current) {
 
     if (current->config.play_forever) {
-        vgmstream->config.play_forever = current->config.play_forever;
+        vgmstream->config->play_forever = current->config.play_forever;
     }
     if (current->config.loop_count_set) {
-        vgmstream->config.loop_count_set = 1;
-        vgmstream->config.loop_count = current->config.loop_count;
+        vgmstream->config->loop_count_set = 1;
+        vgmstream->config->loop_count = current->config.loop_count;
     }
     if (current->config.fade_time_set) {
-        vgmstream->config.fade_time_set = 1;
-        vgmstream->config.fade_time = current->config.fade_time;
+        vgmstream->config->fade_time_set = 1;
+        vgmstream->config->fade_time = current->config.fade_time;
     }
     if (current->config.fade_delay_set) {
-        vgmstream->config.fade_delay_set = 1;
-        vgmstream->config.fade_delay = current->config.fade_delay;
+        vgmstream->config->fade_delay_set = 1;
+        vgmstream->config->fade_delay = current->config.fade_delay;
     }
     if (current->config.ignore_fade) {
-        vgmstream->config.ignore_fade = current->config.ignore_fade;
+        vgmstream->config->ignore_fade = current->config.ignore_fade;
     }
     if (current->config.force_loop) {
-        vgmstream->config.force_loop = current->config.force_loop;
+        vgmstream->config->force_loop = current->config.force_loop;
     }
     if (current->config.really_force_loop) {
-        vgmstream->config.really_force_loop = current->config.really_force_loop;
+        vgmstream->config->really_force_loop = current->config.really_force_loop;
     }
     if (current->config.ignore_loop) {
-        vgmstream->config.ignore_loop = current->config.ignore_loop;
+        vgmstream->config->ignore_loop = current->config.ignore_loop;
     }
 
     if (current->sample_rate > 0) {
@@ -1534,5 +1732,7 @@ static void clean_txtp(txtp_header* txtp, int fail) {
     free(txtp->vgmstream);
     free(txtp->group);
     free(txtp->entry);
+    free_reopen_data(txtp->reopen);
+    free_sources(&txtp->sources);
     free(txtp);
 }
@@ -2,8 +2,12 @@
 #include "../layout/layout.h"
 #include "../coding/coding.h"
 #include "ubi_bao_streamfile.h"
+#include "bank_index.h"
 
 
+#define BAO_INDEX_SUBSONGS 0x42414F70 /* "BAOp": header BAO offset per subsong of a .pk */
+#define BAO_INDEX_IDS      0x42414F69 /* "BAOi": id/offset/size of every BAO in a .pk/.spk */
+
 #define BAO_MAX_LAYER_COUNT 16  /* arbitrary max */
 #define BAO_MAX_CHAIN_COUNT 128 /* POP:TFS goes up to ~100 */
 
@@ -735,6 +739,8 @@ static int parse_pk(ubi_bao_header * bao, STREAMFILE *streamFile) {
     int target_subsong = streamFile->stream_index;
     STREAMFILE *streamIndex = NULL;
     STREAMFILE *streamTest = NULL;
+    bank_index* index = NULL;
+    bank_entry_t entry = {0};
 
     /* format: 0x01=package index, 0x02=package BAO */
     if (read_8bit(0x00, streamFile) != 0x01)
@@ -769,17 +775,34 @@ static int parse_pk(ubi_bao_header * bao, STREAMFILE *streamFile) {
     }
 
     /* use smaller I/O buffers for performance, as this read lots of small headers all over the place */
+    streamTest = reopen_streamfile(streamFile, 0x100);
+    if (!streamTest) goto fail;
+
+    /* known packages go straight to the target header BAO */
+    bao->total_subsongs = bank_index_get(streamFile, BAO_INDEX_SUBSONGS, target_subsong, &entry);
+    if (bao->total_subsongs) {
+        if (target_subsong > bao->total_subsongs)
+            goto fail;
+
+        config_bao_endian(bao, entry.offset, streamTest);
+        if (!parse_header(bao, streamTest, entry.offset))
+            goto fail;
+
+        close_streamfile(streamTest);
+        return 1;
+    }
+
     streamIndex = reopen_streamfile(streamFile, index_size);
     if (!streamIndex) goto fail;
 
-    streamTest = reopen_streamfile(streamFile, 0x100);
-    if (!streamTest) goto fail;
+    index = bank_index_new(streamFile, BAO_INDEX_SUBSONGS);
 
     /* parse index to get target subsong N = Nth valid header BAO */
     bao_offset = index_header_size + index_size;
     for (i = 0; i < index_entries; i++) {
       //uint32_t bao_id = read_32bitLE(index_header_size + 0x08*i + 0x00, streamIndex);
         size_t bao_size = read_32bitLE(index_header_size + 0x08*i + 0x04, streamIndex);
+        int prev_subsongs = bao->total_subsongs;
 
         //;VGM_LOG("UBI BAO: offset=%x, size=%x\n", (uint32_t)bao_offset, bao_size);
 
@@ -787,9 +810,18 @@ static int parse_pk(ubi_bao_header * bao, STREAMFILE *streamFile) {
         if (!parse_bao(bao, streamTest, bao_offset, target_subsong))
             goto fail;
 
+        if (bao->total_subsongs != prev_subsongs) {
+            entry.offset = bao_offset;
+            if (!bank_index_add(index, &entry))
+                goto fail;
+        }
+
         bao_offset += bao_size; /* files simply concat BAOs */
     }
 
+    bank_index_put(index);
+    index = NULL;
+
     //;VGM_LOG("UBI BAO: class "); {int i; for (i=0;i<16;i++){ VGM_ASSERT(bao->classes[i],"%02x=%i ",i,bao->classes[i]); }} VGM_LOG("\n");
     //;VGM_LOG("UBI BAO: types "); {int i; for (i=0;i<16;i++){ VGM_ASSERT(bao->types[i],"%02x=%i ",i,bao->types[i]); }} VGM_LOG("\n");
 
@@ -799,6 +831,7 @@ static int parse_pk(ubi_bao_header * bao, STREAMFILE *streamFile) {
 fail:
     close_streamfile(streamIndex);
     close_streamfile(streamTest);
+    bank_index_free(index);
     return 0;
 }
 
@@ -1416,30 +1449,64 @@ fail:
 }
 
 static int find_package_bao(uint32_t target_id, STREAMFILE *streamFile, off_t *out_offset, size_t *out_size) {
-    int i;
+    int i, found;
     int index_entries;
     off_t bao_offset;
     size_t index_size, index_header_size;
+    bank_index* index = NULL;
+    bank_entry_t entry = {0};
+
+    /* known packages are looked up in memory (every subsong resolves resources in the same .pk/.spk) */
+    found = bank_index_find(streamFile, BAO_INDEX_IDS, target_id, &entry);
+    if (found >= 0)
+        goto done;
 
     index_size = read_32bitLE(0x04, streamFile);
     index_entries = index_size / 0x08;
     index_header_size = 0x40;
 
-    /* parse index to get target BAO */
+    index = bank_index_new(streamFile, BAO_INDEX_IDS);
+
+    /* parse index to get target BAO (whole index if it's being stored) */
+    found = 0;
     bao_offset = index_header_size + index_size;
     for (i = 0; i < index_entries; i++) {
         uint32_t bao_id = read_32bitLE(index_header_size + 0x08*i + 0x00, streamFile);
         size_t bao_size = read_32bitLE(index_header_size + 0x08*i + 0x04, streamFile);
 
-        if (bao_id == target_id) {
-            if (out_offset) *out_offset = bao_offset;
-            if (out_size) *out_size = bao_size;
-            return 1;
+        if (!found && bao_id == target_id) {
+            entry.index = bao_id;
+            entry.offset = bao_offset;
+            entry.size = bao_size;
+            found = 1;
+            if (!index)
+                break;
+        }
+
+        if (index) {
+            bank_entry_t id_entry = {0};
+            id_entry.index = bao_id;
+            id_entry.offset = bao_offset;
+            id_entry.size = bao_size;
+            if (!bank_index_add(index, &id_entry)) {
+                bank_index_free(index);
+                index = NULL;
+                if (found)
+                    break;
+            }
         }
+
         bao_offset += bao_size;
     }
 
-    return 0;
+    bank_index_put(index);
+
+done:
+    if (found) {
+        if (out_offset) *out_offset = entry.offset;
+        if (out_size) *out_size = entry.size;
+    }
+    return found;
 }
 
 
@@ -89,6 +89,12 @@ typedef struct {
     int default_codec_for_subblock0;
 } ubi_sb_config;
 
+/* where a subsong's header is in a bank or map */
+typedef struct {
+    int map_index;              /* submap (maps only) */
+    int header_index;           /* entry number within section2 */
+} ubi_sb_location;
+
 typedef struct {
     ubi_sb_platform platform;
     int is_ps2_old;
@@ -189,6 +195,12 @@ typedef struct {
     char readable_name[255];    /* final subsong name */
     int types[16];              /* counts each header types, for debugging */
     int allowed_types[16];
+
+    /* subsong locations recorded while parsing a whole bank/map, for the bank index */
+    int is_indexing;
+    int map_index;              /* submap being parsed */
+    ubi_sb_location* locations;
+    int locations_max;
 } ubi_sb_header;
 
 static int parse_bnm_header(ubi_sb_header* sb, STREAMFILE* sf);
@@ -196,12 +208,135 @@ static int parse_bnm_ps2_header(ubi_sb_header* sb, STREAMFILE* sf);
 static int parse_dat_header(ubi_sb_header *sb, STREAMFILE *sf);
 static int parse_header(ubi_sb_header* sb, STREAMFILE* sf, off_t offset, int index);
 static int parse_sb(ubi_sb_header* sb, STREAMFILE* sf, int target_subsong);
+static int parse_sb_location(ubi_sb_header* sb, STREAMFILE* sf, const ubi_sb_location* location);
+static int parse_sb_indexed(ubi_sb_header* sb, STREAMFILE* sf_index, STREAMFILE* sf, int target_subsong);
+static void parse_sm_submap(ubi_sb_header* sb, STREAMFILE* sf, int map_index);
 static VGMSTREAM* init_vgmstream_ubi_sb_header(ubi_sb_header* sb, STREAMFILE* sf_index, STREAMFILE* sf);
 static VGMSTREAM *init_vgmstream_ubi_sb_silence(ubi_sb_header *sb, STREAMFILE *sf_index, STREAMFILE *sf);
 static int config_sb_platform(ubi_sb_header* sb, STREAMFILE* sf);
 static int config_sb_version(ubi_sb_header* sb, STREAMFILE* sf);
 
 
+/* Subsong locations of the last opened banks/maps, as hashes of their name and size, so opening
+ * subsong N of a bank with thousands of them only parses its header instead of walking all section2
+ * tables again. Only enabled with vgmstream_ubi_sb_index_setup. Older banks are dropped. */
+#define UBI_SB_INDEX_SIZE 8
+
+static struct {
+    int enabled;
+    struct {
+        uint64_t key;
+        int total_subsongs;
+        ubi_sb_location* locations;
+    } banks[UBI_SB_INDEX_SIZE];
+    int count;
+    int next;
+    void (*lock)(void*);
+    void (*unlock)(void*);
+    void* lock_data;
+} ubi_sb_index;
+
+void vgmstream_ubi_sb_index_setup(int enabled, void (*lock)(void*), void (*unlock)(void*), void* lock_data) {
+    int i;
+
+    for (i = 0; i < ubi_sb_index.count; i++) {
+        free(ubi_sb_index.banks[i].locations);
+        ubi_sb_index.banks[i].locations = NULL;
+    }
+
+    ubi_sb_index.enabled = enabled;
+    ubi_sb_index.count = 0;
+    ubi_sb_index.next = 0;
+    ubi_sb_index.lock = lock;
+    ubi_sb_index.unlock = unlock;
+    ubi_sb_index.lock_data = lock_data;
+}
+
+static uint64_t ubi_sb_index_key(STREAMFILE* sf) {
+    char filename[PATH_LIMIT];
+    uint64_t hash = 0xCBF29CE484222325ULL; /* FNV-1a */
+    int i;
+
+    get_streamfile_name(sf, filename, sizeof(filename));
+    for (i = 0; filename[i]; i++) {
+        hash = (hash ^ (uint8_t)filename[i]) * 0x100000001B3ULL;
+    }
+    return (hash ^ get_streamfile_size(sf)) * 0x100000001B3ULL;
+}
+
+/* find target_subsong's location, returns 1 (and the bank's subsongs) if the bank is indexed */
+static int ubi_sb_index_get(uint64_t key, int target_subsong, ubi_sb_location* location, int* total_subsongs) {
+    int i, found = 0;
+
+    if (!ubi_sb_index.enabled)
+        return 0;
+
+    if (ubi_sb_index.lock)
+        ubi_sb_index.lock(ubi_sb_index.lock_data);
+    for (i = 0; i < ubi_sb_index.count; i++) {
+        if (ubi_sb_index.banks[i].key == key) {
+            found = 1;
+            *total_subsongs = ubi_sb_index.banks[i].total_subsongs;
+            if (target_subsong > 0 && target_subsong <= *total_subsongs)
+                *location = ubi_sb_index.banks[i].locations[target_subsong - 1];
+            break;
+        }
+    }
+    if (ubi_sb_index.unlock)
+        ubi_sb_index.unlock(ubi_sb_index.lock_data);
+
+    return found;
+}
+
+/* store a fully parsed bank's locations (the index takes them) */
+static void ubi_sb_index_put(uint64_t key, ubi_sb_location* locations, int total_subsongs) {
+    ubi_sb_location* old = NULL;
+    int i;
+
+    if (!ubi_sb_index.enabled) {
+        free(locations);
+        return;
+    }
+
+    if (ubi_sb_index.lock)
+        ubi_sb_index.lock(ubi_sb_index.lock_data);
+    for (i = 0; i < ubi_sb_index.count; i++) {
+        if (ubi_sb_index.banks[i].key == key)
+            break;
+    }
+    if (i == ubi_sb_index.count) {
+        i = ubi_sb_index.next;
+        ubi_sb_index.next = (ubi_sb_index.next + 1) % UBI_SB_INDEX_SIZE;
+        if (ubi_sb_index.count < UBI_SB_INDEX_SIZE)
+            ubi_sb_index.count++;
+    }
+    old = ubi_sb_index.banks[i].locations;
+    ubi_sb_index.banks[i].key = key;
+    ubi_sb_index.banks[i].total_subsongs = total_subsongs;
+    ubi_sb_index.banks[i].locations = locations;
+    if (ubi_sb_index.unlock)
+        ubi_sb_index.unlock(ubi_sb_index.lock_data);
+
+    free(old);
+}
+
+/* record where the last counted subsong is, for the bank index */
+static int add_sb_location(ubi_sb_header* sb, int header_index) {
+    if (sb->total_subsongs > sb->locations_max) {
+        int locations_max = sb->locations_max ? sb->locations_max * 2 : 256;
+        ubi_sb_location* locations = realloc(sb->locations, locations_max * sizeof(ubi_sb_location));
+        if (!locations) return 0;
+
+        sb->locations = locations;
+        sb->locations_max = locations_max;
+    }
+
+    sb->locations[sb->total_subsongs - 1].map_index = sb->map_index;
+    sb->locations[sb->total_subsongs - 1].header_index = header_index;
+    return 1;
+}
+
+
 /* .SBx - banks from Ubisoft's DARE (Digital Audio Rendering Engine) engine games in ~2000-2008+ */
 VGMSTREAM* init_vgmstream_ubi_sb(STREAMFILE* sf) {
     VGMSTREAM* vgmstream = NULL;
@@ -281,7 +416,7 @@ VGMSTREAM* init_vgmstream_ubi_sb(STREAMFILE* sf) {
     if (sb.cfg.is_padded_section3_offset)
         sb.section3_offset = align_size_to_block(sb.section3_offset, 0x10);
 
-    if (!parse_sb(&sb, sf_index, target_subsong))
+    if (!parse_sb_indexed(&sb, sf_index, sf, target_subsong))
         goto fail;
 
     /* CREATE VGMSTREAM */
@@ -300,6 +435,8 @@ VGMSTREAM* init_vgmstream_ubi_sm(STREAMFILE* sf) {
     STREAMFILE* sf_index = NULL;
     int32_t(*read_32bit)(off_t, STREAMFILE*) = NULL;
     ubi_sb_header sb = {0}, target_sb = {0};
+    ubi_sb_location location;
+    uint64_t key;
     int target_subsong = sf->stream_index;
     int i;
 
@@ -336,59 +473,38 @@ VGMSTREAM* init_vgmstream_ubi_sm(STREAMFILE* sf) {
         goto fail;
 
 
-    for (i = 0; i < sb.map_num; i++) {
-        off_t offset = sb.map_start + i * sb.cfg.map_entry_size;
-
-        /* SUBMAP HEADER */
-        sb.map_type     = read_32bit(offset + 0x00, sf); /* usually 0/1=first, 0=rest */
-        sb.map_zero     = read_32bit(offset + 0x04, sf);
-        sb.map_offset   = read_32bit(offset + 0x08, sf);
-        sb.map_size     = read_32bit(offset + 0x0c, sf); /* includes sbX header, but not internal streams */
-        read_string(sb.map_name, sizeof(sb.map_name), offset + 0x10, sf); /* null-terminated and may contain garbage after null */
-        if (sb.cfg.map_version >= 3)
-            sb.map_unknown  = read_32bit(offset + 0x30, sf); /* uncommon, id/config? longer name? mem garbage? */
-
-        /* SB HEADER */
-        /* SBx layout: base header, section1, section2, section4, extra section, section3, data (all except header can be null?) */
-        sb.version_empty    = read_32bit(sb.map_offset + 0x00, sf); /* sbX in maps don't set version */
-        sb.section1_offset  = read_32bit(sb.map_offset + 0x04, sf) + sb.map_offset;
-        sb.section1_num     = read_32bit(sb.map_offset + 0x08, sf);
-        sb.section2_offset  = read_32bit(sb.map_offset + 0x0c, sf) + sb.map_offset;
-        sb.section2_num     = read_32bit(sb.map_offset + 0x10, sf);
-
-        if (sb.cfg.map_version < 3) {
-            sb.section3_offset  = read_32bit(sb.map_offset + 0x14, sf) + sb.map_offset;
-            sb.section3_num     = read_32bit(sb.map_offset + 0x18, sf);
-            sb.sectionX_offset  = read_32bit(sb.map_offset + 0x1c, sf) + sb.map_offset;
-            sb.sectionX_size    = read_32bit(sb.map_offset + 0x20, sf);
-        } else {
-            sb.section4_offset  = read_32bit(sb.map_offset + 0x14, sf);
-            sb.section4_num     = read_32bit(sb.map_offset + 0x18, sf);
-            sb.section3_offset  = read_32bit(sb.map_offset + 0x1c, sf) + sb.map_offset;
-            sb.section3_num     = read_32bit(sb.map_offset + 0x20, sf);
-            sb.sectionX_offset  = read_32bit(sb.map_offset + 0x24, sf) + sb.map_offset;
-            sb.sectionX_size    = read_32bit(sb.map_offset + 0x28, sf);
-
-            /* latest map format has another section with sounds after section 2 */
-            sb.section2_num    += sb.section4_num;    /* let's just merge it with section 2 */
-            sb.sectionX_offset += sb.section4_offset; /* for some reason, this is relative to section 4 here */
+    /* known maps go straight to the target's submap and header */
+    key = ubi_sb_index_key(sf);
+    if (ubi_sb_index_get(key, target_subsong, &location, &sb.total_subsongs)) {
+        if (target_subsong <= sb.total_subsongs) {
+            parse_sm_submap(&sb, sf, location.map_index);
+            if (!parse_sb_location(&sb, sf_index, &location))
+                goto fail;
+            target_sb = sb; /* memcpy */
         }
+    }
+    else {
+        sb.is_indexing = ubi_sb_index.enabled;
+        for (i = 0; i < sb.map_num; i++) {
+            parse_sm_submap(&sb, sf, i);
 
-        VGM_ASSERT(sb.map_type != 0 && sb.map_type != 1, "UBI SM: unknown map_type at %x\n", (uint32_t)offset);
-        VGM_ASSERT(sb.map_zero != 0, "UBI SM: unknown map_zero at %x\n", (uint32_t)offset);
-        //;VGM_ASSERT(sb.map_unknown != 0, "UBI SM: unknown map_unknown at %x\n", (uint32_t)offset);
-        VGM_ASSERT(sb.version_empty != 0, "UBI SM: unknown version_empty at %x\n", (uint32_t)offset);
+            if (!parse_sb(&sb, sf_index, target_subsong))
+                goto fail;
 
-        if (!parse_sb(&sb, sf_index, target_subsong))
-            goto fail;
+            /* snapshot of current sb if subsong was found
+             * (it gets rewritten and we need exact values for sequences and stuff) */
+            if (sb.type != UBI_NONE) {
+                target_sb = sb; /* memcpy */
+                sb.type = UBI_NONE; /* reset parsed flag */
+            }
+        }
 
-        /* snapshot of current sb if subsong was found
-         * (it gets rewritten and we need exact values for sequences and stuff) */
-        if (sb.type != UBI_NONE) {
-            target_sb = sb; /* memcpy */
-            sb.type = UBI_NONE; /* reset parsed flag */
+        if (sb.is_indexing) {
+            ubi_sb_index_put(key, sb.locations, sb.total_subsongs);
+            sb.locations = NULL;
         }
     }
+    target_sb.locations = NULL;
 
     target_sb.total_subsongs = sb.total_subsongs;
 
@@ -398,6 +514,7 @@ VGMSTREAM* init_vgmstream_ubi_sm(STREAMFILE* sf) {
     return vgmstream;
 
 fail:
+    free(sb.locations);
     close_streamfile(sf_index);
     return NULL;
 }
@@ -429,7 +546,7 @@ VGMSTREAM* init_vgmstream_ubi_bnm(STREAMFILE* sf) {
     sf_index = reopen_streamfile(sf, 0x100);
     if (!sf_index) goto fail;
 
-    if (!parse_sb(&sb, sf_index, target_subsong))
+    if (!parse_sb_indexed(&sb, sf_index, sf, target_subsong))
         goto fail;
 
     /* CREATE VGMSTREAM */
@@ -2533,6 +2650,8 @@ static int parse_sb(ubi_sb_header* sb, STREAMFILE* sf, int target_subsong) {
 
         sb->bank_subsongs++;
         sb->total_subsongs++;
+        if (sb->is_indexing && !add_sb_location(sb, i))
+            goto fail;
         if (sb->total_subsongs != target_subsong)
             continue;
 
@@ -2551,6 +2670,90 @@ fail:
     return 0;
 }
 
+/* parse a known subsong's header directly (sb must be set up for its bank/submap) */
+static int parse_sb_location(ubi_sb_header* sb, STREAMFILE* sf, const ubi_sb_location* location) {
+    off_t offset = sb->section2_offset + sb->cfg.section2_entry_size * location->header_index;
+
+    if (!parse_header(sb, sf, offset, location->header_index))
+        return 0;
+
+    build_readable_name(sb->readable_name, sizeof(sb->readable_name), sb);
+    return 1;
+}
+
+/* same as parse_sb for single banks, but through the bank index when it knows the bank */
+static int parse_sb_indexed(ubi_sb_header* sb, STREAMFILE* sf_index, STREAMFILE* sf, int target_subsong) {
+    ubi_sb_location location;
+    uint64_t key = ubi_sb_index_key(sf);
+
+    if (ubi_sb_index_get(key, target_subsong, &location, &sb->total_subsongs)) {
+        if (target_subsong > sb->total_subsongs)
+            return 1; /* not found, handled externally */
+        return parse_sb_location(sb, sf_index, &location);
+    }
+
+    sb->is_indexing = ubi_sb_index.enabled;
+    if (!parse_sb(sb, sf_index, target_subsong)) {
+        free(sb->locations);
+        sb->locations = NULL;
+        return 0;
+    }
+
+    if (sb->is_indexing) {
+        ubi_sb_index_put(key, sb->locations, sb->total_subsongs);
+        sb->locations = NULL;
+    }
+    return 1;
+}
+
+/* read a map's submap header and its sbX header */
+static void parse_sm_submap(ubi_sb_header* sb, STREAMFILE* sf, int map_index) {
+    int32_t (*read_32bit)(off_t,STREAMFILE*) = sb->big_endian ? read_32bitBE : read_32bitLE;
+    off_t offset = sb->map_start + map_index * sb->cfg.map_entry_size;
+
+    /* SUBMAP HEADER */
+    sb->map_type     = read_32bit(offset + 0x00, sf); /* usually 0/1=first, 0=rest */
+    sb->map_zero     = read_32bit(offset + 0x04, sf);
+    sb->map_offset   = read_32bit(offset + 0x08, sf);
+    sb->map_size     = read_32bit(offset + 0x0c, sf); /* includes sbX header, but not internal streams */
+    read_string(sb->map_name, sizeof(sb->map_name), offset + 0x10, sf); /* null-terminated and may contain garbage after null */
+    if (sb->cfg.map_version >= 3)
+        sb->map_unknown  = read_32bit(offset + 0x30, sf); /* uncommon, id/config? longer name? mem garbage? */
+
+    /* SB HEADER */
+    /* SBx layout: base header, section1, section2, section4, extra section, section3, data (all except header can be null?) */
+    sb->version_empty    = read_32bit(sb->map_offset + 0x00, sf); /* sbX in maps don't set version */
+    sb->section1_offset  = read_32bit(sb->map_offset + 0x04, sf) + sb->map_offset;
+    sb->section1_num     = read_32bit(sb->map_offset + 0x08, sf);
+    sb->section2_offset  = read_32bit(sb->map_offset + 0x0c, sf) + sb->map_offset;
+    sb->section2_num     = read_32bit(sb->map_offset + 0x10, sf);
+
+    if (sb->cfg.map_version < 3) {
+        sb->section3_offset  = read_32bit(sb->map_offset + 0x14, sf) + sb->map_offset;
+        sb->section3_num     = read_32bit(sb->map_offset + 0x18, sf);
+        sb->sectionX_offset  = read_32bit(sb->map_offset + 0x1c, sf) + sb->map_offset;
+        sb->sectionX_size    = read_32bit(sb->map_offset + 0x20, sf);
+    } else {
+        sb->section4_offset  = read_32bit(sb->map_offset + 0x14, sf);
+        sb->section4_num     = read_32bit(sb->map_offset + 0x18, sf);
+        sb->section3_offset  = read_32bit(sb->map_offset + 0x1c, sf) + sb->map_offset;
+        sb->section3_num     = read_32bit(sb->map_offset + 0x20, sf);
+        sb->sectionX_offset  = read_32bit(sb->map_offset + 0x24, sf) + sb->map_offset;
+        sb->sectionX_size    = read_32bit(sb->map_offset + 0x28, sf);
+
+        /* latest map format has another section with sounds after section 2 */
+        sb->section2_num    += sb->section4_num;    /* let's just merge it with section 2 */
+        sb->sectionX_offset += sb->section4_offset; /* for some reason, this is relative to section 4 here */
+    }
+
+    VGM_ASSERT(sb->map_type != 0 && sb->map_type != 1, "UBI SM: unknown map_type at %x\n", (uint32_t)offset);
+    VGM_ASSERT(sb->map_zero != 0, "UBI SM: unknown map_zero at %x\n", (uint32_t)offset);
+    //;VGM_ASSERT(sb->map_unknown != 0, "UBI SM: unknown map_unknown at %x\n", (uint32_t)offset);
+    VGM_ASSERT(sb->version_empty != 0, "UBI SM: unknown version_empty at %x\n", (uint32_t)offset);
+
+    sb->map_index = map_index;
+}
+
 /* ************************************************************************* */
 
 static int config_sb_platform(ubi_sb_header* sb, STREAMFILE* sf) {
@@ -410,7 +410,7 @@ static STREAMFILE* setup_ubi_sb_streamfile(STREAMFILE *streamFile, off_t stream_
     if (!new_streamFile) goto fail;
     temp_streamFile = new_streamFile;
 
-    new_streamFile = open_buffer_streamfile(new_streamFile,0);
+    new_streamFile = open_buffer_streamfile_adaptive(new_streamFile);
     if (!new_streamFile) goto fail;
     temp_streamFile = new_streamFile;
 
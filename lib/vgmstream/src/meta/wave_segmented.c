@@ -4,6 +4,18 @@
 
 #define MAX_SEGMENTS 4
 
+typedef struct {
+    STREAMFILE* sf;         /* own reopen, for segments closed by the layout */
+    int channel_count;
+    int sample_rate;
+    int big_endian;
+    off_t segments_offset;
+} wave_header;
+
+static VGMSTREAM* open_wave_segment(STREAMFILE* sf, const wave_header* wave, int segment);
+static VGMSTREAM* reopen_wave_segment(void* open_data, int segment);
+static void free_wave_header(void* open_data);
+
 /* .WAVE - "EngineBlack" games, segmented [Shantae and the Pirate's Curse (PC/3DS), TMNT: Danger of the Ooze (PS3/3DS)] */
 VGMSTREAM * init_vgmstream_wave_segmented(STREAMFILE *streamFile) {
     VGMSTREAM * vgmstream = NULL;
@@ -59,108 +71,28 @@ VGMSTREAM * init_vgmstream_wave_segmented(STREAMFILE *streamFile) {
     /* parse segments (usually: preload + intro + loop + ending, intro/ending may be skipped)
      * Often first segment is ADPCM and rest Ogg; may only have one segment. */
     {
-        off_t extradata_offset, table_offset, segment_offset;
-        size_t segment_size;
-        int32_t segment_samples;
-        int codec;
-        int i, ch;
-
-        /* open each segment subfile */
-        for (i = 0; i < segment_count; i++) {
-            codec = read_8bit(segments_offset+0x10*i+0x00, streamFile);
-            /* 0x01(1): unknown (flag? usually 0x00/0x01/0x02) */
-            if (read_8bit(segments_offset+0x10*i+0x02, streamFile) != 0x01) goto fail; /* unknown */
-            if (read_8bit(segments_offset+0x10*i+0x03, streamFile) != 0x00) goto fail; /* unknown */
-
-            segment_samples  = read_32bit(segments_offset+0x10*i+0x04, streamFile);
-            extradata_offset = read_32bit(segments_offset+0x10*i+0x08, streamFile);
-            table_offset     = read_32bit(segments_offset+0x10*i+0x0c, streamFile);
-
-            /* create a sub-VGMSTREAM per segment
-             * (we'll reopen this streamFile as needed, so each sub-VGMSTREAM is fully independent) */
-            switch(codec) {
-                case 0x02: { /* "adpcm" */
-                    data->segments[i] = allocate_vgmstream(channel_count, 0);
-                    if (!data->segments[i]) goto fail;
-
-                    data->segments[i]->sample_rate = sample_rate;
-                    data->segments[i]->meta_type = meta_WAVE;
-                    data->segments[i]->coding_type = coding_IMA_int;
-                    data->segments[i]->layout_type = layout_none;
-                    data->segments[i]->num_samples = segment_samples;
-
-                    if (!vgmstream_open_stream(data->segments[i],streamFile,0x00))
-                        goto fail;
-
-                    /* bizarrely enough channel data isn't sequential (segment0 ch1+ may go after all other segments) */
-                    for (ch = 0; ch < channel_count; ch++) {
-                        segment_offset = read_32bit(table_offset + 0x04*ch, streamFile);
-                        data->segments[i]->ch[ch].channel_start_offset =
-                                data->segments[i]->ch[ch].offset = segment_offset;
-
-                        /* ADPCM setup */
-                        data->segments[i]->ch[ch].adpcm_history1_32 = read_16bit(extradata_offset+0x04*ch+0x00, streamFile);
-                        data->segments[i]->ch[ch].adpcm_step_index  = read_8bit(extradata_offset+0x04*ch+0x02, streamFile);
-                        /* 0x03: reserved */
-                    }
-
-                    break;
-                }
-
-                case 0x03: { /* "dsp-adpcm" */
-                    data->segments[i] = allocate_vgmstream(channel_count, 0);
-                    if (!data->segments[i]) goto fail;
-
-                    data->segments[i]->sample_rate = sample_rate;
-                    data->segments[i]->meta_type = meta_WAVE;
-                    data->segments[i]->coding_type = coding_NGC_DSP;
-                    data->segments[i]->layout_type = layout_none;
-                    data->segments[i]->num_samples = segment_samples;
-
-                    if (!vgmstream_open_stream(data->segments[i],streamFile,0x00))
-                        goto fail;
-
-                    /* bizarrely enough channel data isn't sequential (segment0 ch1+ may go after all other segments) */
-                    for (ch = 0; ch < channel_count; ch++) {
-                        segment_offset = read_32bit(table_offset + 0x04*ch, streamFile);
-                        data->segments[i]->ch[ch].channel_start_offset =
-                                data->segments[i]->ch[ch].offset = segment_offset;
-                    }
-
-                    /* ADPCM setup: 0x06 initial ps/hist1/hist2 (per channel) + 0x20 coefs (per channel) */
-                    dsp_read_hist(data->segments[i], streamFile, extradata_offset+0x02, 0x06, big_endian);
-                    dsp_read_coefs(data->segments[i], streamFile, extradata_offset+0x06*channel_count+0x00, 0x20, big_endian);
-
-                    break;
-                }
-
-#ifdef VGM_USE_VORBIS
-                case 0x04: { /* "vorbis" */
-                    ogg_vorbis_meta_info_t ovmi = {0};
-
-                    segment_offset = read_32bit(table_offset, streamFile);
-                    segment_size = read_32bitBE(segment_offset, streamFile); /* always BE */
-
-                    ovmi.meta_type = meta_WAVE;
-                    ovmi.stream_size = segment_size;
+        wave_header wave = {0};
+        int i;
 
-                    data->segments[i] = init_vgmstream_ogg_vorbis_callbacks(streamFile, NULL, segment_offset+0x04, &ovmi);
-                    if (!data->segments[i]) goto fail;
+        wave.channel_count = channel_count;
+        wave.sample_rate = sample_rate;
+        wave.big_endian = big_endian;
+        wave.segments_offset = segments_offset;
 
-                    if (data->segments[i]->num_samples != segment_samples) {
-                        VGM_LOG("WAVE: segment %i samples != num_samples\n", i);
-                        goto fail;
-                    }
+        for (i = 0; i < segment_count; i++) {
+            data->segments[i] = open_wave_segment(streamFile, &wave, i);
+            if (!data->segments[i]) goto fail;
+        }
 
-                    break;
-                }
-#endif
+        /* segments are reopened if closed after playing (intro before loop and such) */
+        data->open_data = calloc(1, sizeof(wave_header));
+        if (!data->open_data) goto fail;
+        data->free_open_data = free_wave_header;
+        memcpy(data->open_data, &wave, sizeof(wave_header));
 
-                default: /* others: s16be/s16le/mp3 as referenced in the exe? */
-                    VGM_LOG("WAVE: unknown codec\n");
-                    goto fail;
-            }
-        }
+        ((wave_header*)data->open_data)->sf = reopen_streamfile(streamFile, 0);
+        if (!((wave_header*)data->open_data)->sf) goto fail;
+        data->open_segment = reopen_wave_segment;
     }
 
     /* setup segmented VGMSTREAMs */
@@ -218,3 +150,130 @@ fail:
     close_vgmstream(vgmstream);
     return NULL;
 }
+
+
+/* create a sub-VGMSTREAM per segment (reopening the streamfile as needed, so each is fully independent) */
+static VGMSTREAM* open_wave_segment(STREAMFILE* sf, const wave_header* wave, int segment) {
+    VGMSTREAM* vgmstream = NULL;
+    off_t segments_offset = wave->segments_offset;
+    off_t extradata_offset, table_offset, segment_offset;
+    int channel_count = wave->channel_count;
+    int big_endian = wave->big_endian;
+    int32_t (*read_32bit)(off_t,STREAMFILE*) = big_endian ? read_32bitBE : read_32bitLE;
+    int16_t (*read_16bit)(off_t,STREAMFILE*) = big_endian ? read_16bitBE : read_16bitLE;
+    int32_t segment_samples;
+    int codec;
+    int ch;
+
+    codec = read_8bit(segments_offset+0x10*segment+0x00, sf);
+    /* 0x01(1): unknown (flag? usually 0x00/0x01/0x02) */
+    if (read_8bit(segments_offset+0x10*segment+0x02, sf) != 0x01) goto fail; /* unknown */
+    if (read_8bit(segments_offset+0x10*segment+0x03, sf) != 0x00) goto fail; /* unknown */
+
+    segment_samples  = read_32bit(segments_offset+0x10*segment+0x04, sf);
+    extradata_offset = read_32bit(segments_offset+0x10*segment+0x08, sf);
+    table_offset     = read_32bit(segments_offset+0x10*segment+0x0c, sf);
+
+    switch(codec) {
+        case 0x02: { /* "adpcm" */
+            vgmstream = allocate_vgmstream(channel_count, 0);
+            if (!vgmstream) goto fail;
+
+            vgmstream->sample_rate = wave->sample_rate;
+            vgmstream->meta_type = meta_WAVE;
+            vgmstream->coding_type = coding_IMA_int;
+            vgmstream->layout_type = layout_none;
+            vgmstream->num_samples = segment_samples;
+
+            if (!vgmstream_open_stream(vgmstream,sf,0x00))
+                goto fail;
+
+            /* bizarrely enough channel data isn't sequential (segment0 ch1+ may go after all other segments) */
+            for (ch = 0; ch < channel_count; ch++) {
+                segment_offset = read_32bit(table_offset + 0x04*ch, sf);
+                vgmstream->ch[ch].channel_start_offset =
+                        vgmstream->ch[ch].offset = segment_offset;
+
+                /* ADPCM setup */
+                vgmstream->ch[ch].adpcm_history1_32 = read_16bit(extradata_offset+0x04*ch+0x00, sf);
+                vgmstream->ch[ch].adpcm_step_index  = read_8bit(extradata_offset+0x04*ch+0x02, sf);
+                /* 0x03: reserved */
+            }
+
+            break;
+        }
+
+        case 0x03: { /* "dsp-adpcm" */
+            vgmstream = allocate_vgmstream(channel_count, 0);
+            if (!vgmstream) goto fail;
+
+            vgmstream->sample_rate = wave->sample_rate;
+            vgmstream->meta_type = meta_WAVE;
+            vgmstream->coding_type = coding_NGC_DSP;
+            vgmstream->layout_type = layout_none;
+            vgmstream->num_samples = segment_samples;
+
+            if (!vgmstream_open_stream(vgmstream,sf,0x00))
+                goto fail;
+
+            /* bizarrely enough channel data isn't sequential (segment0 ch1+ may go after all other segments) */
+            for (ch = 0; ch < channel_count; ch++) {
+                segment_offset = read_32bit(table_offset + 0x04*ch, sf);
+                vgmstream->ch[ch].channel_start_offset =
+                        vgmstream->ch[ch].offset = segment_offset;
+            }
+
+            /* ADPCM setup: 0x06 initial ps/hist1/hist2 (per channel) + 0x20 coefs (per channel) */
+            dsp_read_hist(vgmstream, sf, extradata_offset+0x02, 0x06, big_endian);
+            dsp_read_coefs(vgmstream, sf, extradata_offset+0x06*channel_count+0x00, 0x20, big_endian);
+
+            break;
+        }
+
+#ifdef VGM_USE_VORBIS
+        case 0x04: { /* "vorbis" */
+            ogg_vorbis_meta_info_t ovmi = {0};
+            size_t segment_size;
+
+            segment_offset = read_32bit(table_offset, sf);
+            segment_size = read_32bitBE(segment_offset, sf); /* always BE */
+
+            ovmi.meta_type = meta_WAVE;
+            ovmi.stream_size = segment_size;
+
+            vgmstream = init_vgmstream_ogg_vorbis_callbacks(sf, NULL, segment_offset+0x04, &ovmi);
+            if (!vgmstream) goto fail;
+
+            if (vgmstream->num_samples != segment_samples) {
+                VGM_LOG("WAVE: segment %i samples != num_samples\n", segment);
+                goto fail;
+            }
+
+            break;
+        }
+#endif
+
+        default: /* others: s16be/s16le/mp3 as referenced in the exe? */
+            VGM_LOG("WAVE: unknown codec\n");
+            goto fail;
+    }
+
+    return vgmstream;
+fail:
+    close_vgmstream(vgmstream);
+    return NULL;
+}
+
+static VGMSTREAM* reopen_wave_segment(void* open_data, int segment) {
+    wave_header* wave = open_data;
+    return open_wave_segment(wave->sf, wave, segment);
+}
+
+static void free_wave_header(void* open_data) {
+    wave_header* wave = open_data;
+
+    if (!wave)
+        return;
+    close_streamfile(wave->sf);
+    free(wave);
+}
@@ -17,6 +17,106 @@
 #define XNB_TYPE_LZX  1
 #define XNB_TYPE_LZ4  2
 
+#define XNB_CACHE_BLOCKS      32      /* enough for most XNB audio, so loops don't decompress again */
+#define XNB_CACHE_BLOCK_SIZE  0x10000 /* max decompressed block */
+
+/* Recently decompressed blocks, shared by reopened SFs of the same file (channels), as decompression
+ * can only go forward and seeking back would restart from the beginning. Not thread-safe. */
+typedef struct {
+    off_t logical_offset;
+    size_t size;
+    uint32_t used;
+    uint8_t* buf;
+} xnb_cached_block_t;
+
+typedef struct {
+    int refs;
+    char name[PATH_LIMIT];
+    uint32_t counter;
+    xnb_cached_block_t blocks[XNB_CACHE_BLOCKS];
+} xnb_block_cache_t;
+
+static xnb_block_cache_t* xnb_cache_open(xnb_block_cache_t* cache, STREAMFILE* sf) {
+    const char* name = get_streamfile_name_ref(sf);
+
+    if (cache && name && strcmp(cache->name, name) == 0) {
+        cache->refs++;
+        return cache;
+    }
+
+    cache = calloc(1, sizeof(xnb_block_cache_t));
+    if (!cache) return NULL;
+    cache->refs = 1;
+    if (name)
+        snprintf(cache->name, sizeof(cache->name), "%s", name);
+    return cache;
+}
+
+static void xnb_cache_close(xnb_block_cache_t* cache) {
+    int i;
+
+    if (!cache) return;
+    cache->refs--;
+    if (cache->refs > 0)
+        return;
+
+    for (i = 0; i < XNB_CACHE_BLOCKS; i++) {
+        free(cache->blocks[i].buf);
+    }
+    free(cache);
+}
+
+/* copies data at offset if some cached block has it, returns bytes done */
+static size_t xnb_cache_read(xnb_block_cache_t* cache, uint8_t* dest, off_t offset, size_t length) {
+    int i;
+
+    if (!cache) return 0;
+
+    for (i = 0; i < XNB_CACHE_BLOCKS; i++) {
+        xnb_cached_block_t* block = &cache->blocks[i];
+        size_t to_read;
+
+        if (!block->size || offset < block->logical_offset || offset >= block->logical_offset + block->size)
+            continue;
+
+        to_read = block->logical_offset + block->size - offset;
+        if (to_read > length)
+            to_read = length;
+        memcpy(dest, block->buf + (offset - block->logical_offset), to_read);
+        block->used = ++cache->counter;
+        return to_read;
+    }
+
+    return 0;
+}
+
+/* keeps a decompressed block, replacing the least recently used */
+static void xnb_cache_store(xnb_block_cache_t* cache, off_t logical_offset, const uint8_t* buf, size_t size) {
+    xnb_cached_block_t* block;
+    int i;
+
+    if (!cache || size == 0 || size > XNB_CACHE_BLOCK_SIZE)
+        return;
+
+    block = &cache->blocks[0];
+    for (i = 0; i < XNB_CACHE_BLOCKS; i++) {
+        if (cache->blocks[i].size && cache->blocks[i].logical_offset == logical_offset)
+            return; /* decompressed by another SF */
+        if (cache->blocks[i].used < block->used)
+            block = &cache->blocks[i];
+    }
+
+    if (!block->buf) {
+        block->buf = malloc(XNB_CACHE_BLOCK_SIZE);
+        if (!block->buf) return;
+    }
+
+    memcpy(block->buf, buf, size);
+    block->logical_offset = logical_offset;
+    block->size = size;
+    block->used = ++cache->counter;
+}
+
 typedef struct {
     /* config */
     int type;
@@ -33,6 +133,8 @@ typedef struct {
 
     size_t logical_size;
 
+    xnb_block_cache_t* cache;
+
     /* decompression state (dst size min for LZX) */
     uint8_t dst[0x10000];
     uint8_t src[0x10000];
@@ -50,6 +152,9 @@ static int xnb_io_init(STREAMFILE* sf, xnb_io_data* data) {
      * reset on new open so that new bufs of the clone are used. */
     data->logical_offset = -1;
 
+    /* not fatal if it fails (blocks are decompressed again as needed) */
+    data->cache = xnb_cache_open(data->cache, sf);
+
 #ifdef XNB_ENABLE_LZX
     if (data->type == XNB_TYPE_LZX) {
         data->lzxs = lzx_init(LZX_XNB_WINDOW_BITS);
@@ -62,6 +167,9 @@ static int xnb_io_init(STREAMFILE* sf, xnb_io_data* data) {
 }
 
 static void xnb_io_close(STREAMFILE* sf, xnb_io_data* data) {
+    xnb_cache_close(data->cache);
+    data->cache = NULL;
+
 #ifdef XNB_ENABLE_LZX
     if (data->type == XNB_TYPE_LZX) {
         lzx_teardown(data->lzxs);
@@ -163,25 +271,37 @@ fail:
 static size_t xnb_io_read(STREAMFILE* sf, uint8_t *dest, off_t offset, size_t length, xnb_io_data* data) {
     size_t total_read = 0;
 
-    /* reset */
-    if (data->logical_offset < 0 || offset < data->logical_offset) {
-        data->physical_offset = 0x00;
-        data->logical_offset = 0x00;
-        data->block_size = 0;
-        data->data_size = 0;
-        data->skip_size = 0;
+    /* read blocks, one at a time */
+    while (length > 0) {
 
-        switch(data->type) {
+        /* use blocks decompressed before if possible (decompression state stays as-is) */
+        if (offset >= data->compression_start) {
+            size_t bytes_done = xnb_cache_read(data->cache, dest, offset, length);
+            if (bytes_done > 0) {
+                total_read += bytes_done;
+                dest += bytes_done;
+                offset += bytes_done;
+                length -= bytes_done;
+                continue;
+            }
+        }
+
+        /* reset */
+        if (data->logical_offset < 0 || offset < data->logical_offset) {
+            data->physical_offset = 0x00;
+            data->logical_offset = 0x00;
+            data->block_size = 0;
+            data->data_size = 0;
+            data->skip_size = 0;
+
+            switch(data->type) {
 #ifdef XNB_ENABLE_LZX
-            case XNB_TYPE_LZX: lzx_reset(data->lzxs); break;
+                case XNB_TYPE_LZX: lzx_reset(data->lzxs); break;
 #endif
-            case XNB_TYPE_LZ4: lz4mg_reset(&data->lz4s); break;
-            default: break;
+                case XNB_TYPE_LZ4: lz4mg_reset(&data->lz4s); break;
+                default: break;
+            }
         }
-    }
-
-    /* read blocks, one at a time */
-    while (length > 0) {
 
         /* ignore EOF */
         if (offset < 0 || data->logical_offset >= data->logical_size) {
@@ -213,6 +333,8 @@ static size_t xnb_io_read(STREAMFILE* sf, uint8_t *dest, off_t offset, size_t le
                     VGM_LOG("XNB: decompression error\n");
                     break;
                 }
+
+                xnb_cache_store(data->cache, data->logical_offset, data->dst + data->skip_size, data->data_size);
             }
         }
 
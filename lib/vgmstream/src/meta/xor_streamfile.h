@@ -0,0 +1,46 @@
+#ifndef _XOR_STREAMFILE_H_
+#define _XOR_STREAMFILE_H_
+#include "../streamfile.h"
+#include "../cpu.h"
+
+/* Shared helpers for decryption streamfiles that XOR data with a rolling key. The key is repeated
+ * into a keystream, so data is XORed in big blocks (see cpu.c kernels) rather than per byte. */
+
+#define XOR_KEY_MAX         0x200
+#define XOR_KEY_STREAM_SIZE 0x1000
+
+typedef struct {
+    uint8_t stream[XOR_KEY_STREAM_SIZE];
+    size_t key_size;
+    size_t block_size; /* multiple of key_size, so the key position is the same after each block */
+} xor_key_t;
+
+/* returns 0 if key is too big (or empty) */
+static int xor_key_init(xor_key_t* xk, const uint8_t* key, size_t key_size) {
+    size_t i;
+
+    if (key_size == 0 || key_size > XOR_KEY_MAX)
+        return 0;
+
+    for (i = 0; i < sizeof(xk->stream); i++) {
+        xk->stream[i] = key[i % key_size];
+    }
+    xk->key_size = key_size;
+    xk->block_size = (sizeof(xk->stream) - key_size) / key_size * key_size;
+    return 1;
+}
+
+/* XORs buf with the key, starting from key_pos (usually offset % key_size) */
+static void xor_key_apply(const xor_key_t* xk, uint8_t* buf, size_t size, size_t key_pos) {
+    const vgm_kernels_t* kernels = vgm_get_kernels();
+    const uint8_t* stream = xk->stream + (key_pos % xk->key_size);
+
+    while (size > 0) {
+        size_t block = size > xk->block_size ? xk->block_size : size;
+        kernels->xor_bytes(buf, stream, block);
+        buf += block;
+        size -= block;
+    }
+}
+
+#endif /* _XOR_STREAMFILE_H_ */
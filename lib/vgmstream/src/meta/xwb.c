@@ -1,6 +1,7 @@
 #include "meta.h"
 #include "../coding/coding.h"
 #include <string.h>
+#include <ctype.h>
 #include "xwb_xsb.h"
 
 /* most info from XWBtool, xactwb.h, xact2wb.h and xact3wb.h */
@@ -620,24 +621,146 @@ fail:
     return 0;
 }
 
+/* Stream names of the last few .xsb, as hashes of their name and size + the .xwb wavebank name (a .xsb
+ * may have cues for several), so each subsong doesn't parse all cues again. Only enabled with
+ * vgmstream_xsb_name_cache_setup. Older .xsb are dropped. */
+#define XSB_NAME_CACHE_SIZE 4
+
+static struct {
+    int enabled;
+    struct {
+        uint64_t key;
+        int version;
+        char **names;
+    } entries[XSB_NAME_CACHE_SIZE];
+    int count;
+    int next;
+    void (*lock)(void*);
+    void (*unlock)(void*);
+    void* lock_data;
+} xsb_name_cache;
+
+void vgmstream_xsb_name_cache_setup(int enabled, void (*lock)(void*), void (*unlock)(void*), void* lock_data) {
+    int i;
+
+    for (i = 0; i < xsb_name_cache.count; i++) {
+        free_xsb_names(xsb_name_cache.entries[i].names);
+        xsb_name_cache.entries[i].names = NULL;
+    }
+
+    xsb_name_cache.enabled = enabled;
+    xsb_name_cache.count = 0;
+    xsb_name_cache.next = 0;
+    xsb_name_cache.lock = lock;
+    xsb_name_cache.unlock = unlock;
+    xsb_name_cache.lock_data = lock_data;
+}
+
+static uint64_t xsb_name_cache_key(STREAMFILE *sf, const char *wavebank_name) {
+    char filename[PATH_LIMIT];
+    uint64_t hash = 0xCBF29CE484222325ULL; /* FNV-1a */
+    int i;
+
+    get_streamfile_name(sf, filename, sizeof(filename));
+    for (i = 0; filename[i]; i++) {
+        hash = (hash ^ (uint8_t)filename[i]) * 0x100000001B3ULL;
+    }
+    hash = (hash ^ get_streamfile_size(sf)) * 0x100000001B3ULL;
+    for (i = 0; wavebank_name[i]; i++) {
+        hash = (hash ^ (uint8_t)tolower(wavebank_name[i])) * 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+/* copy stream's name (empty if none), returns 1 if the .xsb is known */
+static int xsb_name_cache_get(uint64_t key, int stream, char *name, size_t name_size, int *version) {
+    int i, found = 0;
+
+    if (!xsb_name_cache.enabled)
+        return 0;
+
+    if (xsb_name_cache.lock)
+        xsb_name_cache.lock(xsb_name_cache.lock_data);
+    for (i = 0; i < xsb_name_cache.count; i++) {
+        if (xsb_name_cache.entries[i].key == key) {
+            found = 1;
+            *version = xsb_name_cache.entries[i].version;
+            name[0] = '\0';
+            if (xsb_name_cache.entries[i].names && stream >= 0 && stream < XSB_MAX_STREAMS && xsb_name_cache.entries[i].names[stream])
+                snprintf(name, name_size, "%s", xsb_name_cache.entries[i].names[stream]);
+            break;
+        }
+    }
+    if (xsb_name_cache.unlock)
+        xsb_name_cache.unlock(xsb_name_cache.lock_data);
+
+    return found;
+}
+
+/* store a parsed .xsb's names (the cache takes them) */
+static void xsb_name_cache_put(uint64_t key, char **names, int version) {
+    char **old_names = NULL;
+    int i;
+
+    if (!xsb_name_cache.enabled) {
+        free_xsb_names(names);
+        return;
+    }
+
+    if (xsb_name_cache.lock)
+        xsb_name_cache.lock(xsb_name_cache.lock_data);
+    for (i = 0; i < xsb_name_cache.count; i++) {
+        if (xsb_name_cache.entries[i].key == key)
+            break;
+    }
+    if (i == xsb_name_cache.count) {
+        i = xsb_name_cache.next;
+        xsb_name_cache.next = (xsb_name_cache.next + 1) % XSB_NAME_CACHE_SIZE;
+        if (xsb_name_cache.count < XSB_NAME_CACHE_SIZE)
+            xsb_name_cache.count++;
+    }
+    old_names = xsb_name_cache.entries[i].names;
+    xsb_name_cache.entries[i].key = key;
+    xsb_name_cache.entries[i].version = version;
+    xsb_name_cache.entries[i].names = names;
+    if (xsb_name_cache.unlock)
+        xsb_name_cache.unlock(xsb_name_cache.lock_data);
+
+    free_xsb_names(old_names);
+}
+
 static int get_xsb_name(char * buf, size_t maxsize, int target_subsong, xwb_header * xwb, STREAMFILE *streamFile) {
-    xsb_header xsb = {0};
+    char name[STREAM_NAME_SIZE];
+    int stream = target_subsong - 1;
+    int version = 0;
+    uint64_t key;
 
-    xsb.selected_stream = target_subsong - 1;
-    if (!parse_xsb(&xsb, streamFile, xwb->wavebank_name))
-        goto fail;
+    key = xsb_name_cache_key(streamFile, xwb->wavebank_name);
+    if (!xsb_name_cache_get(key, stream, name, sizeof(name), &version)) {
+        xsb_header xsb = {0};
+
+        if (!parse_xsb(&xsb, streamFile, xwb->wavebank_name)) {
+            free_xsb_names(xsb.names);
+            goto fail;
+        }
+
+        version = xsb.version;
+        name[0] = '\0';
+        if (xsb.names && stream >= 0 && stream < XSB_MAX_STREAMS && xsb.names[stream])
+            snprintf(name, sizeof(name), "%s", xsb.names[stream]);
+        xsb_name_cache_put(key, xsb.names, version);
+    }
 
-    if ((xwb->version <= XACT1_1_MAX && xsb.version > XSB_XACT1_2_MAX) ||
-        (xwb->version <= XACT2_2_MAX && xsb.version > XSB_XACT2_MAX)) {
-        VGM_LOG("XSB: mismatched XACT versions: xsb v%i vs xwb v%i\n", xsb.version, xwb->version);
+    if ((xwb->version <= XACT1_1_MAX && version > XSB_XACT1_2_MAX) ||
+        (xwb->version <= XACT2_2_MAX && version > XSB_XACT2_MAX)) {
+        VGM_LOG("XSB: mismatched XACT versions: xsb v%i vs xwb v%i\n", version, xwb->version);
         goto fail;
     }
 
-    //;VGM_LOG("XSB: name found=%i at %lx\n", xsb.parse_found, xsb.name_offset);
-    if (!xsb.name_len || xsb.name[0] == '\0')
+    if (name[0] == '\0')
         goto fail;
 
-    strncpy(buf,xsb.name,maxsize);
+    strncpy(buf,name,maxsize);
     buf[maxsize-1] = '\0';
     return 1;
 fail:
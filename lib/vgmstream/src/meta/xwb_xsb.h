@@ -7,10 +7,11 @@
 #define XSB_XACT1_2_MAX 11      /* other Xbox games */
 #define XSB_XACT2_MAX   41      /* other PC/X360 games */
 
+#define XSB_MAX_STREAMS 0x1000
+
 
 typedef struct {
     /* config */
-    int selected_stream;
     int selected_wavebank;
 
     /* state */
@@ -35,8 +36,7 @@ typedef struct {
 
     /* output */
     int parse_done;
-    char name[STREAM_NAME_SIZE];
-    int name_len;
+    char **names;               /* per stream in the selected wavebank (XSB_MAX_STREAMS), NULL if none */
 
 } xsb_header;
 
@@ -44,40 +44,45 @@ typedef struct {
 static void xsb_check_stream(xsb_header *xsb, int stream_index, int wavebank_index, off_t name_offset, STREAMFILE *sf) {
     if (xsb->parse_done)
         return;
-    //;VGM_LOG("XSB old: found stream=%i vs %i, wavebank=%i vs %i, name_offset=%lx\n", stream_index, xsb->selected_stream, wavebank_index, xsb->selected_wavebank, name_offset);
+    //;VGM_LOG("XSB old: found stream=%i, wavebank=%i vs %i, name_offset=%lx\n", stream_index, wavebank_index, xsb->selected_wavebank, name_offset);
 
-    if (stream_index < 0 || stream_index > 0xFFF || wavebank_index < 0 || wavebank_index > xsb->wavebanks_count) {
+    if (stream_index < 0 || stream_index >= XSB_MAX_STREAMS || wavebank_index < 0 || wavebank_index > xsb->wavebanks_count) {
         VGM_LOG("XSB old: bad stream=%i, wavebank=%i\n", stream_index, wavebank_index);
         return;
     }
 
 
     /* multiple names may correspond to a stream (ex. Blue Dragon), so we concat all */
-    if (xsb->selected_stream == stream_index &&
-            (xsb->selected_wavebank == wavebank_index || wavebank_index == -1 || wavebank_index == 255)) {
+    if (xsb->selected_wavebank == wavebank_index || wavebank_index == -1 || wavebank_index == 255) {
         char name[STREAM_NAME_SIZE];
-        size_t name_size;
+        char *stream_name = xsb->names[stream_index];
+        size_t name_size, len;
 
         name_size = read_string(name,sizeof(name), name_offset, sf); /* null-terminated */
-
-        if (xsb->name_len) {
-            const char *cat = "; ";
-            int cat_len = 2;
-
-            if (xsb->name_len + cat_len + name_size + 1 < STREAM_NAME_SIZE) {
-                strcat(xsb->name + xsb->name_len, cat);
-                strcat(xsb->name + xsb->name_len, name);
-            }
-        }
-        else {
-            strcpy(xsb->name, name);
-        }
-        xsb->name_len += name_size;
+        len = stream_name ? strlen(stream_name) : 0;
+        if (len && len + 2 + name_size + 1 >= STREAM_NAME_SIZE)
+            return;
+
+        stream_name = realloc(stream_name, len + 2 + name_size + 1);
+        if (!stream_name) return;
+        sprintf(stream_name + len, "%s%s", len ? "; " : "", name);
+        xsb->names[stream_index] = stream_name;
         //xsb->parse_done = 1; /* uncomment this to stop reading after first name */
         //;VGM_LOG("XSB: parse found stream=%i, wavebank=%i, name_offset=%lx\n", stream_index, wavebank_index, name_offset);
     }
 }
 
+static void free_xsb_names(char **names) {
+    int i;
+
+    if (!names)
+        return;
+    for (i = 0; i < XSB_MAX_STREAMS; i++) {
+        free(names[i]);
+    }
+    free(names);
+}
+
 
 static int parse_xsb_old_cue_entry(xsb_header *xsb, STREAMFILE *sf, off_t name_offset, int entry) {
     int32_t  (*read_s32)(off_t,STREAMFILE*) = xsb->big_endian ? read_s32be : read_s32le;
@@ -862,7 +867,10 @@ static int parse_xsb(xsb_header *xsb, STREAMFILE *sf, char *xwb_wavebank_name) {
     }
 
 
-    /* find cue pointing to stream */
+    /* find cues pointing to each stream */
+    xsb->names = calloc(XSB_MAX_STREAMS, sizeof(char*));
+    if (!xsb->names) goto fail;
+
     if (xsb->version <= XSB_XACT1_2_MAX) {
         parse_xsb_old_cues(xsb, sf);
     }
@@ -1,6 +1,8 @@
 #include "vgmstream.h"
 #include "mixing.h"
 #include "plugins.h"
+#include "pool.h"
+#include "cpu.h"
 #include <math.h>
 #include <limits.h>
 
@@ -29,23 +31,22 @@
  * to update all plugins, while allowing internal setup and layer/segment mixing
  * (may change in the future for simpler usage).
  *
+ * On activation the mixing chain is compiled into block ops (see compile_mixing).
  * Then after decoding normally, vgmstream applies mixing internally:
  * - detect if mixing is active and needs to be done at this point (some effects
  *   like fades only apply after certain time) and skip otherwise.
  * - copy outbuf to mixbuf, as using a float buffer to increase accuracy (most ops
  *   apply float volumes) and slightly improve performance (avoids doing
  *   int16-to-float casts per mix, as it's not free)
- * - apply all mixes on mixbuf
+ * - apply all ops on mixbuf
  * - copy mixbuf to outbuf
  * segmented/layered layouts handle mixing on their own.
  *
- * Mixing is tuned for most common case (no mix except fade-out at the end) and is
- * fast enough but not super-optimized yet, there is some penalty the more effects
- * are applied. Maybe could add extra sub-ops to avoid ifs and dumb values (volume=0.0
- * could simply use a clear op), only use mixbuf if necessary (swap can be done without
- * mixbuf if it goes first) or add function pointer indexes but isn't too important.
- * Operations are applied once per "step" with 1 sample from all channels to simplify code
- * (and maybe improve memory cache?), though maybe it should call one function per operation.
+ * mixbuf keeps each channel in its own plane, so every op is one loop over the whole
+ * block rather than interpreting the chain once per sample. Since ops only move
+ * channels between planes or apply volumes per sample, results are the same as
+ * applying the chain to 1 sample from all channels at a time (save rounding of
+ * folded volumes, see compile_mixing).
  */
 
 #define VGMSTREAM_MAX_MIXING 512
@@ -81,6 +82,45 @@ typedef struct {
     int32_t time_post;  /* position after time_end where vol_end applies (-1 = end) */
 } mix_command_data;
 
+/* Mixing chain compiled to ops over whole blocks (see compile_mixing). Channels are kept in
+ * separate planes of mixbuf, so moving channels around is resolved on setup and ops are simple
+ * loops over contiguous samples (that compilers can vectorize). */
+typedef enum {
+    MIXOP_ADD,          /* dst += src * vol */
+    MIXOP_VOLUME,       /* dst *= vol */
+    MIXOP_CLEAR,        /* dst = 0 (inserted channel) */
+    MIXOP_LIMIT,        /* dst clamped to vol * 16-bit range */
+    MIXOP_FADE_GAIN,    /* calculates gains of mixing_chain[mix] for this block */
+    MIXOP_FADE,         /* dst *= last calculated gains */
+    MIXOP_MATRIX        /* rows: each dst = sum of src * vol terms (all from planes before the op) */
+} mix_op_t;
+
+typedef struct {
+    mix_op_t op;
+    int dst;            /* plane */
+    int src;            /* plane */
+    float vol;
+    int mix;            /* fade command */
+    int row_start;      /* matrix rows */
+    int row_count;
+} mix_op_data;
+
+typedef struct {
+    int dst;            /* plane */
+    int term_start;
+    int term_count;
+} mix_row_data;
+
+typedef struct {
+    int src;            /* plane */
+    float vol;
+} mix_term_data;
+
+#define MIXING_MATRIX_SAMPLES 256 /* matrix rows are calculated in chunks of this */
+
+#define MIXING_FADE_TABLE_SIZE 1024 /* curve points (plus end) of costly fade shapes */
+#define MIXING_FADE_TABLES 5
+
 typedef struct {
     int mixing_channels;    /* max channels needed to mix */
     int output_channels;    /* resulting channels after mixing */
@@ -88,31 +128,63 @@ typedef struct {
     int mixing_count;       /* mixing number */
     size_t mixing_size;     /* mixing max */
     mix_command_data mixing_chain[VGMSTREAM_MAX_MIXING]; /* effects to apply (could be alloc'ed but to simplify...) */
-    float* mixbuf;          /* internal mixing buffer */
+    float* mixbuf;          /* internal mixing buffer (mixing_channels planes plus fade gains) */
+
+    mix_op_data* ops;       /* compiled mixing chain */
+    int op_count;
+    mix_row_data* rows;     /* matrix ops' rows */
+    int row_count;
+    int row_size;
+    mix_term_data* terms;   /* matrix rows' terms */
+    int term_count;
+    int term_size;
+    float* matrixbuf;       /* matrix results, mixing_channels * MIXING_MATRIX_SAMPLES */
+
+    float* fade_tables[MIXING_FADE_TABLES]; /* curves of fade shapes in use (see get_fade_table_index) */
+    int input_channels;     /* channels when compiled (first planes) */
+    int out_count;          /* resulting channels */
+    int out_planes[VGMSTREAM_MAX_CHANNELS]; /* plane of each resulting channel */
+    uint8_t input_used[VGMSTREAM_MAX_CHANNELS]; /* input channels read before being overwritten (others aren't split) */
+    int inplace;            /* ops only change the volume of each channel once, applied on the output (see mix_inplace) */
+    int inplace_uniform;    /* same, with one volume for all channels */
+
+    int active_always;      /* has ops that apply at any position */
+    int active_count;       /* otherwise, sorted and merged ranges where fades apply */
+    int32_t active_start[VGMSTREAM_MAX_MIXING];
+    int32_t active_end[VGMSTREAM_MAX_MIXING];
+    int32_t inactive_start; /* last range found without mixing, so next calls in it skip the search */
+    int32_t inactive_end;
 } mixing_data;
 
 
 /* ******************************************************************* */
 
+/* ranges come from setup_active_ranges, so most calls (small renders outside fades) are a single compare */
 static int is_active(mixing_data *data, int32_t current_start, int32_t current_end) {
-    int i;
-    int32_t fade_start, fade_end;
-
-    for (i = 0; i < data->mixing_count; i++) {
-        mix_command_data *mix = &data->mixing_chain[i];
+    int lo, hi;
 
-        if (mix->command != MIX_FADE)
-            return 1; /* has non-fades = active */
-
-        /* check is current range falls within a fade
-         * (assuming fades were already optimized on add) */
-        fade_start = mix->time_pre < 0 ? 0 : mix->time_pre;
-        fade_end = mix->time_post < 0 ? INT_MAX : mix->time_post;
+    if (data->active_always)
+        return 1;
+    if (current_start >= data->inactive_start && current_end <= data->inactive_end)
+        return 0;
 
-        if (current_start < fade_end && current_end > fade_start)
-            return 1;
+    /* first range ending after current start */
+    lo = 0;
+    hi = data->active_count;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (data->active_end[mid] <= current_start)
+            lo = mid + 1;
+        else
+            hi = mid;
     }
 
+    if (lo < data->active_count && data->active_start[lo] < current_end)
+        return 1;
+
+    /* remember the gap between ranges */
+    data->inactive_start = lo > 0 ? data->active_end[lo - 1] : INT_MIN;
+    data->inactive_end = lo < data->active_count ? data->active_start[lo] : INT_MAX;
     return 0;
 }
 
@@ -136,13 +208,6 @@ static int32_t get_current_pos(VGMSTREAM* vgmstream, int32_t sample_count) {
 static float get_fade_gain_curve(char shape, float index) {
     float gain;
 
-    /* don't bother doing calcs near 0.0/1.0 */
-    if (index <= 0.0001f || index >= 0.9999f) {
-        return index;
-    }
-
-    //todo optimizations: interleave calcs, maybe use cosf, powf, etc? (with extra defines)
-
     /* (curve math mostly from SoX/FFmpeg) */
     switch(shape) {
         /* 2.5f in L/E 'pow' is the attenuation factor, where 5.0 (100db) is common but a bit fast
@@ -181,224 +246,440 @@ static float get_fade_gain_curve(char shape, float index) {
     return gain;
 }
 
-static int get_fade_gain(mix_command_data *mix, float *out_cur_vol, int32_t current_subpos) {
-    float cur_vol = 0.0f;
-
-    if ((current_subpos >= mix->time_pre || mix->time_pre < 0) && current_subpos < mix->time_start) {
-        cur_vol = mix->vol_start; /* before */
-    }
-    else if (current_subpos >= mix->time_end && (current_subpos < mix->time_post || mix->time_post < 0)) {
-        cur_vol = mix->vol_end; /* after */
-    }
-    else if (current_subpos >= mix->time_start && current_subpos < mix->time_end) {
-        /* in between */
-        float range_vol, range_dur, range_idx, index, gain;
-
-        if (mix->vol_start < mix->vol_end) { /* fade in */
-            range_vol = mix->vol_end - mix->vol_start;
-            range_dur = mix->time_end - mix->time_start;
-            range_idx = current_subpos - mix->time_start;
-            index = range_idx / range_dur;
-        } else { /* fade out */
-            range_vol = mix->vol_end - mix->vol_start;
-            range_dur = mix->time_end - mix->time_start;
-            range_idx = mix->time_end - current_subpos;
-            index = range_idx / range_dur;
-        }
+/* shapes that use math functions get a table, others are cheap enough to calculate */
+static int get_fade_table_index(char shape) {
+    switch(shape) {
+        case 'E': return 0;
+        case 'L': return 1;
+        case 'H': return 2;
+        case 'Q': return 3;
+        case 'p': return 4;
+        default:  return -1;
+    }
+}
+
+/* curve over MIXING_FADE_TABLE_SIZE points, interpolated (error is way below 16-bit precision) */
+static float get_fade_gain_table(const float *table, float index) {
+    float pos = index * MIXING_FADE_TABLE_SIZE;
+    int i = (int)pos;
 
-        /* Fading is done like this:
-         * - find current position within fade duration
-         * - get linear % (or rather, index from 0.0 .. 1.0) of duration
-         * - apply shape to % (from linear fade to curved fade)
-         * - get final volume for that point
-         *
-         * Roughly speaking some curve shapes are better for fades (decay rate is more natural
-         * sounding in that highest to mid/low happens faster but low to lowest takes more time,
-         * kinda like a gunshot or bell), and others for crossfades (decay of fade-in + fade-out
-         * is adjusted so that added volume level stays constant-ish).
-         *
-         * As curves can fade in two ways ('normal' and curving 'the other way'), they are adjusted
-         * to get 'normal' shape on both fades (by reversing index and making 1 - gain), thus some
-         * curves are complementary (exponential fade-in ~= logarithmic fade-out); the following
-         * are described taking fade-in = normal.
-         */
+    return table[i] + (table[i+1] - table[i]) * (pos - i);
+}
+
+/* volume of a fade between time_start and time_end */
+static float get_fade_vol(mix_command_data *mix, const float *table, int32_t current_subpos) {
+    float cur_vol, range_vol, range_dur, range_idx, index, gain;
+
+    if (mix->vol_start < mix->vol_end) { /* fade in */
+        range_vol = mix->vol_end - mix->vol_start;
+        range_dur = mix->time_end - mix->time_start;
+        range_idx = current_subpos - mix->time_start;
+        index = range_idx / range_dur;
+    } else { /* fade out */
+        range_vol = mix->vol_end - mix->vol_start;
+        range_dur = mix->time_end - mix->time_start;
+        range_idx = mix->time_end - current_subpos;
+        index = range_idx / range_dur;
+    }
+
+    /* Fading is done like this:
+     * - find current position within fade duration
+     * - get linear % (or rather, index from 0.0 .. 1.0) of duration
+     * - apply shape to % (from linear fade to curved fade)
+     * - get final volume for that point
+     *
+     * Roughly speaking some curve shapes are better for fades (decay rate is more natural
+     * sounding in that highest to mid/low happens faster but low to lowest takes more time,
+     * kinda like a gunshot or bell), and others for crossfades (decay of fade-in + fade-out
+     * is adjusted so that added volume level stays constant-ish).
+     *
+     * As curves can fade in two ways ('normal' and curving 'the other way'), they are adjusted
+     * to get 'normal' shape on both fades (by reversing index and making 1 - gain), thus some
+     * curves are complementary (exponential fade-in ~= logarithmic fade-out); the following
+     * are described taking fade-in = normal.
+     */
+    if (index <= 0.0001f || index >= 0.9999f)
+        gain = index; /* don't bother doing calcs near 0.0/1.0 */
+    else if (table)
+        gain = get_fade_gain_table(table, index);
+    else
         gain = get_fade_gain_curve(mix->shape, index);
 
-        if (mix->vol_start < mix->vol_end) {  /* fade in */
-            cur_vol = mix->vol_start + range_vol * gain;
-        } else { /* fade out */
-            cur_vol = mix->vol_end - range_vol * gain; //mix->vol_start - range_vol * (1 - gain);
-        }
+    if (mix->vol_start < mix->vol_end) {  /* fade in */
+        cur_vol = mix->vol_start + range_vol * gain;
+    } else { /* fade out */
+        cur_vol = mix->vol_end - range_vol * gain; //mix->vol_start - range_vol * (1 - gain);
     }
-    else {
-        /* fade is outside reach */
-        goto fail;
+
+    return cur_vol;
+}
+
+static int32_t clamp_fade_index(int32_t time, int32_t current_pos, int32_t sample_count) {
+    if (time <= current_pos)
+        return 0;
+    if (time - current_pos >= sample_count)
+        return sample_count;
+    return time - current_pos;
+}
+
+/* Gets fade volumes for a block (1.0 where the fade is outside reach). Returns 0 if the fade
+ * doesn't apply, 1 if the volume is constant (set in out_vol), or 2 if set per sample in gains.
+ * Volumes only change between time_start and time_end, so the rest is filled in ranges. */
+static int get_fade_gains(mixing_data *data, mix_command_data *mix, float *gains, float *out_vol, int32_t current_pos, int32_t sample_count) {
+    int32_t pre, start, end, post;
+    int s, table_index;
+    const float *table;
+
+    /* sample ranges: [0..pre) outside, [pre..start) before, [start..end) in between,
+     * [end..post) after, [post..count) outside */
+    pre = mix->time_pre < 0 ? 0 : clamp_fade_index(mix->time_pre, current_pos, sample_count);
+    start = clamp_fade_index(mix->time_start, current_pos, sample_count);
+    end = clamp_fade_index(mix->time_end, current_pos, sample_count);
+    post = mix->time_post < 0 ? sample_count : clamp_fade_index(mix->time_post, current_pos, sample_count);
+
+    if (pre == sample_count || post == 0)
+        return 0; /* fade is outside reach */
+    if (pre == 0 && start == sample_count) {
+        *out_vol = mix->vol_start;
+        return 1;
+    }
+    if (end == 0 && post == sample_count) {
+        *out_vol = mix->vol_end;
+        return 1;
     }
 
-    *out_cur_vol = cur_vol;
-    return 1;
-fail:
-    return 0;
+    for (s = 0; s < pre; s++) {
+        gains[s] = 1.0f;
+    }
+    for (; s < start; s++) {
+        gains[s] = mix->vol_start;
+    }
+    table_index = get_fade_table_index(mix->shape);
+    table = table_index >= 0 ? data->fade_tables[table_index] : NULL;
+    for (; s < end; s++) {
+        gains[s] = get_fade_vol(mix, table, current_pos + s);
+    }
+    for (; s < post; s++) {
+        gains[s] = mix->vol_end;
+    }
+    for (; s < sample_count; s++) {
+        gains[s] = 1.0f;
+    }
+    return 2;
 }
 
-void mix_vgmstream(sample_t *outbuf, int32_t sample_count, VGMSTREAM* vgmstream) {
-    mixing_data *data = vgmstream->mixing_data;
-    int ch, s, m, ok;
+static void apply_matrix(mixing_data *data, mix_op_data *op, int32_t sample_count) {
+    const vgm_kernels_t* kernels = vgm_get_kernels();
+    int32_t pos, samples;
+    int r, t;
+
+    /* rows may read each other's planes, so results are kept until all rows are done */
+    for (pos = 0; pos < sample_count; pos += MIXING_MATRIX_SAMPLES) {
+        samples = sample_count - pos;
+        if (samples > MIXING_MATRIX_SAMPLES)
+            samples = MIXING_MATRIX_SAMPLES;
+
+        for (r = 0; r < op->row_count; r++) {
+            mix_row_data *row = &data->rows[op->row_start + r];
+            mix_term_data *term = &data->terms[row->term_start];
+            float *tmp = data->matrixbuf + r * MIXING_MATRIX_SAMPLES;
+
+            kernels->f32_scale(tmp, data->mixbuf + term->src * sample_count + pos, term->vol, samples);
+            for (t = 1; t < row->term_count; t++) {
+                kernels->f32_muladd(tmp, data->mixbuf + term[t].src * sample_count + pos, term[t].vol, samples);
+            }
+        }
 
-    int32_t current_pos, current_subpos;
-    float temp_f, temp_min, temp_max, cur_vol = 0.0f;
-    float *temp_mixbuf;
-    sample_t *temp_outbuf;
+        for (r = 0; r < op->row_count; r++) {
+            mix_row_data *row = &data->rows[op->row_start + r];
+            memcpy(data->mixbuf + row->dst * sample_count + pos, data->matrixbuf + r * MIXING_MATRIX_SAMPLES, samples * sizeof(float));
+        }
+    }
+}
 
-    const float limiter_max = 32767.0f;
-    const float limiter_min = -32768.0f;
+/* Applies chains that only change each channel's volume (volume, limit or fade) directly on the
+ * interleaved buffer, without copying to planes. Either outbuf is modified or outbuf_f gets
+ * the (scaled) result. Each channel has at most one op, so results match the planar path. */
+static void mix_inplace(mixing_data *data, sample_t *outbuf, float *outbuf_f, int32_t sample_count, int32_t current_pos) {
+    const float scale = 1.0f / 32768.0f;
+    const int channels = data->input_channels;
+    float *gains = data->mixbuf; /* unused otherwise */
+    float fade_vol = 0.0f;
+    int fade_type = 0;
+    int m, s;
+
+    if (outbuf_f) {
+        vgm_get_kernels()->s16_to_float(outbuf_f, outbuf, sample_count * channels, scale);
+    }
 
-    /* no support or not need to apply */
-    if (!data || !data->mixing_on || data->mixing_count == 0)
+    /* most common case (global volume), single pass */
+    if (data->inplace_uniform) {
+        float vol = data->ops[0].vol;
+
+        if (outbuf_f) {
+            for (s = 0; s < sample_count * channels; s++) {
+                outbuf_f[s] = outbuf_f[s] * vol;
+            }
+        }
+        else {
+            for (s = 0; s < sample_count * channels; s++) {
+                outbuf[s] = clamp16( (int32_t)(outbuf[s] * vol) );
+            }
+        }
         return;
+    }
+
+    for (m = 0; m < data->op_count; m++) {
+        mix_op_data *op = &data->ops[m];
+        float vol = op->vol;
+        float temp_max = 32767.0f * vol;
+        float temp_min = -32768.0f * vol;
+        int32_t pos;
+
+        if (op->op == MIXOP_FADE_GAIN) {
+            fade_type = get_fade_gains(data, &data->mixing_chain[op->mix], gains, &fade_vol, current_pos, sample_count);
+            continue;
+        }
+
+        if (op->op == MIXOP_CLEAR) {
+            vol = 0.0f;
+        }
+        else if (op->op == MIXOP_FADE) {
+            if (fade_type == 0)
+                continue;
+            vol = fade_vol;
+        }
+
+        if (outbuf_f) {
+            float *buf = outbuf_f + op->dst;
+            temp_max *= scale;
+            temp_min *= scale;
+
+            for (s = 0, pos = 0; s < sample_count; s++, pos += channels) {
+                if (op->op == MIXOP_LIMIT) {
+                    if (buf[pos] > temp_max)
+                        buf[pos] = temp_max;
+                    else if (buf[pos] < temp_min)
+                        buf[pos] = temp_min;
+                }
+                else {
+                    buf[pos] = buf[pos] * ((op->op == MIXOP_FADE && fade_type == 2) ? gains[s] : vol);
+                }
+            }
+        }
+        else {
+            sample_t *buf = outbuf + op->dst;
+
+            for (s = 0, pos = 0; s < sample_count; s++, pos += channels) {
+                float temp_f = buf[pos];
+                if (op->op == MIXOP_LIMIT) {
+                    if (temp_f > temp_max)
+                        temp_f = temp_max;
+                    else if (temp_f < temp_min)
+                        temp_f = temp_min;
+                }
+                else {
+                    temp_f = temp_f * ((op->op == MIXOP_FADE && fade_type == 2) ? gains[s] : vol);
+                }
+                buf[pos] = clamp16( (int32_t)temp_f );
+            }
+        }
+    }
+}
+
+/* Applies mixes to mixbuf planes. Returns 0 if nothing was done (outbuf has the result),
+ * 1 if done (mixbuf has the result), or 2 if done in place (outbuf or outbuf_f has it). */
+static int mix_vgmstream_internal(sample_t *outbuf, float *outbuf_f, int32_t sample_count, VGMSTREAM* vgmstream) {
+    mixing_data *data = vgmstream->mixing_data;
+    int ch, s, m;
+    int32_t current_pos;
+    float *gains, fade_vol = 0.0f;
+    int fade_type = 0;
+
+    /* no support or not need to apply */
+    if (!data || !data->mixing_on || data->mixing_count == 0 || !data->ops)
+        return 0;
 
     /* try to skip if no ops apply (for example if fade set but does nothing yet) */
     current_pos = get_current_pos(vgmstream, sample_count);
     if (!is_active(data, current_pos, current_pos + sample_count))
-        return;
-
+        return 0;
 
-    /* use advancing buffer pointers to simplify logic */
-    temp_mixbuf = data->mixbuf;
-    temp_outbuf = outbuf;
+    if (data->inplace) {
+        mix_inplace(data, outbuf, outbuf_f, sample_count, current_pos);
+        return 2;
+    }
 
-    current_subpos = current_pos;
+    /* split channels into planes (only those the ops or the output read) */
+    for (ch = 0; ch < data->input_channels; ch++) {
+        float *dst = data->mixbuf + ch * sample_count;
+        sample_t *src = outbuf + ch;
 
-    /* apply mixes in order per channel */
-    for (s = 0; s < sample_count; s++) {
-        /* reset after new sample 'step'*/
-        float *stpbuf = temp_mixbuf;
-        int step_channels = vgmstream->channels;
+        if (!data->input_used[ch])
+            continue;
 
-        for (ch = 0; ch < step_channels; ch++) {
-            stpbuf[ch] = temp_outbuf[ch]; /* copy current 'lane' */
+        for (s = 0; s < sample_count; s++) {
+            dst[s] = src[s * data->input_channels];
         }
+    }
+    gains = data->mixbuf + data->mixing_channels * sample_count;
 
-        for (m = 0; m < data->mixing_count; m++) {
-            mix_command_data *mix = &data->mixing_chain[m];
-
-            /* mixing ops are designed to apply in order, all channels per 1 sample 'step'. Since some ops change
-             * total channels, channel number meaning varies as ops move them around, ex:
-             * - 4ch w/ "1-2,2+3" = ch1<>ch3, ch2(old ch1)+ch3 = 4ch: ch2 ch1+ch3 ch3 ch4
-             * - 4ch w/ "2+3,1-2" = ch2+ch3, ch1<>ch2(modified) = 4ch: ch2+ch3 ch1 ch3 ch4
-             * - 2ch w/ "1+2,1u" = ch1+ch2, ch1(add and push rest) = 3ch: ch1' ch1+ch2 ch2
-             * - 2ch w/ "1u,1+2" = ch1(add and push rest) = 3ch: ch1'+ch1 ch1 ch2
-             * - 2ch w/ "1-2,1d" = ch1<>ch2, ch1(drop and move ch2(old ch1) to ch1) = ch1
-             * - 2ch w/ "1d,1-2" = ch1(drop and pull rest), ch1(do nothing, ch2 doesn't exist now) = ch2
-             */
-            switch(mix->command) {
+    for (m = 0; m < data->op_count; m++) {
+        mix_op_data *op = &data->ops[m];
+        float *dst = data->mixbuf + op->dst * sample_count;
+        float *src = data->mixbuf + op->src * sample_count;
+        float vol = op->vol;
 
-                case MIX_SWAP:
-                    temp_f = stpbuf[mix->ch_dst];
-                    stpbuf[mix->ch_dst] = stpbuf[mix->ch_src];
-                    stpbuf[mix->ch_src] = temp_f;
-                    break;
+        switch(op->op) {
+            case MIXOP_ADD:
+                vgm_get_kernels()->f32_muladd(dst, src, vol, sample_count);
+                break;
 
-                case MIX_ADD:
-                    stpbuf[mix->ch_dst] = stpbuf[mix->ch_dst] + stpbuf[mix->ch_src] * mix->vol;
-                    break;
+            case MIXOP_VOLUME:
+                vgm_get_kernels()->f32_scale(dst, dst, vol, sample_count);
+                break;
 
-                case MIX_VOLUME:
-                    if (mix->ch_dst < 0) {
-                        for (ch = 0; ch < step_channels; ch++) {
-                            stpbuf[ch] = stpbuf[ch] * mix->vol;
-                        }
-                    }
-                    else {
-                        stpbuf[mix->ch_dst] = stpbuf[mix->ch_dst] * mix->vol;
-                    }
-                    break;
+            case MIXOP_CLEAR:
+                for (s = 0; s < sample_count; s++) {
+                    dst[s] = 0;
+                }
+                break;
+
+            case MIXOP_LIMIT: {
+                const float temp_max = 32767.0f * vol;
+                const float temp_min = -32768.0f * vol;
+
+                for (s = 0; s < sample_count; s++) {
+                    if (dst[s] > temp_max)
+                        dst[s] = temp_max;
+                    else if (dst[s] < temp_min)
+                        dst[s] = temp_min;
+                }
+                break;
+            }
 
-                case MIX_LIMIT:
-                    temp_max = limiter_max * mix->vol;
-                    temp_min = limiter_min * mix->vol;
-
-                    if (mix->ch_dst < 0) {
-                        for (ch = 0; ch < step_channels; ch++) {
-                            if (stpbuf[ch] > temp_max)
-                                stpbuf[ch] = temp_max;
-                            else if (stpbuf[ch] < temp_min)
-                                stpbuf[ch] = temp_min;
-                        }
+            case MIXOP_FADE_GAIN:
+                fade_type = get_fade_gains(data, &data->mixing_chain[op->mix], gains, &fade_vol, current_pos, sample_count);
+                break;
+
+            case MIXOP_MATRIX:
+                apply_matrix(data, op, sample_count);
+                break;
+
+            case MIXOP_FADE:
+                if (fade_type == 1) {
+                    for (s = 0; s < sample_count; s++) {
+                        dst[s] = dst[s] * fade_vol;
                     }
-                    else {
-                        if (stpbuf[mix->ch_dst] > temp_max)
-                            stpbuf[mix->ch_dst] = temp_max;
-                        else if (stpbuf[mix->ch_dst] < temp_min)
-                            stpbuf[mix->ch_dst] = temp_min;
+                }
+                else if (fade_type == 2) {
+                    for (s = 0; s < sample_count; s++) {
+                        dst[s] = dst[s] * gains[s];
                     }
-                    break;
+                }
+                break;
 
-                case MIX_UPMIX:
-                    step_channels += 1;
-                    for (ch = step_channels - 1; ch > mix->ch_dst; ch--) {
-                        stpbuf[ch] = stpbuf[ch-1]; /* 'push' channels forward (or pull backwards) */
-                    }
-                    stpbuf[mix->ch_dst] = 0; /* inserted as silent */
-                    break;
+            default:
+                break;
+        }
+    }
 
-                case MIX_DOWNMIX:
-                    step_channels -= 1;
-                    for (ch = mix->ch_dst; ch < step_channels; ch++) {
-                        stpbuf[ch] = stpbuf[ch+1]; /* 'pull' channels back */
-                    }
-                    break;
+    return 1;
+}
 
-                case MIX_KILLMIX:
-                    step_channels = mix->ch_dst; /* clamp channels */
-                    break;
+/* Mixes, adding time to the stream's profile if enabled. time_start is updated to the end, for the
+ * following output conversion. */
+static int mix_vgmstream_profiled(sample_t *outbuf, float *outbuf_f, int32_t sample_count, VGMSTREAM* vgmstream, uint64_t *time_start) {
+    vgmstream_profile_t* profile = vgmstream->profile;
+    uint64_t time_end;
+    int done;
+
+    if (!profile)
+        return mix_vgmstream_internal(outbuf, outbuf_f, sample_count, vgmstream);
+
+    *time_start = get_streamfile_time_us();
+    done = mix_vgmstream_internal(outbuf, outbuf_f, sample_count, vgmstream);
+    time_end = get_streamfile_time_us();
+    profile->mix_time_us += time_end - *time_start;
+    *time_start = time_end;
+    return done;
+}
 
-                case MIX_FADE:
-                    ok = get_fade_gain(mix, &cur_vol, current_subpos);
-                    if (!ok) {
-                        break; /* fade doesn't apply right now */
-                    }
+static void add_profile_output(VGMSTREAM* vgmstream, uint64_t time_start) {
+    vgmstream_profile_t* profile = vgmstream->profile;
+    if (profile)
+        profile->output_time_us += get_streamfile_time_us() - time_start;
+}
 
-                    if (mix->ch_dst < 0) {
-                        for (ch = 0; ch < step_channels; ch++) {
-                            stpbuf[ch] = stpbuf[ch] * cur_vol;
-                        }
-                    }
-                    else {
-                        stpbuf[mix->ch_dst] = stpbuf[mix->ch_dst] * cur_vol;
-                    }
-                    break;
+void mix_vgmstream(sample_t *outbuf, int32_t sample_count, VGMSTREAM* vgmstream) {
+    mixing_data *data = vgmstream->mixing_data;
+    uint64_t time_start = 0;
+    int ch, s;
 
-                default:
-                    break;
-            }
+    if (mix_vgmstream_profiled(outbuf, NULL, sample_count, vgmstream, &time_start) != 1)
+        return;
+
+    /* copy resulting mix to output */
+    for (ch = 0; ch < data->out_count; ch++) {
+        const float *plane = data->mixbuf + data->out_planes[ch] * sample_count;
+        sample_t *dst = outbuf + ch;
+
+        for (s = 0; s < sample_count; s++) {
+            /* when casting float to int, value is simply truncated:
+             * - (int)1.7 = 1, (int)-1.7 = -1
+             * alts for more accurate rounding could be:
+             * - (int)floor(f)
+             * - (int)(f < 0 ? f - 0.5f : f + 0.5f)
+             * - (((int) (f1 + 32768.5)) - 32768)
+             * - etc
+             * but since +-1 isn't really audible we'll just cast as it's the fastest
+             */
+            dst[s * data->out_count] = clamp16( (int32_t)plane[s] );
         }
+    }
 
-        current_subpos++;
+    add_profile_output(vgmstream, time_start);
+}
 
-        temp_mixbuf += step_channels;
-        temp_outbuf += vgmstream->channels;
+int mix_vgmstream_float(sample_t *inbuf, float *outbuf, int32_t sample_count, VGMSTREAM* vgmstream) {
+    mixing_data *data = vgmstream->mixing_data;
+    const float scale = 1.0f / 32768.0f;
+    uint64_t time_start = 0;
+    int ch, s, done;
+
+    done = mix_vgmstream_profiled(inbuf, outbuf, sample_count, vgmstream, &time_start);
+    if (done == 0) {
+        /* no mixing was applied so output channels are the same as input */
+        vgm_get_kernels()->s16_to_float(outbuf, inbuf, sample_count * vgmstream->channels, scale);
+        add_profile_output(vgmstream, time_start);
+        return vgmstream->channels;
+    }
+    if (done == 2) {
+        return data->out_count;
     }
 
-    /* copy resulting mix to output */
-    for (s = 0; s < sample_count * data->output_channels; s++) {
-        /* when casting float to int, value is simply truncated:
-         * - (int)1.7 = 1, (int)-1.7 = -1
-         * alts for more accurate rounding could be:
-         * - (int)floor(f)
-         * - (int)(f < 0 ? f - 0.5f : f + 0.5f)
-         * - (((int) (f1 + 32768.5)) - 32768)
-         * - etc
-         * but since +-1 isn't really audible we'll just cast as it's the fastest
-         */
-        outbuf[s] = clamp16( (int32_t)data->mixbuf[s] );
+    /* copy resulting mix to output (limiter is applied by mixes if needed) */
+    for (ch = 0; ch < data->out_count; ch++) {
+        const float *plane = data->mixbuf + data->out_planes[ch] * sample_count;
+        float *dst = outbuf + ch;
+
+        for (s = 0; s < sample_count; s++) {
+            dst[s * data->out_count] = plane[s] * scale;
+        }
     }
+
+    add_profile_output(vgmstream, time_start);
+    return data->out_count;
 }
 
 /* ******************************************************************* */
 
+size_t mixing_get_init_size(void) {
+    return sizeof(mixing_data);
+}
+
 void mixing_init(VGMSTREAM* vgmstream) {
-    mixing_data *data = calloc(1, sizeof(mixing_data));
+    mixing_data *data = pool_arena_calloc(vgmstream->arena, 1, sizeof(mixing_data));
     if (!data) goto fail;
 
     data->mixing_size = VGMSTREAM_MAX_MIXING; /* fixed array for now */
@@ -409,19 +690,25 @@ void mixing_init(VGMSTREAM* vgmstream) {
     return;
 
 fail:
-    free(data);
     return;
 }
 
 void mixing_close(VGMSTREAM* vgmstream) {
     mixing_data *data = NULL;
+    int i;
     if (!vgmstream) return;
 
     data = vgmstream->mixing_data;
     if (!data) return;
 
-    free(data->mixbuf);
-    free(data);
+    /* data and mixbuf go with the stream's arena */
+    free(data->ops);
+    free(data->rows);
+    free(data->terms);
+    free(data->matrixbuf);
+    for (i = 0; i < MIXING_FADE_TABLES; i++) {
+        free(data->fade_tables[i]);
+    }
 }
 
 void mixing_update_channel(VGMSTREAM* vgmstream) {
@@ -594,6 +881,25 @@ static mix_command_data* get_last_fade(mixing_data *data, int target_channel) {
 }
 
 
+/* precalculates the shape's curve once, rather than calling math functions per sample */
+static void setup_fade_table(mixing_data *data, char shape) {
+    int table_index = get_fade_table_index(shape);
+    float *table;
+    int i;
+
+    if (table_index < 0 || data->fade_tables[table_index])
+        return;
+
+    table = malloc(sizeof(float) * (MIXING_FADE_TABLE_SIZE + 1));
+    if (!table) return; /* curve is calculated instead */
+
+    for (i = 0; i <= MIXING_FADE_TABLE_SIZE; i++) {
+        table[i] = get_fade_gain_curve(shape, (float)i / MIXING_FADE_TABLE_SIZE);
+    }
+
+    data->fade_tables[table_index] = table;
+}
+
 void mixing_push_fade(VGMSTREAM* vgmstream, int ch_dst, double vol_start, double vol_end, char shape,
         int32_t time_pre, int32_t time_start, int32_t time_end, int32_t time_post) {
     mixing_data *data = vgmstream->mixing_data;
@@ -670,7 +976,9 @@ void mixing_push_fade(VGMSTREAM* vgmstream, int ch_dst, double vol_start, double
     }
 
     //;VGM_LOG("MIX: fade %i^%f~%f=%c@%i~%i~%i~%i\n", ch_dst, vol_start, vol_end, shape, time_pre, time_start, time_end, time_post);
-    add_mixing(vgmstream, &mix);
+    if (add_mixing(vgmstream, &mix)) {
+        setup_fade_table(data, mix.shape);
+    }
 }
 
 /* ******************************************************************* */
@@ -807,8 +1115,8 @@ void mixing_macro_crosstrack(VGMSTREAM* vgmstream, int max) {
 
     /* set loops to hear all track changes */
     track_num = output_channels / max;
-    if (vgmstream->config.loop_count < track_num)
-        vgmstream->config.loop_count = track_num;
+    if (vgmstream->config->loop_count < track_num)
+        vgmstream->config->loop_count = track_num;
 
     ch = 0;
     for (track = 0; track < track_num; track++) {
@@ -868,8 +1176,8 @@ void mixing_macro_crosslayer(VGMSTREAM* vgmstream, int max, char mode) {
 
     /* set loops to hear all track changes */
     layer_num = output_channels / max;
-    if (vgmstream->config.loop_count < layer_num)
-        vgmstream->config.loop_count = layer_num;
+    if (vgmstream->config->loop_count < layer_num)
+        vgmstream->config->loop_count = layer_num;
 
     /* mode 'v': constant volume
      * mode 'e': sets fades to successively lower/equalize volume per loop for each layer
@@ -1056,6 +1364,419 @@ void mixing_macro_downmix(VGMSTREAM* vgmstream, int max /*, mapping_t output_map
 
 /* ******************************************************************* */
 
+static void add_op(mixing_data *data, mix_op_t type, int dst, int src, float vol, int mix) {
+    mix_op_data *op = &data->ops[data->op_count];
+    op->op = type;
+    op->dst = dst;
+    op->src = src;
+    op->vol = vol;
+    op->mix = mix;
+    op->row_start = 0;
+    op->row_count = 0;
+    data->op_count++;
+}
+
+/* pending run of linear ops (adds/volumes/clears), as coefs of each plane from planes before the run */
+typedef struct {
+    double coefs[VGMSTREAM_MAX_CHANNELS][VGMSTREAM_MAX_CHANNELS];
+    int plane_count;
+} mix_matrix_state;
+
+static void reset_matrix(mix_matrix_state *mtx) {
+    int p, q;
+    for (p = 0; p < mtx->plane_count; p++) {
+        for (q = 0; q < mtx->plane_count; q++) {
+            mtx->coefs[p][q] = (p == q) ? 1.0 : 0.0;
+        }
+    }
+}
+
+static int add_matrix_row(mixing_data *data, mix_matrix_state *mtx, int dst) {
+    mix_row_data *row;
+    int q;
+
+    if (data->row_count + 1 > data->row_size) {
+        int size = data->row_size ? data->row_size * 2 : mtx->plane_count;
+        mix_row_data *rows_re = realloc(data->rows, sizeof(mix_row_data) * size);
+        if (!rows_re) return 0;
+        data->rows = rows_re;
+        data->row_size = size;
+    }
+    if (data->term_count + mtx->plane_count > data->term_size) {
+        int size = data->term_size ? data->term_size * 2 : mtx->plane_count * mtx->plane_count;
+        mix_term_data *terms_re = realloc(data->terms, sizeof(mix_term_data) * size);
+        if (!terms_re) return 0;
+        data->terms = terms_re;
+        data->term_size = size;
+    }
+
+    row = &data->rows[data->row_count];
+    row->dst = dst;
+    row->term_start = data->term_count;
+    row->term_count = 0;
+    for (q = 0; q < mtx->plane_count; q++) {
+        if (mtx->coefs[dst][q] == 0.0)
+            continue;
+        data->terms[data->term_count].src = q;
+        data->terms[data->term_count].vol = mtx->coefs[dst][q];
+        data->term_count++;
+        row->term_count++;
+    }
+    data->row_count++;
+    return 1;
+}
+
+/* Turns the pending run into ops for current channels (planes of removed channels are ignored):
+ * planes that mix others go into one matrix op, then planes that only change their own volume
+ * (diagonal) or are cleared get simpler ops, and unchanged planes (identity) get none. */
+static int flush_matrix(mixing_data *data, mix_matrix_state *mtx, const int *planes, int step_channels) {
+    int row_start = data->row_count;
+    int ch, q;
+
+    for (ch = 0; ch < step_channels; ch++) {
+        int p = planes[ch];
+        int is_self = 1, is_empty = 1;
+
+        for (q = 0; q < mtx->plane_count; q++) {
+            if (mtx->coefs[p][q] == 0.0)
+                continue;
+            is_empty = 0;
+            if (q != p)
+                is_self = 0;
+        }
+        if (is_empty || is_self)
+            continue;
+
+        if (!add_matrix_row(data, mtx, p))
+            return 0;
+    }
+
+    if (data->row_count > row_start) {
+        add_op(data, MIXOP_MATRIX, 0, 0, 0.0f, 0);
+        data->ops[data->op_count - 1].row_start = row_start;
+        data->ops[data->op_count - 1].row_count = data->row_count - row_start;
+    }
+
+    /* after the matrix, that reads planes as they were */
+    for (ch = 0; ch < step_channels; ch++) {
+        int p = planes[ch];
+        int is_self = 1, is_empty = 1;
+
+        for (q = 0; q < mtx->plane_count; q++) {
+            if (mtx->coefs[p][q] == 0.0)
+                continue;
+            is_empty = 0;
+            if (q != p)
+                is_self = 0;
+        }
+
+        if (is_empty)
+            add_op(data, MIXOP_CLEAR, p, 0, 0.0f, 0);
+        else if (is_self && mtx->coefs[p][p] != 1.0)
+            add_op(data, MIXOP_VOLUME, p, 0, mtx->coefs[p][p], 0);
+    }
+
+    reset_matrix(mtx);
+    return 1;
+}
+
+/* Finds which input planes are read by ops or the output before ops overwrite them, so dropped
+ * channels (downmixes leaving them out, killmixes) aren't split into planes at all */
+static void setup_input_used(mixing_data *data) {
+    uint8_t written[VGMSTREAM_MAX_CHANNELS] = {0};
+    int ch, m, r, t;
+
+    memset(data->input_used, 0, sizeof(data->input_used));
+
+#define MIX_READ(plane) do { if (!written[plane]) data->input_used[plane] = 1; } while (0)
+    for (m = 0; m < data->op_count; m++) {
+        mix_op_data *op = &data->ops[m];
+        switch(op->op) {
+            case MIXOP_ADD:
+                MIX_READ(op->src);
+                MIX_READ(op->dst);
+                break;
+            case MIXOP_VOLUME:
+            case MIXOP_LIMIT:
+            case MIXOP_FADE:
+                MIX_READ(op->dst);
+                break;
+            case MIXOP_CLEAR:
+                written[op->dst] = 1;
+                break;
+            case MIXOP_MATRIX:
+                /* rows read planes as they were before the op */
+                for (r = 0; r < op->row_count; r++) {
+                    mix_row_data *row = &data->rows[op->row_start + r];
+                    for (t = 0; t < row->term_count; t++) {
+                        MIX_READ(data->terms[row->term_start + t].src);
+                    }
+                }
+                for (r = 0; r < op->row_count; r++) {
+                    written[data->rows[op->row_start + r].dst] = 1;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    for (ch = 0; ch < data->out_count; ch++) {
+        MIX_READ(data->out_planes[ch]);
+    }
+#undef MIX_READ
+}
+
+/* Checks if ops can be applied on the output buffer (see mix_inplace) */
+static void setup_inplace(mixing_data *data) {
+    int dst_used[VGMSTREAM_MAX_CHANNELS] = {0};
+    int ch, m;
+
+    data->inplace = 0;
+    data->inplace_uniform = 0;
+
+    if (data->out_count != data->input_channels)
+        return;
+    for (ch = 0; ch < data->out_count; ch++) {
+        if (data->out_planes[ch] != ch)
+            return;
+    }
+
+    for (m = 0; m < data->op_count; m++) {
+        mix_op_data *op = &data->ops[m];
+        switch(op->op) {
+            case MIXOP_VOLUME:
+            case MIXOP_CLEAR:
+            case MIXOP_LIMIT:
+            case MIXOP_FADE:
+                if (dst_used[op->dst])
+                    return;
+                dst_used[op->dst] = 1;
+                break;
+            case MIXOP_FADE_GAIN:
+                break;
+            default:
+                return;
+        }
+    }
+    data->inplace = 1;
+
+    if (data->op_count != data->input_channels)
+        return;
+    for (m = 0; m < data->op_count; m++) {
+        if (data->ops[m].op != MIXOP_VOLUME || data->ops[m].vol != data->ops[0].vol)
+            return;
+    }
+    data->inplace_uniform = 1;
+}
+
+/* Finds where the chain does anything: fades only apply between their pre and post times
+ * (assuming fades were already optimized on add), while other commands apply everywhere. */
+static void setup_active_ranges(mixing_data *data) {
+    int m, i, j;
+
+    data->active_always = 0;
+    data->active_count = 0;
+    data->inactive_start = 0;
+    data->inactive_end = 0;
+
+    for (m = 0; m < data->mixing_count; m++) {
+        mix_command_data *mix = &data->mixing_chain[m];
+        int32_t fade_start, fade_end;
+
+        if (mix->command != MIX_FADE) {
+            data->active_always = 1;
+            return;
+        }
+
+        fade_start = mix->time_pre < 0 ? 0 : mix->time_pre;
+        fade_end = mix->time_post < 0 ? INT_MAX : mix->time_post;
+        if (fade_start >= fade_end)
+            continue;
+
+        /* insert sorted by start */
+        i = data->active_count;
+        while (i > 0 && data->active_start[i-1] > fade_start) {
+            data->active_start[i] = data->active_start[i-1];
+            data->active_end[i] = data->active_end[i-1];
+            i--;
+        }
+        data->active_start[i] = fade_start;
+        data->active_end[i] = fade_end;
+        data->active_count++;
+    }
+
+    /* merge overlapping ranges, so ends are sorted too */
+    j = 0;
+    for (i = 1; i < data->active_count; i++) {
+        if (data->active_start[i] <= data->active_end[j]) {
+            if (data->active_end[i] > data->active_end[j])
+                data->active_end[j] = data->active_end[i];
+        }
+        else {
+            j++;
+            data->active_start[j] = data->active_start[i];
+            data->active_end[j] = data->active_end[i];
+        }
+    }
+    if (data->active_count > 0)
+        data->active_count = j + 1;
+}
+
+/* Turns the mixing chain into block ops. Channel numbers in the chain change as ops move them around
+ * (see MIX_UPMIX/DOWNMIX), so this keeps which plane each current channel is in, and swaps, down/upmixes
+ * and killmixes just change that mapping instead of moving samples.
+ *
+ * Runs of linear ops (adds, volumes, upmixed silence) are folded into a single matrix from the planes
+ * before the run (ex. a 7.1 to stereo downmix becomes one op), and only non-linear ops (limits, fades)
+ * split runs. As volumes get pre-multiplied output may differ by +-1 vs applying ops one by one. */
+static int compile_mixing(VGMSTREAM* vgmstream) {
+    mixing_data *data = vgmstream->mixing_data;
+    mix_matrix_state *mtx = NULL;
+    int planes[VGMSTREAM_MAX_CHANNELS]; /* plane of each current channel */
+    int plane_used[VGMSTREAM_MAX_CHANNELS] = {0};
+    int step_channels, ch, m, q, temp;
+
+    if (vgmstream->channels > VGMSTREAM_MAX_CHANNELS || data->mixing_channels > VGMSTREAM_MAX_CHANNELS)
+        goto fail;
+
+    free(data->ops);
+    free(data->matrixbuf);
+    data->op_count = 0;
+    data->row_count = 0;
+    data->term_count = 0;
+    /* worst case, each limit/fade and the end flush a matrix plus one op per channel */
+    data->ops = malloc(sizeof(mix_op_data) * (data->mixing_count + 1) * (data->mixing_channels + 2));
+    data->matrixbuf = malloc(sizeof(float) * data->mixing_channels * MIXING_MATRIX_SAMPLES);
+    mtx = malloc(sizeof(mix_matrix_state));
+    if (!data->ops || !data->matrixbuf || !mtx) goto fail;
+
+    mtx->plane_count = data->mixing_channels;
+    reset_matrix(mtx);
+
+    step_channels = vgmstream->channels;
+    for (ch = 0; ch < step_channels; ch++) {
+        planes[ch] = ch;
+        plane_used[ch] = 1;
+    }
+
+    /* channels are validated on push */
+    for (m = 0; m < data->mixing_count; m++) {
+        mix_command_data *mix = &data->mixing_chain[m];
+
+        switch(mix->command) {
+            case MIX_SWAP:
+                temp = planes[mix->ch_dst];
+                planes[mix->ch_dst] = planes[mix->ch_src];
+                planes[mix->ch_src] = temp;
+                break;
+
+            case MIX_ADD: {
+                int dst = planes[mix->ch_dst];
+                int src = planes[mix->ch_src];
+                for (q = 0; q < mtx->plane_count; q++) {
+                    mtx->coefs[dst][q] += mtx->coefs[src][q] * mix->vol;
+                }
+                break;
+            }
+
+            case MIX_VOLUME:
+                for (ch = 0; ch < step_channels; ch++) {
+                    int dst = planes[ch];
+                    if (mix->ch_dst >= 0 && ch != mix->ch_dst)
+                        continue;
+                    for (q = 0; q < mtx->plane_count; q++) {
+                        mtx->coefs[dst][q] *= mix->vol;
+                    }
+                }
+                break;
+
+            case MIX_LIMIT:
+                if (!flush_matrix(data, mtx, planes, step_channels))
+                    goto fail;
+                if (mix->ch_dst < 0) {
+                    for (ch = 0; ch < step_channels; ch++) {
+                        add_op(data, MIXOP_LIMIT, planes[ch], 0, mix->vol, m);
+                    }
+                }
+                else {
+                    add_op(data, MIXOP_LIMIT, planes[mix->ch_dst], 0, mix->vol, m);
+                }
+                break;
+
+            case MIX_UPMIX: {
+                int plane = 0;
+                while (plane_used[plane]) { /* always one free as mixing_channels is the max */
+                    plane++;
+                }
+                plane_used[plane] = 1;
+
+                step_channels += 1;
+                for (ch = step_channels - 1; ch > mix->ch_dst; ch--) {
+                    planes[ch] = planes[ch-1];
+                }
+                planes[mix->ch_dst] = plane;
+                for (q = 0; q < mtx->plane_count; q++) { /* inserted as silent */
+                    mtx->coefs[plane][q] = 0.0;
+                }
+                break;
+            }
+
+            case MIX_DOWNMIX:
+                plane_used[planes[mix->ch_dst]] = 0;
+                step_channels -= 1;
+                for (ch = mix->ch_dst; ch < step_channels; ch++) {
+                    planes[ch] = planes[ch+1];
+                }
+                break;
+
+            case MIX_KILLMIX:
+                for (ch = mix->ch_dst; ch < step_channels; ch++) {
+                    plane_used[planes[ch]] = 0;
+                }
+                step_channels = mix->ch_dst;
+                break;
+
+            case MIX_FADE:
+                if (!flush_matrix(data, mtx, planes, step_channels))
+                    goto fail;
+                add_op(data, MIXOP_FADE_GAIN, 0, 0, 0.0f, m);
+                if (mix->ch_dst < 0) {
+                    for (ch = 0; ch < step_channels; ch++) {
+                        add_op(data, MIXOP_FADE, planes[ch], 0, 0.0f, m);
+                    }
+                }
+                else {
+                    add_op(data, MIXOP_FADE, planes[mix->ch_dst], 0, 0.0f, m);
+                }
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    if (!flush_matrix(data, mtx, planes, step_channels))
+        goto fail;
+
+    data->input_channels = vgmstream->channels;
+    data->out_count = step_channels;
+    for (ch = 0; ch < step_channels; ch++) {
+        data->out_planes[ch] = planes[ch];
+    }
+    setup_input_used(data);
+    setup_inplace(data);
+
+    free(mtx);
+    return 1;
+fail:
+    free(mtx);
+    free(data->ops);
+    data->ops = NULL;
+    data->op_count = 0;
+    return 0;
+}
+
 void mixing_setup(VGMSTREAM * vgmstream, int32_t max_sample_count) {
     mixing_data *data = vgmstream->mixing_data;
     float *mixbuf_re = NULL;
@@ -1072,11 +1793,15 @@ void mixing_setup(VGMSTREAM * vgmstream, int32_t max_sample_count) {
     if (max_sample_count <= 0)
         goto fail;
 
-    /* create or alter internal buffer */
-    mixbuf_re = realloc(data->mixbuf, max_sample_count*data->mixing_channels*sizeof(float));
+    /* create or alter internal buffer (channel planes + fade gains) */
+    mixbuf_re = pool_arena_realloc(vgmstream->arena, data->mixbuf, max_sample_count*(data->mixing_channels + 1)*sizeof(float));
     if (!mixbuf_re) goto fail;
 
     data->mixbuf = mixbuf_re;
+
+    if (!compile_mixing(vgmstream))
+        goto fail;
+    setup_active_ranges(data);
     data->mixing_on = 1;
 
     /* since data exists on its own memory and pointer is already set
@@ -1109,3 +1834,88 @@ void mixing_info(VGMSTREAM * vgmstream, int *out_input_channels, int *out_output
 fail:
     return;
 }
+
+int mixing_is_enabled(VGMSTREAM * vgmstream) {
+    mixing_data *data = vgmstream->mixing_data;
+
+    return data && data->mixing_on && data->mixing_count > 0;
+}
+
+uint64_t mixing_get_used_channels(VGMSTREAM * vgmstream) {
+    mixing_data *data = vgmstream->mixing_data;
+    uint64_t lanes[VGMSTREAM_MAX_CHANNELS]; /* input channels each mixing channel depends on */
+    uint64_t all_channels, used_channels = 0;
+    int m, ch, step_channels;
+
+    all_channels = (vgmstream->channels >= 64) ? ~(uint64_t)0 : ((uint64_t)1 << vgmstream->channels) - 1;
+    if (!data || !data->mixing_on || data->mixing_count == 0)
+        return all_channels;
+    if (vgmstream->channels > VGMSTREAM_MAX_CHANNELS || data->mixing_channels > VGMSTREAM_MAX_CHANNELS)
+        return all_channels;
+
+    /* follow channels around like mix_vgmstream does with samples (checks are done on push) */
+    for (ch = 0; ch < data->mixing_channels; ch++) {
+        lanes[ch] = (ch < vgmstream->channels) ? (uint64_t)1 << ch : 0;
+    }
+    step_channels = vgmstream->channels;
+
+    for (m = 0; m < data->mixing_count; m++) {
+        mix_command_data *mix = &data->mixing_chain[m];
+        uint64_t temp;
+
+        switch(mix->command) {
+            case MIX_SWAP:
+                temp = lanes[mix->ch_dst];
+                lanes[mix->ch_dst] = lanes[mix->ch_src];
+                lanes[mix->ch_src] = temp;
+                break;
+
+            case MIX_ADD:
+                if (mix->vol != 0.0f)
+                    lanes[mix->ch_dst] |= lanes[mix->ch_src];
+                break;
+
+            case MIX_VOLUME:
+                if (mix->vol != 0.0f)
+                    break;
+                if (mix->ch_dst < 0) {
+                    for (ch = 0; ch < step_channels; ch++) {
+                        lanes[ch] = 0;
+                    }
+                }
+                else {
+                    lanes[mix->ch_dst] = 0;
+                }
+                break;
+
+            case MIX_UPMIX:
+                step_channels += 1;
+                for (ch = step_channels - 1; ch > mix->ch_dst; ch--) {
+                    lanes[ch] = lanes[ch-1];
+                }
+                lanes[mix->ch_dst] = 0;
+                break;
+
+            case MIX_DOWNMIX:
+                step_channels -= 1;
+                for (ch = mix->ch_dst; ch < step_channels; ch++) {
+                    lanes[ch] = lanes[ch+1];
+                }
+                break;
+
+            case MIX_KILLMIX:
+                step_channels = mix->ch_dst;
+                break;
+
+            case MIX_LIMIT: /* same channel */
+            case MIX_FADE: /* time dependant, assumed to keep channels */
+            default:
+                break;
+        }
+    }
+
+    for (ch = 0; ch < step_channels; ch++) {
+        used_channels |= lanes[ch];
+    }
+    return used_channels;
+}
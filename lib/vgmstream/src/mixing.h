@@ -7,10 +7,18 @@
  * outbuf must big enough to hold output_channels*samples_to_do */
 void mix_vgmstream(sample_t *outbuf, int32_t sample_count, VGMSTREAM* vgmstream);
 
+/* Same as mix_vgmstream but writes to a float buffer (+-1.0), taking the mix result directly.
+ * inbuf may be modified and outbuf must hold output_channels*samples_to_do. Returns the
+ * channels written (same as input if mixing isn't active: hosts that don't enable it
+ * still get vgmstream->channels). */
+int mix_vgmstream_float(sample_t *inbuf, float *outbuf, int32_t sample_count, VGMSTREAM* vgmstream);
+
 /* internal mixing pre-setup for vgmstream (doesn't imply usage).
  * If init somehow fails next calls are ignored. */
 void mixing_init(VGMSTREAM* vgmstream);
 void mixing_close(VGMSTREAM* vgmstream);
+/* bytes mixing_init takes from the stream's arena, to size it */
+size_t mixing_get_init_size(void);
 void mixing_update_channel(VGMSTREAM* vgmstream);
 
 /* Call to let vgmstream apply mixing, which must handle input/output_channels.
@@ -21,6 +29,13 @@ void mixing_setup(VGMSTREAM * vgmstream, int32_t max_sample_count);
 /* gets current mixing info */
 void mixing_info(VGMSTREAM * vgmstream, int *input_channels, int *output_channels);
 
+/* if mixes were set up that may change rendered samples (otherwise mix_vgmstream does nothing) */
+int mixing_is_enabled(VGMSTREAM * vgmstream);
+
+/* gets a bitmask of input channels that reach the output once mixing is active
+ * (others may be removed or muted), or all channels if mixing isn't used */
+uint64_t mixing_get_used_channels(VGMSTREAM * vgmstream);
+
 /* adds mixes filtering and optimizing if needed */
 void mixing_push_swap(VGMSTREAM* vgmstream, int ch_dst, int ch_src);
 void mixing_push_add(VGMSTREAM* vgmstream, int ch_dst, int ch_src, double volume);
@@ -0,0 +1,298 @@
+#include <stdlib.h>
+#include <string.h>
+#include "page_cache.h"
+#include "vgmstream.h"
+
+/* Metas reopen the same file a bunch during detection (reopen_streamfile, companion files, per
+ * channel opens), and each reopen starts with an empty buffer. Buffered streamfiles fill their
+ * buffers through here instead, so a page is only read once while it stays in the cache.
+ *
+ * Files are matched by name + size (+ stamp if known). Pages of closed files are kept until
+ * evicted, so a host opening the same file again later (ex. tags then playback) also benefits. */
+
+#define PAGE_CACHE_HASH_SIZE 4096
+
+typedef struct cache_page {
+    page_cache_file* file;
+    off_t offset;               /* page aligned */
+    size_t size;                /* may be less than a page at EOF */
+    struct cache_page* prev;    /* LRU list, newest first */
+    struct cache_page* next;
+    struct cache_page* hash_next;
+    uint8_t* data;
+} cache_page;
+
+struct page_cache_file {
+    char name[PATH_LIMIT];
+    size_t filesize;
+    uint64_t stamp;
+    int refs;                   /* open streamfiles */
+    int pages;                  /* cached pages */
+    int stale;                  /* file changed, new opens don't use it */
+    struct page_cache_file* next;
+};
+
+static struct {
+    size_t max_pages;
+    void (*lock)(void*);
+    void (*unlock)(void*);
+    void* lock_data;
+
+    size_t count;
+    cache_page* newest;
+    cache_page* oldest;
+    cache_page* hash[PAGE_CACHE_HASH_SIZE];
+    page_cache_file* files;
+} cache;
+
+
+static void cache_lock(void) {
+    if (cache.lock)
+        cache.lock(cache.lock_data);
+}
+
+static void cache_unlock(void) {
+    if (cache.unlock)
+        cache.unlock(cache.lock_data);
+}
+
+static unsigned int page_hash(page_cache_file* file, off_t offset) {
+    size_t key = (size_t)file ^ (size_t)(offset / PAGE_CACHE_PAGE_SIZE) * 2654435761u;
+    return (unsigned int)(key ^ (key >> 16)) % PAGE_CACHE_HASH_SIZE;
+}
+
+static void unlink_file(page_cache_file* file) {
+    page_cache_file** link = &cache.files;
+    while (*link) {
+        if (*link == file) {
+            *link = file->next;
+            break;
+        }
+        link = &(*link)->next;
+    }
+    free(file);
+}
+
+/* unused files are only kept while they have pages */
+static void check_file(page_cache_file* file) {
+    if (file->refs == 0 && file->pages == 0)
+        unlink_file(file);
+}
+
+static void lru_remove(cache_page* page) {
+    if (page->prev) page->prev->next = page->next;
+    else cache.newest = page->next;
+    if (page->next) page->next->prev = page->prev;
+    else cache.oldest = page->prev;
+    page->prev = page->next = NULL;
+}
+
+static void lru_push(cache_page* page) {
+    page->prev = NULL;
+    page->next = cache.newest;
+    if (cache.newest) cache.newest->prev = page;
+    cache.newest = page;
+    if (!cache.oldest) cache.oldest = page;
+}
+
+static void drop_page(cache_page* page) {
+    cache_page** link = &cache.hash[page_hash(page->file, page->offset)];
+    page_cache_file* file = page->file;
+
+    while (*link) {
+        if (*link == page) {
+            *link = page->hash_next;
+            break;
+        }
+        link = &(*link)->hash_next;
+    }
+    lru_remove(page);
+    cache.count--;
+    free(page);
+
+    file->pages--;
+    check_file(file);
+}
+
+static void drop_file_pages(page_cache_file* file) {
+    cache_page* page = cache.newest;
+    while (page && file->pages > 0) {
+        cache_page* next = page->next;
+        if (page->file == file)
+            drop_page(page); /* may free file once pages reach 0 */
+        page = next;
+    }
+}
+
+static cache_page* find_page(page_cache_file* file, off_t offset) {
+    cache_page* page = cache.hash[page_hash(file, offset)];
+    while (page) {
+        if (page->file == file && page->offset == offset)
+            return page;
+        page = page->hash_next;
+    }
+    return NULL;
+}
+
+static void store_page(page_cache_file* file, off_t offset, const uint8_t* src, size_t size) {
+    cache_page* page;
+    unsigned int hash;
+
+    if (!cache.max_pages || file->stale || find_page(file, offset))
+        return;
+
+    while (cache.count >= cache.max_pages && cache.oldest) {
+        drop_page(cache.oldest);
+    }
+
+    page = malloc(sizeof(cache_page) + PAGE_CACHE_PAGE_SIZE);
+    if (!page) return;
+    page->data = (uint8_t*)(page + 1);
+    page->file = file;
+    page->offset = offset;
+    page->size = size;
+    memcpy(page->data, src, size);
+
+    hash = page_hash(file, offset);
+    page->hash_next = cache.hash[hash];
+    cache.hash[hash] = page;
+    lru_push(page);
+    cache.count++;
+    file->pages++;
+}
+
+
+page_cache_file* page_cache_open(const char* name, size_t filesize, uint64_t stamp) {
+    page_cache_file* file;
+
+    if (!cache.max_pages || !name || !name[0])
+        return NULL;
+
+    cache_lock();
+    for (file = cache.files; file; file = file->next) {
+        if (file->stale || strcmp(file->name, name) != 0)
+            continue;
+
+        if (file->filesize == filesize && (!stamp || !file->stamp || file->stamp == stamp)) {
+            if (!file->stamp)
+                file->stamp = stamp;
+            file->refs++;
+            cache_unlock();
+            return file;
+        }
+
+        /* changed file: drop old pages, current users keep reading through it uncached */
+        file->stale = 1;
+        file->refs++; /* keep it alive while dropping */
+        drop_file_pages(file);
+        file->refs--;
+        check_file(file);
+        break;
+    }
+
+    file = calloc(1, sizeof(page_cache_file));
+    if (file) {
+        strncpy(file->name, name, sizeof(file->name));
+        file->name[sizeof(file->name) - 1] = '\0';
+        file->filesize = filesize;
+        file->stamp = stamp;
+        file->refs = 1;
+        file->next = cache.files;
+        cache.files = file;
+    }
+    cache_unlock();
+
+    return file;
+}
+
+void page_cache_close(page_cache_file* file) {
+    if (!file)
+        return;
+
+    cache_lock();
+    file->refs--;
+    check_file(file);
+    cache_unlock();
+}
+
+size_t page_cache_fill(page_cache_file* file, uint8_t* dst, off_t offset, size_t length, page_cache_read_t read_cb, void* cb_data) {
+    size_t done = 0, bytes;
+
+    if (!file || offset % PAGE_CACHE_PAGE_SIZE)
+        return read_cb(cb_data, dst, offset, length);
+
+    /* copy cached pages until one is missing */
+    cache_lock();
+    while (done < length) {
+        cache_page* page = find_page(file, offset + done);
+        size_t to_copy;
+
+        if (!page)
+            break;
+
+        to_copy = page->size;
+        if (to_copy > length - done)
+            to_copy = length - done;
+        memcpy(dst + done, page->data, to_copy);
+        done += to_copy;
+
+        lru_remove(page);
+        lru_push(page);
+
+        if (page->size < PAGE_CACHE_PAGE_SIZE) { /* EOF */
+            cache_unlock();
+            return done;
+        }
+    }
+    cache_unlock();
+
+    if (done == length)
+        return done;
+
+    /* read the rest in one go and keep whole pages (or the last partial page at EOF) */
+    bytes = read_cb(cb_data, dst + done, offset + done, length - done);
+
+    cache_lock();
+    {
+        size_t pos = 0;
+        while (pos < bytes) {
+            off_t page_offset = offset + done + pos;
+            size_t size = bytes - pos;
+            if (size > PAGE_CACHE_PAGE_SIZE)
+                size = PAGE_CACHE_PAGE_SIZE;
+            if (size < PAGE_CACHE_PAGE_SIZE && page_offset + size != file->filesize)
+                break;
+
+            store_page(file, page_offset, dst + done + pos, size);
+            pos += size;
+        }
+    }
+    cache_unlock();
+
+    return done + bytes;
+}
+
+size_t page_cache_get_size(void) {
+    size_t size;
+
+    cache_lock();
+    size = cache.count * (sizeof(cache_page) + PAGE_CACHE_PAGE_SIZE);
+    cache_unlock();
+
+    return size;
+}
+
+void vgmstream_page_cache_setup(size_t max_size, void (*lock)(void*), void (*unlock)(void*), void* lock_data) {
+    size_t max_pages = max_size / PAGE_CACHE_PAGE_SIZE;
+
+    cache_lock();
+    while (cache.count > max_pages && cache.oldest) {
+        drop_page(cache.oldest);
+    }
+    cache.max_pages = max_pages;
+    cache_unlock();
+
+    cache.lock = lock;
+    cache.unlock = unlock;
+    cache.lock_data = lock_data;
+}
@@ -0,0 +1,29 @@
+/*
+ * page_cache.h - process-wide cache of file pages shared by buffered streamfiles
+ */
+#ifndef _PAGE_CACHE_H
+#define _PAGE_CACHE_H
+
+#include "streamtypes.h"
+
+#define PAGE_CACHE_PAGE_SIZE 0x1000
+
+typedef struct page_cache_file page_cache_file;
+
+/* reads from the underlying IO, returns bytes read */
+typedef size_t (*page_cache_read_t)(void* data, uint8_t* dst, off_t offset, size_t length);
+
+/* Gets the cache entry of a file, NULL if the cache is disabled (callers then read as usual).
+ * stamp is some modification mark (ex. mtime) to detect changed files, or 0 if unknown. */
+page_cache_file* page_cache_open(const char* name, size_t filesize, uint64_t stamp);
+
+void page_cache_close(page_cache_file* file);
+
+/* Reads length bytes at offset into dst, copying cached pages and reading the rest with read_cb,
+ * which then get cached. Only page aligned offsets are cached, others just call read_cb. */
+size_t page_cache_fill(page_cache_file* file, uint8_t* dst, off_t offset, size_t length, page_cache_read_t read_cb, void* cb_data);
+
+/* Memory used by cached pages. */
+size_t page_cache_get_size(void);
+
+#endif /* _PAGE_CACHE_H */
@@ -1,17 +1,40 @@
 #include "vgmstream.h"
 #include "plugins.h"
 #include "mixing.h"
+#include "membudget.h"
+#include <math.h>
+#include <sys/stat.h>
+#if !defined(__MSVCRT__) && !defined(_MSC_VER)
+#include <dirent.h>
+#endif
 
 
 /* ****************************************** */
 /* CONTEXT: simplifies plugin code            */
 /* ****************************************** */
 
+/* extension lists are sorted, and players call this for every file in a folder */
+static int find_extension(const char* extension, const char ** extension_list, size_t extension_list_len) {
+    size_t min = 0, max = extension_list_len;
+
+    while (min < max) {
+        size_t mid = (min + max) / 2;
+        int cmp = strcasecmp(extension, extension_list[mid]);
+        if (cmp == 0)
+            return 1;
+        if (cmp < 0)
+            max = mid;
+        else
+            min = mid + 1;
+    }
+
+    return 0;
+}
+
 int vgmstream_ctx_is_valid(const char* filename, vgmstream_ctx_valid_cfg *cfg) {
     const char ** extension_list;
     size_t extension_list_len;
     const char *extension;
-    int i;
 
 
     if (cfg->is_extension) {
@@ -28,46 +51,920 @@ int vgmstream_ctx_is_valid(const char* filename, vgmstream_ctx_valid_cfg *cfg) {
     /* try in default list */
     if (!cfg->skip_standard) {
         extension_list = vgmstream_get_formats(&extension_list_len);
-        for (i = 0; i < extension_list_len; i++) {
-            if (strcasecmp(extension, extension_list[i]) == 0) {
-                return 1;
-            }
-        }
+        if (find_extension(extension, extension_list, extension_list_len))
+            return 1;
     }
 
     /* try in common extensions */
     if (cfg->accept_common) {
         extension_list = vgmstream_get_common_formats(&extension_list_len);
-        for (i = 0; i < extension_list_len; i++) {
-            if (strcasecmp(extension, extension_list[i]) == 0)
-                return 1;
-        }
+        if (find_extension(extension, extension_list, extension_list_len))
+            return 1;
     }
 
     /* allow anything not in the normal list but not in common extensions */
     if (cfg->accept_unknown) {
-        int is_common = 0;
-
         extension_list = vgmstream_get_common_formats(&extension_list_len);
-        for (i = 0; i < extension_list_len; i++) {
-            if (strcasecmp(extension, extension_list[i]) == 0) {
-                is_common = 1;
-                break;
+        if (!find_extension(extension, extension_list, extension_list_len))
+            return 1;
+    }
+
+    return 0;
+}
+
+/* ****************************************** */
+/* SUBSONGS: lists info of every subsong      */
+/* ****************************************** */
+
+static void get_subsong_info(VGMSTREAM* vgmstream, vgmstream_subsong_info* info) {
+    info->num_samples = vgmstream->num_samples;
+    info->sample_rate = vgmstream->sample_rate;
+    info->channels = vgmstream->channels;
+    info->loop_flag = vgmstream->loop_flag;
+    info->loop_start_sample = vgmstream->loop_start_sample;
+    info->loop_end_sample = vgmstream->loop_end_sample;
+    strncpy(info->stream_name, vgmstream->stream_name, sizeof(info->stream_name));
+    info->stream_name[sizeof(info->stream_name) - 1] = '\0';
+}
+
+/* total_subsongs is 0 for formats without subsongs, format (optional) gets the meta description */
+static vgmstream_subsong_info* get_subsongs_info(STREAMFILE* sf, int* subsong_count, int* total_subsongs, char* format, size_t format_size) {
+    vgmstream_subsong_info* infos = NULL;
+    VGMSTREAM* vgmstream = NULL;
+    int old_stream_index, old_probe_only;
+    int i, count;
+
+    if (!sf || !subsong_count)
+        return NULL;
+
+    old_stream_index = sf->stream_index;
+    old_probe_only = sf->probe_only;
+    sf->probe_only = 1;
+
+    /* first subsong tells the total */
+    sf->stream_index = 1;
+    vgmstream = init_vgmstream_from_STREAMFILE(sf);
+    if (!vgmstream) goto fail;
+
+    count = vgmstream->num_streams > 1 ? vgmstream->num_streams : 1;
+    infos = calloc(count, sizeof(vgmstream_subsong_info));
+    if (!infos) goto fail;
+
+    if (total_subsongs)
+        *total_subsongs = vgmstream->num_streams;
+    if (format)
+        get_vgmstream_meta_description(vgmstream, format, format_size);
+
+    get_subsong_info(vgmstream, &infos[0]);
+    close_vgmstream(vgmstream);
+    vgmstream = NULL;
+
+    for (i = 1; i < count; i++) {
+        sf->stream_index = i + 1;
+        vgmstream = init_vgmstream_from_STREAMFILE(sf);
+        if (!vgmstream)
+            continue; /* keep as empty info */
+
+        get_subsong_info(vgmstream, &infos[i]);
+        close_vgmstream(vgmstream);
+        vgmstream = NULL;
+    }
+
+    sf->stream_index = old_stream_index;
+    sf->probe_only = old_probe_only;
+    *subsong_count = count;
+    return infos;
+fail:
+    close_vgmstream(vgmstream);
+    sf->stream_index = old_stream_index;
+    sf->probe_only = old_probe_only;
+    return NULL;
+}
+
+vgmstream_subsong_info* vgmstream_get_subsongs_info(STREAMFILE* sf, int* subsong_count) {
+    return get_subsongs_info(sf, subsong_count, NULL, NULL, 0);
+}
+
+/* ****************************************** */
+/* SCAN: lists playable files and subsongs    */
+/* ****************************************** */
+
+/* results of one file, filled by any thread */
+typedef struct {
+    vgmstream_subsong_info* infos;
+    int count;                  /* 0 if not playable */
+    int total_subsongs;
+    char format[128];
+} scan_file_t;
+
+typedef struct {
+    const vgmstream_scan_cfg* cfg;
+    const char* const* filenames;
+    scan_file_t* files;
+} scan_job_t;
+
+static void scan_file_job(void* data, int index) {
+    scan_job_t* job = data;
+    scan_file_t* file = &job->files[index];
+    const vgmstream_scan_cfg* cfg = job->cfg;
+    STREAMFILE* sf;
+
+    if (cfg->open)
+        sf = cfg->open(job->filenames[index], cfg->open_data);
+    else
+        sf = open_stdio_streamfile(job->filenames[index]);
+    if (!sf) return;
+
+    file->infos = get_subsongs_info(sf, &file->count, &file->total_subsongs, file->format, sizeof(file->format));
+    close_streamfile(sf);
+}
+
+static char* scan_strdup(const char* str) {
+    char* copy = malloc(strlen(str) + 1);
+    if (copy)
+        strcpy(copy, str);
+    return copy;
+}
+
+int vgmstream_scan_files(const char* const* filenames, int filename_count, const vgmstream_scan_cfg* cfg, vgmstream_scan_result* result) {
+    const char** valid_names = NULL;
+    scan_file_t* files = NULL;
+    scan_job_t job;
+    int valid_count = 0, entry_count = 0;
+    int i, j, n;
+
+    if (!filenames || !cfg || !result)
+        return 0;
+    memset(result, 0, sizeof(vgmstream_scan_result));
+    if (filename_count <= 0)
+        return 1;
+
+    /* fast reject by extension before opening anything */
+    valid_names = malloc(filename_count * sizeof(const char*));
+    if (!valid_names) goto fail;
+    for (i = 0; i < filename_count; i++) {
+        vgmstream_ctx_valid_cfg valid_cfg = cfg->valid_cfg;
+        if (vgmstream_ctx_is_valid(filenames[i], &valid_cfg))
+            valid_names[valid_count++] = filenames[i];
+    }
+    if (valid_count == 0) {
+        free(valid_names);
+        return 1;
+    }
+
+    files = calloc(valid_count, sizeof(scan_file_t));
+    if (!files) goto fail;
+
+    job.cfg = cfg;
+    job.filenames = valid_names;
+    job.files = files;
+    if (cfg->run) {
+        cfg->run(scan_file_job, &job, valid_count, cfg->run_data);
+    }
+    else {
+        for (i = 0; i < valid_count; i++) {
+            scan_file_job(&job, i);
+        }
+    }
+
+    /* flatten playable subsongs in order */
+    for (i = 0; i < valid_count; i++) {
+        for (j = 0; j < files[i].count; j++) {
+            if (files[i].infos[j].num_samples > 0)
+                entry_count++;
+        }
+    }
+
+    result->entries = calloc(entry_count ? entry_count : 1, sizeof(vgmstream_scan_entry));
+    result->filenames = calloc(valid_count, sizeof(char*));
+    if (!result->entries || !result->filenames) goto fail;
+
+    n = 0;
+    for (i = 0; i < valid_count; i++) {
+        const char* filename = NULL;
+
+        for (j = 0; j < files[i].count; j++) {
+            vgmstream_scan_entry* entry = &result->entries[n];
+            if (files[i].infos[j].num_samples <= 0)
+                continue;
+
+            if (!filename) {
+                char* copy = scan_strdup(valid_names[i]);
+                if (!copy) goto fail;
+                result->filenames[result->file_count++] = copy;
+                filename = copy;
             }
+
+            entry->filename = filename;
+            entry->subsong = files[i].total_subsongs > 0 ? j + 1 : 0;
+            entry->total_subsongs = files[i].total_subsongs;
+            strcpy(entry->format, files[i].format);
+            entry->info = files[i].infos[j];
+            n++;
         }
+    }
+    result->entry_count = n;
 
-        if (!is_common)
-            return 1;
+    for (i = 0; i < valid_count; i++) {
+        free(files[i].infos);
+    }
+    free(files);
+    free(valid_names);
+    return 1;
+fail:
+    if (files) {
+        for (i = 0; i < valid_count; i++) {
+            free(files[i].infos);
+        }
+    }
+    free(files);
+    free(valid_names);
+    vgmstream_scan_free(result);
+    return 0;
+}
+
+typedef struct {
+    char** filenames;
+    int count;
+    int max;
+    int failed;
+} scan_list_t;
+
+static void scan_list_add(scan_list_t* list, const char* filename) {
+    char* copy;
+
+    if (list->count >= list->max) {
+        int max = list->max ? list->max * 2 : 256;
+        char** filenames = realloc(list->filenames, max * sizeof(char*));
+        if (!filenames) {
+            list->failed = 1;
+            return;
+        }
+        list->filenames = filenames;
+        list->max = max;
+    }
+
+    copy = scan_strdup(filename);
+    if (!copy) {
+        list->failed = 1;
+        return;
+    }
+    list->filenames[list->count++] = copy;
+}
+
+static void scan_list_path(scan_list_t* list, const char* path, int recursive, int is_root) {
+    char subpath[PATH_LIMIT];
+    struct stat st;
+
+    if (stat(path, &st) != 0)
+        return;
+    if (!(st.st_mode & S_IFDIR)) {
+        scan_list_add(list, path);
+        return;
+    }
+    if (!is_root && !recursive)
+        return;
+
+#if defined(__MSVCRT__) || defined(_MSC_VER)
+    {
+        struct _finddata_t find;
+        intptr_t handle;
+
+        snprintf(subpath, sizeof(subpath), "%s\\*", path);
+        handle = _findfirst(subpath, &find);
+        if (handle == -1)
+            return;
+        do {
+            if (strcmp(find.name, ".") == 0 || strcmp(find.name, "..") == 0)
+                continue;
+            snprintf(subpath, sizeof(subpath), "%s\\%s", path, find.name);
+            scan_list_path(list, subpath, recursive, 0);
+        } while (_findnext(handle, &find) == 0);
+        _findclose(handle);
+    }
+#else
+    {
+        DIR* dir;
+        struct dirent* entry;
+
+        dir = opendir(path);
+        if (!dir)
+            return;
+        while ((entry = readdir(dir)) != NULL) {
+            if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+                continue;
+            snprintf(subpath, sizeof(subpath), "%s/%s", path, entry->d_name);
+            scan_list_path(list, subpath, recursive, 0);
+        }
+        closedir(dir);
+    }
+#endif
+}
+
+static int scan_compare_names(const void* a, const void* b) {
+    return strcmp(*(const char**)a, *(const char**)b);
+}
+
+int vgmstream_scan_path(const char* path, const vgmstream_scan_cfg* cfg, vgmstream_scan_result* result) {
+    scan_list_t list = {0};
+    int i, ok = 0;
+
+    if (!path || !cfg || !result)
+        return 0;
+
+    scan_list_path(&list, path, cfg->recursive, 1);
+    if (!list.failed) {
+        if (list.count > 1)
+            qsort(list.filenames, list.count, sizeof(char*), scan_compare_names);
+        ok = vgmstream_scan_files((const char* const*)list.filenames, list.count, cfg, result);
+    }
+
+    for (i = 0; i < list.count; i++) {
+        free(list.filenames[i]);
+    }
+    free(list.filenames);
+    return ok;
+}
+
+void vgmstream_scan_free(vgmstream_scan_result* result) {
+    int i;
+
+    if (!result)
+        return;
+
+    if (result->filenames) {
+        for (i = 0; i < result->file_count; i++) {
+            free(result->filenames[i]);
+        }
+    }
+    free(result->filenames);
+    free(result->entries);
+    memset(result, 0, sizeof(vgmstream_scan_result));
+}
+
+/* ****************************************** */
+/* ANALYSIS: peak and loudness of a stream    */
+/* ****************************************** */
+
+#define ANALYSIS_BUFFER_SAMPLES 0x1000  /* per channel */
+#define ANALYSIS_PI 3.14159265358979323846
+
+/* loudness is measured on 400ms blocks every 100ms (ITU-R BS.1770), from the energy of each 100ms */
+#define ANALYSIS_STEPS_PER_BLOCK 4
+#define ANALYSIS_ABSOLUTE_GATE -70.0
+#define ANALYSIS_RELATIVE_GATE -10.0
+
+typedef struct {
+    /* K-weighting: high shelf then high pass biquads */
+    double b[2][3];
+    double a[2][3];
+    double z[VGMSTREAM_MAX_CHANNELS][2][2];
+    double weight[VGMSTREAM_MAX_CHANNELS];
+
+    int32_t step_samples;
+    int32_t step_pos;
+    double step_energy;
+
+    double* steps;
+    int step_count;
+    int step_size;
+
+    double total_energy;
+    int32_t total_samples;
+} analysis_state;
+
+static void setup_kweighting(analysis_state* state, int sample_rate) {
+    double f0, g, q, k, vh, vb, a0;
+
+    /* shelf (head acoustics), standard's 48000 Hz coefs generalized to any rate */
+    f0 = 1681.974450955533;
+    g = 3.999843853973347;
+    q = 0.7071752369554196;
+    k = tan(ANALYSIS_PI * f0 / sample_rate);
+    vh = pow(10.0, g / 20.0);
+    vb = pow(vh, 0.4996667741545416);
+    a0 = 1.0 + k / q + k * k;
+    state->b[0][0] = (vh + vb * k / q + k * k) / a0;
+    state->b[0][1] = 2.0 * (k * k - vh) / a0;
+    state->b[0][2] = (vh - vb * k / q + k * k) / a0;
+    state->a[0][1] = 2.0 * (k * k - 1.0) / a0;
+    state->a[0][2] = (1.0 - k / q + k * k) / a0;
+
+    /* high pass (RLB) */
+    f0 = 38.13547087602444;
+    q = 0.5003270373238773;
+    k = tan(ANALYSIS_PI * f0 / sample_rate);
+    a0 = 1.0 + k / q + k * k;
+    state->b[1][0] = 1.0;
+    state->b[1][1] = -2.0;
+    state->b[1][2] = 1.0;
+    state->a[1][1] = 2.0 * (k * k - 1.0) / a0;
+    state->a[1][2] = (1.0 - k / q + k * k) / a0;
+}
+
+/* surrounds count more and LFE is ignored, unknown layouts weight all channels the same */
+static void setup_weights(analysis_state* state, VGMSTREAM* vgmstream) {
+    uint32_t layout = vgmstream->channel_layout;
+    uint32_t speaker = 1;
+    int ch;
+
+    for (ch = 0; ch < vgmstream->channels; ch++) {
+        state->weight[ch] = 1.0;
+        if (!layout)
+            continue;
+
+        while (speaker && !(layout & speaker)) {
+            speaker <<= 1;
+        }
+        if (speaker == speaker_LFE)
+            state->weight[ch] = 0.0;
+        else if (speaker == speaker_BL || speaker == speaker_BR || speaker == speaker_SL || speaker == speaker_SR)
+            state->weight[ch] = 1.41;
+        speaker <<= 1;
+    }
+}
+
+static int add_step(analysis_state* state) {
+    if (state->step_count + 1 > state->step_size) {
+        int size = state->step_size ? state->step_size * 2 : 1024;
+        double* steps_re = realloc(state->steps, sizeof(double) * size);
+        if (!steps_re) return 0;
+        state->steps = steps_re;
+        state->step_size = size;
+    }
+
+    state->steps[state->step_count] = state->step_energy;
+    state->step_count++;
+    state->step_energy = 0.0;
+    state->step_pos = 0;
+    return 1;
+}
+
+static int analyze_samples(analysis_state* state, const sample_t* buf, int32_t samples, int channels, int* peak) {
+    int32_t s;
+    int ch, max = 0;
+
+    for (s = 0; s < samples * channels; s++) {
+        int sample = buf[s] < 0 ? -buf[s] : buf[s];
+        if (sample > max)
+            max = sample;
+    }
+    if (max > *peak)
+        *peak = max;
+
+    for (s = 0; s < samples; s++) {
+        double energy = 0.0;
+
+        for (ch = 0; ch < channels; ch++) {
+            double (*z)[2] = state->z[ch];
+            double x = buf[s * channels + ch] / 32768.0;
+            double y;
+
+            /* transposed direct form II */
+            y = state->b[0][0] * x + z[0][0];
+            z[0][0] = state->b[0][1] * x - state->a[0][1] * y + z[0][1];
+            z[0][1] = state->b[0][2] * x - state->a[0][2] * y;
+            x = y;
+            y = state->b[1][0] * x + z[1][0];
+            z[1][0] = state->b[1][1] * x - state->a[1][1] * y + z[1][1];
+            z[1][1] = state->b[1][2] * x - state->a[1][2] * y;
+
+            energy += state->weight[ch] * y * y;
+        }
+
+        state->step_energy += energy;
+        state->total_energy += energy;
+        state->step_pos++;
+        if (state->step_pos == state->step_samples) {
+            if (!add_step(state))
+                return 0;
+        }
+    }
+
+    state->total_samples += samples;
+    return 1;
+}
+
+static double get_loudness(double energy) {
+    return -0.691 + 10.0 * log10(energy > 0.0 ? energy : 1e-20);
+}
+
+static double get_gated_loudness(analysis_state* state) {
+    double block_samples = (double)state->step_samples * ANALYSIS_STEPS_PER_BLOCK;
+    double sum, gate;
+    int i, j, count;
+
+    /* too short for a single block, use the whole thing */
+    if (state->step_count < ANALYSIS_STEPS_PER_BLOCK) {
+        if (state->total_samples <= 0)
+            return get_loudness(0.0);
+        return get_loudness(state->total_energy / state->total_samples);
+    }
+
+    /* block energies replace steps (each block starts at its first step) */
+    for (i = 0; i <= state->step_count - ANALYSIS_STEPS_PER_BLOCK; i++) {
+        double energy = 0.0;
+        for (j = 0; j < ANALYSIS_STEPS_PER_BLOCK; j++) {
+            energy += state->steps[i + j];
+        }
+        state->steps[i] = energy / block_samples;
+    }
+    count = state->step_count - ANALYSIS_STEPS_PER_BLOCK + 1;
+
+    /* absolute gate, then relative to the loudness of what passed it */
+    sum = 0.0;
+    j = 0;
+    for (i = 0; i < count; i++) {
+        if (get_loudness(state->steps[i]) <= ANALYSIS_ABSOLUTE_GATE)
+            continue;
+        sum += state->steps[i];
+        j++;
+    }
+    if (j == 0)
+        return get_loudness(0.0);
+    gate = get_loudness(sum / j) + ANALYSIS_RELATIVE_GATE;
+
+    sum = 0.0;
+    j = 0;
+    for (i = 0; i < count; i++) {
+        double loudness = get_loudness(state->steps[i]);
+        if (loudness <= ANALYSIS_ABSOLUTE_GATE || loudness <= gate)
+            continue;
+        sum += state->steps[i];
+        j++;
+    }
+    if (j == 0)
+        return get_loudness(0.0);
+    return get_loudness(sum / j);
+}
+
+int vgmstream_analyze(VGMSTREAM* vgmstream, vgmstream_analysis_info* info) {
+    analysis_state* state = NULL;
+    sample_t* buf = NULL;
+    int32_t samples_left;
+    int old_loop_flag, peak = 0;
+
+    if (!vgmstream || !info)
+        return 0;
+    if (vgmstream->channels <= 0 || vgmstream->channels > VGMSTREAM_MAX_CHANNELS || vgmstream->sample_rate <= 0)
+        return 0;
+    old_loop_flag = vgmstream->loop_flag;
+
+    state = calloc(1, sizeof(analysis_state));
+    buf = malloc(sizeof(sample_t) * ANALYSIS_BUFFER_SAMPLES * vgmstream->channels);
+    if (!state || !buf) goto fail;
+
+    setup_kweighting(state, vgmstream->sample_rate);
+    setup_weights(state, vgmstream);
+    state->step_samples = vgmstream->sample_rate / 10;
+    if (state->step_samples <= 0)
+        state->step_samples = 1;
+
+    /* file as stored, without jumping back at loop end */
+    reset_vgmstream(vgmstream);
+    vgmstream->loop_flag = 0;
+
+    samples_left = vgmstream->num_samples;
+    while (samples_left > 0) {
+        int32_t samples_to_do = samples_left > ANALYSIS_BUFFER_SAMPLES ? ANALYSIS_BUFFER_SAMPLES : samples_left;
+
+        render_vgmstream_unmixed(buf, samples_to_do, vgmstream);
+        if (!analyze_samples(state, buf, samples_to_do, vgmstream->channels, &peak))
+            goto fail;
+
+        samples_left -= samples_to_do;
     }
 
+    vgmstream->loop_flag = old_loop_flag;
+    reset_vgmstream(vgmstream);
+
+    info->peak = peak / 32768.0;
+    info->loudness = get_gated_loudness(state);
+
+    free(state->steps);
+    free(state);
+    free(buf);
+    return 1;
+fail:
+    vgmstream->loop_flag = old_loop_flag;
+    reset_vgmstream(vgmstream);
+    if (state)
+        free(state->steps);
+    free(state);
+    free(buf);
     return 0;
 }
 
+/* ****************************************** */
+/* PLAYER: renders and seeks for plugins      */
+/* ****************************************** */
+
+#define PLAYER_CHUNK_SAMPLES 2048       /* small enough for low latency, big enough to amortize layouts */
+#define PLAYER_CHUNK_SAMPLES_MAX 0x4000 /* for codecs with huge frames */
+
+typedef struct {
+    int32_t sample;             /* stream position when saved (first pass only) */
+    vgmstream_snapshot* snapshot;
+} player_checkpoint;
+
+struct vgmstream_player {
+    VGMSTREAM* vgmstream;
+    int approximate_seek;
+    int32_t chunk_samples;
+    int32_t position;
+    int32_t length;             /* -1 if forever */
+
+    player_checkpoint* checkpoints;
+    int checkpoint_count;
+    int checkpoints_max;
+    int32_t checkpoint_interval; /* 0 if disabled or unsupported */
+    size_t checkpoint_budget;
+    size_t checkpoint_bytes;
+};
+
+/* a multiple of the codec's frame so chunks don't leave half-decoded frames around */
+static int32_t get_player_chunk_samples(VGMSTREAM* vgmstream) {
+    int32_t frame_samples = get_vgmstream_samples_per_frame(vgmstream);
+
+    if (frame_samples <= 0 || frame_samples > PLAYER_CHUNK_SAMPLES_MAX)
+        return PLAYER_CHUNK_SAMPLES;
+    if (frame_samples > PLAYER_CHUNK_SAMPLES)
+        return frame_samples;
+    return (PLAYER_CHUNK_SAMPLES + frame_samples - 1) / frame_samples * frame_samples;
+}
+
+vgmstream_player* vgmstream_player_init(VGMSTREAM* vgmstream, const vgmstream_player_cfg* cfg) {
+    vgmstream_player* player;
+
+    if (!vgmstream || !cfg)
+        return NULL;
+
+    player = calloc(1, sizeof(vgmstream_player));
+    if (!player) return NULL;
+
+    if (cfg->play_cfg) {
+        vgmstream_cfg_t play_cfg = *cfg->play_cfg;
+        vgmstream_apply_config(vgmstream, &play_cfg);
+    }
+
+    player->vgmstream = vgmstream;
+    player->approximate_seek = cfg->approximate_seek;
+    player->chunk_samples = cfg->chunk_samples > 0 ? cfg->chunk_samples : get_player_chunk_samples(vgmstream);
+    player->checkpoint_interval = cfg->checkpoint_seconds > 0 ? cfg->checkpoint_seconds * vgmstream->sample_rate : 0;
+    player->checkpoint_budget = membudget_get_checkpoint_size(cfg->checkpoint_budget);
+
+    /* setup that would happen in the first render, so the host's audio thread doesn't allocate */
+    prepare_vgmstream(vgmstream);
+
+    if (vgmstream->config_enabled)
+        player->length = vgmstream->pstate.play_forever ? -1 : vgmstream_get_samples(vgmstream);
+    else
+        player->length = vgmstream->loop_flag ? -1 : vgmstream->num_samples;
+
+    return player;
+}
+
+int32_t vgmstream_player_get_chunk_samples(vgmstream_player* player) {
+    return player->chunk_samples;
+}
+
+int32_t vgmstream_player_get_position(vgmstream_player* player) {
+    return player->position;
+}
+
+int32_t vgmstream_player_get_length(vgmstream_player* player) {
+    return player->length;
+}
+
+static void free_player_checkpoints(vgmstream_player* player) {
+    int i;
+
+    for (i = 0; i < player->checkpoint_count; i++) {
+        vgmstream_free_snapshot(player->checkpoints[i].snapshot);
+    }
+    free(player->checkpoints);
+    player->checkpoints = NULL;
+    player->checkpoint_count = 0;
+    player->checkpoints_max = 0;
+    membudget_add_checkpoints(-(long)player->checkpoint_bytes);
+    player->checkpoint_bytes = 0;
+}
+
+/* when over budget keeps every other checkpoint and doubles the interval, so seeks stay close-ish
+ * over the whole stream rather than only near the start */
+static void thin_player_checkpoints(vgmstream_player* player) {
+    size_t freed = 0;
+    int i, count = 0;
+
+    for (i = 0; i < player->checkpoint_count; i++) {
+        if (i % 2 == 0) {
+            freed += vgmstream_snapshot_size(player->checkpoints[i].snapshot);
+            vgmstream_free_snapshot(player->checkpoints[i].snapshot);
+            continue;
+        }
+        player->checkpoints[count] = player->checkpoints[i];
+        count++;
+    }
+
+    player->checkpoint_count = count;
+    player->checkpoint_bytes -= freed;
+    player->checkpoint_interval *= 2;
+    membudget_add_checkpoints(-(long)freed);
+}
+
+void vgmstream_player_free(vgmstream_player* player) {
+    if (!player)
+        return;
+
+    free_player_checkpoints(player);
+    free(player);
+}
+
+/* saves the state every interval while playing the first pass (positions repeat after looping) */
+static void add_player_checkpoint(vgmstream_player* player) {
+    VGMSTREAM* vgmstream = player->vgmstream;
+    vgmstream_snapshot* snapshot;
+    int32_t last;
+
+    if (player->checkpoint_interval <= 0 || vgmstream->loop_count > 0)
+        return;
+
+    last = player->checkpoint_count ? player->checkpoints[player->checkpoint_count - 1].sample : 0;
+    if (vgmstream->current_sample < last + player->checkpoint_interval)
+        return;
+    if (player->checkpoint_budget && player->checkpoint_bytes >= player->checkpoint_budget) {
+        thin_player_checkpoints(player);
+        if (player->checkpoint_bytes >= player->checkpoint_budget) /* single huge ones */
+            return;
+        last = player->checkpoint_count ? player->checkpoints[player->checkpoint_count - 1].sample : 0;
+        if (vgmstream->current_sample < last + player->checkpoint_interval)
+            return;
+    }
+
+    if (player->checkpoint_count >= player->checkpoints_max) {
+        int checkpoints_max = player->checkpoints_max ? player->checkpoints_max * 2 : 16;
+        player_checkpoint* checkpoints = realloc(player->checkpoints, checkpoints_max * sizeof(player_checkpoint));
+        if (!checkpoints) return;
+
+        player->checkpoints = checkpoints;
+        player->checkpoints_max = checkpoints_max;
+    }
+
+    /* some codecs (FFmpeg, Vorbis, MPEG...) keep state that can't be saved, those decode forward */
+    snapshot = vgmstream_save_snapshot(vgmstream);
+    if (!snapshot) {
+        player->checkpoint_interval = 0;
+        free_player_checkpoints(player);
+        return;
+    }
+
+    player->checkpoints[player->checkpoint_count].sample = vgmstream->current_sample;
+    player->checkpoints[player->checkpoint_count].snapshot = snapshot;
+    player->checkpoint_count++;
+    player->checkpoint_bytes += vgmstream_snapshot_size(snapshot);
+    membudget_add_checkpoints((long)vgmstream_snapshot_size(snapshot));
+}
+
+/* restores the last checkpoint before sample, if it's past minimum (closer than decoding from there) */
+static void restore_player_checkpoint(vgmstream_player* player, int32_t sample, int32_t minimum) {
+    const player_checkpoint* found = NULL;
+    int i;
+
+    for (i = 0; i < player->checkpoint_count; i++) {
+        if (player->checkpoints[i].sample > sample)
+            break;
+        found = &player->checkpoints[i];
+    }
+    if (!found || found->sample <= minimum)
+        return;
+
+    vgmstream_restore_snapshot(player->vgmstream, found->snapshot);
+}
+
+void vgmstream_player_seek(vgmstream_player* player, int32_t seek_sample) {
+    VGMSTREAM* vgmstream = player->vgmstream;
+
+    if (seek_sample < 0)
+        seek_sample = 0;
+    if (player->length >= 0 && seek_sample > player->length)
+        seek_sample = player->length;
+
+    /* a checkpoint may be closer than where seeking would decode forward from */
+    if (seek_sample < vgmstream->current_sample || vgmstream->loop_count > 0)
+        restore_player_checkpoint(player, seek_sample, 0);
+    else if (player->checkpoint_interval > 0 && seek_sample - vgmstream->current_sample > player->checkpoint_interval)
+        restore_player_checkpoint(player, seek_sample, vgmstream->current_sample);
+
+    /* jumps directly when it can (segments, visited blocks, PCM), else decodes forward */
+    if (player->approximate_seek)
+        seek_vgmstream_approximate(vgmstream, seek_sample);
+    else
+        seek_vgmstream(vgmstream, seek_sample);
+
+    player->position = seek_sample;
+}
+
+static int32_t get_player_samples_to_do(vgmstream_player* player, int32_t sample_count) {
+    if (player->length < 0)
+        return sample_count;
+    if (player->position >= player->length)
+        return 0;
+    if (sample_count > player->length - player->position)
+        return player->length - player->position;
+    return sample_count;
+}
+
+int32_t vgmstream_player_render(vgmstream_player* player, sample_t* buffer, int32_t sample_count) {
+    VGMSTREAM* vgmstream = player->vgmstream;
+    int input_channels, output_channels;
+    int32_t samples_done = 0;
+
+    input_channels = output_channels = vgmstream->channels;
+    mixing_info(vgmstream, &input_channels, &output_channels);
+
+    sample_count = get_player_samples_to_do(player, sample_count);
+    while (samples_done < sample_count) {
+        int32_t samples_to_do = sample_count - samples_done;
+        if (samples_to_do > player->chunk_samples)
+            samples_to_do = player->chunk_samples;
+
+        render_vgmstream(buffer + samples_done * output_channels, samples_to_do, vgmstream);
+        add_player_checkpoint(player);
+
+        samples_done += samples_to_do;
+        player->position += samples_to_do;
+    }
+
+    return samples_done;
+}
+
+int32_t vgmstream_player_render_float(vgmstream_player* player, float* buffer, int32_t sample_count) {
+    VGMSTREAM* vgmstream = player->vgmstream;
+    int input_channels, output_channels;
+    int32_t samples_done = 0;
+
+    input_channels = output_channels = vgmstream->channels;
+    mixing_info(vgmstream, &input_channels, &output_channels);
+
+    sample_count = get_player_samples_to_do(player, sample_count);
+    while (samples_done < sample_count) {
+        int32_t samples_to_do = sample_count - samples_done;
+        if (samples_to_do > player->chunk_samples)
+            samples_to_do = player->chunk_samples;
+
+        render_vgmstream_float(buffer + samples_done * output_channels, samples_to_do, vgmstream);
+        add_player_checkpoint(player);
+
+        samples_done += samples_to_do;
+        player->position += samples_to_do;
+    }
+
+    return samples_done;
+}
+
 /* ****************************************** */
 /* TAGS: loads key=val tags from a file       */
 /* ****************************************** */
 
 #define VGMSTREAM_TAGS_LINE_MAX 2048
+#define TAGS_CACHE_SIZE 4
+
+/* Tag files are parsed once into a list of relevant lines, plus an index of filenames (and the prefixes
+ * virtual .txtp match) to the first line with that name, so each file's lookup doesn't re-read the file. */
+enum {
+    TAGS_LINE_GLOBAL,       /* # @KEY val */
+    TAGS_LINE_FILE,         /* # %KEY val */
+    TAGS_LINE_AUTOTRACK,    /* # $AUTOTRACK */
+    TAGS_LINE_AUTOALBUM,    /* # $AUTOALBUM */
+    TAGS_LINE_FILENAME,
+};
+
+typedef struct {
+    int type;
+    int key;                /* offsets in text (key is the name for filenames) */
+    int val;
+    int section_start;      /* filenames: first line of their section */
+    int track;              /* filenames: track number */
+} tags_line_t;
+
+typedef struct {
+    uint32_t hash;
+    int line;               /* -1 if empty */
+    int len;
+} tags_index_t;
+
+typedef struct {
+    uint64_t id;            /* name and size of the tag file */
+    int refs;
+
+    tags_line_t* lines;
+    int line_count;
+    char* text;
+    int text_size;
+
+    tags_index_t* index;
+    int index_size;         /* power of 2 */
+} tags_file_t;
 
 /* opaque tag state */
 struct VGMSTREAM_TAGS {
@@ -81,36 +978,367 @@ struct VGMSTREAM_TAGS {
     /* path of targetname */
     char targetpath[VGMSTREAM_TAGS_LINE_MAX];
 
-    /* tag section for filename (see comments below) */
-    int section_found;
-    off_t section_start;
-    off_t section_end;
-    off_t offset;
+    /* parsed tag file (kept between resets) */
+    tags_file_t* file;
+
+    /* current output (see vgmstream_tags_next_tag) */
+    int started;
+    int stage;
+    int pos;
+    int target_line;        /* -1 if not in the tag file */
 
     /* commands */
     int autotrack_on;
-    int autotrack_written;
     int track_count;
-
     int autoalbum_on;
-    int autoalbum_written;
 };
 
+/* Last few parsed tag files, so players asking for each file of a folder with a new VGMSTREAM_TAGS
+ * share them. Only enabled with vgmstream_tags_cache_setup. */
+static struct {
+    int enabled;
+    tags_file_t* entries[TAGS_CACHE_SIZE];
+    int count;
+    int next;
+    void (*lock)(void*);
+    void (*unlock)(void*);
+    void* lock_data;
+} tags_cache;
+
+
+static void tags_cache_lock(void) {
+    if (tags_cache.lock)
+        tags_cache.lock(tags_cache.lock_data);
+}
+
+static void tags_cache_unlock(void) {
+    if (tags_cache.unlock)
+        tags_cache.unlock(tags_cache.lock_data);
+}
+
+static void tags_file_free(tags_file_t* tf) {
+    if (!tf) return;
+    free(tf->lines);
+    free(tf->text);
+    free(tf->index);
+    free(tf);
+}
+
+/* drops a reference, freeing the file when unused (takes the cache lock as refs may be shared) */
+static void tags_file_release(tags_file_t* tf) {
+    int refs;
+
+    if (!tf) return;
+    tags_cache_lock();
+    refs = --tf->refs;
+    tags_cache_unlock();
+
+    if (refs == 0)
+        tags_file_free(tf);
+}
+
+void vgmstream_tags_cache_setup(int enabled, void (*lock)(void*), void (*unlock)(void*), void* lock_data) {
+    tags_file_t* old[TAGS_CACHE_SIZE];
+    int i, old_count;
+
+    tags_cache_lock();
+    old_count = tags_cache.count;
+    for (i = 0; i < old_count; i++) {
+        old[i] = tags_cache.entries[i];
+        tags_cache.entries[i] = NULL;
+    }
+    tags_cache.count = 0;
+    tags_cache.next = 0;
+    tags_cache_unlock();
+
+    for (i = 0; i < old_count; i++) {
+        tags_file_release(old[i]);
+    }
 
-static void tags_clean(VGMSTREAM_TAGS* tag) {
+    tags_cache.enabled = enabled;
+    tags_cache.lock = lock;
+    tags_cache.unlock = unlock;
+    tags_cache.lock_data = lock_data;
+}
+
+static uint64_t tags_file_id(STREAMFILE* tagfile) {
+    char filename[PATH_LIMIT];
+    uint64_t hash = 0xCBF29CE484222325ULL; /* FNV-1a */
+    int i;
+
+    get_streamfile_name(tagfile, filename, sizeof(filename));
+    for (i = 0; filename[i]; i++) {
+        hash = (hash ^ (uint8_t)filename[i]) * 0x100000001B3ULL;
+    }
+    return (hash ^ get_streamfile_size(tagfile)) * 0x100000001B3ULL;
+}
+
+/* case insensitive like the name matching (strncasecmp) */
+static uint32_t tags_name_hash(const char* name, int len) {
+    uint32_t hash = 0x811C9DC5; /* FNV-1a */
     int i;
-    int val_len = strlen(tag->val);
+
+    for (i = 0; i < len; i++) {
+        uint8_t c = (uint8_t)name[i];
+        if (c >= 'A' && c <= 'Z')
+            c += 0x20;
+        hash = (hash ^ c) * 0x01000193;
+    }
+    return hash;
+}
+
+static tags_index_t* tags_index_find(tags_file_t* tf, const char* name, int len, uint32_t hash) {
+    uint32_t mask = tf->index_size - 1;
+    uint32_t i;
+
+    for (i = hash & mask; tf->index[i].line >= 0; i = (i + 1) & mask) {
+        tags_index_t* entry = &tf->index[i];
+        if (entry->hash == hash && entry->len == len &&
+                strncasecmp(tf->text + tf->lines[entry->line].key, name, len) == 0)
+            return entry;
+    }
+    return &tf->index[i]; /* empty slot */
+}
+
+/* maps name[0..len) to line, unless an earlier line has it */
+static void tags_index_add(tags_file_t* tf, int line, int len) {
+    const char* name = tf->text + tf->lines[line].key;
+    uint32_t hash = tags_name_hash(name, len);
+    tags_index_t* entry = tags_index_find(tf, name, len, hash);
+
+    if (entry->line >= 0)
+        return;
+    entry->hash = hash;
+    entry->line = line;
+    entry->len = len;
+}
+
+static int tags_build_index(tags_file_t* tf) {
+    int i, j, keys = 0;
+
+    /* names and their prefixes (see vgmstream_tags_next_tag) */
+    for (i = 0; i < tf->line_count; i++) {
+        const char* name = tf->text + tf->lines[i].key;
+        if (tf->lines[i].type != TAGS_LINE_FILENAME)
+            continue;
+        keys++;
+        if (vgmstream_is_virtual_filename(name)) {
+            for (j = 0; name[j]; j++) {
+                if (name[j] == ' ' || name[j] == '.' || name[j] == '#')
+                    keys++;
+            }
+        }
+    }
+
+    tf->index_size = 16;
+    while (tf->index_size < keys * 2) {
+        tf->index_size *= 2;
+    }
+    tf->index = malloc(tf->index_size * sizeof(tags_index_t));
+    if (!tf->index) return 0;
+    for (i = 0; i < tf->index_size; i++) {
+        tf->index[i].line = -1;
+    }
+
+    for (i = 0; i < tf->line_count; i++) {
+        const char* name = tf->text + tf->lines[i].key;
+        if (tf->lines[i].type != TAGS_LINE_FILENAME)
+            continue;
+        tags_index_add(tf, i, strlen(name));
+        if (vgmstream_is_virtual_filename(name)) {
+            for (j = 0; name[j]; j++) {
+                if (name[j] == ' ' || name[j] == '.' || name[j] == '#')
+                    tags_index_add(tf, i, j);
+            }
+        }
+    }
+
+    return 1;
+}
+
+static int tags_add_text(tags_file_t* tf, int* text_max, const char* str, int len) {
+    int offset = tf->text_size;
+
+    if (tf->text_size + len + 1 > *text_max) {
+        int new_max = (*text_max ? *text_max * 2 : 0x1000) + len + 1;
+        char* new_text = realloc(tf->text, new_max);
+        if (!new_text) return -1;
+        tf->text = new_text;
+        *text_max = new_max;
+    }
+    memcpy(tf->text + offset, str, len);
+    tf->text[offset + len] = '\0';
+    tf->text_size += len + 1;
+    return offset;
+}
+
+static int tags_add_line(tags_file_t* tf, int* lines_max, int* text_max, int type, const char* key, int key_len, const char* val) {
+    tags_line_t* line;
+    int val_len = 0;
+
+    if (tf->line_count == *lines_max) {
+        int new_max = *lines_max ? *lines_max * 2 : 64;
+        tags_line_t* new_lines = realloc(tf->lines, new_max * sizeof(tags_line_t));
+        if (!new_lines) return 0;
+        tf->lines = new_lines;
+        *lines_max = new_max;
+    }
 
     /* remove trailing spaces */
-    for (i = val_len - 1; i > 0; i--) {
-        if (tag->val[i] != ' ')
+    if (val) {
+        val_len = strlen(val);
+        while (val_len > 1 && val[val_len - 1] == ' ') {
+            val_len--;
+        }
+    }
+
+    line = &tf->lines[tf->line_count];
+    memset(line, 0, sizeof(tags_line_t));
+    line->type = type;
+    line->key = tags_add_text(tf, text_max, key, key_len);
+    line->val = tags_add_text(tf, text_max, val ? val : "", val_len);
+    if (line->key < 0 || line->val < 0)
+        return 0;
+
+    tf->line_count++;
+    return 1;
+}
+
+/* reads the tag file once, keeping only lines that output or locate tags */
+static tags_file_t* tags_file_parse(STREAMFILE* tagfile, uint64_t id) {
+    tags_file_t* tf = NULL;
+    off_t offset = 0, file_size = get_streamfile_size(tagfile);
+    char line[VGMSTREAM_TAGS_LINE_MAX];
+    char key[VGMSTREAM_TAGS_LINE_MAX];
+    char val[VGMSTREAM_TAGS_LINE_MAX];
+    int lines_max = 0, text_max = 0;
+    int section_start = 0, track = 0;
+    int ok, bytes_read, line_ok, n1, n2;
+
+    tf = calloc(1, sizeof(tags_file_t));
+    if (!tf) goto fail;
+    tf->id = id;
+    tf->refs = 1;
+
+    /* skip BOM if needed */
+    if ((uint16_t)read_16bitLE(0x00, tagfile) == 0xFFFE ||
+        (uint16_t)read_16bitLE(0x00, tagfile) == 0xFEFF) {
+        offset = 0x02;
+    }
+    else if (((uint32_t)read_32bitBE(0x00, tagfile) & 0xFFFFFF00) ==  0xEFBBBF00) {
+        offset = 0x03;
+    }
+
+    while (offset <= file_size) {
+        bytes_read = read_line(line, sizeof(line), offset, tagfile, &line_ok);
+        if (!line_ok || bytes_read == 0) break; /* lines after a bad one are ignored */
+        offset += bytes_read;
+
+        if (line[0] == '#') {
+            /* find possible global command */
+            ok = sscanf(line, "# $%[^ \t] %[^\r\n]", key, val);
+            if (ok == 1 || ok == 2) {
+                if (strcasecmp(key,"AUTOTRACK") == 0) {
+                    if (!tags_add_line(tf, &lines_max, &text_max, TAGS_LINE_AUTOTRACK, "", 0, NULL)) goto fail;
+                }
+                else if (strcasecmp(key,"AUTOALBUM") == 0) {
+                    if (!tags_add_line(tf, &lines_max, &text_max, TAGS_LINE_AUTOALBUM, "", 0, NULL)) goto fail;
+                }
+                continue; /* not an actual tag */
+            }
+
+            /* find possible global tag */
+            ok = sscanf(line, "# @%[^@]@ %[^\r\n]", key, val); /* key with spaces */
+            if (ok != 2)
+                ok = sscanf(line, "# @%[^ \t] %[^\r\n]", key, val); /* key without */
+            if (ok == 2) {
+                if (!tags_add_line(tf, &lines_max, &text_max, TAGS_LINE_GLOBAL, key, strlen(key), val)) goto fail;
+                continue;
+            }
+
+            /* find possible file tag */
+            ok = sscanf(line, "# %%%[^%%]%% %[^\r\n] ", key, val); /* key with spaces */
+            if (ok != 2)
+                ok = sscanf(line, "# %%%[^ \t] %[^\r\n] ", key, val); /* key without */
+            if (ok == 2) {
+                if (!tags_add_line(tf, &lines_max, &text_max, TAGS_LINE_FILE, key, strlen(key), val)) goto fail;
+            }
+            continue;
+        }
+
+        /* find possible filename, starting a new section after it
+         * (.m3u seem to allow filenames with whitespaces before, make sure to trim) */
+        ok = sscanf(line, " %n%[^\r\n]%n ", &n1, key, &n2);
+        if (ok == 1) {
+            if (!tags_add_line(tf, &lines_max, &text_max, TAGS_LINE_FILENAME, line + n1, n2 - n1, NULL)) goto fail;
+            track++; /* new track found (target filename or not) */
+            tf->lines[tf->line_count - 1].section_start = section_start;
+            tf->lines[tf->line_count - 1].track = track;
+            section_start = tf->line_count;
+        }
+        /* empty/bad line, probably */
+    }
+
+    if (!tags_build_index(tf))
+        goto fail;
+    return tf;
+fail:
+    tags_file_free(tf);
+    return NULL;
+}
+
+/* parsed tag file from the cache (if enabled and known) or parsed now */
+static tags_file_t* tags_file_get(STREAMFILE* tagfile) {
+    uint64_t id = tags_file_id(tagfile);
+    tags_file_t* tf = NULL;
+    tags_file_t* old = NULL;
+    int i;
+
+    if (tags_cache.enabled) {
+        tags_cache_lock();
+        for (i = 0; i < tags_cache.count; i++) {
+            if (tags_cache.entries[i]->id == id) {
+                tf = tags_cache.entries[i];
+                tf->refs++;
+                break;
+            }
+        }
+        tags_cache_unlock();
+        if (tf)
+            return tf;
+    }
+
+    tf = tags_file_parse(tagfile, id);
+    if (!tf || !tags_cache.enabled)
+        return tf;
+
+    tags_cache_lock();
+    for (i = 0; i < tags_cache.count; i++) {
+        if (tags_cache.entries[i]->id == id)
             break;
-        tag->val[i] = '\0';
     }
+    if (i == tags_cache.count) {
+        i = tags_cache.next;
+        tags_cache.next = (tags_cache.next + 1) % TAGS_CACHE_SIZE;
+        if (tags_cache.count < TAGS_CACHE_SIZE)
+            tags_cache.count++;
+        else
+            old = tags_cache.entries[i];
+    }
+    else {
+        old = tags_cache.entries[i];
+    }
+    tags_cache.entries[i] = tf;
+    tf->refs++;
+    tags_cache_unlock();
+
+    tags_file_release(old);
+    return tf;
 }
 
+
 VGMSTREAM_TAGS* vgmstream_tags_init(const char* *tag_key, const char* *tag_val) {
-    VGMSTREAM_TAGS* tags = malloc(sizeof(VGMSTREAM_TAGS));
+    VGMSTREAM_TAGS* tags = calloc(1, sizeof(VGMSTREAM_TAGS));
     if (!tags) goto fail;
 
     *tag_key = tags->key;
@@ -122,167 +1350,124 @@ fail:
 }
 
 void vgmstream_tags_close(VGMSTREAM_TAGS *tags) {
+    if (!tags) return;
+    tags_file_release(tags->file);
     free(tags);
 }
 
+/* finds the target's filename line and the commands before it */
+static void tags_start(VGMSTREAM_TAGS* tags) {
+    tags_file_t* tf = tags->file;
+    tags_index_t* entry;
+    int i;
+
+    tags->started = 1;
+    tags->stage = 0;
+    tags->pos = 0;
+
+    entry = tags_index_find(tf, tags->targetname, tags->targetname_len,
+            tags_name_hash(tags->targetname, tags->targetname_len));
+    tags->target_line = entry->line;
+    if (tags->target_line < 0)
+        return;
+
+    for (i = 0; i < tags->target_line; i++) {
+        if (tf->lines[i].type == TAGS_LINE_AUTOTRACK)
+            tags->autotrack_on = 1;
+        else if (tf->lines[i].type == TAGS_LINE_AUTOALBUM)
+            tags->autoalbum_on = 1;
+    }
+    tags->track_count = tf->lines[tags->target_line].track;
+}
+
+static int tags_output_line(VGMSTREAM_TAGS* tags, const tags_line_t* line) {
+    snprintf(tags->key, sizeof(tags->key), "%s", tags->file->text + line->key);
+    snprintf(tags->val, sizeof(tags->val), "%s", tags->file->text + line->val);
+    return 1;
+}
+
 /* Find next tag and return 1 if found.
  *
  * Tags can be "global" @TAGS, "command" $TAGS, and "file" %TAGS for a target filename.
  * To extract tags we must find either global tags, or the filename's tag "section"
  * where tags apply: (# @TAGS ) .. (other_filename) ..(# %TAGS section).. (target_filename).
- * When a new "other_filename" is found that offset is marked as section_start, and when
- * target_filename is found it's marked as section_end. Then we can begin extracting tags
- * within that section, until all tags are exhausted. Global tags are extracted as found,
- * so they always go first, also meaning any tags after file's section are ignored.
- * Command tags have special meanings and are output after all section tags. */
+ * A section starts after the previous filename (or at file start) and ends at the first
+ * line with target_filename, OR a virtual .txtp with the filename inside (so 'file.adx' gets
+ * tags from 'file.adx#i.txtp', reading tags even if we don't open !tags.m3u with virtual .txtp
+ * directly). Global tags before target_filename go first (any after are ignored), then tags
+ * within the section. Command tags have special meanings and are output after all section tags. */
 int vgmstream_tags_next_tag(VGMSTREAM_TAGS* tags, STREAMFILE* tagfile) {
-    off_t file_size = get_streamfile_size(tagfile);
-    char currentname[VGMSTREAM_TAGS_LINE_MAX] = {0};
-    char line[VGMSTREAM_TAGS_LINE_MAX];
-    int ok, bytes_read, line_ok, n1,n2;
+    tags_file_t* tf;
 
     if (!tags)
         return 0;
 
-    /* prepare file start and skip BOM if needed */
-    if (tags->offset == 0) {
-        if ((uint16_t)read_16bitLE(0x00, tagfile) == 0xFFFE ||
-            (uint16_t)read_16bitLE(0x00, tagfile) == 0xFEFF) {
-            tags->offset = 0x02;
-            if (tags->section_start == 0)
-                tags->section_start = 0x02;
+    if (!tags->started) {
+        /* reuse the parsed file if it's the same one */
+        if (!tags->file || tags->file->id != tags_file_id(tagfile)) {
+            tags_file_release(tags->file);
+            tags->file = tags_file_get(tagfile);
         }
-        else if (((uint32_t)read_32bitBE(0x00, tagfile) & 0xFFFFFF00) ==  0xEFBBBF00) {
-            tags->offset = 0x03;
-            if (tags->section_start == 0)
-                tags->section_start = 0x03;
-        }
-    }
-
-    /* read lines */
-    while (tags->offset <= file_size) {
-
-        /* after section: no more tags to extract */
-        if (tags->section_found && tags->offset >= tags->section_end) {
-
-            /* write extra tags after all regular tags */
-            if (tags->autotrack_on && !tags->autotrack_written) {
-                sprintf(tags->key, "%s", "TRACK");
-                sprintf(tags->val, "%i", tags->track_count);
-                tags->autotrack_written = 1;
-                return 1;
-            }
-
-            if (tags->autoalbum_on && !tags->autoalbum_written && tags->targetpath[0] != '\0') {
-                const char* path;
-
-                path = strrchr(tags->targetpath,'\\');
-                if (!path) {
-                    path = strrchr(tags->targetpath,'/');
-                }
-                if (!path) {
-                    path = tags->targetpath;
-                }
-
-                sprintf(tags->key, "%s", "ALBUM");
-                sprintf(tags->val, "%s", path+1);
-                tags->autoalbum_written = 1;
-                return 1;
-            }
-
+        if (!tags->file)
             goto fail;
+        tags_start(tags);
+    }
+    tf = tags->file;
+
+    /* global tags before the target */
+    if (tags->stage == 0) {
+        int end = tags->target_line >= 0 ? tags->target_line : tf->line_count;
+        while (tags->pos < end) {
+            const tags_line_t* line = &tf->lines[tags->pos++];
+            if (line->type == TAGS_LINE_GLOBAL)
+                return tags_output_line(tags, line);
         }
 
-        bytes_read = read_line(line, sizeof(line), tags->offset, tagfile, &line_ok);
-        if (!line_ok || bytes_read == 0) goto fail;
-
-        tags->offset += bytes_read;
+        if (tags->target_line < 0)
+            goto fail;
+        tags->stage = 1;
+        tags->pos = tf->lines[tags->target_line].section_start;
+    }
 
+    /* target's section */
+    if (tags->stage == 1) {
+        while (tags->pos < tags->target_line) {
+            const tags_line_t* line = &tf->lines[tags->pos++];
+            if (line->type == TAGS_LINE_FILE)
+                return tags_output_line(tags, line);
+        }
+        tags->stage = 2;
+    }
 
-        if (tags->section_found) {
-            /* find possible file tag */
-            ok = sscanf(line, "# %%%[^%%]%% %[^\r\n] ", tags->key,tags->val); /* key with spaces */
-            if (ok != 2)
-                ok = sscanf(line, "# %%%[^ \t] %[^\r\n] ", tags->key,tags->val); /* key without */
-            if (ok == 2) {
-                tags_clean(tags);
-                return 1;
-            }
+    /* write extra tags after all regular tags */
+    if (tags->stage == 2) {
+        tags->stage = 3;
+        if (tags->autotrack_on) {
+            sprintf(tags->key, "%s", "TRACK");
+            sprintf(tags->val, "%i", tags->track_count);
+            return 1;
         }
-        else {
-
-            if (line[0] == '#') {
-                /* find possible global command */
-                ok = sscanf(line, "# $%[^ \t] %[^\r\n]", tags->key,tags->val);
-                if (ok == 1 || ok == 2) {
-                    if (strcasecmp(tags->key,"AUTOTRACK") == 0) {
-                        tags->autotrack_on = 1;
-                    }
-                    else if (strcasecmp(tags->key,"AUTOALBUM") == 0) {
-                        tags->autoalbum_on = 1;
-                    }
-
-                    continue; /* not an actual tag */
-                }
+    }
 
-                /* find possible global tag */
-                ok = sscanf(line, "# @%[^@]@ %[^\r\n]", tags->key,tags->val); /* key with spaces */
-                if (ok != 2)
-                    ok = sscanf(line, "# @%[^ \t] %[^\r\n]", tags->key,tags->val); /* key without */
-                if (ok == 2) {
-                    tags_clean(tags);
-                    return 1;
-                }
+    if (tags->stage == 3) {
+        tags->stage = 4;
+        if (tags->autoalbum_on && tags->targetpath[0] != '\0') {
+            const char* path;
 
-                continue; /* next line */
+            path = strrchr(tags->targetpath,'\\');
+            if (!path) {
+                path = strrchr(tags->targetpath,'/');
             }
-
-            /* find possible filename and section start/end
-             * (.m3u seem to allow filenames with whitespaces before, make sure to trim) */
-            ok = sscanf(line, " %n%[^\r\n]%n ", &n1, currentname, &n2);
-            if (ok == 1)  {
-                int currentname_len = n2 - n1;
-                int filename_found = 0;
-
-                /* we want to find file with the same name (case insensitive), OR a virtual .txtp with
-                 * the filename inside (so 'file.adx' gets tags from 'file.adx#i.txtp', reading
-                 * tags even if we don't open !tags.m3u with virtual .txtp directly) */
-
-                /* strcasecmp works ok even for UTF-8 */
-                if (currentname_len >= tags->targetname_len && /* starts with targetname */
-                        strncasecmp(currentname, tags->targetname, tags->targetname_len) == 0) {
-
-                    if (currentname_len == tags->targetname_len) { /* exact match */
-                        filename_found = 1;
-                    }
-                    else if (vgmstream_is_virtual_filename(currentname)) { /* ends with .txth */
-                        char c = currentname[tags->targetname_len];
-                        /* tell apart the unlikely case of having both 'bgm01.ad.txtp' and 'bgm01.adp.txtp' */
-                        filename_found = (c==' ' || c == '.' || c == '#');
-                    }
-                }
-
-                if (filename_found) {
-                    /* section ok, start would be set before this (or be 0) */
-                    tags->section_end = tags->offset;
-                    tags->section_found = 1;
-                    tags->offset = tags->section_start;
-                }
-                else {
-                    /* mark new possible section */
-                    tags->section_start = tags->offset;
-                }
-
-                tags->track_count++; /* new track found (target filename or not) */
-                continue;
+            if (!path) {
+                path = tags->targetpath;
             }
 
-            /* empty/bad line, probably */
+            sprintf(tags->key, "%s", "ALBUM");
+            snprintf(tags->val, sizeof(tags->val), "%s", path+1);
+            return 1;
         }
     }
 
-    /* may reach here if read up to file_size but no section was found */
-
 fail:
     tags->key[0] = '\0';
     tags->val[0] = '\0';
@@ -291,12 +1476,15 @@ fail:
 
 
 void vgmstream_tags_reset(VGMSTREAM_TAGS* tags, const char* target_filename) {
+    tags_file_t* file;
     char *path;
 
     if (!tags)
         return;
 
+    file = tags->file; /* kept in case the next tag file is the same */
     memset(tags, 0, sizeof(VGMSTREAM_TAGS));
+    tags->file = file;
 
     //todo validate sizes and copy sensible max
 
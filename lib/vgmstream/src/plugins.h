@@ -5,6 +5,7 @@
 #define _PLUGINS_H_
 
 #include "streamfile.h"
+#include "vgmstream.h"
 
 /* ****************************************** */
 /* CONTEXT: simplifies plugin code            */
@@ -21,45 +22,129 @@ typedef struct {
 /* returns if vgmstream can parse file by extension */
 int vgmstream_ctx_is_valid(const char* filename, vgmstream_ctx_valid_cfg *cfg);
 
-#if 0
 
-/* opaque player state */
-typedef struct VGMSTREAM_CTX VGMSTREAM_CTX;
+
+/* ****************************************** */
+/* SUBSONGS: lists info of every subsong      */
+/* ****************************************** */
+
+typedef struct {
+    int32_t num_samples;        /* 0 if subsong couldn't be opened */
+    int sample_rate;
+    int channels;
+    int loop_flag;
+    int32_t loop_start_sample;
+    int32_t loop_end_sample;
+    char stream_name[STREAM_NAME_SIZE];
+} vgmstream_subsong_info;
+
+/* Opens every subsong of a file as metadata-only and returns an array of their info
+ * (free with vgmstream_free()), setting *subsong_count. Files without subsongs return a single entry.
+ * Meant to be done once per file and cached by the plugin, as banks may be slow to parse. */
+vgmstream_subsong_info* vgmstream_get_subsongs_info(STREAMFILE* sf, int* subsong_count);
+
+
+/* ****************************************** */
+/* SCAN: lists playable files and subsongs    */
+/* ****************************************** */
+
+typedef struct {
+    vgmstream_ctx_valid_cfg valid_cfg;  /* files rejected by extension aren't opened */
+    int recursive;              /* scan subfolders too (vgmstream_scan_path) */
+
+    /* opens a file to scan (NULL uses open_stdio_streamfile), must be callable from any thread */
+    STREAMFILE* (*open)(const char* filename, void* open_data);
+    void* open_data;
+
+    /* runs job(job_data, N) for N in 0..count-1 from any threads and returns once all are done,
+     * like vgmstream_channel_workers_setup's runner (NULL scans files one by one) */
+    void (*run)(void (*job)(void*, int), void* job_data, int count, void* run_data);
+    void* run_data;
+} vgmstream_scan_cfg;
+
+typedef struct {
+    const char* filename;       /* owned by the result */
+    int subsong;                /* 1..N, or 0 if the format has no subsongs */
+    int total_subsongs;         /* 0 if the format has no subsongs */
+    char format[128];           /* meta description */
+    vgmstream_subsong_info info;
+} vgmstream_scan_entry;
 
 typedef struct {
-    //...
-} VGMSTREAM_CTX_INFO;
+    vgmstream_scan_entry* entries;  /* in file order, then subsong order */
+    int entry_count;
+    int file_count;             /* files that had any playable entry */
+    char** filenames;
+} vgmstream_scan_result;
+
+/* Opens every file (after a fast reject by extension) with metadata-only inits and lists an entry per
+ * playable subsong, with files scanned in parallel if cfg has a runner. Global caches enabled by the
+ * host must have lock callbacks then. Returns 0 on error; free the result with vgmstream_scan_free. */
+int vgmstream_scan_files(const char* const* filenames, int filename_count, const vgmstream_scan_cfg* cfg, vgmstream_scan_result* result);
 
-VGMSTREAM_CTX* vgmstream_ctx_init(...);
+/* Same as vgmstream_scan_files for all files in a folder of the local filesystem (hosts with their own
+ * VFS should list files themselves). Files are sorted by path. */
+int vgmstream_scan_path(const char* path, const vgmstream_scan_cfg* cfg, vgmstream_scan_result* result);
 
-VGMSTREAM_CTX* vgmstream_ctx_format_check(...);
-VGMSTREAM_CTX* vgmstream_ctx_set_format_whilelist(...);
-VGMSTREAM_CTX* vgmstream_ctx_set_format_blacklist(...);
+void vgmstream_scan_free(vgmstream_scan_result* result);
+
+
+/* ****************************************** */
+/* ANALYSIS: peak and loudness of a stream    */
+/* ****************************************** */
 
-VGMSTREAM_CTX* vgmstream_ctx_set_file(...);
+typedef struct {
+    double peak;                /* max absolute sample, 1.0 = full scale */
+    double loudness;            /* integrated loudness in LUFS (EBU R128), very low if silent */
+} vgmstream_analysis_info;
 
-VGMSTREAM_CTX* vgmstream_ctx_get_config(...);
+/* Decodes the whole stream once (num_samples, ignoring loops, mixing and fades) measuring its
+ * peak and loudness, to calculate ReplayGain-like volume. Resets the vgmstream before and after.
+ * Keeps no global state, so different vgmstreams may be analyzed in parallel. Returns 0 on error. */
+int vgmstream_analyze(VGMSTREAM* vgmstream, vgmstream_analysis_info* info);
 
-VGMSTREAM_CTX* vgmstream_ctx_set_config(...);
 
-VGMSTREAM_CTX* vgmstream_ctx_get_buffer(...);
+/* ****************************************** */
+/* PLAYER: renders and seeks for plugins      */
+/* ****************************************** */
 
-VGMSTREAM_CTX* vgmstream_ctx_get_info(...);
+typedef struct {
+    const vgmstream_cfg_t* play_cfg;    /* loop/fade policy applied on init (NULL if the host already did it) */
+    int approximate_seek;       /* seek with seek_vgmstream_approximate (scrubbing) */
+    int checkpoint_seconds;     /* save the decoder state every N seconds of the first pass, so seeks go
+                                 * back to the nearest one instead of decoding from the start (0 = none) */
+    size_t checkpoint_budget;   /* max memory used by checkpoints, thinned when reached (0 = no limit or memory budget's share) */
+    int32_t chunk_samples;      /* max samples per render (0 = picked per codec) */
+} vgmstream_player_cfg;
 
-VGMSTREAM_CTX* vgmstream_ctx_describe(...);
+/* opaque player state */
+typedef struct vgmstream_player vgmstream_player;
 
-VGMSTREAM_CTX* vgmstream_ctx_get_title(...);
+/* Wraps an opened vgmstream for playback: applies config, then renders split in chunks, stops at the
+ * end and seeks with checkpoints. The vgmstream still belongs to the host (and can be used to read info)
+ * but must only be rendered or seeked through the player. Hosts that enable mixing should do it after
+ * init, with vgmstream_player_get_chunk_samples as max sample count. */
+vgmstream_player* vgmstream_player_init(VGMSTREAM* vgmstream, const vgmstream_player_cfg* cfg);
 
-VGMSTREAM_CTX* vgmstream_ctx_get_tagfile(...);
+/* Samples per render that the player uses internally, a good size for host buffers. */
+int32_t vgmstream_player_get_chunk_samples(vgmstream_player* player);
 
-VGMSTREAM_CTX* vgmstream_ctx_play(...);
+/* Renders up to sample_count and returns samples done, less than asked once the end is reached
+ * (0 when done, never if looping forever). */
+int32_t vgmstream_player_render(vgmstream_player* player, sample_t* buffer, int32_t sample_count);
+int32_t vgmstream_player_render_float(vgmstream_player* player, float* buffer, int32_t sample_count);
 
-VGMSTREAM_CTX* vgmstream_ctx_seek(...);
+/* Moves to seek_sample (in output samples, clamped to the end), from the nearest checkpoint if any. */
+void vgmstream_player_seek(vgmstream_player* player, int32_t seek_sample);
 
-VGMSTREAM_CTX* vgmstream_ctx_close(...);
+/* Output samples rendered so far (or where it was seeked). */
+int32_t vgmstream_player_get_position(vgmstream_player* player);
 
-#endif
+/* Total output samples, or -1 if looping forever. */
+int32_t vgmstream_player_get_length(vgmstream_player* player);
 
+/* Frees the player and its checkpoints, but not the vgmstream. */
+void vgmstream_player_free(vgmstream_player* player);
 
 
 /* ****************************************** */
@@ -86,6 +171,12 @@ int vgmstream_tags_next_tag(VGMSTREAM_TAGS* tags, STREAMFILE* tagfile);
 /* Closes tag file */
 void vgmstream_tags_close(VGMSTREAM_TAGS* tags);
 
+/* Keep the last few tag files parsed (by name and size), so players that make a VGMSTREAM_TAGS per
+ * file of a folder don't read the tag file again for each (0 disables and forgets them, default).
+ * Same threading rules as vgmstream_pool_setup. Files edited without changing size may be seen
+ * unchanged until replaced by others. */
+void vgmstream_tags_cache_setup(int enabled, void (*lock)(void*), void (*unlock)(void*), void* lock_data);
+
 
 /* ****************************************** */
 /* MIXING: modifies vgmstream output          */
@@ -0,0 +1,300 @@
+#include <stdlib.h>
+#include <string.h>
+#include "pool.h"
+#include "vgmstream.h"
+
+/* Closed streams hand their shells, channel arrays and mixing/layout buffers here, and new
+ * opens take a block of similar size back instead of calling the allocator. Mainly useful
+ * for hosts that open and close many streams in a long-running process (skipping tracks, tag
+ * scanning), as failed meta detections also allocate and free a few of these per file. */
+
+#define POOL_MAX_BLOCKS 64
+#define POOL_HEADER_SIZE 0x10   /* keeps returned pointers aligned like malloc's */
+#define POOL_MAX_WASTE 2        /* reuse blocks up to this many times the wanted size */
+
+typedef struct {
+    size_t size; /* usable size after header */
+} pool_header;
+
+static struct {
+    int max_blocks;
+    void (*lock)(void*);
+    void (*unlock)(void*);
+    void* lock_data;
+
+    int count;
+    void* blocks[POOL_MAX_BLOCKS]; /* raw blocks (header included), newest last */
+} pool;
+
+
+static void pool_lock(void) {
+    if (pool.lock)
+        pool.lock(pool.lock_data);
+}
+
+static void pool_unlock(void) {
+    if (pool.unlock)
+        pool.unlock(pool.lock_data);
+}
+
+static size_t block_size(void* block) {
+    return ((pool_header*)block)->size;
+}
+
+/* takes the smallest pooled block that fits, or NULL */
+static void* pool_take(size_t size) {
+    void* block = NULL;
+    int i, best = -1;
+
+    if (!pool.max_blocks)
+        return NULL;
+
+    pool_lock();
+    for (i = 0; i < pool.count; i++) {
+        size_t current = block_size(pool.blocks[i]);
+        if (current < size || current > size * POOL_MAX_WASTE)
+            continue;
+        if (best < 0 || current < block_size(pool.blocks[best]))
+            best = i;
+        if (current == size)
+            break;
+    }
+
+    if (best >= 0) {
+        block = pool.blocks[best];
+        pool.count--;
+        pool.blocks[best] = pool.blocks[pool.count];
+    }
+    pool_unlock();
+
+    return block;
+}
+
+/* keeps a block for later, returns 0 if the pool is full or disabled */
+static int pool_keep(void* block) {
+    int kept = 0;
+
+    if (!pool.max_blocks)
+        return 0;
+
+    pool_lock();
+    if (pool.count < pool.max_blocks) {
+        pool.blocks[pool.count] = block;
+        pool.count++;
+        kept = 1;
+    }
+    pool_unlock();
+
+    return kept;
+}
+
+void* pool_calloc(size_t count, size_t size) {
+    size_t total = count * size;
+    void* block;
+
+    if (total == 0)
+        total = 1;
+
+    block = pool_take(total);
+    if (block) {
+        memset((uint8_t*)block + POOL_HEADER_SIZE, 0, block_size(block));
+    }
+    else {
+        block = calloc(1, POOL_HEADER_SIZE + total);
+        if (!block) return NULL;
+        ((pool_header*)block)->size = total;
+    }
+
+    return (uint8_t*)block + POOL_HEADER_SIZE;
+}
+
+void* pool_realloc(void* ptr, size_t size) {
+    void* new_ptr;
+    size_t old_size;
+
+    if (!ptr)
+        return pool_calloc(1, size);
+
+    old_size = block_size((uint8_t*)ptr - POOL_HEADER_SIZE);
+    if (old_size >= size)
+        return ptr;
+
+    new_ptr = pool_calloc(1, size);
+    if (!new_ptr) return NULL;
+
+    memcpy(new_ptr, ptr, old_size);
+    pool_free(ptr);
+    return new_ptr;
+}
+
+size_t pool_get_size(void) {
+    size_t size = 0;
+    int i;
+
+    pool_lock();
+    for (i = 0; i < pool.count; i++) {
+        size += POOL_HEADER_SIZE + block_size(pool.blocks[i]);
+    }
+    pool_unlock();
+
+    return size;
+}
+
+void pool_free(void* ptr) {
+    void* block;
+
+    if (!ptr)
+        return;
+
+    block = (uint8_t*)ptr - POOL_HEADER_SIZE;
+    if (!pool_keep(block))
+        free(block);
+}
+
+
+/* ************************************************************ */
+
+#define ARENA_ALIGN 0x10            /* same as malloc's for any type */
+#define ARENA_ALLOC_HEADER 0x10     /* before each allocation, to grow them */
+#define ARENA_MIN_CHUNK 0x1000
+
+#define ARENA_ALIGN_SIZE(size) (((size) + (ARENA_ALIGN - 1)) & ~(size_t)(ARENA_ALIGN - 1))
+#define ARENA_CHUNK_HEADER ARENA_ALIGN_SIZE(sizeof(arena_chunk))
+
+typedef struct arena_chunk {
+    struct arena_chunk* next;   /* older chunks */
+    size_t size;                /* usable size after header */
+    size_t used;
+} arena_chunk;
+
+struct pool_arena {
+    arena_chunk* chunks;        /* newest first, the arena is in the last one */
+    size_t chunk_size;
+};
+
+static arena_chunk* arena_new_chunk(size_t size) {
+    arena_chunk* chunk = pool_calloc(1, ARENA_CHUNK_HEADER + size);
+    if (!chunk) return NULL;
+
+    chunk->size = size;
+    return chunk;
+}
+
+/* bytes in a chunk's data (pooled blocks are zeroed and space is never reused, so it's 0'ed) */
+static uint8_t* arena_take(arena_chunk* chunk, size_t size) {
+    uint8_t* ptr = (uint8_t*)chunk + ARENA_CHUNK_HEADER + chunk->used;
+    chunk->used += size;
+    return ptr;
+}
+
+pool_arena* pool_arena_new(size_t chunk_size) {
+    arena_chunk* chunk;
+    pool_arena* arena;
+
+    if (chunk_size < ARENA_MIN_CHUNK)
+        chunk_size = ARENA_MIN_CHUNK;
+    chunk_size = ARENA_ALIGN_SIZE(chunk_size);
+
+    chunk = arena_new_chunk(ARENA_ALIGN_SIZE(sizeof(pool_arena)) + chunk_size);
+    if (!chunk) return NULL;
+
+    arena = (pool_arena*)arena_take(chunk, ARENA_ALIGN_SIZE(sizeof(pool_arena)));
+    arena->chunks = chunk;
+    arena->chunk_size = chunk_size;
+    return arena;
+}
+
+void* pool_arena_calloc(pool_arena* arena, size_t count, size_t size) {
+    arena_chunk* chunk;
+    size_t total, needed;
+    uint8_t* ptr;
+
+    if (!arena)
+        return NULL;
+    if (size && count > ((size_t)-1 - ARENA_ALLOC_HEADER - ARENA_ALIGN) / size)
+        return NULL;
+
+    total = count * size;
+    needed = ARENA_ALLOC_HEADER + ARENA_ALIGN_SIZE(total);
+
+    chunk = arena->chunks;
+    if (chunk->size - chunk->used < needed) {
+        chunk = arena_new_chunk(needed > arena->chunk_size ? needed : arena->chunk_size);
+        if (!chunk) return NULL;
+
+        chunk->next = arena->chunks;
+        arena->chunks = chunk;
+    }
+
+    ptr = arena_take(chunk, needed);
+    *(size_t*)ptr = total;
+    return ptr + ARENA_ALLOC_HEADER;
+}
+
+void* pool_arena_realloc(pool_arena* arena, void* ptr, size_t size) {
+    arena_chunk* chunk;
+    uint8_t* header;
+    size_t old_size;
+    void* new_ptr;
+
+    if (!ptr)
+        return pool_arena_calloc(arena, 1, size);
+
+    header = (uint8_t*)ptr - ARENA_ALLOC_HEADER;
+    old_size = *(size_t*)header;
+    if (old_size >= size)
+        return ptr;
+
+    /* last allocation of the current chunk can grow in place */
+    chunk = arena->chunks;
+    if (header + ARENA_ALLOC_HEADER + ARENA_ALIGN_SIZE(old_size) == (uint8_t*)chunk + ARENA_CHUNK_HEADER + chunk->used &&
+            chunk->size - chunk->used >= ARENA_ALIGN_SIZE(size) - ARENA_ALIGN_SIZE(old_size)) {
+        chunk->used += ARENA_ALIGN_SIZE(size) - ARENA_ALIGN_SIZE(old_size);
+        *(size_t*)header = size;
+        return ptr;
+    }
+
+    new_ptr = pool_arena_calloc(arena, 1, size);
+    if (!new_ptr) return NULL;
+
+    memcpy(new_ptr, ptr, old_size);
+    return new_ptr;
+}
+
+void pool_arena_free(pool_arena* arena) {
+    arena_chunk* chunk;
+
+    if (!arena)
+        return;
+
+    /* the arena goes with its (last) chunk */
+    chunk = arena->chunks;
+    while (chunk) {
+        arena_chunk* next = chunk->next;
+        pool_free(chunk);
+        chunk = next;
+    }
+}
+
+void vgmstream_pool_setup(int max_blocks, void (*lock)(void*), void (*unlock)(void*), void* lock_data) {
+    int i;
+
+    if (max_blocks < 0)
+        max_blocks = 0;
+    if (max_blocks > POOL_MAX_BLOCKS)
+        max_blocks = POOL_MAX_BLOCKS;
+
+    /* callers set this once before/after using vgmstream, but lock anyway with the old callbacks */
+    pool_lock();
+    for (i = max_blocks; i < pool.count; i++) {
+        free(pool.blocks[i]);
+    }
+    if (pool.count > max_blocks)
+        pool.count = max_blocks;
+    pool.max_blocks = max_blocks;
+    pool_unlock();
+
+    pool.lock = lock;
+    pool.unlock = unlock;
+    pool.lock_data = lock_data;
+}
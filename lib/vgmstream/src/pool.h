@@ -0,0 +1,33 @@
+/*
+ * pool.h - recycling of common vgmstream allocations
+ */
+#ifndef _POOL_H
+#define _POOL_H
+
+#include "streamtypes.h"
+
+/* Memory from these must only be released with pool_free (blocks carry a small header).
+ * When the pool is disabled (default) they work like calloc/realloc/free. */
+void* pool_calloc(size_t count, size_t size);
+void* pool_realloc(void* ptr, size_t size);
+void pool_free(void* ptr);
+
+/* Memory kept by the pool for reuse. */
+size_t pool_get_size(void);
+
+/* Per-object arena, for objects made of several allocations that live and die together (a VGMSTREAM
+ * with its channels and mixing, layout data with its buffers). Allocations are carved from a few
+ * chunks (taken from the pool above) and are only released all at once with pool_arena_free, so
+ * closing doesn't leave a trail of small holes in the heap of long-running hosts. */
+typedef struct pool_arena pool_arena;
+
+/* New arena whose chunks hold at least chunk_size bytes (the arena itself lives in the first one). */
+pool_arena* pool_arena_new(size_t chunk_size);
+/* Zeroed memory valid until the arena is freed. */
+void* pool_arena_calloc(pool_arena* arena, size_t count, size_t size);
+/* Grows ptr (NULL or from this arena) keeping its contents. The old space is reclaimed with the arena. */
+void* pool_arena_realloc(pool_arena* arena, void* ptr, size_t size);
+/* Releases all memory of the arena (including the arena). */
+void pool_arena_free(pool_arena* arena);
+
+#endif /* _POOL_H */
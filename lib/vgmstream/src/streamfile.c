@@ -1,34 +1,337 @@
 #ifndef _MSC_VER
 #include <unistd.h>
 #endif
+#include <sys/stat.h>
+#include <time.h>
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#endif
 #include "streamfile.h"
 #include "util.h"
 #include "vgmstream.h"
+#include "page_cache.h"
+
+
+/* wall clock for I/O stats (MSVC's clock() is wall time, elsewhere it's CPU time) */
+uint64_t get_streamfile_time_us(void) {
+#ifdef _WIN32
+    return (uint64_t)clock() * 1000000 / CLOCKS_PER_SEC;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
+}
+
+static inline void stats_read(streamfile_stats_t *stats, size_t length) {
+    stats->read_calls++;
+    stats->bytes_requested += length;
+}
+
+/* wrappers: own calls/requested bytes, the rest from the streamfile they read */
+static void get_stats_wrapper(STREAMFILE *inner_sf, const streamfile_stats_t *own, streamfile_stats_t *stats) {
+    get_streamfile_stats(inner_sf, stats);
+    stats->read_calls = own->read_calls;
+    stats->bytes_requested = own->bytes_requested;
+}
+
+void get_streamfile_stats(STREAMFILE *sf, streamfile_stats_t *stats) {
+    memset(stats, 0, sizeof(streamfile_stats_t));
+    if (sf && sf->get_stats)
+        sf->get_stats(sf, stats);
+}
 
+void release_streamfile_buffer(STREAMFILE *sf) {
+    if (sf && sf->release)
+        sf->release(sf);
+}
+
+const char* get_streamfile_name_ref(STREAMFILE *sf) {
+    if (!sf || !sf->get_name_ref)
+        return NULL;
+    return sf->get_name_ref(sf);
+}
+
+void prefetch_streamfile(STREAMFILE *sf, off_t offset, size_t length) {
+    if (sf && sf->prefetch && offset >= 0 && length > 0)
+        sf->prefetch(sf, offset, length);
+}
 
-/* a STREAMFILE that operates via standard IO using a buffer */
+
+/* Reference counted file name, shared by a streamfile and its same-name reopens (one per channel)
+ * rather than a PATH_LIMIT buffer each. Like shared mappings, a streamfile and its reopens are
+ * handled by one thread at a time, so counts aren't locked. */
+typedef struct {
+    int refs;
+    size_t length;
+    char name[1]; /* length + 1 */
+} sf_name;
+
+static sf_name* sf_name_new(const char *name) {
+    size_t length = strlen(name);
+    sf_name *new_name;
+
+    if (length > PATH_LIMIT - 1)
+        length = PATH_LIMIT - 1; /* same as old fixed buffers */
+
+    new_name = malloc(sizeof(sf_name) + length);
+    if (!new_name) return NULL;
+
+    new_name->refs = 1;
+    new_name->length = length;
+    memcpy(new_name->name, name, length);
+    new_name->name[length] = '\0';
+    return new_name;
+}
+
+static sf_name* sf_name_ref(sf_name *name) {
+    name->refs++;
+    return name;
+}
+
+static void sf_name_unref(sf_name *name) {
+    if (!name)
+        return;
+    name->refs--;
+    if (name->refs == 0)
+        free(name);
+}
+
+static int sf_name_equals(const sf_name *name, const char *other) {
+    return strncmp(name->name, other, name->length) == 0 && other[name->length] == '\0';
+}
+
+/* get_name, copying only the name rather than padding the whole buffer */
+static void sf_name_copy(const sf_name *name, char *buffer, size_t length) {
+    size_t copy = name->length;
+
+    if (length == 0)
+        return;
+    if (copy > length - 1)
+        copy = length - 1;
+    memcpy(buffer, name->name, copy);
+    buffer[copy] = '\0';
+}
+
+
+/* Buffered streamfiles take their buffer on the first refill and give it back when closed or
+ * released while idle, so per-channel reopens that aren't being read (other segments, channels
+ * sharing one reader) don't hold 0x8000 bytes each. Given back buffers are kept here for reuse
+ * by later refills and opens, up to max_size bytes. */
+#define BUFFER_POOL_MAX_FREE 64
+
+static struct {
+    size_t max_size;        /* free buffer bytes to keep (0 = disabled) */
+    void (*lock)(void*);
+    void (*unlock)(void*);
+    void* lock_data;
+
+    size_t free_size;
+    int free_count;
+    uint8_t* free_buffers[BUFFER_POOL_MAX_FREE]; /* newest last */
+    size_t free_sizes[BUFFER_POOL_MAX_FREE];
+
+    size_t held_size;       /* buffers of open streamfiles (counted even when disabled) */
+} buffer_pool;
+
+static void buffer_pool_lock(void) {
+    if (buffer_pool.lock)
+        buffer_pool.lock(buffer_pool.lock_data);
+}
+
+static void buffer_pool_unlock(void) {
+    if (buffer_pool.unlock)
+        buffer_pool.unlock(buffer_pool.lock_data);
+}
+
+void vgmstream_buffer_pool_setup(size_t max_size, void (*lock)(void*), void (*unlock)(void*), void* lock_data) {
+    /* locked with the old callbacks, like the other pools */
+    buffer_pool_lock();
+    while (buffer_pool.free_count > 0 && buffer_pool.free_size > max_size) {
+        buffer_pool.free_count--;
+        buffer_pool.free_size -= buffer_pool.free_sizes[buffer_pool.free_count];
+        free(buffer_pool.free_buffers[buffer_pool.free_count]);
+    }
+    buffer_pool.max_size = max_size;
+    buffer_pool_unlock();
+
+    buffer_pool.lock = lock;
+    buffer_pool.unlock = unlock;
+    buffer_pool.lock_data = lock_data;
+}
+
+void streamfile_get_buffer_usage(size_t *held, size_t *pooled) {
+    buffer_pool_lock();
+    *held = buffer_pool.held_size;
+    *pooled = buffer_pool.free_size;
+    buffer_pool_unlock();
+}
+
+/* a buffer of exactly size bytes (contents undefined), or NULL */
+static uint8_t* buffer_pool_take(size_t size) {
+    uint8_t* buffer = NULL;
+    int i;
+
+    buffer_pool_lock();
+    if (buffer_pool.max_size) {
+        for (i = buffer_pool.free_count - 1; i >= 0; i--) {
+            if (buffer_pool.free_sizes[i] != size)
+                continue;
+            buffer = buffer_pool.free_buffers[i];
+            buffer_pool.free_count--;
+            buffer_pool.free_size -= size;
+            buffer_pool.free_buffers[i] = buffer_pool.free_buffers[buffer_pool.free_count];
+            buffer_pool.free_sizes[i] = buffer_pool.free_sizes[buffer_pool.free_count];
+            break;
+        }
+    }
+    buffer_pool.held_size += size; /* undone below if malloc fails */
+    buffer_pool_unlock();
+
+    if (!buffer) {
+        buffer = malloc(size);
+        if (!buffer) {
+            buffer_pool_lock();
+            buffer_pool.held_size -= size;
+            buffer_pool_unlock();
+        }
+    }
+    return buffer;
+}
+
+static void buffer_pool_give(uint8_t* buffer, size_t size) {
+    int kept = 0;
+
+    if (!buffer)
+        return;
+
+    buffer_pool_lock();
+    buffer_pool.held_size -= size;
+    if (buffer_pool.max_size && buffer_pool.free_count < BUFFER_POOL_MAX_FREE && buffer_pool.free_size + size <= buffer_pool.max_size) {
+        buffer_pool.free_buffers[buffer_pool.free_count] = buffer;
+        buffer_pool.free_sizes[buffer_pool.free_count] = size;
+        buffer_pool.free_count++;
+        buffer_pool.free_size += size;
+        kept = 1;
+    }
+    buffer_pool_unlock();
+
+    if (!kept)
+        free(buffer);
+}
+
+/* takes the buffer of a streamfile before a refill if it has none, updating its stats */
+static int buffer_pool_borrow(uint8_t **buffer, size_t size, streamfile_stats_t *stats) {
+    if (*buffer)
+        return 1;
+
+    *buffer = buffer_pool_take(size);
+    if (!*buffer)
+        return 0;
+
+    stats->buffer_size = size;
+    if (stats->buffer_peak < size)
+        stats->buffer_peak = size;
+    return 1;
+}
+
+static void buffer_pool_return(uint8_t **buffer, size_t size, streamfile_stats_t *stats) {
+    buffer_pool_give(*buffer, size);
+    *buffer = NULL;
+    stats->buffer_size = 0;
+}
+
+
+/* a STREAMFILE that operates via standard IO (or a host's file callbacks) using a buffer */
 typedef struct {
     STREAMFILE sf;          /* callbacks */
 
     FILE * infile;          /* actual FILE */
-    char name[PATH_LIMIT];  /* FILE filename */
+    const host_streamfile_io_t * io; /* host callbacks instead of FILE (optional) */
+    void * handle;          /* host file */
+    off_t file_offset;      /* host file position, to seek only when reads jump */
+    sf_name * name;         /* FILE filename (shared with reopens) */
     off_t offset;           /* last read offset (info) */
     off_t buffer_offset;    /* current buffer data start */
-    uint8_t * buffer;       /* data buffer */
+    uint8_t * buffer;       /* data buffer (NULL until the first refill or when released) */
     size_t buffersize;      /* max buffer size */
     size_t validsize;       /* current buffer size */
     size_t filesize;        /* buffered file size */
+    page_cache_file * pages; /* shared pages of this file (optional) */
+    streamfile_stats_t stats;
 } STDIO_STREAMFILE;
 
 static STREAMFILE* open_stdio_streamfile_buffer(const char * const filename, size_t buffersize);
-static STREAMFILE* open_stdio_streamfile_buffer_by_file(FILE *infile, const char * const filename, size_t buffersize);
+static STREAMFILE* open_stdio_streamfile_buffer_by_file(FILE *infile, const char * const filename, sf_name *shared_name, size_t buffersize);
+static STREAMFILE* open_host_streamfile_buffer(void *handle, const host_streamfile_io_t *io, const char * const filename, sf_name *shared_name, size_t buffersize);
+
+static size_t read_stdio_file(STDIO_STREAMFILE *streamfile, uint8_t *dst, off_t offset, size_t length) {
+    uint64_t time_start = get_streamfile_time_us();
+    size_t bytes_read;
+
+    if (streamfile->io) {
+        if (streamfile->file_offset != offset && streamfile->io->seek(streamfile->handle, offset) != 0) {
+            streamfile->file_offset = -1;
+            return 0;
+        }
+        bytes_read = streamfile->io->read(streamfile->handle, dst, length);
+        streamfile->file_offset = offset + bytes_read;
+        streamfile->stats.bytes_read += bytes_read;
+        streamfile->stats.read_time_us += get_streamfile_time_us() - time_start;
+        return bytes_read;
+    }
+
+#ifndef _WIN32
+    /* positional reads are a single syscall, don't go through stdio's own buffer and don't
+     * move the file position (shared between dup'd reopens of the same file) */
+    {
+        int fd = fileno(streamfile->infile);
+
+        bytes_read = 0;
+        while (bytes_read < length) {
+            ssize_t bytes = pread(fd, dst + bytes_read, length - bytes_read, offset + bytes_read);
+            if (bytes < 0 && errno == EINTR)
+                continue;
+            if (bytes <= 0)
+                break;
+            bytes_read += bytes;
+        }
+    }
+#else
+    /* position to new offset */
+    if (fseeko(streamfile->infile,offset,SEEK_SET)) {
+        return 0; /* this shouldn't happen in our code */
+    }
+
+#ifdef _MSC_VER
+    /* Workaround a bug that appears when compiling with MSVC (later versions).
+     * This bug is deterministic and seemingly appears randomly after seeking.
+     * It results in fread returning data from the wrong area of the file.
+     * HPS is one format that is almost always affected by this.
+     * May be related/same as open_stdio's bug when using dup() */
+    fseek(streamfile->infile, ftell(streamfile->infile), SEEK_SET);
+#endif
+
+    bytes_read = fread(dst, sizeof(uint8_t), length, streamfile->infile);
+#endif
+    streamfile->stats.bytes_read += bytes_read;
+    streamfile->stats.read_time_us += get_streamfile_time_us() - time_start;
+    return bytes_read;
+}
+
+static int has_file_stdio(STDIO_STREAMFILE *streamfile) {
+    return streamfile->infile || streamfile->handle;
+}
 
 static size_t read_stdio(STDIO_STREAMFILE *streamfile, uint8_t *dst, off_t offset, size_t length) {
     size_t length_read_total = 0;
 
-    if (!streamfile->infile || !dst || length <= 0 || offset < 0)
+    if (!has_file_stdio(streamfile) || !dst || length <= 0 || offset < 0)
         return 0;
 
+    stats_read(&streamfile->stats, length);
     //;VGM_LOG("STDIO: read %lx + %x (buf %lx + %x)\n", offset, length, streamfile->buffer_offset, streamfile->validsize);
 
     /* is the part of the requested length in the buffer? */
@@ -49,17 +352,22 @@ static size_t read_stdio(STDIO_STREAMFILE *streamfile, uint8_t *dst, off_t offse
         dst += length_to_read;
     }
 
+    if (length == 0)
+        streamfile->stats.buffer_hits++;
+    else if (offset < streamfile->buffer_offset)
+        streamfile->stats.rebuffers_back++;
+
 #ifdef VGM_DEBUG_OUTPUT
     if (offset < streamfile->buffer_offset && length > 0) {
         VGM_LOG("STDIO: rebuffer, requested %lx vs %lx (sf %x)\n", offset, streamfile->buffer_offset, (uint32_t)streamfile);
-        //streamfile->rebuffer++;
-        //if (rebuffer > N) ...
     }
 #endif
 
     /* read the rest of the requested length */
     while (length > 0) {
         size_t length_to_read;
+        off_t offset_into_buffer;
+        int sequential;
 
         /* ignore requests at EOF */
         if (offset >= streamfile->filesize) {
@@ -68,41 +376,41 @@ static size_t read_stdio(STDIO_STREAMFILE *streamfile, uint8_t *dst, off_t offse
             break;
         }
 
-        /* position to new offset */
-        if (fseeko(streamfile->infile,offset,SEEK_SET)) {
-            break; /* this shouldn't happen in our code */
-        }
-
-#ifdef _MSC_VER
-        /* Workaround a bug that appears when compiling with MSVC (later versions).
-         * This bug is deterministic and seemingly appears randomly after seeking.
-         * It results in fread returning data from the wrong area of the file.
-         * HPS is one format that is almost always affected by this.
-         * May be related/same as open_stdio's bug when using dup() */
-        fseek(streamfile->infile, ftell(streamfile->infile), SEEK_SET);
-#endif
+        if (!buffer_pool_borrow(&streamfile->buffer, streamfile->buffersize, &streamfile->stats))
+            break;
 
-        /* fill the buffer (offset now is beyond buffer_offset) */
+        /* fill the buffer (offset now is beyond buffer_offset), from a page boundary if
+         * pages are shared so other reopens can use them */
+        sequential = streamfile->validsize > 0 && offset == streamfile->buffer_offset + streamfile->validsize;
         streamfile->buffer_offset = offset;
-        streamfile->validsize = fread(streamfile->buffer, sizeof(uint8_t), streamfile->buffersize, streamfile->infile);
+        if (streamfile->pages && streamfile->buffersize >= PAGE_CACHE_PAGE_SIZE * 2)
+            streamfile->buffer_offset -= offset % PAGE_CACHE_PAGE_SIZE;
+        streamfile->validsize = page_cache_fill(streamfile->pages, streamfile->buffer, streamfile->buffer_offset, streamfile->buffersize, (page_cache_read_t)read_stdio_file, streamfile);
+        streamfile->stats.buffer_misses++;
         //;VGM_LOG("STDIO: read buf %lx + %x\n", streamfile->buffer_offset, streamfile->validsize);
 
+        /* hosts with background loading can get the next buffer ready while this one is used */
+        if (sequential && streamfile->io && streamfile->io->prefetch && streamfile->validsize == streamfile->buffersize)
+            streamfile->io->prefetch(streamfile->handle, streamfile->buffer_offset + streamfile->validsize, streamfile->buffersize);
+
         /* decide how much must be read this time */
-        if (length > streamfile->buffersize)
-            length_to_read = streamfile->buffersize;
-        else
+        offset_into_buffer = offset - streamfile->buffer_offset;
+        length_to_read = streamfile->buffersize - offset_into_buffer;
+        if (length_to_read > length)
             length_to_read = length;
 
         /* give up on partial reads (EOF) */
-        if (streamfile->validsize < length_to_read) {
-            memcpy(dst, streamfile->buffer, streamfile->validsize);
-            offset += streamfile->validsize;
-            length_read_total += streamfile->validsize;
+        if (streamfile->validsize < offset_into_buffer + length_to_read) {
+            if (streamfile->validsize > offset_into_buffer) {
+                memcpy(dst, streamfile->buffer + offset_into_buffer, streamfile->validsize - offset_into_buffer);
+                length_read_total += streamfile->validsize - offset_into_buffer;
+                offset = streamfile->buffer_offset + streamfile->validsize;
+            }
             break;
         }
 
         /* use the new buffer */
-        memcpy(dst, streamfile->buffer, length_to_read);
+        memcpy(dst, streamfile->buffer + offset_into_buffer, length_to_read);
         offset += length_to_read;
         length_read_total += length_to_read;
         length -= length_to_read;
@@ -112,6 +420,27 @@ static size_t read_stdio(STDIO_STREAMFILE *streamfile, uint8_t *dst, off_t offse
     streamfile->offset = offset; /* last fread offset */
     return length_read_total;
 }
+static const uint8_t* read_ptr_stdio(STDIO_STREAMFILE *streamfile, off_t offset, size_t length) {
+    if (!has_file_stdio(streamfile) || offset < 0 || length > streamfile->buffersize || offset + length > streamfile->filesize)
+        return NULL;
+
+    /* refill the buffer from offset if the range isn't fully inside */
+    if (offset < streamfile->buffer_offset || offset + length > streamfile->buffer_offset + streamfile->validsize) {
+        uint8_t byte;
+        streamfile->validsize = 0;
+        streamfile->stats.bytes_requested += length - 1;
+        read_stdio(streamfile, &byte, offset, 1);
+        if (offset < streamfile->buffer_offset || offset + length > streamfile->buffer_offset + streamfile->validsize)
+            return NULL; /* EOF */
+    }
+    else {
+        stats_read(&streamfile->stats, length);
+        streamfile->stats.buffer_hits++;
+    }
+
+    streamfile->offset = offset + length;
+    return streamfile->buffer + (offset - streamfile->buffer_offset);
+}
 static size_t get_size_stdio(STDIO_STREAMFILE *streamfile) {
     return streamfile->filesize;
 }
@@ -119,13 +448,38 @@ static off_t get_offset_stdio(STDIO_STREAMFILE *streamfile) {
     return streamfile->offset;
 }
 static void get_name_stdio(STDIO_STREAMFILE *streamfile, char *buffer, size_t length) {
-    strncpy(buffer, streamfile->name, length);
-    buffer[length-1]='\0';
+    sf_name_copy(streamfile->name, buffer, length);
+}
+static const char* get_name_ref_stdio(STDIO_STREAMFILE *streamfile) {
+    return streamfile->name->name;
+}
+static void get_stats_stdio(STDIO_STREAMFILE *streamfile, streamfile_stats_t *stats) {
+    *stats = streamfile->stats;
+}
+static void prefetch_stdio(STDIO_STREAMFILE *streamfile, off_t offset, size_t length) {
+    if (streamfile->io) {
+        if (streamfile->handle && streamfile->io->prefetch)
+            streamfile->io->prefetch(streamfile->handle, offset, length);
+        return;
+    }
+#ifdef POSIX_FADV_WILLNEED
+    /* the OS starts reading it into its page cache */
+    if (streamfile->infile)
+        posix_fadvise(fileno(streamfile->infile), offset, length, POSIX_FADV_WILLNEED);
+#endif
+}
+static void release_stdio(STDIO_STREAMFILE *streamfile) {
+    buffer_pool_return(&streamfile->buffer, streamfile->buffersize, &streamfile->stats);
+    streamfile->validsize = 0;
 }
 static void close_stdio(STDIO_STREAMFILE *streamfile) {
+    page_cache_close(streamfile->pages);
     if (streamfile->infile)
         fclose(streamfile->infile);
-    free(streamfile->buffer);
+    if (streamfile->handle)
+        streamfile->io->close(streamfile->handle);
+    buffer_pool_return(&streamfile->buffer, streamfile->buffersize, &streamfile->stats);
+    sf_name_unref(streamfile->name);
     free(streamfile);
 }
 
@@ -133,6 +487,20 @@ static STREAMFILE* open_stdio(STDIO_STREAMFILE *streamfile, const char * const f
     if (!filename)
         return NULL;
 
+    /* hosts give a new handle with its own position (or NULL), same names share the name */
+    if (streamfile->io) {
+        void *handle = streamfile->io->open(streamfile->handle, filename);
+        sf_name *shared_name = sf_name_equals(streamfile->name, filename) ? streamfile->name : NULL;
+        STREAMFILE *new_sf;
+
+        if (!handle && !vgmstream_is_virtual_filename(filename))
+            return NULL;
+        new_sf = open_host_streamfile_buffer(handle, streamfile->io, filename, shared_name, buffersize);
+        if (!new_sf && handle)
+            streamfile->io->close(handle);
+        return new_sf;
+    }
+
 #if !defined (__ANDROID__) && !defined (_MSC_VER)
     /* when enabling this for MSVC it'll seemingly work, but there are issues possibly related to underlying
      * IO buffers when using dup(), noticeable by re-opening the same streamfile with small buffer sizes
@@ -140,12 +508,12 @@ static STREAMFILE* open_stdio(STDIO_STREAMFILE *streamfile, const char * const f
      * this reportedly this causes issues in Android too */
 
     /* if same name, duplicate the file descriptor we already have open */
-    if (streamfile->infile && !strcmp(streamfile->name,filename)) {
+    if (streamfile->infile && sf_name_equals(streamfile->name, filename)) {
         int new_fd;
         FILE *new_file = NULL;
 
         if (((new_fd = dup(fileno(streamfile->infile))) >= 0) && (new_file = fdopen(new_fd, "rb")))  {
-            STREAMFILE *new_sf = open_stdio_streamfile_buffer_by_file(new_file, filename, buffersize);
+            STREAMFILE *new_sf = open_stdio_streamfile_buffer_by_file(new_file, filename, streamfile->name, buffersize);
             if (new_sf)
                 return new_sf;
             fclose(new_file);
@@ -160,13 +528,10 @@ static STREAMFILE* open_stdio(STDIO_STREAMFILE *streamfile, const char * const f
     return open_stdio_streamfile_buffer(filename, buffersize);
 }
 
-static STREAMFILE* open_stdio_streamfile_buffer_by_file(FILE *infile, const char * const filename, size_t buffersize) {
-    uint8_t *buffer = NULL;
+/* shared_name (optional) is the same filename from a reopened streamfile */
+static STREAMFILE* open_stdio_streamfile_buffer_by_file(FILE *infile, const char * const filename, sf_name *shared_name, size_t buffersize) {
     STDIO_STREAMFILE *streamfile = NULL;
 
-    buffer = calloc(buffersize,1);
-    if (!buffer) goto fail;
-
     streamfile = calloc(1,sizeof(STDIO_STREAMFILE));
     if (!streamfile) goto fail;
 
@@ -176,13 +541,17 @@ static STREAMFILE* open_stdio_streamfile_buffer_by_file(FILE *infile, const char
     streamfile->sf.get_name = (void*)get_name_stdio;
     streamfile->sf.open = (void*)open_stdio;
     streamfile->sf.close = (void*)close_stdio;
+    streamfile->sf.read_ptr = (void*)read_ptr_stdio;
+    streamfile->sf.get_stats = (void*)get_stats_stdio;
+    streamfile->sf.release = (void*)release_stdio;
+    streamfile->sf.get_name_ref = (void*)get_name_ref_stdio;
+    streamfile->sf.prefetch = (void*)prefetch_stdio;
 
     streamfile->infile = infile;
     streamfile->buffersize = buffersize;
-    streamfile->buffer = buffer;
 
-    strncpy(streamfile->name, filename, sizeof(streamfile->name));
-    streamfile->name[sizeof(streamfile->name)-1] = '\0';
+    streamfile->name = shared_name ? sf_name_ref(shared_name) : sf_name_new(filename);
+    if (!streamfile->name) goto fail;
 
     /* cache filesize */
     if (infile) {
@@ -201,10 +570,18 @@ static STREAMFILE* open_stdio_streamfile_buffer_by_file(FILE *infile, const char
         goto fail; /* can be ignored but may result in strange/unexpected behaviors */
     }
 
+    if (infile) {
+        struct stat st;
+        uint64_t stamp = 0;
+        if (fstat(fileno(infile), &st) == 0)
+            stamp = (uint64_t)st.st_mtime;
+        streamfile->pages = page_cache_open(streamfile->name->name, streamfile->filesize, stamp);
+    }
+
     return &streamfile->sf;
 
 fail:
-    free(buffer);
+    if (streamfile) sf_name_unref(streamfile->name);
     free(streamfile);
     return NULL;
 }
@@ -220,7 +597,7 @@ static STREAMFILE* open_stdio_streamfile_buffer(const char * const filename, siz
             return NULL;
     }
 
-    streamfile = open_stdio_streamfile_buffer_by_file(infile, filename, bufsize);
+    streamfile = open_stdio_streamfile_buffer_by_file(infile, filename, NULL, bufsize);
     if (!streamfile) {
         if (infile) fclose(infile);
     }
@@ -233,23 +610,567 @@ STREAMFILE* open_stdio_streamfile(const char *filename) {
 }
 
 STREAMFILE* open_stdio_streamfile_by_file(FILE *file, const char *filename) {
-    return open_stdio_streamfile_buffer_by_file(file, filename, STREAMFILE_DEFAULT_BUFFER_SIZE);
+    return open_stdio_streamfile_buffer_by_file(file, filename, NULL, STREAMFILE_DEFAULT_BUFFER_SIZE);
+}
+
+static STREAMFILE* open_host_streamfile_buffer(void *handle, const host_streamfile_io_t *io, const char * const filename, sf_name *shared_name, size_t buffersize) {
+    STDIO_STREAMFILE *streamfile;
+    STREAMFILE *sf;
+
+    sf = open_stdio_streamfile_buffer_by_file(NULL, filename, shared_name, buffersize);
+    if (!sf) return NULL;
+    streamfile = (STDIO_STREAMFILE*)sf;
+
+    streamfile->io = io;
+    streamfile->handle = handle;
+    if (handle) {
+        streamfile->filesize = io->get_size(handle);
+        streamfile->file_offset = -1;
+        streamfile->pages = page_cache_open(streamfile->name->name, streamfile->filesize, io->get_stamp ? io->get_stamp(handle) : 0);
+    }
+    if (!io->prefetch)
+        streamfile->sf.prefetch = NULL;
+
+    return sf;
+}
+
+STREAMFILE* open_host_streamfile(void *handle, const char *filename, const host_streamfile_io_t *io, size_t buffer_size) {
+    STREAMFILE *sf;
+
+    if (!io || !filename || (!handle && !vgmstream_is_virtual_filename(filename)))
+        goto fail;
+    if (buffer_size == 0)
+        buffer_size = STREAMFILE_DEFAULT_BUFFER_SIZE;
+
+    sf = open_host_streamfile_buffer(handle, io, filename, NULL, buffer_size);
+    if (!sf) goto fail;
+    return sf;
+fail:
+    if (io && handle)
+        io->close(handle);
+    return NULL;
 }
 
 /* **************************************************** */
 
+#ifndef _WIN32
+/* whole file mapping, shared between reopens of the same file */
+typedef struct {
+    uint8_t * data;         /* mapped file */
+    size_t size;            /* mapped size (same as filesize) */
+    sf_name * name;         /* mapped filename */
+    int refs;               /* streamfiles using this mapping */
+} MMAP_MAPPING;
+
+/* a STREAMFILE that reads from a memory mapped file, with no intermediate buffer */
+typedef struct {
+    STREAMFILE sf;          /* callbacks */
+
+    MMAP_MAPPING * mapping; /* shared mapping (with the filename) */
+    off_t offset;           /* last read offset (info) */
+    streamfile_stats_t stats; /* all reads are hits, bytes_read counts bytes copied from the mapping */
+} MMAP_STREAMFILE;
+
+static STREAMFILE* open_mmap_streamfile_by_mapping(MMAP_MAPPING *mapping);
+
+static size_t read_mmap(MMAP_STREAMFILE *streamfile, uint8_t *dst, off_t offset, size_t length) {
+    size_t filesize = streamfile->mapping->size;
+
+    if (!dst || length <= 0 || offset < 0)
+        return 0;
+
+    stats_read(&streamfile->stats, length);
+
+    /* ignore requests at EOF */
+    if (offset >= filesize) {
+        VGM_ASSERT_ONCE(offset > filesize, "MMAP: reading over filesize 0x%x @ 0x%x + 0x%x\n", filesize, (uint32_t)offset, length);
+        return 0;
+    }
+
+    if (length > filesize - offset)
+        length = filesize - offset;
+
+    memcpy(dst, streamfile->mapping->data + offset, length);
+    streamfile->stats.buffer_hits++;
+    streamfile->stats.bytes_read += length;
+    streamfile->offset = offset + length; /* last read offset */
+    return length;
+}
+static const uint8_t* read_ptr_mmap(MMAP_STREAMFILE *streamfile, off_t offset, size_t length) {
+    if (offset < 0 || offset + length > streamfile->mapping->size)
+        return NULL;
+
+    stats_read(&streamfile->stats, length);
+    streamfile->stats.buffer_hits++;
+    streamfile->offset = offset + length;
+    return streamfile->mapping->data + offset;
+}
+static size_t get_size_mmap(MMAP_STREAMFILE *streamfile) {
+    return streamfile->mapping->size;
+}
+static off_t get_offset_mmap(MMAP_STREAMFILE *streamfile) {
+    return streamfile->offset;
+}
+static void get_name_mmap(MMAP_STREAMFILE *streamfile, char *buffer, size_t length) {
+    sf_name_copy(streamfile->mapping->name, buffer, length);
+}
+static const char* get_name_ref_mmap(MMAP_STREAMFILE *streamfile) {
+    return streamfile->mapping->name->name;
+}
+static void get_stats_mmap(MMAP_STREAMFILE *streamfile, streamfile_stats_t *stats) {
+    *stats = streamfile->stats;
+}
+static void prefetch_mmap(MMAP_STREAMFILE *streamfile, off_t offset, size_t length) {
+#ifdef MADV_WILLNEED
+    /* pages not faulted in yet are read ahead by the OS (range must start on a page) */
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    off_t start;
+
+    if (page == 0 || offset >= streamfile->mapping->size)
+        return;
+    if (length > streamfile->mapping->size - offset)
+        length = streamfile->mapping->size - offset;
+    start = offset - (offset % page);
+    madvise(streamfile->mapping->data + start, length + (offset - start), MADV_WILLNEED);
+#endif
+}
+static void close_mmap(MMAP_STREAMFILE *streamfile) {
+    MMAP_MAPPING *mapping = streamfile->mapping;
+
+    mapping->refs--;
+    if (mapping->refs == 0) {
+        munmap(mapping->data, mapping->size);
+        sf_name_unref(mapping->name);
+        free(mapping);
+    }
+    free(streamfile);
+}
+
+static STREAMFILE* open_mmap(MMAP_STREAMFILE *streamfile, const char * const filename, size_t buffersize) {
+    if (!filename)
+        return NULL;
+
+    /* if same name, share the mapping we already have (buffersize isn't needed) */
+    if (sf_name_equals(streamfile->mapping->name, filename)) {
+        STREAMFILE *new_sf = open_mmap_streamfile_by_mapping(streamfile->mapping);
+        if (new_sf)
+            return new_sf;
+    }
+
+    return open_mmap_streamfile(filename);
+}
+
+static STREAMFILE* open_mmap_streamfile_by_mapping(MMAP_MAPPING *mapping) {
+    MMAP_STREAMFILE *streamfile = NULL;
+
+    streamfile = calloc(1,sizeof(MMAP_STREAMFILE));
+    if (!streamfile) return NULL;
+
+    streamfile->sf.read = (void*)read_mmap;
+    streamfile->sf.get_size = (void*)get_size_mmap;
+    streamfile->sf.get_offset = (void*)get_offset_mmap;
+    streamfile->sf.get_name = (void*)get_name_mmap;
+    streamfile->sf.open = (void*)open_mmap;
+    streamfile->sf.close = (void*)close_mmap;
+    streamfile->sf.read_ptr = (void*)read_ptr_mmap;
+    streamfile->sf.get_stats = (void*)get_stats_mmap;
+    streamfile->sf.get_name_ref = (void*)get_name_ref_mmap;
+    streamfile->sf.prefetch = (void*)prefetch_mmap;
+
+    streamfile->mapping = mapping;
+    mapping->refs++;
+
+    return &streamfile->sf;
+}
+
+/* maps the whole file, or returns NULL (empty files, pipes and such can't be mapped) */
+static MMAP_MAPPING* open_mmap_mapping(const char * const filename) {
+    MMAP_MAPPING *mapping = NULL;
+    struct stat st;
+    void *data;
+    int fd;
+
+    fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= 0 || (uint64_t)st.st_size > (size_t)-1)
+        goto fail;
+
+    data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED)
+        goto fail;
+    close(fd); /* mapping stays valid */
+
+    mapping = calloc(1,sizeof(MMAP_MAPPING));
+    if (mapping)
+        mapping->name = sf_name_new(filename);
+    if (!mapping || !mapping->name) {
+        munmap(data, (size_t)st.st_size);
+        free(mapping);
+        return NULL;
+    }
+
+    mapping->data = data;
+    mapping->size = (size_t)st.st_size;
+    return mapping;
+fail:
+    close(fd);
+    return NULL;
+}
+#endif
+
+STREAMFILE* open_mmap_streamfile(const char *filename) {
+#ifndef _WIN32
+    MMAP_MAPPING *mapping = open_mmap_mapping(filename);
+    if (mapping) {
+        STREAMFILE *sf = open_mmap_streamfile_by_mapping(mapping);
+        if (sf)
+            return sf;
+        munmap(mapping->data, mapping->size);
+        sf_name_unref(mapping->name);
+        free(mapping);
+    }
+#endif
+
+    /* mapping not possible, use regular IO (still read at once if small) */
+    return open_memory_streamfile_f(open_stdio_streamfile(filename), MEMORY_STREAMFILE_MAX_SIZE);
+}
+
+/* **************************************************** */
+
+/* whole file read at open, shared between reopens of the same file */
+typedef struct {
+    uint8_t * data;         /* file data */
+    size_t size;            /* same as filesize */
+    sf_name * name;
+    STREAMFILE *inner_sf;   /* kept to open other files and for stats */
+    size_t max_size;        /* for other files */
+    int refs;               /* streamfiles using this data */
+} MEMORY_DATA;
+
+/* a STREAMFILE that reads from a copy of the whole file in memory */
+typedef struct {
+    STREAMFILE sf;          /* callbacks */
+
+    MEMORY_DATA * mem;      /* shared data (with the filename) */
+    off_t offset;           /* last read offset (info) */
+    streamfile_stats_t stats; /* own calls, the rest from the inner streamfile */
+} MEMORY_STREAMFILE;
+
+static STREAMFILE* open_memory_streamfile_by_data(MEMORY_DATA *mem);
+
+static size_t memory_read(MEMORY_STREAMFILE *streamfile, uint8_t *dst, off_t offset, size_t length) {
+    size_t filesize = streamfile->mem->size;
+
+    if (!dst || length <= 0 || offset < 0)
+        return 0;
+
+    stats_read(&streamfile->stats, length);
+
+    /* ignore requests at EOF */
+    if (offset >= filesize) {
+        VGM_ASSERT_ONCE(offset > filesize, "MEMORY: reading over filesize 0x%x @ 0x%x + 0x%x\n", filesize, (uint32_t)offset, length);
+        return 0;
+    }
+
+    if (length > filesize - offset)
+        length = filesize - offset;
+
+    memcpy(dst, streamfile->mem->data + offset, length);
+    streamfile->stats.buffer_hits++;
+    streamfile->offset = offset + length; /* last read offset */
+    return length;
+}
+static const uint8_t* memory_read_ptr(MEMORY_STREAMFILE *streamfile, off_t offset, size_t length) {
+    if (offset < 0 || offset + length > streamfile->mem->size)
+        return NULL;
+
+    stats_read(&streamfile->stats, length);
+    streamfile->stats.buffer_hits++;
+    streamfile->offset = offset + length;
+    return streamfile->mem->data + offset;
+}
+static size_t memory_get_size(MEMORY_STREAMFILE *streamfile) {
+    return streamfile->mem->size;
+}
+static off_t memory_get_offset(MEMORY_STREAMFILE *streamfile) {
+    return streamfile->offset;
+}
+static void memory_get_name(MEMORY_STREAMFILE *streamfile, char *buffer, size_t length) {
+    sf_name_copy(streamfile->mem->name, buffer, length);
+}
+static const char* memory_get_name_ref(MEMORY_STREAMFILE *streamfile) {
+    return streamfile->mem->name->name;
+}
+static void memory_get_stats(MEMORY_STREAMFILE *streamfile, streamfile_stats_t *stats) {
+    get_stats_wrapper(streamfile->mem->inner_sf, &streamfile->stats, stats);
+    stats->buffer_hits = streamfile->stats.buffer_hits;
+}
+static void memory_close(MEMORY_STREAMFILE *streamfile) {
+    MEMORY_DATA *mem = streamfile->mem;
+
+    mem->refs--;
+    if (mem->refs == 0) {
+        close_streamfile(mem->inner_sf);
+        sf_name_unref(mem->name);
+        free(mem->data);
+        free(mem);
+    }
+    free(streamfile);
+}
+
+static STREAMFILE* memory_open(MEMORY_STREAMFILE *streamfile, const char * const filename, size_t buffersize) {
+    STREAMFILE *new_inner_sf;
+
+    if (!filename)
+        return NULL;
+
+    /* if same name, share the data we already have */
+    if (sf_name_equals(streamfile->mem->name, filename)) {
+        STREAMFILE *new_sf = open_memory_streamfile_by_data(streamfile->mem);
+        if (new_sf)
+            return new_sf;
+    }
+
+    /* other files (companions) may be small too */
+    new_inner_sf = streamfile->mem->inner_sf->open(streamfile->mem->inner_sf, filename, buffersize);
+    return open_memory_streamfile_f(new_inner_sf, streamfile->mem->max_size);
+}
+
+static STREAMFILE* open_memory_streamfile_by_data(MEMORY_DATA *mem) {
+    MEMORY_STREAMFILE *streamfile = NULL;
+
+    streamfile = calloc(1,sizeof(MEMORY_STREAMFILE));
+    if (!streamfile) return NULL;
+
+    streamfile->sf.read = (void*)memory_read;
+    streamfile->sf.get_size = (void*)memory_get_size;
+    streamfile->sf.get_offset = (void*)memory_get_offset;
+    streamfile->sf.get_name = (void*)memory_get_name;
+    streamfile->sf.open = (void*)memory_open;
+    streamfile->sf.close = (void*)memory_close;
+    streamfile->sf.read_ptr = (void*)memory_read_ptr;
+    streamfile->sf.get_stats = (void*)memory_get_stats;
+    streamfile->sf.get_name_ref = (void*)memory_get_name_ref;
+    streamfile->sf.stream_index = mem->inner_sf->stream_index;
+    streamfile->sf.probe_only = mem->inner_sf->probe_only;
+
+    streamfile->mem = mem;
+    mem->refs++;
+
+    return &streamfile->sf;
+}
+
+STREAMFILE* open_memory_streamfile_f(STREAMFILE *streamfile, size_t max_size) {
+    char filename[PATH_LIMIT];
+    MEMORY_DATA *mem = NULL;
+    STREAMFILE *new_sf;
+    size_t filesize;
+
+    if (!streamfile)
+        return NULL;
+
+    filesize = get_streamfile_size(streamfile);
+    if (filesize == 0 || filesize > max_size)
+        return streamfile;
+
+    mem = calloc(1,sizeof(MEMORY_DATA));
+    if (!mem) goto fail;
+    mem->data = malloc(filesize);
+    if (!mem->data) goto fail;
+
+    /* a single read, and the inner buffer isn't needed after it */
+    if (read_streamfile(mem->data, 0, filesize, streamfile) != filesize)
+        goto fail;
+    release_streamfile_buffer(streamfile);
+
+    streamfile->get_name(streamfile, filename, sizeof(filename));
+    mem->name = sf_name_new(filename);
+    if (!mem->name) goto fail;
+
+    mem->size = filesize;
+    mem->inner_sf = streamfile;
+    mem->max_size = max_size;
+
+    new_sf = open_memory_streamfile_by_data(mem);
+    if (!new_sf) goto fail;
+    return new_sf;
+
+fail:
+    if (mem) {
+        sf_name_unref(mem->name);
+        free(mem->data);
+        free(mem);
+    }
+    return streamfile; /* regular IO then */
+}
+
+/* **************************************************** */
+
+void sf_reader_init(sf_reader *r, STREAMFILE *sf) {
+    r->sf = sf;
+    r->offset = 0;
+    r->size = 0;
+}
+
+const uint8_t* sf_reader_refill(sf_reader *r, off_t offset, size_t size) {
+    if (offset < 0 || size > SF_READER_BUFFER_SIZE)
+        return NULL;
+
+    r->offset = offset;
+    r->size = read_streamfile(r->buf, offset, SF_READER_BUFFER_SIZE, r->sf);
+    if (size > r->size)
+        return NULL;
+    return r->buf;
+}
+
+int sf_chunks_read(sf_chunks *chunks, sf_reader *r, off_t offset, off_t max_offset, off_t end_offset, int big_endian, int pad) {
+
+    while (offset < max_offset && offset < end_offset) {
+        const uint8_t* p = sf_reader_get(r, offset, 0x08);
+        sf_chunk* chunk;
+
+        if (!p || chunks->count >= SF_CHUNKS_MAX)
+            return 0;
+
+        chunk = &chunks->chunk[chunks->count];
+        chunk->id = get_u32be(p + 0x00);
+        chunk->size = big_endian ? get_u32be(p + 0x04) : get_u32le(p + 0x04);
+        chunk->offset = offset;
+        if (offset + 0x08 + chunk->size > end_offset)
+            return 0;
+        chunks->count++;
+
+        offset += 0x08 + chunk->size;
+        if (pad && (chunk->size % 0x02) && offset + 0x01 <= end_offset)
+            offset += 0x01;
+    }
+
+    return 1;
+}
+
+const sf_chunk* sf_chunks_find(const sf_chunks *chunks, uint32_t id) {
+    int i;
+
+    for (i = 0; i < chunks->count; i++) {
+        if (chunks->chunk[i].id == id)
+            return &chunks->chunk[i];
+    }
+    return NULL;
+}
+
+/* **************************************************** */
+
+/* Adaptive buffers start at the default size, double after a few sequential refills (up to
+ * a max) and halve after a few random ones, while all adaptive buffers stay under a global
+ * budget. Growing and shrinking only happens on refills, when the buffer data is discarded anyway. */
+#define ADAPTIVE_BUFFER_MIN         0x1000
+#define ADAPTIVE_BUFFER_MAX         0x200000
+#define ADAPTIVE_BUFFER_GROW_COUNT  2   /* sequential refills before growing */
+#define ADAPTIVE_BUFFER_SHRINK_COUNT 4  /* random refills before shrinking */
+
+#define INTERLEAVE_BUFFER_MAX       0x100000
+
+static struct {
+    size_t max_size;
+    size_t used;
+    void (*lock)(void*);
+    void (*unlock)(void*);
+    void* lock_data;
+} buffer_budget;
+
+void vgmstream_buffer_budget_setup(size_t max_size, void (*lock)(void*), void (*unlock)(void*), void* lock_data) {
+    buffer_budget.max_size = max_size;
+    buffer_budget.lock = lock;
+    buffer_budget.unlock = unlock;
+    buffer_budget.lock_data = lock_data;
+}
+
+/* charges a size change of an adaptive buffer, returns 0 if growing would go over budget */
+static int buffer_budget_change(size_t old_size, size_t new_size) {
+    int ok = 1;
+
+    if (buffer_budget.lock)
+        buffer_budget.lock(buffer_budget.lock_data);
+    if (new_size > old_size && buffer_budget.used + (new_size - old_size) > buffer_budget.max_size)
+        ok = 0;
+    else
+        buffer_budget.used = buffer_budget.used - old_size + new_size;
+    if (buffer_budget.unlock)
+        buffer_budget.unlock(buffer_budget.lock_data);
+
+    return ok;
+}
+
 typedef struct {
     STREAMFILE sf;
 
     STREAMFILE *inner_sf;
     off_t offset;           /* last read offset (info) */
     off_t buffer_offset;    /* current buffer data start */
-    uint8_t * buffer;       /* data buffer */
+    uint8_t * buffer;       /* data buffer (NULL until the first refill or when released) */
     size_t buffersize;      /* max buffer size */
     size_t validsize;       /* current buffer size */
     size_t filesize;        /* buffered file size */
+    streamfile_stats_t stats;
+
+    off_t row_start;        /* interleaved data start, refills are aligned to rows from here (optional) */
+    size_t row_size;        /* interleave * channels */
+
+    int adaptive;           /* buffersize changes with the access pattern */
+    off_t fill_end;         /* end of the last refill */
+    int sequential_count;   /* consecutive refills right after the previous buffer */
+    int random_count;       /* consecutive refills elsewhere */
 } BUFFER_STREAMFILE;
 
+/* resizes an adaptive buffer before a refill at offset */
+static void buffer_adapt(BUFFER_STREAMFILE *streamfile, off_t offset) {
+    size_t new_size = streamfile->buffersize;
+    uint8_t *new_buffer;
+
+    if (offset == streamfile->fill_end && offset > 0) {
+        streamfile->random_count = 0;
+        streamfile->sequential_count++;
+        if (streamfile->sequential_count >= ADAPTIVE_BUFFER_GROW_COUNT && new_size < ADAPTIVE_BUFFER_MAX) {
+            new_size *= 2;
+            streamfile->sequential_count = 0;
+        }
+    }
+    else {
+        streamfile->sequential_count = 0;
+        streamfile->random_count++;
+        if (streamfile->random_count >= ADAPTIVE_BUFFER_SHRINK_COUNT && new_size > ADAPTIVE_BUFFER_MIN) {
+            new_size /= 2;
+            streamfile->random_count = 0;
+        }
+    }
+
+    if (new_size == streamfile->buffersize)
+        return;
+    if (!buffer_budget_change(streamfile->buffersize, new_size))
+        return;
+
+    /* swapped through the pool as the old data is discarded anyway (may allocate while rendering,
+     * but only a few times as the pattern settles, so it's allowed) */
+    VGM_ALLOC_CHECK_PAUSE();
+    new_buffer = buffer_pool_take(new_size);
+    VGM_ALLOC_CHECK_RESUME();
+    if (!new_buffer) {
+        buffer_budget_change(new_size, streamfile->buffersize);
+        return;
+    }
+    if (streamfile->buffer) {
+        buffer_pool_give(streamfile->buffer, streamfile->buffersize);
+        streamfile->validsize = 0;
+    }
+    streamfile->buffer = new_buffer;
+    streamfile->buffersize = new_size;
+    streamfile->stats.buffer_size = new_size;
+    if (streamfile->stats.buffer_peak < new_size)
+        streamfile->stats.buffer_peak = new_size;
+}
+
 
 static size_t buffer_read(BUFFER_STREAMFILE *streamfile, uint8_t *dst, off_t offset, size_t length) {
     size_t length_read_total = 0;
@@ -257,6 +1178,8 @@ static size_t buffer_read(BUFFER_STREAMFILE *streamfile, uint8_t *dst, off_t off
     if (!dst || length <= 0 || offset < 0)
         return 0;
 
+    stats_read(&streamfile->stats, length);
+
     /* is the part of the requested length in the buffer? */
     if (offset >= streamfile->buffer_offset && offset < streamfile->buffer_offset + streamfile->validsize) {
         size_t length_to_read;
@@ -273,6 +1196,11 @@ static size_t buffer_read(BUFFER_STREAMFILE *streamfile, uint8_t *dst, off_t off
         dst += length_to_read;
     }
 
+    if (length == 0)
+        streamfile->stats.buffer_hits++;
+    else if (offset < streamfile->buffer_offset)
+        streamfile->stats.rebuffers_back++;
+
 #ifdef VGM_DEBUG_OUTPUT
     if (offset < streamfile->buffer_offset) {
         VGM_LOG("BUFFER: rebuffer, requested %lx vs %lx (sf %x)\n", offset, streamfile->buffer_offset, (uint32_t)streamfile);
@@ -282,6 +1210,7 @@ static size_t buffer_read(BUFFER_STREAMFILE *streamfile, uint8_t *dst, off_t off
     /* read the rest of the requested length */
     while (length > 0) {
         size_t length_to_read;
+        off_t offset_into_buffer;
 
         /* ignore requests at EOF */
         if (offset >= streamfile->filesize) {
@@ -290,26 +1219,38 @@ static size_t buffer_read(BUFFER_STREAMFILE *streamfile, uint8_t *dst, off_t off
             break;
         }
 
-        /* fill the buffer (offset now is beyond buffer_offset) */
+        if (streamfile->adaptive)
+            buffer_adapt(streamfile, offset);
+        if (!buffer_pool_borrow(&streamfile->buffer, streamfile->buffersize, &streamfile->stats))
+            break;
+
+        /* fill the buffer (offset now is beyond buffer_offset), from the start of the interleave
+         * row if set so all channels' blocks of that row are in */
         streamfile->buffer_offset = offset;
+        if (streamfile->row_size && offset >= streamfile->row_start)
+            streamfile->buffer_offset -= (offset - streamfile->row_start) % streamfile->row_size;
         streamfile->validsize = streamfile->inner_sf->read(streamfile->inner_sf, streamfile->buffer, streamfile->buffer_offset, streamfile->buffersize);
+        streamfile->fill_end = streamfile->buffer_offset + streamfile->validsize;
+        streamfile->stats.buffer_misses++;
 
         /* decide how much must be read this time */
-        if (length > streamfile->buffersize)
-            length_to_read = streamfile->buffersize;
-        else
+        offset_into_buffer = offset - streamfile->buffer_offset;
+        length_to_read = streamfile->buffersize - offset_into_buffer;
+        if (length_to_read > length)
             length_to_read = length;
 
         /* give up on partial reads (EOF) */
-        if (streamfile->validsize < length_to_read) {
-            memcpy(dst, streamfile->buffer, streamfile->validsize);
-            offset += streamfile->validsize;
-            length_read_total += streamfile->validsize;
+        if (streamfile->validsize < offset_into_buffer + length_to_read) {
+            if (streamfile->validsize > offset_into_buffer) {
+                memcpy(dst, streamfile->buffer + offset_into_buffer, streamfile->validsize - offset_into_buffer);
+                length_read_total += streamfile->validsize - offset_into_buffer;
+                offset = streamfile->buffer_offset + streamfile->validsize;
+            }
             break;
         }
 
         /* use the new buffer */
-        memcpy(dst, streamfile->buffer, length_to_read);
+        memcpy(dst, streamfile->buffer + offset_into_buffer, length_to_read);
         offset += length_to_read;
         length_read_total += length_to_read;
         length -= length_to_read;
@@ -319,6 +1260,27 @@ static size_t buffer_read(BUFFER_STREAMFILE *streamfile, uint8_t *dst, off_t off
     streamfile->offset = offset; /* last fread offset */
     return length_read_total;
 }
+static const uint8_t* buffer_read_ptr(BUFFER_STREAMFILE *streamfile, off_t offset, size_t length) {
+    if (offset < 0 || length > streamfile->buffersize || offset + length > streamfile->filesize)
+        return NULL; /* also keeps the buffer when other readers of a shared buffer are at EOF */
+
+    /* refill the buffer from offset if the range isn't fully inside */
+    if (offset < streamfile->buffer_offset || offset + length > streamfile->buffer_offset + streamfile->validsize) {
+        uint8_t byte;
+        streamfile->validsize = 0;
+        streamfile->stats.bytes_requested += length - 1;
+        buffer_read(streamfile, &byte, offset, 1);
+        if (offset < streamfile->buffer_offset || offset + length > streamfile->buffer_offset + streamfile->validsize)
+            return NULL; /* EOF */
+    }
+    else {
+        stats_read(&streamfile->stats, length);
+        streamfile->stats.buffer_hits++;
+    }
+
+    streamfile->offset = offset + length;
+    return streamfile->buffer + (offset - streamfile->buffer_offset);
+}
 static size_t buffer_get_size(BUFFER_STREAMFILE *streamfile) {
     return streamfile->filesize; /* cache */
 }
@@ -330,11 +1292,42 @@ static void buffer_get_name(BUFFER_STREAMFILE *streamfile, char *buffer, size_t
 }
 static STREAMFILE *buffer_open(BUFFER_STREAMFILE *streamfile, const char * const filename, size_t buffersize) {
     STREAMFILE *new_inner_sf = streamfile->inner_sf->open(streamfile->inner_sf,filename,buffersize);
+    if (streamfile->adaptive)
+        return open_buffer_streamfile_adaptive(new_inner_sf);
+    if (streamfile->row_size) {
+        char original_filename[PATH_LIMIT];
+        streamfile->inner_sf->get_name(streamfile->inner_sf, original_filename, PATH_LIMIT);
+        if (strcmp(filename, original_filename) == 0)
+            return open_interleave_buffer_streamfile(new_inner_sf, streamfile->row_start, streamfile->row_size);
+    }
     return open_buffer_streamfile(new_inner_sf, buffersize); /* original buffer size is preferable? */
 }
+static void buffer_get_stats(BUFFER_STREAMFILE *streamfile, streamfile_stats_t *stats) {
+    get_streamfile_stats(streamfile->inner_sf, stats);
+    stats->read_calls = streamfile->stats.read_calls;
+    stats->bytes_requested = streamfile->stats.bytes_requested;
+    stats->buffer_hits = streamfile->stats.buffer_hits;
+    stats->buffer_misses = streamfile->stats.buffer_misses;
+    stats->rebuffers_back = streamfile->stats.rebuffers_back;
+    stats->buffer_size += streamfile->stats.buffer_size;
+    stats->buffer_peak += streamfile->stats.buffer_peak;
+}
+static const char* buffer_get_name_ref(BUFFER_STREAMFILE *streamfile) {
+    return get_streamfile_name_ref(streamfile->inner_sf); /* default */
+}
+static void buffer_prefetch(BUFFER_STREAMFILE *streamfile, off_t offset, size_t length) {
+    prefetch_streamfile(streamfile->inner_sf, offset, length); /* default */
+}
+static void buffer_release(BUFFER_STREAMFILE *streamfile) {
+    buffer_pool_return(&streamfile->buffer, streamfile->buffersize, &streamfile->stats);
+    streamfile->validsize = 0;
+    release_streamfile_buffer(streamfile->inner_sf);
+}
 static void buffer_close(BUFFER_STREAMFILE *streamfile) {
+    if (streamfile->adaptive)
+        buffer_budget_change(streamfile->buffersize, 0);
     streamfile->inner_sf->close(streamfile->inner_sf);
-    free(streamfile->buffer);
+    buffer_pool_return(&streamfile->buffer, streamfile->buffersize, &streamfile->stats);
     free(streamfile);
 }
 
@@ -350,9 +1343,6 @@ STREAMFILE* open_buffer_streamfile(STREAMFILE *streamfile, size_t buffer_size) {
     if (this_sf->buffersize == 0)
         this_sf->buffersize = STREAMFILE_DEFAULT_BUFFER_SIZE;
 
-    this_sf->buffer = calloc(this_sf->buffersize,1);
-    if (!this_sf->buffer) goto fail;
-
     /* set callbacks and internals */
     this_sf->sf.read = (void*)buffer_read;
     this_sf->sf.get_size = (void*)buffer_get_size;
@@ -360,7 +1350,13 @@ STREAMFILE* open_buffer_streamfile(STREAMFILE *streamfile, size_t buffer_size) {
     this_sf->sf.get_name = (void*)buffer_get_name;
     this_sf->sf.open = (void*)buffer_open;
     this_sf->sf.close = (void*)buffer_close;
+    this_sf->sf.read_ptr = (void*)buffer_read_ptr;
+    this_sf->sf.get_stats = (void*)buffer_get_stats;
+    this_sf->sf.release = (void*)buffer_release;
+    this_sf->sf.get_name_ref = streamfile->get_name_ref ? (void*)buffer_get_name_ref : NULL;
+    this_sf->sf.prefetch = streamfile->prefetch ? (void*)buffer_prefetch : NULL;
     this_sf->sf.stream_index = streamfile->stream_index;
+    this_sf->sf.probe_only = streamfile->probe_only;
 
     this_sf->inner_sf = streamfile;
 
@@ -369,7 +1365,6 @@ STREAMFILE* open_buffer_streamfile(STREAMFILE *streamfile, size_t buffer_size) {
     return &this_sf->sf;
 
 fail:
-    if (this_sf) free(this_sf->buffer);
     free(this_sf);
     return NULL;
 }
@@ -380,20 +1375,70 @@ STREAMFILE* open_buffer_streamfile_f(STREAMFILE *streamfile, size_t buffer_size)
     return new_sf;
 }
 
+STREAMFILE* open_interleave_buffer_streamfile(STREAMFILE *streamfile, off_t row_start, size_t row_size) {
+    BUFFER_STREAMFILE *this_sf;
+    size_t buffer_size;
+
+    if (row_size == 0 || row_size > INTERLEAVE_BUFFER_MAX)
+        return NULL;
+
+    /* whole rows, so refills after the first one start at a row too */
+    buffer_size = row_size;
+    while (buffer_size < STREAMFILE_DEFAULT_BUFFER_SIZE)
+        buffer_size += row_size;
+
+    this_sf = (BUFFER_STREAMFILE*)open_buffer_streamfile(streamfile, buffer_size);
+    if (!this_sf)
+        return NULL;
+
+    this_sf->row_start = row_start;
+    this_sf->row_size = row_size;
+    return &this_sf->sf;
+}
+
+STREAMFILE* open_buffer_streamfile_adaptive(STREAMFILE *streamfile) {
+    BUFFER_STREAMFILE *this_sf = (BUFFER_STREAMFILE*)open_buffer_streamfile(streamfile, 0);
+    if (!this_sf)
+        return NULL;
+
+    this_sf->adaptive = 1;
+    buffer_budget_change(0, this_sf->buffersize); /* always allowed, charged so later growth sees it */
+    return &this_sf->sf;
+}
+STREAMFILE* open_buffer_streamfile_adaptive_f(STREAMFILE *streamfile) {
+    STREAMFILE *new_sf = open_buffer_streamfile_adaptive(streamfile);
+    if (!new_sf)
+        close_streamfile(streamfile);
+    return new_sf;
+}
+
 /* **************************************************** */
 
 //todo stream_index: copy? pass? funtion? external?
 //todo use realnames on reopen? simplify?
 //todo use safe string ops, this ain't easy
 
+/* Metas often stack wrappers (wrap > clamp > io > fakename...), so reads of wrappers that only forward
+ * them (wrap, fakename) go straight to the first streamfile below that does something else, and clamps
+ * or slices over clamps/slices read the innermost one with the starts added. Skipped wrappers stay in the chain for
+ * open/close/names/stats (their own counters just don't see those reads). */
+static STREAMFILE* get_fused_read_sf(STREAMFILE *sf, off_t *p_start);
+
 typedef struct {
     STREAMFILE sf;
 
     STREAMFILE *inner_sf;
+    STREAMFILE *read_sf;    /* fused inner_sf */
+    streamfile_stats_t stats;
 } WRAP_STREAMFILE;
 
 static size_t wrap_read(WRAP_STREAMFILE *streamfile, uint8_t *dst, off_t offset, size_t length) {
-    return streamfile->inner_sf->read(streamfile->inner_sf, dst, offset, length); /* default */
+    stats_read(&streamfile->stats, length);
+    return streamfile->read_sf->read(streamfile->read_sf, dst, offset, length); /* default */
+}
+static const uint8_t* wrap_read_ptr(WRAP_STREAMFILE *streamfile, off_t offset, size_t length) {
+    stats_read(&streamfile->stats, length);
+    return streamfile->read_sf->read_ptr(streamfile->read_sf, offset, length); /* default */
 }
 static size_t wrap_get_size(WRAP_STREAMFILE *streamfile) {
     return streamfile->inner_sf->get_size(streamfile->inner_sf); /* default */
@@ -407,6 +1452,18 @@ static void wrap_get_name(WRAP_STREAMFILE *streamfile, char *buffer, size_t leng
 static void wrap_open(WRAP_STREAMFILE *streamfile, const char * const filename, size_t buffersize) {
     streamfile->inner_sf->open(streamfile->inner_sf, filename, buffersize); /* default (don't wrap) */
 }
+static void wrap_get_stats(WRAP_STREAMFILE *streamfile, streamfile_stats_t *stats) {
+    get_stats_wrapper(streamfile->inner_sf, &streamfile->stats, stats);
+}
+static const char* wrap_get_name_ref(WRAP_STREAMFILE *streamfile) {
+    return get_streamfile_name_ref(streamfile->inner_sf); /* default */
+}
+static void wrap_prefetch(WRAP_STREAMFILE *streamfile, off_t offset, size_t length) {
+    prefetch_streamfile(streamfile->read_sf, offset, length); /* default */
+}
+static void wrap_release(WRAP_STREAMFILE *streamfile) {
+    release_streamfile_buffer(streamfile->inner_sf);
+}
 static void wrap_close(WRAP_STREAMFILE *streamfile) {
     //streamfile->inner_sf->close(streamfile->inner_sf); /* don't close */
     free(streamfile);
@@ -427,9 +1484,16 @@ STREAMFILE* open_wrap_streamfile(STREAMFILE *streamfile) {
     this_sf->sf.get_name = (void*)wrap_get_name;
     this_sf->sf.open = (void*)wrap_open;
     this_sf->sf.close = (void*)wrap_close;
+    this_sf->sf.read_ptr = streamfile->read_ptr ? (void*)wrap_read_ptr : NULL;
+    this_sf->sf.get_stats = (void*)wrap_get_stats;
+    this_sf->sf.release = (void*)wrap_release;
+    this_sf->sf.get_name_ref = streamfile->get_name_ref ? (void*)wrap_get_name_ref : NULL;
+    this_sf->sf.prefetch = streamfile->prefetch ? (void*)wrap_prefetch : NULL;
     this_sf->sf.stream_index = streamfile->stream_index;
+    this_sf->sf.probe_only = streamfile->probe_only;
 
     this_sf->inner_sf = streamfile;
+    this_sf->read_sf = get_fused_read_sf(streamfile, NULL);
 
     return &this_sf->sf;
 }
@@ -448,12 +1512,22 @@ typedef struct {
     STREAMFILE *inner_sf;
     off_t start;
     size_t size;
+    STREAMFILE *read_sf;    /* fused inner_sf (inner clamps are within this one's range) */
+    off_t read_start;       /* start in read_sf */
+    streamfile_stats_t stats;
 } CLAMP_STREAMFILE;
 
 static size_t clamp_read(CLAMP_STREAMFILE *streamfile, uint8_t *dst, off_t offset, size_t length) {
-    off_t inner_offset = streamfile->start + offset;
+    off_t inner_offset = streamfile->read_start + offset;
     size_t clamp_length = length > (streamfile->size - offset) ? (streamfile->size - offset) : length;
-    return streamfile->inner_sf->read(streamfile->inner_sf, dst, inner_offset, clamp_length);
+    stats_read(&streamfile->stats, length);
+    return streamfile->read_sf->read(streamfile->read_sf, dst, inner_offset, clamp_length);
+}
+static const uint8_t* clamp_read_ptr(CLAMP_STREAMFILE *streamfile, off_t offset, size_t length) {
+    if (offset < 0 || offset + length > streamfile->size)
+        return NULL;
+    stats_read(&streamfile->stats, length);
+    return streamfile->read_sf->read_ptr(streamfile->read_sf, streamfile->read_start + offset, length);
 }
 static size_t clamp_get_size(CLAMP_STREAMFILE *streamfile) {
     return streamfile->size;
@@ -478,6 +1552,22 @@ static STREAMFILE *clamp_open(CLAMP_STREAMFILE *streamfile, const char * const f
         return new_inner_sf;
     }
 }
+static void clamp_get_stats(CLAMP_STREAMFILE *streamfile, streamfile_stats_t *stats) {
+    get_stats_wrapper(streamfile->inner_sf, &streamfile->stats, stats);
+}
+static const char* clamp_get_name_ref(CLAMP_STREAMFILE *streamfile) {
+    return get_streamfile_name_ref(streamfile->inner_sf); /* default */
+}
+static void clamp_prefetch(CLAMP_STREAMFILE *streamfile, off_t offset, size_t length) {
+    if (offset >= streamfile->size)
+        return;
+    if (length > streamfile->size - offset)
+        length = streamfile->size - offset;
+    prefetch_streamfile(streamfile->read_sf, streamfile->read_start + offset, length);
+}
+static void clamp_release(CLAMP_STREAMFILE *streamfile) {
+    release_streamfile_buffer(streamfile->inner_sf);
+}
 static void clamp_close(CLAMP_STREAMFILE *streamfile) {
     streamfile->inner_sf->close(streamfile->inner_sf);
     free(streamfile);
@@ -499,11 +1589,19 @@ STREAMFILE* open_clamp_streamfile(STREAMFILE *streamfile, off_t start, size_t si
     this_sf->sf.get_name = (void*)clamp_get_name;
     this_sf->sf.open = (void*)clamp_open;
     this_sf->sf.close = (void*)clamp_close;
+    this_sf->sf.read_ptr = streamfile->read_ptr ? (void*)clamp_read_ptr : NULL;
+    this_sf->sf.get_stats = (void*)clamp_get_stats;
+    this_sf->sf.release = (void*)clamp_release;
+    this_sf->sf.get_name_ref = streamfile->get_name_ref ? (void*)clamp_get_name_ref : NULL;
+    this_sf->sf.prefetch = streamfile->prefetch ? (void*)clamp_prefetch : NULL;
     this_sf->sf.stream_index = streamfile->stream_index;
+    this_sf->sf.probe_only = streamfile->probe_only;
 
     this_sf->inner_sf = streamfile;
     this_sf->start = start;
     this_sf->size = size;
+    this_sf->read_start = start;
+    this_sf->read_sf = get_fused_read_sf(streamfile, &this_sf->read_start);
 
     return &this_sf->sf;
 }
@@ -526,9 +1624,11 @@ typedef struct {
     size_t (*size_callback)(STREAMFILE *, void*); /* size when custom reads make data smaller/bigger than underlying streamfile */
     int (*init_callback)(STREAMFILE*, void*); /* init the data struct members somehow, return >= 0 if ok */
     void (*close_callback)(STREAMFILE*, void*); /* close the data struct members somehow */
+    streamfile_stats_t stats;
 } IO_STREAMFILE;
 
 static size_t io_read(IO_STREAMFILE *streamfile, uint8_t *dst, off_t offset, size_t length) {
+    stats_read(&streamfile->stats, length);
     return streamfile->read_callback(streamfile->inner_sf, dst, offset, length, streamfile->data);
 }
 static size_t io_get_size(IO_STREAMFILE *streamfile) {
@@ -547,6 +1647,15 @@ static STREAMFILE* io_open(IO_STREAMFILE *streamfile, const char * const filenam
     STREAMFILE *new_inner_sf = streamfile->inner_sf->open(streamfile->inner_sf,filename,buffersize);
     return open_io_streamfile_ex(new_inner_sf, streamfile->data, streamfile->data_size, streamfile->read_callback, streamfile->size_callback, streamfile->init_callback, streamfile->close_callback);
 }
+static void io_get_stats(IO_STREAMFILE *streamfile, streamfile_stats_t *stats) {
+    get_stats_wrapper(streamfile->inner_sf, &streamfile->stats, stats);
+}
+static const char* io_get_name_ref(IO_STREAMFILE *streamfile) {
+    return get_streamfile_name_ref(streamfile->inner_sf); /* default */
+}
+static void io_release(IO_STREAMFILE *streamfile) {
+    release_streamfile_buffer(streamfile->inner_sf);
+}
 static void io_close(IO_STREAMFILE *streamfile) {
     if (streamfile->close_callback)
         streamfile->close_callback(streamfile->inner_sf, streamfile->data);
@@ -571,7 +1680,11 @@ STREAMFILE* open_io_streamfile_ex(STREAMFILE *streamfile, void *data, size_t dat
     this_sf->sf.get_name = (void*)io_get_name;
     this_sf->sf.open = (void*)io_open;
     this_sf->sf.close = (void*)io_close;
+    this_sf->sf.get_stats = (void*)io_get_stats;
+    this_sf->sf.release = (void*)io_release;
+    this_sf->sf.get_name_ref = streamfile->get_name_ref ? (void*)io_get_name_ref : NULL;
     this_sf->sf.stream_index = streamfile->stream_index;
+    this_sf->sf.probe_only = streamfile->probe_only;
 
     this_sf->inner_sf = streamfile;
     if (data) {
@@ -618,11 +1731,20 @@ typedef struct {
     STREAMFILE sf;
 
     STREAMFILE *inner_sf;
-    char fakename[PATH_LIMIT];
+    STREAMFILE *read_sf;    /* fused inner_sf */
+    sf_name *fakename;      /* shared with reopens */
+    streamfile_stats_t stats;
 } FAKENAME_STREAMFILE;
 
+static STREAMFILE* open_fakename_streamfile_by_name(STREAMFILE *streamfile, sf_name *fakename);
+
 static size_t fakename_read(FAKENAME_STREAMFILE *streamfile, uint8_t *dst, off_t offset, size_t length) {
-    return streamfile->inner_sf->read(streamfile->inner_sf, dst, offset, length); /* default */
+    stats_read(&streamfile->stats, length);
+    return streamfile->read_sf->read(streamfile->read_sf, dst, offset, length); /* default */
+}
+static const uint8_t* fakename_read_ptr(FAKENAME_STREAMFILE *streamfile, off_t offset, size_t length) {
+    stats_read(&streamfile->stats, length);
+    return streamfile->read_sf->read_ptr(streamfile->read_sf, offset, length); /* default */
 }
 static size_t fakename_get_size(FAKENAME_STREAMFILE *streamfile) {
     return streamfile->inner_sf->get_size(streamfile->inner_sf); /* default */
@@ -631,32 +1753,46 @@ static size_t fakename_get_offset(FAKENAME_STREAMFILE *streamfile) {
     return streamfile->inner_sf->get_offset(streamfile->inner_sf); /* default */
 }
 static void fakename_get_name(FAKENAME_STREAMFILE *streamfile, char *buffer, size_t length) {
-    strncpy(buffer,streamfile->fakename,length);
-    buffer[length-1]='\0';
+    sf_name_copy(streamfile->fakename, buffer, length);
+}
+static const char* fakename_get_name_ref(FAKENAME_STREAMFILE *streamfile) {
+    return streamfile->fakename->name;
 }
 static STREAMFILE* fakename_open(FAKENAME_STREAMFILE *streamfile, const char * const filename, size_t buffersize) {
     /* detect re-opening the file */
-    if (strcmp(filename, streamfile->fakename) == 0) {
+    if (sf_name_equals(streamfile->fakename, filename)) {
         STREAMFILE *new_inner_sf;
-        char original_filename[PATH_LIMIT];
+        STREAMFILE *new_sf;
 
-        streamfile->inner_sf->get_name(streamfile->inner_sf, original_filename, PATH_LIMIT);
-        new_inner_sf = streamfile->inner_sf->open(streamfile->inner_sf, original_filename, buffersize);
-        return open_fakename_streamfile(new_inner_sf, streamfile->fakename, NULL);
+        new_inner_sf = reopen_streamfile(streamfile->inner_sf, buffersize);
+        new_sf = open_fakename_streamfile_by_name(new_inner_sf, streamfile->fakename);
+        if (!new_sf)
+            close_streamfile(new_inner_sf);
+        return new_sf;
     }
     else {
         return streamfile->inner_sf->open(streamfile->inner_sf, filename, buffersize);
     }
 }
+static void fakename_get_stats(FAKENAME_STREAMFILE *streamfile, streamfile_stats_t *stats) {
+    get_stats_wrapper(streamfile->inner_sf, &streamfile->stats, stats);
+}
+static void fakename_prefetch(FAKENAME_STREAMFILE *streamfile, off_t offset, size_t length) {
+    prefetch_streamfile(streamfile->read_sf, offset, length); /* default */
+}
+static void fakename_release(FAKENAME_STREAMFILE *streamfile) {
+    release_streamfile_buffer(streamfile->inner_sf);
+}
 static void fakename_close(FAKENAME_STREAMFILE *streamfile) {
     streamfile->inner_sf->close(streamfile->inner_sf);
+    sf_name_unref(streamfile->fakename);
     free(streamfile);
 }
 
-STREAMFILE* open_fakename_streamfile(STREAMFILE *streamfile, const char *fakename, const char *fakeext) {
+static STREAMFILE* open_fakename_streamfile_by_name(STREAMFILE *streamfile, sf_name *fakename) {
     FAKENAME_STREAMFILE *this_sf = NULL;
 
-    if (!streamfile || (!fakename && !fakeext)) return NULL;
+    if (!streamfile || !fakename) return NULL;
 
     this_sf = calloc(1,sizeof(FAKENAME_STREAMFILE));
     if (!this_sf) return NULL;
@@ -668,28 +1804,57 @@ STREAMFILE* open_fakename_streamfile(STREAMFILE *streamfile, const char *fakenam
     this_sf->sf.get_name = (void*)fakename_get_name;
     this_sf->sf.open = (void*)fakename_open;
     this_sf->sf.close = (void*)fakename_close;
+    this_sf->sf.read_ptr = streamfile->read_ptr ? (void*)fakename_read_ptr : NULL;
+    this_sf->sf.get_stats = (void*)fakename_get_stats;
+    this_sf->sf.release = (void*)fakename_release;
+    this_sf->sf.get_name_ref = (void*)fakename_get_name_ref;
+    this_sf->sf.prefetch = streamfile->prefetch ? (void*)fakename_prefetch : NULL;
     this_sf->sf.stream_index = streamfile->stream_index;
+    this_sf->sf.probe_only = streamfile->probe_only;
 
     this_sf->inner_sf = streamfile;
+    this_sf->read_sf = get_fused_read_sf(streamfile, NULL);
+    this_sf->fakename = sf_name_ref(fakename);
+
+    return &this_sf->sf;
+}
+
+/* copies passed name or retains current, and swaps extension if expected */
+static sf_name* get_fakename(STREAMFILE *streamfile, const char *fakename, const char *fakeext) {
+    char name[PATH_LIMIT];
 
-    /* copy passed name or retain current, and swap extension if expected */
     if (fakename) {
-        strcpy(this_sf->fakename,fakename);
+        strncpy(name, fakename, sizeof(name));
+        name[sizeof(name) - 1] = '\0';
     } else {
-        streamfile->get_name(streamfile, this_sf->fakename, PATH_LIMIT);
+        streamfile->get_name(streamfile, name, sizeof(name));
     }
 
     if (fakeext) {
-        char* ext = strrchr(this_sf->fakename,'.');
+        char* ext = strrchr(name,'.');
         if (ext != NULL) {
             ext[1] = '\0'; /* truncate past dot */
         } else {
-            strcat(this_sf->fakename, "."); /* no extension = add dot */
+            strcat(name, "."); /* no extension = add dot */
         }
-        strcat(this_sf->fakename, fakeext);
+        strcat(name, fakeext);
     }
 
-    return &this_sf->sf;
+    return sf_name_new(name);
+}
+
+STREAMFILE* open_fakename_streamfile(STREAMFILE *streamfile, const char *fakename, const char *fakeext) {
+    sf_name *new_name;
+    STREAMFILE *new_sf;
+
+    if (!streamfile || (!fakename && !fakeext)) return NULL;
+
+    new_name = get_fakename(streamfile, fakename, fakeext);
+    if (!new_name) return NULL;
+
+    new_sf = open_fakename_streamfile_by_name(streamfile, new_name);
+    sf_name_unref(new_name); /* kept by the streamfile */
+    return new_sf;
 }
 STREAMFILE* open_fakename_streamfile_f(STREAMFILE *streamfile, const char *fakename, const char *fakeext) {
     STREAMFILE *new_sf = open_fakename_streamfile(streamfile, fakename, fakeext);
@@ -698,6 +1863,178 @@ STREAMFILE* open_fakename_streamfile_f(STREAMFILE *streamfile, const char *faken
     return new_sf;
 }
 
+/* **************************************************** */
+
+/* reader shared by a slice's reopens, so channels of a subfile don't need a buffer each (not thread-safe) */
+typedef struct {
+    STREAMFILE *inner_sf;   /* reopened parent */
+    int refs;
+} SLICE_SOURCE;
+
+typedef struct {
+    STREAMFILE sf;
+
+    STREAMFILE *inner_sf;   /* parent (not closed) in the first slice, source's in reopens */
+    SLICE_SOURCE *source;   /* set on the first reopen */
+    sf_name *name;          /* shared with reopens */
+    off_t start;
+    size_t size;
+    STREAMFILE *read_sf;    /* fused inner_sf */
+    off_t read_start;       /* start in read_sf */
+    streamfile_stats_t stats;
+} SLICE_STREAMFILE;
+
+static STREAMFILE* open_slice_streamfile_by_name(STREAMFILE *streamfile, SLICE_SOURCE *source, sf_name *name, off_t start, size_t size);
+
+static size_t slice_read(SLICE_STREAMFILE *streamfile, uint8_t *dst, off_t offset, size_t length) {
+    size_t slice_length = length > (streamfile->size - offset) ? (streamfile->size - offset) : length;
+    stats_read(&streamfile->stats, length);
+    return streamfile->read_sf->read(streamfile->read_sf, dst, streamfile->read_start + offset, slice_length);
+}
+static const uint8_t* slice_read_ptr(SLICE_STREAMFILE *streamfile, off_t offset, size_t length) {
+    if (offset < 0 || offset + length > streamfile->size)
+        return NULL;
+    stats_read(&streamfile->stats, length);
+    return streamfile->read_sf->read_ptr(streamfile->read_sf, streamfile->read_start + offset, length);
+}
+static size_t slice_get_size(SLICE_STREAMFILE *streamfile) {
+    return streamfile->size;
+}
+static off_t slice_get_offset(SLICE_STREAMFILE *streamfile) {
+    return streamfile->inner_sf->get_offset(streamfile->inner_sf) - streamfile->start;
+}
+static void slice_get_name(SLICE_STREAMFILE *streamfile, char *buffer, size_t length) {
+    sf_name_copy(streamfile->name, buffer, length);
+}
+static const char* slice_get_name_ref(SLICE_STREAMFILE *streamfile) {
+    return streamfile->name->name;
+}
+static STREAMFILE* slice_open(SLICE_STREAMFILE *streamfile, const char * const filename, size_t buffersize) {
+    if (!filename)
+        return NULL;
+
+    /* other files (companions) */
+    if (!sf_name_equals(streamfile->name, filename))
+        return streamfile->inner_sf->open(streamfile->inner_sf, filename, buffersize);
+
+    /* reopens read the parent through a single reader (the first slice's parent isn't ours to keep) */
+    if (!streamfile->source) {
+        SLICE_SOURCE *source = calloc(1, sizeof(SLICE_SOURCE));
+        if (!source) return NULL;
+
+        source->inner_sf = reopen_streamfile(streamfile->inner_sf, buffersize);
+        if (!source->inner_sf) {
+            free(source);
+            return NULL;
+        }
+        source->refs = 1;
+        streamfile->source = source;
+    }
+
+    return open_slice_streamfile_by_name(streamfile->source->inner_sf, streamfile->source, streamfile->name, streamfile->start, streamfile->size);
+}
+static void slice_get_stats(SLICE_STREAMFILE *streamfile, streamfile_stats_t *stats) {
+    get_stats_wrapper(streamfile->inner_sf, &streamfile->stats, stats);
+}
+static void slice_prefetch(SLICE_STREAMFILE *streamfile, off_t offset, size_t length) {
+    if (offset >= streamfile->size)
+        return;
+    if (length > streamfile->size - offset)
+        length = streamfile->size - offset;
+    prefetch_streamfile(streamfile->read_sf, streamfile->read_start + offset, length);
+}
+static void slice_release(SLICE_STREAMFILE *streamfile) {
+    release_streamfile_buffer(streamfile->inner_sf);
+}
+static void slice_close(SLICE_STREAMFILE *streamfile) {
+    SLICE_SOURCE *source = streamfile->source;
+
+    if (source) {
+        source->refs--;
+        if (source->refs == 0) {
+            close_streamfile(source->inner_sf);
+            free(source);
+        }
+    }
+    sf_name_unref(streamfile->name);
+    free(streamfile);
+}
+
+static STREAMFILE* open_slice_streamfile_by_name(STREAMFILE *streamfile, SLICE_SOURCE *source, sf_name *name, off_t start, size_t size) {
+    SLICE_STREAMFILE *this_sf = NULL;
+
+    this_sf = calloc(1,sizeof(SLICE_STREAMFILE));
+    if (!this_sf) return NULL;
+
+    /* set callbacks and internals */
+    this_sf->sf.read = (void*)slice_read;
+    this_sf->sf.get_size = (void*)slice_get_size;
+    this_sf->sf.get_offset = (void*)slice_get_offset;
+    this_sf->sf.get_name = (void*)slice_get_name;
+    this_sf->sf.open = (void*)slice_open;
+    this_sf->sf.close = (void*)slice_close;
+    this_sf->sf.read_ptr = streamfile->read_ptr ? (void*)slice_read_ptr : NULL;
+    this_sf->sf.get_stats = (void*)slice_get_stats;
+    this_sf->sf.release = (void*)slice_release;
+    this_sf->sf.get_name_ref = (void*)slice_get_name_ref;
+    this_sf->sf.prefetch = streamfile->prefetch ? (void*)slice_prefetch : NULL;
+    this_sf->sf.stream_index = streamfile->stream_index;
+    this_sf->sf.probe_only = streamfile->probe_only;
+
+    this_sf->inner_sf = streamfile;
+    this_sf->source = source;
+    if (source)
+        source->refs++;
+    this_sf->name = sf_name_ref(name);
+    this_sf->start = start;
+    this_sf->size = size;
+    this_sf->read_start = start;
+    this_sf->read_sf = get_fused_read_sf(streamfile, &this_sf->read_start);
+
+    return &this_sf->sf;
+}
+
+STREAMFILE* open_slice_streamfile(STREAMFILE *streamfile, off_t start, size_t size, const char *fakeext) {
+    sf_name *name;
+    STREAMFILE *new_sf;
+
+    if (!streamfile || size == 0) return NULL;
+    if (start + size > get_streamfile_size(streamfile)) return NULL;
+
+    if (fakeext) {
+        name = get_fakename(streamfile, NULL, fakeext);
+    }
+    else {
+        char filename[PATH_LIMIT];
+        streamfile->get_name(streamfile, filename, sizeof(filename));
+        name = sf_name_new(filename);
+    }
+    if (!name) return NULL;
+
+    new_sf = open_slice_streamfile_by_name(streamfile, NULL, name, start, size);
+    sf_name_unref(name); /* kept by the streamfile */
+    return new_sf;
+}
+
+static STREAMFILE* get_fused_read_sf(STREAMFILE *sf, off_t *p_start) {
+    if (sf->read == (void*)wrap_read)
+        return ((WRAP_STREAMFILE*)sf)->read_sf;
+    if (sf->read == (void*)fakename_read)
+        return ((FAKENAME_STREAMFILE*)sf)->read_sf;
+    if (p_start && sf->read == (void*)clamp_read) {
+        CLAMP_STREAMFILE *clamp_sf = (CLAMP_STREAMFILE*)sf;
+        *p_start += clamp_sf->read_start;
+        return clamp_sf->read_sf;
+    }
+    if (p_start && sf->read == (void*)slice_read) {
+        SLICE_STREAMFILE *slice_sf = (SLICE_STREAMFILE*)sf;
+        *p_start += slice_sf->read_start;
+        return slice_sf->read_sf;
+    }
+    return sf;
+}
+
+
 /* **************************************************** */
 
 typedef struct {
@@ -706,37 +2043,60 @@ typedef struct {
     STREAMFILE **inner_sfs;
     size_t inner_sfs_size;
     size_t *sizes;
+    off_t *starts;          /* offset of each segment (sum of previous sizes) */
+    int last_segment;       /* segment of the last read, checked first */
     off_t size;
     off_t offset;
+    streamfile_stats_t stats;
 } MULTIFILE_STREAMFILE;
 
+/* finds the segment that contains offset (must be < size) */
+static int multifile_find_segment(MULTIFILE_STREAMFILE *streamfile, off_t offset) {
+    int lo, hi, segment;
+
+    segment = streamfile->last_segment;
+    if (offset >= streamfile->starts[segment] && offset < streamfile->starts[segment] + streamfile->sizes[segment])
+        return segment;
+
+    /* last segment starting at or before offset (so empty segments are skipped) */
+    lo = 0;
+    hi = streamfile->inner_sfs_size - 1;
+    segment = 0;
+    while (lo <= hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (streamfile->starts[mid] <= offset) {
+            segment = mid;
+            lo = mid + 1;
+        }
+        else {
+            hi = mid - 1;
+        }
+    }
+
+    return segment;
+}
+
 static size_t multifile_read(MULTIFILE_STREAMFILE *streamfile, uint8_t *dst, off_t offset, size_t length) {
-    int i, segment = 0;
-    off_t segment_offset = 0;
+    int segment;
+    off_t segment_offset;
     size_t done = 0;
 
-    if (offset > streamfile->size) {
+    stats_read(&streamfile->stats, length);
+
+    if (offset < 0 || offset >= streamfile->size) {
         streamfile->offset = streamfile->size;
         return 0;
     }
 
     /* map external offset to multifile offset */
-    for (i = 0; i < streamfile->inner_sfs_size; i++) {
-        size_t segment_size = streamfile->sizes[i];
-        /* check if offset falls in this segment */
-        if (offset >= segment_offset && offset < segment_offset + segment_size) {
-            segment = i;
-            segment_offset = offset - segment_offset;
-            break;
-        }
-
-        segment_offset += segment_size;
-    }
+    segment = multifile_find_segment(streamfile, offset);
+    segment_offset = offset - streamfile->starts[segment];
 
     /* reads can span multiple segments */
     while(done < length) {
         if (segment >= streamfile->inner_sfs_size) /* over last segment, not fully done */
             break;
+        streamfile->last_segment = segment;
         /* reads over segment size are ok, will return smaller value and continue next segment */
         done += streamfile->inner_sfs[segment]->read(streamfile->inner_sfs[segment], dst + done, segment_offset, length - done);
         segment++;
@@ -792,6 +2152,31 @@ fail:
     free(new_inner_sfs);
     return NULL;
 }
+static void multifile_get_stats(MULTIFILE_STREAMFILE *streamfile, streamfile_stats_t *stats) {
+    int i;
+    for (i = 0; i < streamfile->inner_sfs_size; i++) {
+        streamfile_stats_t inner;
+        get_streamfile_stats(streamfile->inner_sfs[i], &inner);
+        stats->bytes_read += inner.bytes_read;
+        stats->buffer_hits += inner.buffer_hits;
+        stats->buffer_misses += inner.buffer_misses;
+        stats->rebuffers_back += inner.rebuffers_back;
+        stats->read_time_us += inner.read_time_us;
+        stats->buffer_size += inner.buffer_size;
+        stats->buffer_peak += inner.buffer_peak;
+    }
+    stats->read_calls = streamfile->stats.read_calls;
+    stats->bytes_requested = streamfile->stats.bytes_requested;
+}
+static const char* multifile_get_name_ref(MULTIFILE_STREAMFILE *streamfile) {
+    return get_streamfile_name_ref(streamfile->inner_sfs[0]);
+}
+static void multifile_release(MULTIFILE_STREAMFILE *streamfile) {
+    int i;
+    for (i = 0; i < streamfile->inner_sfs_size; i++) {
+        release_streamfile_buffer(streamfile->inner_sfs[i]);
+    }
+}
 static void multifile_close(MULTIFILE_STREAMFILE *streamfile) {
     int i;
     for (i = 0; i < streamfile->inner_sfs_size; i++) {
@@ -801,6 +2186,7 @@ static void multifile_close(MULTIFILE_STREAMFILE *streamfile) {
     }
     free(streamfile->inner_sfs);
     free(streamfile->sizes);
+    free(streamfile->starts);
     free(streamfile);
 }
 
@@ -824,17 +2210,24 @@ STREAMFILE* open_multifile_streamfile(STREAMFILE **streamfiles, size_t streamfil
     this_sf->sf.get_name = (void*)multifile_get_name;
     this_sf->sf.open = (void*)multifile_open;
     this_sf->sf.close = (void*)multifile_close;
+    this_sf->sf.get_stats = (void*)multifile_get_stats;
+    this_sf->sf.release = (void*)multifile_release;
+    this_sf->sf.get_name_ref = streamfiles[0]->get_name_ref ? (void*)multifile_get_name_ref : NULL;
     this_sf->sf.stream_index = streamfiles[0]->stream_index;
+    this_sf->sf.probe_only = streamfiles[0]->probe_only;
 
     this_sf->inner_sfs_size = streamfiles_size;
     this_sf->inner_sfs = calloc(streamfiles_size, sizeof(STREAMFILE*));
     if (!this_sf->inner_sfs) goto fail;
     this_sf->sizes = calloc(streamfiles_size, sizeof(size_t));
     if (!this_sf->sizes) goto fail;
+    this_sf->starts = calloc(streamfiles_size, sizeof(off_t));
+    if (!this_sf->starts) goto fail;
 
     for (i = 0; i < this_sf->inner_sfs_size; i++) {
         this_sf->inner_sfs[i] = streamfiles[i];
         this_sf->sizes[i] = streamfiles[i]->get_size(streamfiles[i]);
+        this_sf->starts[i] = this_sf->size;
         this_sf->size += this_sf->sizes[i];
     }
 
@@ -844,6 +2237,7 @@ fail:
     if (this_sf) {
         free(this_sf->inner_sfs);
         free(this_sf->sizes);
+        free(this_sf->starts);
     }
     free(this_sf);
     return NULL;
@@ -861,8 +2255,368 @@ STREAMFILE* open_multifile_streamfile_f(STREAMFILE **streamfiles, size_t streamf
 
 /* **************************************************** */
 
+#define PROBE_BUFFER_SIZE 0x4000
+
+typedef struct {
+    STREAMFILE sf;
+
+    STREAMFILE *inner_sf;
+    size_t filesize;        /* cached */
+    size_t probe_size;      /* valid bytes in probe */
+    uint8_t probe[PROBE_BUFFER_SIZE]; /* file start */
+    streamfile_stats_t stats;
+
+    /* budget for reads past probe (0 = no limit), see set_probe_streamfile_budget */
+    size_t budget_bytes;
+    uint64_t budget_deadline;
+    size_t budget_used;
+    int over_budget;
+} PROBE_STREAMFILE;
+
+static size_t probe_read_inner(PROBE_STREAMFILE *streamfile, uint8_t *dst, off_t offset, size_t length) {
+    size_t done;
+
+    if (!streamfile->budget_bytes && !streamfile->budget_deadline)
+        return streamfile->inner_sf->read(streamfile->inner_sf, dst, offset, length);
+
+    /* fail reads so the candidate bails like with a truncated file */
+    if (streamfile->over_budget)
+        return 0;
+    if (streamfile->budget_bytes && streamfile->budget_used + length > streamfile->budget_bytes) {
+        streamfile->over_budget = 1;
+        return 0;
+    }
+
+    done = streamfile->inner_sf->read(streamfile->inner_sf, dst, offset, length);
+    streamfile->budget_used += length;
+    if (streamfile->budget_deadline && get_streamfile_time_us() > streamfile->budget_deadline)
+        streamfile->over_budget = 1;
+    return done;
+}
+
+static size_t probe_read(PROBE_STREAMFILE *streamfile, uint8_t *dst, off_t offset, size_t length) {
+    size_t done = 0;
+
+    stats_read(&streamfile->stats, length);
+    if (offset < 0)
+        return 0;
+
+    if (offset < streamfile->probe_size) {
+        done = streamfile->probe_size - offset;
+        if (done > length)
+            done = length;
+        memcpy(dst, streamfile->probe + offset, done);
+        if (done == length)
+            return done;
+    }
+
+    return done + probe_read_inner(streamfile, dst + done, offset + done, length - done);
+}
+static const uint8_t* probe_read_ptr(PROBE_STREAMFILE *streamfile, off_t offset, size_t length) {
+    if (offset >= 0 && offset + length <= streamfile->probe_size) {
+        stats_read(&streamfile->stats, length);
+        return streamfile->probe + offset;
+    }
+    /* budgeted reads must go through probe_read */
+    if (!streamfile->inner_sf->read_ptr || streamfile->budget_bytes || streamfile->budget_deadline)
+        return NULL;
+    stats_read(&streamfile->stats, length);
+    return streamfile->inner_sf->read_ptr(streamfile->inner_sf, offset, length);
+}
+static size_t probe_get_size(PROBE_STREAMFILE *streamfile) {
+    return streamfile->filesize;
+}
+static off_t probe_get_offset(PROBE_STREAMFILE *streamfile) {
+    return streamfile->inner_sf->get_offset(streamfile->inner_sf); /* default */
+}
+static void probe_get_name(PROBE_STREAMFILE *streamfile, char *buffer, size_t length) {
+    streamfile->inner_sf->get_name(streamfile->inner_sf, buffer, length); /* default */
+}
+static STREAMFILE* probe_open(PROBE_STREAMFILE *streamfile, const char * const filename, size_t buffersize) {
+    return streamfile->inner_sf->open(streamfile->inner_sf, filename, buffersize); /* default (don't probe) */
+}
+static void probe_get_stats(PROBE_STREAMFILE *streamfile, streamfile_stats_t *stats) {
+    get_stats_wrapper(streamfile->inner_sf, &streamfile->stats, stats);
+}
+static const char* probe_get_name_ref(PROBE_STREAMFILE *streamfile) {
+    return get_streamfile_name_ref(streamfile->inner_sf); /* default */
+}
+static void probe_prefetch(PROBE_STREAMFILE *streamfile, off_t offset, size_t length) {
+    prefetch_streamfile(streamfile->inner_sf, offset, length); /* default */
+}
+static void probe_release(PROBE_STREAMFILE *streamfile) {
+    release_streamfile_buffer(streamfile->inner_sf);
+}
+static void probe_close(PROBE_STREAMFILE *streamfile) {
+    //streamfile->inner_sf->close(streamfile->inner_sf); /* don't close */
+    free(streamfile);
+}
+
+STREAMFILE* open_probe_streamfile(STREAMFILE *streamfile) {
+    PROBE_STREAMFILE *this_sf = NULL;
+
+    if (!streamfile) return NULL;
+
+    this_sf = calloc(1,sizeof(PROBE_STREAMFILE));
+    if (!this_sf) return NULL;
+
+    /* set callbacks and internals */
+    this_sf->sf.read = (void*)probe_read;
+    this_sf->sf.get_size = (void*)probe_get_size;
+    this_sf->sf.get_offset = (void*)probe_get_offset;
+    this_sf->sf.get_name = (void*)probe_get_name;
+    this_sf->sf.open = (void*)probe_open;
+    this_sf->sf.close = (void*)probe_close;
+    this_sf->sf.read_ptr = (void*)probe_read_ptr;
+    this_sf->sf.get_stats = (void*)probe_get_stats;
+    this_sf->sf.release = (void*)probe_release;
+    this_sf->sf.get_name_ref = streamfile->get_name_ref ? (void*)probe_get_name_ref : NULL;
+    this_sf->sf.prefetch = streamfile->prefetch ? (void*)probe_prefetch : NULL;
+    this_sf->sf.stream_index = streamfile->stream_index;
+    this_sf->sf.probe_only = streamfile->probe_only;
+
+    this_sf->inner_sf = streamfile;
+    this_sf->filesize = streamfile->get_size(streamfile);
+    this_sf->probe_size = streamfile->read(streamfile, this_sf->probe, 0, PROBE_BUFFER_SIZE);
+
+    return &this_sf->sf;
+}
+
+void set_probe_streamfile_budget(STREAMFILE *sf, size_t max_bytes, uint64_t max_us) {
+    PROBE_STREAMFILE *probe_sf = (PROBE_STREAMFILE*)sf;
+    if (!sf || sf->read != (void*)probe_read)
+        return;
+
+    probe_sf->budget_bytes = max_bytes;
+    probe_sf->budget_deadline = max_us ? get_streamfile_time_us() + max_us : 0;
+    probe_sf->budget_used = 0;
+    probe_sf->over_budget = 0;
+}
+
+int is_probe_streamfile_over_budget(STREAMFILE *sf, size_t *p_used) {
+    PROBE_STREAMFILE *probe_sf = (PROBE_STREAMFILE*)sf;
+    if (!sf || sf->read != (void*)probe_read)
+        return 0;
+
+    if (p_used)
+        *p_used = probe_sf->budget_used;
+    return probe_sf->over_budget;
+}
+
+/* **************************************************** */
+
+/* Companion files (.sth of a .str, .txth, dual stereo partners, etc) are often missing, and each failed
+ * open may be a network round trip. Keep which files exist in the last few folders (when the host can
+ * list them) and recent failed opens, for a few seconds as folders may change.
+ * Only enabled with vgmstream_dir_cache_setup. */
+#define DIR_CACHE_FOLDERS   8
+#define DIR_CACHE_MISSING   64
+#define DIR_CACHE_TTL_US    (10 * 1000000ULL)
+
+typedef struct {
+    int used;
+    int listed;             /* 0 if the folder couldn't be listed (only failed opens are kept then) */
+    uint64_t key;           /* hash of the folder path */
+    uint64_t time_us;
+    uint64_t* names;        /* sorted hashes of the (lowercase) file names */
+    int count;
+    int capacity;
+} dir_cache_folder_t;
+
+typedef struct {
+    uint64_t key;           /* hash of the full path */
+    uint64_t time_us;
+} dir_cache_missing_t;
+
+static struct {
+    int enabled;
+    vgmstream_list_dir_t list_dir;
+    void* list_data;
+    dir_cache_folder_t folders[DIR_CACHE_FOLDERS];
+    int folder_next;
+    dir_cache_missing_t missing[DIR_CACHE_MISSING];
+    int missing_count;
+    int missing_next;
+    void (*lock)(void*);
+    void (*unlock)(void*);
+    void* lock_data;
+} dir_cache;
+
+enum { DIR_CACHE_UNKNOWN, DIR_CACHE_EXISTS, DIR_CACHE_NOT_FOUND, DIR_CACHE_UNLISTED };
+
+void vgmstream_dir_cache_setup(int enabled, vgmstream_list_dir_t list_dir, void* list_data,
+        void (*lock)(void*), void (*unlock)(void*), void* lock_data) {
+    int i;
+
+    for (i = 0; i < DIR_CACHE_FOLDERS; i++) {
+        free(dir_cache.folders[i].names);
+    }
+    memset(&dir_cache, 0, sizeof(dir_cache));
+
+    dir_cache.enabled = enabled;
+    dir_cache.list_dir = list_dir;
+    dir_cache.list_data = list_data;
+    dir_cache.lock = lock;
+    dir_cache.unlock = unlock;
+    dir_cache.lock_data = lock_data;
+}
+
+static uint64_t dir_cache_hash(const char* str, size_t length, int lowercase) {
+    uint64_t hash = 0xCBF29CE484222325ULL; /* FNV-1a */
+    size_t i;
+    for (i = 0; i < length; i++) {
+        uint8_t c = (uint8_t)str[i];
+        if (lowercase && c >= 'A' && c <= 'Z')
+            c += 0x20;
+        hash = (hash ^ c) * 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+static int dir_cache_compare(const void* a, const void* b) {
+    uint64_t key_a = *(const uint64_t*)a;
+    uint64_t key_b = *(const uint64_t*)b;
+    return key_a < key_b ? -1 : key_a > key_b ? 1 : 0;
+}
+
+static void dir_cache_lock(void) {
+    if (dir_cache.lock)
+        dir_cache.lock(dir_cache.lock_data);
+}
+
+static void dir_cache_unlock(void) {
+    if (dir_cache.unlock)
+        dir_cache.unlock(dir_cache.lock_data);
+}
+
+/* callback for vgmstream_list_dir_t */
+static void dir_cache_add_name(void* list, const char* name) {
+    dir_cache_folder_t* folder = list;
+
+    if (!folder->listed)
+        return;
+    if (folder->count == folder->capacity) {
+        int capacity = folder->capacity ? folder->capacity * 2 : 64;
+        uint64_t* names = realloc(folder->names, capacity * sizeof(uint64_t));
+        if (!names) {
+            folder->listed = 0; /* incomplete lists can't say a file is missing */
+            return;
+        }
+        folder->names = names;
+        folder->capacity = capacity;
+    }
+    folder->names[folder->count++] = dir_cache_hash(name, strlen(name), 1);
+}
+
+/* finds what's known about a file (cache must be locked) */
+static int dir_cache_find(uint64_t folder_key, uint64_t name_key, uint64_t path_key, uint64_t now) {
+    int i;
+
+    for (i = 0; i < dir_cache.missing_count; i++) {
+        dir_cache_missing_t* missing = &dir_cache.missing[i];
+        if (missing->key == path_key && now - missing->time_us < DIR_CACHE_TTL_US)
+            return DIR_CACHE_NOT_FOUND;
+    }
+
+    for (i = 0; i < DIR_CACHE_FOLDERS; i++) {
+        dir_cache_folder_t* folder = &dir_cache.folders[i];
+        if (!folder->used || folder->key != folder_key || now - folder->time_us >= DIR_CACHE_TTL_US)
+            continue;
+        if (!folder->listed)
+            return DIR_CACHE_UNLISTED;
+        /* names are case insensitive here, so files only differing in case are tried */
+        if (bsearch(&name_key, folder->names, folder->count, sizeof(uint64_t), dir_cache_compare))
+            return DIR_CACHE_EXISTS;
+        return DIR_CACHE_NOT_FOUND;
+    }
+
+    return DIR_CACHE_UNKNOWN;
+}
+
+/* lists a folder (outside the lock, as it may be slow) and keeps it */
+static void dir_cache_list(const char* pathname, size_t folder_length, uint64_t folder_key, uint64_t now) {
+    char path[PATH_LIMIT];
+    dir_cache_folder_t folder = {0};
+    dir_cache_folder_t* slot;
+
+    if (folder_length >= sizeof(path))
+        return;
+    memcpy(path, pathname, folder_length); /* keeps the separator */
+    path[folder_length] = '\0';
+
+    folder.used = 1;
+    folder.listed = 1;
+    folder.key = folder_key;
+    folder.time_us = now;
+    if (!dir_cache.list_dir(dir_cache.list_data, path, dir_cache_add_name, &folder))
+        folder.listed = 0;
+    if (!folder.listed) {
+        free(folder.names);
+        folder.names = NULL;
+        folder.count = folder.capacity = 0;
+    }
+    else if (folder.count > 1) {
+        qsort(folder.names, folder.count, sizeof(uint64_t), dir_cache_compare);
+    }
+
+    dir_cache_lock();
+    slot = &dir_cache.folders[dir_cache.folder_next];
+    free(slot->names);
+    *slot = folder;
+    dir_cache.folder_next = (dir_cache.folder_next + 1) % DIR_CACHE_FOLDERS;
+    dir_cache_unlock();
+}
+
+static void dir_cache_add_missing(uint64_t path_key, uint64_t now) {
+    dir_cache_lock();
+    dir_cache.missing[dir_cache.missing_next].key = path_key;
+    dir_cache.missing[dir_cache.missing_next].time_us = now;
+    dir_cache.missing_next = (dir_cache.missing_next + 1) % DIR_CACHE_MISSING;
+    if (dir_cache.missing_count < DIR_CACHE_MISSING)
+        dir_cache.missing_count++;
+    dir_cache_unlock();
+}
+
 STREAMFILE* open_streamfile(STREAMFILE *streamfile, const char *pathname) {
-    return streamfile->open(streamfile, pathname, STREAMFILE_DEFAULT_BUFFER_SIZE);
+    STREAMFILE *new_sf;
+    const char *name, *slash;
+    uint64_t folder_key, name_key, path_key, now;
+    int state;
+
+    if (!dir_cache.enabled)
+        return streamfile->open(streamfile, pathname, STREAMFILE_DEFAULT_BUFFER_SIZE);
+
+    /* hosts may mix separators (ex. URLs in Windows) */
+    name = strrchr(pathname, '/');
+    slash = strrchr(pathname, '\\');
+    if (slash && (!name || slash > name))
+        name = slash;
+    name = name ? name + 1 : pathname;
+
+    folder_key = dir_cache_hash(pathname, name - pathname, 0);
+    name_key = dir_cache_hash(name, strlen(name), 1);
+    path_key = dir_cache_hash(pathname, strlen(pathname), 0);
+    now = get_streamfile_time_us();
+
+    dir_cache_lock();
+    state = dir_cache_find(folder_key, name_key, path_key, now);
+    dir_cache_unlock();
+
+    if (state == DIR_CACHE_UNKNOWN && dir_cache.list_dir && name != pathname) {
+        dir_cache_list(pathname, name - pathname, folder_key, now);
+
+        dir_cache_lock();
+        state = dir_cache_find(folder_key, name_key, path_key, now);
+        dir_cache_unlock();
+    }
+
+    if (state == DIR_CACHE_NOT_FOUND)
+        return NULL;
+
+    new_sf = streamfile->open(streamfile, pathname, STREAMFILE_DEFAULT_BUFFER_SIZE);
+    if (!new_sf)
+        dir_cache_add_missing(path_key, now);
+    return new_sf;
 }
 
 STREAMFILE* open_streamfile_by_ext(STREAMFILE *streamfile, const char *ext) {
@@ -882,7 +2636,7 @@ STREAMFILE* open_streamfile_by_ext(STREAMFILE *streamfile, const char *ext) {
         strcpy(filename + filename_len - fileext_len, ext);
     }
 
-    return streamfile->open(streamfile, filename, STREAMFILE_DEFAULT_BUFFER_SIZE);
+    return open_streamfile(streamfile, filename);
 }
 
 STREAMFILE* open_streamfile_by_filename(STREAMFILE *streamfile, const char * filename) {
@@ -931,18 +2685,23 @@ STREAMFILE* open_streamfile_by_filename(STREAMFILE *streamfile, const char * fil
         strcpy(fullname, filename);
     }
 
-    return streamfile->open(streamfile, fullname, STREAMFILE_DEFAULT_BUFFER_SIZE);
+    return open_streamfile(streamfile, fullname);
 }
 
 STREAMFILE* reopen_streamfile(STREAMFILE *streamfile, size_t buffer_size) {
     char pathname[PATH_LIMIT];
+    const char *name;
 
     if (!streamfile) return NULL;
 
     if (buffer_size == 0)
         buffer_size = STREAMFILE_DEFAULT_BUFFER_SIZE;
-    streamfile->get_name(streamfile,pathname,sizeof(pathname));
-    return streamfile->open(streamfile,pathname,buffer_size);
+    name = get_streamfile_name_ref(streamfile);
+    if (!name) {
+        streamfile->get_name(streamfile,pathname,sizeof(pathname));
+        name = pathname;
+    }
+    return streamfile->open(streamfile,name,buffer_size);
 }
 
 /* **************************************************** */
@@ -1233,11 +2992,14 @@ void get_streamfile_name(STREAMFILE *streamFile, char * buffer, size_t size) {
 }
 /* copies the filename without path */
 void get_streamfile_filename(STREAMFILE *streamFile, char * buffer, size_t size) {
-    char foldername[PATH_LIMIT];
-    const char *path;
-
+    char pathname[PATH_LIMIT];
+    const char *foldername, *path;
 
-    streamFile->get_name(streamFile,foldername,sizeof(foldername));
+    foldername = get_streamfile_name_ref(streamFile);
+    if (!foldername) {
+        streamFile->get_name(streamFile,pathname,sizeof(pathname));
+        foldername = pathname;
+    }
 
     //todo Windows CMD accepts both \\ and /, better way to handle this?
     path = strrchr(foldername,'\\');
@@ -61,9 +61,25 @@
  * Value can be adjusted freely but 8k is a good enough compromise. */
 #define STREAMFILE_DEFAULT_BUFFER_SIZE 0x8000
 
+/* most files are smaller, and reading them at once is faster than buffering */
+#define MEMORY_STREAMFILE_MAX_SIZE 0x400000
+
 /* struct representing a file with callbacks. Code should use STREAMFILEs and not std C functions
  * to do file operations, as plugins may need to provide their own callbacks.
  * Reads from arbitrary offsets, meaning internally may need fseek equivalents during reads. */
+/* I/O counters of a STREAMFILE, see get_streamfile_stats */
+typedef struct {
+    uint64_t read_calls;        /* reads requested to this streamfile */
+    uint64_t bytes_requested;   /* bytes asked by those reads */
+    uint64_t bytes_read;        /* bytes read from the actual file/device */
+    uint64_t buffer_hits;       /* reads fully served from buffer/memory */
+    uint64_t buffer_misses;     /* buffer refills */
+    uint64_t rebuffers_back;    /* refills caused by reading before the buffer */
+    uint64_t read_time_us;      /* time spent in the actual file/device reads */
+    uint64_t buffer_size;       /* buffer memory held now (0 while idle/released) */
+    uint64_t buffer_peak;       /* most buffer memory held at once */
+} streamfile_stats_t;
+
 typedef struct _STREAMFILE {
     size_t (*read)(struct _STREAMFILE *, uint8_t * dst, off_t offset, size_t length);
     size_t (*get_size)(struct _STREAMFILE *);
@@ -73,11 +89,31 @@ typedef struct _STREAMFILE {
     struct _STREAMFILE * (*open)(struct _STREAMFILE *, const char * const filename, size_t buffersize);
     void (*close)(struct _STREAMFILE *);
 
+    /* Optional (may be NULL): pointer to length bytes at offset if resident in the streamfile's
+     * memory (buffer, mapping), else NULL. Valid until the next read. Use read_streamfile_ptr. */
+    const uint8_t * (*read_ptr)(struct _STREAMFILE *, off_t offset, size_t length);
+    /* Optional (may be NULL): fills this streamfile's I/O counters. Wrappers report calls/requested
+     * bytes as seen by their callers and the rest from the streamfiles they read. */
+    void (*get_stats)(struct _STREAMFILE *, streamfile_stats_t *stats);
+    /* Optional (may be NULL): gives back the streamfile's buffer (to the buffer pool) while it's not
+     * going to be read for a while, retaken on the next read. Use release_streamfile_buffer. */
+    void (*release)(struct _STREAMFILE *);
+    /* Optional (may be NULL): the name get_name copies, kept by the streamfile while open. Reopens
+     * of the same file usually share it, so equal pointers mean equal names. Use get_streamfile_name_ref. */
+    const char * (*get_name_ref)(struct _STREAMFILE *);
+    /* Optional (may be NULL): hint that length bytes at offset will be read soon, so the streamfile
+     * may start loading them in the background. Never waits for them. Use prefetch_streamfile. */
+    void (*prefetch)(struct _STREAMFILE *, off_t offset, size_t length);
+
 
     /* Substream selection for files with subsongs. Manually used in metas if supported.
      * Not ideal here, but it's the simplest way to pass to all init_vgmstream_x functions. */
     int stream_index; /* 0=default/auto (first), 1=first, N=Nth */
 
+    /* Metadata-only open (ex. plugins reading tags): channels share a single reopened streamfile
+     * instead of one buffer each, so the VGMSTREAM is meant for info only. Passed like stream_index. */
+    int probe_only;
+
 } STREAMFILE;
 
 /* All open_ fuctions should be safe to call with wrong/null parameters.
@@ -91,11 +127,54 @@ STREAMFILE* open_stdio_streamfile(const char *filename);
 /* Opens a standard STREAMFILE from a pre-opened FILE. */
 STREAMFILE* open_stdio_streamfile_by_file(FILE *file, const char *filename);
 
+/* File callbacks of a host/plugin (its own VFS), see open_host_streamfile. */
+typedef struct {
+    /* moves to offset, returns 0 on success */
+    int (*seek)(void *handle, off_t offset);
+    /* reads up to length bytes from the current position, returns bytes read */
+    size_t (*read)(void *handle, uint8_t *dst, size_t length);
+    size_t (*get_size)(void *handle);
+    /* opens a file by name (reopens of the same file and companion files), from an opened one, or
+     * NULL if not found. Must be a new handle with its own position. */
+    void* (*open)(void *handle, const char *filename);
+    void (*close)(void *handle);
+    /* Optional (may be NULL): modification mark (ex. mtime) to share pages with the page cache, 0 if unknown */
+    uint64_t (*get_stamp)(void *handle);
+    /* Optional (may be NULL): starts loading a range in the background, never waits */
+    void (*prefetch)(void *handle, off_t offset, size_t length);
+} host_streamfile_io_t;
+
+/* Opens a STREAMFILE over a host's file handle (taken, closed on failure), so plugins only pass
+ * their file callbacks and get the same buffering, buffer pool, page cache, stats and (with
+ * prefetch) read-ahead as stdio. Seeks only happen when reads aren't sequential. The handle may be
+ * NULL for virtual files (see vgmstream_is_virtual_filename). Buffer size 0 uses the default.
+ * io must stay valid while the streamfile and its reopens are open. */
+STREAMFILE* open_host_streamfile(void *handle, const char *filename, const host_streamfile_io_t *io, size_t buffer_size);
+
+/* Opens a STREAMFILE that reads from a memory mapped file, for local files. Reopens of the same
+ * file share the mapping (not thread-safe). Falls back to open_stdio_streamfile if mapping fails
+ * (through open_memory_streamfile_f with MEMORY_STREAMFILE_MAX_SIZE). */
+STREAMFILE* open_mmap_streamfile(const char *filename);
+
+/* Opens a STREAMFILE that reads the whole file into memory at once if it's up to max_size bytes,
+ * for small files on slow IO. Reopens of the same file (channels) share the data (not thread-safe)
+ * and other files (companions) are opened the same way. Takes the passed streamfile, and returns
+ * it as-is if bigger or on errors. */
+STREAMFILE* open_memory_streamfile_f(STREAMFILE *streamfile, size_t max_size);
+
 /* Opens a STREAMFILE that does buffered IO.
  * Can be used when the underlying IO may be slow (like when using custom IO).
  * Buffer size is optional. */
 STREAMFILE* open_buffer_streamfile(STREAMFILE *streamfile, size_t buffer_size);
 STREAMFILE* open_buffer_streamfile_f(STREAMFILE *streamfile, size_t buffer_size);
+/* Same, but the buffer grows on sequential reads and shrinks on random reads. Growth is limited
+ * by the global budget set with vgmstream_buffer_budget_setup (none by default). */
+STREAMFILE* open_buffer_streamfile_adaptive(STREAMFILE *streamfile);
+STREAMFILE* open_buffer_streamfile_adaptive_f(STREAMFILE *streamfile);
+/* Same, but refills start at interleave rows (row_size = interleave * channels, from row_start), so
+ * one buffer holds every channel's block and can be shared by all channels. NULL if row_size is too
+ * big for a single buffer. */
+STREAMFILE* open_interleave_buffer_streamfile(STREAMFILE *streamfile, off_t row_start, size_t row_size);
 
 /* Opens a STREAMFILE that doesn't close the underlying streamfile.
  * Calls to open won't wrap the new SF (assumes it needs to be closed).
@@ -108,6 +187,11 @@ STREAMFILE* open_wrap_streamfile_f(STREAMFILE *streamfile);
 STREAMFILE* open_clamp_streamfile(STREAMFILE *streamfile, off_t start, size_t size);
 STREAMFILE* open_clamp_streamfile_f(STREAMFILE *streamfile, off_t start, size_t size);
 
+/* Opens a STREAMFILE of a section of a larger streamfile, with the extension swapped to fakeext (optional).
+ * Doesn't close the passed streamfile, and its reopens (channels) share a single reopened parent rather
+ * than a buffer each (not thread-safe). For subfiles in big banks with many subsongs. */
+STREAMFILE* open_slice_streamfile(STREAMFILE *streamfile, off_t start, size_t size, const char *fakeext);
+
 /* Opens a STREAMFILE that uses custom IO for streamfile reads.
  * Can be used to modify data on the fly (ex. decryption), or even transform it from a format to another. 
  * Data is an optional state struct of some size what will be malloc+copied on open. */
@@ -131,6 +215,19 @@ STREAMFILE* open_fakename_streamfile_f(STREAMFILE *streamfile, const char * fake
 STREAMFILE* open_multifile_streamfile(STREAMFILE **streamfiles, size_t streamfiles_size);
 STREAMFILE* open_multifile_streamfile_f(STREAMFILE **streamfiles, size_t streamfiles_size);
 
+/* Opens a STREAMFILE that keeps the file start and size in memory, for format detection where every
+ * meta checks the header. Doesn't close the passed streamfile, and reopens return the inner's. */
+STREAMFILE* open_probe_streamfile(STREAMFILE *streamfile);
+
+/* Limits reads of a probe streamfile past the kept file start to max_bytes, and to max_us of time
+ * from now (0 = no limit for each). Once over, reads fail until the next call, so a detection
+ * candidate that walks big files bails like with a truncated one. Does nothing on other streamfiles. */
+void set_probe_streamfile_budget(STREAMFILE *sf, size_t max_bytes, uint64_t max_us);
+
+/* Returns 1 if a probe streamfile went over its budget since it was set, with the bytes read in p_used
+ * (may be NULL), 0 otherwise. */
+int is_probe_streamfile_over_budget(STREAMFILE *sf, size_t *p_used);
+
 /* Opens a STREAMFILE from a (path)+filename.
  * Just a wrapper, to avoid having to access the STREAMFILE's callbacks directly. */
 STREAMFILE* open_streamfile(STREAMFILE *streamfile, const char * pathname);
@@ -160,6 +257,38 @@ static inline size_t read_streamfile(uint8_t *dst, off_t offset, size_t length,
     return streamfile->read(streamfile, dst, offset,length);
 }
 
+/* Get length bytes at offset, pointing into the streamfile's memory when possible (no copy),
+ * or reading into buf otherwise (must hold length). Returned data is valid until the next read
+ * of the streamfile. Like read_streamfile, bytes past EOF are left untouched in buf. */
+static inline const uint8_t* read_streamfile_ptr(uint8_t *buf, off_t offset, size_t length, STREAMFILE *streamfile) {
+    if (streamfile->read_ptr) {
+        const uint8_t *ptr = streamfile->read_ptr(streamfile, offset, length);
+        if (ptr) return ptr;
+    }
+    streamfile->read(streamfile, buf, offset, length);
+    return buf;
+}
+
+/* Fills I/O counters (all 0 if the streamfile doesn't keep them). */
+void get_streamfile_stats(STREAMFILE *sf, streamfile_stats_t *stats);
+
+/* Gives back the buffer of an idle streamfile (see STREAMFILE.release). Pointers from
+ * read_streamfile_ptr are invalid after this. */
+void release_streamfile_buffer(STREAMFILE *sf);
+
+/* Name of the streamfile without copying it (see STREAMFILE.get_name_ref), or NULL if it
+ * doesn't keep one (use get_streamfile_name then). */
+const char* get_streamfile_name_ref(STREAMFILE *sf);
+
+/* Hints that a range will be read soon (see STREAMFILE.prefetch), ignored if unsupported. */
+void prefetch_streamfile(STREAMFILE *sf, off_t offset, size_t length);
+
+/* Memory of buffers held by open streamfiles and of idle ones kept by the buffer pool. */
+void streamfile_get_buffer_usage(size_t *held, size_t *pooled);
+
+/* Wall clock in microseconds, as used for read_time_us. */
+uint64_t get_streamfile_time_us(void);
+
 /* return file size */
 static inline size_t get_streamfile_size(STREAMFILE * streamfile) {
     return streamfile->get_size(streamfile);
@@ -260,33 +389,73 @@ static inline float    read_f32be_m(off_t offset, STREAMFILE *sf) {
     return sample_float;
 }
 #endif
-#if 0
-/* collection of callbacks for quick access */
-typedef struct sf_reader {
-    int32_t (*read_s32)(off_t,STREAMFILE*); //maybe s32
-    float (*read_f32)(off_t,STREAMFILE*);
-    /* ... */
+/* Windowed reader for header parsing. Fields are decoded from a local copy of a span of the file,
+ * refilled with a single read when a field falls outside, instead of one read call per field.
+ * Reads past EOF return -1 like read_32bitLE and such do.
+ *
+ * sf_reader r;
+ * sf_reader_init(&r, sf);
+ * value = sf_reader_u32le(&r, offset);
+ */
+#define SF_READER_BUFFER_SIZE 0x400
+
+typedef struct {
+    STREAMFILE *sf;
+    off_t offset;           /* window start */
+    size_t size;            /* valid bytes in window */
+    uint8_t buf[SF_READER_BUFFER_SIZE];
 } sf_reader;
 
-void init_reader(sf_reader *r, int big_endian);
-/* ... */
-void sf_reader_init(sf_reader *r, int big_endian) {
-    memset(r, 0, sizeof(sf_reader));
-    if (big_endian) {
-        r->read_s32 = read_s32be;
-        r->read_f32 = read_f32be;
-    }
-    else {
-        r->read_s32 = read_s32le;
-        r->read_f32 = read_f32le;
-    }
+void sf_reader_init(sf_reader *r, STREAMFILE *sf);
+
+/* refills the window at offset, for sf_reader_get */
+const uint8_t* sf_reader_refill(sf_reader *r, off_t offset, size_t size);
+
+/* pointer to size bytes at offset (valid until next call), or NULL if not all are readable */
+static inline const uint8_t* sf_reader_get(sf_reader *r, off_t offset, size_t size) {
+    if (offset >= r->offset && offset + size <= r->offset + r->size)
+        return r->buf + (offset - r->offset);
+    return sf_reader_refill(r, offset, size);
 }
-/* sf_reader r;
- * ...
- * sf_reader_init(&r, big_endian);
- * val = r.read_s32; //maybe r.s32?
+
+static inline int8_t   sf_reader_s8   (sf_reader *r, off_t offset) { const uint8_t *p = sf_reader_get(r, offset, 0x01); return p ? get_s8(p) : -1; }
+static inline uint8_t  sf_reader_u8   (sf_reader *r, off_t offset) { const uint8_t *p = sf_reader_get(r, offset, 0x01); return p ? get_u8(p) : -1; }
+static inline int16_t  sf_reader_s16le(sf_reader *r, off_t offset) { const uint8_t *p = sf_reader_get(r, offset, 0x02); return p ? get_s16le(p) : -1; }
+static inline uint16_t sf_reader_u16le(sf_reader *r, off_t offset) { const uint8_t *p = sf_reader_get(r, offset, 0x02); return p ? get_u16le(p) : -1; }
+static inline int16_t  sf_reader_s16be(sf_reader *r, off_t offset) { const uint8_t *p = sf_reader_get(r, offset, 0x02); return p ? get_s16be(p) : -1; }
+static inline uint16_t sf_reader_u16be(sf_reader *r, off_t offset) { const uint8_t *p = sf_reader_get(r, offset, 0x02); return p ? get_u16be(p) : -1; }
+static inline int32_t  sf_reader_s32le(sf_reader *r, off_t offset) { const uint8_t *p = sf_reader_get(r, offset, 0x04); return p ? get_s32le(p) : -1; }
+static inline uint32_t sf_reader_u32le(sf_reader *r, off_t offset) { const uint8_t *p = sf_reader_get(r, offset, 0x04); return p ? get_u32le(p) : -1; }
+static inline int32_t  sf_reader_s32be(sf_reader *r, off_t offset) { const uint8_t *p = sf_reader_get(r, offset, 0x04); return p ? get_s32be(p) : -1; }
+static inline uint32_t sf_reader_u32be(sf_reader *r, off_t offset) { const uint8_t *p = sf_reader_get(r, offset, 0x04); return p ? get_u32be(p) : -1; }
+
+/* Index of chunks (32b id + 32b size + data) in RIFF-like files, read in one pass over the chunk
+ * headers with a sf_reader, so parsers can go through (or look up) chunks without re-reading.
+ *
+ * sf_chunks chunks = {0};
+ * if (!sf_chunks_read(&chunks, &r, 0x0c, riff_end, file_size, 0, 1)) goto fail;
+ * fmt = sf_chunks_find(&chunks, 0x666d7420);
  */
-#endif
+#define SF_CHUNKS_MAX 256
+
+typedef struct {
+    uint32_t id;            /* FOURCC, read as big endian */
+    off_t offset;           /* chunk start (the id) */
+    size_t size;            /* data size as stored (without padding) */
+} sf_chunk;
+
+typedef struct {
+    sf_chunk chunk[SF_CHUNKS_MAX];
+    int count;
+} sf_chunks;
+
+/* Appends chunks from offset until max_offset. Sizes are LE or BE, and with pad odd sizes skip a
+ * padding byte (RIFF spec) when it fits in end_offset. Returns 0 if a chunk goes past end_offset
+ * or there are too many chunks. */
+int sf_chunks_read(sf_chunks *chunks, sf_reader *r, off_t offset, off_t max_offset, off_t end_offset, int big_endian, int pad);
+
+/* first chunk with that id, or NULL */
+const sf_chunk* sf_chunks_find(const sf_chunks *chunks, uint32_t id);
 #if 0  //todo improve + test + simplify code (maybe not inline?)
 static inline int read_s4h(off_t offset, STREAMFILE * streamfile) {
     uint8_t byte = read_u8(offset, streamfile);
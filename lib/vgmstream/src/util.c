@@ -1,6 +1,17 @@
 #include <string.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <time.h>
+#define VGM_ALLOC_IMPL /* real allocators below */
 #include "util.h"
+#include "vgmstream.h"
 #include "streamtypes.h"
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sched.h>
+#endif
 
 const char * filename_extension(const char * pathname) {
     const char * filename;
@@ -127,6 +138,200 @@ void swap_samples_le(sample_t *buf, int count) {
 
 /* length is maximum length of dst. dst will always be null-terminated if
  * length > 0 */
+/* flag: 0 = not run, 1 = running, 2 = done (atomic ops are also full barriers, so init's writes
+ * are visible once done is seen) */
+void vgm_once(vgm_once_t* flag, void (*init)(void)) {
+#ifdef _WIN32
+    if (InterlockedCompareExchange(flag, 2, 2) == 2)
+        return;
+    if (InterlockedCompareExchange(flag, 1, 0) == 0) {
+        init();
+        InterlockedExchange(flag, 2);
+        return;
+    }
+    while (InterlockedCompareExchange(flag, 2, 2) != 2) {
+        Sleep(0);
+    }
+#else
+    if (__sync_val_compare_and_swap(flag, 2, 2) == 2)
+        return;
+    if (__sync_bool_compare_and_swap(flag, 0, 1)) {
+        init();
+        __sync_val_compare_and_swap(flag, 1, 2);
+        return;
+    }
+    while (__sync_val_compare_and_swap(flag, 2, 2) != 2) {
+        sched_yield();
+    }
+#endif
+}
+
+/* atomic ops on longs, all full barriers */
+static long atomic_load_long(volatile long* value) {
+#ifdef _WIN32
+    return InterlockedCompareExchange(value, 0, 0);
+#else
+    return __sync_fetch_and_add(value, 0);
+#endif
+}
+
+static void atomic_store_long(volatile long* value, long desired) {
+#ifdef _WIN32
+    InterlockedExchange(value, desired);
+#else
+    long old;
+    do {
+        old = __sync_fetch_and_add(value, 0);
+    } while (!__sync_bool_compare_and_swap(value, old, desired));
+#endif
+}
+
+/* returns the value before adding */
+static long atomic_fetch_add_long(volatile long* value, long add) {
+#ifdef _WIN32
+    return InterlockedExchangeAdd(value, add);
+#else
+    return __sync_fetch_and_add(value, add);
+#endif
+}
+
+static int atomic_cas_long(volatile long* value, long expected, long desired) {
+#ifdef _WIN32
+    return InterlockedCompareExchange(value, desired, expected) == expected;
+#else
+    return __sync_bool_compare_and_swap(value, expected, desired);
+#endif
+}
+
+
+/* Debug log as a bounded queue of fixed lines (Vyukov style): each slot's sequence tells if it's free
+ * for write position N (seq == N) or holds the line of N (seq == N + 1). Producers claim the write
+ * position with a CAS only when its slot is free, so logging never waits: a full queue (drainer behind)
+ * drops the line. The single drainer passes lines in order and frees slots for the next lap. */
+#define VGM_LOG_SLOTS       64
+#define VGM_LOG_LINE_SIZE   256
+#define VGM_LOG_RATE        100 /* max lines per second, rest dropped */
+
+typedef struct {
+    volatile long seq;
+    char line[VGM_LOG_LINE_SIZE];
+} vgm_log_slot;
+
+static struct {
+    void (*callback)(const char* line, void* data);
+    void* data;
+    volatile long write_pos;
+    long read_pos;              /* drainer only */
+    volatile long draining;
+    volatile long dropped;
+    volatile long rate_second;
+    volatile long rate_count;
+    vgm_log_slot slots[VGM_LOG_SLOTS];
+} g_log;
+
+void vgmstream_log_setup(void (*callback)(const char* line, void* data), void* data) {
+    int i;
+
+    g_log.write_pos = 0;
+    g_log.read_pos = 0;
+    for (i = 0; i < VGM_LOG_SLOTS; i++) {
+        g_log.slots[i].seq = i;
+    }
+    g_log.data = data;
+    atomic_store_long((volatile long*)&g_log.draining, 0);
+    g_log.callback = callback;
+}
+
+void vgm_log(const char* fmt, ...) {
+    va_list args;
+    vgm_log_slot* slot;
+    long pos, second;
+    int len;
+
+    if (!g_log.callback) {
+        va_start(args, fmt);
+        vprintf(fmt, args);
+        va_end(args);
+        return;
+    }
+
+    /* rate limit (a racy second change may let a few extra lines through) */
+    second = (long)time(NULL);
+    if (atomic_load_long(&g_log.rate_second) != second) {
+        long old_second = atomic_load_long(&g_log.rate_second);
+        if (old_second != second && atomic_cas_long(&g_log.rate_second, old_second, second))
+            atomic_store_long(&g_log.rate_count, 0);
+    }
+    if (atomic_fetch_add_long(&g_log.rate_count, 1) >= VGM_LOG_RATE) {
+        atomic_fetch_add_long(&g_log.dropped, 1);
+        return;
+    }
+
+    /* claim a free slot */
+    pos = atomic_load_long(&g_log.write_pos);
+    while (1) {
+        long diff;
+
+        slot = &g_log.slots[(unsigned long)pos % VGM_LOG_SLOTS];
+        diff = atomic_load_long(&slot->seq) - pos;
+        if (diff == 0) {
+            if (atomic_cas_long(&g_log.write_pos, pos, pos + 1))
+                break;
+            pos = atomic_load_long(&g_log.write_pos);
+        }
+        else if (diff < 0) { /* full */
+            atomic_fetch_add_long(&g_log.dropped, 1);
+            return;
+        }
+        else { /* taken by another producer */
+            pos = atomic_load_long(&g_log.write_pos);
+        }
+    }
+
+    va_start(args, fmt);
+    len = vsnprintf(slot->line, sizeof(slot->line), fmt, args);
+    va_end(args);
+    if (len < 0)
+        len = 0;
+    if (len >= (int)sizeof(slot->line))
+        len = sizeof(slot->line) - 1;
+    while (len > 0 && (slot->line[len - 1] == '\n' || slot->line[len - 1] == '\r')) {
+        len--;
+    }
+    slot->line[len] = '\0';
+
+    atomic_store_long(&slot->seq, pos + 1); /* publishes the line */
+}
+
+int vgmstream_log_drain(void) {
+    long dropped;
+    int count = 0;
+
+    if (!g_log.callback || !atomic_cas_long(&g_log.draining, 0, 1))
+        return 0;
+
+    while (1) {
+        vgm_log_slot* slot = &g_log.slots[(unsigned long)g_log.read_pos % VGM_LOG_SLOTS];
+        if (atomic_load_long(&slot->seq) != g_log.read_pos + 1)
+            break; /* empty, or next line still being written */
+
+        g_log.callback(slot->line, g_log.data);
+        atomic_store_long(&slot->seq, g_log.read_pos + VGM_LOG_SLOTS);
+        g_log.read_pos++;
+        count++;
+    }
+
+    dropped = atomic_load_long(&g_log.dropped);
+    if (dropped && atomic_cas_long(&g_log.dropped, dropped, 0)) {
+        char line[64];
+        snprintf(line, sizeof(line), "(%li log lines dropped)", dropped);
+        g_log.callback(line, g_log.data);
+    }
+
+    atomic_store_long(&g_log.draining, 0);
+    return count;
+}
+
 void concatn(int length, char * dst, const char * src) {
     int i,j;
     if (length <= 0) return;
@@ -135,3 +340,109 @@ void concatn(int length, char * dst, const char * src) {
         dst[i]=src[j];
     dst[i]='\0';
 }
+
+static struct {
+    void* (*alloc)(size_t size, void* data);
+    void* (*resize)(void* ptr, size_t size, void* data);
+    void (*release)(void* ptr, void* data);
+    void* data;
+} allocator;
+
+void vgmstream_allocator_setup(void* (*alloc)(size_t size, void* data), void* (*resize)(void* ptr, size_t size, void* data),
+        void (*release)(void* ptr, void* data), void* data) {
+    /* all or nothing, as memory must be freed by the allocator that made it */
+    if (!alloc || !resize || !release) {
+        alloc = NULL;
+        resize = NULL;
+        release = NULL;
+        data = NULL;
+    }
+
+    allocator.alloc = alloc;
+    allocator.resize = resize;
+    allocator.release = release;
+    allocator.data = data;
+}
+
+void* vgm_malloc(size_t size) {
+    if (allocator.alloc)
+        return allocator.alloc(size, allocator.data);
+    return malloc(size);
+}
+
+void* vgm_calloc(size_t count, size_t size) {
+    void* ptr;
+
+    if (!allocator.alloc)
+        return calloc(count, size);
+
+    if (size && count > (size_t)-1 / size)
+        return NULL;
+    ptr = allocator.alloc(count * size, allocator.data);
+    if (ptr)
+        memset(ptr, 0, count * size);
+    return ptr;
+}
+
+void* vgm_realloc(void* ptr, size_t size) {
+    if (allocator.resize)
+        return allocator.resize(ptr, size, allocator.data);
+    return realloc(ptr, size);
+}
+
+void vgm_free(void* ptr) {
+    if (!ptr)
+        return;
+    if (allocator.release)
+        allocator.release(ptr, allocator.data);
+    else
+        free(ptr);
+}
+
+void vgmstream_free(void* ptr) {
+    vgm_free(ptr);
+}
+
+#ifdef VGM_DEBUG_ALLOC
+#include <stdio.h>
+
+#ifdef _MSC_VER
+#define VGM_THREAD_LOCAL __declspec(thread)
+#else
+#define VGM_THREAD_LOCAL __thread
+#endif
+
+/* per thread, as several streams may render at once */
+static VGM_THREAD_LOCAL int alloc_check_depth;
+static VGM_THREAD_LOCAL int alloc_check_paused;
+
+void vgm_alloc_check(int begin) {
+    alloc_check_depth += begin ? 1 : -1;
+}
+
+void vgm_alloc_check_pause(int pause) {
+    alloc_check_paused += pause ? 1 : -1;
+}
+
+static void alloc_check(const char* call, size_t size, const char* file, int line) {
+    if (alloc_check_depth <= 0 || alloc_check_paused > 0)
+        return;
+    fprintf(stderr, "vgmstream: %s of %u bytes while rendering at %s:%i\n", call, (unsigned)size, file, line);
+    abort();
+}
+
+void* vgm_debug_malloc(size_t size, const char* file, int line) {
+    alloc_check("malloc", size, file, line);
+    return vgm_malloc(size);
+}
+
+void* vgm_debug_calloc(size_t count, size_t size, const char* file, int line) {
+    alloc_check("calloc", count * size, file, line);
+    return vgm_calloc(count, size);
+}
+
+void* vgm_debug_realloc(void* ptr, size_t size, const char* file, int line) {
+    alloc_check("realloc", size, file, line);
+    return vgm_realloc(ptr, size);
+}
+#endif
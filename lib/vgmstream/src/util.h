@@ -11,45 +11,45 @@
 
 /* host endian independent multi-byte integer reading */
 
-static inline int16_t get_16bitBE(uint8_t * p) {
+static inline int16_t get_16bitBE(const uint8_t * p) {
     return (p[0]<<8) | (p[1]);
 }
 
-static inline int16_t get_16bitLE(uint8_t * p) {
+static inline int16_t get_16bitLE(const uint8_t * p) {
     return (p[0]) | (p[1]<<8);
 }
 
-static inline int32_t get_32bitBE(uint8_t * p) {
+static inline int32_t get_32bitBE(const uint8_t * p) {
     return (p[0]<<24) | (p[1]<<16) | (p[2]<<8) | (p[3]);
 }
 
-static inline int32_t get_32bitLE(uint8_t * p) {
+static inline int32_t get_32bitLE(const uint8_t * p) {
     return (p[0]) | (p[1]<<8) | (p[2]<<16) | (p[3]<<24);
 }
 
-static inline int64_t get_64bitBE(uint8_t * p) {
+static inline int64_t get_64bitBE(const uint8_t * p) {
     return (uint64_t)(((uint64_t)p[0]<<56) | ((uint64_t)p[1]<<48) | ((uint64_t)p[2]<<40) | ((uint64_t)p[3]<<32) | ((uint64_t)p[4]<<24) | ((uint64_t)p[5]<<16) | ((uint64_t)p[6]<<8) | ((uint64_t)p[7]));
 }
 
-static inline int64_t get_64bitLE(uint8_t * p) {
+static inline int64_t get_64bitLE(const uint8_t * p) {
     return (uint64_t)(((uint64_t)p[0]) | ((uint64_t)p[1]<<8) | ((uint64_t)p[2]<<16) | ((uint64_t)p[3]<<24) | ((uint64_t)p[4]<<32) | ((uint64_t)p[5]<<40) | ((uint64_t)p[6]<<48) | ((uint64_t)p[7]<<56));
 }
 
 /* alias of the above */
-static inline  int8_t  get_s8   (uint8_t *p) { return ( int8_t)p[0]; }
-static inline uint8_t  get_u8   (uint8_t *p) { return (uint8_t)p[0]; }
-static inline  int16_t get_s16le(uint8_t *p) { return ( int16_t)get_16bitLE(p); }
-static inline uint16_t get_u16le(uint8_t *p) { return (uint16_t)get_16bitLE(p); }
-static inline  int16_t get_s16be(uint8_t *p) { return ( int16_t)get_16bitBE(p); }
-static inline uint16_t get_u16be(uint8_t *p) { return (uint16_t)get_16bitBE(p); }
-static inline  int32_t get_s32le(uint8_t *p) { return ( int32_t)get_32bitLE(p); }
-static inline uint32_t get_u32le(uint8_t *p) { return (uint32_t)get_32bitLE(p); }
-static inline  int32_t get_s32be(uint8_t *p) { return ( int32_t)get_32bitBE(p); }
-static inline uint32_t get_u32be(uint8_t *p) { return (uint32_t)get_32bitBE(p); }
-static inline  int64_t get_s64be(uint8_t *p) { return ( int64_t)get_64bitLE(p); }
-static inline uint64_t get_u64be(uint8_t *p) { return (uint64_t)get_64bitLE(p); }
-static inline  int64_t get_s64le(uint8_t *p) { return ( int64_t)get_64bitBE(p); }
-static inline uint64_t get_u64le(uint8_t *p) { return (uint64_t)get_64bitBE(p); }
+static inline  int8_t  get_s8   (const uint8_t *p) { return ( int8_t)p[0]; }
+static inline uint8_t  get_u8   (const uint8_t *p) { return (uint8_t)p[0]; }
+static inline  int16_t get_s16le(const uint8_t *p) { return ( int16_t)get_16bitLE(p); }
+static inline uint16_t get_u16le(const uint8_t *p) { return (uint16_t)get_16bitLE(p); }
+static inline  int16_t get_s16be(const uint8_t *p) { return ( int16_t)get_16bitBE(p); }
+static inline uint16_t get_u16be(const uint8_t *p) { return (uint16_t)get_16bitBE(p); }
+static inline  int32_t get_s32le(const uint8_t *p) { return ( int32_t)get_32bitLE(p); }
+static inline uint32_t get_u32le(const uint8_t *p) { return (uint32_t)get_32bitLE(p); }
+static inline  int32_t get_s32be(const uint8_t *p) { return ( int32_t)get_32bitBE(p); }
+static inline uint32_t get_u32be(const uint8_t *p) { return (uint32_t)get_32bitBE(p); }
+static inline  int64_t get_s64be(const uint8_t *p) { return ( int64_t)get_64bitLE(p); }
+static inline uint64_t get_u64be(const uint8_t *p) { return (uint64_t)get_64bitLE(p); }
+static inline  int64_t get_s64le(const uint8_t *p) { return ( int64_t)get_64bitBE(p); }
+static inline uint64_t get_u64le(const uint8_t *p) { return (uint64_t)get_64bitBE(p); }
 
 void put_8bit(uint8_t * buf, int8_t i);
 
@@ -87,6 +87,28 @@ static inline int get_low_nibble_signed(uint8_t n) {
     return nibble_to_int[n&0xf];
 }
 
+/* signed nibble expanded to 16b then scaled down: (int16_t)(nibble << 12) >> shift, as most XA-style
+ * ADPCM does per sample. Pick the row once per frame (shift) and index it with the raw nibble.
+ * for (s=0;s<16;s++) for (n=0;n<16;n++) nibble_shift_table[s][n] = (int16_t)(n << 12) >> s; */
+static const int16_t nibble_shift_table[16][16] = {
+    {      0,   4096,   8192,  12288,  16384,  20480,  24576,  28672, -32768, -28672, -24576, -20480, -16384, -12288,  -8192,  -4096 },
+    {      0,   2048,   4096,   6144,   8192,  10240,  12288,  14336, -16384, -14336, -12288, -10240,  -8192,  -6144,  -4096,  -2048 },
+    {      0,   1024,   2048,   3072,   4096,   5120,   6144,   7168,  -8192,  -7168,  -6144,  -5120,  -4096,  -3072,  -2048,  -1024 },
+    {      0,    512,   1024,   1536,   2048,   2560,   3072,   3584,  -4096,  -3584,  -3072,  -2560,  -2048,  -1536,  -1024,   -512 },
+    {      0,    256,    512,    768,   1024,   1280,   1536,   1792,  -2048,  -1792,  -1536,  -1280,  -1024,   -768,   -512,   -256 },
+    {      0,    128,    256,    384,    512,    640,    768,    896,  -1024,   -896,   -768,   -640,   -512,   -384,   -256,   -128 },
+    {      0,     64,    128,    192,    256,    320,    384,    448,   -512,   -448,   -384,   -320,   -256,   -192,   -128,    -64 },
+    {      0,     32,     64,     96,    128,    160,    192,    224,   -256,   -224,   -192,   -160,   -128,    -96,    -64,    -32 },
+    {      0,     16,     32,     48,     64,     80,     96,    112,   -128,   -112,    -96,    -80,    -64,    -48,    -32,    -16 },
+    {      0,      8,     16,     24,     32,     40,     48,     56,    -64,    -56,    -48,    -40,    -32,    -24,    -16,     -8 },
+    {      0,      4,      8,     12,     16,     20,     24,     28,    -32,    -28,    -24,    -20,    -16,    -12,     -8,     -4 },
+    {      0,      2,      4,      6,      8,     10,     12,     14,    -16,    -14,    -12,    -10,     -8,     -6,     -4,     -2 },
+    {      0,      1,      2,      3,      4,      5,      6,      7,     -8,     -7,     -6,     -5,     -4,     -3,     -2,     -1 },
+    {      0,      0,      1,      1,      2,      2,      3,      3,     -4,     -4,     -3,     -3,     -2,     -2,     -1,     -1 },
+    {      0,      0,      0,      0,      1,      1,      1,      1,     -2,     -2,     -2,     -2,     -1,     -1,     -1,     -1 },
+    {      0,      0,      0,      0,      0,      0,      0,      0,     -1,     -1,     -1,     -1,     -1,     -1,     -1,     -1 },
+};
+
 static inline int clamp16(int32_t val) {
     if (val > 32767) return 32767;
     else if (val < -32768) return -32768;
@@ -106,24 +128,89 @@ void swap_samples_le(sample_t *buf, int count);
 
 void concatn(int length, char * dst, const char * src);
 
+/* Runs init only the first time, even when called from several threads at once (others wait until
+ * it's done), for global setup of codec libraries. flag must be a static vgm_once_t set to 0. */
+typedef volatile long vgm_once_t;
+void vgm_once(vgm_once_t* flag, void (*init)(void));
+
+
+/* All allocations of the core go through these (malloc/calloc/realloc/free are defined to them
+ * below), so hosts can install their own allocator with vgmstream_allocator_setup. Vendored decoder
+ * libraries in their own files (acm, miniz, g7221, relic's fft) keep using the C ones internally. */
+#include <stdlib.h> /* before the defines, so later includes don't get replaced */
+void* vgm_malloc(size_t size);
+void* vgm_calloc(size_t count, size_t size);
+void* vgm_realloc(void* ptr, size_t size);
+void vgm_free(void* ptr);
+
+
+/* Debug check that rendering a prepared stream (see prepare_vgmstream) never touches the heap, for
+ * real-time hosts. With VGM_DEBUG_ALLOC the core's malloc/calloc/realloc assert when called inside
+ * render_vgmstream* on the rendering thread (external codec libraries and channel worker threads
+ * aren't covered). _PAUSE/_RESUME mark the few allocations that are allowed on purpose. */
+#ifdef VGM_DEBUG_ALLOC
+
+void vgm_alloc_check(int begin);
+void vgm_alloc_check_pause(int pause);
+void* vgm_debug_malloc(size_t size, const char* file, int line);
+void* vgm_debug_calloc(size_t count, size_t size, const char* file, int line);
+void* vgm_debug_realloc(void* ptr, size_t size, const char* file, int line);
+
+#define VGM_ALLOC_CHECK_BEGIN() vgm_alloc_check(1)
+#define VGM_ALLOC_CHECK_END() vgm_alloc_check(0)
+#define VGM_ALLOC_CHECK_PAUSE() vgm_alloc_check_pause(1)
+#define VGM_ALLOC_CHECK_RESUME() vgm_alloc_check_pause(0)
+
+#else/*VGM_DEBUG_ALLOC*/
+
+#define VGM_ALLOC_CHECK_BEGIN() /* nothing */
+#define VGM_ALLOC_CHECK_END() /* nothing */
+#define VGM_ALLOC_CHECK_PAUSE() /* nothing */
+#define VGM_ALLOC_CHECK_RESUME() /* nothing */
+
+#endif/*VGM_DEBUG_ALLOC*/
+
+/* C++ hosts include this too, but their allocations are their own */
+#if !defined(__cplusplus) && !defined(VGM_ALLOC_IMPL)
+#ifdef VGM_DEBUG_ALLOC
+#define malloc(size) vgm_debug_malloc(size, __FILE__, __LINE__)
+#define calloc(count, size) vgm_debug_calloc(count, size, __FILE__, __LINE__)
+#define realloc(ptr, size) vgm_debug_realloc(ptr, size, __FILE__, __LINE__)
+#else
+#define malloc(size) vgm_malloc(size)
+#define calloc(count, size) vgm_calloc(count, size)
+#define realloc(ptr, size) vgm_realloc(ptr, size)
+#endif
+#define free(ptr) vgm_free(ptr)
+#endif
+
+
+/* printf-like line for the debug log: printed right away, or queued for the host's callback without
+ * blocking (see vgmstream_log_setup) */
+#if defined(__GNUC__)
+void vgm_log(const char* fmt, ...) __attribute__((format(printf, 1, 2)));
+#else
+void vgm_log(const char* fmt, ...);
+#endif
 
 /* Simple stdout logging for debugging and regression testing purposes.
- * Needs C99 variadic macros, uses do..while to force ";" as statement */
+ * Needs C99 variadic macros, uses do..while to force ";" as statement
+ * (_ONCE flags aren't locked, so with several threads a message may be repeated) */
 #ifdef VGM_DEBUG_OUTPUT
 
 /* equivalent to printf when condition is true */
 #define VGM_ASSERT(condition, ...) \
-    do { if (condition) {printf(__VA_ARGS__);} } while (0)
+    do { if (condition) {vgm_log(__VA_ARGS__);} } while (0)
 #define VGM_ASSERT_ONCE(condition, ...) \
-    do { static int written; if (!written) { if (condition) {printf(__VA_ARGS__); written = 1;} }  } while (0)
+    do { static int written; if (!written) { if (condition) {vgm_log(__VA_ARGS__); written = 1;} }  } while (0)
 /* equivalent to printf */
 #define VGM_LOG(...) \
-    do { printf(__VA_ARGS__); } while (0)
+    do { vgm_log(__VA_ARGS__); } while (0)
 #define VGM_LOG_ONCE(...) \
-    do { static int written; if (!written) { printf(__VA_ARGS__); written = 1; } } while (0)
+    do { static int written; if (!written) { vgm_log(__VA_ARGS__); written = 1; } } while (0)
 /* prints file/line/func */
 #define VGM_LOGF() \
-    do { printf("%s:%i '%s'\n",  __FILE__, __LINE__, __func__); } while (0)
+    do { vgm_log("%s:%i '%s'\n",  __FILE__, __LINE__, __func__); } while (0)
 /* prints to a file */
 #define VGM_LOGT(txt, ...) \
     do { FILE *fl = fopen(txt,"a+"); if(fl){fprintf(fl,__VA_ARGS__); fflush(fl);} fclose(fl); } while(0)
@@ -10,11 +10,17 @@
 #include "layout/layout.h"
 #include "coding/coding.h"
 #include "mixing.h"
+#include "pool.h"
+#include "membudget.h"
+#include "cpu.h"
 
 static void try_dual_file_stereo(VGMSTREAM * opened_vgmstream, STREAMFILE *streamFile, VGMSTREAM* (*init_vgmstream_function)(STREAMFILE*));
+static void save_loop_state(VGMSTREAM * vgmstream);
 
 
-/* list of metadata parser functions that will recognize files, used on init */
+/* list of metadata parser functions that will recognize files, used on init
+ * (metas that can only make streams of optional codecs are left out of builds without them,
+ * as they'd read headers of every file just to fail) */
 VGMSTREAM * (*init_vgmstream_functions[])(STREAMFILE *streamFile) = {
     init_vgmstream_adx,
     init_vgmstream_brstm,
@@ -63,8 +69,12 @@ VGMSTREAM * (*init_vgmstream_functions[])(STREAMFILE *streamFile) = {
 #ifdef VGM_USE_VORBIS
     init_vgmstream_ogg_vorbis,
 #endif
+#if defined(VGM_USE_VORBIS) || defined(VGM_USE_FFMPEG)
     init_vgmstream_sli_ogg,
+#endif
+#ifdef VGM_USE_VORBIS
     init_vgmstream_sfl_ogg,
+#endif
 #if 0
     init_vgmstream_mp4_aac,
 #endif
@@ -77,7 +87,9 @@ VGMSTREAM * (*init_vgmstream_functions[])(STREAMFILE *streamFile) = {
     init_vgmstream_aifc,
     init_vgmstream_str_snds,
     init_vgmstream_ws_aud,
+#ifdef VGM_USE_MPEG
     init_vgmstream_ahx,
+#endif
     init_vgmstream_ivb,
     init_vgmstream_svs,
     init_vgmstream_riff,
@@ -102,7 +114,9 @@ VGMSTREAM * (*init_vgmstream_functions[])(STREAMFILE *streamFile) = {
     init_vgmstream_leg,
     init_vgmstream_filp,
     init_vgmstream_ikm_ps2,
+#ifdef VGM_USE_VORBIS
     init_vgmstream_ikm_pc,
+#endif
     init_vgmstream_ikm_psp,
     init_vgmstream_sfs,
     init_vgmstream_bg00,
@@ -230,7 +244,9 @@ VGMSTREAM * (*init_vgmstream_functions[])(STREAMFILE *streamFile) = {
     init_vgmstream_ngc_dsp_konami,
     init_vgmstream_ps2_ster,
     init_vgmstream_ps2_wb,
+#if defined(VGM_USE_G7221) || defined(VGM_USE_G719)
     init_vgmstream_bnsf,
+#endif
     init_vgmstream_ps2_gcm,
     init_vgmstream_ps2_smpl,
     init_vgmstream_ps2_msa,
@@ -299,29 +315,53 @@ VGMSTREAM * (*init_vgmstream_functions[])(STREAMFILE *streamFile) = {
     init_vgmstream_hca,
     init_vgmstream_ps2_svag_snk,
     init_vgmstream_ps2_vds_vdm,
+#ifdef VGM_USE_FFMPEG
     init_vgmstream_x360_cxs,
+#endif
     init_vgmstream_dsp_adx,
     init_vgmstream_akb,
     init_vgmstream_akb2,
 #ifdef VGM_USE_FFMPEG
     init_vgmstream_mp4_aac_ffmpeg,
 #endif
+#ifdef VGM_USE_FFMPEG
     init_vgmstream_bik,
+#endif
+#ifdef VGM_USE_FFMPEG
     init_vgmstream_x360_ast,
+#endif
     init_vgmstream_wwise,
     init_vgmstream_ubi_raki,
+#ifdef VGM_USE_FFMPEG
     init_vgmstream_x360_pasx,
+#endif
+#ifdef VGM_USE_FFMPEG
     init_vgmstream_xma,
+#endif
     init_vgmstream_sxd,
+#ifdef VGM_USE_VORBIS
     init_vgmstream_ogl,
+#endif
     init_vgmstream_mc3,
+#if defined(VGM_USE_FFMPEG) || defined(VGM_USE_ATRAC9)
     init_vgmstream_gtd,
+#endif
+#ifdef VGM_USE_FFMPEG
     init_vgmstream_ta_aac_x360,
+#endif
+#ifdef VGM_USE_FFMPEG
     init_vgmstream_ta_aac_ps3,
+#endif
     init_vgmstream_ta_aac_mobile,
+#ifdef VGM_USE_VORBIS
     init_vgmstream_ta_aac_mobile_vorbis,
+#endif
+#ifdef VGM_USE_ATRAC9
     init_vgmstream_ta_aac_vita,
+#endif
+#ifdef VGM_USE_FFMPEG
     init_vgmstream_va3,
+#endif
     init_vgmstream_mta2,
     init_vgmstream_mta2_container,
     init_vgmstream_ngc_ulw,
@@ -334,7 +374,9 @@ VGMSTREAM * (*init_vgmstream_functions[])(STREAMFILE *streamFile) = {
     init_vgmstream_ea_map_mus,
     init_vgmstream_ea_mpf_mus,
     init_vgmstream_ea_schl_fixed,
+#ifdef VGM_USE_VORBIS
     init_vgmstream_sk_aud,
+#endif
     init_vgmstream_stm,
     init_vgmstream_ea_snu,
     init_vgmstream_awc,
@@ -345,9 +387,13 @@ VGMSTREAM * (*init_vgmstream_functions[])(STREAMFILE *streamFile) = {
     init_vgmstream_opus_shinen,
     init_vgmstream_opus_nus3,
     init_vgmstream_opus_sps_n1,
+#ifdef VGM_USE_FFMPEG
     init_vgmstream_opus_nxa,
+#endif
     init_vgmstream_pc_ast,
+#ifdef VGM_USE_FFMPEG
     init_vgmstream_naac,
+#endif
     init_vgmstream_ubi_sb,
     init_vgmstream_ubi_sm,
     init_vgmstream_ubi_bnm,
@@ -366,10 +412,16 @@ VGMSTREAM * (*init_vgmstream_functions[])(STREAMFILE *streamFile) = {
     init_vgmstream_ea_sbr_harmony,
     init_vgmstream_ngc_vid1,
     init_vgmstream_flx,
+#ifdef VGM_USE_VORBIS
     init_vgmstream_mogg,
+#endif
+#ifdef VGM_USE_ATRAC9
     init_vgmstream_kma9,
+#endif
     init_vgmstream_fsb_encrypted,
+#if defined(VGM_USE_MPEG) || defined(VGM_USE_FFMPEG) || defined(VGM_USE_VORBIS)
     init_vgmstream_xwc,
+#endif
     init_vgmstream_atsl,
     init_vgmstream_sps_n1,
     init_vgmstream_atx,
@@ -419,20 +471,30 @@ VGMSTREAM * (*init_vgmstream_functions[])(STREAMFILE *streamFile) = {
     init_vgmstream_vis,
     init_vgmstream_vai,
     init_vgmstream_aif_asobo,
+#ifdef VGM_USE_VORBIS
     init_vgmstream_ao,
+#endif
     init_vgmstream_apc,
     init_vgmstream_wv2,
     init_vgmstream_xau_konami,
     init_vgmstream_derf,
     init_vgmstream_utk,
     init_vgmstream_adpcm_capcom,
+#ifdef VGM_USE_FFMPEG
     init_vgmstream_ue4opus,
+#endif
+#ifdef VGM_USE_FFMPEG
     init_vgmstream_xwma,
+#endif
+#ifdef VGM_USE_FFMPEG
     init_vgmstream_xopus,
+#endif
     init_vgmstream_vs_square,
     init_vgmstream_msf_banpresto_wmsf,
     init_vgmstream_msf_banpresto_2msf,
+#ifdef VGM_USE_VORBIS
     init_vgmstream_nwav,
+#endif
     init_vgmstream_xpcm,
     init_vgmstream_msf_tamasoft,
     init_vgmstream_xps_dat,
@@ -441,7 +503,9 @@ VGMSTREAM * (*init_vgmstream_functions[])(STREAMFILE *streamFile) = {
     init_vgmstream_opus_opusx,
     init_vgmstream_dsp_adpy,
     init_vgmstream_dsp_adpx,
+#ifdef VGM_USE_FFMPEG
     init_vgmstream_ogg_opus,
+#endif
     init_vgmstream_nus3audio,
     init_vgmstream_imc,
     init_vgmstream_imc_container,
@@ -450,21 +514,31 @@ VGMSTREAM * (*init_vgmstream_functions[])(STREAMFILE *streamFile) = {
     init_vgmstream_dsf,
     init_vgmstream_208,
     init_vgmstream_dsp_ds2,
+#if defined(VGM_USE_FFMPEG) || defined(VGM_USE_VORBIS)
     init_vgmstream_ffdl,
+#endif
     init_vgmstream_mus_vc,
+#ifdef VGM_USE_FFMPEG
     init_vgmstream_strm_abylight,
+#endif
     init_vgmstream_sfh,
     init_vgmstream_ea_schl_video,
     init_vgmstream_msf_konami,
+#ifdef VGM_USE_FFMPEG
     init_vgmstream_xwma_konami,
+#endif
+#ifdef VGM_USE_ATRAC9
     init_vgmstream_9tav,
+#endif
     init_vgmstream_fsb5_fev_bank,
     init_vgmstream_bwav,
     init_vgmstream_opus_prototype,
     init_vgmstream_awb,
     init_vgmstream_acb,
     init_vgmstream_rad,
+#ifdef VGM_USE_FFMPEG
     init_vgmstream_smk,
+#endif
     init_vgmstream_mzrt,
     init_vgmstream_xavs,
     init_vgmstream_psf_single,
@@ -476,7 +550,9 @@ VGMSTREAM * (*init_vgmstream_functions[])(STREAMFILE *streamFile) = {
     init_vgmstream_nub_wav,
     init_vgmstream_nub_vag,
     init_vgmstream_nub_at3,
+#ifdef VGM_USE_FFMPEG
     init_vgmstream_nub_xma,
+#endif
     init_vgmstream_nub_idsp,
     init_vgmstream_nub_is14,
     init_vgmstream_xmv_valve,
@@ -486,19 +562,25 @@ VGMSTREAM * (*init_vgmstream_functions[])(STREAMFILE *streamFile) = {
     init_vgmstream_opus_sqex,
     init_vgmstream_isb,
     init_vgmstream_xssb,
+#ifdef VGM_USE_FFMPEG
     init_vgmstream_xma_ue3,
+#endif
     init_vgmstream_csb,
     init_vgmstream_fwse,
     init_vgmstream_fda,
     init_vgmstream_tgc,
     init_vgmstream_kwb,
+#ifdef VGM_USE_FFMPEG
     init_vgmstream_lrmd,
+#endif
     init_vgmstream_bkhd,
     init_vgmstream_bkhd_fx,
     init_vgmstream_diva,
     init_vgmstream_imuse,
     init_vgmstream_ktsr,
+#ifdef VGM_USE_VORBIS
     init_vgmstream_mups,
+#endif
     init_vgmstream_kat,
     init_vgmstream_pcm_success,
 
@@ -510,7 +592,9 @@ VGMSTREAM * (*init_vgmstream_functions[])(STREAMFILE *streamFile) = {
     init_vgmstream_raw_snds,        /* .snds raw SNDS IMA (*after* ps_headerless) */
     init_vgmstream_raw_wavm,        /* .wavm raw xbox */
     init_vgmstream_raw_pcm,         /* .raw raw PCM */
+#ifdef VGM_USE_G7221
     init_vgmstream_s14_sss,         /* .s14/sss raw siren14 */
+#endif
     init_vgmstream_raw_al,          /* .al/al2 raw A-LAW */
 #ifdef VGM_USE_FFMPEG
     init_vgmstream_ffmpeg,          /* may play anything incorrectly, since FFmpeg doesn't check extensions */
@@ -518,115 +602,307 @@ VGMSTREAM * (*init_vgmstream_functions[])(STREAMFILE *streamFile) = {
 };
 
 
-/* internal version with all parameters */
-static VGMSTREAM * init_vgmstream_internal(STREAMFILE *streamFile) {
-    int i, fcns_size;
-    
-    if (!streamFile)
-        return NULL;
+/* Quick candidates for common formats with a known extension and header id, tried before
+ * the full list. Ids here aren't accepted by earlier metas, so the result is the same as
+ * the linear scan (headerless/raw formats are left to it). */
+typedef struct {
+    const char* extensions;
+    uint32_t id;
+    uint32_t id_mask;
+    VGMSTREAM* (*init_vgmstream_function)(STREAMFILE*);
+} init_vgmstream_hint_t;
+
+static const init_vgmstream_hint_t init_vgmstream_hints[] = {
+    {"wav,lwav",    0x52494646, 0xFFFFFFFF, init_vgmstream_riff },      /* "RIFF" */
+    {"fsb",         0x46534235, 0xFFFFFFFF, init_vgmstream_fsb5 },      /* "FSB5" */
+    {"xwb",         0x57424E44, 0xFFFFFFFF, init_vgmstream_xwb },       /* "WBND" */
+    {"xwb",         0x444E4257, 0xFFFFFFFF, init_vgmstream_xwb },       /* "DNBW" */
+    {"hca",         0x48434100, 0x7F7F7F7F, init_vgmstream_hca },       /* "HCA\0", possibly masked */
+    {"acb",         0x40555446, 0xFFFFFFFF, init_vgmstream_acb },       /* "@UTF" */
+    {"awb",         0x41465332, 0xFFFFFFFF, init_vgmstream_awb },       /* "AFS2" */
+    {"scd",         0x53454442, 0xFFFFFFFF, init_vgmstream_sqex_scd },  /* "SEDB" */
+    {"xvag",        0x58564147, 0xFFFFFFFF, init_vgmstream_xvag },      /* "XVAG" */
+    {"wem",         0x52494646, 0xFFFFFFFF, init_vgmstream_wwise },     /* "RIFF" */
+    {"wem",         0x52494658, 0xFFFFFFFF, init_vgmstream_wwise },     /* "RIFX" */
+#ifdef VGM_USE_VORBIS
+    {"ogg,logg",    0x4F676753, 0xFFFFFFFF, init_vgmstream_ogg_vorbis },/* "OggS" */
+#endif
+    {"txtp",        0x00000000, 0x00000000, init_vgmstream_txtp },      /* text, any id */
+};
 
-    fcns_size = (sizeof(init_vgmstream_functions)/sizeof(init_vgmstream_functions[0]));
-    /* try a series of formats, see which works */
-    for (i = 0; i < fcns_size; i++) {
-        /* call init function and see if valid VGMSTREAM was returned */
-        VGMSTREAM * vgmstream = (init_vgmstream_functions[i])(streamFile);
-        if (!vgmstream)
-            continue;
+static int get_init_vgmstream_index(VGMSTREAM* (*init_vgmstream_function)(STREAMFILE*)) {
+    int i, fcns_size = (sizeof(init_vgmstream_functions)/sizeof(init_vgmstream_functions[0]));
 
-        /* fail if there is nothing/too much to play (<=0 generates empty files, >N writes GBs of garbage) */
-        if (vgmstream->num_samples <= 0 || vgmstream->num_samples > VGMSTREAM_MAX_NUM_SAMPLES) {
-            VGM_LOG("VGMSTREAM: wrong num_samples %i\n", vgmstream->num_samples);
-            close_vgmstream(vgmstream);
-            continue;
-        }
+    for (i = 0; i < fcns_size; i++) {
+        if (init_vgmstream_functions[i] == init_vgmstream_function)
+            return i + 1;
+    }
+    return 0;
+}
 
-        /* everything should have a reasonable sample rate */
-        if (vgmstream->sample_rate < VGMSTREAM_MIN_SAMPLE_RATE || vgmstream->sample_rate > VGMSTREAM_MAX_SAMPLE_RATE) {
-            VGM_LOG("VGMSTREAM: wrong sample_rate %i\n", vgmstream->sample_rate);
-            close_vgmstream(vgmstream);
-            continue;
-        }
+/* call init function and check the returned VGMSTREAM, NULL if not valid */
+static VGMSTREAM* check_init_vgmstream(STREAMFILE* streamFile, VGMSTREAM* (*init_vgmstream_function)(STREAMFILE*)) {
+    VGMSTREAM * vgmstream = init_vgmstream_function(streamFile);
+    if (!vgmstream)
+        return NULL;
 
-        /* sanify loops and remove bad metadata */
-        if (vgmstream->loop_flag) {
-            if (vgmstream->loop_end_sample <= vgmstream->loop_start_sample
-                    || vgmstream->loop_end_sample > vgmstream->num_samples
-                    || vgmstream->loop_start_sample < 0) {
-                VGM_LOG("VGMSTREAM: wrong loops ignored (lss=%i, lse=%i, ns=%i)\n",
-                        vgmstream->loop_start_sample, vgmstream->loop_end_sample, vgmstream->num_samples);
-                vgmstream->loop_flag = 0;
-                vgmstream->loop_start_sample = 0;
-                vgmstream->loop_end_sample = 0;
-            }
-        }
+    /* fail if there is nothing/too much to play (<=0 generates empty files, >N writes GBs of garbage) */
+    if (vgmstream->num_samples <= 0 || vgmstream->num_samples > VGMSTREAM_MAX_NUM_SAMPLES) {
+        VGM_LOG("VGMSTREAM: wrong num_samples %i\n", vgmstream->num_samples);
+        close_vgmstream(vgmstream);
+        return NULL;
+    }
 
-        /* test if candidate for dual stereo */
-        if (vgmstream->channels == 1 && vgmstream->allow_dual_stereo == 1) {
-            try_dual_file_stereo(vgmstream, streamFile, init_vgmstream_functions[i]);
-        }
+    /* everything should have a reasonable sample rate */
+    if (vgmstream->sample_rate < VGMSTREAM_MIN_SAMPLE_RATE || vgmstream->sample_rate > VGMSTREAM_MAX_SAMPLE_RATE) {
+        VGM_LOG("VGMSTREAM: wrong sample_rate %i\n", vgmstream->sample_rate);
+        close_vgmstream(vgmstream);
+        return NULL;
+    }
 
-        /* clean as loops are readable metadata but loop fields may contain garbage
-         * (done *after* dual stereo as it needs loop fields to match) */
-        if (!vgmstream->loop_flag) {
+    /* sanify loops and remove bad metadata */
+    if (vgmstream->loop_flag) {
+        if (vgmstream->loop_end_sample <= vgmstream->loop_start_sample
+                || vgmstream->loop_end_sample > vgmstream->num_samples
+                || vgmstream->loop_start_sample < 0) {
+            VGM_LOG("VGMSTREAM: wrong loops ignored (lss=%i, lse=%i, ns=%i)\n",
+                    vgmstream->loop_start_sample, vgmstream->loop_end_sample, vgmstream->num_samples);
+            vgmstream->loop_flag = 0;
             vgmstream->loop_start_sample = 0;
             vgmstream->loop_end_sample = 0;
         }
+    }
+
+    /* test if candidate for dual stereo */
+    if (vgmstream->channels == 1 && vgmstream->allow_dual_stereo == 1) {
+        try_dual_file_stereo(vgmstream, streamFile, init_vgmstream_function);
+    }
+
+    /* clean as loops are readable metadata but loop fields may contain garbage
+     * (done *after* dual stereo as it needs loop fields to match) */
+    if (!vgmstream->loop_flag) {
+        vgmstream->loop_start_sample = 0;
+        vgmstream->loop_end_sample = 0;
+    }
 
 #ifdef VGM_USE_FFMPEG
-        /* check FFmpeg streams here, for lack of a better place */
-        if (vgmstream->coding_type == coding_FFmpeg) {
-            ffmpeg_codec_data *data = (ffmpeg_codec_data *) vgmstream->codec_data;
-            if (data && data->streamCount && !vgmstream->num_streams) {
-                vgmstream->num_streams = data->streamCount;
-            }
+    /* check FFmpeg streams here, for lack of a better place */
+    if (vgmstream->coding_type == coding_FFmpeg) {
+        ffmpeg_codec_data *data = (ffmpeg_codec_data *) vgmstream->codec_data;
+        if (data && data->streamCount && !vgmstream->num_streams) {
+            vgmstream->num_streams = data->streamCount;
         }
+    }
 #endif
 
-        /* some players are picky with incorrect channel layouts */
-        if (vgmstream->channel_layout > 0) {
-            int output_channels = vgmstream->channels;
-            int ch, count = 0, max_ch = 32;
-            for (ch = 0; ch < max_ch; ch++) {
-                int bit = (vgmstream->channel_layout >> ch) & 1;
-                if (ch > 17 && bit) {
-                    VGM_LOG("VGMSTREAM: wrong bit %i in channel_layout %x\n", ch, vgmstream->channel_layout);
-                    vgmstream->channel_layout = 0;
-                    break;
-                }
-                count += bit;
-            }
-
-            if (count > output_channels) {
-                VGM_LOG("VGMSTREAM: wrong totals %i in channel_layout %x\n", count, vgmstream->channel_layout);
+    /* some players are picky with incorrect channel layouts */
+    if (vgmstream->channel_layout > 0) {
+        int output_channels = vgmstream->channels;
+        int ch, count = 0, max_ch = 32;
+        for (ch = 0; ch < max_ch; ch++) {
+            int bit = (vgmstream->channel_layout >> ch) & 1;
+            if (ch > 17 && bit) {
+                VGM_LOG("VGMSTREAM: wrong bit %i in channel_layout %x\n", ch, vgmstream->channel_layout);
                 vgmstream->channel_layout = 0;
+                break;
             }
+            count += bit;
         }
 
-        /* files can have thousands subsongs, but let's put a limit */
-        if (vgmstream->num_streams < 0 || vgmstream->num_streams > VGMSTREAM_MAX_SUBSONGS) {
-            VGM_LOG("VGMSTREAM: wrong num_streams (ns=%i)\n", vgmstream->num_streams);
-            close_vgmstream(vgmstream);
-            continue;
+        if (count > output_channels) {
+            VGM_LOG("VGMSTREAM: wrong totals %i in channel_layout %x\n", count, vgmstream->channel_layout);
+            vgmstream->channel_layout = 0;
         }
+    }
 
-        /* save info */
-        /* stream_index 0 may be used by plugins to signal "vgmstream default" (IOW don't force to 1) */
-        if (vgmstream->stream_index == 0) {
-            vgmstream->stream_index = streamFile->stream_index;
-        }
+    /* files can have thousands subsongs, but let's put a limit */
+    if (vgmstream->num_streams < 0 || vgmstream->num_streams > VGMSTREAM_MAX_SUBSONGS) {
+        VGM_LOG("VGMSTREAM: wrong num_streams (ns=%i)\n", vgmstream->num_streams);
+        close_vgmstream(vgmstream);
+        return NULL;
+    }
+
+    /* save info */
+    /* stream_index 0 may be used by plugins to signal "vgmstream default" (IOW don't force to 1) */
+    if (vgmstream->stream_index == 0) {
+        vgmstream->stream_index = streamFile->stream_index;
+    }
+
+
+    /* so hosts can skip detection on next opens */
+    vgmstream->init_index = get_init_vgmstream_index(init_vgmstream_function);
+
+    setup_vgmstream(vgmstream); /* final setup */
+
+    return vgmstream;
+}
+
+static int is_init_vgmstream_hint(const init_vgmstream_hint_t* hint, STREAMFILE* streamFile, uint32_t id) {
+    if ((id & hint->id_mask) != hint->id)
+        return 0;
+    return check_extensions(streamFile, hint->extensions);
+}
+
+static vgmstream_detection_profile_t* detection_profile = NULL;
+
+int vgmstream_get_detection_count(void) {
+    return (sizeof(init_vgmstream_functions)/sizeof(init_vgmstream_functions[0]));
+}
+
+void vgmstream_detection_profile_setup(vgmstream_detection_profile_t* profile) {
+    detection_profile = profile;
+}
+
+static struct {
+    size_t max_bytes;
+    uint64_t max_us;
+} detection_budget;
+
+void vgmstream_detection_budget_setup(size_t max_bytes, int max_ms) {
+    detection_budget.max_bytes = max_bytes;
+    detection_budget.max_us = max_ms > 0 ? (uint64_t)max_ms * 1000 : 0;
+}
+
+/* budget applies to probe streamfiles only (detect_vgmstream's), so other callers aren't limited */
+static VGMSTREAM* budget_init_vgmstream(STREAMFILE* streamFile, VGMSTREAM* (*init_vgmstream_function)(STREAMFILE*), int* p_over_budget) {
+    VGMSTREAM* vgmstream;
+    size_t used = 0;
+
+    *p_over_budget = 0;
+    if (!detection_budget.max_bytes && !detection_budget.max_us)
+        return check_init_vgmstream(streamFile, init_vgmstream_function);
+
+    set_probe_streamfile_budget(streamFile, detection_budget.max_bytes, detection_budget.max_us);
+    vgmstream = check_init_vgmstream(streamFile, init_vgmstream_function);
+
+    /* a stream made from failed reads can't be trusted */
+    if (is_probe_streamfile_over_budget(streamFile, &used)) {
+        VGM_LOG("VGMSTREAM: init %i over detection budget (read 0x%x), skipped\n",
+                get_init_vgmstream_index(init_vgmstream_function), (uint32_t)used);
+        close_vgmstream(vgmstream);
+        vgmstream = NULL;
+        *p_over_budget = 1;
+    }
+    set_probe_streamfile_budget(streamFile, 0, 0);
+    return vgmstream;
+}
+
+static VGMSTREAM* try_init_vgmstream(STREAMFILE* streamFile, VGMSTREAM* (*init_vgmstream_function)(STREAMFILE*)) {
+    vgmstream_detection_profile_t* profile;
+    streamfile_stats_t stats_start, stats_end;
+    uint64_t time_start;
+    VGMSTREAM* vgmstream;
+    int index, over_budget;
+
+    if (!detection_profile)
+        return budget_init_vgmstream(streamFile, init_vgmstream_function, &over_budget);
+
+    index = get_init_vgmstream_index(init_vgmstream_function);
+    if (index <= 0)
+        return budget_init_vgmstream(streamFile, init_vgmstream_function, &over_budget);
+    profile = &detection_profile[index - 1];
+
+    get_streamfile_stats(streamFile, &stats_start);
+    time_start = get_streamfile_time_us();
+
+    vgmstream = budget_init_vgmstream(streamFile, init_vgmstream_function, &over_budget);
+
+    get_streamfile_stats(streamFile, &stats_end);
+    profile->tries++;
+    profile->over_budget += over_budget;
+    profile->time_us += get_streamfile_time_us() - time_start;
+    profile->bytes_requested += stats_end.bytes_requested - stats_start.bytes_requested;
+    profile->bytes_read += stats_end.bytes_read - stats_start.bytes_read;
+    if (vgmstream) {
+        profile->matches++;
+        get_vgmstream_meta_description(vgmstream, profile->meta_name, sizeof(profile->meta_name));
+    }
+
+    return vgmstream;
+}
+
+static VGMSTREAM * detect_vgmstream(STREAMFILE *streamFile) {
+    int i, j, fcns_size, hints_size;
+    uint32_t id;
+
+    fcns_size = (sizeof(init_vgmstream_functions)/sizeof(init_vgmstream_functions[0]));
+    hints_size = (sizeof(init_vgmstream_hints)/sizeof(init_vgmstream_hints[0]));
+    id = read_u32be(0x00, streamFile);
+
+    /* try likely formats first */
+    for (i = 0; i < hints_size; i++) {
+        VGMSTREAM * vgmstream;
+        if (!is_init_vgmstream_hint(&init_vgmstream_hints[i], streamFile, id))
+            continue;
 
+        vgmstream = try_init_vgmstream(streamFile, init_vgmstream_hints[i].init_vgmstream_function);
+        if (vgmstream)
+            return vgmstream;
+    }
 
-        setup_vgmstream(vgmstream); /* final setup */
+    /* try a series of formats, see which works */
+    for (i = 0; i < fcns_size; i++) {
+        VGMSTREAM * vgmstream;
+        int tried = 0;
+
+        /* skip candidates that already failed above */
+        for (j = 0; j < hints_size; j++) {
+            if (init_vgmstream_hints[j].init_vgmstream_function == init_vgmstream_functions[i] &&
+                    is_init_vgmstream_hint(&init_vgmstream_hints[j], streamFile, id)) {
+                tried = 1;
+                break;
+            }
+        }
+        if (tried)
+            continue;
 
-        return vgmstream;
+        vgmstream = try_init_vgmstream(streamFile, init_vgmstream_functions[i]);
+        if (vgmstream)
+            return vgmstream;
     }
 
     /* not supported */
     return NULL;
 }
 
+static VGMSTREAM * detect_vgmstream_index(STREAMFILE *streamFile, int init_index) {
+    int fcns_size = (sizeof(init_vgmstream_functions)/sizeof(init_vgmstream_functions[0]));
+    VGMSTREAM* vgmstream;
+
+    /* known format first (may fail if the file changed), then everything else */
+    if (init_index > 0 && init_index <= fcns_size) {
+        vgmstream = try_init_vgmstream(streamFile, init_vgmstream_functions[init_index - 1]);
+        if (vgmstream)
+            return vgmstream;
+    }
+
+    return detect_vgmstream(streamFile);
+}
+
+/* internal version with all parameters */
+static VGMSTREAM * init_vgmstream_internal(STREAMFILE *streamFile, int init_index) {
+    STREAMFILE* probe_sf;
+    VGMSTREAM* vgmstream;
+
+    if (!streamFile)
+        return NULL;
+
+    /* candidates read the header from memory (resulting streams reopen the file normally) */
+    probe_sf = open_probe_streamfile(streamFile);
+    if (!probe_sf)
+        return detect_vgmstream_index(streamFile, init_index);
+
+    vgmstream = detect_vgmstream_index(probe_sf, init_index);
+    close_streamfile(probe_sf);
+    return vgmstream;
+}
+
+static void resolve_layout_render(VGMSTREAM * vgmstream);
+
 void setup_vgmstream(VGMSTREAM * vgmstream) {
 
+    resolve_layout_render(vgmstream);
+
     /* save start things so we can restart when seeking */
     memcpy(vgmstream->start_ch, vgmstream->ch, sizeof(VGMSTREAMCHANNEL)*vgmstream->channels);
     memcpy(vgmstream->start_vgmstream, vgmstream, sizeof(VGMSTREAM));
@@ -648,7 +924,31 @@ VGMSTREAM * init_vgmstream(const char * const filename) {
 }
 
 VGMSTREAM * init_vgmstream_from_STREAMFILE(STREAMFILE *streamFile) {
-    return init_vgmstream_internal(streamFile);
+    return init_vgmstream_internal(streamFile, 0);
+}
+
+VGMSTREAM * init_vgmstream_from_STREAMFILE_index(STREAMFILE *streamFile, int init_index) {
+    return init_vgmstream_internal(streamFile, init_index);
+}
+
+uint32_t vgmstream_get_detection_version(void) {
+    int i, fcns_size = (sizeof(init_vgmstream_functions)/sizeof(init_vgmstream_functions[0]));
+    const char ** formats;
+    size_t formats_size;
+    uint32_t hash = 0x811C9DC5; /* FNV-1a */
+
+    /* new metas are added to the format list too, and may shift init indexes */
+    formats = vgmstream_get_formats(&formats_size);
+    for (i = 0; i < formats_size; i++) {
+        const char* ext = formats[i];
+        while (*ext) {
+            hash = (hash ^ (uint8_t)*ext++) * 0x01000193;
+        }
+        hash = (hash ^ ',') * 0x01000193;
+    }
+    hash = (hash ^ (uint32_t)fcns_size) * 0x01000193;
+
+    return hash;
 }
 
 /* Reset a VGMSTREAM to its state at the start of playback (when a plugin seeks back to zero). */
@@ -774,6 +1074,7 @@ void reset_vgmstream(VGMSTREAM * vgmstream) {
 /* Allocate memory and setup a VGMSTREAM */
 VGMSTREAM * allocate_vgmstream(int channel_count, int loop_flag) {
     VGMSTREAM * vgmstream;
+    pool_arena* arena;
 
     /* up to ~16-24 aren't too rare for multilayered files, more is probably a bug */
     if (channel_count <= 0 || channel_count > VGMSTREAM_MAX_CHANNELS) {
@@ -788,6 +1089,9 @@ VGMSTREAM * allocate_vgmstream(int channel_count, int loop_flag) {
      * - start_ch: ch clone copied on init_vgmstream and restored on reset_vgmstream
      * - loop_ch: ch clone copied on loop start and restored on loop end (vgmstream_do_loop)
      * - codec/layout_data: custom state for complex codecs or layouts, handled externally
+     * - arena: where all of the above but codec/layout data come from, freed at once on close
+     * - config/stream_name and rare codec tables in ch: info that doesn't change while playing,
+     *   allocated once in the arena and shared by the clones (only pointers are copied)
      *
      * Here we only create the basic structs to be filled, and only after init_vgmstream it
      * can be considered ready. Clones are shallow copies, in that they share alloc'ed struts
@@ -798,21 +1102,33 @@ VGMSTREAM * allocate_vgmstream(int channel_count, int loop_flag) {
      * take care clones are properly synced.
      */
 
+    /* one chunk fits the main structs and mixing setup (plus allocation headers), mixing buffers may take another */
+    arena = pool_arena_new(sizeof(VGMSTREAM) * 2 + sizeof(VGMSTREAMCHANNEL) * channel_count * 3 +
+            sizeof(play_config_t) + STREAM_NAME_SIZE + mixing_get_init_size() + 0x100);
+    if (!arena) return NULL;
+
     /* create vgmstream + main structs (other data is 0'ed) */
-    vgmstream = calloc(1,sizeof(VGMSTREAM));
-    if (!vgmstream) return NULL;
-    
-    vgmstream->start_vgmstream = calloc(1,sizeof(VGMSTREAM));
+    vgmstream = pool_arena_calloc(arena, 1,sizeof(VGMSTREAM));
+    if (!vgmstream) goto fail;
+    vgmstream->arena = arena;
+
+    vgmstream->start_vgmstream = pool_arena_calloc(arena, 1,sizeof(VGMSTREAM));
     if (!vgmstream->start_vgmstream) goto fail;
 
-    vgmstream->ch = calloc(channel_count,sizeof(VGMSTREAMCHANNEL));
+    vgmstream->config = pool_arena_calloc(arena, 1,sizeof(play_config_t));
+    if (!vgmstream->config) goto fail;
+
+    vgmstream->stream_name = pool_arena_calloc(arena, STREAM_NAME_SIZE,sizeof(char));
+    if (!vgmstream->stream_name) goto fail;
+
+    vgmstream->ch = pool_arena_calloc(arena, channel_count,sizeof(VGMSTREAMCHANNEL));
     if (!vgmstream->ch) goto fail;
 
-    vgmstream->start_ch = calloc(channel_count,sizeof(VGMSTREAMCHANNEL));
+    vgmstream->start_ch = pool_arena_calloc(arena, channel_count,sizeof(VGMSTREAMCHANNEL));
     if (!vgmstream->start_ch) goto fail;
 
     if (loop_flag) {
-        vgmstream->loop_ch = calloc(channel_count,sizeof(VGMSTREAMCHANNEL));
+        vgmstream->loop_ch = pool_arena_calloc(arena, channel_count,sizeof(VGMSTREAMCHANNEL));
         if (!vgmstream->loop_ch) goto fail;
     }
 
@@ -824,14 +1140,7 @@ VGMSTREAM * allocate_vgmstream(int channel_count, int loop_flag) {
     //vgmstream->stream_name_size = STREAM_NAME_SIZE;
     return vgmstream;
 fail:
-    if (vgmstream) {
-        mixing_close(vgmstream);
-        free(vgmstream->ch);
-        free(vgmstream->start_ch);
-        free(vgmstream->loop_ch);
-        free(vgmstream->start_vgmstream);
-    }
-    free(vgmstream);
+    pool_arena_free(arena);
     return NULL;
 }
 
@@ -989,12 +1298,11 @@ void close_vgmstream(VGMSTREAM * vgmstream) {
         }
     }
 
+    free_layout_blocked_index(vgmstream->block_index);
+    free(vgmstream->loop_codec_state);
+    free(vgmstream->profile);
     mixing_close(vgmstream);
-    free(vgmstream->ch);
-    free(vgmstream->start_ch);
-    free(vgmstream->loop_ch);
-    free(vgmstream->start_vgmstream);
-    free(vgmstream);
+    pool_arena_free(vgmstream->arena); /* vgmstream itself included */
 }
 
 /* calculate samples based on player's config */
@@ -1025,12 +1333,11 @@ void vgmstream_force_loop(VGMSTREAM* vgmstream, int loop_flag, int loop_start_sa
 
     /* this requires a bit more messing with the VGMSTREAM than I'm comfortable with... */
     if (loop_flag && !vgmstream->loop_flag && !vgmstream->loop_ch) {
-        vgmstream->loop_ch = calloc(vgmstream->channels,sizeof(VGMSTREAMCHANNEL));
+        vgmstream->loop_ch = pool_arena_calloc(vgmstream->arena, vgmstream->channels,sizeof(VGMSTREAMCHANNEL));
         if (!vgmstream->loop_ch) loop_flag = 0; /* ??? */
     }
     else if (!loop_flag && vgmstream->loop_flag) {
-        free(vgmstream->loop_ch); /* not important though */
-        vgmstream->loop_ch = NULL;
+        vgmstream->loop_ch = NULL; /* memory goes with the arena, not important though */
     }
 
     vgmstream->loop_flag = loop_flag;
@@ -1079,70 +1386,1075 @@ void vgmstream_set_loop_target(VGMSTREAM* vgmstream, int loop_target) {
     setup_vgmstream(vgmstream);
 }
 
+void vgmstream_apply_config(VGMSTREAM* vgmstream, vgmstream_cfg_t* vcfg) {
+    play_config_t* fcfg = vgmstream->config;
+    play_state_t* ps = &vgmstream->pstate;
+    vgmstream_cfg_t cfg = *vcfg;
 
-/* Decode data into sample buffer */
-void render_vgmstream(sample_t * buffer, int32_t sample_count, VGMSTREAM * vgmstream) {
-    switch (vgmstream->layout_type) {
-        case layout_interleave:
-            render_vgmstream_interleave(buffer,sample_count,vgmstream);
-            break;
-        case layout_none:
-            render_vgmstream_flat(buffer,sample_count,vgmstream);
-            break;
-        case layout_blocked_mxch:
-        case layout_blocked_ast:
-        case layout_blocked_halpst:
-        case layout_blocked_xa:
-        case layout_blocked_ea_schl:
-        case layout_blocked_ea_1snh:
-        case layout_blocked_caf:
-        case layout_blocked_wsi:
-        case layout_blocked_str_snds:
-        case layout_blocked_ws_aud:
-        case layout_blocked_matx:
-        case layout_blocked_dec:
-        case layout_blocked_vs:
-        case layout_blocked_mul:
-        case layout_blocked_gsb:
-        case layout_blocked_xvas:
-        case layout_blocked_thp:
-        case layout_blocked_filp:
-        case layout_blocked_ivaud:
-        case layout_blocked_ea_swvr:
-        case layout_blocked_adm:
-        case layout_blocked_bdsp:
-        case layout_blocked_tra:
-        case layout_blocked_ps2_iab:
-        case layout_blocked_vs_str:
-        case layout_blocked_rws:
-        case layout_blocked_hwas:
-        case layout_blocked_ea_sns:
-        case layout_blocked_awc:
-        case layout_blocked_vgs:
-        case layout_blocked_vawx:
-        case layout_blocked_xvag_subsong:
-        case layout_blocked_ea_wve_au00:
-        case layout_blocked_ea_wve_ad10:
-        case layout_blocked_sthd:
-        case layout_blocked_h4m:
-        case layout_blocked_xa_aiff:
-        case layout_blocked_vs_square:
-        case layout_blocked_vid1:
-        case layout_blocked_ubi_sce:
-            render_vgmstream_blocked(buffer,sample_count,vgmstream);
-            break;
-        case layout_segmented:
-            render_vgmstream_segmented(buffer,sample_count,vgmstream);
-            break;
-        case layout_layered:
-            render_vgmstream_layered(buffer,sample_count,vgmstream);
-            break;
-        default:
-            break;
+    /* honor suggested config (order matters, and config mixes with/overwrites player defaults) */
+    if (fcfg->play_forever && cfg.allow_play_forever) {
+        cfg.play_forever = 1;
+        cfg.ignore_loop = 0;
+    }
+    if (fcfg->loop_count_set) {
+        cfg.loop_count = fcfg->loop_count;
+        cfg.play_forever = 0;
+        cfg.ignore_loop = 0;
+    }
+    if (fcfg->fade_delay_set) {
+        cfg.fade_delay = fcfg->fade_delay;
+    }
+    if (fcfg->fade_time_set) {
+        cfg.fade_time = fcfg->fade_time;
+    }
+    if (fcfg->ignore_fade) {
+        cfg.ignore_fade = 1;
     }
 
-    mix_vgmstream(buffer, sample_count, vgmstream);
-}
+    if (fcfg->force_loop) {
+        cfg.ignore_loop = 0;
+        cfg.force_loop = 1;
+        cfg.really_force_loop = 0;
+    }
+    if (fcfg->really_force_loop) {
+        cfg.ignore_loop = 0;
+        cfg.force_loop = 0;
+        cfg.really_force_loop = 1;
+    }
+    if (fcfg->ignore_loop) {
+        cfg.ignore_loop = 1;
+        cfg.force_loop = 0;
+        cfg.really_force_loop = 0;
+    }
+
+    if (cfg.force_loop && !vgmstream->loop_flag) {
+        vgmstream_force_loop(vgmstream, 1, 0, vgmstream->num_samples);
+    }
+    if (cfg.really_force_loop) {
+        vgmstream_force_loop(vgmstream, 1, 0, vgmstream->num_samples);
+    }
+    if (cfg.ignore_loop) {
+        vgmstream_force_loop(vgmstream, 0, 0, 0);
+    }
+
+    /* remove non-compatible options */
+    if (!vgmstream->loop_flag) {
+        cfg.play_forever = 0;
+    }
+    if (cfg.play_forever) {
+        cfg.ignore_fade = 0;
+    }
+    if (cfg.loop_count < 0) {
+        cfg.loop_count = 0;
+    }
+    if (cfg.fade_time < 0) {
+        cfg.fade_time = 0;
+    }
+    if (cfg.fade_delay < 0) {
+        cfg.fade_delay = 0;
+    }
+
+    /* loop N times, but also play stream end instead of fading out */
+    if (cfg.loop_count > 0 && cfg.ignore_fade) {
+        vgmstream_set_loop_target(vgmstream, (int)cfg.loop_count);
+        cfg.fade_time = 0;
+        cfg.fade_delay = 0;
+    }
+    else if (vgmstream->loop_target) {
+        vgmstream_set_loop_target(vgmstream, 0);
+    }
+
+    ps->play_forever = cfg.play_forever;
+    ps->play_position = 0;
+    if (vgmstream->loop_flag) {
+        ps->play_duration = get_vgmstream_play_samples(cfg.loop_count, cfg.fade_time, cfg.fade_delay, vgmstream);
+        ps->fade_samples = (int32_t)(cfg.fade_time * vgmstream->sample_rate);
+    }
+    else {
+        ps->play_duration = vgmstream->num_samples;
+        ps->fade_samples = 0;
+    }
+    ps->fade_start = ps->play_duration - ps->fade_samples;
+
+    vgmstream->config_enabled = 1;
+
+    /* notify of new initial state */
+    setup_vgmstream(vgmstream);
+}
+
+int32_t vgmstream_get_samples(VGMSTREAM* vgmstream) {
+    if (!vgmstream->config_enabled)
+        return vgmstream->num_samples;
+    return vgmstream->pstate.play_duration;
+}
+
+
+/* Runs codec setup deferred by metas, once (resets restore start_vgmstream so it's cleared there too) */
+static void setup_vgmstream_codec(VGMSTREAM * vgmstream) {
+    void (*codec_setup)(struct _VGMSTREAM*) = vgmstream->codec_setup;
+
+    vgmstream->codec_setup = NULL;
+    ((VGMSTREAM*)vgmstream->start_vgmstream)->codec_setup = NULL;
+    codec_setup(vgmstream);
+}
+
+static void prepare_vgmstream_internal(VGMSTREAM * vgmstream, int fill_buffers) {
+    uint8_t buf[1];
+    int sub, ch;
+
+    if (vgmstream->codec_setup) {
+        setup_vgmstream_codec(vgmstream);
+    }
+
+    if (vgmstream->layout_type == layout_segmented && vgmstream->layout_data) {
+        segmented_layout_data* data = vgmstream->layout_data;
+        /* only the current segment takes buffers, later ones get the pooled ones of idle segments;
+         * closed segments are prepared by the preopen job when reopened */
+        for (sub = 0; sub < data->segment_count; sub++) {
+            if (data->segments[sub])
+                prepare_vgmstream_internal(data->segments[sub], fill_buffers && sub == data->current_segment);
+        }
+    }
+    else if (vgmstream->layout_type == layout_layered && vgmstream->layout_data) {
+        layered_layout_data* data = vgmstream->layout_data;
+        for (sub = 0; sub < data->layer_count; sub++) {
+            prepare_vgmstream_internal(data->layers[sub], fill_buffers);
+        }
+    }
+    else {
+        if (!vgmstream->layout_render || vgmstream->layout_render_type != vgmstream->layout_type)
+            resolve_layout_render(vgmstream);
+        if (vgmstream->layout_render == render_vgmstream_blocked)
+            prepare_layout_blocked(vgmstream);
+
+        /* first refills take the streamfile buffers (also after release_vgmstream_buffers) */
+        for (ch = 0; fill_buffers && ch < vgmstream->channels; ch++) {
+            if (vgmstream->ch[ch].streamfile)
+                read_streamfile(buf, vgmstream->ch[ch].offset, 1, vgmstream->ch[ch].streamfile);
+        }
+    }
+}
+
+void prepare_vgmstream(VGMSTREAM * vgmstream) {
+    prepare_vgmstream_internal(vgmstream, 1);
+}
+
+static void render_layout_none(sample_t * buffer, int32_t sample_count, VGMSTREAM * vgmstream) {
+    /* unknown layout, nothing to render */
+}
+
+/* Picks the layout's render function once, rather than switching on every render call */
+static void resolve_layout_render(VGMSTREAM * vgmstream) {
+    void (*render)(sample_t*, int32_t, VGMSTREAM*) = render_layout_none;
+
+    switch (vgmstream->layout_type) {
+        case layout_interleave:
+            render = render_vgmstream_interleave;
+            break;
+        case layout_none:
+            render = render_vgmstream_flat;
+            break;
+        case layout_blocked_mxch:
+        case layout_blocked_ast:
+        case layout_blocked_halpst:
+        case layout_blocked_xa:
+        case layout_blocked_ea_schl:
+        case layout_blocked_ea_1snh:
+        case layout_blocked_caf:
+        case layout_blocked_wsi:
+        case layout_blocked_str_snds:
+        case layout_blocked_ws_aud:
+        case layout_blocked_matx:
+        case layout_blocked_dec:
+        case layout_blocked_vs:
+        case layout_blocked_mul:
+        case layout_blocked_gsb:
+        case layout_blocked_xvas:
+        case layout_blocked_thp:
+        case layout_blocked_filp:
+        case layout_blocked_ivaud:
+        case layout_blocked_ea_swvr:
+        case layout_blocked_adm:
+        case layout_blocked_bdsp:
+        case layout_blocked_tra:
+        case layout_blocked_ps2_iab:
+        case layout_blocked_vs_str:
+        case layout_blocked_rws:
+        case layout_blocked_hwas:
+        case layout_blocked_ea_sns:
+        case layout_blocked_awc:
+        case layout_blocked_vgs:
+        case layout_blocked_vawx:
+        case layout_blocked_xvag_subsong:
+        case layout_blocked_ea_wve_au00:
+        case layout_blocked_ea_wve_ad10:
+        case layout_blocked_sthd:
+        case layout_blocked_h4m:
+        case layout_blocked_xa_aiff:
+        case layout_blocked_vs_square:
+        case layout_blocked_vid1:
+        case layout_blocked_ubi_sce:
+            render = render_vgmstream_blocked;
+            break;
+        case layout_segmented:
+            render = render_vgmstream_segmented;
+            break;
+        case layout_layered:
+            render = render_vgmstream_layered;
+            break;
+        default:
+            break;
+    }
+
+    vgmstream->layout_render = render;
+    vgmstream->layout_render_type = vgmstream->layout_type;
+}
+
+#define LOOP_PREFETCH_SECONDS 2     /* before loop end */
+#define LOOP_PREFETCH_SIZE 0x10000  /* per channel */
+
+/* Hints the streamfiles of a stream about to be restarted (segments, layers) to load its start */
+static void prefetch_start(VGMSTREAM * vgmstream) {
+    int i;
+
+    if (vgmstream->layout_type == layout_segmented && vgmstream->layout_data) {
+        segmented_layout_data* data = vgmstream->layout_data;
+        if (data->segments[0])
+            prefetch_start(data->segments[0]);
+    }
+    else if (vgmstream->layout_type == layout_layered && vgmstream->layout_data) {
+        layered_layout_data* data = vgmstream->layout_data;
+        for (i = 0; i < data->layer_count; i++) {
+            prefetch_start(data->layers[i]);
+        }
+    }
+    else {
+        for (i = 0; i < vgmstream->channels; i++) {
+            prefetch_streamfile(vgmstream->start_ch[i].streamfile, vgmstream->start_ch[i].offset, LOOP_PREFETCH_SIZE);
+        }
+    }
+}
+
+/* Near the loop end hints the streamfiles to load what is read after jumping back, which after a
+ * long loop is gone from their buffers (the first read would stall on slow storage). Codecs that
+ * read on their own (FFmpeg and such) only get their channels' offsets. Once per pass. */
+static void prefetch_loop(VGMSTREAM * vgmstream, int32_t sample_count) {
+    int ch;
+
+    if (!vgmstream->loop_flag || vgmstream->loop_prefetched)
+        return;
+    if (vgmstream->current_sample + sample_count < vgmstream->loop_end_sample - vgmstream->sample_rate * LOOP_PREFETCH_SECONDS)
+        return;
+
+    if (vgmstream->layout_type == layout_segmented) {
+        VGMSTREAM* segment = get_layout_segmented_loop(vgmstream);
+        if (segment)
+            prefetch_start(segment);
+    }
+    else {
+        if (!vgmstream->hit_loop)
+            return; /* loop start not saved yet */
+
+        for (ch = 0; ch < vgmstream->channels; ch++) {
+            prefetch_streamfile(vgmstream->loop_ch[ch].streamfile, vgmstream->loop_ch[ch].offset, LOOP_PREFETCH_SIZE);
+        }
+        /* block header, before the channel offsets */
+        if (vgmstream->layout_render == render_vgmstream_blocked && vgmstream->loop_block_offset < vgmstream->loop_ch[0].offset)
+            prefetch_streamfile(vgmstream->loop_ch[0].streamfile, vgmstream->loop_block_offset, vgmstream->loop_ch[0].offset - vgmstream->loop_block_offset);
+    }
+
+    vgmstream->loop_prefetched = 1;
+}
+
+/* Decode data into sample buffer (no mixing) */
+static void render_layout(sample_t * buffer, int32_t sample_count, VGMSTREAM * vgmstream) {
+    if (vgmstream->codec_setup) {
+        setup_vgmstream_codec(vgmstream);
+    }
+
+    prefetch_loop(vgmstream, sample_count);
+
+    /* sub-VGMSTREAMs made manually may skip setup_vgmstream, and a few metas tweak the layout later */
+    if (!vgmstream->layout_render || vgmstream->layout_render_type != vgmstream->layout_type) {
+        resolve_layout_render(vgmstream);
+    }
+
+    vgmstream->layout_render(buffer, sample_count, vgmstream);
+}
+
+/* Samples of sample_count that are before the play end (all if not using config or playing forever) */
+static int32_t get_play_samples_to_do(VGMSTREAM * vgmstream, int32_t sample_count) {
+    play_state_t* ps = &vgmstream->pstate;
+
+    if (!vgmstream->config_enabled || ps->play_forever)
+        return sample_count;
+    if (ps->play_position >= ps->play_duration)
+        return 0;
+    if (sample_count > ps->play_duration - ps->play_position)
+        return ps->play_duration - ps->play_position;
+    return sample_count;
+}
+
+/* First sample of samples_done (from play_position) inside the fade, or samples_done if none */
+static int32_t get_play_fade_first(VGMSTREAM * vgmstream, int32_t samples_done) {
+    play_state_t* ps = &vgmstream->pstate;
+
+    if (!vgmstream->config_enabled || ps->play_forever || ps->fade_samples <= 0)
+        return samples_done;
+    if (ps->play_position + samples_done <= ps->fade_start)
+        return samples_done;
+    if (ps->play_position >= ps->fade_start)
+        return 0;
+    return ps->fade_start - ps->play_position;
+}
+
+/* Fades out rendered samples and silences those past the end, then moves the play position */
+static void apply_play_state(sample_t * buffer, int32_t samples_done, int32_t sample_count, int channels, VGMSTREAM * vgmstream) {
+    play_state_t* ps = &vgmstream->pstate;
+    int32_t s = get_play_fade_first(vgmstream, samples_done);
+    int ch;
+
+    for (; s < samples_done; s++) {
+        float gain = (float)(ps->play_duration - (ps->play_position + s)) / ps->fade_samples;
+        for (ch = 0; ch < channels; ch++) {
+            buffer[s * channels + ch] = (sample_t)(buffer[s * channels + ch] * gain);
+        }
+    }
+
+    if (sample_count > samples_done)
+        memset(buffer + samples_done * channels, 0, (sample_count - samples_done) * channels * sizeof(sample_t));
+    if (vgmstream->config_enabled && !ps->play_forever)
+        ps->play_position += sample_count;
+}
+
+static void apply_play_state_float(float * buffer, int32_t samples_done, int32_t sample_count, int channels, VGMSTREAM * vgmstream) {
+    play_state_t* ps = &vgmstream->pstate;
+    int32_t s = get_play_fade_first(vgmstream, samples_done);
+    int ch;
+
+    for (; s < samples_done; s++) {
+        float gain = (float)(ps->play_duration - (ps->play_position + s)) / ps->fade_samples;
+        for (ch = 0; ch < channels; ch++) {
+            buffer[s * channels + ch] *= gain;
+        }
+    }
+
+    if (sample_count > samples_done)
+        memset(buffer + samples_done * channels, 0, (sample_count - samples_done) * channels * sizeof(float));
+    if (vgmstream->config_enabled && !ps->play_forever)
+        ps->play_position += sample_count;
+}
+
+/* Adds time since time_start to a render stage counter, if profiling */
+static void add_profile_render(VGMSTREAM * vgmstream, uint64_t time_start) {
+    vgmstream_profile_t* profile = vgmstream->profile;
+
+    profile->render_time_us += get_streamfile_time_us() - time_start;
+    profile->render_calls++;
+}
+
+/* Decode data into sample buffer */
+void render_vgmstream(sample_t * buffer, int32_t sample_count, VGMSTREAM * vgmstream) {
+    int32_t samples_to_do = get_play_samples_to_do(vgmstream, sample_count);
+    uint64_t time_start = vgmstream->profile ? get_streamfile_time_us() : 0;
+
+    VGM_ALLOC_CHECK_BEGIN();
+    render_layout(buffer, samples_to_do, vgmstream);
+    mix_vgmstream(buffer, samples_to_do, vgmstream);
+
+    if (vgmstream->config_enabled) {
+        vgmstream_profile_t* profile = vgmstream->profile;
+        uint64_t time_output = profile ? get_streamfile_time_us() : 0;
+        int input_channels, output_channels;
+
+        input_channels = output_channels = vgmstream->channels;
+        mixing_info(vgmstream, &input_channels, &output_channels);
+        apply_play_state(buffer, samples_to_do, sample_count, output_channels, vgmstream);
+        if (profile)
+            profile->output_time_us += get_streamfile_time_us() - time_output;
+    }
+    VGM_ALLOC_CHECK_END();
+
+    if (vgmstream->profile)
+        add_profile_render(vgmstream, time_start);
+}
+
+void render_vgmstream_unmixed(sample_t * buffer, int32_t sample_count, VGMSTREAM * vgmstream) {
+    uint64_t time_start = vgmstream->profile ? get_streamfile_time_us() : 0;
+
+    VGM_ALLOC_CHECK_BEGIN();
+    render_layout(buffer, sample_count, vgmstream);
+    VGM_ALLOC_CHECK_END();
+
+    if (vgmstream->profile)
+        add_profile_render(vgmstream, time_start);
+}
+
+#define RENDER_FLOAT_BUFFER_SIZE 0x2000 /* in samples, enough for 64ch * 128 */
+
+/* Renders float samples straight from the codec when nothing in between needs 16-bit samples
+ * (flat layout and no mixing), or 0 if not possible (caller must render and convert). */
+static int render_layout_float(float * buffer, int32_t sample_count, VGMSTREAM * vgmstream) {
+    if (vgmstream->layout_type != layout_none || mixing_is_enabled(vgmstream))
+        return 0;
+    if (!vgmstream_can_decode_float(vgmstream))
+        return 0;
+
+    if (vgmstream->codec_setup) {
+        setup_vgmstream_codec(vgmstream);
+    }
+
+    render_vgmstream_flat_float(buffer, sample_count, vgmstream);
+    return 1;
+}
+
+/* Same as apply_play_state for planes */
+static void apply_play_state_planar(sample_t ** planes, int32_t samples_done, int32_t sample_count, int channels, VGMSTREAM * vgmstream) {
+    play_state_t* ps = &vgmstream->pstate;
+    int32_t first = get_play_fade_first(vgmstream, samples_done);
+    int32_t s;
+    int ch;
+
+    for (ch = 0; ch < channels; ch++) {
+        sample_t* plane = planes[ch];
+
+        for (s = first; s < samples_done; s++) {
+            float gain = (float)(ps->play_duration - (ps->play_position + s)) / ps->fade_samples;
+            plane[s] = (sample_t)(plane[s] * gain);
+        }
+
+        if (sample_count > samples_done)
+            memset(plane + samples_done, 0, (sample_count - samples_done) * sizeof(sample_t));
+    }
+
+    if (vgmstream->config_enabled && !ps->play_forever)
+        ps->play_position += sample_count;
+}
+
+/* Renders planes straight from the codec when channels are decoded separately (flat layout,
+ * no mixing and a per-channel codec), or 0 if not possible (caller must render and split). */
+static int render_layout_planar(sample_t ** planes, int32_t sample_count, VGMSTREAM * vgmstream) {
+    if (vgmstream->layout_type != layout_none || mixing_is_enabled(vgmstream))
+        return 0;
+    if (!vgmstream_can_decode_planar(vgmstream))
+        return 0;
+
+    if (vgmstream->codec_setup) {
+        setup_vgmstream_codec(vgmstream);
+    }
+
+    render_vgmstream_flat_planar(planes, sample_count, vgmstream);
+    return 1;
+}
+
+/* Renders interleaved samples in chunks and splits them into planes */
+static void render_planar_chunked(sample_t ** planes, int32_t sample_count, VGMSTREAM * vgmstream) {
+    sample_t tmpbuf[RENDER_FLOAT_BUFFER_SIZE];
+    const vgm_kernels_t* kernels = vgm_get_kernels();
+    int input_channels, output_channels, max_channels;
+    int32_t samples_per_chunk, pos = 0;
+
+    input_channels = output_channels = vgmstream->channels;
+    mixing_info(vgmstream, &input_channels, &output_channels);
+    max_channels = input_channels > output_channels ? input_channels : output_channels;
+    if (max_channels <= 0)
+        return;
+    samples_per_chunk = RENDER_FLOAT_BUFFER_SIZE / max_channels;
+
+    while (sample_count > 0) {
+        int32_t samples_to_do = sample_count > samples_per_chunk ? samples_per_chunk : sample_count;
+        int32_t samples_to_play = get_play_samples_to_do(vgmstream, samples_to_do);
+
+        render_layout(tmpbuf, samples_to_play, vgmstream);
+        mix_vgmstream(tmpbuf, samples_to_play, vgmstream);
+        if (vgmstream->config_enabled)
+            apply_play_state(tmpbuf, samples_to_play, samples_to_do, output_channels, vgmstream);
+
+        kernels->s16_deinterleave(planes, pos, tmpbuf, output_channels, samples_to_do);
+
+        pos += samples_to_do;
+        sample_count -= samples_to_do;
+    }
+}
+
+/* Decode data into one buffer per output channel */
+void render_vgmstream_planar(sample_t ** planes, int32_t sample_count, VGMSTREAM * vgmstream) {
+    vgmstream_profile_t* profile = vgmstream->profile;
+    uint64_t time_start = profile ? get_streamfile_time_us() : 0;
+    int32_t samples_to_play = get_play_samples_to_do(vgmstream, sample_count);
+
+    VGM_ALLOC_CHECK_BEGIN();
+    if (render_layout_planar(planes, samples_to_play, vgmstream)) {
+        if (vgmstream->config_enabled) {
+            uint64_t time_output = profile ? get_streamfile_time_us() : 0;
+            apply_play_state_planar(planes, samples_to_play, sample_count, vgmstream->channels, vgmstream);
+            if (profile)
+                profile->output_time_us += get_streamfile_time_us() - time_output;
+        }
+    }
+    else {
+        render_planar_chunked(planes, sample_count, vgmstream);
+    }
+    VGM_ALLOC_CHECK_END();
+
+    if (profile)
+        add_profile_render(vgmstream, time_start);
+}
+
+/* Decode data into float buffer, passing the mixer's result without clamping to 16-bit */
+void render_vgmstream_float(float * buffer, int32_t sample_count, VGMSTREAM * vgmstream) {
+    sample_t tmpbuf[RENDER_FLOAT_BUFFER_SIZE];
+    vgmstream_profile_t* profile = vgmstream->profile;
+    uint64_t time_start = profile ? get_streamfile_time_us() : 0;
+    int input_channels, output_channels, max_channels;
+    int32_t samples_per_chunk;
+
+    input_channels = output_channels = vgmstream->channels;
+    mixing_info(vgmstream, &input_channels, &output_channels);
+    max_channels = input_channels > output_channels ? input_channels : output_channels;
+    if (max_channels <= 0)
+        return;
+    samples_per_chunk = RENDER_FLOAT_BUFFER_SIZE / max_channels;
+
+    VGM_ALLOC_CHECK_BEGIN();
+    while (sample_count > 0) {
+        int32_t samples_to_do = sample_count > samples_per_chunk ? samples_per_chunk : sample_count;
+        int32_t samples_to_play = get_play_samples_to_do(vgmstream, samples_to_do);
+
+        if (render_layout_float(buffer, samples_to_play, vgmstream)) {
+            output_channels = vgmstream->channels;
+        }
+        else {
+            render_layout(tmpbuf, samples_to_play, vgmstream);
+            output_channels = mix_vgmstream_float(tmpbuf, buffer, samples_to_play, vgmstream);
+        }
+        if (vgmstream->config_enabled) {
+            uint64_t time_output = profile ? get_streamfile_time_us() : 0;
+            apply_play_state_float(buffer, samples_to_play, samples_to_do, output_channels, vgmstream);
+            if (profile)
+                profile->output_time_us += get_streamfile_time_us() - time_output;
+        }
+
+        buffer += samples_to_do * output_channels;
+        sample_count -= samples_to_do;
+    }
+    VGM_ALLOC_CHECK_END();
+
+    if (profile)
+        add_profile_render(vgmstream, time_start);
+}
+
+/* Codecs whose samples only depend on their position (no history), so seeking is offset math */
+static int is_stateless_codec(VGMSTREAM * vgmstream) {
+    switch (vgmstream->coding_type) {
+        case coding_PCM16LE:
+        case coding_PCM16BE:
+        case coding_PCM16_int:
+        case coding_PCM8:
+        case coding_PCM8_int:
+        case coding_PCM8_U:
+        case coding_PCM8_U_int:
+        case coding_PCM8_SB:
+        case coding_ULAW:
+        case coding_ULAW_int:
+        case coding_ALAW:
+        case coding_PCMFLOAT:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+/* Sets channels of a stateless flat/interleave stream as they'd be after decoding up to sample */
+static void set_stateless_position(VGMSTREAM * vgmstream, int32_t sample, int32_t block_samples) {
+    VGMSTREAMCHANNEL* start_ch = vgmstream->start_ch;
+    int32_t blocks = block_samples ? sample / block_samples : 0;
+    int ch;
+
+    for (ch = 0; ch < vgmstream->channels; ch++) {
+        vgmstream->ch[ch].offset = start_ch[ch].offset + (off_t)blocks * vgmstream->interleave_block_size * vgmstream->channels;
+    }
+    vgmstream->current_sample = sample;
+    vgmstream->samples_into_block = block_samples ? sample % block_samples : sample;
+}
+
+static int seek_stateless(VGMSTREAM * vgmstream, int32_t seek_sample) {
+    VGMSTREAM* start = vgmstream->start_vgmstream;
+    int32_t block_samples = 0;
+
+    if (!is_stateless_codec(vgmstream) || vgmstream->codec_data)
+        return 0;
+    if (start->current_sample != 0 || start->samples_into_block != 0)
+        return 0;
+
+    /* first pass only (later loops are reached decoding forward) */
+    if (seek_sample >= vgmstream->num_samples)
+        return 0;
+    if (start->loop_flag && seek_sample > start->loop_end_sample)
+        return 0;
+
+    if (vgmstream->layout_type == layout_interleave) {
+        int frame_size = get_vgmstream_frame_size(vgmstream);
+        int samples_per_frame = get_vgmstream_samples_per_frame(vgmstream);
+
+        if (vgmstream->interleave_first_block_size || vgmstream->interleave_last_block_size)
+            return 0;
+        if (frame_size == 0 || samples_per_frame == 0)
+            return 0;
+        block_samples = vgmstream->interleave_block_size / frame_size * samples_per_frame;
+        if (block_samples == 0 && vgmstream->channels > 1)
+            return 0; /* mono without interleave works like flat */
+    }
+    else if (vgmstream->layout_type != layout_none) {
+        return 0;
+    }
+
+    reset_vgmstream(vgmstream);
+
+    if (vgmstream->loop_flag && seek_sample > vgmstream->loop_start_sample) {
+        set_stateless_position(vgmstream, vgmstream->loop_start_sample, block_samples);
+        save_loop_state(vgmstream);
+    }
+
+    set_stateless_position(vgmstream, seek_sample, block_samples);
+    return 1;
+}
+
+/* Moves NWA/iMUSE/ACM to the block with sample, as decoding up to it would */
+static void set_codec_block_position(VGMSTREAM * vgmstream, int32_t sample) {
+    if (vgmstream->coding_type == coding_NWA)
+        seek_nwa(((nwa_codec_data*)vgmstream->codec_data)->nwa, sample);
+    else if (vgmstream->coding_type == coding_ACM)
+        seek_acm(vgmstream->codec_data, sample);
+    else
+        seek_imuse(vgmstream, sample);
+    vgmstream->current_sample = sample;
+    vgmstream->samples_into_block = sample;
+}
+
+/* NWA/iMUSE blocks start at offsets from the header and decode on their own (as done on loops),
+ * ACM resumes from seek points saved as blocks are decoded */
+static int seek_codec_blocks(VGMSTREAM * vgmstream, int32_t seek_sample) {
+    VGMSTREAM* start = vgmstream->start_vgmstream;
+
+    if (!vgmstream->codec_data)
+        return 0;
+    if (vgmstream->coding_type == coding_NWA && !((nwa_codec_data*)vgmstream->codec_data)->nwa)
+        return 0;
+    if (vgmstream->coding_type == coding_ACM && !((acm_codec_data*)vgmstream->codec_data)->handle)
+        return 0;
+    if (vgmstream->coding_type != coding_NWA && vgmstream->coding_type != coding_IMUSE && vgmstream->coding_type != coding_ACM)
+        return 0;
+    if (start->current_sample != 0 || start->samples_into_block != 0)
+        return 0;
+
+    /* first pass only (later loops are reached decoding forward) */
+    if (seek_sample >= vgmstream->num_samples)
+        return 0;
+    if (start->loop_flag && seek_sample > start->loop_end_sample)
+        return 0;
+
+    reset_vgmstream(vgmstream);
+
+    /* iMUSE/ACM save their decoder state as loop state, so it must be there first */
+    if (vgmstream->loop_flag && seek_sample > vgmstream->loop_start_sample) {
+        set_codec_block_position(vgmstream, vgmstream->loop_start_sample);
+        save_loop_state(vgmstream);
+    }
+
+    set_codec_block_position(vgmstream, seek_sample);
+    return 1;
+}
+
+/* Current position counting played loops, as seeks are requested by players */
+static int32_t get_play_position(VGMSTREAM * vgmstream) {
+    VGMSTREAM* start = vgmstream->start_vgmstream;
+
+    if (vgmstream->loop_count > 0)
+        return vgmstream->current_sample + vgmstream->loop_count * (start->loop_end_sample - start->loop_start_sample);
+    return vgmstream->current_sample;
+}
+
+/* Decodes and discards samples from the current position */
+static void skip_samples(VGMSTREAM * vgmstream, int32_t samples_to_skip) {
+    sample_t tmpbuf[RENDER_FLOAT_BUFFER_SIZE];
+    int input_channels, output_channels;
+    int32_t samples_per_chunk;
+
+    input_channels = output_channels = vgmstream->channels;
+    mixing_info(vgmstream, &input_channels, &output_channels);
+    samples_per_chunk = RENDER_FLOAT_BUFFER_SIZE / (input_channels > 0 ? input_channels : 1);
+
+    while (samples_to_skip > 0) {
+        int32_t samples_to_do = samples_to_skip > samples_per_chunk ? samples_per_chunk : samples_to_skip;
+
+        render_layout(tmpbuf, samples_to_do, vgmstream); /* mixing is stateless, no need */
+        samples_to_skip -= samples_to_do;
+    }
+}
+
+void seek_vgmstream(VGMSTREAM * vgmstream, int32_t seek_sample) {
+    int loop_target = vgmstream->loop_target;
+    int done = 0;
+
+    if (seek_sample < 0)
+        seek_sample = 0;
+
+    /* jump directly when the layout/codec allows it,
+     * including setup deferred to the first render (direct seeks may not render) */
+    if (vgmstream->codec_setup) {
+        setup_vgmstream_codec(vgmstream);
+    }
+
+    if (vgmstream->layout_type == layout_segmented) {
+        done = seek_layout_segmented(vgmstream, seek_sample);
+    }
+    else if (vgmstream->block_index) {
+        done = seek_layout_blocked(vgmstream, seek_sample);
+    }
+    else if (vgmstream->coding_type == coding_NWA || vgmstream->coding_type == coding_IMUSE || vgmstream->coding_type == coding_ACM) {
+        done = seek_codec_blocks(vgmstream, seek_sample);
+    }
+    else {
+        done = seek_stateless(vgmstream, seek_sample);
+    }
+
+    /* otherwise decode forward from the current position, or the start if past it */
+    if (!done) {
+        int32_t play_position = get_play_position(vgmstream);
+
+        if (seek_sample < play_position) {
+            reset_vgmstream(vgmstream);
+            play_position = 0;
+        }
+
+        skip_samples(vgmstream, seek_sample - play_position);
+    }
+
+    /* resets restore the start state, host settings set after opening must stay */
+    if (vgmstream->loop_target != loop_target)
+        vgmstream_set_loop_target(vgmstream, loop_target);
+
+    vgmstream->pstate.play_position = seek_sample;
+}
+
+/* frames decoded before the target after an approximate jump, so history settles */
+#define APPROXIMATE_PREROLL_FRAMES 4
+
+/* Samples per frame of codecs whose state is only positions and ADPCM history (or HCA's current
+ * block), that approximate seeks can jump into. 0 if not supported. */
+static int32_t get_approximate_frame_samples(VGMSTREAM * vgmstream) {
+    switch (vgmstream->coding_type) {
+        case coding_PSX:
+        case coding_PSX_badflags:
+        case coding_NGC_DSP:
+        case coding_CRI_ADX:
+        case coding_CRI_ADX_fixed:
+        case coding_CRI_ADX_exp: /* not encrypted ADX, as keys change every frame */
+            return vgmstream->codec_data ? 0 : get_vgmstream_samples_per_frame(vgmstream);
+        case coding_CRI_HCA:
+            if (!vgmstream->codec_data || vgmstream->layout_type != layout_none)
+                return 0;
+            return ((hca_codec_data*)vgmstream->codec_data)->info.samplesPerBlock;
+        default:
+            return 0;
+    }
+}
+
+/* Jumps to a frame a few before sample with cleared history, then decodes forward to sample,
+ * so the position is exact and only preroll samples are decoded from a wrong state. */
+static void set_approximate_position(VGMSTREAM * vgmstream, int32_t sample, int32_t frame_samples, int32_t block_samples) {
+    int32_t start = sample - frame_samples * APPROXIMATE_PREROLL_FRAMES;
+    int ch;
+
+    start = start > 0 ? start / frame_samples * frame_samples : 0;
+    if (start > vgmstream->current_sample) {
+        if (vgmstream->coding_type == coding_CRI_HCA) {
+            seek_hca(vgmstream->codec_data, start);
+            vgmstream->current_sample = start;
+            vgmstream->samples_into_block = start;
+        }
+        else {
+            set_stateless_position(vgmstream, start, block_samples);
+            for (ch = 0; ch < vgmstream->channels; ch++) {
+                VGMSTREAMCHANNEL* stream = &vgmstream->ch[ch];
+                stream->adpcm_history1_16 = stream->adpcm_history2_16 = 0;
+                stream->adpcm_history3_16 = stream->adpcm_history4_16 = 0;
+                stream->adpcm_history1_32 = stream->adpcm_history2_32 = 0;
+                stream->adpcm_history3_32 = stream->adpcm_history4_32 = 0;
+            }
+        }
+    }
+
+    skip_samples(vgmstream, sample - vgmstream->current_sample);
+}
+
+static int seek_approximate(VGMSTREAM * vgmstream, int32_t seek_sample) {
+    VGMSTREAM* start = vgmstream->start_vgmstream;
+    int32_t frame_samples = get_approximate_frame_samples(vgmstream);
+    int32_t block_samples = 0;
+
+    if (frame_samples <= 0)
+        return 0;
+    if (start->current_sample != 0 || start->samples_into_block != 0)
+        return 0;
+
+    /* first pass only (later loops are reached decoding forward) */
+    if (seek_sample >= vgmstream->num_samples)
+        return 0;
+    if (start->loop_flag && seek_sample > start->loop_end_sample)
+        return 0;
+
+    if (vgmstream->layout_type == layout_interleave) {
+        int frame_size = get_vgmstream_frame_size(vgmstream);
+
+        if (vgmstream->interleave_first_block_size || vgmstream->interleave_last_block_size)
+            return 0;
+        if (frame_size == 0)
+            return 0;
+        block_samples = vgmstream->interleave_block_size / frame_size * frame_samples;
+        if (block_samples == 0 && vgmstream->channels > 1)
+            return 0;
+    }
+    else if (vgmstream->layout_type != layout_none) {
+        return 0;
+    }
+
+    /* just ahead is as fast decoding forward */
+    if (vgmstream->loop_count == 0 && seek_sample >= vgmstream->current_sample &&
+            seek_sample - vgmstream->current_sample <= frame_samples * (APPROXIMATE_PREROLL_FRAMES + 1))
+        return 0;
+
+    reset_vgmstream(vgmstream);
+
+    /* loop start state is saved once reached, so it's the same on later loops but approximate too */
+    if (vgmstream->loop_flag && seek_sample > vgmstream->loop_start_sample) {
+        set_approximate_position(vgmstream, vgmstream->loop_start_sample, frame_samples, block_samples);
+        save_loop_state(vgmstream);
+    }
+
+    set_approximate_position(vgmstream, seek_sample, frame_samples, block_samples);
+    return 1;
+}
+
+void seek_vgmstream_approximate(VGMSTREAM * vgmstream, int32_t seek_sample) {
+    int loop_target = vgmstream->loop_target;
+
+    if (seek_sample < 0)
+        seek_sample = 0;
+
+    if (vgmstream->codec_setup) {
+        setup_vgmstream_codec(vgmstream);
+    }
+
+    if (!seek_approximate(vgmstream, seek_sample)) {
+        seek_vgmstream(vgmstream, seek_sample);
+        return;
+    }
+
+    if (vgmstream->loop_target != loop_target)
+        vgmstream_set_loop_target(vgmstream, loop_target);
+
+    vgmstream->pstate.play_position = seek_sample;
+}
+
+/* Saved state of a vgmstream: the struct and channels (positions, ADPCM history, blocks, loop state),
+ * plus state of codecs that keep it in codec_data and of sub-VGMSTREAMs in layouts. */
+struct vgmstream_snapshot {
+    VGMSTREAM stream;
+    VGMSTREAMCHANNEL* ch;
+    VGMSTREAMCHANNEL* loop_ch;
+    void* codec_state;
+    int current_segment;
+    int sub_count;
+    vgmstream_snapshot** subs; /* layered: all layers, segmented: only current segment */
+    size_t size;
+};
+
+/* codecs whose codec_data can be saved (see each codec's save_x), NULL if not supported */
+static void* save_codec_state(VGMSTREAM* vgmstream, size_t* size) {
+    *size = 0;
+    switch (vgmstream->coding_type) {
+        case coding_RELIC:
+            return save_relic(vgmstream->codec_data, size);
+        case coding_UBI_ADPCM:
+            return save_ubi_adpcm(vgmstream->codec_data, size);
+        case coding_CIRCUS_VQ:
+            return save_circus_vq(vgmstream->codec_data, size);
+        case coding_IMUSE:
+            return save_imuse(vgmstream->codec_data, size);
+        case coding_CRI_HCA:
+            return save_hca(vgmstream->codec_data, size);
+        case coding_ACM:
+            return save_acm(vgmstream->codec_data, size);
+        default:
+            return NULL;
+    }
+}
+
+static void restore_codec_state(VGMSTREAM* vgmstream, const void* state) {
+    switch (vgmstream->coding_type) {
+        case coding_RELIC:
+            restore_relic(vgmstream->codec_data, state);
+            break;
+        case coding_UBI_ADPCM:
+            restore_ubi_adpcm(vgmstream->codec_data, state);
+            break;
+        case coding_CIRCUS_VQ:
+            restore_circus_vq(vgmstream->codec_data, state);
+            break;
+        case coding_IMUSE:
+            restore_imuse(vgmstream->codec_data, state);
+            break;
+        case coding_CRI_HCA:
+            restore_hca(vgmstream->codec_data, state);
+            break;
+        case coding_ACM:
+            restore_acm(vgmstream->codec_data, state);
+            break;
+        default:
+            break;
+    }
+}
+
+vgmstream_snapshot* vgmstream_save_snapshot(VGMSTREAM* vgmstream) {
+    vgmstream_snapshot* snapshot = NULL;
+    int i;
+
+    if (!vgmstream)
+        return NULL;
+    /* deferred setup changes codec_data on first render */
+    if (vgmstream->codec_setup)
+        return NULL;
+
+    snapshot = calloc(1, sizeof(vgmstream_snapshot));
+    if (!snapshot) goto fail;
+
+    memcpy(&snapshot->stream, vgmstream, sizeof(VGMSTREAM));
+    snapshot->size = sizeof(vgmstream_snapshot) + sizeof(VGMSTREAMCHANNEL) * vgmstream->channels * 2;
+
+    snapshot->ch = malloc(sizeof(VGMSTREAMCHANNEL) * vgmstream->channels);
+    if (!snapshot->ch) goto fail;
+    memcpy(snapshot->ch, vgmstream->ch, sizeof(VGMSTREAMCHANNEL) * vgmstream->channels);
+    if (vgmstream->loop_ch) {
+        snapshot->loop_ch = malloc(sizeof(VGMSTREAMCHANNEL) * vgmstream->channels);
+        if (!snapshot->loop_ch) goto fail;
+        memcpy(snapshot->loop_ch, vgmstream->loop_ch, sizeof(VGMSTREAMCHANNEL) * vgmstream->channels);
+    }
+
+    if (vgmstream->codec_data) {
+        size_t size;
+        snapshot->codec_state = save_codec_state(vgmstream, &size);
+        if (!snapshot->codec_state) goto fail;
+        snapshot->size += size;
+    }
+
+    if (vgmstream->layout_type == layout_layered && vgmstream->layout_data) {
+        layered_layout_data* data = vgmstream->layout_data;
+
+        snapshot->subs = calloc(data->layer_count, sizeof(vgmstream_snapshot*));
+        if (!snapshot->subs) goto fail;
+        snapshot->sub_count = data->layer_count;
+        for (i = 0; i < data->layer_count; i++) {
+            snapshot->subs[i] = vgmstream_save_snapshot(data->layers[i]);
+            if (!snapshot->subs[i]) goto fail;
+            snapshot->size += snapshot->subs[i]->size;
+        }
+    }
+    else if (vgmstream->layout_type == layout_segmented && vgmstream->layout_data) {
+        segmented_layout_data* data = vgmstream->layout_data;
+
+        /* segments that can be reopened may be closed, so saved ones may not exist later */
+        if (data->open_segment)
+            goto fail;
+
+        /* later segments are reset when reached */
+        snapshot->subs = calloc(1, sizeof(vgmstream_snapshot*));
+        if (!snapshot->subs) goto fail;
+        snapshot->sub_count = 1;
+        snapshot->current_segment = data->current_segment;
+        snapshot->subs[0] = vgmstream_save_snapshot(data->segments[data->current_segment]);
+        if (!snapshot->subs[0]) goto fail;
+        snapshot->size += snapshot->subs[0]->size;
+    }
+    else if (vgmstream->layout_data) {
+        goto fail;
+    }
+
+    return snapshot;
+fail:
+    vgmstream_free_snapshot(snapshot);
+    return NULL;
+}
+
+int vgmstream_restore_snapshot(VGMSTREAM* vgmstream, const vgmstream_snapshot* snapshot) {
+    void* block_index;
+    void* loop_codec_state;
+    void* profile;
+    int i;
+
+    if (!vgmstream || !snapshot)
+        return 0;
+    /* same vgmstream, so pointers in the saved struct are still valid */
+    if (snapshot->stream.ch != vgmstream->ch || snapshot->stream.codec_data != vgmstream->codec_data ||
+            snapshot->stream.layout_data != vgmstream->layout_data)
+        return 0;
+
+    /* shared and kept for the whole stream, may have been made after the snapshot */
+    block_index = vgmstream->block_index;
+    loop_codec_state = vgmstream->loop_codec_state;
+    profile = vgmstream->profile;
+
+    memcpy(vgmstream, &snapshot->stream, sizeof(VGMSTREAM));
+    vgmstream->block_index = block_index;
+    vgmstream->loop_codec_state = loop_codec_state;
+    vgmstream->profile = profile;
+    memcpy(vgmstream->ch, snapshot->ch, sizeof(VGMSTREAMCHANNEL) * vgmstream->channels);
+    if (vgmstream->loop_ch && snapshot->loop_ch)
+        memcpy(vgmstream->loop_ch, snapshot->loop_ch, sizeof(VGMSTREAMCHANNEL) * vgmstream->channels);
+
+    if (snapshot->codec_state)
+        restore_codec_state(vgmstream, snapshot->codec_state);
+
+    if (vgmstream->layout_type == layout_layered && vgmstream->layout_data) {
+        layered_layout_data* data = vgmstream->layout_data;
+
+        for (i = 0; i < snapshot->sub_count && i < data->layer_count; i++) {
+            if (!vgmstream_restore_snapshot(data->layers[i], snapshot->subs[i]))
+                return 0;
+        }
+        touch_layout_layered(data);
+    }
+    else if (vgmstream->layout_type == layout_segmented && vgmstream->layout_data) {
+        segmented_layout_data* data = vgmstream->layout_data;
+
+        data->current_segment = snapshot->current_segment;
+        if (!vgmstream_restore_snapshot(data->segments[data->current_segment], snapshot->subs[0]))
+            return 0;
+    }
+
+    return 1;
+}
+
+size_t vgmstream_snapshot_size(const vgmstream_snapshot* snapshot) {
+    return snapshot ? snapshot->size : 0;
+}
+
+void vgmstream_free_snapshot(vgmstream_snapshot* snapshot) {
+    int i;
+
+    if (!snapshot)
+        return;
+
+    for (i = 0; i < snapshot->sub_count; i++) {
+        vgmstream_free_snapshot(snapshot->subs[i]);
+    }
+    free(snapshot->subs);
+    free(snapshot->codec_state);
+    free(snapshot->ch);
+    free(snapshot->loop_ch);
+    free(snapshot);
+}
 
 /* Get the number of samples of a single frame (smallest self-contained sample group, 1/N channels) */
 int get_vgmstream_samples_per_frame(VGMSTREAM * vgmstream) {
@@ -1528,34 +2840,312 @@ int get_vgmstream_frame_size(VGMSTREAM * vgmstream) {
         case coding_CELT_FSB:
             return 0; /* varies, usually 0x80-100 */
 #endif
-        default: /* Vorbis, MPEG, ACM, etc */
-            return 0;
+        default: /* Vorbis, MPEG, ACM, etc */
+            return 0;
+    }
+}
+
+/* In NDS IMA the frame size is the block size, so the last one is short */
+int get_vgmstream_samples_per_shortframe(VGMSTREAM * vgmstream) {
+    switch (vgmstream->coding_type) {
+        case coding_NDS_IMA:
+            return (vgmstream->interleave_last_block_size-4)*2;
+        default:
+            return get_vgmstream_samples_per_frame(vgmstream);
+    }
+}
+int get_vgmstream_shortframe_size(VGMSTREAM * vgmstream) {
+    switch (vgmstream->coding_type) {
+        case coding_NDS_IMA:
+            return vgmstream->interleave_last_block_size;
+        default:
+            return get_vgmstream_frame_size(vgmstream);
+    }
+}
+
+static int low_power;
+
+void vgmstream_low_power_setup(int enabled) {
+    low_power = enabled;
+}
+
+int vgmstream_is_low_power(void) {
+    return low_power;
+}
+
+/* Host runner to decode channels in parallel, only enabled with vgmstream_channel_workers_setup. */
+static struct {
+    int min_channels;
+    int min_samples;
+    void (*run)(void (*job)(void*, int), void* job_data, int count, void* run_data);
+    void* run_data;
+} channel_workers;
+
+void vgmstream_channel_workers_setup(int min_channels, int min_samples, void (*run)(void (*job)(void*, int), void* job_data, int count, void* run_data), void* run_data) {
+    channel_workers.min_channels = min_channels;
+    channel_workers.min_samples = min_samples;
+    channel_workers.run = run;
+    channel_workers.run_data = run_data;
+}
+
+int vgmstream_can_run_parallel(int channels, int samples) {
+    return channel_workers.run && channels >= channel_workers.min_channels && samples >= channel_workers.min_samples;
+}
+
+int vgmstream_run_parallel(int channels, int samples, void (*job)(void*, int), void* job_data, int count) {
+    if (!vgmstream_can_run_parallel(channels, samples))
+        return 0;
+
+    return vgmstream_run_jobs(job, job_data, count);
+}
+
+int vgmstream_run_jobs(void (*job)(void*, int), void* job_data, int count) {
+    if (!channel_workers.run)
+        return 0;
+
+    channel_workers.run(job, job_data, count, channel_workers.run_data);
+    return 1;
+}
+
+typedef struct {
+    VGMSTREAM* vgmstream;
+    int samples_written;
+    int samples_to_do;
+    sample_t* buffer;
+    sample_t** planes;      /* if set, channels go to their own plane instead of buffer */
+} decode_channel_job_t;
+
+/* Codecs whose decoders only touch their own channel (state and streamfile), so each
+ * channel may be decoded in a different thread. Must match decode_channel_job.
+ * (PCM isn't worth it, conversion is cheaper than waking threads) */
+static int is_parallel_decoder(VGMSTREAM* vgmstream) {
+    switch (vgmstream->coding_type) {
+        case coding_CRI_ADX:
+        case coding_CRI_ADX_exp:
+        case coding_CRI_ADX_fixed:
+        case coding_CRI_ADX_enc_8:
+        case coding_CRI_ADX_enc_9:
+        case coding_NGC_DSP:
+        case coding_PSX:
+        case coding_PSX_badflags:
+        case coding_XA:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+/* Codecs that can also decode each channel into its own plane (see decode_channel_job) */
+static int is_planar_decoder(VGMSTREAM* vgmstream) {
+    switch (vgmstream->coding_type) {
+        case coding_PCM16LE:
+        case coding_PCM16BE:
+        case coding_PCM8:
+            return 1;
+        default:
+            return is_parallel_decoder(vgmstream);
+    }
+}
+
+/* decodes one channel, same as the decode_vgmstream loops */
+static void decode_channel_job(void* data, int ch) {
+    decode_channel_job_t* job = data;
+    VGMSTREAM* vgmstream = job->vgmstream;
+    VGMSTREAMCHANNEL* stream = &vgmstream->ch[ch];
+    sample_t* outbuf = job->planes ?
+            job->planes[ch] + job->samples_written :
+            job->buffer + job->samples_written*vgmstream->channels + ch;
+    int channelspacing = job->planes ? 1 : vgmstream->channels;
+    int32_t first_sample = vgmstream->samples_into_block;
+    int32_t samples_to_do = job->samples_to_do;
+
+    switch (vgmstream->coding_type) {
+        case coding_CRI_ADX:
+        case coding_CRI_ADX_exp:
+        case coding_CRI_ADX_fixed:
+        case coding_CRI_ADX_enc_8:
+        case coding_CRI_ADX_enc_9:
+            decode_adx(stream, outbuf, channelspacing, first_sample, samples_to_do,
+                    vgmstream->interleave_block_size, vgmstream->coding_type);
+            break;
+        case coding_NGC_DSP:
+            decode_ngc_dsp(stream, outbuf, channelspacing, first_sample, samples_to_do);
+            break;
+        case coding_PSX:
+            decode_psx(stream, outbuf, channelspacing, first_sample, samples_to_do, 0, vgmstream->codec_config);
+            break;
+        case coding_PSX_badflags:
+            decode_psx(stream, outbuf, channelspacing, first_sample, samples_to_do, 1, vgmstream->codec_config);
+            break;
+        case coding_XA:
+            decode_xa(stream, outbuf, channelspacing, first_sample, samples_to_do, ch);
+            break;
+        case coding_PCM16LE:
+            decode_pcm16le(stream, outbuf, channelspacing, first_sample, samples_to_do);
+            break;
+        case coding_PCM16BE:
+            decode_pcm16be(stream, outbuf, channelspacing, first_sample, samples_to_do);
+            break;
+        case coding_PCM8:
+            decode_pcm8(stream, outbuf, channelspacing, first_sample, samples_to_do);
+            break;
+        default:
+            break;
+    }
+}
+
+/* Codecs that decode independent substreams in parallel themselves, reading each from its channel's
+ * streamfile (so they need one per channel too) */
+static int is_parallel_substream_decoder(VGMSTREAM* vgmstream) {
+    switch (vgmstream->coding_type) {
+#ifdef VGM_USE_MPEG
+        case coding_MPEG_custom:
+        case coding_MPEG_ealayer3:
+        case coding_MPEG_layer1:
+        case coding_MPEG_layer2:
+        case coding_MPEG_layer3:
+            return mpeg_is_parallel_decoder(vgmstream->codec_data);
+#endif
+        default:
+            return 0;
+    }
+}
+
+/* Streams that may decode channels in parallel, opened with a streamfile per channel. */
+static int is_parallel_stream(VGMSTREAM* vgmstream) {
+    return channel_workers.run && vgmstream->channels >= channel_workers.min_channels &&
+            (is_parallel_decoder(vgmstream) || is_parallel_substream_decoder(vgmstream));
+}
+
+/* Decodes all channels through the host runner if worth it, returns 0 if not done. Channels
+ * sharing a streamfile (set by some metas/layouts) can't be read from different threads. */
+static int decode_vgmstream_parallel(VGMSTREAM * vgmstream, int samples_written, int samples_to_do, sample_t * buffer, sample_t ** planes) {
+    decode_channel_job_t job;
+    int i, j;
+
+    if (samples_to_do < channel_workers.min_samples || !is_parallel_decoder(vgmstream) || !is_parallel_stream(vgmstream))
+        return 0;
+
+    for (i = 0; i < vgmstream->channels; i++) {
+        if (!vgmstream->ch[i].streamfile)
+            return 0;
+        for (j = 0; j < i; j++) {
+            if (vgmstream->ch[i].streamfile == vgmstream->ch[j].streamfile)
+                return 0;
+        }
+    }
+
+    job.vgmstream = vgmstream;
+    job.samples_written = samples_written;
+    job.samples_to_do = samples_to_do;
+    job.buffer = buffer;
+    job.planes = planes;
+    return vgmstream_run_parallel(vgmstream->channels, samples_to_do, decode_channel_job, &job, vgmstream->channels);
+}
+
+static void decode_vgmstream_internal(VGMSTREAM * vgmstream, int samples_written, int samples_to_do, sample_t * buffer);
+
+int vgmstream_can_decode_float(VGMSTREAM * vgmstream) {
+    switch (vgmstream->coding_type) {
+#ifdef VGM_USE_FFMPEG
+        case coding_FFmpeg:
+            return ffmpeg_can_decode_float(vgmstream->codec_data);
+#endif
+#ifdef VGM_USE_VORBIS
+        case coding_VORBIS_custom:
+            return vorbis_custom_can_decode_float(vgmstream->codec_data);
+#endif
+        default:
+            return 0;
+    }
+}
+
+void decode_vgmstream_float(VGMSTREAM * vgmstream, int samples_written, int samples_to_do, float * buffer) {
+    vgmstream_profile_t* profile = vgmstream->profile;
+    uint64_t time_start = profile ? get_streamfile_time_us() : 0;
+
+    switch (vgmstream->coding_type) {
+#ifdef VGM_USE_FFMPEG
+        case coding_FFmpeg:
+            decode_ffmpeg_float(vgmstream,
+                          buffer+samples_written*vgmstream->channels,samples_to_do,vgmstream->channels);
+            break;
+#endif
+#ifdef VGM_USE_VORBIS
+        case coding_VORBIS_custom:
+            decode_vorbis_custom_float(vgmstream,
+                          buffer+samples_written*vgmstream->channels,samples_to_do,vgmstream->channels);
+            break;
+#endif
+        default:
+            memset(buffer + samples_written*vgmstream->channels, 0, samples_to_do * vgmstream->channels * sizeof(float));
+            break;
     }
-}
 
-/* In NDS IMA the frame size is the block size, so the last one is short */
-int get_vgmstream_samples_per_shortframe(VGMSTREAM * vgmstream) {
-    switch (vgmstream->coding_type) {
-        case coding_NDS_IMA:
-            return (vgmstream->interleave_last_block_size-4)*2;
-        default:
-            return get_vgmstream_samples_per_frame(vgmstream);
+    if (profile) {
+        profile->decode_time_us += get_streamfile_time_us() - time_start;
+        profile->decode_calls++;
     }
 }
-int get_vgmstream_shortframe_size(VGMSTREAM * vgmstream) {
-    switch (vgmstream->coding_type) {
-        case coding_NDS_IMA:
-            return vgmstream->interleave_last_block_size;
-        default:
-            return get_vgmstream_frame_size(vgmstream);
+
+int vgmstream_can_decode_planar(VGMSTREAM * vgmstream) {
+    return is_planar_decoder(vgmstream);
+}
+
+void decode_vgmstream_planar(VGMSTREAM * vgmstream, int samples_written, int samples_to_do, sample_t ** planes) {
+    vgmstream_profile_t* profile = vgmstream->profile;
+    uint64_t time_start = profile ? get_streamfile_time_us() : 0;
+    decode_channel_job_t job;
+    int ch;
+
+    if (!decode_vgmstream_parallel(vgmstream, samples_written, samples_to_do, NULL, planes)) {
+        job.vgmstream = vgmstream;
+        job.samples_written = samples_written;
+        job.samples_to_do = samples_to_do;
+        job.buffer = NULL;
+        job.planes = planes;
+
+        if (is_planar_decoder(vgmstream)) {
+            for (ch = 0; ch < vgmstream->channels; ch++) {
+                decode_channel_job(&job, ch);
+            }
+        }
+        else {
+            for (ch = 0; ch < vgmstream->channels; ch++) {
+                memset(planes[ch] + samples_written, 0, samples_to_do * sizeof(sample_t));
+            }
+        }
+    }
+
+    if (profile) {
+        profile->decode_time_us += get_streamfile_time_us() - time_start;
+        profile->decode_calls++;
     }
 }
 
 /* Decode samples into the buffer. Assume that we have written samples_written into the
  * buffer already, and we have samples_to_do consecutive samples ahead of us. */
 void decode_vgmstream(VGMSTREAM * vgmstream, int samples_written, int samples_to_do, sample_t * buffer) {
+    vgmstream_profile_t* profile = vgmstream->profile;
+    uint64_t time_start;
+
+    if (!profile) {
+        decode_vgmstream_internal(vgmstream, samples_written, samples_to_do, buffer);
+        return;
+    }
+
+    time_start = get_streamfile_time_us();
+    decode_vgmstream_internal(vgmstream, samples_written, samples_to_do, buffer);
+    profile->decode_time_us += get_streamfile_time_us() - time_start;
+    profile->decode_calls++;
+}
+
+static void decode_vgmstream_internal(VGMSTREAM * vgmstream, int samples_written, int samples_to_do, sample_t * buffer) {
     int ch;
 
+    if (decode_vgmstream_parallel(vgmstream, samples_written, samples_to_do, buffer, NULL))
+        return;
+
     switch (vgmstream->coding_type) {
         case coding_CRI_ADX:
         case coding_CRI_ADX_exp:
@@ -1779,10 +3369,8 @@ void decode_vgmstream(VGMSTREAM * vgmstream, int samples_written, int samples_to
             }
             break;
         case coding_EA_XA:
-            for (ch = 0; ch < vgmstream->channels; ch++) {
-                decode_ea_xa(&vgmstream->ch[ch],buffer+samples_written*vgmstream->channels+ch,
-                        vgmstream->channels,vgmstream->samples_into_block,samples_to_do, ch);
-            }
+            decode_ea_xa(vgmstream, buffer+samples_written*vgmstream->channels,
+                    vgmstream->samples_into_block, samples_to_do);
             break;
         case coding_EA_XA_int:
             for (ch = 0; ch < vgmstream->channels; ch++) {
@@ -1809,10 +3397,8 @@ void decode_vgmstream(VGMSTREAM * vgmstream, int samples_written, int samples_to
             }
             break;
         case coding_EA_XAS_V1:
-            for (ch = 0; ch < vgmstream->channels; ch++) {
-                decode_ea_xas_v1(&vgmstream->ch[ch],buffer+samples_written*vgmstream->channels+ch,
-                        vgmstream->channels,vgmstream->samples_into_block,samples_to_do, ch);
-            }
+            decode_ea_xas_v1(vgmstream, buffer+samples_written*vgmstream->channels,
+                    vgmstream->samples_into_block, samples_to_do);
             break;
 #ifdef VGM_USE_VORBIS
         case coding_OGG_VORBIS:
@@ -2142,10 +3728,8 @@ void decode_vgmstream(VGMSTREAM * vgmstream, int samples_written, int samples_to
             }
             break;
         case coding_MTA2:
-            for (ch = 0; ch < vgmstream->channels; ch++) {
-                decode_mta2(&vgmstream->ch[ch],buffer+samples_written*vgmstream->channels+ch,
-                        vgmstream->channels, vgmstream->samples_into_block, samples_to_do, ch);
-            }
+            decode_mta2(vgmstream, buffer+samples_written*vgmstream->channels,
+                    vgmstream->samples_into_block, samples_to_do);
             break;
         case coding_MC3:
             for (ch = 0; ch < vgmstream->channels; ch++) {
@@ -2224,6 +3808,48 @@ void decode_vgmstream(VGMSTREAM * vgmstream, int samples_written, int samples_to
     }
 }
 
+/* Decoders that handle any number of consecutive frames per call (from first_sample). */
+static int is_multiframe_decoder(VGMSTREAM* vgmstream) {
+    switch (vgmstream->coding_type) {
+        case coding_PSX:
+        case coding_PSX_badflags:
+        case coding_NGC_DSP:
+        case coding_CRI_ADX:
+        case coding_CRI_ADX_exp:
+        case coding_CRI_ADX_fixed:
+        case coding_CRI_ADX_enc_8:
+        case coding_CRI_ADX_enc_9:
+        case coding_MSADPCM:
+        case coding_MSADPCM_int:
+        case coding_MSADPCM_ck:
+        case coding_XA:
+        case coding_NDS_PROCYON:
+        case coding_ASF:
+        case coding_DSA:
+        case coding_XMD:
+        case coding_PTADPCM:
+        case coding_NGC_AFC:
+        case coding_NGC_DTK:
+        case coding_AICA_int:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+void vgmstream_update_frame_geometry(VGMSTREAM * vgmstream) {
+    vgmstream->frame_samples = get_vgmstream_samples_per_frame(vgmstream);
+    vgmstream->frame_bytes = get_vgmstream_frame_size(vgmstream);
+    vgmstream->frame_multi = is_multiframe_decoder(vgmstream);
+    vgmstream->frame_geometry_valid = 1;
+
+#ifdef VGM_USE_MAIATRAC3PLUS
+    /* frame samples follow the decoder's discard state here, so keep asking */
+    if (vgmstream->coding_type == coding_AT3plus)
+        vgmstream->frame_geometry_valid = 0;
+#endif
+}
+
 /* Calculate number of consecutive samples to do (taking into account stopping for loop start and end) */
 int vgmstream_samples_to_do(int samples_this_block, int samples_per_frame, VGMSTREAM * vgmstream) {
     int samples_to_do;
@@ -2232,26 +3858,28 @@ int vgmstream_samples_to_do(int samples_this_block, int samples_per_frame, VGMST
     samples_left_this_block = samples_this_block - vgmstream->samples_into_block;
     samples_to_do = samples_left_this_block;
 
-    /* fun loopy crap */
-    /* Why did I think this would be any simpler? */
+    /* fun loopy crap: stop just before the next loop event (start if not seen yet, otherwise end) */
     if (vgmstream->loop_flag) {
-        /* are we going to hit the loop end during this block? */
-        if (vgmstream->current_sample + samples_left_this_block > vgmstream->loop_end_sample) {
-            /* only do to just before it */
-            samples_to_do = vgmstream->loop_end_sample - vgmstream->current_sample;
-        }
+        int32_t block_end = vgmstream->current_sample + samples_left_this_block;
 
-        /* are we going to hit the loop start during this block? */
-        if (!vgmstream->hit_loop && vgmstream->current_sample + samples_left_this_block > vgmstream->loop_start_sample) {
-            /* only do to just before it */
+        if (!vgmstream->hit_loop && block_end > vgmstream->loop_start_sample)
             samples_to_do = vgmstream->loop_start_sample - vgmstream->current_sample;
-        }
-
+        else if (block_end > vgmstream->loop_end_sample)
+            samples_to_do = vgmstream->loop_end_sample - vgmstream->current_sample;
     }
 
     /* if it's a framed encoding don't do more than one frame */
-    if (samples_per_frame > 1 && (vgmstream->samples_into_block % samples_per_frame) + samples_to_do > samples_per_frame)
-        samples_to_do = samples_per_frame - (vgmstream->samples_into_block % samples_per_frame);
+    if (samples_per_frame > 1) {
+        int frame_pos;
+
+        if (!vgmstream->frame_geometry_valid)
+            vgmstream_update_frame_geometry(vgmstream);
+        if (!vgmstream->frame_multi) {
+            frame_pos = vgmstream->samples_into_block % samples_per_frame;
+            if (frame_pos + samples_to_do > samples_per_frame)
+                samples_to_do = samples_per_frame - frame_pos;
+        }
+    }
 
     return samples_to_do;
 }
@@ -2288,86 +3916,91 @@ int vgmstream_do_loop(VGMSTREAM * vgmstream) {
         }
 
 
-        /* prepare certain codecs' internal state for looping */
-
-        if (vgmstream->coding_type == coding_CIRCUS_VQ) {
-            seek_circus_vq(vgmstream->codec_data, vgmstream->loop_sample);
+        /* prepare certain codecs' internal state for looping: restore it as saved on loop start
+         * if possible (exact, and no need to decode from a frame before the loop), or seek */
+        if (vgmstream->loop_codec_state) {
+            restore_codec_state(vgmstream, vgmstream->loop_codec_state);
         }
+        else {
+            if (vgmstream->coding_type == coding_CIRCUS_VQ) {
+                seek_circus_vq(vgmstream->codec_data, vgmstream->loop_sample);
+            }
 
-        if (vgmstream->coding_type == coding_RELIC) {
-            seek_relic(vgmstream->codec_data, vgmstream->loop_sample);
-        }
+            if (vgmstream->coding_type == coding_RELIC) {
+                seek_relic(vgmstream->codec_data, vgmstream->loop_sample);
+            }
 
-        if (vgmstream->coding_type == coding_CRI_HCA) {
-            loop_hca(vgmstream->codec_data, vgmstream->loop_sample);
-        }
+            if (vgmstream->coding_type == coding_CRI_HCA) {
+                loop_hca(vgmstream->codec_data, vgmstream->loop_sample);
+            }
 
-        if (vgmstream->coding_type == coding_UBI_ADPCM) {
-            seek_ubi_adpcm(vgmstream->codec_data, vgmstream->loop_sample);
-        }
+            if (vgmstream->coding_type == coding_UBI_ADPCM) {
+                seek_ubi_adpcm(vgmstream->codec_data, vgmstream->loop_sample);
+            }
 
-        if (vgmstream->coding_type == coding_IMUSE) {
-            seek_imuse(vgmstream->codec_data, vgmstream->loop_sample);
-        }
+            if (vgmstream->coding_type == coding_IMUSE) {
+                seek_imuse(vgmstream, vgmstream->loop_sample);
+            }
 
-        if (vgmstream->coding_type == coding_EA_MT) {
-            seek_ea_mt(vgmstream, vgmstream->loop_sample);
-        }
+            if (vgmstream->coding_type == coding_EA_MT) {
+                seek_ea_mt(vgmstream, vgmstream->loop_sample);
+            }
 
 #ifdef VGM_USE_VORBIS
-        if (vgmstream->coding_type == coding_OGG_VORBIS) {
-            seek_ogg_vorbis(vgmstream, vgmstream->loop_sample);
-        }
+            if (vgmstream->coding_type == coding_OGG_VORBIS) {
+                seek_ogg_vorbis(vgmstream, vgmstream->loop_sample);
+            }
 
-        if (vgmstream->coding_type == coding_VORBIS_custom) {
-            seek_vorbis_custom(vgmstream, vgmstream->loop_sample);
-        }
+            if (vgmstream->coding_type == coding_VORBIS_custom) {
+                seek_vorbis_custom(vgmstream, vgmstream->loop_sample);
+            }
 #endif
 
 #ifdef VGM_USE_FFMPEG
-        if (vgmstream->coding_type == coding_FFmpeg) {
-            seek_ffmpeg(vgmstream, vgmstream->loop_sample);
-        }
+            if (vgmstream->coding_type == coding_FFmpeg) {
+                seek_ffmpeg(vgmstream, vgmstream->loop_sample);
+            }
 #endif
 
 #if defined(VGM_USE_MP4V2) && defined(VGM_USE_FDKAAC)
-        if (vgmstream->coding_type == coding_MP4_AAC) {
-            seek_mp4_aac(vgmstream, vgmstream->loop_sample);
-        }
+            if (vgmstream->coding_type == coding_MP4_AAC) {
+                seek_mp4_aac(vgmstream, vgmstream->loop_sample);
+            }
 #endif
 
 #ifdef VGM_USE_MAIATRAC3PLUS
-        if (vgmstream->coding_type == coding_AT3plus) {
-            seek_at3plus(vgmstream, vgmstream->loop_sample);
-        }
+            if (vgmstream->coding_type == coding_AT3plus) {
+                seek_at3plus(vgmstream, vgmstream->loop_sample);
+            }
 #endif
 
 #ifdef VGM_USE_ATRAC9
-        if (vgmstream->coding_type == coding_ATRAC9) {
-            seek_atrac9(vgmstream, vgmstream->loop_sample);
-        }
+            if (vgmstream->coding_type == coding_ATRAC9) {
+                seek_atrac9(vgmstream, vgmstream->loop_sample);
+            }
 #endif
 
 #ifdef VGM_USE_CELT
-        if (vgmstream->coding_type == coding_CELT_FSB) {
-            seek_celt_fsb(vgmstream, vgmstream->loop_sample);
-        }
+            if (vgmstream->coding_type == coding_CELT_FSB) {
+                seek_celt_fsb(vgmstream, vgmstream->loop_sample);
+            }
 #endif
 
 #ifdef VGM_USE_MPEG
-        if (vgmstream->coding_type == coding_MPEG_custom ||
-            vgmstream->coding_type == coding_MPEG_ealayer3 ||
-            vgmstream->coding_type == coding_MPEG_layer1 ||
-            vgmstream->coding_type == coding_MPEG_layer2 ||
-            vgmstream->coding_type == coding_MPEG_layer3) {
-            seek_mpeg(vgmstream, vgmstream->loop_sample);
-        }
+            if (vgmstream->coding_type == coding_MPEG_custom ||
+                vgmstream->coding_type == coding_MPEG_ealayer3 ||
+                vgmstream->coding_type == coding_MPEG_layer1 ||
+                vgmstream->coding_type == coding_MPEG_layer2 ||
+                vgmstream->coding_type == coding_MPEG_layer3) {
+                seek_mpeg(vgmstream, vgmstream->loop_sample);
+            }
 #endif
 
-        if (vgmstream->coding_type == coding_NWA) {
-            nwa_codec_data *data = vgmstream->codec_data;
-            if (data)
-                seek_nwa(data->nwa, vgmstream->loop_sample);
+            if (vgmstream->coding_type == coding_NWA) {
+                nwa_codec_data *data = vgmstream->codec_data;
+                if (data)
+                    seek_nwa(data->nwa, vgmstream->loop_sample);
+            }
         }
 
         /* restore! */
@@ -2378,6 +4011,8 @@ int vgmstream_do_loop(VGMSTREAM * vgmstream) {
         vgmstream->current_block_samples = vgmstream->loop_block_samples;
         vgmstream->current_block_offset = vgmstream->loop_block_offset;
         vgmstream->next_block_offset = vgmstream->loop_next_block_offset;
+        vgmstream->frame_geometry_valid = 0;
+        vgmstream->loop_prefetched = 0;
 
         return 1; /* looped */
     }
@@ -2385,20 +4020,31 @@ int vgmstream_do_loop(VGMSTREAM * vgmstream) {
 
     /* is this the loop start? */
     if (!vgmstream->hit_loop && vgmstream->current_sample == vgmstream->loop_start_sample) {
-        /* save! */
-        memcpy(vgmstream->loop_ch, vgmstream->ch, sizeof(VGMSTREAMCHANNEL)*vgmstream->channels);
-        vgmstream->loop_sample = vgmstream->current_sample;
-        vgmstream->loop_samples_into_block = vgmstream->samples_into_block;
-        vgmstream->loop_block_size = vgmstream->current_block_size;
-        vgmstream->loop_block_samples = vgmstream->current_block_samples;
-        vgmstream->loop_block_offset = vgmstream->current_block_offset;
-        vgmstream->loop_next_block_offset = vgmstream->next_block_offset;
-        vgmstream->hit_loop = 1;
+        save_loop_state(vgmstream);
     }
 
     return 0; /* not looped */
 }
 
+static void save_loop_state(VGMSTREAM * vgmstream) {
+    /* save! */
+    memcpy(vgmstream->loop_ch, vgmstream->ch, sizeof(VGMSTREAMCHANNEL)*vgmstream->channels);
+    vgmstream->loop_sample = vgmstream->current_sample;
+    vgmstream->loop_samples_into_block = vgmstream->samples_into_block;
+    vgmstream->loop_block_size = vgmstream->current_block_size;
+    vgmstream->loop_block_samples = vgmstream->current_block_samples;
+    vgmstream->loop_block_offset = vgmstream->current_block_offset;
+    vgmstream->loop_next_block_offset = vgmstream->next_block_offset;
+    vgmstream->hit_loop = 1;
+
+    /* same state on every pass, so once is enough (kept on resets) */
+    if (vgmstream->codec_data && !vgmstream->loop_codec_state && !vgmstream->codec_setup) {
+        size_t size;
+        vgmstream->loop_codec_state = save_codec_state(vgmstream, &size);
+        ((VGMSTREAM*)vgmstream->start_vgmstream)->loop_codec_state = vgmstream->loop_codec_state;
+    }
+}
+
 /* Write a description of the stream into array pointed by desc, which must be length bytes long.
  * Will always be null-terminated if length > 0 */
 void describe_vgmstream(VGMSTREAM * vgmstream, char * desc, int length) {
@@ -2555,8 +4201,90 @@ void describe_vgmstream(VGMSTREAM * vgmstream, char * desc, int length) {
 }
 
 
+/* Partner files that didn't pair (missing or different), as hashes of their name + the init function
+ * that tried them, so next opens of the same mono file (tags, then playback) don't try them again.
+ * Only enabled with vgmstream_dual_stereo_cache_setup. Older entries are overwritten. */
+#define DUAL_STEREO_CACHE_SIZE 64
+
+static struct {
+    int enabled;
+    uint64_t entries[DUAL_STEREO_CACHE_SIZE];
+    int count;
+    int next;
+    void (*lock)(void*);
+    void (*unlock)(void*);
+    void* lock_data;
+} dual_stereo_cache;
+
+void vgmstream_dual_stereo_cache_setup(int enabled, void (*lock)(void*), void (*unlock)(void*), void* lock_data) {
+    dual_stereo_cache.enabled = enabled;
+    dual_stereo_cache.count = 0;
+    dual_stereo_cache.next = 0;
+    dual_stereo_cache.lock = lock;
+    dual_stereo_cache.unlock = unlock;
+    dual_stereo_cache.lock_data = lock_data;
+}
+
+static uint64_t dual_stereo_cache_key(const char* filename, VGMSTREAM*(*init_vgmstream_function)(STREAMFILE *)) {
+    uint64_t hash = 0xCBF29CE484222325ULL; /* FNV-1a */
+    while (*filename) {
+        hash = (hash ^ (uint8_t)*filename++) * 0x100000001B3ULL;
+    }
+    return hash ^ (uint64_t)(uintptr_t)init_vgmstream_function;
+}
+
+/* returns 1 if key is a known failed partner, otherwise adds it if add is set */
+static int dual_stereo_cache_check(uint64_t key, int add) {
+    int i, found = 0;
+
+    if (!dual_stereo_cache.enabled)
+        return 0;
+
+    if (dual_stereo_cache.lock)
+        dual_stereo_cache.lock(dual_stereo_cache.lock_data);
+    for (i = 0; i < dual_stereo_cache.count; i++) {
+        if (dual_stereo_cache.entries[i] == key) {
+            found = 1;
+            break;
+        }
+    }
+    if (!found && add) {
+        dual_stereo_cache.entries[dual_stereo_cache.next] = key;
+        dual_stereo_cache.next = (dual_stereo_cache.next + 1) % DUAL_STEREO_CACHE_SIZE;
+        if (dual_stereo_cache.count < DUAL_STEREO_CACHE_SIZE)
+            dual_stereo_cache.count++;
+    }
+    if (dual_stereo_cache.unlock)
+        dual_stereo_cache.unlock(dual_stereo_cache.lock_data);
+
+    return found;
+}
+
 /* See if there is a second file which may be the second channel, given an already opened mono vgmstream.
  * If a suitable file is found, open it and change opened_vgmstream to a stereo vgmstream. */
+/* Copies a channel's arena tables to another stream's arena, for channels moved between streams */
+static int move_channel_tables(VGMSTREAM* vgmstream, VGMSTREAMCHANNEL* ch) {
+    if (ch->adpcm_coef_3by32) {
+        int32_t* coefs = pool_arena_calloc(vgmstream->arena, VGMSTREAM_L5_COEFS, sizeof(int32_t));
+        if (!coefs) return 0;
+        memcpy(coefs, ch->adpcm_coef_3by32, VGMSTREAM_L5_COEFS * sizeof(int32_t));
+        ch->adpcm_coef_3by32 = coefs;
+    }
+    if (ch->vadpcm_coefs) {
+        int16_t* coefs = pool_arena_calloc(vgmstream->arena, VGMSTREAM_VADPCM_COEFS, sizeof(int16_t));
+        if (!coefs) return 0;
+        memcpy(coefs, ch->vadpcm_coefs, VGMSTREAM_VADPCM_COEFS * sizeof(int16_t));
+        ch->vadpcm_coefs = coefs;
+    }
+    if (ch->vadpcm_book) {
+        int16_t* book = pool_arena_calloc(vgmstream->arena, VGMSTREAM_VADPCM_BOOK, sizeof(int16_t));
+        if (!book) return 0;
+        memcpy(book, ch->vadpcm_book, VGMSTREAM_VADPCM_BOOK * sizeof(int16_t));
+        ch->vadpcm_book = book;
+    }
+    return 1;
+}
+
 static void try_dual_file_stereo(VGMSTREAM * opened_vgmstream, STREAMFILE *streamFile, VGMSTREAM*(*init_vgmstream_function)(STREAMFILE *)) {
     /* filename search pairs for dual file stereo */
     static const char * const dfs_pairs[][2] = {
@@ -2576,6 +4304,7 @@ static void try_dual_file_stereo(VGMSTREAM * opened_vgmstream, STREAMFILE *strea
     VGMSTREAM *new_vgmstream = NULL;
     STREAMFILE *dual_streamFile = NULL;
     int i,j, dfs_pair_count, extension_len, filename_len;
+    uint64_t cache_key = 0;
 
     if (opened_vgmstream->channels != 1)
         return;
@@ -2629,8 +4358,13 @@ static void try_dual_file_stereo(VGMSTREAM * opened_vgmstream, STREAMFILE *strea
             if (dfs_pair != -1) {
                 //VGM_LOG("DFS: try %i: %s\n", dfs_pair, new_filename);
                 /* try to init other channel (new_filename now has the opposite name) */
-                dual_streamFile = open_streamfile(streamFile, new_filename);
+                cache_key = dual_stereo_cache_key(new_filename, init_vgmstream_function);
+                if (dual_stereo_cache_check(cache_key, 0))
+                    dual_streamFile = NULL;
+                else
+                    dual_streamFile = open_streamfile(streamFile, new_filename);
                 if (!dual_streamFile) {
+                    dual_stereo_cache_check(cache_key, 1);
                     /* restore filename and keep trying (if found it'll break and init) */
                     dfs_pair = -1;
                     get_streamfile_name(streamFile, new_filename, sizeof(new_filename));
@@ -2644,6 +4378,9 @@ static void try_dual_file_stereo(VGMSTREAM * opened_vgmstream, STREAMFILE *strea
         goto fail;
     //;VGM_LOG("DFS: match %i filename=%s\n", dfs_pair, new_filename);
 
+    /* metadata-only opens only need the partner's header (it's merged as-is, so it's the same mode) */
+    dual_streamFile->probe_only = streamFile->probe_only;
+
     new_vgmstream = init_vgmstream_function(dual_streamFile); /* use the init function that just worked */
     close_streamfile(dual_streamFile);
 
@@ -2662,7 +4399,7 @@ static void try_dual_file_stereo(VGMSTREAM * opened_vgmstream, STREAMFILE *strea
              * difficult to determine when it does, and they should be zero otherwise, anyway */
             new_vgmstream->interleave_block_size == opened_vgmstream->interleave_block_size &&
             new_vgmstream->interleave_last_block_size == opened_vgmstream->interleave_last_block_size)) {
-        goto fail;
+        goto mismatch;
     }
 
     /* check these even if there is no loop, because they should then be zero in both
@@ -2671,7 +4408,7 @@ static void try_dual_file_stereo(VGMSTREAM * opened_vgmstream, STREAMFILE *strea
             !(new_vgmstream->loop_flag      == opened_vgmstream->loop_flag &&
             new_vgmstream->loop_start_sample== opened_vgmstream->loop_start_sample &&
             new_vgmstream->loop_end_sample  == opened_vgmstream->loop_end_sample)) {
-        goto fail;
+        goto mismatch;
     }
 
     /* We seem to have a usable, matching file. Merge in the second channel. */
@@ -2680,40 +4417,24 @@ static void try_dual_file_stereo(VGMSTREAM * opened_vgmstream, STREAMFILE *strea
         VGMSTREAMCHANNEL * new_loop_chans = NULL;
         VGMSTREAMCHANNEL * new_start_chans = NULL;
 
-        /* build the channels */
-        new_chans = calloc(2,sizeof(VGMSTREAMCHANNEL));
+        /* build the channels (old 1ch arrays stay in the arena until close) */
+        new_chans = pool_arena_calloc(opened_vgmstream->arena, 2,sizeof(VGMSTREAMCHANNEL));
         if (!new_chans) goto fail;
 
         memcpy(&new_chans[dfs_pair],&opened_vgmstream->ch[0],sizeof(VGMSTREAMCHANNEL));
         memcpy(&new_chans[dfs_pair^1],&new_vgmstream->ch[0],sizeof(VGMSTREAMCHANNEL));
+        if (!move_channel_tables(opened_vgmstream, &new_chans[dfs_pair^1]))
+            goto fail;
 
         /* loop and start will be initialized later, we just need to allocate them here */
-        new_start_chans = calloc(2,sizeof(VGMSTREAMCHANNEL));
-        if (!new_start_chans) {
-            free(new_chans);
+        new_start_chans = pool_arena_calloc(opened_vgmstream->arena, 2,sizeof(VGMSTREAMCHANNEL));
+        if (!new_start_chans)
             goto fail;
-        }
 
         if (opened_vgmstream->loop_ch) {
-            new_loop_chans = calloc(2,sizeof(VGMSTREAMCHANNEL));
-            if (!new_loop_chans) {
-                free(new_chans);
-                free(new_start_chans);
+            new_loop_chans = pool_arena_calloc(opened_vgmstream->arena, 2,sizeof(VGMSTREAMCHANNEL));
+            if (!new_loop_chans)
                 goto fail;
-            }
-        }
-
-        /* remove the existing structures */
-        /* not using close_vgmstream as that would close the file */
-        free(opened_vgmstream->ch);
-        free(new_vgmstream->ch);
-
-        free(opened_vgmstream->start_ch);
-        free(new_vgmstream->start_ch);
-
-        if (opened_vgmstream->loop_ch) {
-            free(opened_vgmstream->loop_ch);
-            free(new_vgmstream->loop_ch);
         }
 
         /* fill in the new structures */
@@ -2724,15 +4445,16 @@ static void try_dual_file_stereo(VGMSTREAM * opened_vgmstream, STREAMFILE *strea
         /* stereo! */
         opened_vgmstream->channels = 2;
 
-        /* discard the second VGMSTREAM */
+        /* discard the second VGMSTREAM (not using close_vgmstream as that would close the file) */
         mixing_close(new_vgmstream);
-        free(new_vgmstream->start_vgmstream);
-        free(new_vgmstream);
+        pool_arena_free(new_vgmstream->arena);
 
         mixing_update_channel(opened_vgmstream); /* notify of new channel hacked-in */
     }
 
     return;
+mismatch:
+    dual_stereo_cache_check(cache_key, 1);
 fail:
     close_vgmstream(new_vgmstream);
     return;
@@ -2797,15 +4519,24 @@ static int get_vgmstream_file_bitrate_main(VGMSTREAM * vgmstream, STREAMFILE **s
      * fool this in various ways; metas should report stream_size in complex cases
      * to get accurate bitrates (particularly for subsongs). */
 
-    if (vgmstream->stream_size) {
+    if (vgmstream->bitrate) {
+        bitrate = vgmstream->bitrate;
+    }
+    else if (vgmstream->stream_size) {
         bitrate = get_vgmstream_file_bitrate_from_size(vgmstream->stream_size, vgmstream->sample_rate, vgmstream->num_samples);
     }
     else if (vgmstream->layout_type == layout_segmented) {
         segmented_layout_data *data = (segmented_layout_data *) vgmstream->layout_data;
-        for (sub = 0; sub < data->segment_count; sub++) {
-            bitrate += get_vgmstream_file_bitrate_main(data->segments[sub], streamfile_pointers, pointers_count, pointers_max);
+        if (data->open_segment) {
+            /* segments that can be reopened may be closed */
+            bitrate = data->average_bitrate;
+        }
+        else {
+            for (sub = 0; sub < data->segment_count; sub++) {
+                bitrate += get_vgmstream_file_bitrate_main(data->segments[sub], streamfile_pointers, pointers_count, pointers_max);
+            }
+            bitrate = bitrate / data->segment_count;
         }
-        bitrate = bitrate / data->segment_count;
     }
     else if (vgmstream->layout_type == layout_layered) {
         layered_layout_data *data = vgmstream->layout_data;
@@ -2817,25 +4548,36 @@ static int get_vgmstream_file_bitrate_main(VGMSTREAM * vgmstream, STREAMFILE **s
     else {
         /* Add channel bitrate if streamfile hasn't been used before (comparing files
          * by absolute paths), so bitrate doesn't multiply when the same STREAMFILE is
-         * reopened per channel, also skipping repeated pointers. */
+         * reopened per channel, also skipping repeated pointers. Reopens usually share
+         * their kept name, so most compares are by pointer and nothing is copied. */
         char path_current[PATH_LIMIT];
         char path_compare[PATH_LIMIT];
         int is_unique = 1;
 
         for (ch = 0; ch < vgmstream->channels; ch++) {
             STREAMFILE * currentFile = get_vgmstream_average_bitrate_channel_streamfile(vgmstream, ch);
+            const char * name_current;
             if (!currentFile) continue;
-            get_streamfile_name(currentFile, path_current, sizeof(path_current));
+            name_current = get_streamfile_name_ref(currentFile);
+            if (!name_current) {
+                get_streamfile_name(currentFile, path_current, sizeof(path_current));
+                name_current = path_current;
+            }
 
             for (sub = 0; sub < *pointers_count; sub++) {
                 STREAMFILE * compareFile = streamfile_pointers[sub];
+                const char * name_compare;
                 if (!compareFile) continue;
                 if (currentFile == compareFile) {
                     is_unique = 0;
                     break;
                 }
-                get_streamfile_name(compareFile, path_compare, sizeof(path_compare));
-                if (strcmp(path_current, path_compare) == 0) {
+                name_compare = get_streamfile_name_ref(compareFile);
+                if (!name_compare) {
+                    get_streamfile_name(compareFile, path_compare, sizeof(path_compare));
+                    name_compare = path_compare;
+                }
+                if (name_compare == name_current || strcmp(name_current, name_compare) == 0) {
                     is_unique = 0;
                     break;
                 }
@@ -2864,10 +4606,209 @@ int get_vgmstream_average_bitrate(VGMSTREAM * vgmstream) {
     const size_t pointers_max = 128; /* arbitrary max, but +100 segments have been observed */
     STREAMFILE *streamfile_pointers[128]; /* list already used streamfiles */
     int pointers_count = 0;
+    int bitrate;
+
+    /* walking layouts and comparing every channel's file is slow for big segment/layer lists,
+     * and results don't change once opened (kept in the start copy too, to survive resets) */
+    if (vgmstream->average_bitrate)
+        return vgmstream->average_bitrate < 0 ? 0 : vgmstream->average_bitrate;
+
+    bitrate = get_vgmstream_file_bitrate_main(vgmstream, streamfile_pointers, &pointers_count, pointers_max);
+
+    vgmstream->average_bitrate = bitrate > 0 ? bitrate : -1;
+    if (vgmstream->start_vgmstream)
+        ((VGMSTREAM*)vgmstream->start_vgmstream)->average_bitrate = vgmstream->average_bitrate;
+    return bitrate;
+}
+
+
+static void add_vgmstream_io_stats(STREAMFILE* sf, streamfile_stats_t* stats, STREAMFILE** streamfile_pointers, int* pointers_count, int pointers_max) {
+    streamfile_stats_t sf_stats;
+    int i;
+
+    /* each streamfile counts once (by pointer), as every reopen has its own buffer and counters */
+    if (!sf) return;
+    for (i = 0; i < *pointers_count; i++) {
+        if (streamfile_pointers[i] == sf)
+            return;
+    }
+    if (*pointers_count >= pointers_max) return;
+    streamfile_pointers[*pointers_count] = sf;
+    (*pointers_count)++;
+
+    get_streamfile_stats(sf, &sf_stats);
+    stats->read_calls += sf_stats.read_calls;
+    stats->bytes_requested += sf_stats.bytes_requested;
+    stats->bytes_read += sf_stats.bytes_read;
+    stats->buffer_hits += sf_stats.buffer_hits;
+    stats->buffer_misses += sf_stats.buffer_misses;
+    stats->rebuffers_back += sf_stats.rebuffers_back;
+    stats->read_time_us += sf_stats.read_time_us;
+    stats->buffer_size += sf_stats.buffer_size;
+    stats->buffer_peak += sf_stats.buffer_peak;
+}
+
+static void get_vgmstream_io_stats_main(VGMSTREAM* vgmstream, streamfile_stats_t* stats, STREAMFILE** streamfile_pointers, int* pointers_count, int pointers_max) {
+    int sub, ch;
+
+    if (vgmstream->layout_type == layout_segmented) {
+        segmented_layout_data* data = vgmstream->layout_data;
+        for (sub = 0; sub < data->segment_count; sub++) {
+            if (!data->segments[sub]) /* closed until reopened */
+                continue;
+            get_vgmstream_io_stats_main(data->segments[sub], stats, streamfile_pointers, pointers_count, pointers_max);
+        }
+    }
+    else if (vgmstream->layout_type == layout_layered) {
+        layered_layout_data* data = vgmstream->layout_data;
+        for (sub = 0; sub < data->layer_count; sub++) {
+            get_vgmstream_io_stats_main(data->layers[sub], stats, streamfile_pointers, pointers_count, pointers_max);
+        }
+    }
+    else {
+        /* channel streamfiles, plus the ones codecs may use instead */
+        for (ch = 0; ch < vgmstream->channels; ch++) {
+            add_vgmstream_io_stats(vgmstream->ch[ch].streamfile, stats, streamfile_pointers, pointers_count, pointers_max);
+            add_vgmstream_io_stats(get_vgmstream_average_bitrate_channel_streamfile(vgmstream, ch), stats, streamfile_pointers, pointers_count, pointers_max);
+        }
+    }
+}
+
+/* Sums I/O counters of all streamfiles used by this stream (channels, layers, segments). */
+void get_vgmstream_io_stats(VGMSTREAM* vgmstream, streamfile_stats_t* stats) {
+    const size_t pointers_max = 256;
+    STREAMFILE* streamfile_pointers[256];
+    int pointers_count = 0;
+
+    memset(stats, 0, sizeof(streamfile_stats_t));
+    if (!vgmstream)
+        return;
+    get_vgmstream_io_stats_main(vgmstream, stats, streamfile_pointers, &pointers_count, pointers_max);
+}
+
+void release_vgmstream_buffers(VGMSTREAM* vgmstream) {
+    int sub, ch;
+
+    if (!vgmstream)
+        return;
+
+    if (vgmstream->layout_type == layout_segmented && vgmstream->layout_data) {
+        segmented_layout_data* data = vgmstream->layout_data;
+        for (sub = 0; sub < data->segment_count; sub++) {
+            release_vgmstream_buffers(data->segments[sub]); /* may be closed */
+        }
+    }
+    else if (vgmstream->layout_type == layout_layered && vgmstream->layout_data) {
+        layered_layout_data* data = vgmstream->layout_data;
+        for (sub = 0; sub < data->layer_count; sub++) {
+            release_vgmstream_buffers(data->layers[sub]);
+        }
+    }
+    else {
+        /* shared streamfiles are released more than once, which is harmless */
+        for (ch = 0; ch < vgmstream->channels; ch++) {
+            release_streamfile_buffer(vgmstream->ch[ch].streamfile);
+            release_streamfile_buffer(get_vgmstream_average_bitrate_channel_streamfile(vgmstream, ch));
+        }
+    }
+}
+
+void vgmstream_set_profiling(VGMSTREAM* vgmstream, int enabled) {
+    VGMSTREAM* start;
+    int sub;
+
+    if (!vgmstream)
+        return;
+    start = vgmstream->start_vgmstream;
+
+    if (vgmstream->layout_type == layout_segmented && vgmstream->layout_data) {
+        segmented_layout_data* data = vgmstream->layout_data;
+        for (sub = 0; sub < data->segment_count; sub++) {
+            if (!data->segments[sub]) /* closed until reopened (enabled then) */
+                continue;
+            vgmstream_set_profiling(data->segments[sub], enabled);
+        }
+    }
+    else if (vgmstream->layout_type == layout_layered && vgmstream->layout_data) {
+        layered_layout_data* data = vgmstream->layout_data;
+        for (sub = 0; sub < data->layer_count; sub++) {
+            vgmstream_set_profiling(data->layers[sub], enabled);
+        }
+    }
+
+    if (enabled && !vgmstream->profile) {
+        vgmstream_profile_t* profile = calloc(1, sizeof(vgmstream_profile_t));
+        streamfile_stats_t stats;
+
+        /* streamfile read time so far, as the base to subtract (other counters start at 0) */
+        if (profile) {
+            get_vgmstream_io_stats(vgmstream, &stats);
+            profile->read_time_us = stats.read_time_us;
+        }
+        vgmstream->profile = profile;
+    }
+    else if (!enabled && vgmstream->profile) {
+        free(vgmstream->profile);
+        vgmstream->profile = NULL;
+    }
+
+    /* resets restore the start copy */
+    if (start)
+        start->profile = vgmstream->profile;
+}
+
+static void add_vgmstream_profile_stages(VGMSTREAM* vgmstream, vgmstream_profile_t* profile) {
+    vgmstream_profile_t* current = vgmstream->profile;
+    int sub, i;
+
+    if (vgmstream->layout_type == layout_segmented && vgmstream->layout_data) {
+        segmented_layout_data* data = vgmstream->layout_data;
+        for (sub = 0; sub < data->segment_count; sub++) {
+            if (!data->segments[sub])
+                continue;
+            /* playlists may repeat the same segment */
+            for (i = 0; i < sub; i++) {
+                if (data->segments[i] == data->segments[sub])
+                    break;
+            }
+            if (i == sub)
+                add_vgmstream_profile_stages(data->segments[sub], profile);
+        }
+    }
+    else if (vgmstream->layout_type == layout_layered && vgmstream->layout_data) {
+        layered_layout_data* data = vgmstream->layout_data;
+        for (sub = 0; sub < data->layer_count; sub++) {
+            add_vgmstream_profile_stages(data->layers[sub], profile);
+        }
+    }
 
-    return get_vgmstream_file_bitrate_main(vgmstream, streamfile_pointers, &pointers_count, pointers_max);
+    if (!current)
+        return;
+    profile->decode_calls += current->decode_calls;
+    profile->decode_time_us += current->decode_time_us;
+    profile->layout_time_us += current->layout_time_us;
+    profile->mix_time_us += current->mix_time_us;
+    profile->output_time_us += current->output_time_us;
 }
 
+void vgmstream_get_profile(VGMSTREAM* vgmstream, vgmstream_profile_t* profile) {
+    vgmstream_profile_t* current;
+    streamfile_stats_t stats;
+
+    memset(profile, 0, sizeof(vgmstream_profile_t));
+    if (!vgmstream || !vgmstream->profile)
+        return;
+    current = vgmstream->profile;
+
+    profile->render_calls = current->render_calls;
+    profile->render_time_us = current->render_time_us;
+    add_vgmstream_profile_stages(vgmstream, profile);
+
+    /* streamfiles count reads since opened, so only the part after profiling was enabled (read_time_us is the base) */
+    get_vgmstream_io_stats(vgmstream, &stats);
+    if (stats.read_time_us > current->read_time_us)
+        profile->read_time_us = stats.read_time_us - current->read_time_us;
+}
 
 /**
  * Inits vgmstream, doing two things:
@@ -2880,10 +4821,14 @@ int vgmstream_open_stream(VGMSTREAM* vgmstream, STREAMFILE* sf, off_t start_offs
 }
 int vgmstream_open_stream_bf(VGMSTREAM* vgmstream, STREAMFILE* sf, off_t start_offset, int force_multibuffer) {
     STREAMFILE* file = NULL;
-    char filename[PATH_LIMIT];
+    char filename_buf[PATH_LIMIT];
+    const char* filename;
+    size_t buffer_size;
     int ch;
     int use_streamfile_per_channel = 0;
     int use_same_offset_per_channel = 0;
+    int use_interleave_buffer = 0;
+    int use_parallel_streamfiles = 0;
     int is_stereo_codec = 0;
 
 
@@ -2976,6 +4921,26 @@ int vgmstream_open_stream_bf(VGMSTREAM* vgmstream, STREAMFILE* sf, off_t start_o
         use_streamfile_per_channel = 1;
     }
 
+    /* channels decoded in parallel can't share a streamfile (more reads, but shared pages help) */
+    if (is_parallel_stream(vgmstream)) {
+        use_streamfile_per_channel = 1;
+        use_parallel_streamfiles = 1;
+    }
+
+    /* metadata-only: a single buffer is enough for metas that walk blocks to count samples */
+    if (sf && sf->probe_only) {
+        use_streamfile_per_channel = 0;
+    }
+
+    /* big interleaves: channels read the same rows at once, so a single buffer holding whole rows
+     * can serve all of them (a buffer per channel mostly reads and discards other channels' blocks) */
+    if (use_streamfile_per_channel && !force_multibuffer && !use_parallel_streamfiles &&
+            vgmstream->layout_type == layout_interleave &&
+            vgmstream->channels > 1 &&
+            vgmstream->interleave_first_block_size == 0) {
+        use_interleave_buffer = 1;
+    }
+
     /* for mono or codecs like IMA (XBOX, MS IMA, MS ADPCM) where channels work with the same bytes */
     if (vgmstream->layout_type == layout_none) {
         use_same_offset_per_channel = 1;
@@ -2992,11 +4957,30 @@ int vgmstream_open_stream_bf(VGMSTREAM* vgmstream, STREAMFILE* sf, off_t start_o
         goto fail;
     }
 
-    get_streamfile_name(sf, filename, sizeof(filename));
+    /* name kept by the streamfile if possible, as it's passed to every reopen */
+    filename = get_streamfile_name_ref(sf);
+    if (!filename) {
+        get_streamfile_name(sf, filename_buf, sizeof(filename_buf));
+        filename = filename_buf;
+    }
+
+    /* default buffers, unless a tight memory budget says otherwise */
+    buffer_size = membudget_get_buffer_size(use_streamfile_per_channel ? vgmstream->channels : 1, STREAMFILE_DEFAULT_BUFFER_SIZE);
+
     /* open the file for reading by each channel */
     {
-        if (!use_streamfile_per_channel) {
-            file = open_streamfile(sf, filename);
+        if (use_interleave_buffer) {
+            STREAMFILE* inner_sf = sf->open(sf, filename, buffer_size);
+            if (!inner_sf) goto fail;
+
+            file = open_interleave_buffer_streamfile(inner_sf, start_offset, vgmstream->interleave_block_size * vgmstream->channels);
+            if (file)
+                use_streamfile_per_channel = 0;
+            else
+                close_streamfile(inner_sf); /* rows too big, keep a buffer per channel */
+        }
+        else if (!use_streamfile_per_channel) {
+            file = sf->open(sf, filename, buffer_size);
             if (!file) goto fail;
         }
 
@@ -3014,7 +4998,7 @@ int vgmstream_open_stream_bf(VGMSTREAM* vgmstream, STREAMFILE* sf, off_t start_o
             /* open new one if needed, useful to avoid jumping around when each channel data is too apart
              * (don't use when data is close as it'd make buffers read the full file multiple times) */
             if (use_streamfile_per_channel) {
-                file = open_streamfile(sf,filename);
+                file = sf->open(sf, filename, buffer_size);
                 if (!file) goto fail;
             }
 
@@ -792,21 +792,40 @@ typedef struct {
     int ignore_loop;
 } play_config_t;
 
-/* info for a single vgmstream channel */
+/* player's defaults for vgmstream_apply_config, overridden by the file's config (.txtp) if set */
 typedef struct {
-    STREAMFILE * streamfile;    /* file used by this channel */
-    off_t channel_start_offset; /* where data for this channel begins */
-    off_t offset;               /* current location in the file */
+    int allow_play_forever;     /* player can loop forever (otherwise the file's play_forever is ignored) */
+    int play_forever;           /* loop forever if the file loops (loop count and fade are ignored) */
+    int ignore_loop;            /* play as if the file didn't loop */
+    int force_loop;             /* loop full files that don't loop */
+    int really_force_loop;      /* loop full files even if they loop */
+    int ignore_fade;            /* play the file's end after loop count instead of fading out */
+    double loop_count;
+    double fade_time;           /* in seconds */
+    double fade_delay;          /* in seconds, after loop count and before fading */
+} vgmstream_cfg_t;
 
-    off_t frame_header_offset;  /* offset of the current frame header (for WS) */
-    int samples_left_in_frame;  /* for WS */
+/* play boundaries resolved from the config, in output samples */
+typedef struct {
+    int play_forever;
+    int32_t play_duration;      /* total samples played (as if not looping forever, for info) */
+    int32_t fade_start;         /* position where the fade-out starts */
+    int32_t fade_samples;       /* fade-out duration, ending at play_duration */
+    int32_t play_position;      /* output samples rendered so far (or where it was seeked) */
+} play_state_t;
 
-    /* format specific */
+#define VGMSTREAM_L5_COEFS 0x60
+#define VGMSTREAM_VADPCM_COEFS (8*2*8)
+#define VGMSTREAM_VADPCM_MATRIX (10*8)
+#define VGMSTREAM_VADPCM_BOOK (8*VGMSTREAM_VADPCM_MATRIX)
 
-    /* adpcm */
-    int16_t adpcm_coef[16];             /* formats with decode coefficients built in (DSP, some ADX) */
-    int32_t adpcm_coef_3by32[0x60];     /* Level-5 0x555 */
-    int16_t vadpcm_coefs[8*2*8];        /* VADPCM: max 8 groups * max 2 order * fixed 8 subframe coefs */
+/* info for a single vgmstream channel */
+typedef struct {
+    /* Hot state: fields most decoders touch for every frame go first, so they share one 64-byte
+     * cache line per channel (on 64-bit) rather than being spread over the struct. Keep it that way
+     * when adding fields, rare/big ones go below. */
+    STREAMFILE * streamfile;    /* file used by this channel */
+    off_t offset;               /* current location in the file */
     union {
         int16_t adpcm_history1_16;      /* previous sample */
         int32_t adpcm_history1_32;
@@ -815,6 +834,19 @@ typedef struct {
         int16_t adpcm_history2_16;      /* previous previous sample */
         int32_t adpcm_history2_32;
     };
+    int adpcm_step_index;               /* for IMA */
+    int adpcm_scale;                    /* for MS ADPCM */
+    int16_t adpcm_coef[16];             /* formats with decode coefficients built in (DSP, some ADX) */
+
+    /* rest of the state */
+    off_t channel_start_offset; /* where data for this channel begins */
+
+    off_t frame_header_offset;  /* offset of the current frame header (for WS) */
+    int samples_left_in_frame;  /* for WS */
+
+    /* format specific */
+
+    /* adpcm */
     union {
         int16_t adpcm_history3_16;
         int32_t adpcm_history3_32;
@@ -824,25 +856,28 @@ typedef struct {
         int32_t adpcm_history4_32;
     };
 
-    double adpcm_history1_double;
-    double adpcm_history2_double;
-
-    int adpcm_step_index;               /* for IMA */
-    int adpcm_scale;                    /* for MS ADPCM */
-
-    /* state for G.721 decoder, sort of big but we might as well keep it around */
-    struct g72x_state g72x_state;
-
     /* ADX encryption */
     int adx_channels;
     uint16_t adx_xor;
     uint16_t adx_mult;
     uint16_t adx_add;
 
+    /* big tables of rare codecs are allocated in the stream's arena when set, so channel copies
+     * (ch, start_ch, loop_ch, snapshots) share them instead of carrying them (NULL if unused) */
+    int32_t* adpcm_coef_3by32;          /* Level-5 0x555: VGMSTREAM_L5_COEFS */
+    int16_t* vadpcm_coefs;              /* VADPCM: VGMSTREAM_VADPCM_COEFS (max 8 groups * max 2 order * fixed 8 subframe coefs) */
+    int16_t* vadpcm_book;               /* VADPCM: VGMSTREAM_VADPCM_BOOK (vadpcm_coefs as 8 groups of 10x8 decode matrices) */
+
+    double adpcm_history1_double;
+    double adpcm_history2_double;
+
+    /* state for G.721 decoder, sort of big but we might as well keep it around */
+    struct g72x_state g72x_state;
+
 } VGMSTREAMCHANNEL;
 
 /* main vgmstream info */
-typedef struct {
+typedef struct _VGMSTREAM {
     /* basic config */
     int32_t num_samples;            /* the actual max number of samples */
     int32_t sample_rate;            /* sample rate in Hz */
@@ -867,17 +902,23 @@ typedef struct {
     int num_streams;                /* for multi-stream formats (0=not set/one stream, 1=one stream) */
     int stream_index;               /* selected subsong (also 1-based) */
     size_t stream_size;             /* info to properly calculate bitrate in case of subsongs */
-    char stream_name[STREAM_NAME_SIZE]; /* name of the current stream (info), if the file stores it and it's filled */
+    int bitrate;                    /* stream bitrate in bps if the header has or implies it (0=calculate from sizes) */
+    int average_bitrate;            /* get_vgmstream_average_bitrate result (0=not calculated yet, -1=unknown) */
+    char* stream_name;              /* name of the current stream (info), if the file stores it and it's filled
+                                     * (STREAM_NAME_SIZE buffer in the arena, shared with start_vgmstream) */
 
     /* mapping config (info for plugins) */
     uint32_t channel_layout;        /* order: FL FR FC LFE BL BR FLC FRC BC SL SR etc (WAVEFORMATEX flags where FL=lowest bit set) */
 
     /* other config */
     int allow_dual_stereo;          /* search for dual stereo (file_L.ext + file_R.ext = single stereo file) */
+    int init_index;                 /* detection function that opened the stream (1-based, 0=unknown) */
 
     /* config requests, players must read and honor these values
      * (ideally internally would work as a player, but for now player must do it manually) */
-    play_config_t config;
+    play_config_t* config;          /* in the arena, shared with start_vgmstream */
+    int config_enabled;             /* set by vgmstream_apply_config, renders then play up to pstate's end */
+    play_state_t pstate;
 
 
     /* layout/block state */
@@ -895,9 +936,15 @@ typedef struct {
     size_t loop_block_size;         /* saved from current_block_size */
     int32_t loop_block_samples;      /* saved from current_block_samples */
     off_t loop_next_block_offset;   /* saved from next_block_offset */
+    /* frame geometry cache (see vgmstream_update_frame_geometry) */
+    int frame_geometry_valid;       /* 0 when coding or block values changed (must be cleared then) */
+    int frame_samples;              /* get_vgmstream_samples_per_frame */
+    int frame_bytes;                /* get_vgmstream_frame_size */
+    int frame_multi;                /* decoder handles consecutive frames per call */
 
     /* loop state */
     int hit_loop;                   /* have we seen the loop yet? */
+    int loop_prefetched;            /* loop start was prefetched for this pass (see prefetch_loop) */
     int loop_count;                 /* counter of complete loops (1=looped once) */
     int loop_target;                /* max loops before continuing with the stream end (loops forever if not set) */
 
@@ -912,6 +959,7 @@ typedef struct {
     VGMSTREAMCHANNEL * start_ch;    /* shallow copy of channels as they were at the beginning of the stream (for resets) */
     VGMSTREAMCHANNEL * loop_ch;     /* shallow copy of channels as they were at the loop point (for loops) */
     void* start_vgmstream;          /* shallow copy of the VGMSTREAM as it was at the beginning of the stream (for resets) */
+    void* arena;                    /* pool_arena holding the VGMSTREAM, start_vgmstream, channel arrays and mixing (freed on close) */
 
     void * mixing_data;             /* state for mixing effects */
 
@@ -923,6 +971,26 @@ typedef struct {
     /* Same, for special layouts. layout_data + codec_data may exist at the same time. */
     void * layout_data;
 
+    /* Optional codec setup done before the first render (or seek, that renders) rather than on init,
+     * for costly setup that detection and metadata-only opens don't need. Called once. */
+    void (*codec_setup)(struct _VGMSTREAM* vgmstream);
+
+    /* Seek index of visited blocks (blocked layouts), built while rendering. Shared with start_vgmstream. */
+    void * block_index;
+
+    /* Saved codec_data state at loop start (codecs with save/restore hooks), restored on loop end
+     * instead of seeking the codec. Saved once when first reached. Shared with start_vgmstream. */
+    void * loop_codec_state;
+
+    /* Layout render resolved from layout_type by setup_vgmstream, so the hot render path doesn't
+     * switch per call. Re-resolved if layout_type changes after setup (or setup wasn't called). */
+    void (*layout_render)(sample_t* buffer, int32_t sample_count, struct _VGMSTREAM* vgmstream);
+    layout_t layout_render_type;
+
+    /* Stage timing counters (vgmstream_profile_t) if vgmstream_set_profiling enabled them, else NULL.
+     * Shared with start_vgmstream. */
+    void * profile;
+
 } VGMSTREAM;
 
 #ifdef VGM_USE_VORBIS
@@ -987,8 +1055,10 @@ typedef struct {
     vorbis_block vb;            /* decoder local state */
     ogg_packet op;              /* fake packet for internal use */
 
-    uint8_t * buffer;           /* internal raw data buffer */
+    uint8_t * buffer;           /* internal raw data buffer (packets given to libvorbis when not read in place) */
     size_t buffer_size;
+    uint8_t * ibuf;             /* scratch for custom packets being rebuilt (same allocation as buffer) */
+    size_t ibuf_size;
 
     size_t samples_to_discard;  /* for looping purposes */
     int samples_full;           /* flag, samples available in vorbis buffers */
@@ -1068,6 +1138,11 @@ typedef struct {
     size_t decode_to_discard;  /* discard from this stream only (for EALayer3 or AWC) */
 
     int channels_per_frame; /* for rare cases that streams don't share this */
+
+    uint32_t *skip_index; /* EALayer3: offset+size pairs of other streams' EA-frames skipped from an offset, so loops/seeks needn't re-parse them */
+    size_t skip_index_count;
+    size_t skip_index_max;
+    size_t skip_index_pos; /* next expected pair when replaying */
 } mpeg_custom_stream;
 
 typedef struct {
@@ -1152,6 +1227,17 @@ typedef struct {
     sample_t *buffer;
     int input_channels;     /* internal buffer channels */
     int output_channels;    /* resulting channels (after mixing, if applied) */
+    int32_t *segment_starts; /* start sample of each segment, plus total samples at [segment_count] */
+    int channel_layout;     /* shared by all segments (0 if they differ) */
+
+    /* set by metas that can reopen segments: closed ones are NULL until needed again, which are
+     * those played that can't be reached again, or all but a few in bounded mode (see segmented.c) */
+    VGMSTREAM* (*open_segment)(void* open_data, int segment);
+    void (*free_open_data)(void* open_data);
+    void* open_data;
+    int bounded;            /* only a few segments stay open (big playlists) */
+    int average_bitrate;    /* of all segments, calculated on setup when segments can be reopened */
+    void* arena;            /* pool_arena holding this struct, segments/starts arrays and buffer */
 } segmented_layout_data;
 
 /* for files made of "parallel" layers, one per group of channels (using a complete sub-VGMSTREAM) */
@@ -1161,6 +1247,12 @@ typedef struct {
     sample_t *buffer;
     int input_channels;     /* internal buffer channels */
     int output_channels;    /* resulting channels (after mixing, if applied) */
+    sample_t *layer_buffers; /* one buffer per layer when rendering layers in parallel */
+    int parallel_layers;    /* 1: layers can render in parallel, 0: not checked, -1: can't */
+    uint8_t *layer_flags;   /* per layer render state (see layered.c) */
+    int used_layers;        /* layers whose output isn't removed by mixing (0: not checked) */
+    int first_used_layer;   /* layer that reports the current position */
+    void* arena;            /* pool_arena holding this struct, layer arrays and buffers */
 } layered_layout_data;
 
 /* for compressed NWA */
@@ -1184,6 +1276,9 @@ typedef struct {
     unsigned int current_block;
 
     void* handle;
+
+    uint16_t subkey; /* for key search deferred to first render */
+    void* key_tests; /* frames kept between test_hca_key calls */
 } hca_codec_data;
 
 #ifdef VGM_USE_FFMPEG
@@ -1240,6 +1335,23 @@ typedef struct {
     int32_t samples_consumed;
     int32_t samples_filled;
 
+    /* single stream XMA seek index, built on first seek (see ffmpeg_set_xma_seek_index) */
+    int xma_index_set;
+    uint64_t xma_data_offset;   // absolute XMA data offset within the streamfile
+    uint64_t xma_data_size;
+    int xma_index_count;        // entries, 0 if not built yet, -1 if it couldn't be
+    uint32_t* xma_index_offsets;
+    int32_t* xma_index_frames;
+
+    /* packets read from an index instead of demuxed, formatCtx unused (see init_ffmpeg_raw_packets) */
+    int raw_count;              // packets, 0 if demuxed
+    int raw_current;            // next packet to read
+    uint32_t* raw_offsets;      // absolute packet offsets within the streamfile
+    uint32_t* raw_sizes;
+    int32_t* raw_samples;       // decoder samples before each packet (+1 entry with the total)
+    int32_t raw_preroll;        // samples decoded before a seek target
+    uint8_t* raw_buf;           // packet copy when the streamfile can't point to it
+
 } ffmpeg_codec_data;
 #endif
 
@@ -1261,6 +1373,10 @@ typedef struct {
     HANDLE_AACDECODER h_aacdecoder;
     unsigned int sample_ptr, samples_per_frame, samples_discard;
     INT_PCM sample_buffer[( (6) * (2048)*4 )];
+    uint8_t * read_buffer;      /* MP4 samples are read here (track's max sample size) */
+    uint32_t read_buffer_size;
+    int32_t * sample_index;     /* output sample where each MP4 sample starts, for seeks */
+    int resync;                 /* next frame follows a seek */
 } mp4_aac_codec_data;
 #endif
 #endif
@@ -1316,21 +1432,123 @@ int vgmstream_get_current_sample(VGMSTREAM* vgmstream);
 /* do format detection, return pointer to a usable VGMSTREAM, or NULL on failure */
 VGMSTREAM * init_vgmstream(const char * const filename);
 
-/* init with custom IO via streamfile */
+/* init with custom IO via streamfile
+ * (opening and rendering keep no unlocked global state, so different VGMSTREAMs may be used from
+ * different threads, as long as enabled global caches get lock callbacks and profiles are off) */
 VGMSTREAM * init_vgmstream_from_STREAMFILE(STREAMFILE *streamFile);
 
+/* Same, but tries the detection function of a previous vgmstream->init_index first (falling back
+ * to normal detection if it fails), so hosts that remember what opened a file can skip detection.
+ * Indexes are only valid with the same vgmstream_get_detection_version. */
+VGMSTREAM * init_vgmstream_from_STREAMFILE_index(STREAMFILE *streamFile, int init_index);
+
+/* Value that changes when detection (formats or their order) changes, to invalidate stored init_index. */
+uint32_t vgmstream_get_detection_version(void);
+
+/* Counters of one detection function, see vgmstream_detection_profile_setup. */
+typedef struct {
+    uint64_t tries;             /* times the function was called */
+    uint64_t matches;           /* times it returned a valid stream */
+    uint64_t time_us;           /* wall time spent in it (including failed tries) */
+    uint64_t bytes_requested;   /* bytes it asked the streamfile for */
+    uint64_t bytes_read;        /* bytes actually read from the file (not served from the header buffer) */
+    uint64_t over_budget;       /* tries stopped by vgmstream_detection_budget_setup's limits */
+    char meta_name[128];        /* description of the last matched stream, empty if never matched */
+} vgmstream_detection_profile_t;
+
+/* Number of detection functions, that is the entries that a profile array needs and max init_index. */
+int vgmstream_get_detection_count(void);
+
+/* Makes detection add counters of every tried function to profile[init_index - 1] (NULL disables,
+ * default). Meant for tools that measure parsers and their order over many files; the array isn't
+ * locked, so it's not for hosts that open files from several threads. */
+void vgmstream_detection_profile_setup(vgmstream_detection_profile_t* profile);
+
+/* Limits each detection function to reading max_bytes past the file's start (kept in memory) and to
+ * max_ms of wall time in reads, so a bad file that makes a parser walk or scan all of it doesn't
+ * stall hosts that detect many files (0 = no limit for each, default). Past a limit the function's
+ * reads fail, it's skipped (logged) and detection moves on. Should be called before opening anything. */
+void vgmstream_detection_budget_setup(size_t max_bytes, int max_ms);
+
+/* Wall time a stream spent in each render stage, see vgmstream_set_profiling. Stages include the
+ * file reads they trigger, so read_time_us overlaps them (mostly decode and layout). */
+typedef struct {
+    uint64_t render_calls;      /* render_vgmstream* calls */
+    uint64_t render_time_us;    /* total time in renders, stages below are part of it */
+    uint64_t decode_calls;      /* decode_vgmstream calls (by layouts, per block/frame/chunk) */
+    uint64_t decode_time_us;    /* codecs */
+    uint64_t layout_time_us;    /* layout bookkeeping: block_update and segment changes */
+    uint64_t mix_time_us;       /* mixing (volume, downmix, fades set by mixing) */
+    uint64_t output_time_us;    /* play state (config fades, end silence) and output sample conversion */
+    uint64_t read_time_us;      /* actual file/device reads, from the streamfile I/O counters */
+} vgmstream_profile_t;
+
+/* Enables (or disables and clears) stage timing of a stream, including its layers and segments. Each
+ * stage only adds a couple of clock reads per call (per block in blocked layouts), so hosts can leave
+ * it on to diagnose slow devices. Counters are per stream, so streams in other threads don't interfere. */
+void vgmstream_set_profiling(VGMSTREAM* vgmstream, int enabled);
+
+/* Fills current counters (all 0 if profiling isn't enabled), added since it was enabled. Call from
+ * the thread that renders. Render time is of the top stream, stages are summed over its layers/segments. */
+void vgmstream_get_profile(VGMSTREAM* vgmstream, vgmstream_profile_t* profile);
+
 /* reset a VGMSTREAM to start of stream */
 void reset_vgmstream(VGMSTREAM * vgmstream);
 
+/* Moves a VGMSTREAM to seek_sample, counted in played samples (so past loop end when looping),
+ * same as resetting if needed and decoding forward. Jumps directly when the position is in the
+ * first pass and the layout or codec allows it: segmented restarts only the target segment,
+ * blocked resumes from the nearest block already played and PCM-like codecs move offsets. */
+void seek_vgmstream(VGMSTREAM * vgmstream, int32_t seek_sample);
+
+/* Same as seek_vgmstream, but for faster seeks in long files when sample accuracy isn't needed
+ * (scrubbing): frame-based ADPCM and HCA jump to a frame a bit before seek_sample, assuming zero
+ * history, and decode forward from there. The position is exact, output may differ slightly for
+ * a few frames after it. Other codecs and layouts seek normally. */
+void seek_vgmstream_approximate(VGMSTREAM * vgmstream, int32_t seek_sample);
+
+/* Saved decoder state of a vgmstream, to return to that position later without decoding from the start
+ * (ex. periodic snapshots while playing make backward seeks cost at most one interval of decoding).
+ * Supports codecs with their state in channels and a few with codec_data (HCA, Relic, UBI ADPCM, iMUSE),
+ * plus layered and segmented layouts made of those. */
+typedef struct vgmstream_snapshot vgmstream_snapshot;
+
+/* Saves the current state, or returns NULL if the codec or layout can't be saved (or on error). */
+vgmstream_snapshot* vgmstream_save_snapshot(VGMSTREAM * vgmstream);
+
+/* Returns the vgmstream the snapshot was taken from to that state. Returns 0 on error. */
+int vgmstream_restore_snapshot(VGMSTREAM * vgmstream, const vgmstream_snapshot* snapshot);
+
+/* Memory used by a snapshot */
+size_t vgmstream_snapshot_size(const vgmstream_snapshot* snapshot);
+
+void vgmstream_free_snapshot(vgmstream_snapshot* snapshot);
+
 /* close an open vgmstream */
 void close_vgmstream(VGMSTREAM * vgmstream);
 
 /* calculate the number of samples to be played based on looping parameters */
 int32_t get_vgmstream_play_samples(double looptimes, double fadeseconds, double fadedelayseconds, VGMSTREAM * vgmstream);
 
+/* Does now the setup that would otherwise happen in the first render (deferred codec setup like
+ * HCA key search, block index, streamfile buffers), so later renders don't allocate. */
+void prepare_vgmstream(VGMSTREAM * vgmstream);
+
 /* Decode data into sample buffer */
 void render_vgmstream(sample_t * buffer, int32_t sample_count, VGMSTREAM * vgmstream);
 
+/* Decode data into sample buffer without mixing (volume, downmix, fades), as stored in the file */
+void render_vgmstream_unmixed(sample_t * buffer, int32_t sample_count, VGMSTREAM * vgmstream);
+
+/* Decode data into float sample buffer (normalized to +-1.0), must hold output channels * sample_count.
+ * Same as render_vgmstream but mixing results (volume, downmix, fades) aren't clamped to 16-bit. */
+void render_vgmstream_float(float * buffer, int32_t sample_count, VGMSTREAM * vgmstream);
+
+/* Decode data into one buffer per output channel (planes[ch], each holding sample_count samples),
+ * same as render_vgmstream otherwise. Per-channel codecs in flat streams without mixing are
+ * decoded into the planes directly, others are rendered interleaved and split. */
+void render_vgmstream_planar(sample_t ** planes, int32_t sample_count, VGMSTREAM * vgmstream);
+
 /* Write a description of the stream into array pointed by desc, which must be length bytes long.
  * Will always be null-terminated if length > 0 */
 void describe_vgmstream(VGMSTREAM * vgmstream, char * desc, int length);
@@ -1338,6 +1556,14 @@ void describe_vgmstream(VGMSTREAM * vgmstream, char * desc, int length);
 /* Return the average bitrate in bps of all unique files contained within this stream. */
 int get_vgmstream_average_bitrate(VGMSTREAM * vgmstream);
 
+/* Sums I/O counters (reads, buffer hits/misses, time in file reads) of all streamfiles the stream uses,
+ * to check buffer sizes and parsers that trash buffers. */
+void get_vgmstream_io_stats(VGMSTREAM* vgmstream, streamfile_stats_t* stats);
+
+/* Gives back the buffers of all streamfiles the stream uses (see release_streamfile_buffer), for
+ * hosts keeping a stream that won't be rendered for a while. Rendering retakes them as needed. */
+void release_vgmstream_buffers(VGMSTREAM* vgmstream);
+
 /* List supported formats and return elements in the list, for plugins that need to know.
  * The list disables some common formats that may conflict (.wav, .ogg, etc). */
 const char ** vgmstream_get_formats(size_t * size);
@@ -1352,6 +1578,174 @@ void vgmstream_force_loop(VGMSTREAM* vgmstream, int loop_flag, int loop_start_sa
 /* Set number of max loops to do, then play up to stream end (for songs with proper endings) */
 void vgmstream_set_loop_target(VGMSTREAM* vgmstream, int loop_target);
 
+/* Resolves player config (loops, fades, forced loops) with the file's config and makes renders honor
+ * it: loops the requested number of times, fades out and outputs silence after the end. Seeks are then
+ * in output samples. Should be called before playing anything, like vgmstream_force_loop. */
+void vgmstream_apply_config(VGMSTREAM* vgmstream, vgmstream_cfg_t* vcfg);
+
+/* Samples to play once config is applied (num_samples otherwise) */
+int32_t vgmstream_get_samples(VGMSTREAM* vgmstream);
+
+/* Allocator for all of vgmstream's memory (streams, streamfiles, codecs and caches), for hosts that
+ * pool or track it; data is passed to the callbacks. Must be set once before anything else, and kept
+ * while anything allocated may still be freed (NULL callbacks go back to the C allocator). resize
+ * gets NULL pointers like realloc, release never does. External codec libraries use their own. */
+void vgmstream_allocator_setup(void* (*alloc)(size_t size, void* data), void* (*resize)(void* ptr, size_t size, void* data),
+        void (*release)(void* ptr, void* data), void* data);
+
+/* Frees memory vgmstream returns to the host (like vgmstream_get_subsongs_info's) */
+void vgmstream_free(void* ptr);
+
+/* CPU features used to pick faster versions of some decoder/mixing loops (results are the same) */
+#define VGMSTREAM_CPU_SSE2      (1 << 0)
+#define VGMSTREAM_CPU_SSE41     (1 << 1)
+#define VGMSTREAM_CPU_AVX2      (1 << 2)
+#define VGMSTREAM_CPU_NEON      (1 << 3)
+
+/* Features of the running CPU (VGMSTREAM_CPU_* flags) */
+uint32_t vgmstream_get_cpu_features(void);
+
+/* Ignores some CPU features when picking loops, mainly to debug or compare against the C versions
+ * (~0 forces them, 0 uses all features, default). Should be called before opening anything. */
+void vgmstream_cpu_setup(uint32_t disabled_features);
+
+/* Keep up to max_blocks freed VGMSTREAM shells, channel arrays and internal buffers to reuse on
+ * next opens (0 disables and frees pooled blocks, default). The pool is global, so hosts that use
+ * vgmstream from several threads must pass lock/unlock callbacks (can be NULL otherwise). Should be
+ * called once before opening anything and again with 0 after closing everything. */
+void vgmstream_pool_setup(int max_blocks, void (*lock)(void*), void (*unlock)(void*), void* lock_data);
+
+/* Share file pages read by buffered streamfiles (stdio, buffer, host IO) between all reopens of
+ * the same file in the process, keeping up to max_size bytes (0 disables, default). Same threading
+ * rules as vgmstream_pool_setup. Streamfiles opened while disabled don't use the cache. */
+void vgmstream_page_cache_setup(size_t max_size, void (*lock)(void*), void (*unlock)(void*), void* lock_data);
+
+/* Let adaptive streamfile buffers (used by some deblocking/interleave readers) grow up to max_size
+ * bytes in total (0 keeps them at the default size, default). Same threading rules as
+ * vgmstream_pool_setup. */
+void vgmstream_buffer_budget_setup(size_t max_size, void (*lock)(void*), void (*unlock)(void*), void* lock_data);
+
+/* Keep up to max_size bytes of streamfile buffers given back by closed or idle streamfiles, to
+ * reuse on next refills instead of allocating (0 disables and frees kept buffers, default).
+ * Buffers are taken on the first read either way. Same threading rules as vgmstream_pool_setup. */
+void vgmstream_buffer_pool_setup(size_t max_size, void (*lock)(void*), void (*unlock)(void*), void* lock_data);
+
+/* Sizes vgmstream's memory use to about max_size bytes in total: calls the page cache (1/8), buffer
+ * budget (1/4) and buffer pool (1/16) setups above (so it replaces them) with the same callbacks,
+ * and limits seek checkpoints of each player (1/4, spacing them out when full). Tight budgets also
+ * get smaller channel buffers and bounded segmented streams that keep fewer segments open.
+ * 0 disables the budget and those caches (default). Same threading rules as vgmstream_pool_setup. */
+void vgmstream_memory_budget_setup(size_t max_size, void (*lock)(void*), void (*unlock)(void*), void* lock_data);
+
+/* Part of the budget meant for hosts' own caches of decoded audio (ex. loops), 0 if no budget. */
+size_t vgmstream_memory_budget_get_host_cache(void);
+
+/* Memory in use by category, in bytes */
+typedef struct {
+    size_t page_cache;      /* shared file pages */
+    size_t stream_buffers;  /* buffers of open streamfiles (including grown adaptive ones) */
+    size_t buffer_pool;     /* idle streamfile buffers kept for reuse */
+    size_t decoder_pool;    /* freed stream blocks kept for reuse (vgmstream_pool_setup) */
+    size_t checkpoints;     /* seek checkpoints of all players */
+    size_t total;
+} vgmstream_memory_usage_t;
+
+void vgmstream_get_memory_usage(vgmstream_memory_usage_t* usage);
+
+/* Remember (up to a few dozen) dual stereo partner files that failed to open or pair, to skip them
+ * on next opens of the same mono files (0 disables and forgets them, default). Same threading rules
+ * as vgmstream_pool_setup. Files added or changed later may be ignored until the entry is replaced. */
+void vgmstream_dual_stereo_cache_setup(int enabled, void (*lock)(void*), void (*unlock)(void*), void* lock_data);
+
+/* Lists the files of a folder (path ends with a separator) calling add_name(list, name) for each,
+ * returns 0 if the folder can't be listed. */
+typedef int (*vgmstream_list_dir_t)(void* list_data, const char* path, void (*add_name)(void* list, const char* name), void* list);
+
+/* Remember which files exist in the last few folders (listed once with list_dir, if given) and which
+ * files failed to open recently, so formats probing companion files (.sth, .txth, .sp, dual stereo
+ * partners, etc) don't touch the filesystem for missing ones (0 disables and forgets them, default).
+ * Entries expire after a few seconds. Same threading rules as vgmstream_pool_setup. */
+void vgmstream_dir_cache_setup(int enabled, vgmstream_list_dir_t list_dir, void* list_data,
+        void (*lock)(void*), void (*unlock)(void*), void* lock_data);
+
+/* Remember the HCA key found in each folder (for the last few folders), so next encrypted files without
+ * a key file test that key before the whole known key list (0 disables, default). Same threading
+ * rules as vgmstream_pool_setup. */
+void vgmstream_hca_key_cache_setup(int enabled, void (*lock)(void*), void (*unlock)(void*), void* lock_data);
+
+/* Same for encrypted ADX (type 8 and 9 keys are kept apart). */
+void vgmstream_adx_key_cache_setup(int enabled, void (*lock)(void*), void (*unlock)(void*), void* lock_data);
+
+/* Remember where each subsong is in the last few opened Ubisoft .sbX/.smX/.bnm banks, so opening one
+ * subsong of a known bank only parses its header instead of the whole bank (0 disables and forgets
+ * them, default). Same threading rules as vgmstream_pool_setup. */
+void vgmstream_ubi_sb_index_setup(int enabled, void (*lock)(void*), void (*unlock)(void*), void* lock_data);
+
+/* Remember where each sample header is in the last few opened FSB5 banks, so opening one subsong of
+ * a known bank only parses its header instead of all previous ones (0 disables and forgets them,
+ * default). Same threading rules as vgmstream_pool_setup. */
+void vgmstream_fsb5_index_setup(int enabled, void (*lock)(void*), void (*unlock)(void*), void* lock_data);
+
+/* Remember the last few rebuilt Wwise Vorbis setups, so opening many streams of a bank that share
+ * codebooks doesn't rebuild them (or reload a .wvc) each time (0 disables and forgets them, default).
+ * Same threading rules as vgmstream_pool_setup. */
+void vgmstream_wwise_setup_cache_setup(int enabled, void (*lock)(void*), void (*unlock)(void*), void* lock_data);
+
+/* Remember where each subsong (and its name once found) is in the last few opened banks of formats
+ * that must walk their tables to find one (.nus3bank, Sony .bnk, .sab/.mab), so next opens go straight
+ * to the target (0 disables and forgets them, default). Same threading rules as vgmstream_pool_setup. */
+void vgmstream_bank_index_setup(int enabled, void (*lock)(void*), void (*unlock)(void*), void* lock_data);
+
+/* Remember the names of every wave in the last few .acb cue sheets, so loading each subsong of their
+ * .awb doesn't walk all cues again (0 disables and forgets them, default). Same threading rules as
+ * vgmstream_pool_setup. */
+void vgmstream_acb_name_cache_setup(int enabled, void (*lock)(void*), void (*unlock)(void*), void* lock_data);
+
+/* Remember the stream names found in the last few .xsb sound banks, so loading each subsong of their
+ * .xwb doesn't parse all cues again (0 disables and forgets them, default). Same threading rules as
+ * vgmstream_pool_setup. */
+void vgmstream_xsb_name_cache_setup(int enabled, void (*lock)(void*), void (*unlock)(void*), void* lock_data);
+
+/* Remember the last few parsed .txth and which folders have no shared .txth for an extension, so
+ * opening many raw files of a set doesn't read and split the same text each time (0 disables and
+ * forgets them, default). Same threading rules as vgmstream_pool_setup. */
+void vgmstream_txth_cache_setup(int enabled, void (*lock)(void*), void (*unlock)(void*), void* lock_data);
+
+/* Keep seek indexes that take a decoding pass to build (visited blocks of blocked layouts) across
+ * sessions, so seeks in files played before jump straight to a block. save(name, buf, size) is called
+ * when closing a stream that indexed more blocks than were saved, and load(name, buf, max_size) when
+ * the stream first renders or seeks, returning the saved size (0 if none) and reading only if it fits
+ * in max_size (it's called again with a bigger buffer if needed). Names are 16 hex chars hashing the
+ * file's data and the stream; indexes from other builds are ignored (and replaced on the next save).
+ * Callbacks are called from whichever thread opens and closes streams (0 disables, default). */
+void vgmstream_seek_index_cache_setup(int enabled, size_t (*load)(const char* name, void* buf, size_t max_size, void* data),
+        void (*save)(const char* name, const void* buf, size_t size, void* data), void* data);
+
+/* Decode channels of simple codecs (ADX, DSP, PS-ADPCM, XA), substreams of multichannel custom MPEG
+ * (EALayer3, AWC, etc) and layers of layered streams in parallel for streams with at least min_channels
+ * channels, on render calls of at least min_samples samples. Those codecs get a streamfile per channel. run must call job(job_data, N) for every N in
+ * 0..count-1, from any threads, and return once all are done (NULL disables, default). Jobs may call
+ * run again (layers with parallel channels). Segmented streams also use it to set up the next segment
+ * while the current one renders, for any channel count. The runner is global, so set it up before opening streams
+ * and keep it valid until disabled. */
+void vgmstream_channel_workers_setup(int min_channels, int min_samples, void (*run)(void (*job)(void*, int), void* job_data, int count, void* run_data), void* run_data);
+
+/* Lets decoders whose reference math is float use int versions instead, for devices where matching
+ * PC output doesn't matter (samples may be off by a few LSB). Global, off by default. */
+void vgmstream_low_power_setup(int enabled);
+int vgmstream_is_low_power(void);
+
+/* Debug log lines (VGM_LOG and friends, only in VGM_DEBUG_OUTPUT builds) are printed to stdout as they
+ * happen by default. With a callback they're queued instead, without locks or allocations so render paths
+ * don't wait on output, and vgmstream_log_drain passes them (without the final newline) to the callback
+ * from whichever host thread calls it. Lines past the queue size or a rate limit are dropped and reported
+ * as a count. Set once before opening anything (NULL goes back to printing). */
+void vgmstream_log_setup(void (*callback)(const char* line, void* data), void* data);
+
+/* Passes queued log lines to the callback, returns how many. Safe to call from any thread (only one
+ * drains at a time, others return 0). */
+int vgmstream_log_drain(void);
+
 /* Return 1 if vgmstream detects from the filename that said file can be used even if doesn't physically exist */
 int vgmstream_is_virtual_filename(const char* filename);
 
@@ -1372,11 +1766,34 @@ int get_vgmstream_frame_size(VGMSTREAM * vgmstream);
 /* In NDS IMA the frame size is the block size, so the last one is short */
 int get_vgmstream_samples_per_shortframe(VGMSTREAM * vgmstream);
 int get_vgmstream_shortframe_size(VGMSTREAM * vgmstream);
+/* Refreshes the frame_* cache from the functions above. Layouts call it when frame_geometry_valid
+ * is 0, so those big switches run once per block change rather than on every render call. */
+void vgmstream_update_frame_geometry(VGMSTREAM * vgmstream);
 
 /* Decode samples into the buffer. Assume that we have written samples_written into the
  * buffer already, and we have samples_to_do consecutive samples ahead of us. */
 void decode_vgmstream(VGMSTREAM * vgmstream, int samples_written, int samples_to_do, sample_t * buffer);
 
+/* Same as decode_vgmstream but into a float buffer (+-1.0), for codecs that can skip the 16-bit
+ * step (see vgmstream_can_decode_float). Others get silence. */
+void decode_vgmstream_float(VGMSTREAM * vgmstream, int samples_written, int samples_to_do, float * buffer);
+int vgmstream_can_decode_float(VGMSTREAM * vgmstream);
+
+/* Same as decode_vgmstream but each channel goes to its own plane (planes[ch] + samples_written),
+ * for codecs that decode channels separately (see vgmstream_can_decode_planar). Others get silence. */
+void decode_vgmstream_planar(VGMSTREAM * vgmstream, int samples_written, int samples_to_do, sample_t ** planes);
+int vgmstream_can_decode_planar(VGMSTREAM * vgmstream);
+
+/* Runs job(data, N) for N in 0..count-1 through the vgmstream_channel_workers_setup runner, if set and
+ * channels/samples reach its thresholds (see vgmstream_can_run_parallel). Returns 0 if not done
+ * (caller must run jobs itself). */
+int vgmstream_can_run_parallel(int channels, int samples);
+int vgmstream_run_parallel(int channels, int samples, void (*job)(void*, int), void* job_data, int count);
+
+/* Same as vgmstream_run_parallel without thresholds, for jobs that simply overlap (like setting up
+ * the next segment while rendering the current one). Returns 0 if there is no runner. */
+int vgmstream_run_jobs(void (*job)(void*, int), void* job_data, int count);
+
 /* Calculate number of consecutive samples to do (taking into account stopping for loop start and end) */
 int vgmstream_samples_to_do(int samples_this_block, int samples_per_frame, VGMSTREAM * vgmstream);
 
@@ -1391,6 +1808,7 @@ int vgmstream_open_stream_bf(VGMSTREAM * vgmstream, STREAMFILE *streamFile, off_
 /* Get description info */
 void get_vgmstream_coding_description(VGMSTREAM *vgmstream, char *out, size_t out_size);
 void get_vgmstream_layout_description(VGMSTREAM *vgmstream, char *out, size_t out_size);
+const char * get_vgmstream_layout_name(layout_t layout_type);
 void get_vgmstream_meta_description(VGMSTREAM *vgmstream, char *out, size_t out_size);
 
 #endif
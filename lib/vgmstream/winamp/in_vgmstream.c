@@ -959,36 +959,36 @@ static void set_config_defaults(winamp_song_config *current) {
 static void apply_config(VGMSTREAM* vgmstream, winamp_song_config* cfg) {
 
     /* honor suggested config (order matters, and config mixes with/overwrites player defaults) */
-    if (vgmstream->config.play_forever) {
+    if (vgmstream->config->play_forever) {
         cfg->song_play_forever = 1;
         cfg->song_ignore_loop = 0;
     }
-    if (vgmstream->config.loop_count_set) {
-        cfg->song_loop_count = vgmstream->config.loop_count;
+    if (vgmstream->config->loop_count_set) {
+        cfg->song_loop_count = vgmstream->config->loop_count;
         cfg->song_play_forever = 0;
         cfg->song_ignore_loop = 0;
     }
-    if (vgmstream->config.fade_delay_set) {
-        cfg->song_fade_delay = vgmstream->config.fade_delay;
+    if (vgmstream->config->fade_delay_set) {
+        cfg->song_fade_delay = vgmstream->config->fade_delay;
     }
-    if (vgmstream->config.fade_time_set) {
-        cfg->song_fade_time = vgmstream->config.fade_time;
+    if (vgmstream->config->fade_time_set) {
+        cfg->song_fade_time = vgmstream->config->fade_time;
     }
-    if (vgmstream->config.ignore_fade) {
+    if (vgmstream->config->ignore_fade) {
         cfg->song_ignore_fade = 1;
     }
 
-    if (vgmstream->config.force_loop) {
+    if (vgmstream->config->force_loop) {
         cfg->song_ignore_loop = 0;
         cfg->song_force_loop = 1;
         cfg->song_really_force_loop = 0;
     }
-    if (vgmstream->config.really_force_loop) {
+    if (vgmstream->config->really_force_loop) {
         cfg->song_ignore_loop = 0;
         cfg->song_force_loop = 0;
         cfg->song_really_force_loop = 1;
     }
-    if (vgmstream->config.ignore_loop) {
+    if (vgmstream->config->ignore_loop) {
         cfg->song_ignore_loop = 1;
         cfg->song_force_loop = 0;
         cfg->song_really_force_loop = 0;
@@ -1406,35 +1406,26 @@ DWORD WINAPI __stdcall decode(void *arg) {
         else
             samples_to_do = max_buffer_samples;
 
-        /* seek setup (max samples to skip if still seeking, mark done) */
+        /* seek (jumps or decodes forward as needed, then resumes decoding from there) */
         if (state.seek_needed_samples >= 0) {
-            /* reset if we need to seek backwards */
-            if (state.seek_needed_samples < state.decode_pos_samples) {
-                reset_vgmstream(vgmstream);
-                apply_config(vgmstream, &config); /* config is undone by reset */
-
-                state.decode_pos_samples = 0;
-                state.decode_pos_ms = 0;
-            }
-
             /* adjust seeking past file, can happen using the right (->) key
              * (should be done here and not in SetOutputTime due to threads/race conditions) */
             if (state.seek_needed_samples > max_samples && !config.song_play_forever) {
                 state.seek_needed_samples = max_samples;
             }
 
-            /* adjust max samples to seek */
-            if (state.decode_pos_samples < state.seek_needed_samples) {
-                samples_to_do = state.seek_needed_samples - state.decode_pos_samples;
-                if (samples_to_do > max_buffer_samples)
-                    samples_to_do = max_buffer_samples;
-            }
-            else {
-                state.seek_needed_samples = -1;
+            seek_vgmstream(vgmstream, state.seek_needed_samples);
+            if (state.seek_needed_samples < state.decode_pos_samples) {
+                apply_config(vgmstream, &config); /* config may be undone by reset */
             }
 
+            state.decode_pos_samples = state.seek_needed_samples;
+            state.decode_pos_ms = state.decode_pos_samples * 1000LL / vgmstream->sample_rate;
+            state.seek_needed_samples = -1;
+
             /* flush Winamp buffers */
             input_module.outMod->Flush((int)state.decode_pos_ms);
+            continue;
         }
 
         output_bytes = (samples_to_do * state.output_channels * sizeof(short));
@@ -1449,13 +1440,6 @@ DWORD WINAPI __stdcall decode(void *arg) {
             }
             Sleep(10);
         }
-        else if (state.seek_needed_samples != -1) { /* seek */
-            render_vgmstream(sample_buffer,samples_to_do,vgmstream);
-
-            /* discard decoded samples and keep seeking */
-            state.decode_pos_samples += samples_to_do;
-            state.decode_pos_ms = state.decode_pos_samples * 1000LL / vgmstream->sample_rate;
-        }
         else if (input_module.outMod->CanWrite() >= output_bytes) { /* decode */
             render_vgmstream(sample_buffer,samples_to_do,vgmstream);
 
@@ -1864,42 +1848,27 @@ __declspec(dllexport) size_t winampGetExtendedRead_getData(void *handle, char *d
         else
             samples_to_do = max_buffer_samples;
 
-        /* seek setup (max samples to skip if still seeking, mark done) */
+        /* seek (jumps or decodes forward as needed, then resumes decoding from there) */
         if (xstate.seek_needed_samples != -1) {
-            /* reset if we need to seek backwards */
-            if (xstate.seek_needed_samples < xstate.decode_pos_samples) {
-                reset_vgmstream(xvgmstream);
-                apply_config(xvgmstream, &xconfig); /* config is undone by reset */
-
-                xstate.decode_pos_samples = 0;
-            }
-
             /* adjust seeking past file, can happen using the right (->) key
              * (should be done here and not in SetOutputTime due to threads/race conditions) */
             if (xstate.seek_needed_samples > max_samples && !config.song_play_forever) {
                 xstate.seek_needed_samples = max_samples;
             }
 
-            /* adjust max samples to seek */
-            if (xstate.decode_pos_samples < xstate.seek_needed_samples) {
-                samples_to_do = xstate.seek_needed_samples - xstate.decode_pos_samples;
-                if (samples_to_do > max_buffer_samples)
-                    samples_to_do = max_buffer_samples;
-            }
-            else {
-                xstate.seek_needed_samples = -1;
+            seek_vgmstream(xvgmstream, xstate.seek_needed_samples);
+            if (xstate.seek_needed_samples < xstate.decode_pos_samples) {
+                apply_config(xvgmstream, &xconfig); /* config may be undone by reset */
             }
+
+            xstate.decode_pos_samples = xstate.seek_needed_samples;
+            xstate.seek_needed_samples = -1;
+            continue;
         }
 
         if (!samples_to_do) { /* track finished */
             break;
         }
-        else if (xstate.seek_needed_samples != -1) { /* seek */
-            render_vgmstream(xsample_buffer, samples_to_do, xvgmstream);
-
-            /* discard decoded samples and keep seeking */
-            xstate.decode_pos_samples += samples_to_do;
-        }
         else { /* decode */
             render_vgmstream(xsample_buffer, samples_to_do, xvgmstream);
 
@@ -603,7 +603,7 @@ double WINAPI xmplay_GetGranularity() {
 
 /* seek to a position (in granularity units), return new position or -1 = failed */
 double WINAPI xmplay_SetPosition(DWORD pos) {
-    double cpos = (double)framesDone / (double)vgmstream->sample_rate;
+    double cpos;
     double time = pos * xmplay_GetGranularity();
 
     if (pos == XMPIN_POS_AUTOLOOP || pos == XMPIN_POS_LOOP)
@@ -632,24 +632,10 @@ double WINAPI xmplay_SetPosition(DWORD pos) {
     }
 #endif
 
-    if (time < cpos) {
-        reset_vgmstream(vgmstream);
-        cpos = 0.0;
-    }
-
-    while (cpos < time) {
-        INT16 buffer[1024];
-        long max_sample_count = 1024 / vgmstream->channels;
-        long samples_to_skip = (long)((time - cpos) * vgmstream->sample_rate);
-        if (samples_to_skip > max_sample_count)
-            samples_to_skip = max_sample_count;
-        if (!samples_to_skip)
-            break;
-        render_vgmstream(buffer, (int)samples_to_skip, vgmstream);
-        cpos += (double)samples_to_skip / (double)vgmstream->sample_rate;
-    }
-
-    framesDone = (int32_t)(cpos * vgmstream->sample_rate);
+    /* resets and renders forward if can't jump there directly */
+    framesDone = (int32_t)(time * vgmstream->sample_rate);
+    seek_vgmstream(vgmstream, framesDone);
+    cpos = (double)framesDone / (double)vgmstream->sample_rate;
 
     return cpos;
 }
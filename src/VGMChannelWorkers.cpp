@@ -0,0 +1,123 @@
+/*
+ *  Copyright (C) 2005-2020 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "VGMChannelWorkers.h"
+
+#include <algorithm>
+
+// Channels are few and short to decode, so more threads than this only add wakeups
+#define VGM_CHANNEL_WORKERS_MAX 8
+
+CVGMChannelWorkers::~CVGMChannelWorkers()
+{
+  Enable(false);
+}
+
+void CVGMChannelWorkers::Enable(bool enabled)
+{
+  std::lock_guard<std::mutex> lock(m_enableMutex);
+
+  if (!enabled)
+  {
+    Stop();
+    return;
+  }
+
+  if (!m_threads.empty())
+    return;
+
+  // the caller decodes too, so one less than the available cores
+  unsigned int cores = std::thread::hardware_concurrency();
+  unsigned int count = std::min<unsigned int>(cores > 1 ? cores - 1 : 0, VGM_CHANNEL_WORKERS_MAX);
+
+  m_stop = false;
+  for (unsigned int i = 0; i < count; i++)
+    m_threads.emplace_back(&CVGMChannelWorkers::WorkerThread, this);
+}
+
+void CVGMChannelWorkers::Stop()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_workCond.notify_all();
+
+  for (auto& thread : m_threads)
+    thread.join();
+  m_threads.clear();
+}
+
+// set while a thread runs a batch job, as jobs may call Run again (the caller's own
+// try_lock on m_enableMutex would be undefined then)
+static thread_local bool inJob = false;
+
+void CVGMChannelWorkers::Run(void (*job)(void*, int), void* jobData, int count, void* data)
+{
+  CVGMChannelWorkers* workers = static_cast<CVGMChannelWorkers*>(data);
+
+  // nested, workers busy with another stream (or being stopped) or disabled: decode here
+  std::unique_lock<std::mutex> lock;
+  if (!inJob)
+    lock = std::unique_lock<std::mutex>(workers->m_enableMutex, std::try_to_lock);
+  if (!lock.owns_lock() || workers->m_threads.empty())
+  {
+    for (int i = 0; i < count; i++)
+      job(jobData, i);
+    return;
+  }
+
+  workers->RunJobs(job, jobData, count);
+}
+
+void CVGMChannelWorkers::RunJobs(void (*job)(void*, int), void* jobData, int count)
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_job = job;
+  m_jobData = jobData;
+  m_count = count;
+  m_next = 0;
+  m_pending = count;
+  m_workCond.notify_all();
+
+  while (m_next < m_count)
+  {
+    int index = m_next++;
+    lock.unlock();
+    inJob = true;
+    job(jobData, index);
+    inJob = false;
+    lock.lock();
+    m_pending--;
+  }
+
+  m_doneCond.wait(lock, [this] { return m_pending == 0; });
+  m_job = nullptr;
+  m_count = 0;
+}
+
+void CVGMChannelWorkers::WorkerThread()
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while (true)
+  {
+    m_workCond.wait(lock, [this] { return m_stop || m_next < m_count; });
+    if (m_stop)
+      return;
+
+    int index = m_next++;
+    void (*job)(void*, int) = m_job;
+    void* jobData = m_jobData;
+    lock.unlock();
+    inJob = true;
+    job(jobData, index);
+    inJob = false;
+    lock.lock();
+    if (--m_pending == 0)
+      m_doneCond.notify_one();
+  }
+}
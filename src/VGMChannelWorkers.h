@@ -0,0 +1,51 @@
+/*
+ *  Copyright (C) 2005-2020 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+#include <kodi/AddonBase.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Add-on wide worker threads that vgmstream uses to decode the channels of
+// high channel count streams in parallel (see vgmstream_channel_workers_setup).
+// Threads are only started once enabled, and jobs run on the calling thread
+// while disabled or when another stream is already using the workers.
+class ATTRIBUTE_HIDDEN CVGMChannelWorkers
+{
+public:
+  CVGMChannelWorkers() = default;
+  ~CVGMChannelWorkers();
+
+  // Starts or stops the worker threads
+  void Enable(bool enabled);
+
+  // Runner passed to vgmstream, data is the CVGMChannelWorkers
+  static void Run(void (*job)(void*, int), void* jobData, int count, void* data);
+
+private:
+  void RunJobs(void (*job)(void*, int), void* jobData, int count);
+  void WorkerThread();
+  void Stop();
+
+  std::mutex m_enableMutex; // Enable vs running batches
+  std::mutex m_mutex; // batch state
+  std::condition_variable m_workCond; // new batch or stop
+  std::condition_variable m_doneCond; // batch finished
+  std::vector<std::thread> m_threads;
+  bool m_stop = false;
+
+  // current batch, jobs are taken in order by workers and the caller
+  void (*m_job)(void*, int) = nullptr;
+  void* m_jobData = nullptr;
+  int m_count = 0;
+  int m_next = 0;
+  int m_pending = 0;
+};
@@ -7,36 +7,406 @@
 
 #include "VGMCodec.h"
 
+#include <kodi/AudioEngine.h>
 #include <kodi/Filesystem.h>
 #include <kodi/General.h>
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+
+// Seconds of audio between decoder checkpoints (their memory comes from the
+// memory budget, when full they get sparser)
+#define VGM_CHECKPOINT_SECONDS 10
+
+// Decode ahead ring size (decoded per step by the thread in the player's chunks)
+#define VGM_DECODE_AHEAD_MS 500
+// Low power always decodes ahead, longer and in bursts so the CPU can idle in between
+#define VGM_DECODE_AHEAD_LOW_POWER_MS 2000
+
+// Most channels given to Kodi, files with more are downmixed to the sink's channels
+#define VGM_MAX_OUTPUT_CHANNELS 8
+
+// Freed decoder structs (streams, channels, mixing buffers) kept for the next tracks
+#define VGM_DECODER_POOL_BLOCKS 32
+
+// Bytes past the file start and time in reads each format's detection may use before it's skipped,
+// so bad files that make a parser scan all of them don't stall library scans. Generous for real files.
+#define VGM_DETECTION_BUDGET_BYTES (128 * 1024 * 1024)
+#define VGM_DETECTION_BUDGET_MS 5000
+
+// Streams with fewer channels or calls with fewer samples are decoded on one thread
+#define VGM_PARALLEL_MIN_CHANNELS 12
+#define VGM_PARALLEL_MIN_SAMPLES 512
+
+// Volume normalization target (ReplayGain 2.0), in LUFS
+#define VGM_NORMALIZE_LOUDNESS -18.0
+
+// Heap used by vgmstream, counted by the allocator the addon installs (see CMyAddon)
+static std::atomic<size_t> g_vgmHeapSize{0};
+
+// For the startup profile
+static int64_t ElapsedUs(std::chrono::steady_clock::time_point since)
+{
+  auto elapsed = std::chrono::steady_clock::now() - since;
+  return std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+}
+
 extern "C"
 {
 
+  static size_t read_file_VFS(void* data, uint8_t* dest, off_t offset, size_t length)
+  {
+    kodi::vfs::CFile* file = static_cast<kodi::vfs::CFile*>(data);
+    if (file->GetPosition() != offset && file->Seek(offset, SEEK_SET) != offset)
+      return 0;
+
+    ssize_t read = file->Read(dest, length);
+    return read > 0 ? read : 0;
+  }
+
+  // Reads a remote file with the handle already at offset, opening up to VGM_VFS_REMOTE_HANDLES
+  // or else seeking them in turn (cache must be locked)
+  static size_t read_remote_VFS(void* data, uint8_t* dest, off_t offset, size_t length)
+  {
+    VGMFileCache* cache = static_cast<VGMFileCache*>(data);
+    if (cache->file.GetPosition() == offset)
+      return read_file_VFS(&cache->file, dest, offset, length);
+    for (const auto& handle : cache->remoteFiles)
+    {
+      if (handle->GetPosition() == offset)
+        return read_file_VFS(handle.get(), dest, offset, length);
+    }
+
+    if (cache->remoteFiles.size() + 1 < VGM_VFS_REMOTE_HANDLES)
+    {
+      std::unique_ptr<kodi::vfs::CFile> handle(new kodi::vfs::CFile);
+      if (handle->OpenFile(cache->name, ADDON_READ_CACHED))
+      {
+        cache->remoteFiles.push_back(std::move(handle));
+        return read_file_VFS(cache->remoteFiles.back().get(), dest, offset, length);
+      }
+    }
+
+    size_t index = cache->remoteNext++ % (cache->remoteFiles.size() + 1);
+    kodi::vfs::CFile* file = index == 0 ? &cache->file : cache->remoteFiles[index - 1].get();
+    return read_file_VFS(file, dest, offset, length);
+  }
+
+  // Network sources where seeks are costly, SMB and NFS seek fine
+  static bool is_remote_VFS(const char* const filename)
+  {
+    return kodi::vfs::IsInternetStream(filename) || strncmp(filename, "upnp://", 7) == 0 ||
+           strncmp(filename, "dav://", 6) == 0 || strncmp(filename, "davs://", 7) == 0;
+  }
+
+  // Adds read data as blocks (cache must be locked), returns the first one
+  static VGMBlock insert_blocks_VFS(VGMFileCache* cache, const uint8_t* buffer, off_t block_offset, size_t read)
+  {
+    VGMBlock result;
+    for (size_t pos = 0; pos < read; pos += cache->blocksize)
+    {
+      off_t offset = block_offset + pos;
+      size_t size = std::min(cache->blocksize, read - pos);
+      auto it = cache->index.find(offset);
+      if (it != cache->index.end())
+      {
+        cache->blocks.splice(cache->blocks.begin(), cache->blocks, it->second);
+      }
+      else
+      {
+        // reuse the oldest block's memory if the cache is full and no handle holds it
+        VGMBlock data;
+        if (cache->blocks.size() >= cache->maxblocks)
+        {
+          VGMFileCache::Entry& last = cache->blocks.back();
+          if (last.data.use_count() == 1)
+            data = std::move(last.data);
+          cache->index.erase(last.offset);
+          cache->blocks.pop_back();
+        }
+        if (!data)
+          data = std::make_shared<std::vector<uint8_t>>();
+
+        data->assign(buffer + pos, buffer + pos + size);
+        cache->blocks.push_front({offset, data});
+        cache->index[offset] = cache->blocks.begin();
+      }
+
+      if (pos == 0)
+        result = cache->blocks.front().data;
+    }
+
+    return result;
+  }
+
+  // Background reads of the blocks following sequential handles
+  static void prefetch_thread_VFS(VGMFileCache* cache)
+  {
+    kodi::vfs::CFile file;
+    std::vector<uint8_t> buffer(cache->buffersize);
+    bool opened = false;
+
+    std::unique_lock<std::mutex> lock(cache->mutex);
+    while (true)
+    {
+      cache->prefetchCond.wait(lock, [cache] { return cache->prefetchStop || !cache->prefetchRequests.empty(); });
+      if (cache->prefetchStop)
+        break;
+
+      off_t offset = cache->prefetchRequests.front();
+      cache->prefetchRequests.pop_front();
+      if (cache->index.find(offset) != cache->index.end())
+        continue;
+
+      // own handle so the decoder's reads aren't serialized behind this one
+      cache->prefetchOffset = offset;
+      lock.unlock();
+      if (!opened)
+        opened = file.OpenFile(cache->name, ADDON_READ_CACHED);
+      size_t read = opened ? page_cache_fill(cache->pages, buffer.data(), offset, cache->buffersize,
+                                             read_file_VFS, &file)
+                           : 0;
+      lock.lock();
+
+      if (read > 0)
+        insert_blocks_VFS(cache, buffer.data(), offset, read);
+      cache->prefetchOffset = -1;
+      cache->loadedCond.notify_all();
+    }
+  }
+
+  // Asks for the next window after a sequential read if less than half of it is
+  // cached (cache must be locked)
+  static void request_prefetch_VFS(VGMFileCache* cache, off_t next_offset)
+  {
+    off_t end = next_offset + cache->buffersize;
+    off_t offset = next_offset;
+    while (offset < end && offset < (off_t)cache->filesize &&
+           cache->index.find(offset) != cache->index.end())
+      offset += cache->blocksize;
+
+    if (offset >= (off_t)cache->filesize || offset - next_offset >= (off_t)cache->buffersize / 2)
+      return;
+    if (offset == cache->prefetchOffset)
+      return;
+    for (off_t request : cache->prefetchRequests)
+    {
+      if (request == offset)
+        return;
+    }
+
+    // one per channel is enough, older requests are likely stale
+    if (cache->prefetchRequests.size() >= VGM_VFS_PREFETCH_REQUESTS)
+      cache->prefetchRequests.pop_front();
+    cache->prefetchRequests.push_back(offset);
+
+    if (!cache->prefetchThread.joinable())
+      cache->prefetchThread = std::thread(prefetch_thread_VFS, cache);
+    cache->prefetchCond.notify_one();
+  }
+
+  // Returns the block at a block aligned offset, reading it (and the following
+  // read-ahead blocks) from VFS if no handle has loaded it yet.
+  static VGMBlock get_block_VFS(VGMFileCache* cache,
+                                off_t block_offset,
+                                bool sequential,
+                                streamfile_stats_t* stats)
+  {
+    std::unique_lock<std::mutex> lock(cache->mutex);
+
+    // being read in the background, wait for it rather than reading it twice
+    cache->loadedCond.wait(lock, [cache, block_offset] {
+      return cache->prefetchOffset < 0 || block_offset < cache->prefetchOffset ||
+             block_offset >= cache->prefetchOffset + (off_t)cache->buffersize;
+    });
+
+    VGMBlock result;
+    auto it = cache->index.find(block_offset);
+    if (it != cache->index.end())
+    {
+      cache->blocks.splice(cache->blocks.begin(), cache->blocks, it->second);
+      result = it->second->data;
+    }
+    else
+    {
+      auto start = std::chrono::steady_clock::now();
+      size_t read = cache->remote
+                        ? page_cache_fill(cache->pages, cache->readbuf.data(), block_offset,
+                                          cache->buffersize, read_remote_VFS, cache)
+                        : page_cache_fill(cache->pages, cache->readbuf.data(), block_offset,
+                                          cache->buffersize, read_file_VFS, &cache->file);
+      stats->bytes_read += read;
+      stats->read_time_us += std::chrono::duration_cast<std::chrono::microseconds>(
+                                 std::chrono::steady_clock::now() - start)
+                                 .count();
+      if (read == 0)
+        return nullptr;
+
+      result = insert_blocks_VFS(cache, cache->readbuf.data(), block_offset, read);
+    }
+
+    if (sequential && cache->prefetch)
+      request_prefetch_VFS(cache, block_offset + cache->blocksize);
+
+    return result;
+  }
+
   static size_t read_VFS(struct _STREAMFILE* streamfile, uint8_t* dest, off_t offset, size_t length)
   {
     VGMContext* ctx = (VGMContext*)streamfile;
-    if (ctx && ctx->file)
+    size_t length_read_total = 0;
+
+    if (!ctx || !ctx->cache || !dest || length <= 0 || offset < 0)
+      return 0;
+
+    VGMFileCache* cache = ctx->cache;
+    bool hit = true;
+    ctx->stats.read_calls++;
+    ctx->stats.bytes_requested += length;
+    while (length > 0)
     {
-      ctx->file->Seek(offset, SEEK_SET);
-      return ctx->file->Read(dest, length);
+      if (offset >= (off_t)cache->filesize)
+        break;
+
+      // keep the current block so reads inside it don't touch the shared cache
+      off_t block_offset = offset - (offset % cache->blocksize);
+      if (!ctx->block || ctx->block_offset != block_offset)
+      {
+        bool sequential = ctx->block && ctx->block_offset + (off_t)cache->blocksize == block_offset;
+        if (ctx->block && block_offset < ctx->block_offset)
+          ctx->stats.rebuffers_back++;
+        ctx->stats.buffer_misses++;
+        hit = false;
+        ctx->block = get_block_VFS(cache, block_offset, sequential, &ctx->stats);
+        ctx->block_offset = block_offset;
+        if (!ctx->block)
+          break;
+      }
+
+      size_t offset_into_block = offset - block_offset;
+      if (ctx->block->size() <= offset_into_block)
+        break; // EOF
+
+      size_t length_to_read = ctx->block->size() - offset_into_block;
+      if (length_to_read > length)
+        length_to_read = length;
+
+      memcpy(dest, ctx->block->data() + offset_into_block, length_to_read);
+      length_read_total += length_to_read;
+      length -= length_to_read;
+      offset += length_to_read;
+      dest += length_to_read;
     }
-    return 0;
+
+    if (hit)
+      ctx->stats.buffer_hits++;
+    ctx->offset = offset;
+    return length_read_total;
+  }
+
+  // Points into the current block if the whole range is inside it
+  static const uint8_t* read_ptr_VFS(struct _STREAMFILE* streamfile, off_t offset, size_t length)
+  {
+    VGMContext* ctx = (VGMContext*)streamfile;
+    if (!ctx || !ctx->cache || offset < 0)
+      return nullptr;
+
+    off_t block_offset = offset - (offset % ctx->cache->blocksize);
+    if (offset + length > block_offset + ctx->cache->blocksize)
+      return nullptr;
+
+    if (!ctx->block || ctx->block_offset != block_offset)
+    {
+      uint8_t byte;
+      ctx->stats.bytes_requested += length - 1;
+      if (read_VFS(streamfile, &byte, offset, 1) != 1)
+        return nullptr;
+    }
+    else
+    {
+      ctx->stats.read_calls++;
+      ctx->stats.bytes_requested += length;
+      ctx->stats.buffer_hits++;
+    }
+
+    if (ctx->block->size() < offset - block_offset + length)
+      return nullptr; // EOF
+
+    ctx->offset = offset + length;
+    return ctx->block->data() + (offset - block_offset);
+  }
+
+  static void get_stats_VFS(struct _STREAMFILE* streamfile, streamfile_stats_t* stats)
+  {
+    VGMContext* ctx = (VGMContext*)streamfile;
+    if (ctx)
+      *stats = ctx->stats;
+  }
+
+  // Queues the blocks of a range that will be read soon (ex. loop start) for background reads
+  static void prefetch_VFS(struct _STREAMFILE* streamfile, off_t offset, size_t length)
+  {
+    VGMContext* ctx = (VGMContext*)streamfile;
+    if (!ctx || !ctx->cache || !ctx->cache->prefetch)
+      return;
+
+    VGMFileCache* cache = ctx->cache;
+    std::lock_guard<std::mutex> lock(cache->mutex);
+    off_t end = std::min(offset + (off_t)length, (off_t)cache->filesize);
+    for (off_t block_offset = offset - (offset % cache->blocksize); block_offset < end;
+         block_offset += cache->buffersize)
+      request_prefetch_VFS(cache, block_offset);
+  }
+
+  // Drops the handle's reference to its current block, so the shared cache can evict it
+  static void release_VFS(struct _STREAMFILE* streamfile)
+  {
+    VGMContext* ctx = (VGMContext*)streamfile;
+    if (ctx)
+      ctx->block.reset();
   }
 
   static void close_VFS(struct _STREAMFILE* streamfile)
   {
     VGMContext* ctx = (VGMContext*)streamfile;
-    if (ctx && ctx->file)
-      delete ctx->file;
-    ctx->file = nullptr;
+    if (!ctx)
+      return;
+
+    VGMFileCache* cache = ctx->cache;
+    if (cache)
+    {
+      bool last;
+      {
+        std::lock_guard<std::mutex> lock(cache->mutex);
+        last = --cache->refs == 0;
+      }
+      if (last)
+      {
+        if (cache->prefetchThread.joinable())
+        {
+          {
+            std::lock_guard<std::mutex> lock(cache->mutex);
+            cache->prefetchStop = true;
+          }
+          cache->prefetchCond.notify_one();
+          cache->prefetchThread.join();
+        }
+        page_cache_close(cache->pages);
+        delete cache;
+      }
+    }
+    delete ctx;
   }
 
   static size_t get_size_VFS(struct _STREAMFILE* streamfile)
   {
     VGMContext* ctx = (VGMContext*)streamfile;
-    if (ctx && ctx->file)
-      return ctx->file->GetLength();
+    if (ctx && ctx->cache)
+      return ctx->cache->filesize;
 
     return 0;
   }
@@ -44,36 +414,168 @@ extern "C"
   static off_t get_offset_VFS(struct _STREAMFILE* streamfile)
   {
     VGMContext* ctx = (VGMContext*)streamfile;
-    if (ctx && ctx->file)
-      return ctx->file->GetPosition();
+    if (ctx && ctx->cache)
+      return ctx->offset;
 
     return 0;
   }
 
+  // Opens the file behind a shared cache. Blocks are rounded to the VFS's chunk size (SMB, NFS
+  // and HTTP prefer different ones) and buffersize to whole blocks. Files up to wholefile bytes
+  // are read here in one go and kept whole, so handles never go back to VFS. Remote files read
+  // big windows when reading ahead (fewer range requests), prefetch and keep more blocks.
+  static VGMFileCache* open_cache_VFS(const char* const filename,
+                                      size_t blocksize,
+                                      size_t buffersize,
+                                      bool prefetch,
+                                      size_t wholefile)
+  {
+    VGMFileCache* cache = new VGMFileCache;
+    if (!cache->file.OpenFile(filename, ADDON_READ_CACHED))
+    {
+      delete cache;
+      return nullptr;
+    }
+
+    if (blocksize == 0)
+      blocksize = VGM_VFS_BLOCK_SIZE;
+    cache->remote = is_remote_VFS(filename);
+    if (cache->remote && buffersize > blocksize) // not for header probes
+    {
+      buffersize = std::max(buffersize, (size_t)VGM_VFS_REMOTE_READ);
+      prefetch = true;
+    }
+    int chunksize = cache->file.GetChunkSize();
+    if (chunksize > 1 && (size_t)chunksize <= VGM_VFS_READAHEAD_MAX)
+      blocksize = (blocksize + chunksize - 1) / chunksize * chunksize;
+    if (buffersize > VGM_VFS_READAHEAD_MAX)
+      buffersize = VGM_VFS_READAHEAD_MAX;
+    buffersize = (buffersize + blocksize - 1) / blocksize * blocksize;
+    if (buffersize < blocksize)
+      buffersize = blocksize;
+
+    cache->name = filename;
+    cache->blocksize = blocksize;
+    cache->buffersize = buffersize;
+    cache->prefetch = prefetch;
+    size_t sharedmax = cache->remote ? VGM_VFS_REMOTE_SHARED_MAX : VGM_VFS_SHARED_MAX;
+    cache->maxblocks = std::max(sharedmax / blocksize, buffersize / blocksize * 2);
+    cache->readbuf.resize(buffersize);
+    cache->filesize = cache->file.GetLength();
+
+    kodi::vfs::FileStatus status;
+    uint64_t stamp = 0;
+    if (kodi::vfs::StatFile(filename, status))
+      stamp = status.GetModificationTime();
+    cache->pages = page_cache_open(filename, cache->filesize, stamp);
+
+    cache->wholefile = wholefile;
+    if (cache->filesize > 0 && cache->filesize <= wholefile)
+    {
+      std::vector<uint8_t> buffer(cache->filesize);
+      size_t read = page_cache_fill(cache->pages, buffer.data(), 0, cache->filesize, read_file_VFS,
+                                    &cache->file);
+      if (read == cache->filesize)
+      {
+        cache->maxblocks = std::max(cache->maxblocks, (read + blocksize - 1) / blocksize);
+        insert_blocks_VFS(cache, buffer.data(), 0, read);
+      }
+    }
+    return cache;
+  }
+
   static void get_name_VFS(struct _STREAMFILE* streamfile, char* buffer, size_t length)
   {
     VGMContext* ctx = (VGMContext*)streamfile;
-    if (ctx)
-      strcpy(buffer, ctx->name);
+    if (!ctx || length == 0)
+      return;
+
+    size_t copy = std::min(ctx->cache->name.size(), length - 1);
+    memcpy(buffer, ctx->cache->name.data(), copy);
+    buffer[copy] = '\0';
+  }
+
+  // The name is kept once in the cache shared by all handles of the file
+  static const char* get_name_ref_VFS(struct _STREAMFILE* streamfile)
+  {
+    VGMContext* ctx = (VGMContext*)streamfile;
+    return ctx ? ctx->cache->name.c_str() : nullptr;
   }
 
   static struct _STREAMFILE* open_VFS(struct _STREAMFILE* streamfile,
                                       const char* const filename,
-                                      size_t buffersize)
+                                      size_t buffersize);
+
+  // Makes a new handle over a cache, which the handle takes a reference of
+  static VGMContext* open_handle_VFS(VGMFileCache* cache)
   {
-    VGMContext* ctx = (VGMContext*)streamfile;
+    VGMContext* ctx = new VGMContext;
+    ctx->cache = cache;
     ctx->pos = 0;
-    ctx->file = new kodi::vfs::CFile;
-    ctx->file->OpenFile(filename, ADDON_READ_CACHED);
     ctx->sf.read = read_VFS;
     ctx->sf.get_size = get_size_VFS;
     ctx->sf.get_offset = get_offset_VFS;
     ctx->sf.get_name = get_name_VFS;
     ctx->sf.open = open_VFS;
     ctx->sf.close = close_VFS;
-    strcpy(ctx->name, filename);
+    ctx->sf.read_ptr = read_ptr_VFS;
+    ctx->sf.get_stats = get_stats_VFS;
+    ctx->sf.release = release_VFS;
+    ctx->sf.get_name_ref = get_name_ref_VFS;
+    ctx->sf.prefetch = prefetch_VFS;
 
-    return streamfile;
+    return ctx;
+  }
+
+  // Opens a new file, nullptr if it doesn't exist (ex. companion files)
+  static VGMContext* open_context_VFS(const char* const filename,
+                                      size_t blocksize,
+                                      size_t buffersize,
+                                      bool prefetch,
+                                      size_t wholefile = 0)
+  {
+    if (!filename)
+      return nullptr;
+
+    VGMFileCache* cache = open_cache_VFS(filename, blocksize, buffersize, prefetch, wholefile);
+    if (!cache)
+      return nullptr;
+
+    return open_handle_VFS(cache);
+  }
+
+  // Reopen from vgmstream (channels, companion files), gets its own handle but
+  // shares the parent's blocks when it's the same file
+  static struct _STREAMFILE* open_VFS(struct _STREAMFILE* streamfile,
+                                      const char* const filename,
+                                      size_t buffersize)
+  {
+    VGMContext* parent = (VGMContext*)streamfile;
+    if (!filename)
+      return nullptr;
+
+    if (parent->cache->name == filename)
+    {
+      {
+        std::lock_guard<std::mutex> lock(parent->cache->mutex);
+        parent->cache->refs++;
+      }
+      return (struct _STREAMFILE*)open_handle_VFS(parent->cache);
+    }
+
+    return (struct _STREAMFILE*)open_context_VFS(filename, parent->cache->blocksize,
+                                                 parent->cache->buffersize, parent->cache->prefetch,
+                                                 parent->cache->wholefile);
+  }
+
+  void free_VFS(VGMContext* ctx)
+  {
+    if (!ctx)
+      return;
+
+    if (ctx->stream)
+      close_vgmstream(ctx->stream);
+    close_VFS((struct _STREAMFILE*)ctx);
   }
 
 } /* extern "C" */
@@ -82,17 +584,87 @@ extern "C"
 
 bool CVGMCodec::m_loopForEverActive = false;
 
-CVGMCodec::CVGMCodec(KODI_HANDLE instance, const std::string& version)
-  : CInstanceAudioDecoder(instance, version)
+CVGMCodec::CVGMCodec(KODI_HANDLE instance, const std::string& version, VGMShared& shared)
+  : CInstanceAudioDecoder(instance, version),
+    m_cache(shared.streamCache),
+    m_detection(shared.detection),
+    m_pcmCache(shared.pcmCache),
+    m_workers(shared.channelWorkers)
 {
 }
 
 CVGMCodec::~CVGMCodec()
 {
-  if (ctx.stream)
-    close_vgmstream(ctx.stream);
+  if (m_openThread.joinable())
+    m_openThread.join();
+  free_VFS(m_header);
+  StopDecodeThread();
+  vgmstream_log_drain();
+  DiscardPcmCache();
+  m_pcmFile.Close();
+  vgmstream_player_free(m_player);
+
+  if (ctx && ctx->stream)
+  {
+    streamfile_stats_t stats;
+    get_vgmstream_io_stats(ctx->stream, &stats);
+    kodi::Log(ADDON_LOG_DEBUG,
+              "I/O stats for %s: %llu reads (%llu bytes), %llu hits, %llu misses (%llu back), "
+              "%llu bytes read in %llu ms, %llu buffer bytes at most",
+              m_filename.c_str(), (unsigned long long)stats.read_calls,
+              (unsigned long long)stats.bytes_requested, (unsigned long long)stats.buffer_hits,
+              (unsigned long long)stats.buffer_misses, (unsigned long long)stats.rebuffers_back,
+              (unsigned long long)stats.bytes_read, (unsigned long long)stats.read_time_us / 1000,
+              (unsigned long long)stats.buffer_peak);
+
+    vgmstream_memory_usage_t usage;
+    vgmstream_get_memory_usage(&usage);
+    kodi::Log(ADDON_LOG_DEBUG,
+              "Memory used by vgmstream: %zu bytes (page cache %zu, buffers %zu, pooled buffers %zu, "
+              "decoder pool %zu, checkpoints %zu), %zu heap bytes in total",
+              usage.total, usage.page_cache, usage.stream_buffers, usage.buffer_pool,
+              usage.decoder_pool, usage.checkpoints, g_vgmHeapSize.load());
 
-  delete ctx.file;
+    if (ctx->stream->profile)
+    {
+      vgmstream_profile_t profile;
+      vgmstream_get_profile(ctx->stream, &profile);
+      kodi::Log(ADDON_LOG_DEBUG,
+                "Decoding profile for %s: %llu renders in %llu ms (decode %llu ms in %llu calls, "
+                "layout %llu ms, mix %llu ms, output %llu ms, file reads %llu ms), %i underruns",
+                m_filename.c_str(), (unsigned long long)profile.render_calls,
+                (unsigned long long)profile.render_time_us / 1000,
+                (unsigned long long)profile.decode_time_us / 1000,
+                (unsigned long long)profile.decode_calls,
+                (unsigned long long)profile.layout_time_us / 1000,
+                (unsigned long long)profile.mix_time_us / 1000,
+                (unsigned long long)profile.output_time_us / 1000,
+                (unsigned long long)profile.read_time_us / 1000, m_underruns);
+      vgmstream_set_profiling(ctx->stream, 0);
+    }
+
+    // Info rather than debug, so it's in the logs of devices that don't have debug logging on
+    if (m_telemetry.IsEnabled())
+    {
+      char coding[128];
+      get_vgmstream_coding_description(ctx->stream, coding, sizeof(coding));
+      kodi::Log(ADDON_LOG_INFO, "Telemetry for %s (%s, %i Hz, %i channels%s): %s",
+                m_filename.c_str(), coding, ctx->stream->sample_rate, ctx->stream->channels,
+                m_decodeAhead ? ", decode ahead" : "", m_telemetry.Summary().c_str());
+    }
+  }
+
+  // Keep the opened stream around in case the same file is played again soon
+  if (ctx && ctx->stream)
+  {
+    reset_vgmstream(ctx->stream);
+    release_vgmstream_buffers(ctx->stream);
+    m_cache.Put(m_filename, ctx);
+  }
+  else
+  {
+    free_VFS(ctx);
+  }
 
   // Set the static to false only from one where has set it before
   if (m_loopForEverInUse)
@@ -109,20 +681,96 @@ bool CVGMCodec::Init(const std::string& filename,
                      AudioEngineDataFormat& format,
                      std::vector<AudioEngineChannel>& channellist)
 {
-  open_VFS((struct _STREAMFILE*)&ctx, filename.c_str(), 0);
+  // Use the player's file cache hint to decide how much to read ahead
+  size_t blocksize = kodi::GetSettingInt("readblocksize") * 1024;
+  size_t readahead = filecache > 0 ? filecache : blocksize * VGM_VFS_READAHEAD_BLOCKS;
+  std::string file;
+  int subsong;
+  SplitSubsongPath(filename, file, subsong);
 
-  ctx.stream = init_vgmstream_from_STREAMFILE((struct _STREAMFILE*)&ctx);
-  if (!ctx.stream)
+  m_filename = filename;
+  m_started = false;
+  m_startupPending = kodi::GetSettingBoolean("profile");
+  m_initTime = std::chrono::steady_clock::now();
+  m_openUs = m_detectUs = m_startUs = -1;
+  ctx = m_cache.Take(filename);
+  VGMSTREAM* info = ctx ? ctx->stream : nullptr; // format info, ctx is set by the thread otherwise
+  if (!ctx)
   {
-    close_VFS((struct _STREAMFILE*)&ctx);
-    return false;
+    VGMContext* opened = open_context_VFS(file.c_str(), blocksize, readahead,
+                                          kodi::GetSettingBoolean("prefetch"),
+                                          (size_t)kodi::GetSettingInt("wholefile") * 1024 * 1024);
+    if (!opened)
+      return false;
+    m_openUs = ElapsedUs(m_initTime);
+
+    // Files seen on previous runs go straight to the format that opened them
+    CVGMDetectionCache::Info known;
+    m_detection.Load(DetectionCacheEnabled());
+    bool found = m_detection.Get(filename, file, known);
+
+    // Quick start only reads the header here (no channel opens)
+    opened->sf.stream_index = subsong;
+    opened->sf.probe_only = kodi::GetSettingBoolean("quickstart");
+    opened->stream = init_vgmstream_from_STREAMFILE_index((struct _STREAMFILE*)opened, known.initIndex);
+    if (!opened->stream)
+    {
+      free_VFS(opened);
+      return false;
+    }
+
+    if (!found || known.initIndex != opened->stream->init_index)
+      m_detection.Put(filename, file, opened->stream);
+
+    streamfile_stats_t stats;
+    get_streamfile_stats((struct _STREAMFILE*)opened, &stats);
+    m_detectUs = ElapsedUs(m_initTime) - m_openUs;
+    m_detectCached = found && known.initIndex == opened->stream->init_index;
+    m_detectBytes = stats.bytes_read;
+
+    info = opened->stream;
+    m_channels = info->channels;
+    m_sampleRate = info->sample_rate;
+    if (opened->sf.probe_only)
+    {
+      m_header = opened;
+      m_openThread = std::thread(&CVGMCodec::OpenThread, this);
+    }
+    else
+    {
+      ctx = opened;
+    }
   }
 
-  channels = ctx.stream->channels;
-  samplerate = ctx.stream->sample_rate;
-  bitspersample = 16;
-  totaltime = ctx.stream->num_samples / ctx.stream->sample_rate * 1000;
-  format = AUDIOENGINE_FMT_S16NE;
+  // Loops, fades and end trimming are done by vgmstream's renders from here on
+  // (applied by the player too, here for the duration)
+  vgmstream_cfg_t vcfg;
+  GetPlayConfig(vcfg);
+  vgmstream_apply_config(info, &vcfg);
+
+  // Downmixed by vgmstream's mixing (set up here to know the result, enabled on start)
+  m_downmixChannels = 0;
+  m_outputChannels = info->channels;
+  if (info->channels > VGM_MAX_OUTPUT_CHANNELS)
+  {
+    m_downmixChannels = GetDownmixChannels();
+    vgmstream_mixing_autodownmix(info, m_downmixChannels);
+    vgmstream_mixing_enable(info, 0, nullptr, &m_outputChannels);
+  }
+
+  channels = m_outputChannels;
+  samplerate = info->sample_rate;
+
+  // Leaves the original rate when unset or already the same
+  m_lowPower = vgmstream_is_low_power() != 0;
+  int outputRate = kodi::GetSettingInt("outputsamplerate");
+  if (m_resampler.Init(channels, samplerate, outputRate, m_lowPower))
+    samplerate = outputRate;
+  m_outputRate = samplerate;
+  bitspersample = 32;
+
+  totaltime = (int64_t)vgmstream_get_samples(info) * 1000 / info->sample_rate;
+  format = AUDIOENGINE_FMT_FLOAT;
 
   // clang-format off
   static std::vector<std::vector<enum AudioEngineChannel>> map = {
@@ -137,12 +785,11 @@ bool CVGMCodec::Init(const std::string& filename,
     };
   // clang-format on
 
-  if (ctx.stream->channels <= 8)
-    channellist = map[ctx.stream->channels - 1];
+  if (m_outputChannels <= VGM_MAX_OUTPUT_CHANNELS)
+    channellist = map[m_outputChannels - 1];
 
   bitrate = 0;
-  m_loopForEver = kodi::GetSettingBoolean("loopforever");
-  if (!m_loopForEverActive && m_loopForEver && ctx.stream->loop_flag)
+  if (!m_loopForEverActive && info->pstate.play_forever)
   {
     m_loopForEverActive = true; // Set static to know on others that becomes active
     m_loopForEverInUse =
@@ -150,90 +797,975 @@ bool CVGMCodec::Init(const std::string& filename,
     kodi::QueueNotification(QUEUE_INFO, "", kodi::GetLocalizedString(30002));
   }
 
+  // Files measured on library scans play at the same loudness, without clipping
+  m_gain = 1.0f;
+  CVGMDetectionCache::Info analysis;
+  if (kodi::GetSettingBoolean("normalize") && m_detection.Get(filename, file, analysis) &&
+      analysis.analyzed && analysis.peak > 0.0)
+  {
+    double gain = std::pow(10.0, (VGM_NORMALIZE_LOUDNESS - analysis.loudness) / 20.0);
+    m_gain = (float)std::min(gain, 1.0 / analysis.peak);
+  }
+
+  if (m_header)
+    return true;
+  return Start();
+}
+
+int CVGMCodec::GetDownmixChannels()
+{
+  // Same as the sink when it can tell, stereo otherwise
+  kodi::audioengine::AudioEngineFormat sink;
+  if (!kodi::audioengine::GetCurrentSinkFormat(sink))
+    return 2;
+  int channels = (int)sink.GetChannelCount();
+  if (channels < 1 || channels > VGM_MAX_OUTPUT_CHANNELS)
+    return 2;
+  return channels;
+}
+
+void CVGMCodec::OpenThread()
+{
+  // A new handle shares the header's file blocks, and its format needs no detection
+  VGMContext* opened = (VGMContext*)open_VFS(&m_header->sf, m_header->cache->name.c_str(), 0);
+  if (!opened)
+    return;
+
+  opened->sf.stream_index = m_header->sf.stream_index;
+  opened->stream = init_vgmstream_from_STREAMFILE_index((struct _STREAMFILE*)opened,
+                                                        m_header->stream->init_index);
+  if (!opened->stream || opened->stream->channels != m_channels ||
+      opened->stream->sample_rate != m_sampleRate)
+  {
+    free_VFS(opened);
+    return;
+  }
+
+  ctx = opened;
+}
+
+bool CVGMCodec::Start()
+{
+  if (m_started)
+    return true;
+
+  if (m_openThread.joinable())
+    m_openThread.join();
+  free_VFS(m_header);
+  m_header = nullptr;
+  if (!ctx)
+    return false;
+
+  vgmstream_cfg_t vcfg;
+  GetPlayConfig(vcfg);
+
+  vgmstream_player_cfg pcfg = {};
+  pcfg.play_cfg = &vcfg;
+  pcfg.approximate_seek = kodi::GetSettingBoolean("fastseek");
+  pcfg.checkpoint_seconds = VGM_CHECKPOINT_SECONDS;
+  pcfg.checkpoint_budget = 0; // share of the memory budget
+  vgmstream_player_free(m_player);
+  m_player = vgmstream_player_init(ctx->stream, &pcfg);
+  if (!m_player)
+    return false;
+
+  // Streams opened after Init (quick start) still need their downmix, cached ones keep theirs
+  if (m_downmixChannels > 0)
+  {
+    int outputChannels = ctx->stream->channels;
+    vgmstream_mixing_enable(ctx->stream, 0, nullptr, &outputChannels);
+    if (outputChannels > m_downmixChannels)
+      vgmstream_mixing_autodownmix(ctx->stream, m_downmixChannels);
+    vgmstream_mixing_enable(ctx->stream, vgmstream_player_get_chunk_samples(m_player), nullptr,
+                            &outputChannels);
+    if (outputChannels != m_outputChannels)
+      return false;
+  }
+
+  // Cheap enough to leave on, logged on close
+  vgmstream_set_profiling(ctx->stream, kodi::GetSettingBoolean("profile"));
+  m_telemetry.Start(kodi::GetSettingBoolean("telemetry"),
+                    (int64_t)m_outputRate * m_outputChannels * sizeof(float));
+
+  if (m_resampler.IsActive())
+  {
+    m_resampleIn.resize(vgmstream_player_get_chunk_samples(m_player) * m_outputChannels);
+    m_resampleInputEnd = false;
+  }
+
+  // Short enough loops are decoded once and then repeated from memory
+  const VGMSTREAM* stream = ctx->stream;
+  size_t loopCacheMax = std::min((size_t)kodi::GetSettingInt("loopcachesize") * 1024 * 1024,
+                                  vgmstream_memory_budget_get_host_cache());
+  m_loopCacheEnabled = stream->pstate.play_forever &&
+                       stream->loop_end_sample > stream->loop_start_sample &&
+                       (size_t)(stream->loop_end_sample - stream->loop_start_sample) *
+                               m_outputChannels * sizeof(float) <=
+                           loopCacheMax;
+  m_loopCacheReady = false;
+  m_loopCacheActive = false;
+  m_loopCacheFilled = 0;
+  m_loopCache.clear();
+  // allocated here rather than when first filled, as that happens on the decode thread
+  if (m_loopCacheEnabled)
+    m_loopCache.resize((size_t)(stream->loop_end_sample - stream->loop_start_sample) *
+                       m_outputChannels);
+
   m_endReached = false;
 
+  OpenPcmCache();
+
+  m_workers.Enable(kodi::GetSettingBoolean("paralleldecode"));
+
+  m_decodeAhead = kodi::GetSettingBoolean("decodeahead") || m_lowPower;
+  if (m_decodeAhead)
+    StartDecodeThread();
+
+  m_started = true;
+  m_startUs = ElapsedUs(m_initTime);
   return true;
 }
 
+void CVGMCodec::LogStartup()
+{
+  m_startupPending = false;
+  int64_t firstUs = ElapsedUs(m_initTime);
+  if (m_openUs < 0)
+  {
+    kodi::Log(ADDON_LOG_DEBUG,
+              "Startup profile for %s: reused open stream, ready in %.1f ms, first samples in "
+              "%.1f ms",
+              m_filename.c_str(), m_startUs / 1000.0, firstUs / 1000.0);
+    return;
+  }
+
+  kodi::Log(ADDON_LOG_DEBUG,
+            "Startup profile for %s: open %.1f ms, detection %.1f ms (%s, %llu bytes read), "
+            "ready in %.1f ms, first samples in %.1f ms",
+            m_filename.c_str(), m_openUs / 1000.0, m_detectUs / 1000.0,
+            m_detectCached ? "cached format" : "all formats", (unsigned long long)m_detectBytes,
+            m_startUs / 1000.0, firstUs / 1000.0);
+}
+
 int CVGMCodec::ReadPCM(uint8_t* buffer, int size, int& actualsize)
 {
+  auto start = std::chrono::steady_clock::now();
   if (m_endReached)
     return -1;
+  if (!m_started && !Start())
+  {
+    m_endReached = true;
+    return -1;
+  }
 
-  bool loopForever = m_loopForEver && ctx.stream->loop_flag;
-  if (!loopForever)
+  if (m_decodeAhead)
   {
-    int decodePosSamples = size / (2 * ctx.stream->channels);
-    if (decodePosSamples + ctx.stream->current_sample > ctx.stream->num_samples)
+    actualsize = ReadRing(buffer, size);
+    if (actualsize == 0)
     {
-      size = (decodePosSamples - ctx.stream->num_samples) * (ctx.stream->channels / 2);
       m_endReached = true;
+      return -1;
     }
+    if (m_startupPending)
+      LogStartup();
+    m_telemetry.AddRead(ElapsedUs(start), actualsize);
+    return 0;
   }
 
-  render_vgmstream((sample*)buffer, size / (2 * ctx.stream->channels), ctx.stream);
-  actualsize = size;
-
-  ctx.pos += size;
+  bool end = false;
+  actualsize = Decode(buffer, size, end);
+  if (end)
+    m_endReached = true;
+  if (m_startupPending && actualsize > 0)
+    LogStartup();
+  m_telemetry.AddRead(ElapsedUs(start), actualsize);
   return 0;
 }
 
-int64_t CVGMCodec::Seek(int64_t time)
+int CVGMCodec::Decode(uint8_t* buffer, int size, bool& end)
 {
-  int16_t* buffer = new int16_t[576 * ctx.stream->channels];
-  if (!buffer)
-    return 0;
+  if (!m_telemetry.IsEnabled())
+    return DecodeOutput(buffer, size, end);
 
-  long samples_to_do = (long)time * ctx.stream->sample_rate / 1000L;
-  if (samples_to_do < ctx.stream->current_sample)
-    reset_vgmstream(ctx.stream);
+  // file reads are counted by the stream's handles, on this thread
+  streamfile_stats_t before, after;
+  get_vgmstream_io_stats(ctx->stream, &before);
+  auto start = std::chrono::steady_clock::now();
+  int done = DecodeOutput(buffer, size, end);
+  int64_t decodeUs = ElapsedUs(start);
+  get_vgmstream_io_stats(ctx->stream, &after);
+  m_telemetry.AddDecode(decodeUs, (int64_t)(after.read_time_us - before.read_time_us), done);
+  return done;
+}
+
+int CVGMCodec::DecodeOutput(uint8_t* buffer, int size, bool& end)
+{
+  if (m_resampler.IsActive())
+    return DecodeResampled(buffer, size, end);
+  return DecodeStream(buffer, size, end);
+}
+
+int CVGMCodec::DecodeStream(uint8_t* buffer, int size, bool& end)
+{
+  // renders stop at the configured end (after loops and fade)
+  int32_t length = vgmstream_player_get_length(m_player);
+  bool loopForever = length < 0;
+
+  int frames = size / (sizeof(float) * m_outputChannels);
+  int32_t start = ctx->stream->current_sample;
+  if (m_pcmReading)
+  {
+    frames = ReadPcmCache((float*)buffer, frames, end);
+    size = frames * m_outputChannels * sizeof(float);
+  }
+  else if (loopForever && ReadLoopCache((float*)buffer, frames))
+  {
+    ctx->pos += size;
+    return size;
+  }
   else
-    samples_to_do -= ctx.stream->current_sample;
+  {
+    frames = vgmstream_player_render_float(m_player, (float*)buffer, frames);
+    size = frames * m_outputChannels * sizeof(float);
+    if (!loopForever && vgmstream_player_get_position(m_player) >= length)
+      end = true;
+
+    // before the gain, that may change on the next play
+    if (m_pcmWriting)
+      WritePcmCache((float*)buffer, frames);
+  }
+
+  if (m_gain != 1.0f)
+  {
+    float* samples = (float*)buffer;
+    for (size_t i = 0; i < size / sizeof(float); i++)
+      samples[i] *= m_gain;
+  }
 
-  while (samples_to_do > 0)
+  if (loopForever && !m_pcmReading)
+    FillLoopCache((float*)buffer, frames, start);
+
+  ctx->pos += size;
+  return size;
+}
+
+bool CVGMCodec::ReadLoopCache(float* samples, int frames)
+{
+  if (!m_loopCacheReady)
+    return false;
+
+  // once ready, takes over whenever the stream is inside the loop section
+  const int channels = m_outputChannels;
+  const size_t loopFrames = m_loopCache.size() / channels;
+  if (!m_loopCacheActive)
+  {
+    int32_t current = ctx->stream->current_sample;
+    if (current < ctx->stream->loop_start_sample || current > ctx->stream->loop_end_sample)
+      return false;
+    m_loopCachePos = (current - ctx->stream->loop_start_sample) % loopFrames;
+    m_loopCacheActive = true;
+  }
+
+  int done = 0;
+  while (done < frames)
   {
-    long l = samples_to_do > 576 ? 576 : samples_to_do;
-    render_vgmstream(buffer, l, ctx.stream);
-    samples_to_do -= l;
+    size_t todo = std::min((size_t)(frames - done), loopFrames - m_loopCachePos);
+    memcpy(samples + done * channels, m_loopCache.data() + m_loopCachePos * channels,
+           todo * channels * sizeof(float));
+    m_loopCachePos = (m_loopCachePos + todo) % loopFrames;
+    done += todo;
   }
-  delete[] buffer;
+  return true;
+}
+
+void CVGMCodec::FillLoopCache(const float* samples, int frames, int32_t start)
+{
+  if (!m_loopCacheEnabled || m_loopCacheReady)
+    return;
+
+  // rendered frames go from start and jump back to loop start at loop end
+  const int channels = m_outputChannels;
+  const int32_t loopStart = ctx->stream->loop_start_sample;
+  const int32_t loopEnd = ctx->stream->loop_end_sample;
+  int32_t pos = start;
+  int done = 0;
+  while (done < frames)
+  {
+    if (pos >= loopEnd)
+      pos = loopStart;
+    if (pos < loopStart)
+    {
+      int todo = std::min(frames - done, loopStart - pos);
+      pos += todo;
+      done += todo;
+      continue;
+    }
+
+    // must be filled in order from loop start, parts skipped by seeks wait for the next pass
+    int todo = std::min(frames - done, loopEnd - pos);
+    int32_t offset = pos - loopStart;
+    if (offset != m_loopCacheFilled)
+      m_loopCacheFilled = 0;
+    if (offset == m_loopCacheFilled)
+    {
+      memcpy(m_loopCache.data() + (size_t)offset * channels, samples + done * channels,
+             todo * channels * sizeof(float));
+      m_loopCacheFilled += todo;
+      if (m_loopCacheFilled == loopEnd - loopStart)
+      {
+        m_loopCacheReady = true;
+        return;
+      }
+    }
+    pos += todo;
+    done += todo;
+  }
+}
+
+bool CVGMCodec::IsSlowCodec(const VGMSTREAM* stream)
+{
+  // transform codecs that may not keep up on weak devices, cheap ones are faster than the disk
+  switch (stream->coding_type)
+  {
+    case coding_RELIC:
+    case coding_CRI_HCA:
+    case coding_EA_XAS_V0:
+    case coding_EA_XAS_V1:
+#ifdef VGM_USE_G7221
+    case coding_G7221C:
+#endif
+#ifdef VGM_USE_ATRAC9
+    case coding_ATRAC9:
+#endif
+      return true;
+    default:
+      return false;
+  }
+}
+
+void CVGMCodec::OpenPcmCache()
+{
+  m_pcmReading = false;
+  m_pcmWriting = false;
+  m_pcmFile.Close();
+
+  m_pcmCache.Configure((uint64_t)kodi::GetSettingInt("pcmcache") * 1024 * 1024);
+  const VGMSTREAM* stream = ctx->stream;
+  if (!m_pcmCache.IsEnabled() || !IsSlowCodec(stream))
+    return;
+
+  // looping forever repeats the loop section after loop end, so that's all there is to keep
+  int32_t length = vgmstream_player_get_length(m_player);
+  if (length < 0 && stream->loop_end_sample <= stream->loop_start_sample)
+    return;
+  m_pcmFrames = length >= 0 ? length : stream->loop_end_sample;
+  if (m_pcmFrames <= 0)
+    return;
+
+  std::string file;
+  int subsong;
+  SplitSubsongPath(m_filename, file, subsong);
+
+  // the file and subsong are in the key, only play settings that change the output are added
+  char config[64];
+  if (length < 0)
+  {
+    snprintf(config, sizeof(config), "forever");
+  }
+  else
+  {
+    vgmstream_cfg_t vcfg;
+    GetPlayConfig(vcfg);
+    snprintf(config, sizeof(config), "%g %g %g", vcfg.loop_count, vcfg.fade_time, vcfg.fade_delay);
+  }
+  if (m_outputChannels != stream->channels)
+    snprintf(config + strlen(config), sizeof(config) - strlen(config), " %dch", m_outputChannels);
+  m_pcmKey = m_pcmCache.GetKey(m_filename, file, config);
+  if (m_pcmKey.empty())
+    return;
+
+  const int64_t bytes = m_pcmFrames * m_outputChannels * sizeof(float);
+  std::string path = m_pcmCache.Find(m_pcmKey);
+  if (!path.empty() && m_pcmFile.OpenFile(path) && m_pcmFile.GetLength() == bytes)
+  {
+    m_pcmReading = true;
+    m_pcmPos = 0;
+
+    // the loop section is read from disk too
+    m_loopCacheEnabled = false;
+    std::vector<float>().swap(m_loopCache);
+    return;
+  }
+  m_pcmFile.Close();
+
+  m_pcmTemp = m_pcmCache.BeginWrite(m_pcmKey);
+  if (!m_pcmTemp.empty() && m_pcmFile.OpenFileForWrite(m_pcmTemp, true))
+  {
+    m_pcmWriting = true;
+    m_pcmPos = 0;
+  }
+}
+
+int CVGMCodec::ReadPcmCache(float* samples, int frames, bool& end)
+{
+  const int channels = m_outputChannels;
+  const bool loopForever = vgmstream_player_get_length(m_player) < 0;
+  const int64_t loopStart = ctx->stream->loop_start_sample;
+  int done = 0;
+  while (done < frames)
+  {
+    // past loop end the loop section repeats (kept up to there when looping forever)
+    int64_t pos = m_pcmPos;
+    if (loopForever && pos >= m_pcmFrames)
+      pos = loopStart + (pos - loopStart) % (m_pcmFrames - loopStart);
+    if (pos >= m_pcmFrames)
+      break;
+
+    int64_t todo = std::min((int64_t)(frames - done), m_pcmFrames - pos);
+    int64_t offset = pos * channels * sizeof(float);
+    ssize_t bytes = todo * channels * sizeof(float);
+    if (m_pcmFile.GetPosition() != offset && m_pcmFile.Seek(offset, SEEK_SET) != offset)
+      break;
+    if (m_pcmFile.Read(samples + (size_t)done * channels, bytes) != bytes)
+      break;
+    done += todo;
+    m_pcmPos += todo;
+  }
+
+  if (done < frames)
+    end = true; // end of the play, or a broken entry
+  return done;
+}
+
+void CVGMCodec::WritePcmCache(const float* samples, int frames)
+{
+  const int channels = m_outputChannels;
+  int64_t todo = std::min((int64_t)frames, m_pcmFrames - m_pcmPos);
+  ssize_t bytes = todo * channels * sizeof(float);
+  if (m_pcmFile.Write(samples, bytes) != bytes)
+  {
+    DiscardPcmCache();
+    return;
+  }
+
+  m_pcmPos += todo;
+  if (m_pcmPos < m_pcmFrames)
+    return;
+
+  m_pcmFile.Close();
+  m_pcmWriting = false;
+  m_pcmCache.Commit(m_pcmKey, m_pcmTemp, m_pcmFrames * channels * sizeof(float));
+}
+
+void CVGMCodec::DiscardPcmCache()
+{
+  if (!m_pcmWriting)
+    return;
+
+  m_pcmFile.Close();
+  m_pcmWriting = false;
+  m_pcmCache.Discard(m_pcmTemp);
+}
+
+int CVGMCodec::DecodeResampled(uint8_t* buffer, int size, bool& end)
+{
+  const int channels = m_outputChannels;
+  const size_t frames = size / (sizeof(float) * channels);
+  float* output = (float*)buffer;
+  size_t done = 0;
+
+  // output whatever pending input allows, then decode more until done (or no more input)
+  while (true)
+  {
+    done += m_resampler.Process(output + done * channels, frames - done);
+    if (done == frames)
+      break;
+    if (m_resampleInputEnd)
+    {
+      end = true;
+      break;
+    }
+
+    bool inputEnd = false;
+    int decoded =
+        DecodeStream((uint8_t*)m_resampleIn.data(), m_resampleIn.size() * sizeof(float), inputEnd);
+    m_resampler.Push(m_resampleIn.data(), decoded / (sizeof(float) * channels));
+    if (inputEnd)
+    {
+      m_resampler.Flush();
+      m_resampleInputEnd = true;
+    }
+  }
+
+  return done * channels * sizeof(float);
+}
+
+void CVGMCodec::StartDecodeThread()
+{
+  const int32_t chunkSamples = vgmstream_player_get_chunk_samples(m_player);
+  m_ringChunk = chunkSamples * m_outputChannels * sizeof(float);
+  size_t chunks = (size_t)ctx->stream->sample_rate *
+                  (m_lowPower ? VGM_DECODE_AHEAD_LOW_POWER_MS : VGM_DECODE_AHEAD_MS) / 1000 /
+                  chunkSamples;
+  if (chunks < 2)
+    chunks = 2;
+
+  // ring is a whole number of chunks so decoded chunks never wrap around
+  m_ring.resize(m_ringChunk * chunks);
+  m_ringWrite = 0;
+  m_ringRead = 0;
+  m_decodeEnd = false;
+  m_decodeStop = false;
+  m_decodeThread = std::thread(&CVGMCodec::DecodeThread, this);
+}
 
+void CVGMCodec::StopDecodeThread()
+{
+  if (!m_decodeThread.joinable())
+    return;
+
+  m_decodeStop = true;
+  m_ringCond.notify_all();
+  m_decodeThread.join();
+}
+
+void CVGMCodec::DecodeThread()
+{
+  // low power fills the ring whole once half of it was played, rather than a chunk at a time
+  bool refilling = true;
+  while (!m_decodeStop && !m_decodeEnd)
+  {
+    size_t write = m_ringWrite.load(std::memory_order_relaxed);
+    size_t read = m_ringRead.load(std::memory_order_acquire);
+    size_t free = m_ring.size() - (write - read);
+    if (free < m_ringChunk || (m_lowPower && !refilling && free < m_ring.size() / 2))
+    {
+      refilling = false;
+      // core log lines queued while rendering are written here, off the audio thread
+      vgmstream_log_drain();
+      std::unique_lock<std::mutex> lock(m_ringMutex);
+      m_ringCond.wait_for(lock, std::chrono::milliseconds(10));
+      continue;
+    }
+    refilling = true;
+
+    bool end = false;
+    int decoded = Decode(m_ring.data() + write % m_ring.size(), m_ringChunk, end);
+
+    m_ringWrite.store(write + decoded, std::memory_order_release);
+    if (end)
+      m_decodeEnd = true;
+    m_ringCond.notify_all();
+  }
+}
+
+int CVGMCodec::ReadRing(uint8_t* buffer, int size)
+{
+  if ((size_t)size > m_ring.size())
+    size = m_ring.size();
+
+  size_t read = m_ringRead.load(std::memory_order_relaxed);
+  size_t available = m_ringWrite.load(std::memory_order_acquire) - read;
+
+  // wait for the thread if it fell behind (underrun)
+  if (available < (size_t)size && !m_decodeEnd)
+    m_underruns++;
+  while (available < (size_t)size && !m_decodeEnd)
+  {
+    std::unique_lock<std::mutex> lock(m_ringMutex);
+    m_ringCond.wait_for(lock, std::chrono::milliseconds(10));
+    available = m_ringWrite.load(std::memory_order_acquire) - read;
+  }
+
+  size_t done = available < (size_t)size ? available : size;
+  size_t pos = read % m_ring.size();
+  size_t first = m_ring.size() - pos < done ? m_ring.size() - pos : done;
+  memcpy(buffer, m_ring.data() + pos, first);
+  memcpy(buffer + first, m_ring.data(), done - first);
+
+  m_ringRead.store(read + done, std::memory_order_release);
+  m_ringCond.notify_all();
+  return done;
+}
+
+int64_t CVGMCodec::Seek(int64_t time)
+{
+  auto start = std::chrono::steady_clock::now();
+  if (!m_started && !Start())
+    return -1;
+
+  StopDecodeThread();
+
+  int32_t sample = (int32_t)(time * ctx->stream->sample_rate / 1000);
+
+  // an entry written on an earlier play has the whole output, else it must be written in order
+  DiscardPcmCache();
+
+  if (m_pcmReading)
+  {
+    m_pcmPos = sample;
+  }
+  else if (m_loopCacheReady && sample >= ctx->stream->loop_start_sample)
+  {
+    // past loop start everything is in the loop cache, no need to move the stream
+    size_t loopFrames = m_loopCache.size() / m_outputChannels;
+    m_loopCachePos = (size_t)(sample - ctx->stream->loop_start_sample) % loopFrames;
+    m_loopCacheActive = true;
+  }
+  else
+  {
+    // from the nearest checkpoint, or jumps directly when it can, else decodes forward
+    vgmstream_player_seek(m_player, sample);
+
+    m_loopCacheActive = false;
+    if (!m_loopCacheReady)
+      m_loopCacheFilled = 0;
+  }
+
+  m_resampler.Reset();
+  m_resampleInputEnd = false;
+  m_endReached = false;
+  if (m_decodeAhead)
+    StartDecodeThread();
+
+  m_telemetry.AddSeek(ElapsedUs(start));
   return time;
 }
 
 bool CVGMCodec::ReadTag(const std::string& filename, kodi::addon::AudioDecoderInfoTag& tag)
 {
-  open_VFS((struct _STREAMFILE*)&ctx, filename.c_str(), 0);
+  // Library scans call this from several threads on one instance, so only per-call contexts
+  // and the thread safe shared caches are used here, never ctx
+  // Measured once when the library scans the file, so playback knows its volume
+  if (kodi::GetSettingBoolean("normalize"))
+    Analyze(filename);
 
-  ctx.stream = init_vgmstream_from_STREAMFILE((struct _STREAMFILE*)&ctx);
-  if (!ctx.stream)
+  // An already opened stream has all needed info
+  bool cached = m_cache.Peek(filename, [&tag](const VGMSTREAM* stream) {
+    tag.SetDuration(GetPlaySeconds(stream->num_samples, stream->sample_rate, stream->loop_flag,
+                                   stream->loop_start_sample, stream->loop_end_sample));
+    tag.SetSamplerate(stream->sample_rate);
+    tag.SetChannels(stream->channels);
+    if (stream->stream_name[0])
+      tag.SetTitle(stream->stream_name);
+  });
+  if (cached)
+    return true;
+
+  std::string file;
+  int subsong;
+  SplitSubsongPath(filename, file, subsong);
+
+  // Subsongs of an already listed bank don't need to be opened again
+  vgmstream_subsong_info info;
+  if (subsong > 0 && m_cache.GetSubsong(file, subsong, info))
   {
-    close_VFS((struct _STREAMFILE*)&ctx);
+    if (info.num_samples <= 0)
+      return false;
+    tag.SetDuration(GetPlaySeconds(info.num_samples, info.sample_rate, info.loop_flag,
+                                   info.loop_start_sample, info.loop_end_sample));
+    tag.SetSamplerate(info.sample_rate);
+    tag.SetChannels(info.channels);
+    if (info.stream_name[0])
+      tag.SetTitle(info.stream_name);
+    tag.SetTrack(subsong);
+    return true;
+  }
+
+  // Library rescans of unchanged files don't need to open them
+  CVGMDetectionCache::Info known;
+  m_detection.Load(DetectionCacheEnabled());
+  bool found = m_detection.Get(filename, file, known);
+  if (found && known.numSamples > 0 && known.sampleRate > 0)
+  {
+    tag.SetDuration(GetPlaySeconds(known.numSamples, known.sampleRate, known.loopFlag,
+                                   known.loopStart, known.loopEnd));
+    tag.SetSamplerate(known.sampleRate);
+    tag.SetChannels(known.channels);
+    if (!known.streamName.empty())
+      tag.SetTitle(known.streamName);
+    if (subsong > 0)
+      tag.SetTrack(subsong);
+    return true;
+  }
+
+  // Only headers are needed here, skip opening channels
+  VGMContext* probe = open_context_VFS(file.c_str(), VGM_VFS_BLOCK_SIZE, VGM_VFS_BLOCK_SIZE, false);
+  if (!probe)
+    return false;
+  probe->sf.probe_only = 1;
+  probe->sf.stream_index = subsong;
+
+  probe->stream = init_vgmstream_from_STREAMFILE_index((struct _STREAMFILE*)probe, known.initIndex);
+  if (!probe->stream)
+  {
+    free_VFS(probe);
     return false;
   }
+  m_detection.Put(filename, file, probe->stream);
 
-  tag.SetDuration(ctx.stream->num_samples / ctx.stream->sample_rate);
-  tag.SetSamplerate(ctx.stream->sample_rate);
-  tag.SetChannels(ctx.stream->channels);
+  tag.SetDuration(GetPlaySeconds(probe->stream->num_samples, probe->stream->sample_rate,
+                                 probe->stream->loop_flag, probe->stream->loop_start_sample,
+                                 probe->stream->loop_end_sample));
+  tag.SetSamplerate(probe->stream->sample_rate);
+  tag.SetChannels(probe->stream->channels);
+  if (probe->stream->stream_name[0])
+    tag.SetTitle(probe->stream->stream_name);
+  if (subsong > 0)
+    tag.SetTrack(subsong);
+
+  free_VFS(probe);
   return true;
 }
 
+int CVGMCodec::TrackCount(const std::string& filename)
+{
+  int count = m_cache.GetSubsongCount(filename);
+  if (count > 0)
+    return count;
+
+  CVGMDetectionCache::Info known;
+  m_detection.Load(DetectionCacheEnabled());
+  if (m_detection.Get(filename, filename, known) && known.numStreams > 0)
+    return known.numStreams;
+
+  VGMContext* probe = open_context_VFS(filename.c_str(), VGM_VFS_BLOCK_SIZE, VGM_VFS_BLOCK_SIZE, false);
+  if (!probe)
+    return 1;
+
+  // Lists every subsong once, so later tag reads of each track are cheap
+  vgmstream_subsong_info* infos =
+      vgmstream_get_subsongs_info((struct _STREAMFILE*)probe, &count);
+  free_VFS(probe);
+  if (!infos)
+    return 1;
+
+  m_detection.PutSubsongCount(filename, count);
+  m_cache.PutSubsongs(filename, std::vector<vgmstream_subsong_info>(infos, infos + count));
+  vgmstream_free(infos);
+  return count;
+}
+
+void CVGMCodec::Analyze(const std::string& filename)
+{
+  std::string file;
+  int subsong;
+  SplitSubsongPath(filename, file, subsong);
+
+  CVGMDetectionCache::Info known;
+  m_detection.Load(DetectionCacheEnabled());
+  bool found = m_detection.Get(filename, file, known);
+  if (found && known.analyzed)
+    return;
+
+  VGMContext* analysis =
+      open_context_VFS(file.c_str(), VGM_VFS_BLOCK_SIZE, VGM_VFS_BLOCK_SIZE * VGM_VFS_READAHEAD_BLOCKS, false);
+  if (!analysis)
+    return;
+  analysis->sf.stream_index = subsong;
+
+  // decodes without loops, mixing or float conversion
+  analysis->stream =
+      init_vgmstream_from_STREAMFILE_index((struct _STREAMFILE*)analysis, known.initIndex);
+  vgmstream_analysis_info info;
+  if (analysis->stream && vgmstream_analyze(analysis->stream, &info))
+  {
+    m_detection.Put(filename, file, analysis->stream);
+    m_detection.PutAnalysis(filename, file, info.peak, info.loudness);
+  }
+
+  free_VFS(analysis);
+}
+
+bool CVGMCodec::DetectionCacheEnabled()
+{
+  // also keeps the measured volume of files
+  return kodi::GetSettingBoolean("detectioncache") || kodi::GetSettingBoolean("normalize");
+}
+
+void CVGMCodec::GetPlayConfig(vgmstream_cfg_t& vcfg)
+{
+  vcfg = {};
+  vcfg.allow_play_forever = 1;
+  vcfg.play_forever = kodi::GetSettingBoolean("loopforever");
+  vcfg.loop_count = kodi::GetSettingInt("loopcount");
+  vcfg.fade_time = kodi::GetSettingInt("fadetime");
+  vcfg.fade_delay = kodi::GetSettingInt("fadedelay");
+}
+
+int CVGMCodec::GetPlaySeconds(
+    int32_t numSamples, int sampleRate, bool loopFlag, int32_t loopStart, int32_t loopEnd)
+{
+  // Same as what Init reports once loops and fades are applied, so the library
+  // shows the length that gets played (vgmstream's get_vgmstream_play_samples)
+  if (sampleRate <= 0)
+    return 0;
+  if (!loopFlag || loopEnd <= loopStart)
+    return numSamples / sampleRate;
+
+  int loopCount = std::max(kodi::GetSettingInt("loopcount"), 0);
+  int fadeTime = std::max(kodi::GetSettingInt("fadetime"), 0);
+  int fadeDelay = std::max(kodi::GetSettingInt("fadedelay"), 0);
+  double samples = loopStart + (double)(loopEnd - loopStart) * loopCount +
+                   (double)(fadeDelay + fadeTime) * sampleRate;
+  return (int)(samples / sampleRate);
+}
+
+void CVGMCodec::SplitSubsongPath(const std::string& path, std::string& file, int& subsong)
+{
+  // Kodi lists subsongs as virtual tracks: "(file)/(name)-(N).vgmstream"
+  static const std::string extension = ".vgmstream";
+
+  file = path;
+  subsong = 0;
+  if (path.size() <= extension.size() ||
+      path.compare(path.size() - extension.size(), extension.size(), extension) != 0)
+    return;
+
+  size_t start = path.rfind('-');
+  size_t slash = path.find_last_of("/\\");
+  if (start == std::string::npos || slash == std::string::npos)
+    return;
+
+  subsong = atoi(path.substr(start + 1, path.size() - start - 1 - extension.size()).c_str());
+  file = path.substr(0, slash);
+}
+
 //------------------------------------------------------------------------------
 
 class ATTRIBUTE_HIDDEN CMyAddon : public kodi::addon::CAddonBase
 {
 public:
-  CMyAddon() {}
+  CMyAddon()
+  {
+    // first, as everything after allocates through it; kept installed since the caches below
+    // may close streams after this is destroyed
+    vgmstream_allocator_setup(Alloc, Resize, Release, nullptr);
+    // debug builds queue core log lines, written by the decode thread (see DecodeThread)
+    vgmstream_log_setup(LogLine, nullptr);
+    vgmstream_pool_setup(VGM_DECODER_POOL_BLOCKS, Lock, Unlock, &m_poolMutex);
+    vgmstream_detection_budget_setup(VGM_DETECTION_BUDGET_BYTES, VGM_DETECTION_BUDGET_MS);
+    // page cache, buffers and checkpoints (applied on restart, as the caches are global)
+    vgmstream_memory_budget_setup((size_t)kodi::GetSettingInt("memorybudget") * 1024 * 1024, Lock,
+                                  Unlock, &m_memoryMutex);
+    vgmstream_dual_stereo_cache_setup(1, Lock, Unlock, &m_dualStereoMutex);
+    // companion files are probed for most files of a folder, usually missing
+    vgmstream_dir_cache_setup(1, ListDir, nullptr, Lock, Unlock, &m_dirCacheMutex);
+    vgmstream_hca_key_cache_setup(1, Lock, Unlock, &m_hcaKeyMutex);
+    vgmstream_adx_key_cache_setup(1, Lock, Unlock, &m_adxKeyMutex);
+    vgmstream_ubi_sb_index_setup(1, Lock, Unlock, &m_ubiSbMutex);
+    vgmstream_acb_name_cache_setup(1, Lock, Unlock, &m_acbNameMutex);
+    vgmstream_xsb_name_cache_setup(1, Lock, Unlock, &m_xsbNameMutex);
+    vgmstream_txth_cache_setup(1, Lock, Unlock, &m_txthMutex);
+    vgmstream_fsb5_index_setup(1, Lock, Unlock, &m_fsb5Mutex);
+    vgmstream_wwise_setup_cache_setup(1, Lock, Unlock, &m_wwiseSetupMutex);
+    vgmstream_bank_index_setup(1, Lock, Unlock, &m_bankIndexMutex);
+    // block offsets of files that seek by decoding forward, for later sessions (applied on restart)
+    vgmstream_seek_index_cache_setup(kodi::GetSettingBoolean("seekindex"), CVGMSeekIndexCache::Load,
+                                     CVGMSeekIndexCache::Save, &m_shared.seekIndexCache);
+    vgmstream_channel_workers_setup(VGM_PARALLEL_MIN_CHANNELS, VGM_PARALLEL_MIN_SAMPLES,
+                                    CVGMChannelWorkers::Run, &m_shared.channelWorkers);
+    // int versions of float decoders and a shorter resampler (applied on restart, as it's global)
+    vgmstream_low_power_setup(kodi::GetSettingBoolean("lowpower"));
+  }
   ADDON_STATUS CreateInstance(int instanceType,
                               const std::string& instanceID,
                               KODI_HANDLE instance,
                               const std::string& version,
                               KODI_HANDLE& addonInstance) override
   {
-    addonInstance = new CVGMCodec(instance, version);
+    addonInstance = new CVGMCodec(instance, version, m_shared);
     return ADDON_STATUS_OK;
   }
-  ~CMyAddon() override = default;
+  ~CMyAddon() override
+  {
+    vgmstream_channel_workers_setup(0, 0, nullptr, nullptr);
+    vgmstream_seek_index_cache_setup(0, nullptr, nullptr, nullptr);
+    vgmstream_bank_index_setup(0, nullptr, nullptr, nullptr);
+    vgmstream_wwise_setup_cache_setup(0, nullptr, nullptr, nullptr);
+    vgmstream_fsb5_index_setup(0, nullptr, nullptr, nullptr);
+    vgmstream_txth_cache_setup(0, nullptr, nullptr, nullptr);
+    vgmstream_xsb_name_cache_setup(0, nullptr, nullptr, nullptr);
+    vgmstream_acb_name_cache_setup(0, nullptr, nullptr, nullptr);
+    vgmstream_ubi_sb_index_setup(0, nullptr, nullptr, nullptr);
+    vgmstream_adx_key_cache_setup(0, nullptr, nullptr, nullptr);
+    vgmstream_hca_key_cache_setup(0, nullptr, nullptr, nullptr);
+    vgmstream_dir_cache_setup(0, nullptr, nullptr, nullptr, nullptr, nullptr);
+    vgmstream_dual_stereo_cache_setup(0, nullptr, nullptr, nullptr);
+    vgmstream_memory_budget_setup(0, nullptr, nullptr, nullptr);
+    vgmstream_pool_setup(0, nullptr, nullptr, nullptr);
+    vgmstream_log_drain();
+    vgmstream_log_setup(nullptr, nullptr);
+  }
+
+private:
+  static void Lock(void* data) { static_cast<std::mutex*>(data)->lock(); }
+  static void Unlock(void* data) { static_cast<std::mutex*>(data)->unlock(); }
+  static void LogLine(const char* line, void*) { kodi::Log(ADDON_LOG_DEBUG, "vgmstream: %s", line); }
+
+  static int ListDir(void*, const char* path, void (*addName)(void*, const char*), void* list)
+  {
+    std::vector<kodi::vfs::CDirEntry> items;
+    if (!kodi::vfs::GetDirectory(path, "", items))
+      return 0;
+    for (const auto& item : items)
+    {
+      if (!item.IsFolder())
+        addName(list, kodi::vfs::GetFileName(item.Path()).c_str());
+    }
+    return 1;
+  }
+
+  // C allocator with each block's size before it, so the addon knows how much the decoder uses
+  static constexpr size_t HEADER_SIZE = alignof(std::max_align_t);
+
+  static void* Alloc(size_t size, void*)
+  {
+    uint8_t* block = static_cast<uint8_t*>(std::malloc(HEADER_SIZE + size));
+    if (!block)
+      return nullptr;
+    *reinterpret_cast<size_t*>(block) = size;
+    g_vgmHeapSize += size;
+    return block + HEADER_SIZE;
+  }
+
+  static void* Resize(void* ptr, size_t size, void* data)
+  {
+    if (!ptr)
+      return Alloc(size, data);
+
+    uint8_t* block = static_cast<uint8_t*>(ptr) - HEADER_SIZE;
+    size_t oldSize = *reinterpret_cast<size_t*>(block);
+    block = static_cast<uint8_t*>(std::realloc(block, HEADER_SIZE + size));
+    if (!block)
+      return nullptr;
+    *reinterpret_cast<size_t*>(block) = size;
+    g_vgmHeapSize += size;
+    g_vgmHeapSize -= oldSize;
+    return block + HEADER_SIZE;
+  }
+
+  static void Release(void* ptr, void*)
+  {
+    uint8_t* block = static_cast<uint8_t*>(ptr) - HEADER_SIZE;
+    g_vgmHeapSize -= *reinterpret_cast<size_t*>(block);
+    std::free(block);
+  }
+
+  std::mutex m_poolMutex;
+  std::mutex m_memoryMutex;
+  std::mutex m_dualStereoMutex;
+  std::mutex m_dirCacheMutex;
+  std::mutex m_hcaKeyMutex;
+  std::mutex m_adxKeyMutex;
+  std::mutex m_ubiSbMutex;
+  std::mutex m_acbNameMutex;
+  std::mutex m_xsbNameMutex;
+  std::mutex m_txthMutex;
+  std::mutex m_fsb5Mutex;
+  std::mutex m_wwiseSetupMutex;
+  std::mutex m_bankIndexMutex;
+  VGMShared m_shared;
 };
 
 ADDONCREATOR(CMyAddon)
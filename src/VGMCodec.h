@@ -7,28 +7,122 @@
 
 #pragma once
 
+#include "VGMChannelWorkers.h"
+#include "VGMDetectionCache.h"
+#include "VGMPcmCache.h"
+#include "VGMResampler.h"
+#include "VGMSeekIndexCache.h"
+#include "VGMStreamCache.h"
+#include "VGMTelemetry.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <kodi/Filesystem.h>
 #include <kodi/addon-instance/AudioDecoder.h>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 extern "C"
 {
+#include "src/page_cache.h"
+#include "src/plugins.h"
 #include "src/vgmstream.h"
 
+  // Read-ahead cache defaults, block size can be changed on add-on settings
+#define VGM_VFS_BLOCK_SIZE 0x8000
+#define VGM_VFS_READAHEAD_BLOCKS 4
+#define VGM_VFS_READAHEAD_MAX 0x100000
+#define VGM_VFS_SHARED_MAX 0x400000
+#define VGM_VFS_PREFETCH_REQUESTS 8
+  // Remote files (HTTP, UPnP) read bigger windows through a few handles and keep more blocks
+#define VGM_VFS_REMOTE_READ 0x80000
+#define VGM_VFS_REMOTE_SHARED_MAX 0x1000000
+#define VGM_VFS_REMOTE_HANDLES 4
+
+  typedef std::shared_ptr<std::vector<uint8_t>> VGMBlock;
+
+  // Blocks of one file shared by all handles opened on it (channels, reopens),
+  // so handles reading at different offsets don't seek the file on every switch
+  struct ATTRIBUTE_HIDDEN VGMFileCache
+  {
+    struct Entry
+    {
+      off_t offset;
+      VGMBlock data;
+    };
+
+    std::string name;
+    kodi::vfs::CFile file;
+    std::mutex mutex;
+    std::list<Entry> blocks; // most recently used first
+    std::unordered_map<off_t, std::list<Entry>::iterator> index;
+    std::vector<uint8_t> readbuf; // VFS read-ahead, split into blocks
+    size_t blocksize = VGM_VFS_BLOCK_SIZE; // VFS read alignment
+    size_t buffersize = VGM_VFS_BLOCK_SIZE * VGM_VFS_READAHEAD_BLOCKS; // bytes per VFS read
+    size_t maxblocks = 0; // blocks kept before dropping the oldest
+    size_t wholefile = 0; // files up to this size are read at once (also for companions)
+    size_t filesize = 0; // cached file size
+    page_cache_file* pages = nullptr; // process-wide pages, shared with later opens
+    int refs = 1; // handles using this cache
+
+    // Remote files turn every seek into a new range request, so reads go to the handle whose
+    // request ended where they start (file or one of these), and interleaved channels far
+    // apart each continue their own request
+    bool remote = false;
+    std::vector<std::unique_ptr<kodi::vfs::CFile>> remoteFiles;
+    size_t remoteNext = 0; // handle to reuse when none continues
+
+    // background reads ahead of sequential handles (NAS and such)
+    bool prefetch = false;
+    std::thread prefetchThread;
+    std::condition_variable prefetchCond; // new requests or stop
+    std::condition_variable loadedCond; // prefetchOffset done
+    std::deque<off_t> prefetchRequests;
+    off_t prefetchOffset = -1; // window being read now
+    bool prefetchStop = false;
+  };
+
   struct ATTRIBUTE_HIDDEN VGMContext
   {
-    STREAMFILE sf;
-    kodi::vfs::CFile* file = nullptr;
-    char name[260];
+    STREAMFILE sf = {};
+    VGMFileCache* cache = nullptr; // also keeps the name
     VGMSTREAM* stream = nullptr;
     size_t pos;
+
+    VGMBlock block; // last used block, read without locking the cache
+    off_t block_offset = 0;
+    off_t offset = 0; // last read offset (info)
+    streamfile_stats_t stats = {}; // I/O counters, shared cache reads count for the handle that did them
   };
 
+  // Closes the stream and file of a context and frees it
+  void free_VFS(VGMContext* ctx);
+
 } /* extern "C" */
 
+// Add-on wide objects shared by all instances (playback, next track preload, tag reads), so work
+// like opening, detecting or decoding a file once serves all of them. Owned by CMyAddon, which
+// outlives the instances, and each is thread safe. vgmstream's own caches (pages, key caches, bank
+// indexes) are global and set up by CMyAddon too.
+struct ATTRIBUTE_HIDDEN VGMShared
+{
+  CVGMStreamCache streamCache;
+  CVGMDetectionCache detection;
+  CVGMPcmCache pcmCache;
+  CVGMSeekIndexCache seekIndexCache;
+  CVGMChannelWorkers channelWorkers;
+};
+
 class ATTRIBUTE_HIDDEN CVGMCodec : public kodi::addon::CInstanceAudioDecoder
 {
 public:
-  CVGMCodec(KODI_HANDLE instance, const std::string& version);
+  CVGMCodec(KODI_HANDLE instance, const std::string& version, VGMShared& shared);
   ~CVGMCodec() override;
 
   bool Init(const std::string& filename,
@@ -44,13 +138,111 @@ public:
   int ReadPCM(uint8_t* buffer, int size, int& actualsize) override;
   int64_t Seek(int64_t time) override;
   bool ReadTag(const std::string& filename, kodi::addon::AudioDecoderInfoTag& tag) override;
+  int TrackCount(const std::string& filename) override;
 
 private:
-  VGMContext ctx;
-  bool m_loopForEver = false;
+  static void SplitSubsongPath(const std::string& path, std::string& file, int& subsong);
+  static bool DetectionCacheEnabled();
+  static void GetPlayConfig(vgmstream_cfg_t& vcfg);
+  static int GetDownmixChannels();
+  static int GetPlaySeconds(
+      int32_t numSamples, int sampleRate, bool loopFlag, int32_t loopStart, int32_t loopEnd);
+
+  void Analyze(const std::string& filename);
+
+  // With quick start Init only parses the header, and the stream is opened on a
+  // thread and set up on the first read or seek
+  void OpenThread();
+  bool Start();
+  void LogStartup();
+
+  int Decode(uint8_t* buffer, int size, bool& end);
+  int DecodeOutput(uint8_t* buffer, int size, bool& end);
+  int DecodeStream(uint8_t* buffer, int size, bool& end);
+  int DecodeResampled(uint8_t* buffer, int size, bool& end);
+  bool ReadLoopCache(float* samples, int frames);
+  void FillLoopCache(const float* samples, int frames, int32_t start);
+
+  // Decoded audio on disk (see CVGMPcmCache), read back when complete, or
+  // written while the first play goes in order from the start
+  static bool IsSlowCodec(const VGMSTREAM* stream);
+  void OpenPcmCache();
+  int ReadPcmCache(float* samples, int frames, bool& end);
+  void WritePcmCache(const float* samples, int frames);
+  void DiscardPcmCache();
+
+  // Optional decode ahead thread, fills a single producer/single consumer
+  // ring that ReadPCM copies from
+  void StartDecodeThread();
+  void StopDecodeThread();
+  void DecodeThread();
+  int ReadRing(uint8_t* buffer, int size);
+
+  CVGMStreamCache& m_cache;
+  CVGMDetectionCache& m_detection;
+  CVGMPcmCache& m_pcmCache;
+  CVGMChannelWorkers& m_workers;
+  VGMContext* ctx = nullptr;
+  std::string m_filename;
+  vgmstream_player* m_player = nullptr; // renders, end of stream and seeks with checkpoints
+  VGMContext* m_header = nullptr; // header-only open while the stream opens (quick start)
+  std::thread m_openThread;
+  bool m_started = false; // Start done
+  int m_channels = 0; // stream's format, checked on the stream opened after Init
+  int m_outputChannels = 0; // format given to Kodi (after any downmix)
+  int m_downmixChannels = 0; // downmix target of streams with more channels than Kodi takes
+  int m_sampleRate = 0;
+  int m_outputRate = 0; // rate given to Kodi (after any resampling)
   bool m_endReached = false;
   bool m_loopForEverInUse = false;
 
+  float m_gain = 1.0f; // volume normalization
+
+  // Decoded loop section, played from memory after the first pass when looping forever
+  bool m_loopCacheEnabled = false;
+  bool m_loopCacheReady = false;
+  bool m_loopCacheActive = false; // playing from the cache, stream isn't decoded anymore
+  int32_t m_loopCacheFilled = 0; // frames decoded in order from loop start
+  size_t m_loopCachePos = 0; // next frame when active
+  std::vector<float> m_loopCache;
+
+  std::string m_pcmKey;
+  std::string m_pcmTemp; // entry being written
+  kodi::vfs::CFile m_pcmFile;
+  bool m_pcmReading = false;
+  bool m_pcmWriting = false;
+  int64_t m_pcmFrames = 0; // frames of a complete entry (the play, or up to loop end if forever)
+  int64_t m_pcmPos = 0; // frames played (reading) or written
+
+  // Optional conversion to a fixed output rate, fed by chunks of decoded input
+  CVGMResampler m_resampler;
+  std::vector<float> m_resampleIn;
+  bool m_resampleInputEnd = false;
+
+  bool m_lowPower = false; // see vgmstream_low_power_setup
+  bool m_decodeAhead = false;
+  std::thread m_decodeThread;
+  std::atomic<bool> m_decodeStop{false};
+  std::atomic<bool> m_decodeEnd{false};
+  std::vector<uint8_t> m_ring;
+  size_t m_ringChunk = 0;
+  std::atomic<size_t> m_ringWrite{0};
+  std::atomic<size_t> m_ringRead{0};
+  std::mutex m_ringMutex; // only to sleep/wake, data access is lock-free
+  std::condition_variable m_ringCond;
+  int m_underruns = 0; // reads that had to wait for the thread, logged with the profile
+
+  // Time from Init to the first samples (profile setting), logged once they are read
+  std::chrono::steady_clock::time_point m_initTime;
+  int64_t m_openUs = -1; // file open, -1 if the stream was reused
+  int64_t m_detectUs = -1; // detection and format setup
+  int64_t m_startUs = -1; // Init to stream ready (includes the above)
+  bool m_detectCached = false; // format known from the detection cache
+  uint64_t m_detectBytes = 0; // read from the file to detect it
+  bool m_startupPending = false;
+
+  CVGMTelemetry m_telemetry;
+
   // Static because Kodi opens the next file before the end of this and
   // otherwise notification comes twice at the same playback.
   static bool m_loopForEverActive;
@@ -0,0 +1,317 @@
+/*
+ *  Copyright (C) 2005-2020 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "VGMDetectionCache.h"
+
+#include <kodi/Filesystem.h>
+
+#include <algorithm>
+#include <vector>
+
+// Files remembered, least recently used ones are dropped after this
+#define VGM_DETECTION_CACHE_SIZE 20000
+// Changes written to disk in batches, and also on exit
+#define VGM_DETECTION_SAVE_CHANGES 64
+// Bump when the file format changes, detection changes are handled by vgmstream's version
+#define VGM_DETECTION_FILE_VERSION 3
+
+static const char* const header = "vgmstream-detection";
+
+CVGMDetectionCache::~CVGMDetectionCache()
+{
+  Snapshot snapshot;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_changes > 0)
+      snapshot = Serialize();
+  }
+  Save(snapshot);
+}
+
+void CVGMDetectionCache::Load(bool enabled)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_enabled = enabled;
+  if (!m_enabled || m_loaded)
+    return;
+  m_loaded = true;
+  m_path = kodi::GetBaseUserPath("detection.cache");
+
+  kodi::vfs::CFile file;
+  if (!file.OpenFile(m_path))
+    return;
+
+  // a cache from other version may have wrong indexes, start again
+  std::string line;
+  char expected[64];
+  snprintf(expected, sizeof(expected), "%s %i %08x", header, VGM_DETECTION_FILE_VERSION,
+           vgmstream_get_detection_version());
+  if (!file.ReadLine(line) || line != expected)
+    return;
+
+  // path, size, mtime, used, init index, subsongs, channels, sample rate, samples,
+  // loop flag, loop start, loop end, analyzed, peak, loudness, name
+  while (file.ReadLine(line))
+  {
+    std::vector<std::string> fields;
+    size_t start = 0;
+    while (fields.size() < 15)
+    {
+      size_t end = line.find('\t', start);
+      if (end == std::string::npos)
+        break;
+      fields.push_back(line.substr(start, end - start));
+      start = end + 1;
+    }
+    if (fields.size() != 15)
+      continue;
+
+    Entry entry;
+    entry.size = strtoull(fields[1].c_str(), nullptr, 10);
+    entry.mtime = strtoll(fields[2].c_str(), nullptr, 10);
+    entry.used = strtoull(fields[3].c_str(), nullptr, 10);
+    entry.info.initIndex = atoi(fields[4].c_str());
+    entry.info.numStreams = atoi(fields[5].c_str());
+    entry.info.channels = atoi(fields[6].c_str());
+    entry.info.sampleRate = atoi(fields[7].c_str());
+    entry.info.numSamples = atoi(fields[8].c_str());
+    entry.info.loopFlag = atoi(fields[9].c_str()) != 0;
+    entry.info.loopStart = atoi(fields[10].c_str());
+    entry.info.loopEnd = atoi(fields[11].c_str());
+    entry.info.analyzed = atoi(fields[12].c_str()) != 0;
+    entry.info.peak = strtod(fields[13].c_str(), nullptr);
+    entry.info.loudness = strtod(fields[14].c_str(), nullptr);
+    entry.info.streamName = line.substr(start);
+
+    m_counter = std::max(m_counter, entry.used);
+    m_entries[fields[0]] = std::move(entry);
+  }
+}
+
+bool CVGMDetectionCache::StatEntry(const std::string& file, uint64_t& size, int64_t& mtime)
+{
+  kodi::vfs::FileStatus status;
+  if (!kodi::vfs::StatFile(file, status))
+    return false;
+  size = status.GetSize();
+  mtime = status.GetModificationTime();
+  return true;
+}
+
+bool CVGMDetectionCache::Get(const std::string& path, const std::string& file, Info& info)
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_enabled || m_entries.find(path) == m_entries.end())
+      return false;
+  }
+
+  // stat outside the lock, may be slow on network shares
+  uint64_t size;
+  int64_t mtime;
+  if (!StatEntry(file, size, mtime))
+    return false;
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto it = m_entries.find(path);
+  if (it == m_entries.end())
+    return false;
+  if (it->second.size != size || it->second.mtime != mtime)
+  {
+    m_entries.erase(it);
+    m_changes++;
+    return false;
+  }
+
+  it->second.used = ++m_counter;
+  info = it->second.info;
+  return true;
+}
+
+void CVGMDetectionCache::Put(const std::string& path, const std::string& file, const VGMSTREAM* stream)
+{
+  if (!m_enabled)
+    return;
+
+  uint64_t size;
+  int64_t mtime;
+  if (!StatEntry(file, size, mtime))
+    return;
+
+  Snapshot snapshot;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Info info = Current(path, size, mtime);
+    info.initIndex = stream->init_index;
+    info.numStreams = stream->num_streams;
+    info.channels = stream->channels;
+    info.sampleRate = stream->sample_rate;
+    info.numSamples = stream->num_samples;
+    info.loopFlag = stream->loop_flag != 0;
+    info.loopStart = stream->loop_start_sample;
+    info.loopEnd = stream->loop_end_sample;
+    info.streamName = stream->stream_name;
+    Update(path, size, mtime, info, snapshot);
+  }
+  Save(snapshot);
+}
+
+void CVGMDetectionCache::PutSubsongCount(const std::string& file, int count)
+{
+  if (!m_enabled)
+    return;
+
+  uint64_t size;
+  int64_t mtime;
+  if (!StatEntry(file, size, mtime))
+    return;
+
+  Snapshot snapshot;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Info info = Current(file, size, mtime);
+    info.numStreams = count;
+    Update(file, size, mtime, info, snapshot);
+  }
+  Save(snapshot);
+}
+
+void CVGMDetectionCache::PutAnalysis(const std::string& path,
+                                     const std::string& file,
+                                     double peak,
+                                     double loudness)
+{
+  if (!m_enabled)
+    return;
+
+  uint64_t size;
+  int64_t mtime;
+  if (!StatEntry(file, size, mtime))
+    return;
+
+  Snapshot snapshot;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Info info = Current(path, size, mtime);
+    info.analyzed = true;
+    info.peak = peak;
+    info.loudness = loudness;
+    Update(path, size, mtime, info, snapshot);
+  }
+  Save(snapshot);
+}
+
+CVGMDetectionCache::Info CVGMDetectionCache::Current(const std::string& path,
+                                                     uint64_t size,
+                                                     int64_t mtime)
+{
+  // keeps what other puts recorded, unless the file changed
+  auto it = m_entries.find(path);
+  if (it != m_entries.end() && it->second.size == size && it->second.mtime == mtime)
+    return it->second.info;
+  return Info();
+}
+
+void CVGMDetectionCache::Update(
+    const std::string& path, uint64_t size, int64_t mtime, const Info& info, Snapshot& snapshot)
+{
+  // one entry per line
+  if (path.find_first_of("\t\r\n") != std::string::npos)
+    return;
+
+  Entry& entry = m_entries[path];
+  entry.size = size;
+  entry.mtime = mtime;
+  entry.used = ++m_counter;
+  entry.info = info;
+  std::replace_if(entry.info.streamName.begin(), entry.info.streamName.end(),
+                  [](char c) { return c == '\t' || c == '\r' || c == '\n'; }, ' ');
+
+  // drop least recently used in batches, rather than one on every new file
+  if (m_entries.size() > VGM_DETECTION_CACHE_SIZE + VGM_DETECTION_CACHE_SIZE / 8)
+  {
+    std::vector<uint64_t> used;
+    used.reserve(m_entries.size());
+    for (const auto& it : m_entries)
+      used.push_back(it.second.used);
+    size_t drop = m_entries.size() - VGM_DETECTION_CACHE_SIZE;
+    std::nth_element(used.begin(), used.begin() + drop, used.end());
+    uint64_t oldest = used[drop];
+    for (auto it = m_entries.begin(); it != m_entries.end();)
+    {
+      if (it->second.used < oldest)
+        it = m_entries.erase(it);
+      else
+        ++it;
+    }
+  }
+
+  if (++m_changes >= VGM_DETECTION_SAVE_CHANGES)
+    snapshot = Serialize();
+}
+
+CVGMDetectionCache::Snapshot CVGMDetectionCache::Serialize()
+{
+  Snapshot snapshot;
+  m_changes = 0;
+  if (m_path.empty())
+    return snapshot;
+
+  snapshot.path = m_path;
+  snapshot.serial = ++m_serial;
+
+  char line[256];
+  int len = snprintf(line, sizeof(line), "%s %i %08x\n", header, VGM_DETECTION_FILE_VERSION,
+                     vgmstream_get_detection_version());
+  std::string& data = snapshot.data;
+  data.assign(line, len);
+  for (const auto& it : m_entries)
+  {
+    const Entry& entry = it.second;
+    len = snprintf(line, sizeof(line),
+                   "\t%llu\t%lld\t%llu\t%i\t%i\t%i\t%i\t%i\t%i\t%i\t%i\t%i\t%.6f\t%.3f\t",
+                   (unsigned long long)entry.size, (long long)entry.mtime,
+                   (unsigned long long)entry.used, entry.info.initIndex, entry.info.numStreams,
+                   entry.info.channels, entry.info.sampleRate, entry.info.numSamples,
+                   entry.info.loopFlag ? 1 : 0, entry.info.loopStart, entry.info.loopEnd,
+                   entry.info.analyzed ? 1 : 0, entry.info.peak, entry.info.loudness);
+    data += it.first;
+    data.append(line, len);
+    data += entry.info.streamName;
+    data += '\n';
+  }
+  return snapshot;
+}
+
+void CVGMDetectionCache::Save(const Snapshot& snapshot)
+{
+  if (snapshot.serial == 0)
+    return;
+
+  // written outside m_mutex so tag reads on other threads don't wait for the disk, in
+  // order, a slower writer of an older snapshot doesn't replace a newer one
+  std::lock_guard<std::mutex> lock(m_saveMutex);
+  if (snapshot.serial <= m_savedSerial)
+    return;
+  m_savedSerial = snapshot.serial;
+
+  std::string folder = kodi::GetBaseUserPath();
+  if (!kodi::vfs::DirectoryExists(folder))
+    kodi::vfs::CreateDirectory(folder);
+
+  // write whole and replace, so an interrupted save doesn't leave a broken cache
+  std::string temp = snapshot.path + ".tmp";
+  kodi::vfs::CFile file;
+  if (!file.OpenFileForWrite(temp, true))
+    return;
+
+  const std::string& data = snapshot.data;
+  bool written = file.Write(data.data(), data.size()) == (ssize_t)data.size();
+  file.Close();
+  if (!written || !kodi::vfs::RenameFile(temp, snapshot.path))
+    kodi::vfs::DeleteFile(temp);
+}
@@ -0,0 +1,98 @@
+/*
+ *  Copyright (C) 2005-2020 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+#include <kodi/AddonBase.h>
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+extern "C"
+{
+#include "src/vgmstream.h"
+} /* extern "C" */
+
+// Optional on-disk record of what opened each file on previous runs (detection
+// function, subsongs and basic info), so library rescans after a restart can
+// skip format detection or not open files at all for tags. Files are matched
+// by path, size and modification time.
+class ATTRIBUTE_HIDDEN CVGMDetectionCache
+{
+public:
+  struct Info
+  {
+    int initIndex = 0; // vgmstream->init_index, 0 if unknown
+    int numStreams = 0; // subsongs in the file, 0 if unknown
+    int channels = 0;
+    int sampleRate = 0;
+    int32_t numSamples = 0; // 0 if only the subsong count is known
+    bool loopFlag = false;
+    int32_t loopStart = 0;
+    int32_t loopEnd = 0;
+    std::string streamName;
+    bool analyzed = false; // peak and loudness measured (volume normalization)
+    double peak = 0.0;
+    double loudness = 0.0; // LUFS
+  };
+
+  CVGMDetectionCache() = default;
+  ~CVGMDetectionCache();
+
+  // Loads the cache file, does nothing if already loaded or disabled
+  void Load(bool enabled);
+
+  // Info of a file (path may be a subsong track), false if unknown or changed
+  bool Get(const std::string& path, const std::string& file, Info& info);
+
+  // Records the stream opened from a file
+  void Put(const std::string& path, const std::string& file, const VGMSTREAM* stream);
+
+  // Records only the subsong count of a file
+  void PutSubsongCount(const std::string& file, int count);
+
+  // Records the measured peak and loudness of a file (path may be a subsong track)
+  void PutAnalysis(const std::string& path, const std::string& file, double peak, double loudness);
+
+private:
+  struct Entry
+  {
+    uint64_t size;
+    int64_t mtime;
+    uint64_t used; // last use, for eviction
+    Info info;
+  };
+
+  // Cache contents to write, taken under m_mutex and saved after releasing it
+  struct Snapshot
+  {
+    uint64_t serial = 0; // 0 if nothing to save
+    std::string path;
+    std::string data;
+  };
+
+  bool StatEntry(const std::string& file, uint64_t& size, int64_t& mtime);
+  Info Current(const std::string& path, uint64_t size, int64_t mtime);
+  void Update(
+      const std::string& path, uint64_t size, int64_t mtime, const Info& info, Snapshot& snapshot);
+  Snapshot Serialize();
+  void Save(const Snapshot& snapshot);
+
+  std::mutex m_mutex;
+  std::mutex m_saveMutex; // one writer at a time, never taken with m_mutex held
+  uint64_t m_serial = 0; // last snapshot taken (under m_mutex)
+  uint64_t m_savedSerial = 0; // last snapshot written (under m_saveMutex)
+  std::string m_path;
+  std::atomic<bool> m_enabled{false};
+  bool m_loaded = false;
+  unsigned int m_changes = 0; // since last save
+  uint64_t m_counter = 0;
+  std::unordered_map<std::string, Entry> m_entries;
+};
@@ -0,0 +1,268 @@
+/*
+ *  Copyright (C) 2005-2020 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "VGMPcmCache.h"
+
+#include <kodi/Filesystem.h>
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+extern "C"
+{
+#include "src/vgmstream.h"
+} /* extern "C" */
+
+// Changes to the index written to disk in batches, and also on exit
+#define VGM_PCM_SAVE_CHANGES 16
+// Bump when the file format changes, decoder changes are handled by vgmstream's version
+#define VGM_PCM_FILE_VERSION 1
+
+static const char* const header = "vgmstream-pcm";
+
+CVGMPcmCache::~CVGMPcmCache()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (m_changes > 0)
+    Save();
+}
+
+void CVGMPcmCache::Configure(uint64_t maxBytes)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_maxBytes = maxBytes;
+  if (!m_maxBytes || m_loaded)
+    return;
+  m_loaded = true;
+  m_folder = kodi::GetBaseUserPath("pcm/");
+  Load();
+  Evict(); // limit may be lower than last run
+}
+
+bool CVGMPcmCache::IsEnabled()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_maxBytes > 0;
+}
+
+void CVGMPcmCache::Load()
+{
+  // writes interrupted on previous runs
+  std::vector<kodi::vfs::CDirEntry> items;
+  if (kodi::vfs::GetDirectory(m_folder, ".tmp", items))
+  {
+    for (const auto& item : items)
+    {
+      if (!item.IsFolder())
+        kodi::vfs::DeleteFile(item.Path());
+    }
+  }
+
+  kodi::vfs::CFile file;
+  if (!file.OpenFile(m_folder + "index"))
+    return;
+
+  std::string line;
+  char expected[64];
+  snprintf(expected, sizeof(expected), "%s %i %08x", header, VGM_PCM_FILE_VERSION,
+           vgmstream_get_detection_version());
+  bool current = file.ReadLine(line) && line == expected;
+
+  // name, bytes, used, key (key last as it has tabs)
+  while (file.ReadLine(line))
+  {
+    size_t tab1 = line.find('\t');
+    size_t tab2 = tab1 == std::string::npos ? tab1 : line.find('\t', tab1 + 1);
+    size_t tab3 = tab2 == std::string::npos ? tab2 : line.find('\t', tab2 + 1);
+    if (tab3 == std::string::npos)
+      continue;
+
+    // audio from other versions may differ, drop it
+    std::string name = line.substr(0, tab1);
+    if (!current)
+    {
+      kodi::vfs::DeleteFile(m_folder + name);
+      continue;
+    }
+
+    Entry entry;
+    entry.name = name;
+    entry.bytes = strtoull(line.c_str() + tab1 + 1, nullptr, 10);
+    entry.used = strtoull(line.c_str() + tab2 + 1, nullptr, 10);
+    m_counter = std::max(m_counter, entry.used);
+    m_totalBytes += entry.bytes;
+    m_entries[line.substr(tab3 + 1)] = std::move(entry);
+  }
+
+  if (!current)
+    m_changes++;
+}
+
+std::string CVGMPcmCache::GetKey(const std::string& path,
+                                 const std::string& file,
+                                 const std::string& config)
+{
+  // one entry per line
+  if (path.find_first_of("\r\n") != std::string::npos)
+    return "";
+
+  kodi::vfs::FileStatus status;
+  if (!kodi::vfs::StatFile(file, status))
+    return "";
+
+  char values[64];
+  snprintf(values, sizeof(values), "\t%llu\t%lld\t", (unsigned long long)status.GetSize(),
+           (long long)status.GetModificationTime());
+  return path + values + config;
+}
+
+std::string CVGMPcmCache::Find(const std::string& key)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto it = m_entries.find(key);
+  if (!m_maxBytes || it == m_entries.end())
+    return "";
+
+  it->second.used = ++m_counter;
+  m_changes++;
+  return m_folder + it->second.name;
+}
+
+std::string CVGMPcmCache::BeginWrite(const std::string& key)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (!m_maxBytes)
+    return "";
+
+  if (!kodi::vfs::DirectoryExists(m_folder))
+    kodi::vfs::CreateDirectory(m_folder);
+
+  // unique per write, as the same file may be played by two instances
+  char name[64];
+  snprintf(name, sizeof(name), "%016llx-%u.tmp", (unsigned long long)std::hash<std::string>()(key),
+           ++m_temps);
+  return m_folder + name;
+}
+
+void CVGMPcmCache::Commit(const std::string& key, const std::string& temp, uint64_t bytes)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (!m_maxBytes || bytes > m_maxBytes)
+  {
+    kodi::vfs::DeleteFile(temp);
+    return;
+  }
+
+  // name from the key hash, moved along on the rare collision with another key
+  uint64_t hash = std::hash<std::string>()(key);
+  std::string name;
+  auto it = m_entries.find(key);
+  if (it != m_entries.end())
+  {
+    name = it->second.name;
+    m_totalBytes -= it->second.bytes;
+    m_entries.erase(it);
+  }
+  else
+  {
+    bool used = true;
+    for (; used; hash++)
+    {
+      char buf[32];
+      snprintf(buf, sizeof(buf), "%016llx.pcm", (unsigned long long)hash);
+      name = buf;
+      used = false;
+      for (const auto& entry : m_entries)
+      {
+        if (entry.second.name == name)
+        {
+          used = true;
+          break;
+        }
+      }
+    }
+  }
+
+  kodi::vfs::DeleteFile(m_folder + name);
+  if (!kodi::vfs::RenameFile(temp, m_folder + name))
+  {
+    kodi::vfs::DeleteFile(temp);
+    return;
+  }
+
+  Entry& entry = m_entries[key];
+  entry.name = name;
+  entry.bytes = bytes;
+  entry.used = ++m_counter;
+  m_totalBytes += bytes;
+  Evict();
+
+  if (++m_changes >= VGM_PCM_SAVE_CHANGES)
+    Save();
+}
+
+void CVGMPcmCache::Discard(const std::string& temp)
+{
+  kodi::vfs::DeleteFile(temp);
+}
+
+void CVGMPcmCache::Evict()
+{
+  // least recently played first, entries are big so there are few of them
+  while (m_totalBytes > m_maxBytes && !m_entries.empty())
+  {
+    auto oldest = m_entries.begin();
+    for (auto it = m_entries.begin(); it != m_entries.end(); ++it)
+    {
+      if (it->second.used < oldest->second.used)
+        oldest = it;
+    }
+
+    kodi::vfs::DeleteFile(m_folder + oldest->second.name);
+    m_totalBytes -= oldest->second.bytes;
+    m_entries.erase(oldest);
+    m_changes++;
+  }
+}
+
+void CVGMPcmCache::Save()
+{
+  m_changes = 0;
+  if (m_folder.empty())
+    return;
+
+  if (!kodi::vfs::DirectoryExists(m_folder))
+    kodi::vfs::CreateDirectory(m_folder);
+
+  // write whole and replace, so an interrupted save doesn't leave a broken index
+  std::string path = m_folder + "index";
+  std::string temp = path + ".tmp";
+  kodi::vfs::CFile file;
+  if (!file.OpenFileForWrite(temp, true))
+    return;
+
+  char line[128];
+  int len = snprintf(line, sizeof(line), "%s %i %08x\n", header, VGM_PCM_FILE_VERSION,
+                     vgmstream_get_detection_version());
+  std::string data(line, len);
+  for (const auto& it : m_entries)
+  {
+    const Entry& entry = it.second;
+    len = snprintf(line, sizeof(line), "\t%llu\t%llu\t", (unsigned long long)entry.bytes,
+                   (unsigned long long)entry.used);
+    data += entry.name;
+    data.append(line, len);
+    data += it.first;
+    data += '\n';
+  }
+
+  bool written = file.Write(data.data(), data.size()) == (ssize_t)data.size();
+  file.Close();
+  if (!written || !kodi::vfs::RenameFile(temp, path))
+    kodi::vfs::DeleteFile(temp);
+}
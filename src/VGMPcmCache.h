@@ -0,0 +1,65 @@
+/*
+ *  Copyright (C) 2005-2020 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+#include <kodi/AddonBase.h>
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Optional on-disk cache of decoded audio, for codecs some devices can't decode
+// in time, so playing a file again only reads it. Each entry is the player's
+// output for a file, subsong and play settings as raw float PCM, and the
+// folder is kept under a size limit by dropping the least recently played.
+class ATTRIBUTE_HIDDEN CVGMPcmCache
+{
+public:
+  CVGMPcmCache() = default;
+  ~CVGMPcmCache();
+
+  // Loads the index once and sets the size limit (0 disables the cache)
+  void Configure(uint64_t maxBytes);
+  bool IsEnabled();
+
+  // Key of a file's decoded audio with the given play settings, empty if the
+  // file can't be found (path may be a subsong track)
+  std::string GetKey(const std::string& path, const std::string& file, const std::string& config);
+
+  // Path of a complete entry, empty if there is none
+  std::string Find(const std::string& key);
+
+  // Temporary path to write a new entry to, then kept with Commit or dropped
+  // with Discard (an unfinished play)
+  std::string BeginWrite(const std::string& key);
+  void Commit(const std::string& key, const std::string& temp, uint64_t bytes);
+  void Discard(const std::string& temp);
+
+private:
+  struct Entry
+  {
+    std::string name; // file in the cache folder
+    uint64_t bytes;
+    uint64_t used; // last use, for eviction
+  };
+
+  void Load();
+  void Evict();
+  void Save();
+
+  std::mutex m_mutex;
+  std::string m_folder;
+  uint64_t m_maxBytes = 0;
+  uint64_t m_totalBytes = 0;
+  bool m_loaded = false;
+  unsigned int m_changes = 0; // since last save
+  uint64_t m_counter = 0;
+  unsigned int m_temps = 0;
+  std::unordered_map<std::string, Entry> m_entries; // by key
+};
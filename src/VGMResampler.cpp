@@ -0,0 +1,178 @@
+/*
+ *  Copyright (C) 2005-2020 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "VGMResampler.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Input frames each output frame is made of, enough for ~90 dB of stopband
+#define VGM_RESAMPLER_TAPS 32
+// Fewer for low power devices, ~4x cheaper but with a softer transition and ~40 dB of stopband
+#define VGM_RESAMPLER_TAPS_LOW_POWER 8
+// Filter phases between two input frames (coefs are interpolated between them)
+#define VGM_RESAMPLER_PHASE_BITS 8
+#define VGM_RESAMPLER_PHASES (1 << VGM_RESAMPLER_PHASE_BITS)
+// Passband, as part of the lowest Nyquist frequency (some margin for the transition)
+#define VGM_RESAMPLER_CUTOFF 0.95
+#define VGM_RESAMPLER_KAISER_BETA 9.0
+// Consumed input kept before moving the rest back
+#define VGM_RESAMPLER_COMPACT_FRAMES 4096
+
+#define VGM_RESAMPLER_PI 3.14159265358979323846
+
+namespace
+{
+
+// Modified Bessel function of the first kind, order 0 (for the Kaiser window)
+double BesselI0(double x)
+{
+  double sum = 1.0;
+  double term = 1.0;
+  for (int k = 1; k < 32; k++)
+  {
+    term *= (x / (2.0 * k)) * (x / (2.0 * k));
+    sum += term;
+    if (term < sum * 1e-12)
+      break;
+  }
+  return sum;
+}
+
+} // namespace
+
+bool CVGMResampler::Init(int channels, int inputRate, int outputRate, bool lowPower)
+{
+  m_active = false;
+  if (channels <= 0 || inputRate <= 0 || outputRate <= 0 || inputRate == outputRate)
+    return false;
+
+  m_channels = channels;
+  m_taps = lowPower ? VGM_RESAMPLER_TAPS_LOW_POWER : VGM_RESAMPLER_TAPS;
+  m_step = ((uint64_t)inputRate << 32) / outputRate;
+
+  // when downsampling the filter also removes what the new rate can't hold
+  const int taps = m_taps;
+  const double cutoff = VGM_RESAMPLER_CUTOFF * std::min(1.0, (double)outputRate / inputRate);
+  const double window = BesselI0(VGM_RESAMPLER_KAISER_BETA);
+
+  // phase p is the output frame at p/phases after the center input frame, plus one
+  // extra phase (next input frame) to interpolate the last one
+  m_filters.resize((VGM_RESAMPLER_PHASES + 1) * taps);
+  for (int p = 0; p <= VGM_RESAMPLER_PHASES; p++)
+  {
+    float* filter = &m_filters[p * taps];
+    double sum = 0.0;
+    for (int k = 0; k < taps; k++)
+    {
+      double x = (double)p / VGM_RESAMPLER_PHASES + taps / 2 - 1 - k;
+      double r = x / (taps / 2);
+      double sinc = x == 0.0 ? 1.0 : std::sin(VGM_RESAMPLER_PI * cutoff * x) / (VGM_RESAMPLER_PI * cutoff * x);
+      double kaiser =
+          r * r >= 1.0 ? 0.0 : BesselI0(VGM_RESAMPLER_KAISER_BETA * std::sqrt(1.0 - r * r)) / window;
+      filter[k] = cutoff * sinc * kaiser;
+      sum += filter[k];
+    }
+    // unity gain at DC for every phase
+    for (int k = 0; k < taps; k++)
+      filter[k] /= sum;
+  }
+
+  m_coefs.resize(taps);
+  m_planes.assign(channels, std::vector<float>());
+  m_active = true;
+  Reset();
+  return true;
+}
+
+void CVGMResampler::Reset()
+{
+  // silence before the first frame, so output starts with it rather than after the filter's delay
+  const size_t history = m_taps / 2 - 1;
+  for (auto& plane : m_planes)
+    plane.assign(history, 0.0f);
+  m_pos = (uint64_t)history << 32;
+}
+
+void CVGMResampler::Push(const float* input, size_t frames)
+{
+  for (int ch = 0; ch < m_channels; ch++)
+  {
+    std::vector<float>& plane = m_planes[ch];
+    size_t start = plane.size();
+    plane.resize(start + frames);
+    for (size_t i = 0; i < frames; i++)
+      plane[start + i] = input[i * m_channels + ch];
+  }
+}
+
+void CVGMResampler::Flush()
+{
+  for (auto& plane : m_planes)
+    plane.resize(plane.size() + m_taps / 2, 0.0f);
+}
+
+size_t CVGMResampler::Process(float* output, size_t frames)
+{
+  const int taps = m_taps;
+  const size_t half = taps / 2;
+  const size_t available = m_planes.empty() ? 0 : m_planes[0].size();
+  const uint32_t phaseMask = (1u << (32 - VGM_RESAMPLER_PHASE_BITS)) - 1;
+  const float phaseScale = 1.0f / (phaseMask + 1.0f);
+  size_t done = 0;
+
+  while (done < frames)
+  {
+    size_t center = m_pos >> 32;
+    if (center + half >= available)
+      break;
+
+    // coefs for this position, shared by all channels
+    uint32_t frac = (uint32_t)m_pos;
+    const float* filter0 = &m_filters[(frac >> (32 - VGM_RESAMPLER_PHASE_BITS)) * taps];
+    const float* filter1 = filter0 + taps;
+    float t = (frac & phaseMask) * phaseScale;
+    for (int k = 0; k < taps; k++)
+      m_coefs[k] = filter0[k] + (filter1[k] - filter0[k]) * t;
+
+    // several sums so the compiler can vectorize without reordering a single one
+    const size_t first = center + 1 - half;
+    for (int ch = 0; ch < m_channels; ch++)
+    {
+      const float* input = m_planes[ch].data() + first;
+      float sum0 = 0.0f, sum1 = 0.0f, sum2 = 0.0f, sum3 = 0.0f;
+      for (int k = 0; k < taps; k += 4)
+      {
+        sum0 += input[k + 0] * m_coefs[k + 0];
+        sum1 += input[k + 1] * m_coefs[k + 1];
+        sum2 += input[k + 2] * m_coefs[k + 2];
+        sum3 += input[k + 3] * m_coefs[k + 3];
+      }
+      output[done * m_channels + ch] = (sum0 + sum1) + (sum2 + sum3);
+    }
+
+    m_pos += m_step;
+    done++;
+  }
+
+  Compact();
+  return done;
+}
+
+void CVGMResampler::Compact()
+{
+  // drop input before the next output's first frame
+  size_t center = m_pos >> 32;
+  size_t first = center + 1 - m_taps / 2;
+  if (first < VGM_RESAMPLER_COMPACT_FRAMES)
+    return;
+
+  first = std::min(first, m_planes[0].size());
+  for (auto& plane : m_planes)
+    plane.erase(plane.begin(), plane.begin() + first);
+  m_pos -= (uint64_t)first << 32;
+}
@@ -0,0 +1,52 @@
+/*
+ *  Copyright (C) 2005-2020 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+#include <kodi/AddonBase.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Polyphase windowed sinc resampler for float samples, so the add-on can output
+// a fixed rate (the sink's) rather than the odd rates many games use. Input is
+// pushed as it's decoded and output is taken as needed, with the stream's first
+// sample at the first output sample (no delay).
+class ATTRIBUTE_HIDDEN CVGMResampler
+{
+public:
+  CVGMResampler() = default;
+
+  // Sets up conversion, returns false (and stays inactive) if rates are the same or invalid.
+  // Low power uses a shorter filter.
+  bool Init(int channels, int inputRate, int outputRate, bool lowPower);
+  bool IsActive() const { return m_active; }
+
+  // Forgets pending input and history (seeks)
+  void Reset();
+
+  // Adds interleaved input frames
+  void Push(const float* input, size_t frames);
+  // Pads the end so the last input frames can be output
+  void Flush();
+
+  // Writes up to frames of interleaved output, returns frames done (less if more input is needed)
+  size_t Process(float* output, size_t frames);
+
+private:
+  void Compact();
+
+  bool m_active = false;
+  int m_channels = 0;
+  int m_taps = 0; // multiple of 4
+  uint64_t m_step = 0; // input frames per output frame, 32.32 fixed point
+  uint64_t m_pos = 0; // position of the next output frame in m_planes, 32.32 fixed point
+  std::vector<float> m_filters; // (phases + 1) * taps coefs, interpolated between phases
+  std::vector<float> m_coefs; // coefs for the current output frame
+  std::vector<std::vector<float>> m_planes; // history and pending input per channel
+};
@@ -0,0 +1,132 @@
+/*
+ *  Copyright (C) 2005-2020 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "VGMSeekIndexCache.h"
+
+#include <kodi/Filesystem.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+// Indexes kept, a few KB to a few hundred KB each, the oldest quarter is dropped when over
+#define VGM_SEEK_INDEX_MAX_FILES 256
+
+static bool IsTemp(const std::string& path)
+{
+  return path.size() > 4 && path.compare(path.size() - 4, 4, ".tmp") == 0;
+}
+
+size_t CVGMSeekIndexCache::Load(const char* name, void* buf, size_t maxSize, void* data)
+{
+  return static_cast<CVGMSeekIndexCache*>(data)->Read(name, buf, maxSize);
+}
+
+void CVGMSeekIndexCache::Save(const char* name, const void* buf, size_t size, void* data)
+{
+  static_cast<CVGMSeekIndexCache*>(data)->Write(name, buf, size);
+}
+
+void CVGMSeekIndexCache::Open()
+{
+  if (m_opened)
+    return;
+  m_opened = true;
+  m_folder = kodi::GetBaseUserPath("seek/");
+
+  // writes interrupted on previous runs are dropped, the rest counted
+  std::vector<kodi::vfs::CDirEntry> items;
+  if (!kodi::vfs::GetDirectory(m_folder, "", items))
+    return;
+  for (const auto& item : items)
+  {
+    if (item.IsFolder())
+      continue;
+    if (IsTemp(item.Path()))
+      kodi::vfs::DeleteFile(item.Path());
+    else
+      m_files++;
+  }
+}
+
+size_t CVGMSeekIndexCache::Read(const std::string& name, void* buf, size_t maxSize)
+{
+  std::string path;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Open();
+    path = m_folder + name;
+  }
+
+  kodi::vfs::CFile file;
+  if (!file.OpenFile(path))
+    return 0;
+
+  // bigger ones are asked again with enough room
+  int64_t size = file.GetLength();
+  if (size <= 0 || (uint64_t)size > maxSize)
+    return size > 0 ? (size_t)size : 0;
+
+  return file.Read(buf, (size_t)size) == (ssize_t)size ? (size_t)size : 0;
+}
+
+void CVGMSeekIndexCache::Write(const std::string& name, const void* buf, size_t size)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  Open();
+
+  if (!kodi::vfs::DirectoryExists(m_folder))
+    kodi::vfs::CreateDirectory(m_folder);
+
+  // written whole and moved in place, so readers never see part of one
+  char temp[64];
+  snprintf(temp, sizeof(temp), "%s-%u.tmp", name.c_str(), ++m_temps);
+  kodi::vfs::CFile file;
+  if (!file.OpenFileForWrite(m_folder + temp, true))
+    return;
+  bool written = file.Write(buf, size) == (ssize_t)size;
+  file.Close();
+
+  std::string path = m_folder + name;
+  bool replaced = kodi::vfs::FileExists(path);
+  if (replaced)
+    kodi::vfs::DeleteFile(path);
+  if (!written || !kodi::vfs::RenameFile(m_folder + temp, path))
+  {
+    kodi::vfs::DeleteFile(m_folder + temp);
+    if (replaced)
+      m_files--;
+    return;
+  }
+
+  if (!replaced && ++m_files > VGM_SEEK_INDEX_MAX_FILES)
+    Evict();
+}
+
+void CVGMSeekIndexCache::Evict()
+{
+  std::vector<kodi::vfs::CDirEntry> items;
+  if (!kodi::vfs::GetDirectory(m_folder, "", items))
+    return;
+
+  items.erase(std::remove_if(items.begin(), items.end(),
+                             [](const kodi::vfs::CDirEntry& item)
+                             { return item.IsFolder() || IsTemp(item.Path()); }),
+              items.end());
+  std::sort(items.begin(), items.end(),
+            [](const kodi::vfs::CDirEntry& a, const kodi::vfs::CDirEntry& b)
+            { return a.DateTime() < b.DateTime(); });
+
+  m_files = (unsigned int)items.size();
+  for (const auto& item : items)
+  {
+    if (m_files <= VGM_SEEK_INDEX_MAX_FILES * 3 / 4)
+      break;
+    if (kodi::vfs::DeleteFile(item.Path()))
+      m_files--;
+  }
+}
@@ -0,0 +1,41 @@
+/*
+ *  Copyright (C) 2005-2020 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+#include <kodi/AddonBase.h>
+
+#include <cstddef>
+#include <mutex>
+#include <string>
+
+// On-disk store of the seek indexes vgmstream builds while decoding files that
+// can only be seeked by decoding forward (see vgmstream_seek_index_cache_setup),
+// so seeking files played in earlier sessions jumps close to the target. Entries
+// are small files named by vgmstream, and the folder is kept to a number of them
+// by dropping the least recently written.
+class ATTRIBUTE_HIDDEN CVGMSeekIndexCache
+{
+public:
+  CVGMSeekIndexCache() = default;
+
+  // Callbacks passed to vgmstream, data is the CVGMSeekIndexCache
+  static size_t Load(const char* name, void* buf, size_t maxSize, void* data);
+  static void Save(const char* name, const void* buf, size_t size, void* data);
+
+private:
+  size_t Read(const std::string& name, void* buf, size_t maxSize);
+  void Write(const std::string& name, const void* buf, size_t size);
+  void Open();
+  void Evict();
+
+  std::mutex m_mutex;
+  std::string m_folder;
+  bool m_opened = false;
+  unsigned int m_files = 0;
+  unsigned int m_temps = 0;
+};
@@ -0,0 +1,107 @@
+/*
+ *  Copyright (C) 2005-2020 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "VGMStreamCache.h"
+
+#include "VGMCodec.h"
+
+// Streams keep open files and decoder memory, so only a few are kept
+#define VGM_STREAM_CACHE_SIZE 3
+// Subsong lists are only info, but banks may have thousands of subsongs
+#define VGM_BANK_CACHE_SIZE 8
+
+CVGMStreamCache::~CVGMStreamCache()
+{
+  for (auto& entry : m_entries)
+    free_VFS(entry.ctx);
+}
+
+void CVGMStreamCache::Put(const std::string& filename, VGMContext* ctx)
+{
+  VGMContext* removed = nullptr;
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_entries.push_front({filename, ctx});
+    if (m_entries.size() > VGM_STREAM_CACHE_SIZE)
+    {
+      removed = m_entries.back().ctx;
+      m_entries.pop_back();
+    }
+  }
+
+  free_VFS(removed);
+}
+
+VGMContext* CVGMStreamCache::Take(const std::string& filename)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  for (auto it = m_entries.begin(); it != m_entries.end(); ++it)
+  {
+    if (it->filename == filename)
+    {
+      VGMContext* ctx = it->ctx;
+      m_entries.erase(it);
+      return ctx;
+    }
+  }
+  return nullptr;
+}
+
+bool CVGMStreamCache::Peek(const std::string& filename,
+                           const std::function<void(const VGMSTREAM*)>& func)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  for (const auto& entry : m_entries)
+  {
+    if (entry.filename == filename)
+    {
+      func(entry.ctx->stream);
+      return true;
+    }
+  }
+  return false;
+}
+
+void CVGMStreamCache::PutSubsongs(const std::string& filename,
+                                  std::vector<vgmstream_subsong_info>&& subsongs)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_banks.push_front({filename, std::move(subsongs)});
+  if (m_banks.size() > VGM_BANK_CACHE_SIZE)
+    m_banks.pop_back();
+}
+
+int CVGMStreamCache::GetSubsongCount(const std::string& filename)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  for (const auto& bank : m_banks)
+  {
+    if (bank.filename == filename)
+      return bank.subsongs.size();
+  }
+  return 0;
+}
+
+bool CVGMStreamCache::GetSubsong(const std::string& filename,
+                                 int subsong,
+                                 vgmstream_subsong_info& info)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  for (auto it = m_banks.begin(); it != m_banks.end(); ++it)
+  {
+    if (it->filename != filename)
+      continue;
+    if (subsong < 1 || subsong > (int)it->subsongs.size())
+      return false;
+
+    info = it->subsongs[subsong - 1];
+    m_banks.splice(m_banks.begin(), m_banks, it); // keep recently used banks
+    return true;
+  }
+  return false;
+}
@@ -0,0 +1,66 @@
+/*
+ *  Copyright (C) 2005-2020 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+#include <kodi/AddonBase.h>
+
+#include <functional>
+#include <list>
+#include <mutex>
+#include <string>
+#include <vector>
+
+extern "C"
+{
+#include "src/plugins.h"
+#include "src/vgmstream.h"
+
+  struct VGMContext;
+
+} /* extern "C" */
+
+// Add-on wide cache of recently opened streams, so that a following Init or
+// ReadTag of the same file (ex. Kodi opening a track again for playback)
+// doesn't redo format detection and stream setup.
+class ATTRIBUTE_HIDDEN CVGMStreamCache
+{
+public:
+  CVGMStreamCache() = default;
+  ~CVGMStreamCache();
+
+  // Stores an opened context (with stream at start position), takes ownership
+  void Put(const std::string& filename, VGMContext* ctx);
+
+  // Removes and returns a cached context, nullptr if not found
+  VGMContext* Take(const std::string& filename);
+
+  // Calls func with the cached stream without taking it, false if not found
+  bool Peek(const std::string& filename, const std::function<void(const VGMSTREAM*)>& func);
+
+  // Subsong list of a bank file, so every track doesn't need to parse it again
+  void PutSubsongs(const std::string& filename, std::vector<vgmstream_subsong_info>&& subsongs);
+  int GetSubsongCount(const std::string& filename);
+  bool GetSubsong(const std::string& filename, int subsong, vgmstream_subsong_info& info);
+
+private:
+  struct Entry
+  {
+    std::string filename;
+    VGMContext* ctx;
+  };
+
+  struct Bank
+  {
+    std::string filename;
+    std::vector<vgmstream_subsong_info> subsongs;
+  };
+
+  std::mutex m_mutex;
+  std::list<Entry> m_entries; // most recent first
+  std::list<Bank> m_banks; // most recent first
+};
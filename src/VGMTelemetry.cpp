@@ -0,0 +1,95 @@
+/*
+ *  Copyright (C) 2005-2020 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "VGMTelemetry.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+
+void CVGMTelemetry::Start(bool enabled, int64_t bytesPerSecond)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_enabled = enabled && bytesPerSecond > 0;
+  m_bytesPerSecond = bytesPerSecond;
+
+  m_decodes = 0;
+  std::fill(m_decodeLoad, m_decodeLoad + LOAD_BUCKETS, 0);
+  m_decodeMaxUs = 0;
+  m_reads = m_readMisses = 0;
+  m_readMaxUs = 0;
+  m_seeks = 0;
+  m_seekTotalUs = m_seekMaxUs = 0;
+  m_ioStalls = 0;
+  m_ioTotalUs = m_ioMaxUs = 0;
+}
+
+int64_t CVGMTelemetry::DurationUs(int bytes) const
+{
+  return (int64_t)bytes * 1000000 / m_bytesPerSecond;
+}
+
+void CVGMTelemetry::AddDecode(int64_t decodeUs, int64_t readUs, int bytes)
+{
+  if (!m_enabled || bytes <= 0)
+    return;
+
+  int64_t durationUs = DurationUs(bytes);
+  int bucket = 0;
+  while (bucket < LOAD_BUCKETS - 1 && decodeUs > (durationUs >> (LOAD_BUCKETS - 2 - bucket)))
+    bucket++;
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_decodes++;
+  m_decodeLoad[bucket]++;
+  m_decodeMaxUs = std::max(m_decodeMaxUs, decodeUs);
+  m_ioTotalUs += readUs;
+  m_ioMaxUs = std::max(m_ioMaxUs, readUs);
+  if (readUs > durationUs / 2)
+    m_ioStalls++;
+}
+
+void CVGMTelemetry::AddRead(int64_t callUs, int bytes)
+{
+  if (!m_enabled || bytes <= 0)
+    return;
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_reads++;
+  m_readMaxUs = std::max(m_readMaxUs, callUs);
+  if (callUs > DurationUs(bytes))
+    m_readMisses++;
+}
+
+void CVGMTelemetry::AddSeek(int64_t seekUs)
+{
+  if (!m_enabled)
+    return;
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_seeks++;
+  m_seekTotalUs += seekUs;
+  m_seekMaxUs = std::max(m_seekMaxUs, seekUs);
+}
+
+std::string CVGMTelemetry::Summary()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  char line[512];
+  snprintf(line, sizeof(line),
+           "decodes %" PRIu64 " load<=1/32:%" PRIu64 " 1/16:%" PRIu64 " 1/8:%" PRIu64
+           " 1/4:%" PRIu64 " 1/2:%" PRIu64 " 1:%" PRIu64 " over:%" PRIu64 " max %.1f ms, "
+           "reads %" PRIu64 " late %" PRIu64 " max %.1f ms, "
+           "seeks %" PRIu64 " avg %.1f ms max %.1f ms, "
+           "io %.1f ms max %.1f ms stalls %" PRIu64,
+           m_decodes, m_decodeLoad[0], m_decodeLoad[1], m_decodeLoad[2], m_decodeLoad[3],
+           m_decodeLoad[4], m_decodeLoad[5], m_decodeLoad[6], m_decodeMaxUs / 1000.0, m_reads,
+           m_readMisses, m_readMaxUs / 1000.0, m_seeks,
+           m_seeks ? m_seekTotalUs / 1000.0 / m_seeks : 0.0, m_seekMaxUs / 1000.0,
+           m_ioTotalUs / 1000.0, m_ioMaxUs / 1000.0, m_ioStalls);
+  return line;
+}
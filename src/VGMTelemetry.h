@@ -0,0 +1,63 @@
+/*
+ *  Copyright (C) 2005-2020 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+#include <kodi/AddonBase.h>
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+// Playback counters of one track (telemetry setting), summarized in one log line when it
+// stops so logs of many devices can tell which formats underrun where. Decodes may be
+// counted from the decode thread while reads and seeks come from Kodi's.
+class ATTRIBUTE_HIDDEN CVGMTelemetry
+{
+public:
+  CVGMTelemetry() = default;
+
+  // Clears counters for a new play, nothing is counted while disabled.
+  // bytesPerSecond is of the output given to Kodi, to know each buffer's duration.
+  void Start(bool enabled, int64_t bytesPerSecond);
+  bool IsEnabled() const { return m_enabled; }
+
+  // One decoded buffer of bytes, with the time spent in file reads while decoding it
+  void AddDecode(int64_t decodeUs, int64_t readUs, int bytes);
+  // One ReadPCM call that returned bytes
+  void AddRead(int64_t callUs, int bytes);
+  void AddSeek(int64_t seekUs);
+
+  // Counters as "key value" pairs for the log
+  std::string Summary();
+
+private:
+  // Decode time per buffer as a share of the buffer's duration: up to 1/32, 1/16, ... 1/1, over
+  static const int LOAD_BUCKETS = 7;
+
+  int64_t DurationUs(int bytes) const;
+
+  std::mutex m_mutex;
+  bool m_enabled = false;
+  int64_t m_bytesPerSecond = 0;
+
+  uint64_t m_decodes = 0;
+  uint64_t m_decodeLoad[LOAD_BUCKETS] = {};
+  int64_t m_decodeMaxUs = 0;
+
+  uint64_t m_reads = 0;
+  uint64_t m_readMisses = 0; // calls that took longer than the audio they returned
+  int64_t m_readMaxUs = 0;
+
+  uint64_t m_seeks = 0;
+  int64_t m_seekTotalUs = 0;
+  int64_t m_seekMaxUs = 0;
+
+  uint64_t m_ioStalls = 0; // decodes that spent over half their buffer's duration in file reads
+  int64_t m_ioTotalUs = 0;
+  int64_t m_ioMaxUs = 0;
+};